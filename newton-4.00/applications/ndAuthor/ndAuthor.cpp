@@ -903,6 +903,9 @@ void ndAuthor::ShowMainMenuBar()
 			ImGui::RadioButton("cuda", &solverMode, ndWorld::ndCudaSolver);
 			ImGui::RadioButton("syclCpu", &solverMode, ndWorld::ndSyclSolverCpu);
 			ImGui::RadioButton("syclGpu", &solverMode, ndWorld::ndSyclSolverGpu);
+			ImGui::RadioButton("gauss seidel", &solverMode, ndWorld::ndColoredGaussSeidelSolver);
+			ImGui::RadioButton("islands", &solverMode, ndWorld::ndIslandParallelSolver);
+			ImGui::RadioButton("substeps", &solverMode, ndWorld::ndSubstepSolver);
 
 			m_solverMode = ndWorld::ndSolverModes(solverMode);
 			ImGui::Separator();
@@ -22,18 +22,25 @@
 #include "ndBrainStdafx.h"
 #include "ndBrain.h"
 #include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
 #include "ndBrainSaveLoad.h"
 
 ndSpinLock ndBrain::m_lock;
 
 ndBrain::ndBrain()
 	:ndArray<ndBrainLayer*>()
+	,m_batchBuffersColumns(0)
 {
+	m_batchBuffers[0] = nullptr;
+	m_batchBuffers[1] = nullptr;
 }
 
 ndBrain::ndBrain(const ndBrain& src)
 	:ndArray<ndBrainLayer*>()
+	,m_batchBuffersColumns(0)
 {
+	m_batchBuffers[0] = nullptr;
+	m_batchBuffers[1] = nullptr;
 	const ndArray<ndBrainLayer*>& srcLayers = src;
 	for (ndInt32 i = 0; i < srcLayers.GetCount(); ++i)
 	{
@@ -49,6 +56,40 @@ ndBrain::~ndBrain()
 	{
 		delete (*this)[i];
 	}
+	FreeBatchBuffers();
+}
+
+void ndBrain::FreeBatchBuffers()
+{
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		if (m_batchBuffers[i])
+		{
+			delete m_batchBuffers[i];
+			m_batchBuffers[i] = nullptr;
+		}
+	}
+	m_batchBuffersColumns = 0;
+}
+
+void ndBrain::InitBatchBuffers(ndInt32 batchSize)
+{
+	const ndArray<ndBrainLayer*>& layers = *this;
+	ndInt32 columns = 0;
+	for (ndInt32 i = GetCount() - 2; i >= 0; --i)
+	{
+		columns = ndMax(columns, layers[i]->GetOutputSize());
+	}
+
+	if (m_batchBuffers[0] && (m_batchBuffers[0]->GetRows() == batchSize) && (m_batchBuffersColumns >= columns))
+	{
+		return;
+	}
+
+	FreeBatchBuffers();
+	m_batchBuffersColumns = columns;
+	m_batchBuffers[0] = new ndBrainMatrix(batchSize, columns);
+	m_batchBuffers[1] = new ndBrainMatrix(batchSize, columns);
 }
 
 ndInt32 ndBrain::GetInputSize() const
@@ -234,6 +275,31 @@ void ndBrain::MakePrediction(const ndBrainVector& input, ndBrainVector& output,
 	output.Set(in);
 }
 
+void ndBrain::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output)
+{
+	const ndArray<ndBrainLayer*>& layers = *this;
+	ndAssert(input.GetRows() == output.GetRows());
+	ndAssert(input.GetColumns() == GetInputSize());
+	ndAssert(output.GetColumns() == GetOutputSize());
+
+	InitBatchBuffers(input.GetRows());
+
+	const ndBrainMatrix* in = &input;
+	for (ndInt32 i = 0; i < GetCount(); ++i)
+	{
+		ndBrainMatrix* out = &output;
+		if (i != (GetCount() - 1))
+		{
+			// the ping pong buffers are as wide as the widest hidden layer.
+			out = m_batchBuffers[i & 1];
+			ndAssert(layers[i]->GetOutputSize() <= m_batchBuffersColumns);
+			out->SetColumns(layers[i]->GetOutputSize());
+		}
+		layers[i]->MakeBatchPrediction(*in, *out);
+		in = out;
+	}
+}
+
 void ndBrain::CalculateInputGradient___(const ndBrainVector& input, ndBrainVector& inputGradients)
 {
 	ndAssert(0);
@@ -278,8 +344,51 @@ void ndBrain::CalculateInputGradient___(const ndBrainVector& input, ndBrainVecto
 	inputGradients.Set(gradientOut);
 }
 
-//void ndBrain::CalculateInputGradient(const ndBrainVector& input, ndBrainVector& inputGradients, ndBrainVector& workingBuffer)
-void ndBrain::CalculateInputGradient(const ndBrainVector&, ndBrainVector&, ndBrainVector&)
+void ndBrain::CalculateInputGradient(const ndBrainVector& input, ndBrainVector& inputGradients, ndBrainVector& workingBuffer)
 {
-	ndAssert(0);
-}
\ No newline at end of file
+	// the gradient of the sum of the outputs with respect to the inputs.
+	// all layer outputs are kept, since the derivatives are functions of them.
+	ndFixSizeArray<ndInt32, 256> prefixScan;
+	const ndArray<ndBrainLayer*>& layers = *this;
+
+	ndInt32 maxSize = layers[0]->GetInputSize();
+	ndInt32 sizeAcc = (layers[0]->GetInputSize() + 7) & -8;
+	prefixScan.PushBack(0);
+	for (ndInt32 i = 0; i < GetCount(); ++i)
+	{
+		prefixScan.PushBack(sizeAcc);
+		sizeAcc += (layers[i]->GetOutputBufferSize() + 7) & -8;
+		maxSize = ndMax(maxSize, layers[i]->GetOutputSize());
+	}
+
+	const ndInt32 gradientSize = (maxSize + 7) & -8;
+	const ndInt32 maxMemory = sizeAcc + gradientSize * 2;
+	if (maxMemory > workingBuffer.GetCapacity())
+	{
+		ndScopeSpinLock lock(m_lock);
+		workingBuffer.SetCount(maxMemory);
+	}
+	workingBuffer.SetCount(maxMemory);
+
+	ndBrainMemVector in0(&workingBuffer[0], input.GetCount());
+	in0.Set(input);
+	for (ndInt32 i = 0; i < GetCount(); ++i)
+	{
+		const ndBrainMemVector in(&workingBuffer[prefixScan[i + 0]], layers[i]->GetInputSize());
+		ndBrainMemVector out(&workingBuffer[prefixScan[i + 1]], layers[i]->GetOutputSize());
+		layers[i]->MakePrediction(in, out);
+	}
+
+	ndBrainMemVector gradientIn(&workingBuffer[sizeAcc], GetOutputSize());
+	ndBrainMemVector gradientOut(&workingBuffer[sizeAcc + gradientSize], GetOutputSize());
+	gradientOut.Set(ndBrainFloat(1.0f));
+	for (ndInt32 i = layers.GetCount() - 1; i >= 0; --i)
+	{
+		const ndBrainLayer* const layer = layers[i];
+		gradientIn.SetSize(layer->GetInputSize());
+		const ndBrainMemVector out(&workingBuffer[prefixScan[i + 1]], layer->GetOutputSize());
+		layer->InputDerivative(out, gradientOut, gradientIn);
+		gradientIn.Swap(gradientOut);
+	}
+	inputGradients.Set(gradientOut);
+}
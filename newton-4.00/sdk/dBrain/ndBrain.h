@@ -56,6 +56,7 @@ class ndBrain: public ndArray<ndBrainLayer*>
 	void CalculateInputGradient___(const ndBrainVector& input, ndBrainVector& inputGradients);
 
 	void MakePrediction(const ndBrainVector& input, ndBrainVector& output, ndBrainVector& workingBuffer);
+	void MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output);
 	void CalculateInputGradient(const ndBrainVector& input, ndBrainVector& inputGradients, ndBrainVector& workingBuffer);
 
 	friend class ndBrainLoad;
@@ -63,6 +64,14 @@ class ndBrain: public ndArray<ndBrainLayer*>
 	friend class ndBrainTrainer;
 
 	static ndSpinLock m_lock;
+
+	private:
+	void InitBatchBuffers(ndInt32 batchSize);
+	void FreeBatchBuffers();
+
+	// ping pong matrices for the hidden layers of the batch prediction.
+	ndBrainMatrix* m_batchBuffers[2];
+	ndInt32 m_batchBuffersColumns;
 };
 
 #endif 
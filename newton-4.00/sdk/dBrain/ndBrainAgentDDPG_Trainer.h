@@ -26,7 +26,13 @@
 #include "ndBrain.h"
 #include "ndBrainAgent.h"
 #include "ndBrainTrainer.h"
+#include "ndBrainSnapshot.h"
+#include "ndBrainSaveLoad.h"
+#include "ndBrainLayerLinear.h"
 #include "ndBrainReplayBuffer.h"
+#include "ndBrainAsyncLearner.h"
+#include "ndBrainOptimizerAdam.h"
+#include "ndBrainLayerTanhActivation.h"
 #include "ndBrainLossLeastSquaredError.h"
 
 // this is an implementation of the vanilla deep deterministic 
@@ -59,6 +65,9 @@ class ndBrainAgentDDPG_Trainer: public ndBrainAgent, public ndBrainThreadPool
 			m_actionNoiseVariance = ndBrainFloat(0.125f);
 			m_threadsCount = ndMin(ndBrainThreadPool::GetMaxThreads(), ndMin(m_bashBufferSize, 16));
 			//m_threadsCount = 1;
+
+			m_asyncLearning = false;
+			m_maxLearnerStepsPerPublish = 64;
 		}
 
 		ndBrainFloat m_regularizer;
@@ -75,6 +84,39 @@ class ndBrainAgentDDPG_Trainer: public ndBrainAgent, public ndBrainThreadPool
 		ndInt32 m_replayBufferPrefill;
 		ndInt32 m_numberOfHiddenLayers;
 		ndInt32 m_hiddenLayersNumberOfNeurons;
+
+		// when enabled, the optimization runs on a background thread 
+		// and the actor selects actions with the last published weights.
+		ndInt32 m_maxLearnerStepsPerPublish;
+		bool m_asyncLearning;
+	};
+
+	class ndLearner: public ndBrainAsyncLearner
+	{
+		public:
+		ndLearner(ndBrainAgentDDPG_Trainer<statesDim, actionDim>* const owner)
+			:ndBrainAsyncLearner()
+			,m_owner(owner)
+			,m_steps(0)
+		{
+		}
+
+		~ndLearner()
+		{
+			Sync();
+		}
+
+		void Learn() override
+		{
+			for (ndInt32 i = 0; i < m_steps; ++i)
+			{
+				m_owner->BackPropagate();
+			}
+			m_owner->m_publishedActor->Publish(m_owner->m_actor);
+		}
+
+		ndBrainAgentDDPG_Trainer<statesDim, actionDim>* m_owner;
+		ndInt32 m_steps;
 	};
 
 	ndBrainAgentDDPG_Trainer(const HyperParameters& hyperParameters);
@@ -90,6 +132,9 @@ class ndBrainAgentDDPG_Trainer: public ndBrainAgent, public ndBrainThreadPool
 	ndBrainFloat GetActionNoise() const;
 	void SetActionNoise(ndBrainFloat noiseVaraince);
 
+	bool IsAsyncLearning() const;
+	ndUnsigned32 GetPublishedVersion() const;
+
 	protected:
 	void Step();
 	void Optimize();
@@ -119,10 +164,14 @@ class ndBrainAgentDDPG_Trainer: public ndBrainAgent, public ndBrainThreadPool
 	ndBrainOptimizerAdam* m_criticOptimizer;
 	ndArray<ndBrainTrainer*> m_actorTrainers;
 	ndArray<ndBrainTrainer*> m_criticTrainers;
+	ndBrainSnapshot* m_publishedActor;
+	ndLearner* m_learner;
 
 	ndArray<ndInt32> m_bashSamples;
 	ndBrainReplayBuffer<statesDim, actionDim> m_replayBuffer;
 	ndBrainReplayTransitionMemory<statesDim, actionDim> m_currentTransition;
+	ndArray<ndBrainReplayTransitionMemory<statesDim, actionDim>> m_pendingTransitions;
+	ndBrainVector m_workingBuffer;
 
 	ndBrainFloat m_discountFactor;
 	ndBrainFloat m_actorLearnRate;
@@ -134,6 +183,7 @@ class ndBrainAgentDDPG_Trainer: public ndBrainAgent, public ndBrainThreadPool
 	ndInt32 m_eposideCount;
 	ndInt32 m_bashBufferSize;
 	ndInt32 m_replayBufferPrefill;
+	ndInt32 m_maxLearnerStepsPerPublish;
 	ndMovingAverage<256> m_averageQvalue;
 	ndMovingAverage<256> m_averageFramesPerEpisodes;
 	bool m_collectingSamples;
@@ -148,9 +198,13 @@ ndBrainAgentDDPG_Trainer<statesDim, actionDim>::ndBrainAgentDDPG_Trainer(const H
 	,m_targetCritic()
 	,m_actorOptimizer(nullptr)
 	,m_criticOptimizer(nullptr)
+	,m_publishedActor(nullptr)
+	,m_learner(nullptr)
 	,m_bashSamples()
 	,m_replayBuffer()
 	,m_currentTransition()
+	,m_pendingTransitions()
+	,m_workingBuffer()
 	,m_discountFactor(hyperParameters.m_discountFactor)
 	,m_actorLearnRate(hyperParameters.m_actorLearnRate)
 	,m_criticLearnRate(hyperParameters.m_criticLearnRate)
@@ -161,6 +215,7 @@ ndBrainAgentDDPG_Trainer<statesDim, actionDim>::ndBrainAgentDDPG_Trainer(const H
 	,m_eposideCount(0)
 	,m_bashBufferSize(hyperParameters.m_bashBufferSize)
 	,m_replayBufferPrefill(hyperParameters.m_replayBufferPrefill)
+	,m_maxLearnerStepsPerPublish(hyperParameters.m_maxLearnerStepsPerPublish)
 	,m_averageQvalue()
 	,m_averageFramesPerEpisodes()
 	,m_collectingSamples(true)
@@ -168,7 +223,7 @@ ndBrainAgentDDPG_Trainer<statesDim, actionDim>::ndBrainAgentDDPG_Trainer(const H
 	// build actor network
 	ndFixSizeArray<ndBrainLayer*, 32> layers;
 	layers.SetCount(0);
-	layers.PushBack(new ndBrainLayerLinear(m_stateSize, hyperParameters.m_hiddenLayersNumberOfNeurons));
+	layers.PushBack(new ndBrainLayerLinear(statesDim, hyperParameters.m_hiddenLayersNumberOfNeurons));
 	layers.PushBack(new ndBrainLayerTanhActivation(layers[layers.GetCount() - 1]->GetOutputSize()));
 	for (ndInt32 i = 1; i < hyperParameters.m_numberOfHiddenLayers; ++i)
 	{
@@ -176,8 +231,8 @@ ndBrainAgentDDPG_Trainer<statesDim, actionDim>::ndBrainAgentDDPG_Trainer(const H
 		layers.PushBack(new ndBrainLayerLinear(hyperParameters.m_hiddenLayersNumberOfNeurons, hyperParameters.m_hiddenLayersNumberOfNeurons));
 		layers.PushBack(new ndBrainLayerTanhActivation(hyperParameters.m_hiddenLayersNumberOfNeurons));
 	}
-	layers.PushBack(new ndBrainLayerLinear(hyperParameters.m_hiddenLayersNumberOfNeurons, m_actionsSize));
-	layers.PushBack(new ndBrainLayerTanhActivation(m_actionsSize));
+	layers.PushBack(new ndBrainLayerLinear(hyperParameters.m_hiddenLayersNumberOfNeurons, actionDim));
+	layers.PushBack(new ndBrainLayerTanhActivation(actionDim));
 	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
 	{
 		m_actor.AddLayer(layers[i]);
@@ -186,7 +241,7 @@ ndBrainAgentDDPG_Trainer<statesDim, actionDim>::ndBrainAgentDDPG_Trainer(const H
 
 	// the critic is more complex since is deal with more complex inputs
 	layers.SetCount(0);
-	layers.PushBack(new ndBrainLayerLinear(m_stateSize + m_actionsSize, hyperParameters.m_hiddenLayersNumberOfNeurons * 2));
+	layers.PushBack(new ndBrainLayerLinear(statesDim + actionDim, hyperParameters.m_hiddenLayersNumberOfNeurons * 2));
 	layers.PushBack(new ndBrainLayerTanhActivation(layers[layers.GetCount() - 1]->GetOutputSize()));
 	for (ndInt32 i = 1; i < hyperParameters.m_numberOfHiddenLayers; ++i)
 	{
@@ -222,11 +277,23 @@ ndBrainAgentDDPG_Trainer<statesDim, actionDim>::ndBrainAgentDDPG_Trainer(const H
 	m_criticOptimizer = new ndBrainOptimizerAdam();
 	m_actorOptimizer->SetRegularizer(hyperParameters.m_regularizer);
 	m_criticOptimizer->SetRegularizer(hyperParameters.m_criticRegularizer);
+
+	if (hyperParameters.m_asyncLearning)
+	{
+		m_publishedActor = new ndBrainSnapshot(m_actor);
+		m_learner = new ndLearner(this);
+	}
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
 ndBrainAgentDDPG_Trainer<statesDim, actionDim>::~ndBrainAgentDDPG_Trainer()
 {
+	if (m_learner)
+	{
+		delete m_learner;
+		delete m_publishedActor;
+	}
+
 	for (ndInt32 i = 0; i < m_actorTrainers.GetCount(); ++i)
 	{
 		delete m_actorTrainers[i];
@@ -246,21 +313,37 @@ bool ndBrainAgentDDPG_Trainer<statesDim, actionDim>::IsTrainer() const
 template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::InitWeights()
 {
+	if (m_learner)
+	{
+		m_learner->Sync();
+	}
 	m_actor.InitWeightsXavierMethod();
 	m_critic.InitWeightsXavierMethod();
 
 	m_targetActor.CopyFrom(m_actor);
 	m_targetCritic.CopyFrom(m_critic);
+	if (m_publishedActor)
+	{
+		m_publishedActor->Publish(m_actor);
+	}
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::InitWeights(ndBrainFloat weighVariance, ndBrainFloat biasVariance)
 {
+	if (m_learner)
+	{
+		m_learner->Sync();
+	}
 	m_actor.InitWeights(weighVariance, biasVariance);
 	m_critic.InitWeights(weighVariance, biasVariance);
 
 	m_targetActor.CopyFrom(m_actor);
 	m_targetCritic.CopyFrom(m_critic);
+	if (m_publishedActor)
+	{
+		m_publishedActor->Publish(m_actor);
+	}
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
@@ -288,6 +371,18 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::SetActionNoise(ndBrainFloat
 	m_actionNoiseVariance = noiseVariance;
 }
 
+template<ndInt32 statesDim, ndInt32 actionDim>
+bool ndBrainAgentDDPG_Trainer<statesDim, actionDim>::IsAsyncLearning() const
+{
+	return m_learner ? true : false;
+}
+
+template<ndInt32 statesDim, ndInt32 actionDim>
+ndUnsigned32 ndBrainAgentDDPG_Trainer<statesDim, actionDim>::GetPublishedVersion() const
+{
+	return m_publishedActor ? m_publishedActor->GetVersion() : 0;
+}
+
 template<ndInt32 statesDim, ndInt32 actionDim>
 bool ndBrainAgentDDPG_Trainer<statesDim, actionDim>::IsSampling() const
 {
@@ -333,6 +428,8 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagateCritic(const n
 				,m_reward(0.0f)
 				,m_discountFactor(discountFactor)
 				,m_isTerminal(false)
+				,m_criticInput()
+				,m_workingBuffer()
 			{
 			}
 
@@ -347,7 +444,7 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagateCritic(const n
 				ndBrainFloat targetValue = m_reward;
 				if (!m_isTerminal)
 				{
-					m_agent->m_targetCritic.MakePrediction(m_criticInput, criticOutput);
+					m_agent->m_targetCritic.MakePrediction(m_criticInput, criticOutput, m_workingBuffer);
 					targetValue = m_reward + m_discountFactor * criticOutput[0];
 				}
 				criticOutput[0] = targetValue;
@@ -362,8 +459,10 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagateCritic(const n
 			ndBrainFloat m_discountFactor;
 			bool m_isTerminal;
 			ndBrainFixSizeVector<statesDim + actionDim> m_criticInput;
+			ndBrainVector m_workingBuffer;
 		};
 
+		ndBrainVector workingBuffer;
 		ndBrainFixSizeVector<actionDim> nextStateOutput;
 		ndBrainFixSizeVector<statesDim + actionDim> input;
 
@@ -376,7 +475,7 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagateCritic(const n
 			ndInt32 index = ndInt32(shuffleBuffer[i]);
 			const ndBrainReplayTransitionMemory<statesDim, actionDim>& transition = m_replayBuffer[index];
 
-			m_targetActor.MakePrediction(transition.m_nextObservation, nextStateOutput);
+			m_targetActor.MakePrediction(transition.m_nextObservation, nextStateOutput, workingBuffer);
 			ndMemCpy(&loss.m_criticInput[0], &transition.m_nextObservation[0], statesDim);
 			ndMemCpy(&loss.m_criticInput[statesDim], &nextStateOutput[0], actionDim);
 
@@ -406,6 +505,7 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagateActor(const nd
 				:ndBrainLoss()
 				,m_actorTrainer(actorTrainer)
 				,m_agent(agent)
+				,m_workingBuffer()
 				,m_index(0)
 			{
 			}
@@ -420,12 +520,13 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagateActor(const nd
 
 				ndMemCpy(&inputGradient[statesDim], &output[0], actionDim);
 				ndMemCpy(&inputGradient[0], &transition.m_observation[0], statesDim);
-				m_agent->m_critic.CalculateInputGradient(inputGradient, inputGradient);
+				m_agent->m_critic.CalculateInputGradient(inputGradient, inputGradient, m_workingBuffer);
 				ndMemCpy(&loss[0], &inputGradient[statesDim], actionDim);
 			}
 
 			ndBrainTrainer& m_actorTrainer;
 			ndBrainAgentDDPG_Trainer<statesDim, actionDim>* m_agent;
+			ndBrainVector m_workingBuffer;
 			ndInt32 m_index;
 		};
 
@@ -464,6 +565,10 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::BackPropagate()
 template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::Save(ndBrainSave* const loadSave) const
 {
+	if (m_learner)
+	{
+		m_learner->Sync();
+	}
 	loadSave->Save(&m_actor);
 }
 
@@ -511,7 +616,7 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::CalculateQvalue(const ndBra
 	
 	ndMemCpy(&criticInput[0], &state[0], statesDim);
 	ndMemCpy(&criticInput[statesDim], &actions[0], actionDim);
-	m_critic.MakePrediction(criticInput, qValue);
+	m_critic.MakePrediction(criticInput, qValue, m_workingBuffer);
 	m_averageQvalue.Update(ndReal (qValue[0]));
 }
 
@@ -519,14 +624,21 @@ template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::Step()
 {
 	GetObservation(&m_currentTransition.m_observation[0]);
-	m_actor.MakePrediction(m_currentTransition.m_observation, m_currentTransition.m_action);
+	if (m_publishedActor)
+	{
+		m_publishedActor->MakePrediction(m_currentTransition.m_observation, m_currentTransition.m_action, m_workingBuffer);
+	}
+	else
+	{
+		m_actor.MakePrediction(m_currentTransition.m_observation, m_currentTransition.m_action, m_workingBuffer);
+	}
 
 	// explore environment
 	SelectAction(&m_currentTransition.m_action[0]);
 	ApplyActions(&m_currentTransition.m_action[0]);
 
 	m_currentTransition.m_reward = GetReward();
-	if (!IsSampling())
+	if (!IsSampling() && !m_learner)
 	{
 		// Get Q vale from Critic
 		CalculateQvalue(m_currentTransition.m_observation, m_currentTransition.m_action);
@@ -543,11 +655,40 @@ void ndBrainAgentDDPG_Trainer<statesDim, actionDim>::OptimizeStep()
 
 	m_currentTransition.m_terminalState = IsTerminal();
 	GetObservation(&m_currentTransition.m_nextObservation[0]);
-	m_replayBuffer.AddTransition(m_currentTransition);
+	if (m_learner)
+	{
+		// the learner reads the replay buffer while it is busy,
+		// so new transitions wait until it is idle.
+		m_pendingTransitions.PushBack(m_currentTransition);
+		if (!m_learner->IsBusy())
+		{
+			for (ndInt32 i = 0; i < m_pendingTransitions.GetCount(); ++i)
+			{
+				m_replayBuffer.AddTransition(m_pendingTransitions[i]);
+			}
+			if (m_frameCount > m_replayBufferPrefill)
+			{
+				if (IsSampling())
+				{
+					ndExpandTraceMessage("%d start training: episode %d\n", m_frameCount, m_eposideCount);
+				}
+				m_collectingSamples = false;
 
-	if (m_frameCount > m_replayBufferPrefill)
+				// one update per collected frame, like the synchronous mode, 
+				// but bounded so that new weights are published regularly.
+				m_learner->m_steps = ndMin(ndInt32(m_pendingTransitions.GetCount()), m_maxLearnerStepsPerPublish);
+				m_learner->Submit();
+			}
+			m_pendingTransitions.SetCount(0);
+		}
+	}
+	else
 	{
-		Optimize();
+		m_replayBuffer.AddTransition(m_currentTransition);
+		if (m_frameCount > m_replayBufferPrefill)
+		{
+			Optimize();
+		}
 	}
 
 	if (m_currentTransition.m_terminalState)
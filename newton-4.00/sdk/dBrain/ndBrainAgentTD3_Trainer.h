@@ -26,7 +26,13 @@
 #include "ndBrain.h"
 #include "ndBrainAgent.h"
 #include "ndBrainTrainer.h"
+#include "ndBrainSnapshot.h"
+#include "ndBrainSaveLoad.h"
+#include "ndBrainLayerLinear.h"
 #include "ndBrainReplayBuffer.h"
+#include "ndBrainAsyncLearner.h"
+#include "ndBrainOptimizerAdam.h"
+#include "ndBrainLayerTanhActivation.h"
 #include "ndBrainLossLeastSquaredError.h"
 
 // this is an implementation of more stable policy gradient for
@@ -60,6 +66,9 @@ class ndBrainAgentTD3_Trainer : public ndBrainAgent, public ndBrainThreadPool
 			m_softTargetFactor = ndBrainFloat(1.0e-3f);
 			m_actionNoiseVariance = ndBrainFloat(0.125f);
 			m_threadsCount = ndMin(ndBrainThreadPool::GetMaxThreads(), ndMin(m_bashBufferSize, 16));
+
+			m_asyncLearning = false;
+			m_maxLearnerStepsPerPublish = 64;
 		}
 
 		ndBrainFloat m_discountFactor;
@@ -76,6 +85,39 @@ class ndBrainAgentTD3_Trainer : public ndBrainAgent, public ndBrainThreadPool
 		ndInt32 m_replayBufferPrefill;
 		ndInt32 m_numberOfHiddenLayers;
 		ndInt32 m_hiddenLayersNumberOfNeurons;
+
+		// when enabled, the optimization runs on a background thread 
+		// and the actor selects actions with the last published weights.
+		ndInt32 m_maxLearnerStepsPerPublish;
+		bool m_asyncLearning;
+	};
+
+	class ndLearner: public ndBrainAsyncLearner
+	{
+		public:
+		ndLearner(ndBrainAgentTD3_Trainer<statesDim, actionDim>* const owner)
+			:ndBrainAsyncLearner()
+			,m_owner(owner)
+			,m_steps(0)
+		{
+		}
+
+		~ndLearner()
+		{
+			Sync();
+		}
+
+		void Learn() override
+		{
+			for (ndInt32 i = 0; i < m_steps; ++i)
+			{
+				m_owner->BackPropagate();
+			}
+			m_owner->m_publishedActor->Publish(m_owner->m_actor);
+		}
+
+		ndBrainAgentTD3_Trainer<statesDim, actionDim>* m_owner;
+		ndInt32 m_steps;
 	};
 
 	ndBrainAgentTD3_Trainer(const HyperParameters& hyperParameters);
@@ -91,6 +133,9 @@ class ndBrainAgentTD3_Trainer : public ndBrainAgent, public ndBrainThreadPool
 	ndBrainFloat GetActionNoise() const;
 	void SetActionNoise(ndBrainFloat  noiseVaraince);
 
+	bool IsAsyncLearning() const;
+	ndUnsigned32 GetPublishedVersion() const;
+
 	protected:
 	void Step();
 	void Optimize();
@@ -126,10 +171,14 @@ class ndBrainAgentTD3_Trainer : public ndBrainAgent, public ndBrainThreadPool
 	ndArray<ndBrainTrainer*> m_actorTrainers;
 	ndArray<ndBrainTrainer*> m_criticTrainers0;
 	ndArray<ndBrainTrainer*> m_criticTrainers1;
+	ndBrainSnapshot* m_publishedActor;
+	ndLearner* m_learner;
 
 	ndArray<ndInt32> m_bashSamples;
 	ndBrainReplayBuffer<statesDim, actionDim> m_replayBuffer;
 	ndBrainReplayTransitionMemory<statesDim, actionDim> m_currentTransition;
+	ndArray<ndBrainReplayTransitionMemory<statesDim, actionDim>> m_pendingTransitions;
+	ndBrainVector m_workingBuffer;
 
 	ndBrainFloat m_discountFactor;
 	ndBrainFloat m_actorLearnRate;
@@ -141,6 +190,8 @@ class ndBrainAgentTD3_Trainer : public ndBrainAgent, public ndBrainThreadPool
 	ndInt32 m_eposideCount;
 	ndInt32 m_bashBufferSize;
 	ndInt32 m_replayBufferPrefill;
+	ndInt32 m_maxLearnerStepsPerPublish;
+	ndInt32 m_updatesCount;
 	ndMovingAverage<256> m_averageQvalue;
 	ndMovingAverage<256> m_averageFramesPerEpisodes;
 	bool m_collectingSamples;
@@ -159,9 +210,13 @@ ndBrainAgentTD3_Trainer<statesDim, actionDim>::ndBrainAgentTD3_Trainer(const Hyp
 	,m_actorOptimizer(nullptr)
 	,m_criticOptimizer0(nullptr)
 	,m_criticOptimizer1(nullptr)
+	,m_publishedActor(nullptr)
+	,m_learner(nullptr)
 	,m_bashSamples()
 	,m_replayBuffer()
 	,m_currentTransition()
+	,m_pendingTransitions()
+	,m_workingBuffer()
 	,m_discountFactor(hyperParameters.m_discountFactor)
 	,m_actorLearnRate(hyperParameters.m_actorLearnRate)
 	,m_criticLearnRate(hyperParameters.m_criticLearnRate)
@@ -172,6 +227,8 @@ ndBrainAgentTD3_Trainer<statesDim, actionDim>::ndBrainAgentTD3_Trainer(const Hyp
 	,m_eposideCount(0)
 	,m_bashBufferSize(hyperParameters.m_bashBufferSize)
 	,m_replayBufferPrefill(hyperParameters.m_replayBufferPrefill)
+	,m_maxLearnerStepsPerPublish(hyperParameters.m_maxLearnerStepsPerPublish)
+	,m_updatesCount(0)
 	,m_averageQvalue()
 	,m_averageFramesPerEpisodes()
 	,m_collectingSamples(true)
@@ -186,8 +243,8 @@ ndBrainAgentTD3_Trainer<statesDim, actionDim>::ndBrainAgentTD3_Trainer(const Hyp
 		layers.PushBack(new ndBrainLayerLinear(hyperParameters.m_hiddenLayersNumberOfNeurons, hyperParameters.m_hiddenLayersNumberOfNeurons));
 		layers.PushBack(new ndBrainLayerTanhActivation(hyperParameters.m_hiddenLayersNumberOfNeurons));
 	}
-	layers.PushBack(new ndBrainLayerLinear(hyperParameters.m_hiddenLayersNumberOfNeurons, m_actionsSize));
-	layers.PushBack(new ndBrainLayerTanhActivation(m_actionsSize));
+	layers.PushBack(new ndBrainLayerLinear(hyperParameters.m_hiddenLayersNumberOfNeurons, actionDim));
+	layers.PushBack(new ndBrainLayerTanhActivation(actionDim));
 	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
 	{
 		m_actor.AddLayer(layers[i]);
@@ -196,7 +253,7 @@ ndBrainAgentTD3_Trainer<statesDim, actionDim>::ndBrainAgentTD3_Trainer(const Hyp
 
 	// the critic is more complex since is deal with more complex inputs
 	layers.SetCount(0);
-	layers.PushBack(new ndBrainLayerLinear(statesDim + m_actionsSize, hyperParameters.m_hiddenLayersNumberOfNeurons * 2));
+	layers.PushBack(new ndBrainLayerLinear(statesDim + actionDim, hyperParameters.m_hiddenLayersNumberOfNeurons * 2));
 	layers.PushBack(new ndBrainLayerTanhActivation(layers[layers.GetCount() - 1]->GetOutputSize()));
 	for (ndInt32 i = 1; i < hyperParameters.m_numberOfHiddenLayers; ++i)
 	{
@@ -242,11 +299,23 @@ ndBrainAgentTD3_Trainer<statesDim, actionDim>::ndBrainAgentTD3_Trainer(const Hyp
 	m_actorOptimizer->SetRegularizer(hyperParameters.m_regularizer);
 	m_criticOptimizer0->SetRegularizer(hyperParameters.m_criticRegularizer);
 	m_criticOptimizer1->SetRegularizer(hyperParameters.m_criticRegularizer);
+
+	if (hyperParameters.m_asyncLearning)
+	{
+		m_publishedActor = new ndBrainSnapshot(m_actor);
+		m_learner = new ndLearner(this);
+	}
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
 ndBrainAgentTD3_Trainer<statesDim, actionDim>::~ndBrainAgentTD3_Trainer()
 {
+	if (m_learner)
+	{
+		delete m_learner;
+		delete m_publishedActor;
+	}
+
 	for (ndInt32 i = 0; i < m_actorTrainers.GetCount(); ++i)
 	{
 		delete m_actorTrainers[i];
@@ -262,6 +331,10 @@ ndBrainAgentTD3_Trainer<statesDim, actionDim>::~ndBrainAgentTD3_Trainer()
 template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentTD3_Trainer<statesDim, actionDim>::Save(ndBrainSave* const loadSave) const
 {
+	if (m_learner)
+	{
+		m_learner->Sync();
+	}
 	loadSave->Save(&m_actor);
 }
 
@@ -313,9 +386,25 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::SetActionNoise(ndBrainFloat
 	m_actionNoiseVariance = noiseVariance;
 }
 
+template<ndInt32 statesDim, ndInt32 actionDim>
+bool ndBrainAgentTD3_Trainer<statesDim, actionDim>::IsAsyncLearning() const
+{
+	return m_learner ? true : false;
+}
+
+template<ndInt32 statesDim, ndInt32 actionDim>
+ndUnsigned32 ndBrainAgentTD3_Trainer<statesDim, actionDim>::GetPublishedVersion() const
+{
+	return m_publishedActor ? m_publishedActor->GetVersion() : 0;
+}
+
 template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentTD3_Trainer<statesDim, actionDim>::InitWeights()
 {
+	if (m_learner)
+	{
+		m_learner->Sync();
+	}
 	m_actor.InitWeightsXavierMethod();
 	m_critic0.InitWeightsXavierMethod();
 	m_critic1.InitWeightsXavierMethod();
@@ -323,11 +412,19 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::InitWeights()
 	m_targetActor.CopyFrom(m_actor);
 	m_targetCritic0.CopyFrom(m_critic0);
 	m_targetCritic1.CopyFrom(m_critic1);
+	if (m_publishedActor)
+	{
+		m_publishedActor->Publish(m_actor);
+	}
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentTD3_Trainer<statesDim, actionDim>::InitWeights(ndBrainFloat weighVariance, ndBrainFloat biasVariance)
 {
+	if (m_learner)
+	{
+		m_learner->Sync();
+	}
 	m_actor.InitWeights(weighVariance, biasVariance);
 	m_critic0.InitWeights(weighVariance, biasVariance);
 	m_critic1.InitWeights(weighVariance, biasVariance);
@@ -335,6 +432,10 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::InitWeights(ndBrainFloat wei
 	m_targetActor.CopyFrom(m_actor);
 	m_targetCritic0.CopyFrom(m_critic0);
 	m_targetCritic1.CopyFrom(m_critic1);
+	if (m_publishedActor)
+	{
+		m_publishedActor->Publish(m_actor);
+	}
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
@@ -398,6 +499,7 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::BackPropagateCritic(const nd
 			ndBrainFloat m_reward;
 		};
 
+		ndBrainVector workingBuffer;
 		ndBrainFixSizeVector<1> criticOutput;
 		ndBrainFixSizeVector<statesDim> targetInput;
 		ndBrainFixSizeVector<actionDim> nextStateOutput;
@@ -414,17 +516,17 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::BackPropagateCritic(const nd
 			ndInt32 index = ndInt32(shuffleBuffer[i]);
 			const ndBrainReplayTransitionMemory<statesDim, actionDim>& transition = m_replayBuffer[index];
 		
-			m_targetActor.MakePrediction(transition.m_nextObservation, nextStateOutput);
+			m_targetActor.MakePrediction(transition.m_nextObservation, nextStateOutput, workingBuffer);
 			ndMemCpy(&criticInput[0], &transition.m_nextObservation[0], statesDim);
 			ndMemCpy(&criticInput[statesDim], &nextStateOutput[0], actionDim);
 		
 			ndBrainFloat targetValue = transition.m_reward;
 			if (!transition.m_terminalState)
 			{
-				m_targetCritic1.MakePrediction(criticInput, criticOutput);
+				m_targetCritic1.MakePrediction(criticInput, criticOutput, workingBuffer);
 				ndBrainFloat value1 = criticOutput[0];
 		
-				m_targetCritic0.MakePrediction(criticInput, criticOutput);
+				m_targetCritic0.MakePrediction(criticInput, criticOutput, workingBuffer);
 				ndBrainFloat value0 = criticOutput[0];
 		
 				targetValue = transition.m_reward + m_discountFactor * ndMin (value0, value1);
@@ -460,6 +562,7 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::BackPropagateActor(const ndU
 				:ndBrainLoss()
 				,m_actorTrainer(actorTrainer)
 				,m_agent(agent)
+				,m_workingBuffer()
 				,m_index(0)
 			{
 			}
@@ -474,12 +577,13 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::BackPropagateActor(const ndU
 
 				ndMemCpy(&inputGradient[0], &transition.m_observation[0], statesDim);
 				ndMemCpy(&inputGradient[statesDim], &output[0], actionDim);
-				m_agent->m_critic0.CalculateInputGradient(inputGradient, inputGradient);
+				m_agent->m_critic0.CalculateInputGradient(inputGradient, inputGradient, m_workingBuffer);
 				ndMemCpy(&loss[0], &inputGradient[statesDim], actionDim);
 			}
 
 			ndBrainTrainer& m_actorTrainer;
 			ndBrainAgentTD3_Trainer<statesDim, actionDim>* m_agent;
+			ndBrainVector m_workingBuffer;
 			ndInt32 m_index;
 		};
 
@@ -513,14 +617,17 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::BackPropagate()
 
 	BackPropagateCritic(&shuffleBuffer[0]);
 
+	// delayed policy update, the count of updates is used instead of the frame 
+	// count, because with an async learner the frames advance on another thread.
 #if 0
 	BackPropagateActor(&shuffleBuffer[0]);
 #else
-	if (m_frameCount & 1)
+	if (m_updatesCount & 1)
 	{
 		BackPropagateActor(&shuffleBuffer[0]);
 	}
 #endif
+	m_updatesCount++;
 }
 
 template<ndInt32 statesDim, ndInt32 actionDim>
@@ -543,10 +650,10 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::CalculateQvalue(const ndBrai
 	ndMemCpy(&criticInput[0], &state[0], statesDim);
 	ndMemCpy(&criticInput[statesDim], &actions[0], actionDim);
 
-	m_critic1.MakePrediction(criticInput, qValue);
+	m_critic1.MakePrediction(criticInput, qValue, m_workingBuffer);
 	ndBrainFloat reward1 = qValue[0];
 
-	m_critic0.MakePrediction(criticInput, qValue);
+	m_critic0.MakePrediction(criticInput, qValue, m_workingBuffer);
 	ndBrainFloat reward0 = qValue[0];
 
 	m_averageQvalue.Update(ndMin(reward0, reward1));
@@ -556,14 +663,21 @@ template<ndInt32 statesDim, ndInt32 actionDim>
 void ndBrainAgentTD3_Trainer<statesDim, actionDim>::Step()
 {
 	GetObservation(&m_currentTransition.m_observation[0]);
-	m_actor.MakePrediction(m_currentTransition.m_observation, m_currentTransition.m_action);
+	if (m_publishedActor)
+	{
+		m_publishedActor->MakePrediction(m_currentTransition.m_observation, m_currentTransition.m_action, m_workingBuffer);
+	}
+	else
+	{
+		m_actor.MakePrediction(m_currentTransition.m_observation, m_currentTransition.m_action, m_workingBuffer);
+	}
 
 	// explore environment
 	SelectAction(&m_currentTransition.m_action[0]);
 	ApplyActions(&m_currentTransition.m_action[0]);
 
 	m_currentTransition.m_reward = GetReward();
-	if (!IsSampling())
+	if (!IsSampling() && !m_learner)
 	{
 		// Get Q vale from Critic
 		CalculateQvalue(m_currentTransition.m_observation, m_currentTransition.m_action);
@@ -580,11 +694,40 @@ void ndBrainAgentTD3_Trainer<statesDim, actionDim>::OptimizeStep()
 
 	m_currentTransition.m_terminalState = IsTerminal();
 	GetObservation(&m_currentTransition.m_nextObservation[0]);
-	m_replayBuffer.AddTransition(m_currentTransition);
-
-	if (m_frameCount > m_replayBufferPrefill)
+	if (m_learner)
+	{
+		// the learner reads the replay buffer while it is busy,
+		// so new transitions wait until it is idle.
+		m_pendingTransitions.PushBack(m_currentTransition);
+		if (!m_learner->IsBusy())
+		{
+			for (ndInt32 i = 0; i < m_pendingTransitions.GetCount(); ++i)
+			{
+				m_replayBuffer.AddTransition(m_pendingTransitions[i]);
+			}
+			if (m_frameCount > m_replayBufferPrefill)
+			{
+				if (IsSampling())
+				{
+					ndExpandTraceMessage("%d start training: episode %d\n", m_frameCount, m_eposideCount);
+				}
+				m_collectingSamples = false;
+
+				// one update per collected frame, like the synchronous mode, 
+				// but bounded so that new weights are published regularly.
+				m_learner->m_steps = ndMin(ndInt32(m_pendingTransitions.GetCount()), m_maxLearnerStepsPerPublish);
+				m_learner->Submit();
+			}
+			m_pendingTransitions.SetCount(0);
+		}
+	}
+	else
 	{
-		Optimize();
+		m_replayBuffer.AddTransition(m_currentTransition);
+		if (m_frameCount > m_replayBufferPrefill)
+		{
+			Optimize();
+		}
 	}
 
 	if (m_currentTransition.m_terminalState)
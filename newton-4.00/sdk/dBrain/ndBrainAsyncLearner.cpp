@@ -0,0 +1,80 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainAsyncLearner.h"
+
+ndBrainAsyncLearner::ndBrainAsyncLearner()
+	:ndThread()
+	,m_busy(false)
+	,m_passCount(0)
+{
+	SetName("ndBrainLearner");
+}
+
+ndBrainAsyncLearner::~ndBrainAsyncLearner()
+{
+	Sync();
+	Finish();
+}
+
+bool ndBrainAsyncLearner::IsBusy() const
+{
+	return m_busy.load();
+}
+
+ndInt32 ndBrainAsyncLearner::GetPassCount() const
+{
+	return m_passCount.load();
+}
+
+bool ndBrainAsyncLearner::Submit()
+{
+	if (m_busy.load())
+	{
+		return false;
+	}
+
+	#ifdef D_USE_THREAD_EMULATION
+		Learn();
+		m_passCount.fetch_add(1);
+	#else
+		m_busy.store(true);
+		Signal();
+	#endif
+	return true;
+}
+
+void ndBrainAsyncLearner::Sync() const
+{
+	while (m_busy.load())
+	{
+		ndThreadYield();
+	}
+}
+
+void ndBrainAsyncLearner::ThreadFunction()
+{
+	Learn();
+	m_passCount.fetch_add(1);
+	m_busy.store(false);
+}
@@ -0,0 +1,59 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_ASYNC_LEARNER_H__
+#define _ND_BRAIN_ASYNC_LEARNER_H__
+
+#include "ndBrainStdafx.h"
+
+// runs the optimization of an agent trainer on a background thread,
+// so that the simulation can keep collecting samples while it learns.
+// the owner submits a learning pass when the learner is idle, and the 
+// learner usually ends its pass by publishing an ndBrainSnapshot.
+// with thread emulation, the pass runs inline on the submitting thread.
+class ndBrainAsyncLearner: public ndThread
+{
+	public: 
+	ndBrainAsyncLearner();
+	virtual ~ndBrainAsyncLearner();
+
+	bool IsBusy() const;
+	ndInt32 GetPassCount() const;
+
+	// returns false, and does nothing, if the previous pass has not finished
+	bool Submit();
+
+	// waits for the current pass to finish.
+	// derived classes must call it from their destructor. 
+	void Sync() const;
+
+	protected:
+	virtual void Learn() = 0;
+
+	private:
+	virtual void ThreadFunction() override;
+
+	ndAtomic<bool> m_busy;
+	ndAtomic<ndInt32> m_passCount;
+};
+
+#endif 
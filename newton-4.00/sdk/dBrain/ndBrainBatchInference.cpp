@@ -0,0 +1,114 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainBatchInference.h"
+
+ndBrainBatchInference::ndBrainBatchInference(const ndBrain& brain)
+	:ndClassAlloc()
+	,m_inference(brain)
+	,m_clients()
+	,m_submitted()
+	,m_inputs()
+	,m_outputs()
+	,m_scratch()
+	,m_submittedCount(0)
+{
+}
+
+ndBrainBatchInference::~ndBrainBatchInference()
+{
+}
+
+void ndBrainBatchInference::AddClient(ndClient* const client)
+{
+	ndAssert(m_submittedCount.load() == 0);
+	#ifdef _DEBUG
+	for (ndInt32 i = 0; i < m_clients.GetCount(); ++i)
+	{
+		ndAssert(m_clients[i] != client);
+	}
+	#endif
+	m_clients.PushBack(client);
+
+	const ndInt32 count = ndInt32(m_clients.GetCount());
+	m_submitted.SetCount(count);
+	m_inputs.SetCount(count * m_inference.GetInputSize());
+	m_outputs.SetCount(count * m_inference.GetOutputSize());
+	m_scratch.SetCount(ndInt32(m_inference.GetBatchScratchSize(count)));
+}
+
+void ndBrainBatchInference::RemoveClient(ndClient* const client)
+{
+	ndAssert(m_submittedCount.load() == 0);
+	for (ndInt32 i = 0; i < m_clients.GetCount(); ++i)
+	{
+		if (m_clients[i] == client)
+		{
+			m_clients[i] = m_clients[m_clients.GetCount() - 1];
+			m_clients.SetCount(m_clients.GetCount() - 1);
+			break;
+		}
+	}
+}
+
+void ndBrainBatchInference::Submit(ndClient* const client, const ndBrainFloat* const observation)
+{
+	const ndInt32 index = m_submittedCount.fetch_add(1);
+	ndAssert(index < m_clients.GetCount());
+	const ndInt32 inputSize = m_inference.GetInputSize();
+	ndMemCpy(&m_inputs[index * inputSize], observation, inputSize);
+	m_submitted[index] = client;
+}
+
+void ndBrainBatchInference::Update(ndThreadPool& threadPool)
+{
+	const ndInt32 count = m_submittedCount.load();
+	if (!count)
+	{
+		return;
+	}
+
+	auto Evaluate = ndMakeObject::ndFunction([this, count](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(count, threadIndex, threadCount);
+		const ndInt32 rows = startEnd.m_end - startEnd.m_start;
+		if (rows > 0)
+		{
+			const ndInt32 inputSize = m_inference.GetInputSize();
+			const ndInt32 outputSize = m_inference.GetOutputSize();
+			m_inference.MakeBatchPrediction(
+				&m_inputs[startEnd.m_start * inputSize], inputSize,
+				&m_outputs[startEnd.m_start * outputSize], outputSize,
+				rows, &m_scratch[ndInt32(m_inference.GetBatchScratchSize(startEnd.m_start))]);
+
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				m_submitted[i]->ApplyActions(&m_outputs[i * outputSize]);
+			}
+		}
+	});
+	threadPool.ParallelExecute(Evaluate);
+	m_submittedCount.store(0);
+}
@@ -0,0 +1,100 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_BATCH_INFERENCE_H__
+#define _ND_BRAIN_BATCH_INFERENCE_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+#include "ndBrainInference.h"
+
+class ndBrain;
+
+// one evaluation of a trained brain for all the agents that run it.
+// during their update the agents submit their observations from any thread, 
+// later Update evaluates all the rows with one matrix product per layer, 
+// split over the threads of the pool, and hands the actions back to each agent.
+// a physics world runs it from an ndModelBatch, after the model updates 
+// and before the solver.
+class ndBrainBatchInference: public ndClassAlloc
+{
+	public: 
+	class ndClient
+	{
+		public:
+		virtual ~ndClient();
+		virtual void ApplyActions(const ndBrainFloat* const actions) = 0;
+	};
+
+	ndBrainBatchInference(const ndBrain& brain);
+	~ndBrainBatchInference();
+
+	ndInt32 GetInputSize() const;
+	ndInt32 GetOutputSize() const;
+	ndInt32 GetClientsCount() const;
+	ndInt32 GetSubmittedCount() const;
+
+	// clients reserve their row, they can not be added 
+	// or removed while observations are submitted.
+	void AddClient(ndClient* const client);
+	void RemoveClient(ndClient* const client);
+
+	// thread safe, a client submits at most one observation per update.
+	void Submit(ndClient* const client, const ndBrainFloat* const observation);
+
+	void Update(ndThreadPool& threadPool);
+
+	private:
+	ndBrainInference m_inference;
+	ndArray<ndClient*> m_clients;
+	ndArray<ndClient*> m_submitted;
+	ndBrainVector m_inputs;
+	ndBrainVector m_outputs;
+	ndBrainVector m_scratch;
+	ndAtomic<ndInt32> m_submittedCount;
+};
+
+inline ndBrainBatchInference::ndClient::~ndClient()
+{
+}
+
+inline ndInt32 ndBrainBatchInference::GetInputSize() const
+{
+	return m_inference.GetInputSize();
+}
+
+inline ndInt32 ndBrainBatchInference::GetOutputSize() const
+{
+	return m_inference.GetOutputSize();
+}
+
+inline ndInt32 ndBrainBatchInference::GetClientsCount() const
+{
+	return ndInt32(m_clients.GetCount());
+}
+
+inline ndInt32 ndBrainBatchInference::GetSubmittedCount() const
+{
+	return m_submittedCount.load();
+}
+
+#endif 
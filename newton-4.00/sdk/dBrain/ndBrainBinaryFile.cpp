@@ -0,0 +1,475 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainBinaryFile.h"
+#include "ndBrainLayerLinear.h"
+#include "ndBrainLayerReluActivation.h"
+#include "ndBrainLayerTanhActivation.h"
+#include "ndBrainLayerImagePolling_2x2.h"
+#include "ndBrainLayerConvolutional_2d.h"
+#include "ndBrainLayerSoftmaxActivation.h"
+#include "ndBrainLayerSigmoidActivation.h"
+#include "ndBrainLayerCrossCorrelation_2d.h"
+#include "ndBrainLayerLeakyReluActivation.h"
+#include "ndBrainLayerCategoricalSoftmaxActivation.h"
+
+#define D_BRAIN_BINARY_MAGIC		0x4e524244
+#define D_BRAIN_BINARY_VERSION		1
+#define D_BRAIN_BINARY_BYTE_ORDER	0x01020304
+#define D_BRAIN_BINARY_MAX_IMAGE_SIZE	(1<<12)
+
+class ndBrainBinaryHeader
+{
+	public:
+	ndBrainBinaryHeader()
+	{
+		// clear the padding too, the header is part of the hash
+		memset(this, 0, sizeof(ndBrainBinaryHeader));
+	}
+
+	bool IsValid(size_t fileSize) const
+	{
+		if ((m_magic != D_BRAIN_BINARY_MAGIC) || (m_version != D_BRAIN_BINARY_VERSION) || (m_byteOrder != D_BRAIN_BINARY_BYTE_ORDER) ||
+			(m_floatSize != sizeof(ndBrainFloat)) || (m_layerSize != sizeof(ndBrainBinaryFile::ndLayer)) || (m_fileSize != fileSize))
+		{
+			return false;
+		}
+		if ((m_layersCount <= 0) || (m_tableOffset & (D_BRAIN_BINARY_ALIGNMENT - 1)) || (m_tableOffset < sizeof(ndBrainBinaryHeader)) || (m_tableOffset > m_fileSize))
+		{
+			return false;
+		}
+		return ndUnsigned64(m_layersCount) * sizeof(ndBrainBinaryFile::ndLayer) <= (m_fileSize - m_tableOffset);
+	}
+
+	// same content hash as the polygon soup cache, 
+	// eight bytes at a time over the entire file.
+	static ndUnsigned64 HashBuffer(const void* const buffer, ndUnsigned64 size, ndUnsigned64 hash)
+	{
+		const ndUnsigned8* const data = (ndUnsigned8*)buffer;
+		for (ndUnsigned64 i = 0; i < size; i += sizeof(ndUnsigned64))
+		{
+			ndUnsigned64 word = 0;
+			memcpy(&word, &data[i], size_t(ndMin(size - i, ndUnsigned64(sizeof(ndUnsigned64)))));
+			hash ^= word * 0x9e3779b97f4a7c15ULL;
+			hash = ((hash << 31) | (hash >> 33)) * 0xbf58476d1ce4e5b9ULL;
+		}
+		hash ^= size;
+		hash ^= hash >> 29;
+		hash *= 0x94d049bb133111ebULL;
+		return hash ^ (hash >> 32);
+	}
+
+	ndUnsigned64 CalculateHash(const void* const file) const
+	{
+		ndBrainBinaryHeader header;
+		memcpy(&header, this, sizeof(ndBrainBinaryHeader));
+		header.m_hash = 0;
+		const ndUnsigned64 hash = HashBuffer(&header, sizeof(ndBrainBinaryHeader), 0);
+		return HashBuffer(&((ndUnsigned8*)file)[sizeof(ndBrainBinaryHeader)], m_fileSize - sizeof(ndBrainBinaryHeader), hash);
+	}
+
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndUnsigned32 m_byteOrder;
+	ndUnsigned32 m_floatSize;
+	ndUnsigned32 m_layerSize;
+	ndInt32 m_layersCount;
+	ndUnsigned64 m_tableOffset;
+	ndUnsigned64 m_fileSize;
+	ndUnsigned64 m_hash;
+};
+
+ndBrainBinaryFile::ndBrainBinaryFile()
+	:ndClassAlloc()
+	,m_file()
+	,m_layers(nullptr)
+	,m_layersCount(0)
+{
+}
+
+ndBrainBinaryFile::~ndBrainBinaryFile()
+{
+	Close();
+}
+
+void ndBrainBinaryFile::Close()
+{
+	m_file.Close();
+	m_layers = nullptr;
+	m_layersCount = 0;
+}
+
+bool ndBrainBinaryFile::IsBinaryFile(const char* const path)
+{
+	FILE* const file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+	ndUnsigned32 magic = 0;
+	const bool ok = fread(&magic, sizeof(magic), 1, file) == 1;
+	fclose(file);
+	return ok && (magic == D_BRAIN_BINARY_MAGIC);
+}
+
+bool ndBrainBinaryFile::Open(const char* const path, bool verify)
+{
+	Close();
+	if (!m_file.Open(path) || (m_file.GetSize() < sizeof(ndBrainBinaryHeader)))
+	{
+		m_file.Close();
+		return false;
+	}
+
+	const ndUnsigned8* const base = (ndUnsigned8*)m_file.GetData();
+	ndBrainBinaryHeader header;
+	memcpy(&header, base, sizeof(header));
+	if (!header.IsValid(m_file.GetSize()) || (verify && (header.CalculateHash(base) != header.m_hash)))
+	{
+		m_file.Close();
+		return false;
+	}
+
+	// the image sizes are checked before any layer is made from them, with 
+	// each one bounded, so that their products do not overflow 64 bits.
+	auto IsValidImage = [](const ndLayer& layer)
+	{
+		return (layer.m_width > 0) && (layer.m_width <= D_BRAIN_BINARY_MAX_IMAGE_SIZE) && 
+			(layer.m_height > 0) && (layer.m_height <= D_BRAIN_BINARY_MAX_IMAGE_SIZE) &&
+			(layer.m_channels > 0) && (layer.m_channels <= D_BRAIN_BINARY_MAX_IMAGE_SIZE) &&
+			((layer.m_layout == ndBrainConvolution::m_channelFirst) || (layer.m_layout == ndBrainConvolution::m_channelLast)) &&
+			(ndUnsigned64(layer.m_inputs) == ndUnsigned64(layer.m_width) * ndUnsigned64(layer.m_height) * ndUnsigned64(layer.m_channels));
+	};
+
+	// every blob must be inside the file, and the sizes must match the layer
+	const ndLayer* const layers = (ndLayer*)&base[header.m_tableOffset];
+	for (ndInt32 i = 0; i < header.m_layersCount; ++i)
+	{
+		const ndLayer& layer = layers[i];
+		const ndUnsigned64 offsets[] = { layer.m_biasOffset, layer.m_weightsOffset };
+		const ndUnsigned64 counts[] = { layer.m_biasCount, layer.m_weightsCount };
+		bool valid = (memchr(layer.m_labelId, 0, sizeof(layer.m_labelId)) != nullptr) && (layer.m_inputs > 0) && (layer.m_outputs > 0);
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			valid = valid && !(offsets[j] & (D_BRAIN_BINARY_ALIGNMENT - 1)) && (offsets[j] <= header.m_fileSize) && 
+				(counts[j] <= (header.m_fileSize - offsets[j]) / sizeof(ndBrainFloat));
+		}
+		if (!strcmp(layer.m_labelId, "ndBrainLayerLinear"))
+		{
+			valid = valid && (layer.m_stride >= layer.m_inputs) && (layer.m_biasCount == ndUnsigned64(layer.m_outputs)) && 
+				(layer.m_weightsCount == ndUnsigned64(layer.m_stride) * ndUnsigned64(layer.m_outputs));
+		}
+		else if (!strcmp(layer.m_labelId, "ndBrainLayerConvolutional_2d") || !strcmp(layer.m_labelId, "ndBrainLayerCrossCorrelation_2d"))
+		{
+			valid = valid && IsValidImage(layer) && (layer.m_kernelSize > 0) && (layer.m_kernelSize <= layer.m_width) && (layer.m_kernelSize <= layer.m_height) &&
+				(layer.m_filters > 0) && (layer.m_filters <= D_BRAIN_BINARY_MAX_IMAGE_SIZE);
+			if (valid)
+			{
+				const ndUnsigned64 kernelSize = ndUnsigned64(layer.m_kernelSize);
+				const ndUnsigned64 filters = ndUnsigned64(layer.m_filters);
+				const ndUnsigned64 outputSize = ndUnsigned64(layer.m_width - layer.m_kernelSize + 1) * ndUnsigned64(layer.m_height - layer.m_kernelSize + 1);
+				valid = (ndUnsigned64(layer.m_outputs) == outputSize * filters) && (layer.m_biasCount == filters) &&
+					(layer.m_weightsCount == filters * ndUnsigned64(layer.m_channels) * kernelSize * kernelSize);
+			}
+		}
+		else if (!strcmp(layer.m_labelId, "ndBrainLayerImagePolling_2x2"))
+		{
+			valid = valid && IsValidImage(layer) && 
+				(ndUnsigned64(layer.m_outputs) == ndUnsigned64((layer.m_width + 1) / 2) * ndUnsigned64((layer.m_height + 1) / 2) * ndUnsigned64(layer.m_channels));
+		}
+		if (!valid)
+		{
+			m_file.Close();
+			return false;
+		}
+	}
+
+	m_layers = layers;
+	m_layersCount = header.m_layersCount;
+	return true;
+}
+
+bool ndBrainBinaryFile::Save(const ndBrain* const brain, const char* const path)
+{
+	auto Align = [](ndUnsigned64 offset)
+	{
+		return (offset + D_BRAIN_BINARY_ALIGNMENT - 1) & ~ndUnsigned64(D_BRAIN_BINARY_ALIGNMENT - 1);
+	};
+
+	// first the table, the parameters of each layer and the layout of the blobs
+	ndBrainBinaryHeader header;
+	header.m_magic = D_BRAIN_BINARY_MAGIC;
+	header.m_version = D_BRAIN_BINARY_VERSION;
+	header.m_byteOrder = D_BRAIN_BINARY_BYTE_ORDER;
+	header.m_floatSize = sizeof(ndBrainFloat);
+	header.m_layerSize = sizeof(ndLayer);
+	header.m_layersCount = brain->GetCount();
+	header.m_tableOffset = Align(sizeof(ndBrainBinaryHeader));
+	if (!header.m_layersCount)
+	{
+		return false;
+	}
+
+	ndArray<ndLayer> table;
+	ndArray<const ndBrainFloat*> biasData;
+	ndArray<const ndBrainFloat*> weightsData;
+	ndUnsigned64 offset = header.m_tableOffset + ndUnsigned64(sizeof(ndLayer)) * ndUnsigned64(header.m_layersCount);
+	for (ndInt32 i = 0; i < brain->GetCount(); ++i)
+	{
+		ndBrainLayer* const srcLayer = (*brain)[i];
+		const char* const labelId = srcLayer->GetLabelId();
+
+		ndLayer layer;
+		memset(&layer, 0, sizeof(ndLayer));
+		ndAssert(strlen(labelId) < sizeof(layer.m_labelId));
+		strncpy(layer.m_labelId, labelId, sizeof(layer.m_labelId) - 1);
+		layer.m_inputs = srcLayer->GetInputSize();
+		layer.m_outputs = srcLayer->GetOutputSize();
+
+		const ndBrainFloat* bias = nullptr;
+		const ndBrainFloat* weights = nullptr;
+		if (!strcmp(labelId, "ndBrainLayerLinear"))
+		{
+			ndBrainLayerLinear* const linear = (ndBrainLayerLinear*)srcLayer;
+			layer.m_stride = (layer.m_inputs + D_BRAIN_BINARY_ROW_ALIGNMENT - 1) & -D_BRAIN_BINARY_ROW_ALIGNMENT;
+			layer.m_biasCount = ndUnsigned64(layer.m_outputs);
+			layer.m_weightsCount = ndUnsigned64(layer.m_stride) * ndUnsigned64(layer.m_outputs);
+			bias = &(*linear->GetBias())[0];
+			weights = &(*linear->GetWeights())[0][0];
+		}
+		else if (!strcmp(labelId, "ndBrainLayerConvolutional_2d"))
+		{
+			const ndBrainLayerConvolutional_2d* const convolution = (ndBrainLayerConvolutional_2d*)srcLayer;
+			layer.m_width = convolution->m_inputWidth;
+			layer.m_height = convolution->m_inputHeight;
+			layer.m_channels = convolution->m_inputLayers;
+			layer.m_kernelSize = convolution->m_kernelSize;
+			layer.m_filters = convolution->m_outputLayers;
+			layer.m_layout = ndInt32(convolution->GetLayout());
+			layer.m_biasCount = ndUnsigned64(convolution->m_bias.GetCount());
+			layer.m_weightsCount = ndUnsigned64(convolution->m_kernels.GetCount());
+			bias = &convolution->m_bias[0];
+			weights = &convolution->m_kernels[0];
+		}
+		else if (!strcmp(labelId, "ndBrainLayerCrossCorrelation_2d"))
+		{
+			const ndBrainLayerCrossCorrelation_2d* const convolution = (ndBrainLayerCrossCorrelation_2d*)srcLayer;
+			layer.m_width = convolution->m_inputWidth;
+			layer.m_height = convolution->m_inputHeight;
+			layer.m_channels = convolution->m_inputLayers;
+			layer.m_kernelSize = convolution->m_kernelSize;
+			layer.m_filters = convolution->m_outputLayers;
+			layer.m_layout = ndInt32(convolution->GetLayout());
+			layer.m_biasCount = ndUnsigned64(convolution->m_bias.GetCount());
+			layer.m_weightsCount = ndUnsigned64(convolution->m_kernels.GetCount());
+			bias = &convolution->m_bias[0];
+			weights = &convolution->m_kernels[0];
+		}
+		else if (!strcmp(labelId, "ndBrainLayerImagePolling_2x2"))
+		{
+			const ndBrainLayerImagePolling_2x2* const pooling = (ndBrainLayerImagePolling_2x2*)srcLayer;
+			layer.m_width = pooling->GetInputWidth();
+			layer.m_height = pooling->GetInputHeight();
+			layer.m_channels = pooling->GetInputChannels();
+			layer.m_layout = ndInt32(pooling->GetLayout());
+		}
+		else if (!strcmp(labelId, "ndBrainLayerLeakyReluActivation"))
+		{
+			layer.m_leakDerivative = ndReal(((ndBrainLayerLeakyReluActivation*)srcLayer)->m_leakDerivative);
+		}
+		else if (strcmp(labelId, "ndBrainLayerReluActivation") && strcmp(labelId, "ndBrainLayerTanhActivation") && 
+				 strcmp(labelId, "ndBrainLayerApproximateTanhActivation") && strcmp(labelId, "ndBrainLayerSigmoidActivation") && 
+				 strcmp(labelId, "ndBrainLayerSoftmaxActivation") && strcmp(labelId, "ndBrainLayerCategoricalSoftmaxActivation"))
+		{
+			// the same layers as the text files
+			ndTrace(("layer %s can not be saved\n", labelId));
+			return false;
+		}
+
+		if (layer.m_biasCount)
+		{
+			offset = Align(offset);
+			layer.m_biasOffset = offset;
+			offset += layer.m_biasCount * sizeof(ndBrainFloat);
+		}
+		if (layer.m_weightsCount)
+		{
+			offset = Align(offset);
+			layer.m_weightsOffset = offset;
+			offset += layer.m_weightsCount * sizeof(ndBrainFloat);
+		}
+		table.PushBack(layer);
+		biasData.PushBack(bias);
+		weightsData.PushBack(weights);
+	}
+	header.m_fileSize = offset;
+
+	// the whole file is assembled in memory, so that it can be hashed
+	ndArray<ndUnsigned8> buffer;
+	buffer.SetCount(ndInt32(header.m_fileSize));
+	ndMemSet(&buffer[0], ndUnsigned8(0), buffer.GetCount());
+	memcpy(&buffer[ndInt32(header.m_tableOffset)], &table[0], sizeof(ndLayer) * size_t(table.GetCount()));
+	for (ndInt32 i = 0; i < table.GetCount(); ++i)
+	{
+		const ndLayer& layer = table[i];
+		if (layer.m_biasCount)
+		{
+			memcpy(&buffer[ndInt32(layer.m_biasOffset)], biasData[i], size_t(layer.m_biasCount * sizeof(ndBrainFloat)));
+		}
+		if (layer.m_stride)
+		{
+			// the rows of a linear layer are padded
+			ndBrainLayerLinear* const linear = (ndBrainLayerLinear*)(*brain)[i];
+			const ndBrainMatrix& weights = *linear->GetWeights();
+			for (ndInt32 j = 0; j < layer.m_outputs; ++j)
+			{
+				const ndUnsigned64 rowOffset = layer.m_weightsOffset + ndUnsigned64(j) * ndUnsigned64(layer.m_stride) * sizeof(ndBrainFloat);
+				memcpy(&buffer[ndInt32(rowOffset)], &weights[j][0], size_t(layer.m_inputs) * sizeof(ndBrainFloat));
+			}
+		}
+		else if (layer.m_weightsCount)
+		{
+			memcpy(&buffer[ndInt32(layer.m_weightsOffset)], weightsData[i], size_t(layer.m_weightsCount * sizeof(ndBrainFloat)));
+		}
+	}
+	memcpy(&buffer[0], &header, sizeof(header));
+	header.m_hash = header.CalculateHash(&buffer[0]);
+	memcpy(&buffer[0], &header, sizeof(header));
+
+	FILE* const file = fopen(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+	const bool ok = fwrite(&buffer[0], size_t(buffer.GetCount()), 1, file) == 1;
+	fclose(file);
+	return ok;
+}
+
+ndBrainLayer* ndBrainBinaryFile::CreateLayer(ndInt32 index) const
+{
+	const ndLayer& layer = GetLayer(index);
+	const char* const labelId = layer.m_labelId;
+	const ndBrainFloat* const bias = GetBias(index);
+	const ndBrainFloat* const weights = GetWeights(index);
+
+	ndBrainLayer* dstLayer = nullptr;
+	if (!strcmp(labelId, "ndBrainLayerLinear"))
+	{
+		ndBrainLayerLinear* const linear = new ndBrainLayerLinear(layer.m_inputs, layer.m_outputs);
+		ndMemCpy(&(*linear->GetBias())[0], bias, layer.m_outputs);
+		ndBrainMatrix& matrix = *linear->GetWeights();
+		for (ndInt32 i = 0; i < layer.m_outputs; ++i)
+		{
+			ndMemCpy(&matrix[i][0], &weights[i * layer.m_stride], layer.m_inputs);
+		}
+		dstLayer = linear;
+	}
+	else if (!strcmp(labelId, "ndBrainLayerConvolutional_2d"))
+	{
+		ndBrainLayerConvolutional_2d* const convolution = new ndBrainLayerConvolutional_2d(
+			layer.m_width, layer.m_height, layer.m_channels, layer.m_kernelSize, layer.m_filters, ndBrainConvolution::ndLayout(layer.m_layout));
+		if ((ndUnsigned64(convolution->m_bias.GetCount()) != layer.m_biasCount) || (ndUnsigned64(convolution->m_kernels.GetCount()) != layer.m_weightsCount))
+		{
+			delete convolution;
+			return nullptr;
+		}
+		ndMemCpy(&convolution->m_bias[0], bias, convolution->m_bias.GetCount());
+		ndMemCpy(&convolution->m_kernels[0], weights, convolution->m_kernels.GetCount());
+		dstLayer = convolution;
+	}
+	else if (!strcmp(labelId, "ndBrainLayerCrossCorrelation_2d"))
+	{
+		ndBrainLayerCrossCorrelation_2d* const convolution = new ndBrainLayerCrossCorrelation_2d(
+			layer.m_width, layer.m_height, layer.m_channels, layer.m_kernelSize, layer.m_filters, ndBrainConvolution::ndLayout(layer.m_layout));
+		if ((ndUnsigned64(convolution->m_bias.GetCount()) != layer.m_biasCount) || (ndUnsigned64(convolution->m_kernels.GetCount()) != layer.m_weightsCount))
+		{
+			delete convolution;
+			return nullptr;
+		}
+		ndMemCpy(&convolution->m_bias[0], bias, convolution->m_bias.GetCount());
+		ndMemCpy(&convolution->m_kernels[0], weights, convolution->m_kernels.GetCount());
+		dstLayer = convolution;
+	}
+	else if (!strcmp(labelId, "ndBrainLayerImagePolling_2x2"))
+	{
+		dstLayer = new ndBrainLayerImagePolling_2x2(layer.m_width, layer.m_height, layer.m_channels, ndBrainConvolution::ndLayout(layer.m_layout));
+	}
+	else if (!strcmp(labelId, "ndBrainLayerLeakyReluActivation"))
+	{
+		dstLayer = new ndBrainLayerLeakyReluActivation(layer.m_inputs, ndBrainFloat(layer.m_leakDerivative));
+	}
+	else if (!strcmp(labelId, "ndBrainLayerReluActivation"))
+	{
+		dstLayer = new ndBrainLayerReluActivation(layer.m_inputs);
+	}
+	else if (!strcmp(labelId, "ndBrainLayerTanhActivation"))
+	{
+		dstLayer = new ndBrainLayerTanhActivation(layer.m_inputs);
+	}
+	else if (!strcmp(labelId, "ndBrainLayerApproximateTanhActivation"))
+	{
+		dstLayer = new ndBrainLayerApproximateTanhActivation(layer.m_inputs);
+	}
+	else if (!strcmp(labelId, "ndBrainLayerSigmoidActivation"))
+	{
+		dstLayer = new ndBrainLayerSigmoidActivation(layer.m_inputs);
+	}
+	else if (!strcmp(labelId, "ndBrainLayerSoftmaxActivation"))
+	{
+		dstLayer = new ndBrainLayerSoftmaxActivation(layer.m_inputs);
+	}
+	else if (!strcmp(labelId, "ndBrainLayerCategoricalSoftmaxActivation"))
+	{
+		dstLayer = new ndBrainLayerCategoricalSoftmaxActivation(layer.m_inputs);
+	}
+
+	if (dstLayer && ((dstLayer->GetInputSize() != layer.m_inputs) || (dstLayer->GetOutputSize() != layer.m_outputs)))
+	{
+		delete dstLayer;
+		dstLayer = nullptr;
+	}
+	return dstLayer;
+}
+
+ndBrain* ndBrainBinaryFile::CreateBrain() const
+{
+	if (!IsOpen())
+	{
+		return nullptr;
+	}
+
+	ndBrain* const brain = new ndBrain;
+	for (ndInt32 i = 0; i < m_layersCount; ++i)
+	{
+		ndBrainLayer* const layer = CreateLayer(i);
+		if (!layer)
+		{
+			delete brain;
+			return nullptr;
+		}
+		brain->AddLayer(layer);
+	}
+	return brain;
+}
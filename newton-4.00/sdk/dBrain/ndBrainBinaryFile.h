@@ -0,0 +1,124 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_BINARY_FILE_H__
+#define _ND_BRAIN_BINARY_FILE_H__
+
+#include "ndBrainStdafx.h"
+
+#define D_BRAIN_BINARY_ALIGNMENT	64
+#define D_BRAIN_BINARY_ROW_ALIGNMENT	8
+
+class ndBrain;
+class ndBrainLayer;
+
+// binary brain files, a header, a table with one entry per layer, 
+// and the bias and weights of each layer in 64 bytes aligned blocks 
+// of little endian floats. the rows of linear layer weights are padded 
+// to eight floats, so the file can be mapped and evaluated in place.
+// a content hash of the whole file detects truncated or damaged files.
+class ndBrainBinaryFile: public ndClassAlloc
+{
+	public:
+	class ndLayer
+	{
+		public:
+		char m_labelId[64];
+		ndInt32 m_inputs;
+		ndInt32 m_outputs;
+		ndInt32 m_width;
+		ndInt32 m_height;
+		ndInt32 m_channels;
+		ndInt32 m_kernelSize;
+		ndInt32 m_filters;
+		ndInt32 m_layout;
+		ndInt32 m_stride;
+		ndReal m_leakDerivative;
+		ndUnsigned64 m_biasOffset;
+		ndUnsigned64 m_biasCount;
+		ndUnsigned64 m_weightsOffset;
+		ndUnsigned64 m_weightsCount;
+	};
+
+	ndBrainBinaryFile();
+	~ndBrainBinaryFile();
+
+	// maps the file, returns false if it is not a valid brain binary file.
+	bool Open(const char* const path, bool verify = true);
+	void Close();
+
+	bool IsOpen() const;
+	ndInt32 GetLayersCount() const;
+	const ndLayer& GetLayer(ndInt32 index) const;
+
+	// pointers to the mapped memory, valid until the file is closed.
+	const ndBrainFloat* GetData() const;
+	const ndBrainFloat* GetBias(ndInt32 index) const;
+	const ndBrainFloat* GetWeights(ndInt32 index) const;
+
+	ndBrain* CreateBrain() const;
+	ndBrainLayer* CreateLayer(ndInt32 index) const;
+
+	static bool IsBinaryFile(const char* const path);
+	static bool Save(const ndBrain* const brain, const char* const path);
+
+	private:
+	ndMemoryMappedFile m_file;
+	const ndLayer* m_layers;
+	ndInt32 m_layersCount;
+};
+
+inline bool ndBrainBinaryFile::IsOpen() const
+{
+	return m_layers ? true : false;
+}
+
+inline ndInt32 ndBrainBinaryFile::GetLayersCount() const
+{
+	return m_layersCount;
+}
+
+inline const ndBrainBinaryFile::ndLayer& ndBrainBinaryFile::GetLayer(ndInt32 index) const
+{
+	ndAssert(index >= 0);
+	ndAssert(index < m_layersCount);
+	return m_layers[index];
+}
+
+inline const ndBrainFloat* ndBrainBinaryFile::GetData() const
+{
+	return (ndBrainFloat*)m_file.GetData();
+}
+
+inline const ndBrainFloat* ndBrainBinaryFile::GetBias(ndInt32 index) const
+{
+	const ndLayer& layer = GetLayer(index);
+	return layer.m_biasCount ? &GetData()[layer.m_biasOffset / sizeof(ndBrainFloat)] : nullptr;
+}
+
+inline const ndBrainFloat* ndBrainBinaryFile::GetWeights(ndInt32 index) const
+{
+	const ndLayer& layer = GetLayer(index);
+	return layer.m_weightsCount ? &GetData()[layer.m_weightsOffset / sizeof(ndBrainFloat)] : nullptr;
+}
+
+#endif 
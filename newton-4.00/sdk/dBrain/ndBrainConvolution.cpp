@@ -0,0 +1,768 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainMatrix.h"
+#include "ndBrainKernels.h"
+#include "ndBrainThreadPool.h"
+#include "ndBrainConvolution.h"
+
+// with fewer input channels the winograd products are too 
+// shallow to pay for the transforms, and im2col is faster.
+#define D_BRAIN_WINOGRAD_MIN_CHANNELS	8
+
+template <typename Function>
+static void ndBrainConvolutionExecute(ndBrainThreadPool* const threadPool, const Function& function)
+{
+	if (threadPool)
+	{
+		threadPool->ParallelExecute(function);
+	}
+	else
+	{
+		function(0, 1);
+	}
+}
+
+ndBrainConvolution::ndBrainConvolution(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputChannels, ndInt32 kernelSize, ndInt32 outputChannels, bool flipKernels, ndLayout layout)
+	:m_inputWidth(inputWidth)
+	,m_inputHeight(inputHeight)
+	,m_inputChannels(inputChannels)
+	,m_kernelSize(kernelSize)
+	,m_outputWidth(inputWidth - kernelSize + 1)
+	,m_outputHeight(inputHeight - kernelSize + 1)
+	,m_outputChannels(outputChannels)
+	,m_layout(layout)
+	,m_flipKernels(flipKernels)
+{
+	ndAssert(m_outputWidth > 0);
+	ndAssert(m_outputHeight > 0);
+}
+
+ndBrainConvolution::ndLayout ndBrainConvolution::GetLayout() const
+{
+	return m_layout;
+}
+
+bool ndBrainConvolution::UseWinograd() const
+{
+	return (m_kernelSize == 3) && (m_inputChannels >= D_BRAIN_WINOGRAD_MIN_CHANNELS);
+}
+
+bool ndBrainConvolution::PackKernels() const
+{
+	// the products read the kernels in the order of the unrolled patches
+	return m_flipKernels || (m_layout == m_channelLast);
+}
+
+ndInt32 ndBrainConvolution::GetTileCount() const
+{
+	return ((m_outputWidth + 1) / 2) * ((m_outputHeight + 1) / 2);
+}
+
+ndInt32 ndBrainConvolution::GetInputGradientRows() const
+{
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	return (m_layout == m_channelFirst) ? patchSize : outputSize;
+}
+
+ndInt32 ndBrainConvolution::GetLoweredSize() const
+{
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	const ndInt32 winogradSize = UseWinograd() ? 16 * m_inputChannels * GetTileCount() : 0;
+	return ndMax(patchSize * outputSize, winogradSize);
+}
+
+ndInt32 ndBrainConvolution::GetSharedScratchSize() const
+{
+	// the packed kernels, and their winograd transform
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	const ndInt32 winogradSize = UseWinograd() ? 16 * m_outputChannels * m_inputChannels : 0;
+	return m_outputChannels * patchSize + winogradSize;
+}
+
+ndInt32 ndBrainConvolution::GetThreadScratchSize() const
+{
+	// the unrolled input, the winograd products, and the kernel and bias gradients
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	const ndInt32 productSize = UseWinograd() ? 16 * m_outputChannels * GetTileCount() : 0;
+	return GetLoweredSize() + productSize + m_outputChannels * patchSize + m_outputChannels;
+}
+
+ndInt32 ndBrainConvolution::GetScratchSize() const
+{
+	return GetSharedScratchSize() + GetThreadScratchSize();
+}
+
+void ndBrainConvolution::PrepareKernels(const ndBrainFloat* const kernels, ndBrainFloat* const shared) const
+{
+	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
+	const ndInt32 patchSize = m_inputChannels * kernelSize;
+	if (PackKernels())
+	{
+		for (ndInt32 o = 0; o < m_outputChannels; ++o)
+		{
+			ndBrainFloat* const dst = &shared[o * patchSize];
+			for (ndInt32 c = 0; c < m_inputChannels; ++c)
+			{
+				const ndBrainFloat* const src = &kernels[(o * m_inputChannels + c) * kernelSize];
+				for (ndInt32 j = 0; j < kernelSize; ++j)
+				{
+					const ndInt32 index = (m_layout == m_channelFirst) ? c * kernelSize + j : j * m_inputChannels + c;
+					dst[index] = src[m_flipKernels ? kernelSize - 1 - j : j];
+				}
+			}
+		}
+	}
+
+	if (UseWinograd())
+	{
+		WinogradKernels(kernels, &shared[m_outputChannels * patchSize]);
+	}
+}
+
+void ndBrainConvolution::UnpackKernelGradients(const ndBrainFloat* const packedGradients, ndBrainFloat* const kernelGradients, ndInt32 o0, ndInt32 o1) const
+{
+	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
+	const ndInt32 patchSize = m_inputChannels * kernelSize;
+	for (ndInt32 o = o0; o < o1; ++o)
+	{
+		const ndBrainFloat* const src = &packedGradients[o * patchSize];
+		for (ndInt32 c = 0; c < m_inputChannels; ++c)
+		{
+			ndBrainFloat* const dst = &kernelGradients[(o * m_inputChannels + c) * kernelSize];
+			for (ndInt32 j = 0; j < kernelSize; ++j)
+			{
+				const ndInt32 index = (m_layout == m_channelFirst) ? c * kernelSize + j : j * m_inputChannels + c;
+				dst[m_flipKernels ? kernelSize - 1 - j : j] += src[index];
+			}
+		}
+	}
+}
+
+void ndBrainConvolution::Im2col(const ndBrainFloat* const input, ndBrainFloat* const col, ndInt32 c0, ndInt32 c1) const
+{
+	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	if (m_layout == m_channelFirst)
+	{
+		// col[(c * kernelSize + j) * outputSize + p]
+		const ndInt32 inputSize = m_inputWidth * m_inputHeight;
+		for (ndInt32 c = c0; c < c1; ++c)
+		{
+			for (ndInt32 j = 0; j < kernelSize; ++j)
+			{
+				const ndInt32 ky = j / m_kernelSize;
+				const ndInt32 kx = j - ky * m_kernelSize;
+				ndBrainFloat* const dst = &col[(c * kernelSize + j) * outputSize];
+				const ndBrainFloat* const src = &input[c * inputSize + ky * m_inputWidth + kx];
+				for (ndInt32 y = 0; y < m_outputHeight; ++y)
+				{
+					for (ndInt32 x = 0; x < m_outputWidth; ++x)
+					{
+						dst[y * m_outputWidth + x] = src[y * m_inputWidth + x];
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		// col[p * patchSize + j * channels + c]
+		const ndInt32 count = c1 - c0;
+		const ndInt32 patchSize = m_inputChannels * kernelSize;
+		for (ndInt32 y = 0; y < m_outputHeight; ++y)
+		{
+			for (ndInt32 x = 0; x < m_outputWidth; ++x)
+			{
+				ndBrainFloat* const dst = &col[(y * m_outputWidth + x) * patchSize + c0];
+				for (ndInt32 j = 0; j < kernelSize; ++j)
+				{
+					const ndInt32 ky = j / m_kernelSize;
+					const ndInt32 kx = j - ky * m_kernelSize;
+					const ndBrainFloat* const src = &input[((y + ky) * m_inputWidth + x + kx) * m_inputChannels + c0];
+					for (ndInt32 c = 0; c < count; ++c)
+					{
+						dst[j * m_inputChannels + c] = src[c];
+					}
+				}
+			}
+		}
+	}
+}
+
+void ndBrainConvolution::Col2im(const ndBrainFloat* const col, ndBrainFloat* const inputGradient, ndInt32 c0, ndInt32 c1) const
+{
+	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
+	if (m_layout == m_channelFirst)
+	{
+		for (ndInt32 c = c0; c < c1; ++c)
+		{
+			ndBrainFloat* const plane = &inputGradient[c * inputSize];
+			for (ndInt32 i = 0; i < inputSize; ++i)
+			{
+				plane[i] = ndBrainFloat(0.0f);
+			}
+			for (ndInt32 j = 0; j < kernelSize; ++j)
+			{
+				const ndInt32 ky = j / m_kernelSize;
+				const ndInt32 kx = j - ky * m_kernelSize;
+				const ndBrainFloat* const src = &col[(c * kernelSize + j) * outputSize];
+				ndBrainFloat* const dst = &plane[ky * m_inputWidth + kx];
+				for (ndInt32 y = 0; y < m_outputHeight; ++y)
+				{
+					for (ndInt32 x = 0; x < m_outputWidth; ++x)
+					{
+						dst[y * m_inputWidth + x] += src[y * m_outputWidth + x];
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		const ndInt32 count = c1 - c0;
+		const ndInt32 patchSize = m_inputChannels * kernelSize;
+		for (ndInt32 i = 0; i < inputSize; ++i)
+		{
+			ndBrainFloat* const dst = &inputGradient[i * m_inputChannels + c0];
+			for (ndInt32 c = 0; c < count; ++c)
+			{
+				dst[c] = ndBrainFloat(0.0f);
+			}
+		}
+		for (ndInt32 y = 0; y < m_outputHeight; ++y)
+		{
+			for (ndInt32 x = 0; x < m_outputWidth; ++x)
+			{
+				const ndBrainFloat* const src = &col[(y * m_outputWidth + x) * patchSize + c0];
+				for (ndInt32 j = 0; j < kernelSize; ++j)
+				{
+					const ndInt32 ky = j / m_kernelSize;
+					const ndInt32 kx = j - ky * m_kernelSize;
+					ndBrainFloat* const dst = &inputGradient[((y + ky) * m_inputWidth + x + kx) * m_inputChannels + c0];
+					for (ndInt32 c = 0; c < count; ++c)
+					{
+						dst[c] += src[j * m_inputChannels + c];
+					}
+				}
+			}
+		}
+	}
+}
+
+void ndBrainConvolution::ForwardProduct(const ndBrainFloat* const packedKernels, const ndBrainFloat* const bias, ndBrainFloat biasScale, const ndBrainFloat* const col, ndBrainFloat* const output, ndInt32 o0, ndInt32 o1) const
+{
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	if (m_layout == m_channelFirst)
+	{
+		// output(o, p) = kernels(o, r) * col(r, p)
+		for (ndInt32 o = o0; o < o1; ++o)
+		{
+			const ndBrainFloat value = bias[o] * biasScale;
+			ndBrainFloat* const dst = &output[o * outputSize];
+			for (ndInt32 p = 0; p < outputSize; ++p)
+			{
+				dst[p] = value;
+			}
+		}
+		ndBrainKernels::Gemm(o1 - o0, outputSize, patchSize, &packedKernels[o0 * patchSize], patchSize, 1, col, outputSize, 1, &output[o0 * outputSize], outputSize);
+	}
+	else
+	{
+		// output(p, o) = col(p, r) * transpose(kernels(o, r))
+		for (ndInt32 p = 0; p < outputSize; ++p)
+		{
+			ndBrainFloat* const dst = &output[p * m_outputChannels];
+			for (ndInt32 o = o0; o < o1; ++o)
+			{
+				dst[o] = bias[o] * biasScale;
+			}
+		}
+		ndBrainKernels::Gemm(outputSize, o1 - o0, patchSize, col, patchSize, 1, &packedKernels[o0 * patchSize], 1, patchSize, &output[o0], m_outputChannels);
+	}
+}
+
+void ndBrainConvolution::KernelGradientProduct(const ndBrainFloat* const outputDerivative, const ndBrainFloat* const col, ndBrainFloat* const packedGradients, ndBrainFloat* const biasGradients, ndInt32 o0, ndInt32 o1) const
+{
+	// kernelGradients(o, r) += outputDerivative(o, p) * transpose(col(r, p))
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	if (m_layout == m_channelFirst)
+	{
+		for (ndInt32 o = o0; o < o1; ++o)
+		{
+			ndBrainFloat sum = ndBrainFloat(0.0f);
+			const ndBrainFloat* const src = &outputDerivative[o * outputSize];
+			for (ndInt32 p = 0; p < outputSize; ++p)
+			{
+				sum += src[p];
+			}
+			biasGradients[o] += sum;
+		}
+		ndBrainKernels::Gemm(o1 - o0, patchSize, outputSize, &outputDerivative[o0 * outputSize], outputSize, 1, col, 1, outputSize, &packedGradients[o0 * patchSize], patchSize);
+	}
+	else
+	{
+		for (ndInt32 p = 0; p < outputSize; ++p)
+		{
+			const ndBrainFloat* const src = &outputDerivative[p * m_outputChannels];
+			for (ndInt32 o = o0; o < o1; ++o)
+			{
+				biasGradients[o] += src[o];
+			}
+		}
+		ndBrainKernels::Gemm(o1 - o0, patchSize, outputSize, &outputDerivative[o0], 1, m_outputChannels, col, patchSize, 1, &packedGradients[o0 * patchSize], patchSize);
+	}
+}
+
+void ndBrainConvolution::InputGradientProduct(const ndBrainFloat* const packedKernels, const ndBrainFloat* const outputDerivative, ndBrainFloat* const col, ndInt32 r0, ndInt32 r1) const
+{
+	// col(r, p) = transpose(kernels(o, r)) * outputDerivative(o, p), 
+	// the rows are the patch entries for channel first, and the pixels for channel last.
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	const ndInt32 stride = (m_layout == m_channelFirst) ? outputSize : patchSize;
+	for (ndInt32 i = r0 * stride; i < r1 * stride; ++i)
+	{
+		col[i] = ndBrainFloat(0.0f);
+	}
+
+	if (m_layout == m_channelFirst)
+	{
+		ndBrainKernels::Gemm(r1 - r0, outputSize, m_outputChannels, &packedKernels[r0], 1, patchSize, outputDerivative, outputSize, 1, &col[r0 * outputSize], outputSize);
+	}
+	else
+	{
+		ndBrainKernels::Gemm(r1 - r0, patchSize, m_outputChannels, &outputDerivative[r0 * m_outputChannels], m_outputChannels, 1, packedKernels, patchSize, 1, &col[r0 * patchSize], patchSize);
+	}
+}
+
+void ndBrainConvolution::WinogradKernels(const ndBrainFloat* const kernels, ndBrainFloat* const transform) const
+{
+	// transform[n][o][c] = (G * g * transpose(G))[n]
+	const ndBrainFloat half = ndBrainFloat(0.5f);
+	const ndInt32 stride = m_outputChannels * m_inputChannels;
+	for (ndInt32 o = 0; o < m_outputChannels; ++o)
+	{
+		for (ndInt32 c = 0; c < m_inputChannels; ++c)
+		{
+			ndBrainFloat g[3][3];
+			const ndBrainFloat* const src = &kernels[(o * m_inputChannels + c) * 9];
+			for (ndInt32 i = 0; i < 9; ++i)
+			{
+				g[i / 3][i % 3] = src[m_flipKernels ? 8 - i : i];
+			}
+
+			ndBrainFloat gg[4][3];
+			for (ndInt32 k = 0; k < 3; ++k)
+			{
+				gg[0][k] = g[0][k];
+				gg[1][k] = half * (g[0][k] + g[1][k] + g[2][k]);
+				gg[2][k] = half * (g[0][k] - g[1][k] + g[2][k]);
+				gg[3][k] = g[2][k];
+			}
+
+			const ndInt32 index = o * m_inputChannels + c;
+			for (ndInt32 i = 0; i < 4; ++i)
+			{
+				transform[(i * 4 + 0) * stride + index] = gg[i][0];
+				transform[(i * 4 + 1) * stride + index] = half * (gg[i][0] + gg[i][1] + gg[i][2]);
+				transform[(i * 4 + 2) * stride + index] = half * (gg[i][0] - gg[i][1] + gg[i][2]);
+				transform[(i * 4 + 3) * stride + index] = gg[i][2];
+			}
+		}
+	}
+}
+
+void ndBrainConvolution::WinogradInput(const ndBrainFloat* const input, ndBrainFloat* const transform, ndInt32 c0, ndInt32 c1) const
+{
+	// transform[n][c][t] = (transpose(B) * d * B)[n], where d is the 4 x 4 input 
+	// tile of output tile t, the pixels past the edge of the image read as zero.
+	const ndInt32 tilesX = (m_outputWidth + 1) / 2;
+	const ndInt32 tilesY = (m_outputHeight + 1) / 2;
+	const ndInt32 tileCount = tilesX * tilesY;
+	const ndInt32 stride = m_inputChannels * tileCount;
+
+	const bool channelFirst = (m_layout == m_channelFirst);
+	const ndInt32 channelStride = channelFirst ? m_inputWidth * m_inputHeight : 1;
+	const ndInt32 pixelStride = channelFirst ? 1 : m_inputChannels;
+	const ndInt32 rowStride = m_inputWidth * pixelStride;
+
+	for (ndInt32 c = c0; c < c1; ++c)
+	{
+		const ndBrainFloat* const src = &input[c * channelStride];
+		for (ndInt32 ty = 0; ty < tilesY; ++ty)
+		{
+			for (ndInt32 tx = 0; tx < tilesX; ++tx)
+			{
+				ndBrainFloat d[4][4];
+				for (ndInt32 i = 0; i < 4; ++i)
+				{
+					const ndInt32 y = ty * 2 + i;
+					for (ndInt32 j = 0; j < 4; ++j)
+					{
+						const ndInt32 x = tx * 2 + j;
+						d[i][j] = ((y < m_inputHeight) && (x < m_inputWidth)) ? src[y * rowStride + x * pixelStride] : ndBrainFloat(0.0f);
+					}
+				}
+
+				ndBrainFloat e[4][4];
+				for (ndInt32 j = 0; j < 4; ++j)
+				{
+					e[0][j] = d[0][j] - d[2][j];
+					e[1][j] = d[1][j] + d[2][j];
+					e[2][j] = d[2][j] - d[1][j];
+					e[3][j] = d[1][j] - d[3][j];
+				}
+
+				const ndInt32 index = c * tileCount + ty * tilesX + tx;
+				for (ndInt32 i = 0; i < 4; ++i)
+				{
+					transform[(i * 4 + 0) * stride + index] = e[i][0] - e[i][2];
+					transform[(i * 4 + 1) * stride + index] = e[i][1] + e[i][2];
+					transform[(i * 4 + 2) * stride + index] = e[i][2] - e[i][1];
+					transform[(i * 4 + 3) * stride + index] = e[i][1] - e[i][3];
+				}
+			}
+		}
+	}
+}
+
+void ndBrainConvolution::WinogradProduct(const ndBrainFloat* const kernelTransform, const ndBrainFloat* const inputTransform, const ndBrainFloat* const bias, ndBrainFloat biasScale, ndBrainFloat* const product, ndBrainFloat* const output, ndInt32 o0, ndInt32 o1) const
+{
+	// the sixteen products m[n](o, t) = kernels[n](o, c) * input[n](c, t), 
+	// followed by the output transform y = transpose(A) * m * A.
+	const ndInt32 rows = o1 - o0;
+	const ndInt32 tilesX = (m_outputWidth + 1) / 2;
+	const ndInt32 tilesY = (m_outputHeight + 1) / 2;
+	const ndInt32 tileCount = tilesX * tilesY;
+	const ndInt32 kernelStride = m_outputChannels * m_inputChannels;
+	const ndInt32 inputStride = m_inputChannels * tileCount;
+	const ndInt32 productStride = rows * tileCount;
+
+	for (ndInt32 i = 16 * productStride - 1; i >= 0; --i)
+	{
+		product[i] = ndBrainFloat(0.0f);
+	}
+	for (ndInt32 n = 0; n < 16; ++n)
+	{
+		ndBrainKernels::Gemm(
+			rows, tileCount, m_inputChannels, 
+			&kernelTransform[n * kernelStride + o0 * m_inputChannels], m_inputChannels, 1, 
+			&inputTransform[n * inputStride], tileCount, 1, &product[n * productStride], tileCount);
+	}
+
+	const bool channelFirst = (m_layout == m_channelFirst);
+	const ndInt32 channelStride = channelFirst ? m_outputWidth * m_outputHeight : 1;
+	const ndInt32 pixelStride = channelFirst ? 1 : m_outputChannels;
+	const ndInt32 rowStride = m_outputWidth * pixelStride;
+	for (ndInt32 o = o0; o < o1; ++o)
+	{
+		const ndBrainFloat value = bias[o] * biasScale;
+		ndBrainFloat* const dst = &output[o * channelStride];
+		const ndBrainFloat* const src = &product[(o - o0) * tileCount];
+		for (ndInt32 ty = 0; ty < tilesY; ++ty)
+		{
+			for (ndInt32 tx = 0; tx < tilesX; ++tx)
+			{
+				ndBrainFloat m[4][4];
+				const ndInt32 index = ty * tilesX + tx;
+				for (ndInt32 n = 0; n < 16; ++n)
+				{
+					m[n / 4][n % 4] = src[n * productStride + index];
+				}
+
+				ndBrainFloat a[2][4];
+				for (ndInt32 j = 0; j < 4; ++j)
+				{
+					a[0][j] = m[0][j] + m[1][j] + m[2][j];
+					a[1][j] = m[1][j] - m[2][j] - m[3][j];
+				}
+
+				for (ndInt32 i = 0; i < 2; ++i)
+				{
+					const ndInt32 y = ty * 2 + i;
+					if (y < m_outputHeight)
+					{
+						const ndBrainFloat y0 = a[i][0] + a[i][1] + a[i][2];
+						const ndBrainFloat y1 = a[i][1] - a[i][2] - a[i][3];
+						const ndInt32 x = tx * 2;
+						dst[y * rowStride + x * pixelStride] = value + y0;
+						if ((x + 1) < m_outputWidth)
+						{
+							dst[y * rowStride + (x + 1) * pixelStride] = value + y1;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void ndBrainConvolution::Forward(
+	const ndBrainFloat* const kernels, const ndBrainFloat* const bias, ndBrainFloat biasScale,
+	const ndBrainFloat* const input, ndBrainFloat* const output, ndBrainFloat* const scratch) const
+{
+	ndBrainFloat* const shared = scratch;
+	ndBrainFloat* const lowered = &scratch[GetSharedScratchSize()];
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+
+	PrepareKernels(kernels, shared);
+	if (UseWinograd())
+	{
+		WinogradInput(input, lowered, 0, m_inputChannels);
+		WinogradProduct(&shared[m_outputChannels * patchSize], lowered, bias, biasScale, &lowered[GetLoweredSize()], output, 0, m_outputChannels);
+	}
+	else
+	{
+		const ndBrainFloat* const packedKernels = PackKernels() ? shared : kernels;
+		Im2col(input, lowered, 0, m_inputChannels);
+		ForwardProduct(packedKernels, bias, biasScale, lowered, output, 0, m_outputChannels);
+	}
+}
+
+void ndBrainConvolution::Backward(
+	const ndBrainFloat* const kernels, const ndBrainFloat* const input, const ndBrainFloat* const outputDerivative,
+	ndBrainFloat* const inputGradient, ndBrainFloat* const kernelGradients, ndBrainFloat* const biasGradients, ndBrainFloat* const scratch) const
+{
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	const ndInt32 gradientSize = m_outputChannels * patchSize + m_outputChannels;
+
+	ndBrainFloat* const shared = scratch;
+	ndBrainFloat* const col = &scratch[GetSharedScratchSize()];
+	ndBrainFloat* const packedGradients = &col[GetThreadScratchSize() - gradientSize];
+	ndBrainFloat* const packedBiasGradients = &packedGradients[m_outputChannels * patchSize];
+
+	PrepareKernels(kernels, shared);
+	const ndBrainFloat* const packedKernels = PackKernels() ? shared : kernels;
+	for (ndInt32 i = 0; i < gradientSize; ++i)
+	{
+		packedGradients[i] = ndBrainFloat(0.0f);
+	}
+
+	Im2col(input, col, 0, m_inputChannels);
+	KernelGradientProduct(outputDerivative, col, packedGradients, packedBiasGradients, 0, m_outputChannels);
+	InputGradientProduct(packedKernels, outputDerivative, col, 0, GetInputGradientRows());
+	Col2im(col, inputGradient, 0, m_inputChannels);
+
+	UnpackKernelGradients(packedGradients, kernelGradients, 0, m_outputChannels);
+	for (ndInt32 o = 0; o < m_outputChannels; ++o)
+	{
+		biasGradients[o] += packedBiasGradients[o];
+	}
+}
+
+void ndBrainConvolution::ForwardBatch(
+	ndBrainThreadPool* const threadPool, ndBrainVector& scratch, const ndBrainFloat* const kernels, const ndBrainFloat* const bias, ndBrainFloat biasScale,
+	const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	const ndInt32 batchSize = input.GetRows();
+	const ndInt32 threadsCount = threadPool ? threadPool->GetThreadCount() : 1;
+	const ndInt32 sharedSize = GetSharedScratchSize();
+	const ndInt32 threadSize = GetThreadScratchSize();
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+
+	scratch.SetCount(sharedSize + threadSize * threadsCount);
+	ndBrainFloat* const shared = &scratch[0];
+	PrepareKernels(kernels, shared);
+
+	const bool winograd = UseWinograd();
+	const ndBrainFloat* const kernelTransform = &shared[m_outputChannels * patchSize];
+	const ndBrainFloat* const packedKernels = PackKernels() ? shared : kernels;
+
+	if (batchSize >= threadsCount)
+	{
+		// each thread does whole samples
+		auto ForwardSamples = ndMakeObject::ndFunction([this, &scratch, &input, &output, bias, biasScale, winograd, kernelTransform, packedKernels, sharedSize, threadSize, batchSize](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			ndBrainFloat* const lowered = &scratch[sharedSize + threadIndex * threadSize];
+			const ndStartEnd startEnd(batchSize, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				if (winograd)
+				{
+					WinogradInput(&input[i][0], lowered, 0, m_inputChannels);
+					WinogradProduct(kernelTransform, lowered, bias, biasScale, &lowered[GetLoweredSize()], &output[i][0], 0, m_outputChannels);
+				}
+				else
+				{
+					Im2col(&input[i][0], lowered, 0, m_inputChannels);
+					ForwardProduct(packedKernels, bias, biasScale, lowered, &output[i][0], 0, m_outputChannels);
+				}
+			}
+		});
+		ndBrainConvolutionExecute(threadPool, ForwardSamples);
+	}
+	else
+	{
+		// the threads split the input channels of each sample, then the output channels
+		ndBrainFloat* const lowered = &scratch[sharedSize];
+		for (ndInt32 i = 0; i < batchSize; ++i)
+		{
+			const ndBrainFloat* const src = &input[i][0];
+			ndBrainFloat* const dst = &output[i][0];
+			auto LowerInput = ndMakeObject::ndFunction([this, src, lowered, winograd](ndInt32 threadIndex, ndInt32 threadCount)
+			{
+				const ndStartEnd startEnd(m_inputChannels, threadIndex, threadCount);
+				if (winograd)
+				{
+					WinogradInput(src, lowered, startEnd.m_start, startEnd.m_end);
+				}
+				else
+				{
+					Im2col(src, lowered, startEnd.m_start, startEnd.m_end);
+				}
+			});
+
+			auto Product = ndMakeObject::ndFunction([this, &scratch, dst, lowered, bias, biasScale, winograd, kernelTransform, packedKernels, sharedSize, threadSize](ndInt32 threadIndex, ndInt32 threadCount)
+			{
+				const ndStartEnd startEnd(m_outputChannels, threadIndex, threadCount);
+				if (winograd)
+				{
+					ndBrainFloat* const product = &scratch[sharedSize + threadIndex * threadSize + GetLoweredSize()];
+					WinogradProduct(kernelTransform, lowered, bias, biasScale, product, dst, startEnd.m_start, startEnd.m_end);
+				}
+				else
+				{
+					ForwardProduct(packedKernels, bias, biasScale, lowered, dst, startEnd.m_start, startEnd.m_end);
+				}
+			});
+
+			ndBrainConvolutionExecute(threadPool, LowerInput);
+			ndBrainConvolutionExecute(threadPool, Product);
+		}
+	}
+}
+
+void ndBrainConvolution::BackwardBatch(
+	ndBrainThreadPool* const threadPool, ndBrainVector& scratch, const ndBrainFloat* const kernels, const ndBrainMatrix& input, const ndBrainMatrix& outputDerivative,
+	ndBrainMatrix& inputGradient, ndBrainFloat* const kernelGradients, ndBrainFloat* const biasGradients) const
+{
+	ndAssert(input.GetRows() == outputDerivative.GetRows());
+	ndAssert(input.GetRows() == inputGradient.GetRows());
+	const ndInt32 batchSize = input.GetRows();
+	const ndInt32 threadsCount = threadPool ? threadPool->GetThreadCount() : 1;
+	const ndInt32 sharedSize = GetSharedScratchSize();
+	const ndInt32 threadSize = GetThreadScratchSize();
+	const ndInt32 patchSize = m_inputChannels * m_kernelSize * m_kernelSize;
+	const ndInt32 gradientSize = m_outputChannels * patchSize + m_outputChannels;
+	const ndInt32 gradientOffset = sharedSize + threadSize - gradientSize;
+
+	scratch.SetCount(sharedSize + threadSize * threadsCount);
+	ndBrainFloat* const shared = &scratch[0];
+	PrepareKernels(kernels, shared);
+	const ndBrainFloat* const packedKernels = PackKernels() ? shared : kernels;
+	for (ndInt32 i = 0; i < threadsCount; ++i)
+	{
+		ndBrainMemVector gradients(&scratch[gradientOffset + i * threadSize], gradientSize);
+		gradients.Set(ndBrainFloat(0.0f));
+	}
+
+	ndInt32 gradientBuffers = threadsCount;
+	if (batchSize >= threadsCount)
+	{
+		// each thread does whole samples, and adds the kernel gradients to its own buffer
+		auto BackwardSamples = ndMakeObject::ndFunction([this, &scratch, &input, &outputDerivative, &inputGradient, packedKernels, sharedSize, threadSize, gradientOffset, patchSize, batchSize](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			ndBrainFloat* const col = &scratch[sharedSize + threadIndex * threadSize];
+			ndBrainFloat* const packedGradients = &scratch[gradientOffset + threadIndex * threadSize];
+			ndBrainFloat* const packedBiasGradients = &packedGradients[m_outputChannels * patchSize];
+			const ndStartEnd startEnd(batchSize, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				const ndBrainFloat* const derivative = &outputDerivative[i][0];
+				Im2col(&input[i][0], col, 0, m_inputChannels);
+				KernelGradientProduct(derivative, col, packedGradients, packedBiasGradients, 0, m_outputChannels);
+				InputGradientProduct(packedKernels, derivative, col, 0, GetInputGradientRows());
+				Col2im(col, &inputGradient[i][0], 0, m_inputChannels);
+			}
+		});
+		ndBrainConvolutionExecute(threadPool, BackwardSamples);
+	}
+	else
+	{
+		// the threads split each sample by channels, all the kernel gradients go to the first buffer
+		gradientBuffers = 1;
+		ndBrainFloat* const col = &scratch[sharedSize];
+		ndBrainFloat* const packedGradients = &scratch[gradientOffset];
+		ndBrainFloat* const packedBiasGradients = &packedGradients[m_outputChannels * patchSize];
+		for (ndInt32 i = 0; i < batchSize; ++i)
+		{
+			const ndBrainFloat* const src = &input[i][0];
+			const ndBrainFloat* const derivative = &outputDerivative[i][0];
+			ndBrainFloat* const dst = &inputGradient[i][0];
+
+			auto LowerInput = ndMakeObject::ndFunction([this, src, col](ndInt32 threadIndex, ndInt32 threadCount)
+			{
+				const ndStartEnd startEnd(m_inputChannels, threadIndex, threadCount);
+				Im2col(src, col, startEnd.m_start, startEnd.m_end);
+			});
+
+			auto KernelGradients = ndMakeObject::ndFunction([this, derivative, col, packedGradients, packedBiasGradients](ndInt32 threadIndex, ndInt32 threadCount)
+			{
+				const ndStartEnd startEnd(m_outputChannels, threadIndex, threadCount);
+				KernelGradientProduct(derivative, col, packedGradients, packedBiasGradients, startEnd.m_start, startEnd.m_end);
+			});
+
+			auto InputGradients = ndMakeObject::ndFunction([this, derivative, col, packedKernels](ndInt32 threadIndex, ndInt32 threadCount)
+			{
+				const ndStartEnd startEnd(GetInputGradientRows(), threadIndex, threadCount);
+				InputGradientProduct(packedKernels, derivative, col, startEnd.m_start, startEnd.m_end);
+			});
+
+			auto RaiseInput = ndMakeObject::ndFunction([this, dst, col](ndInt32 threadIndex, ndInt32 threadCount)
+			{
+				const ndStartEnd startEnd(m_inputChannels, threadIndex, threadCount);
+				Col2im(col, dst, startEnd.m_start, startEnd.m_end);
+			});
+
+			ndBrainConvolutionExecute(threadPool, LowerInput);
+			ndBrainConvolutionExecute(threadPool, KernelGradients);
+			ndBrainConvolutionExecute(threadPool, InputGradients);
+			ndBrainConvolutionExecute(threadPool, RaiseInput);
+		}
+	}
+
+	// add the partial gradients of all the threads, split by output channels
+	auto AddGradients = ndMakeObject::ndFunction([this, &scratch, kernelGradients, biasGradients, gradientBuffers, gradientOffset, threadSize, patchSize](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(m_outputChannels, threadIndex, threadCount);
+		for (ndInt32 i = 0; i < gradientBuffers; ++i)
+		{
+			const ndBrainFloat* const packedGradients = &scratch[gradientOffset + i * threadSize];
+			const ndBrainFloat* const packedBiasGradients = &packedGradients[m_outputChannels * patchSize];
+			UnpackKernelGradients(packedGradients, kernelGradients, startEnd.m_start, startEnd.m_end);
+			for (ndInt32 o = startEnd.m_start; o < startEnd.m_end; ++o)
+			{
+				biasGradients[o] += packedBiasGradients[o];
+			}
+		}
+	});
+	ndBrainConvolutionExecute(threadPool, AddGradients);
+}
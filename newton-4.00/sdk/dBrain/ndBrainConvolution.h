@@ -0,0 +1,107 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_CONVOLUTION_H__
+#define _ND_BRAIN_CONVOLUTION_H__
+
+#include "ndBrainStdafx.h"
+
+class ndBrainVector;
+class ndBrainMatrix;
+class ndBrainThreadPool;
+
+// lowers the 2d convolution layers to the packed matrix products.
+// the input patches are unrolled to a matrix (im2col), and 3 x 3 kernels 
+// on images with enough channels use the winograd F(2x2, 3x3) transform.
+// kernels are always stored as [outputChannel][inputChannel][ky][kx], 
+// images can be channel first [c][y][x] or channel last [y][x][c].
+class ndBrainConvolution
+{
+	public:
+	enum ndLayout
+	{
+		m_channelFirst,
+		m_channelLast,
+	};
+
+	ndBrainConvolution(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputChannels, ndInt32 kernelSize, ndInt32 outputChannels, bool flipKernels, ndLayout layout);
+
+	ndLayout GetLayout() const;
+	bool UseWinograd() const;
+
+	// size of the scratch buffer used by the single sample functions
+	ndInt32 GetScratchSize() const;
+
+	// output = convolution(input) + bias * biasScale
+	void Forward(
+		const ndBrainFloat* const kernels, const ndBrainFloat* const bias, ndBrainFloat biasScale,
+		const ndBrainFloat* const input, ndBrainFloat* const output, ndBrainFloat* const scratch) const;
+
+	// the input gradient is overwritten, the kernel and bias gradients are added to.
+	void Backward(
+		const ndBrainFloat* const kernels, const ndBrainFloat* const input, const ndBrainFloat* const outputDerivative, 
+		ndBrainFloat* const inputGradient, ndBrainFloat* const kernelGradients, ndBrainFloat* const biasGradients, ndBrainFloat* const scratch) const;
+
+	// one sample per row. with a thread pool the work is split over the samples, 
+	// or over the channels of each sample when there are fewer samples than threads.
+	// the scratch grows to the size the batch needs, and is reused by later calls.
+	void ForwardBatch(
+		ndBrainThreadPool* const threadPool, ndBrainVector& scratch, const ndBrainFloat* const kernels, const ndBrainFloat* const bias, ndBrainFloat biasScale,
+		const ndBrainMatrix& input, ndBrainMatrix& output) const;
+
+	void BackwardBatch(
+		ndBrainThreadPool* const threadPool, ndBrainVector& scratch, const ndBrainFloat* const kernels, const ndBrainMatrix& input, const ndBrainMatrix& outputDerivative,
+		ndBrainMatrix& inputGradient, ndBrainFloat* const kernelGradients, ndBrainFloat* const biasGradients) const;
+
+	private:
+	ndInt32 GetSharedScratchSize() const;
+	ndInt32 GetThreadScratchSize() const;
+	ndInt32 GetLoweredSize() const;
+	ndInt32 GetInputGradientRows() const;
+	ndInt32 GetTileCount() const;
+	bool PackKernels() const;
+
+	void PrepareKernels(const ndBrainFloat* const kernels, ndBrainFloat* const shared) const;
+	void UnpackKernelGradients(const ndBrainFloat* const packedGradients, ndBrainFloat* const kernelGradients, ndInt32 o0, ndInt32 o1) const;
+
+	void Im2col(const ndBrainFloat* const input, ndBrainFloat* const col, ndInt32 c0, ndInt32 c1) const;
+	void Col2im(const ndBrainFloat* const col, ndBrainFloat* const inputGradient, ndInt32 c0, ndInt32 c1) const;
+	void ForwardProduct(const ndBrainFloat* const packedKernels, const ndBrainFloat* const bias, ndBrainFloat biasScale, const ndBrainFloat* const col, ndBrainFloat* const output, ndInt32 o0, ndInt32 o1) const;
+	void KernelGradientProduct(const ndBrainFloat* const outputDerivative, const ndBrainFloat* const col, ndBrainFloat* const packedGradients, ndBrainFloat* const biasGradients, ndInt32 o0, ndInt32 o1) const;
+	void InputGradientProduct(const ndBrainFloat* const packedKernels, const ndBrainFloat* const outputDerivative, ndBrainFloat* const col, ndInt32 r0, ndInt32 r1) const;
+
+	void WinogradKernels(const ndBrainFloat* const kernels, ndBrainFloat* const transform) const;
+	void WinogradInput(const ndBrainFloat* const input, ndBrainFloat* const transform, ndInt32 c0, ndInt32 c1) const;
+	void WinogradProduct(const ndBrainFloat* const kernelTransform, const ndBrainFloat* const inputTransform, const ndBrainFloat* const bias, ndBrainFloat biasScale, ndBrainFloat* const product, ndBrainFloat* const output, ndInt32 o0, ndInt32 o1) const;
+
+	ndInt32 m_inputWidth;
+	ndInt32 m_inputHeight;
+	ndInt32 m_inputChannels;
+	ndInt32 m_kernelSize;
+	ndInt32 m_outputWidth;
+	ndInt32 m_outputHeight;
+	ndInt32 m_outputChannels;
+	ndLayout m_layout;
+	bool m_flipKernels;
+};
+
+#endif 
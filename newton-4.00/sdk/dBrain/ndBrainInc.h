@@ -29,17 +29,26 @@
 #include <ndBrainAgent.h>
 #include <ndBrainLayer.h>
 #include <ndBrainFloat4.h>
+#include <ndBrainKernels.h>
+#include <ndBrainConvolution.h>
 #include <ndBrainVector.h>
 #include <ndBrainMatrix.h>
 #include <ndBrainTrainer.h>
+#include <ndBrainSnapshot.h>
+#include <ndBrainInference.h>
+#include <ndBrainBatchInference.h>
 #include <ndBrainSaveLoad.h>
+#include <ndBrainBinaryFile.h>
 #include <ndBrainAgentDQN.h>
 #include <ndBrainAgentTD3.h>
 #include <ndBrainAgentDDPG.h>
 #include <ndBrainOptimizer.h>
 #include <ndBrainThreadPool.h>
+#include <ndBrainAsyncLearner.h>
 #include <ndBrainLayerLinear.h>
 #include <ndBrainReplayBuffer.h>
+#include <ndBrainPrioritizedReplayBuffer.h>
+#include <ndBrainVectorEnvironment.h>
 #include <ndBrainOptimizerSgd.h>
 #include <ndBrainOptimizerAdam.h>
 #include <ndBrainLayerActivation.h>
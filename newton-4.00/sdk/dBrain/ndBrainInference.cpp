@@ -0,0 +1,675 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainLayer.h"
+#include "ndBrainMatrix.h"
+#include "ndBrainKernels.h"
+#include "ndBrainInference.h"
+#include "ndBrainBinaryFile.h"
+#include "ndBrainLayerLinear.h"
+#include "ndBrainLayerLeakyReluActivation.h"
+
+#define ND_BRAIN_INFERENCE_ALIGN	8
+
+ndBrainInference::ndOperation::ndOperation()
+	:m_layer(nullptr)
+	,m_weights(-1)
+	,m_bias(-1)
+	,m_scale(-1)
+	,m_inputs(0)
+	,m_outputs(0)
+	,m_stride(0)
+	,m_activation(m_none)
+	,m_leakDerivative(ndBrainFloat(0.0f))
+{
+}
+
+ndBrainInference::ndBrainInference(const ndBrain& brain, ndPrecision precision)
+	:ndClassAlloc()
+	,m_operations()
+	,m_parameters()
+	,m_int8Weights()
+	,m_halfWeights()
+	,m_scratch()
+	,m_parametersData(nullptr)
+	,m_precision(precision)
+	,m_inputSize(brain.GetInputSize())
+	,m_outputSize(brain.GetOutputSize())
+	,m_bufferSize(0)
+	,m_rowScratchSize(0)
+	,m_valid(true)
+{
+	auto Align = [](ndInt64 size)
+	{
+		return (size + ND_BRAIN_INFERENCE_ALIGN - 1) & -ND_BRAIN_INFERENCE_ALIGN;
+	};
+
+	ndInt64 weightsSize = 0;
+	ndInt64 parametersSize = 0;
+	ndInt32 bufferSize = m_inputSize;
+	for (ndInt32 i = 0; i < brain.GetCount(); ++i)
+	{
+		ndBrainLayer* const layer = brain[i];
+		bufferSize = ndMax(bufferSize, layer->GetOutputBufferSize());
+
+		ndOperation operation;
+		operation.m_inputs = layer->GetInputSize();
+		operation.m_outputs = layer->GetOutputSize();
+		if (!strcmp(layer->GetLabelId(), "ndBrainLayerLinear"))
+		{
+			// the activation that follows is applied in the same pass as the bias
+			// float weights share the array of the bias, quantized weights have their own.
+			operation.m_stride = ndInt32(Align(operation.m_inputs));
+			if (m_precision == m_float32)
+			{
+				operation.m_weights = parametersSize;
+				parametersSize += ndInt64(operation.m_stride) * operation.m_outputs;
+			}
+			else
+			{
+				operation.m_weights = weightsSize;
+				weightsSize += ndInt64(operation.m_stride) * operation.m_outputs;
+			}
+			operation.m_bias = parametersSize;
+			parametersSize += Align(operation.m_outputs);
+			if (m_precision == m_int8)
+			{
+				operation.m_scale = parametersSize;
+				parametersSize += Align(operation.m_outputs);
+			}
+
+			if ((i + 1) < brain.GetCount())
+			{
+				const ndActivation activation = GetActivation(brain[i + 1]->GetLabelId());
+				if (activation != m_none)
+				{
+					ndAssert(brain[i + 1]->GetOutputSize() == operation.m_outputs);
+					operation.m_activation = activation;
+					operation.m_leakDerivative = GetLeakDerivative(brain[i + 1]);
+					bufferSize = ndMax(bufferSize, brain[i + 1]->GetOutputBufferSize());
+					i++;
+				}
+			}
+		}
+		else
+		{
+			operation.m_activation = GetActivation(layer->GetLabelId());
+			operation.m_leakDerivative = GetLeakDerivative(layer);
+			if (operation.m_activation == m_none)
+			{
+				operation.m_layer = layer->Clone();
+			}
+		}
+		m_operations.PushBack(operation);
+	}
+	m_bufferSize = ndInt32(Align(bufferSize));
+
+	// int8 networks need two more buffers, for the quantized input and the integer products.
+	m_rowScratchSize = m_bufferSize * ((m_precision == m_int8) ? 4 : 2);
+
+	m_parameters.SetCount(ndInt32(parametersSize));
+	m_parameters.Set(ndBrainFloat(0.0f));
+	m_parametersData = parametersSize ? &m_parameters[0] : nullptr;
+	if (weightsSize && (m_precision == m_int8))
+	{
+		m_int8Weights.SetCount(ndInt32(weightsSize));
+		ndMemSet(&m_int8Weights[0], ndInt8(0), ndInt32(weightsSize));
+	}
+	else if (weightsSize && (m_precision == m_float16))
+	{
+		m_halfWeights.SetCount(ndInt32(weightsSize));
+		ndMemSet(&m_halfWeights[0], ndUnsigned16(0), ndInt32(weightsSize));
+	}
+	ndInt32 index = 0;
+	for (ndInt32 i = 0; i < brain.GetCount(); ++i)
+	{
+		ndBrainLayer* const layer = brain[i];
+		ndOperation& operation = m_operations[index];
+		if (operation.m_weights >= 0)
+		{
+			ndBrainLayerLinear* const linear = (ndBrainLayerLinear*)layer;
+			const ndBrainMatrix& weights = *linear->GetWeights();
+			const ndBrainVector& bias = *linear->GetBias();
+			for (ndInt32 j = 0; j < operation.m_outputs; ++j)
+			{
+				const ndBrainVector& srcRow = weights[j];
+				const ndInt64 rowStart = operation.m_weights + ndInt64(j) * operation.m_stride;
+				switch (m_precision)
+				{
+					case m_float32:
+					{
+						ndBrainMemVector row(&m_parameters[rowStart], operation.m_inputs);
+						row.Set(srcRow);
+						break;
+					}
+
+					case m_float16:
+					{
+						for (ndInt32 k = 0; k < operation.m_inputs; ++k)
+						{
+							m_halfWeights[rowStart + k] = ndBrainKernels::FloatToHalf(srcRow[k]);
+						}
+						break;
+					}
+
+					case m_int8:
+					{
+						// symmetric, one scale per output channel
+						ndBrainFloat maxValue = ndBrainFloat(0.0f);
+						for (ndInt32 k = 0; k < operation.m_inputs; ++k)
+						{
+							maxValue = ndMax(maxValue, ndAbs(srcRow[k]));
+						}
+						const ndBrainFloat invScale = (maxValue > ndBrainFloat(0.0f)) ? ndBrainFloat(127.0f) / maxValue : ndBrainFloat(0.0f);
+						for (ndInt32 k = 0; k < operation.m_inputs; ++k)
+						{
+							const ndInt32 value = ndInt32(ndFloor(srcRow[k] * invScale + ndBrainFloat(0.5f)));
+							m_int8Weights[rowStart + k] = ndInt8(ndClamp(value, -127, 127));
+						}
+						m_parameters[operation.m_scale + j] = maxValue / ndBrainFloat(127.0f);
+						break;
+					}
+				}
+			}
+			ndBrainMemVector dstBias(&m_parameters[operation.m_bias], operation.m_outputs);
+			dstBias.Set(bias);
+			if (operation.m_activation != m_none)
+			{
+				i++;
+			}
+		}
+		index++;
+	}
+	ndAssert(index == m_operations.GetCount());
+
+	m_scratch.SetCount(GetScratchSize());
+	m_scratch.Set(ndBrainFloat(0.0f));
+}
+
+ndBrainInference::ndBrainInference(const ndBrainBinaryFile& file)
+	:ndClassAlloc()
+	,m_operations()
+	,m_parameters()
+	,m_int8Weights()
+	,m_halfWeights()
+	,m_scratch()
+	,m_parametersData(file.GetData())
+	,m_precision(m_float32)
+	,m_inputSize(0)
+	,m_outputSize(0)
+	,m_bufferSize(0)
+	,m_rowScratchSize(0)
+	,m_valid(false)
+{
+	const ndInt32 layersCount = file.IsOpen() ? file.GetLayersCount() : 0;
+	if (!layersCount)
+	{
+		ndTrace(("the brain binary file is not open\n"));
+		return;
+	}
+	m_inputSize = file.GetLayer(0).m_inputs;
+	m_outputSize = file.GetLayer(layersCount - 1).m_outputs;
+
+	// same operations as the brain, but the weights and the bias 
+	// of the linear layers are read from the mapped file.
+	bool valid = true;
+	ndInt32 bufferSize = m_inputSize;
+	for (ndInt32 i = 0; valid && (i < layersCount); ++i)
+	{
+		const ndBrainBinaryFile::ndLayer& layer = file.GetLayer(i);
+
+		ndOperation operation;
+		operation.m_inputs = layer.m_inputs;
+		operation.m_outputs = layer.m_outputs;
+		bufferSize = ndMax(bufferSize, layer.m_outputs);
+		if (!strcmp(layer.m_labelId, "ndBrainLayerLinear"))
+		{
+			// the gemv kernels read whole padded rows
+			valid = !(layer.m_stride & (ND_BRAIN_INFERENCE_ALIGN - 1)) && (layer.m_stride >= layer.m_inputs);
+			operation.m_stride = layer.m_stride;
+			operation.m_weights = ndInt64(layer.m_weightsOffset / sizeof(ndBrainFloat));
+			operation.m_bias = ndInt64(layer.m_biasOffset / sizeof(ndBrainFloat));
+			if ((i + 1) < layersCount)
+			{
+				const ndBrainBinaryFile::ndLayer& nextLayer = file.GetLayer(i + 1);
+				const ndActivation activation = GetActivation(nextLayer.m_labelId);
+				if (activation != m_none)
+				{
+					valid = valid && (nextLayer.m_outputs == operation.m_outputs);
+					operation.m_activation = activation;
+					operation.m_leakDerivative = ndBrainFloat(nextLayer.m_leakDerivative);
+					i++;
+				}
+			}
+		}
+		else
+		{
+			operation.m_activation = GetActivation(layer.m_labelId);
+			operation.m_leakDerivative = ndBrainFloat(layer.m_leakDerivative);
+			if (operation.m_activation == m_none)
+			{
+				operation.m_layer = file.CreateLayer(i);
+				valid = operation.m_layer ? true : false;
+				if (valid)
+				{
+					bufferSize = ndMax(bufferSize, operation.m_layer->GetOutputBufferSize());
+				}
+			}
+		}
+		m_operations.PushBack(operation);
+	}
+
+	if (!valid)
+	{
+		ndTrace(("layer %d of the brain binary file can not be evaluated\n", ndInt32(m_operations.GetCount() - 1)));
+		for (ndInt32 i = 0; i < m_operations.GetCount(); ++i)
+		{
+			if (m_operations[i].m_layer)
+			{
+				delete m_operations[i].m_layer;
+			}
+		}
+		m_operations.SetCount(0);
+		m_parametersData = nullptr;
+		m_inputSize = 0;
+		m_outputSize = 0;
+		return;
+	}
+	m_bufferSize = (bufferSize + ND_BRAIN_INFERENCE_ALIGN - 1) & -ND_BRAIN_INFERENCE_ALIGN;
+	m_rowScratchSize = m_bufferSize * 2;
+
+	m_scratch.SetCount(GetScratchSize());
+	m_scratch.Set(ndBrainFloat(0.0f));
+	m_valid = true;
+}
+
+ndBrainInference::~ndBrainInference()
+{
+	for (ndInt32 i = 0; i < m_operations.GetCount(); ++i)
+	{
+		if (m_operations[i].m_layer)
+		{
+			delete m_operations[i].m_layer;
+		}
+	}
+}
+
+ndBrainFloat ndBrainInference::GetLeakDerivative(const ndBrainLayer* const layer)
+{
+	if (!strcmp(layer->GetLabelId(), "ndBrainLayerLeakyReluActivation"))
+	{
+		return ((ndBrainLayerLeakyReluActivation*)layer)->m_leakDerivative;
+	}
+	return ndBrainFloat(0.0f);
+}
+
+ndBrainInference::ndActivation ndBrainInference::GetActivation(const char* const labelId)
+{
+	if (!strcmp(labelId, "ndBrainLayerReluActivation"))
+	{
+		return m_relu;
+	}
+	if (!strcmp(labelId, "ndBrainLayerLeakyReluActivation"))
+	{
+		return m_leakyRelu;
+	}
+	if (!strcmp(labelId, "ndBrainLayerTanhActivation"))
+	{
+		return m_tanh;
+	}
+	if (!strcmp(labelId, "ndBrainLayerSigmoidActivation"))
+	{
+		return m_sigmoid;
+	}
+	if (!strcmp(labelId, "ndBrainLayerSoftmaxActivation"))
+	{
+		return m_softmax;
+	}
+	return m_none;
+}
+
+void ndBrainInference::Activate(ndActivation activation, ndBrainFloat leakDerivative, ndInt32 count, ndBrainFloat* const data)
+{
+	// same arithmetic as the activation layers, so that the results are identical
+	auto FlushToZero = [](ndBrainFloat value)
+	{
+		return (value > ndBrainFloat(1.0e-16f)) ? value : ((value < ndBrainFloat(-1.0e-16f)) ? value : ndBrainFloat(0.0f));
+	};
+
+	switch (activation)
+	{
+		case m_relu:
+		{
+			for (ndInt32 i = 0; i < count; ++i)
+			{
+				data[i] = (data[i] > ndBrainFloat(0.0f)) ? data[i] : ndBrainFloat(0.0f);
+			}
+			break;
+		}
+
+		case m_leakyRelu:
+		{
+			for (ndInt32 i = 0; i < count; ++i)
+			{
+				data[i] = (data[i] > ndBrainFloat(0.0f)) ? data[i] : data[i] * leakDerivative;
+			}
+			break;
+		}
+
+		case m_tanh:
+		{
+			for (ndInt32 i = 0; i < count; ++i)
+			{
+				data[i] = FlushToZero(ndBrainFloat(ndTanh(data[i])));
+			}
+			break;
+		}
+
+		case m_sigmoid:
+		{
+			for (ndInt32 i = 0; i < count; ++i)
+			{
+				ndBrainFloat value = data[i];
+				if (value > ndBrainFloat(0.0f))
+				{
+					value = ndMin(value, ndBrainFloat(30.0f));
+					ndBrainFloat p = ndBrainFloat(ndExp(-value));
+					data[i] = ndFlushToZero(ndBrainFloat(1.0f) / (p + ndBrainFloat(1.0f)));
+				}
+				else
+				{
+					value = ndMax(value, ndBrainFloat(-30.0f));
+					ndBrainFloat p = ndBrainFloat(ndExp(value));
+					data[i] = ndFlushToZero(p / (p + ndBrainFloat(1.0f)));
+				}
+			}
+			break;
+		}
+
+		case m_softmax:
+		{
+			ndBrainFloat max = ndBrainFloat(1.0e-16f);
+			for (ndInt32 i = 0; i < count; ++i)
+			{
+				max = ndMax(data[i], max);
+			}
+
+			ndBrainFloat acc = ndBrainFloat(0.0f);
+			for (ndInt32 i = count - 1; i >= 0; --i)
+			{
+				ndBrainFloat prob = ndBrainFloat(ndExp(ndMax((data[i] - max), ndBrainFloat(-30.0f))));
+				data[i] = prob;
+				acc += prob;
+			}
+
+			ndAssert(acc > ndBrainFloat(0.0f));
+			const ndBrainFloat invAcc = ndBrainFloat(1.0f) / acc;
+			for (ndInt32 i = 0; i < count; ++i)
+			{
+				data[i] = FlushToZero(data[i] * invAcc);
+			}
+			break;
+		}
+
+		case m_none:
+		default:;
+	}
+}
+
+void ndBrainInference::MultiplyWeights(const ndOperation& operation, const ndBrainFloat* const input, ndBrainFloat* const output, ndBrainFloat* const scratch) const
+{
+	const ndBrainFloat* const bias = &m_parametersData[operation.m_bias];
+	switch (m_precision)
+	{
+		case m_float32:
+		{
+			ndBrainKernels::Gemv(operation.m_outputs, operation.m_inputs, &m_parametersData[operation.m_weights], operation.m_stride, input, output);
+			for (ndInt32 i = 0; i < operation.m_outputs; ++i)
+			{
+				output[i] += bias[i];
+			}
+			break;
+		}
+
+		case m_float16:
+		{
+			ndBrainKernels::GemvHalf(operation.m_outputs, operation.m_inputs, &m_halfWeights[operation.m_weights], operation.m_stride, input, output);
+			for (ndInt32 i = 0; i < operation.m_outputs; ++i)
+			{
+				output[i] += bias[i];
+			}
+			break;
+		}
+
+		case m_int8:
+		{
+			// the input is quantized on the fly with a single scale
+			ndInt32* const products = (ndInt32*)&scratch[m_bufferSize * 2];
+			ndInt8* const quantizedInput = (ndInt8*)&scratch[m_bufferSize * 3];
+
+			ndBrainFloat maxValue = ndBrainFloat(0.0f);
+			for (ndInt32 i = 0; i < operation.m_inputs; ++i)
+			{
+				maxValue = ndMax(maxValue, ndAbs(input[i]));
+			}
+			const ndBrainFloat invScale = (maxValue > ndBrainFloat(0.0f)) ? ndBrainFloat(127.0f) / maxValue : ndBrainFloat(0.0f);
+			for (ndInt32 i = 0; i < operation.m_inputs; ++i)
+			{
+				const ndInt32 value = ndInt32(ndFloor(input[i] * invScale + ndBrainFloat(0.5f)));
+				quantizedInput[i] = ndInt8(ndClamp(value, -127, 127));
+			}
+
+			ndBrainKernels::GemvInt8(operation.m_outputs, operation.m_inputs, &m_int8Weights[operation.m_weights], operation.m_stride, quantizedInput, products);
+
+			const ndBrainFloat inputScale = maxValue / ndBrainFloat(127.0f);
+			const ndBrainFloat* const scale = &m_parametersData[operation.m_scale];
+			for (ndInt32 i = 0; i < operation.m_outputs; ++i)
+			{
+				output[i] = ndBrainFloat(products[i]) * scale[i] * inputScale + bias[i];
+			}
+			break;
+		}
+	}
+}
+
+void ndBrainInference::MakePrediction(const ndBrainFloat* const input, ndBrainFloat* const output, ndBrainFloat* const scratch) const
+{
+	ndAssert(m_valid);
+	ndBrainFloat* in = scratch;
+	ndBrainFloat* out = &scratch[m_bufferSize];
+	ndMemCpy(in, input, m_inputSize);
+
+	for (ndInt32 i = 0; i < m_operations.GetCount(); ++i)
+	{
+		const ndOperation& operation = m_operations[i];
+		if (operation.m_weights >= 0)
+		{
+			MultiplyWeights(operation, in, out, scratch);
+			Activate(operation.m_activation, operation.m_leakDerivative, operation.m_outputs, out);
+		}
+		else if (operation.m_layer)
+		{
+			const ndBrainMemVector layerInput(in, operation.m_inputs);
+			ndBrainMemVector layerOutput(out, operation.m_outputs);
+			operation.m_layer->MakePrediction(layerInput, layerOutput);
+		}
+		else
+		{
+			ndMemCpy(out, in, operation.m_outputs);
+			Activate(operation.m_activation, operation.m_leakDerivative, operation.m_outputs, out);
+		}
+		ndSwap(in, out);
+	}
+	ndMemCpy(output, in, m_outputSize);
+}
+
+void ndBrainInference::MakeBatchPrediction(
+	const ndBrainFloat* const inputs, ndInt64 inputStride,
+	ndBrainFloat* const outputs, ndInt64 outputStride,
+	ndInt32 count, ndBrainFloat* const scratch) const
+{
+	ndAssert(m_valid);
+	if ((count == 1) || (m_precision != m_float32))
+	{
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			MakePrediction(&inputs[i * inputStride], &outputs[i * outputStride], scratch);
+		}
+		return;
+	}
+
+	const ndInt64 stride = m_bufferSize;
+	ndBrainFloat* in = scratch;
+	ndBrainFloat* out = &scratch[stride * count];
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		ndMemCpy(&in[i * stride], &inputs[i * inputStride], m_inputSize);
+	}
+
+	const ndBrainFloat* const parameters = m_parametersData;
+	for (ndInt32 i = 0; i < m_operations.GetCount(); ++i)
+	{
+		const ndOperation& operation = m_operations[i];
+		if (operation.m_weights >= 0)
+		{
+			// the rows start with the bias, and the product of all the rows 
+			// by the transposed weights is added to them.
+			const ndBrainFloat* const bias = &parameters[operation.m_bias];
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				ndMemCpy(&out[j * stride], bias, operation.m_outputs);
+			}
+			ndBrainKernels::Gemm(
+				count, operation.m_outputs, operation.m_inputs, 
+				in, stride, 1, 
+				&parameters[operation.m_weights], 1, operation.m_stride,
+				out, stride);
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				Activate(operation.m_activation, operation.m_leakDerivative, operation.m_outputs, &out[j * stride]);
+			}
+		}
+		else if (operation.m_layer)
+		{
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				const ndBrainMemVector layerInput(&in[j * stride], operation.m_inputs);
+				ndBrainMemVector layerOutput(&out[j * stride], operation.m_outputs);
+				operation.m_layer->MakePrediction(layerInput, layerOutput);
+			}
+		}
+		else
+		{
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				ndMemCpy(&out[j * stride], &in[j * stride], operation.m_outputs);
+				Activate(operation.m_activation, operation.m_leakDerivative, operation.m_outputs, &out[j * stride]);
+			}
+		}
+		ndSwap(in, out);
+	}
+
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		ndMemCpy(&outputs[i * outputStride], &in[i * stride], m_outputSize);
+	}
+}
+
+void ndBrainInference::MakePrediction(const ndBrainFloat* const input, ndBrainFloat* const output)
+{
+	MakePrediction(input, output, &m_scratch[0]);
+}
+
+void ndBrainInference::MakePrediction(const ndBrainVector& input, ndBrainVector& output)
+{
+	ndAssert(input.GetCount() == m_inputSize);
+	ndAssert(output.GetCount() == m_outputSize);
+	MakePrediction(&input[0], &output[0], &m_scratch[0]);
+}
+
+ndInt64 ndBrainInference::GetParametersBytes() const
+{
+	if (!m_parameters.GetCount() && m_parametersData)
+	{
+		// evaluated in place from a mapped file, where the bias 
+		// of each layer is a block aligned to the file alignment.
+		ndInt64 bytes = 0;
+		for (ndInt32 i = 0; i < m_operations.GetCount(); ++i)
+		{
+			const ndOperation& operation = m_operations[i];
+			if (operation.m_weights >= 0)
+			{
+				const ndInt64 biasBytes = ndInt64(operation.m_outputs) * ndInt64(sizeof(ndBrainFloat));
+				bytes += ndInt64(operation.m_stride) * operation.m_outputs * ndInt64(sizeof(ndBrainFloat));
+				bytes += (biasBytes + D_BRAIN_BINARY_ALIGNMENT - 1) & -D_BRAIN_BINARY_ALIGNMENT;
+			}
+		}
+		return bytes;
+	}
+	return ndInt64(m_parameters.GetCount()) * ndInt64(sizeof(ndBrainFloat)) + 
+		ndInt64(m_halfWeights.GetCount()) * ndInt64(sizeof(ndUnsigned16)) + 
+		ndInt64(m_int8Weights.GetCount()) * ndInt64(sizeof(ndInt8));
+}
+
+ndBrainInference::ndAccuracy ndBrainInference::CalculateAccuracy(const ndBrain& brain, const ndBrainFloat* const inputs, ndInt64 inputStride, ndInt32 count) const
+{
+	const ndBrainInference reference(brain);
+	ndAssert(reference.GetInputSize() == m_inputSize);
+	ndAssert(reference.GetOutputSize() == m_outputSize);
+
+	ndBrainVector output;
+	ndBrainVector referenceOutput;
+	ndBrainVector scratch;
+	output.SetCount(m_outputSize);
+	referenceOutput.SetCount(m_outputSize);
+	scratch.SetCount(ndMax(GetScratchSize(), reference.GetScratchSize()));
+
+	ndAccuracy accuracy;
+	accuracy.m_maxError = ndBrainFloat(0.0f);
+	accuracy.m_averageError = ndBrainFloat(0.0f);
+	accuracy.m_maxOutput = ndBrainFloat(0.0f);
+	accuracy.m_parametersBytes = GetParametersBytes();
+	accuracy.m_floatParametersBytes = reference.GetParametersBytes();
+	accuracy.m_samplesCount = count;
+
+	ndFloat64 errorAcc = ndFloat64(0.0f);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		reference.MakePrediction(&inputs[i * inputStride], &referenceOutput[0], &scratch[0]);
+		MakePrediction(&inputs[i * inputStride], &output[0], &scratch[0]);
+		for (ndInt32 j = 0; j < m_outputSize; ++j)
+		{
+			const ndBrainFloat error = ndAbs(output[j] - referenceOutput[j]);
+			accuracy.m_maxError = ndMax(accuracy.m_maxError, error);
+			accuracy.m_maxOutput = ndMax(accuracy.m_maxOutput, ndAbs(referenceOutput[j]));
+			errorAcc += error;
+		}
+	}
+	if (count)
+	{
+		accuracy.m_averageError = ndBrainFloat(errorAcc / (ndFloat64(count) * m_outputSize));
+	}
+	return accuracy;
+}
@@ -0,0 +1,184 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_INFERENCE_H__
+#define _ND_BRAIN_INFERENCE_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+
+class ndBrain;
+class ndBrainLayer;
+class ndBrainBinaryFile;
+
+// an inference only copy of a brain, for controllers that evaluate 
+// small networks many times per frame.
+// each linear layer is fused with the activation that follows it, 
+// weights and bias are packed in one array with padded rows for the 
+// gemv kernel, and the evaluation runs over a flat list of operations 
+// without virtual calls or memory allocations.
+// layers that can not be fused (convolutions, drop out, ...) are cloned 
+// and evaluated through the layer interface.
+// the weights are copied, so the brain must be compiled again after training.
+// for deployment the weights can be quantized to half floats, or to int8 
+// with one scale per output, the bias and activations remain in float.
+// a network compiled from an open binary file reads the float weights 
+// in place from the mapped memory, so the file must stay open.
+// a file with layers that can not be evaluated makes an empty network,
+// so callers must check IsValid before making predictions.
+class ndBrainInference: public ndClassAlloc
+{
+	public: 
+	enum ndActivation
+	{
+		m_none,
+		m_relu,
+		m_leakyRelu,
+		m_tanh,
+		m_sigmoid,
+		m_softmax,
+	};
+
+	enum ndPrecision
+	{
+		m_float32,
+		m_float16,
+		m_int8,
+	};
+
+	// the error of a quantized network against the float network
+	class ndAccuracy
+	{
+		public:
+		ndBrainFloat m_maxError;
+		ndBrainFloat m_averageError;
+		ndBrainFloat m_maxOutput;
+		ndInt64 m_parametersBytes;
+		ndInt64 m_floatParametersBytes;
+		ndInt32 m_samplesCount;
+	};
+
+	ndBrainInference(const ndBrain& brain, ndPrecision precision = m_float32);
+	ndBrainInference(const ndBrainBinaryFile& file);
+	~ndBrainInference();
+
+	bool IsValid() const;
+	ndInt32 GetInputSize() const;
+	ndInt32 GetOutputSize() const;
+	ndInt32 GetScratchSize() const;
+	ndInt32 GetOperationsCount() const;
+	ndPrecision GetPrecision() const;
+
+	// the memory read by one evaluation, weights and bias.
+	ndInt64 GetParametersBytes() const;
+
+	// compares count rows of inputs against the float evaluation of the brain.
+	ndAccuracy CalculateAccuracy(const ndBrain& brain, const ndBrainFloat* const inputs, ndInt64 inputStride, ndInt32 count) const;
+
+	// uses the internal buffers, so only one thread can call it at a time
+	void MakePrediction(const ndBrainVector& input, ndBrainVector& output);
+	void MakePrediction(const ndBrainFloat* const input, ndBrainFloat* const output);
+
+	// for concurrent callers, each with its own scratch of GetScratchSize() floats
+	void MakePrediction(const ndBrainFloat* const input, ndBrainFloat* const output, ndBrainFloat* const scratch) const;
+
+	// evaluates count rows of inputs with one matrix product per layer, 
+	// quantized networks evaluate one row at a time.
+	// the scratch must have GetBatchScratchSize(count) floats.
+	ndInt64 GetBatchScratchSize(ndInt32 count) const;
+	void MakeBatchPrediction(
+		const ndBrainFloat* const inputs, ndInt64 inputStride,
+		ndBrainFloat* const outputs, ndInt64 outputStride,
+		ndInt32 count, ndBrainFloat* const scratch) const;
+
+	private:
+	class ndOperation
+	{
+		public:
+		ndOperation();
+
+		ndBrainLayer* m_layer;
+		ndInt64 m_weights;
+		ndInt64 m_bias;
+		ndInt64 m_scale;
+		ndInt32 m_inputs;
+		ndInt32 m_outputs;
+		ndInt32 m_stride;
+		ndActivation m_activation;
+		ndBrainFloat m_leakDerivative;
+	};
+
+	static ndActivation GetActivation(const char* const labelId);
+	static ndBrainFloat GetLeakDerivative(const ndBrainLayer* const layer);
+	static void Activate(ndActivation activation, ndBrainFloat leakDerivative, ndInt32 count, ndBrainFloat* const data);
+	void MultiplyWeights(const ndOperation& operation, const ndBrainFloat* const input, ndBrainFloat* const output, ndBrainFloat* const scratch) const;
+
+	ndArray<ndOperation> m_operations;
+	ndBrainVector m_parameters;
+	ndArray<ndInt8> m_int8Weights;
+	ndArray<ndUnsigned16> m_halfWeights;
+	ndBrainVector m_scratch;
+	const ndBrainFloat* m_parametersData;
+	ndPrecision m_precision;
+	ndInt32 m_inputSize;
+	ndInt32 m_outputSize;
+	ndInt32 m_bufferSize;
+	ndInt32 m_rowScratchSize;
+	bool m_valid;
+};
+
+inline bool ndBrainInference::IsValid() const
+{
+	return m_valid;
+}
+
+inline ndInt32 ndBrainInference::GetInputSize() const
+{
+	return m_inputSize;
+}
+
+inline ndInt32 ndBrainInference::GetOutputSize() const
+{
+	return m_outputSize;
+}
+
+inline ndInt32 ndBrainInference::GetScratchSize() const
+{
+	return m_rowScratchSize;
+}
+
+inline ndInt64 ndBrainInference::GetBatchScratchSize(ndInt32 count) const
+{
+	return ndInt64(m_rowScratchSize) * count;
+}
+
+inline ndBrainInference::ndPrecision ndBrainInference::GetPrecision() const
+{
+	return m_precision;
+}
+
+inline ndInt32 ndBrainInference::GetOperationsCount() const
+{
+	return ndInt32(m_operations.GetCount());
+}
+
+#endif 
@@ -0,0 +1,443 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainKernels.h"
+
+#if defined(_MSC_VER) && (defined(D_BRAIN_USE_AVX2_KERNELS) || defined(D_BRAIN_USE_AVX512_KERNELS))
+	#include <intrin.h>
+#endif
+
+#ifdef D_BRAIN_USE_AVX2_KERNELS
+	const ndBrainKernels::ndMicroKernels* ndBrainGetAvx2Kernels();
+#endif
+
+#ifdef D_BRAIN_USE_AVX512_KERNELS
+	const ndBrainKernels::ndMicroKernels* ndBrainGetAvx512Kernels();
+#endif
+
+#ifdef D_BRAIN_USE_NEON_KERNELS
+	const ndBrainKernels::ndMicroKernels* ndBrainGetNeonKernels();
+#endif
+
+// portable versions, written so that the compiler can vectorize 
+// them for whatever target the library is compiled.
+template <ndInt32 rows>
+static inline void ndBrainGenericGemmTile(ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	const ndInt32 columns8 = columns & -8;
+	for (ndInt32 j = 0; j < columns8; j += 8)
+	{
+		ndBrainFloat acc[rows][8];
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			for (ndInt32 n = 0; n < 8; ++n)
+			{
+				acc[r][n] = c[r * cStride + j + n];
+			}
+		}
+		for (ndInt32 k = 0; k < depth; ++k)
+		{
+			const ndBrainFloat* const bRow = &b[k * D_BRAIN_GEMM_COLUMN_BLOCK + j];
+			for (ndInt32 r = 0; r < rows; ++r)
+			{
+				const ndBrainFloat scale = a[k * rows + r];
+				for (ndInt32 n = 0; n < 8; ++n)
+				{
+					acc[r][n] += scale * bRow[n];
+				}
+			}
+		}
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			for (ndInt32 n = 0; n < 8; ++n)
+			{
+				c[r * cStride + j + n] = acc[r][n];
+			}
+		}
+	}
+
+	for (ndInt32 j = columns8; j < columns; ++j)
+	{
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			ndBrainFloat sum = ndBrainFloat(0.0f);
+			for (ndInt32 k = 0; k < depth; ++k)
+			{
+				sum += a[k * rows + r] * b[k * D_BRAIN_GEMM_COLUMN_BLOCK + j];
+			}
+			c[r * cStride + j] += sum;
+		}
+	}
+}
+
+static void ndBrainGenericGemmStrip(ndInt32 rows, ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	if (rows == 4)
+	{
+		ndBrainGenericGemmTile<4>(depth, columns, a, b, c, cStride);
+	}
+	else
+	{
+		ndAssert(rows == 1);
+		ndBrainGenericGemmTile<1>(depth, columns, a, b, c, cStride);
+	}
+}
+
+static void ndBrainGenericGemv(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		y[i] = ndDotProduct(columns, &m[i * stride], x);
+	}
+}
+
+static void ndBrainGenericGemvTranspose(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// one block of the output at a time, so that it stays in cache while all the rows are added.
+	const ndInt32 block = 256;
+	for (ndInt32 j0 = 0; j0 < columns; j0 += block)
+	{
+		const ndInt32 count = ndMin(columns - j0, block);
+		ndBrainFloat* const dst = &y[j0];
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			dst[j] = ndBrainFloat(0.0f);
+		}
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			const ndBrainFloat scale = x[i];
+			const ndBrainFloat* const src = &m[i * stride + j0];
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				dst[j] += scale * src[j];
+			}
+		}
+	}
+}
+
+// the quantized gemv are shared by the instruction sets that do not have their own.
+void ndBrainGenericGemvInt8(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y)
+{
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		ndInt32 sum = 0;
+		const ndInt8* const row = &m[i * stride];
+		for (ndInt32 j = 0; j < columns; ++j)
+		{
+			sum += ndInt32(row[j]) * ndInt32(x[j]);
+		}
+		y[i] = sum;
+	}
+}
+
+void ndBrainGenericGemvHalf(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		ndBrainFloat sum = ndBrainFloat(0.0f);
+		const ndUnsigned16* const row = &m[i * stride];
+		for (ndInt32 j = 0; j < columns; ++j)
+		{
+			sum += ndBrainKernels::HalfToFloat(row[j]) * x[j];
+		}
+		y[i] = sum;
+	}
+}
+
+static const ndBrainKernels::ndMicroKernels* ndBrainGetGenericKernels()
+{
+	static const ndBrainKernels::ndMicroKernels kernels =
+	{
+		4, ndBrainGenericGemmStrip, ndBrainGenericGemv, ndBrainGenericGemvTranspose, ndBrainGenericGemvInt8, ndBrainGenericGemvHalf
+	};
+	return &kernels;
+}
+
+ndAtomic<const ndBrainKernels::ndMicroKernels*> ndBrainKernels::m_kernels(nullptr);
+ndAtomic<ndBrainKernels::ndInstructionSet> ndBrainKernels::m_instructionSet(ndBrainKernels::m_generic);
+
+bool ndBrainKernels::IsInstructionSetSupported(ndInstructionSet set)
+{
+	switch (set)
+	{
+		case m_generic:
+			return true;
+
+		case m_avx2:
+		{
+			#if defined(D_BRAIN_USE_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+			#elif defined(D_BRAIN_USE_AVX2_KERNELS) && defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 1);
+				const bool osSupport = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0x06) == 0x06);
+				const bool fma = (info[2] & (1 << 12)) != 0;
+				__cpuidex(info, 7, 0);
+				return osSupport && fma && (info[1] & (1 << 5));
+			#else
+				return false;
+			#endif
+		}
+
+		case m_avx512:
+		{
+			// the quantized gemv of this set are the avx2 ones
+			if (!IsInstructionSetSupported(m_avx2))
+			{
+				return false;
+			}
+			#if defined(D_BRAIN_USE_AVX512_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("fma");
+			#elif defined(D_BRAIN_USE_AVX512_KERNELS) && defined(_MSC_VER)
+				int info[4];
+				__cpuid(info, 1);
+				const bool osSupport = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0xe6) == 0xe6);
+				const bool fma = (info[2] & (1 << 12)) != 0;
+				__cpuidex(info, 7, 0);
+				return osSupport && fma && (info[1] & (1 << 16));
+			#else
+				return false;
+			#endif
+		}
+
+		case m_neon:
+		{
+			#ifdef D_BRAIN_USE_NEON_KERNELS
+				return true;
+			#else
+				return false;
+			#endif
+		}
+	}
+	return false;
+}
+
+ndBrainKernels::ndInstructionSet ndBrainKernels::GetBestInstructionSet()
+{
+	// avx2 goes first, with the panel sizes used here the wider avx512 tile 
+	// is not faster and it can lower the clock of the whole core.
+	const ndInstructionSet sets[] = { m_avx2, m_avx512, m_neon };
+	for (ndInt32 i = 0; i < ndInt32(sizeof(sets) / sizeof(sets[0])); ++i)
+	{
+		if (IsInstructionSetSupported(sets[i]))
+		{
+			return sets[i];
+		}
+	}
+	return m_generic;
+}
+
+const ndBrainKernels::ndMicroKernels* ndBrainKernels::GetKernels(ndInstructionSet set)
+{
+	switch (set)
+	{
+		#ifdef D_BRAIN_USE_AVX2_KERNELS
+		case m_avx2:
+			return ndBrainGetAvx2Kernels();
+		#endif
+
+		#ifdef D_BRAIN_USE_AVX512_KERNELS
+		case m_avx512:
+			return ndBrainGetAvx512Kernels();
+		#endif
+
+		#ifdef D_BRAIN_USE_NEON_KERNELS
+		case m_neon:
+			return ndBrainGetNeonKernels();
+		#endif
+
+		default:
+			return ndBrainGetGenericKernels();
+	}
+}
+
+const ndBrainKernels::ndMicroKernels* ndBrainKernels::GetSelectedKernels()
+{
+	// the first caller selects the best instruction set, 
+	// the threads that call at the same time wait for it.
+	static std::once_flag selectBest;
+	std::call_once(selectBest, []()
+	{
+		const ndInstructionSet set = GetBestInstructionSet();
+		m_instructionSet.store(set);
+		m_kernels.store(GetKernels(set));
+	});
+	return m_kernels.load();
+}
+
+ndBrainKernels::ndInstructionSet ndBrainKernels::GetInstructionSet()
+{
+	GetSelectedKernels();
+	return m_instructionSet.load();
+}
+
+bool ndBrainKernels::SetInstructionSet(ndInstructionSet set)
+{
+	if (!IsInstructionSetSupported(set))
+	{
+		return false;
+	}
+	// the default selection must not overwrite this one later.
+	GetSelectedKernels();
+	m_instructionSet.store(set);
+	m_kernels.store(GetKernels(set));
+	return true;
+}
+
+void ndBrainKernels::Gemm(
+	ndInt32 rows, ndInt32 columns, ndInt32 depth,
+	const ndBrainFloat* const a, ndInt64 aRowStride, ndInt64 aDepthStride,
+	const ndBrainFloat* const b, ndInt64 bDepthStride, ndInt64 bColumnStride,
+	ndBrainFloat* const c, ndInt64 cStride)
+{
+	// a panel of b and a strip of rows of a are packed in contiguous buffers,
+	// the panel is reused by all the strips while it is still in cache and 
+	// the micro kernel keeps the partial sums of the strip in registers.
+	const ndMicroKernels* const kernels = GetSelectedKernels();
+	const ndInt32 stripRows = kernels->m_stripRows;
+	ndAssert(stripRows <= D_BRAIN_GEMM_MAX_STRIP_ROWS);
+
+	ndBrainFloat* const packedStrip = ndAlloca(ndBrainFloat, D_BRAIN_GEMM_MAX_STRIP_ROWS * D_BRAIN_GEMM_DEPTH_BLOCK);
+	ndBrainFloat* const packedPanel = ndAlloca(ndBrainFloat, D_BRAIN_GEMM_COLUMN_BLOCK * D_BRAIN_GEMM_DEPTH_BLOCK);
+
+	auto PackStrip = [a, aRowStride, aDepthStride, packedStrip](ndInt32 i0, ndInt32 count, ndInt32 k0, ndInt32 kCount)
+	{
+		for (ndInt32 k = 0; k < kCount; ++k)
+		{
+			const ndBrainFloat* const src = &a[i0 * aRowStride + (k0 + k) * aDepthStride];
+			for (ndInt32 r = 0; r < count; ++r)
+			{
+				packedStrip[k * count + r] = src[r * aRowStride];
+			}
+		}
+	};
+
+	auto PackPanel = [b, bDepthStride, bColumnStride, packedPanel](ndInt32 k0, ndInt32 kCount, ndInt32 j0, ndInt32 jCount)
+	{
+		for (ndInt32 k = 0; k < kCount; ++k)
+		{
+			const ndBrainFloat* const src = &b[(k0 + k) * bDepthStride + j0 * bColumnStride];
+			ndBrainFloat* const dst = &packedPanel[k * D_BRAIN_GEMM_COLUMN_BLOCK];
+			for (ndInt32 j = 0; j < jCount; ++j)
+			{
+				dst[j] = src[j * bColumnStride];
+			}
+		}
+	};
+
+	for (ndInt32 k0 = 0; k0 < depth; k0 += D_BRAIN_GEMM_DEPTH_BLOCK)
+	{
+		const ndInt32 kCount = ndMin(depth - k0, D_BRAIN_GEMM_DEPTH_BLOCK);
+		for (ndInt32 j0 = 0; j0 < columns; j0 += D_BRAIN_GEMM_COLUMN_BLOCK)
+		{
+			const ndInt32 jCount = ndMin(columns - j0, D_BRAIN_GEMM_COLUMN_BLOCK);
+			PackPanel(k0, kCount, j0, jCount);
+
+			ndInt32 i = 0;
+			for (; i + stripRows <= rows; i += stripRows)
+			{
+				PackStrip(i, stripRows, k0, kCount);
+				kernels->m_gemmStrip(stripRows, kCount, jCount, packedStrip, packedPanel, &c[i * cStride + j0], cStride);
+			}
+			for (; i < rows; ++i)
+			{
+				PackStrip(i, 1, k0, kCount);
+				kernels->m_gemmStrip(1, kCount, jCount, packedStrip, packedPanel, &c[i * cStride + j0], cStride);
+			}
+		}
+	}
+}
+
+void ndBrainKernels::Gemv(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	GetSelectedKernels()->m_gemv(rows, columns, m, stride, x, y);
+}
+
+void ndBrainKernels::GemvTranspose(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	GetSelectedKernels()->m_gemvTranspose(rows, columns, m, stride, x, y);
+}
+
+void ndBrainKernels::GemvInt8(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y)
+{
+	GetSelectedKernels()->m_gemvInt8(rows, columns, m, stride, x, y);
+}
+
+void ndBrainKernels::GemvHalf(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	GetSelectedKernels()->m_gemvHalf(rows, columns, m, stride, x, y);
+}
+
+ndUnsigned16 ndBrainKernels::FloatToHalf(ndBrainFloat value)
+{
+	union ndBits
+	{
+		ndReal m_float;
+		ndUnsigned32 m_bits;
+	};
+
+	ndBits bits;
+	bits.m_float = ndClamp(ndReal(value), ndReal(-65504.0f), ndReal(65504.0f));
+	const ndUnsigned32 sign = bits.m_bits & 0x80000000;
+	bits.m_bits ^= sign;
+
+	ndUnsigned32 half;
+	if (bits.m_bits < (113 << 23))
+	{
+		// the sub normals and zero are rounded by the addition of 0.5, 
+		// which aligns the half mantissa to the low bits of the float.
+		ndBits denormal;
+		denormal.m_bits = 126 << 23;
+		bits.m_float += denormal.m_float;
+		half = bits.m_bits - denormal.m_bits;
+	}
+	else
+	{
+		// rebias the exponent and round to nearest even
+		const ndUnsigned32 oddMantissa = (bits.m_bits >> 13) & 1;
+		bits.m_bits += ((ndUnsigned32(15 - 127) << 23) + 0xfff) + oddMantissa;
+		half = bits.m_bits >> 13;
+	}
+	return ndUnsigned16(half | (sign >> 16));
+}
+
+ndBrainFloat ndBrainKernels::HalfToFloat(ndUnsigned16 value)
+{
+	// the half exponent is rebiased with one multiply, which also normalizes the sub normals.
+	// no infinity or nan, FloatToHalf does not produce them.
+	union ndBits
+	{
+		ndReal m_float;
+		ndUnsigned32 m_bits;
+	};
+
+	ndBits scale;
+	ndBits bits;
+	scale.m_bits = ndUnsigned32(127 + 127 - 15) << 23;
+	bits.m_bits = ndUnsigned32(value & 0x7fff) << 13;
+	bits.m_float *= scale.m_float;
+	bits.m_bits |= ndUnsigned32(value & 0x8000) << 16;
+	return ndBrainFloat(bits.m_float);
+}
@@ -0,0 +1,122 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_KERNELS_H__
+#define _ND_BRAIN_KERNELS_H__
+
+#include "ndBrainStdafx.h"
+
+// the micro kernels of each instruction set are compiled with function target 
+// attributes, so the library runs on any cpu and no special build flags are needed.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define D_BRAIN_USE_AVX2_KERNELS
+	#define D_BRAIN_USE_AVX512_KERNELS
+	#if defined(__GNUC__) || defined(__clang__)
+		#define D_BRAIN_AVX2_TARGET __attribute__((target("avx2,fma")))
+		#define D_BRAIN_AVX512_TARGET __attribute__((target("avx512f,fma")))
+	#else
+		#define D_BRAIN_AVX2_TARGET
+		#define D_BRAIN_AVX512_TARGET
+	#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define D_BRAIN_USE_NEON_KERNELS
+#endif
+
+// the strip and panel sizes of the packed matrix products.
+// the packed buffers live on the stack of the calling thread, 
+// a 64 x 64 panel is 16 kbytes and stays in the level one cache.
+#define D_BRAIN_GEMM_MAX_STRIP_ROWS	8
+#define D_BRAIN_GEMM_DEPTH_BLOCK	64
+#define D_BRAIN_GEMM_COLUMN_BLOCK	64
+
+// dense linear algebra used by the neural net layers.
+// the micro kernels are compiled for several instruction sets,
+// and the best one supported by the cpu is selected at run time.
+class ndBrainKernels
+{
+	public:
+	enum ndInstructionSet
+	{
+		m_generic,
+		m_avx2,
+		m_avx512,
+		m_neon,
+	};
+
+	// the register tiled inner loops of one instruction set.
+	// a gemm strip multiplies a packed strip of rows (a[k * rows + r]) 
+	// by a packed panel (b[k * D_BRAIN_GEMM_COLUMN_BLOCK + j]), 
+	// rows is either m_stripRows or one.
+	// the quantized gemv read int8 or half float matrices.
+	class ndMicroKernels
+	{
+		public:
+		ndInt32 m_stripRows;
+		void (*m_gemmStrip)(ndInt32 rows, ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride);
+		void (*m_gemv)(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+		void (*m_gemvTranspose)(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+		void (*m_gemvInt8)(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y);
+		void (*m_gemvHalf)(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+	};
+
+	static ndInstructionSet GetInstructionSet();
+	static ndInstructionSet GetBestInstructionSet();
+	static bool IsInstructionSetSupported(ndInstructionSet set);
+
+	// return false, and leave the selection unchanged, if the cpu does not support it.
+	static bool SetInstructionSet(ndInstructionSet set);
+
+	// c += a * b, where a(i, k) = a[i * aRowStride + k * aDepthStride] and 
+	// b(k, j) = b[k * bDepthStride + j * bColumnStride], so that any of the 
+	// two operands can be read as a transposed matrix.
+	static void Gemm(
+		ndInt32 rows, ndInt32 columns, ndInt32 depth,
+		const ndBrainFloat* const a, ndInt64 aRowStride, ndInt64 aDepthStride,
+		const ndBrainFloat* const b, ndInt64 bDepthStride, ndInt64 bColumnStride,
+		ndBrainFloat* const c, ndInt64 cStride);
+
+	// y = m * x, the rows of m are contiguous
+	static void Gemv(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+
+	// y = transpose(m) * x, the rows of m are contiguous
+	static void GemvTranspose(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+
+	// y = m * x in integers, the elements of m and x must be in [-127, 127], 
+	// so that the products of pairs can be added in 16 bits.
+	static void GemvInt8(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y);
+
+	// y = m * x, with m stored in half floats
+	static void GemvHalf(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+
+	// ieee half floats, rounded to nearest even and saturated to the largest finite half.
+	static ndUnsigned16 FloatToHalf(ndBrainFloat value);
+	static ndBrainFloat HalfToFloat(ndUnsigned16 value);
+
+	private:
+	static const ndMicroKernels* GetKernels(ndInstructionSet set);
+	static const ndMicroKernels* GetSelectedKernels();
+	static ndAtomic<const ndMicroKernels*> m_kernels;
+	static ndAtomic<ndInstructionSet> m_instructionSet;
+};
+
+#endif 
+
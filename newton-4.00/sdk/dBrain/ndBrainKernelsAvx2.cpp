@@ -0,0 +1,331 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainKernels.h"
+
+#ifdef D_BRAIN_USE_AVX2_KERNELS
+#include <immintrin.h>
+
+// avx2 micro kernels, the gemm tile is 6 x 16, 
+// twelve accumulators plus two panel rows and one broadcast.
+#define D_BRAIN_AVX2_STRIP_ROWS	6
+
+static inline D_BRAIN_AVX2_TARGET ndBrainFloat ndBrainAvx2HorizontalAdd(const __m256 value)
+{
+	__m128 sum(_mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1)));
+	sum = _mm_hadd_ps(sum, sum);
+	sum = _mm_hadd_ps(sum, sum);
+	return _mm_cvtss_f32(sum);
+}
+
+template <ndInt32 rows, ndInt32 width>
+static inline D_BRAIN_AVX2_TARGET void ndBrainAvx2GemmTile(ndInt32 depth, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	__m256 acc[rows][width];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			acc[r][w] = _mm256_loadu_ps(&c[r * cStride + w * 8]);
+		}
+	}
+
+	for (ndInt32 k = 0; k < depth; ++k)
+	{
+		__m256 panel[width];
+		const ndBrainFloat* const bRow = &b[k * D_BRAIN_GEMM_COLUMN_BLOCK];
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			panel[w] = _mm256_loadu_ps(&bRow[w * 8]);
+		}
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			const __m256 scale(_mm256_broadcast_ss(&a[k * rows + r]));
+			for (ndInt32 w = 0; w < width; ++w)
+			{
+				acc[r][w] = _mm256_fmadd_ps(scale, panel[w], acc[r][w]);
+			}
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			_mm256_storeu_ps(&c[r * cStride + w * 8], acc[r][w]);
+		}
+	}
+}
+
+template <ndInt32 rows>
+static inline D_BRAIN_AVX2_TARGET void ndBrainAvx2GemmRows(ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	ndInt32 j = 0;
+	for (; j + 16 <= columns; j += 16)
+	{
+		ndBrainAvx2GemmTile<rows, 2>(depth, a, &b[j], &c[j], cStride);
+	}
+	for (; j + 8 <= columns; j += 8)
+	{
+		ndBrainAvx2GemmTile<rows, 1>(depth, a, &b[j], &c[j], cStride);
+	}
+	for (; j < columns; ++j)
+	{
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			ndBrainFloat sum = ndBrainFloat(0.0f);
+			for (ndInt32 k = 0; k < depth; ++k)
+			{
+				sum += a[k * rows + r] * b[k * D_BRAIN_GEMM_COLUMN_BLOCK + j];
+			}
+			c[r * cStride + j] += sum;
+		}
+	}
+}
+
+static D_BRAIN_AVX2_TARGET void ndBrainAvx2GemmStrip(ndInt32 rows, ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	if (rows == D_BRAIN_AVX2_STRIP_ROWS)
+	{
+		ndBrainAvx2GemmRows<D_BRAIN_AVX2_STRIP_ROWS>(depth, columns, a, b, c, cStride);
+	}
+	else
+	{
+		ndAssert(rows == 1);
+		ndBrainAvx2GemmRows<1>(depth, columns, a, b, c, cStride);
+	}
+}
+
+template <ndInt32 rows>
+static inline D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvRows(ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	__m256 acc[rows];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		acc[r] = _mm256_setzero_ps();
+	}
+
+	ndInt32 j = 0;
+	for (; j + 8 <= columns; j += 8)
+	{
+		const __m256 vector(_mm256_loadu_ps(&x[j]));
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			acc[r] = _mm256_fmadd_ps(_mm256_loadu_ps(&m[r * stride + j]), vector, acc[r]);
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		ndBrainFloat sum = ndBrainAvx2HorizontalAdd(acc[r]);
+		for (ndInt32 k = j; k < columns; ++k)
+		{
+			sum += m[r * stride + k] * x[k];
+		}
+		y[r] = sum;
+	}
+}
+
+static D_BRAIN_AVX2_TARGET void ndBrainAvx2Gemv(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// four rows at a time share the loads of x
+	ndInt32 i = 0;
+	for (; i + 4 <= rows; i += 4)
+	{
+		ndBrainAvx2GemvRows<4>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+	for (; i < rows; ++i)
+	{
+		ndBrainAvx2GemvRows<1>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+}
+
+template <ndInt32 width>
+static inline D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvTransposeColumns(ndInt32 rows, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	__m256 acc[width];
+	for (ndInt32 w = 0; w < width; ++w)
+	{
+		acc[w] = _mm256_setzero_ps();
+	}
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		const __m256 scale(_mm256_broadcast_ss(&x[i]));
+		const ndBrainFloat* const row = &m[i * stride];
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			acc[w] = _mm256_fmadd_ps(scale, _mm256_loadu_ps(&row[w * 8]), acc[w]);
+		}
+	}
+	for (ndInt32 w = 0; w < width; ++w)
+	{
+		_mm256_storeu_ps(&y[w * 8], acc[w]);
+	}
+}
+
+static D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvTranspose(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// a block of columns of the output stays in registers while all the rows are added
+	ndInt32 j = 0;
+	for (; j + 32 <= columns; j += 32)
+	{
+		ndBrainAvx2GemvTransposeColumns<4>(rows, &m[j], stride, x, &y[j]);
+	}
+	for (; j + 8 <= columns; j += 8)
+	{
+		ndBrainAvx2GemvTransposeColumns<1>(rows, &m[j], stride, x, &y[j]);
+	}
+	for (; j < columns; ++j)
+	{
+		ndBrainFloat sum = ndBrainFloat(0.0f);
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			sum += m[i * stride + j] * x[i];
+		}
+		y[j] = sum;
+	}
+}
+
+static inline D_BRAIN_AVX2_TARGET ndInt32 ndBrainAvx2HorizontalAdd(const __m256i value)
+{
+	__m128i sum(_mm_add_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1)));
+	sum = _mm_hadd_epi32(sum, sum);
+	sum = _mm_hadd_epi32(sum, sum);
+	return _mm_cvtsi128_si32(sum);
+}
+
+template <ndInt32 rows>
+static inline D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvInt8Rows(ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y)
+{
+	// maddubs multiplies unsigned by signed bytes, so the sign of x is moved 
+	// to the row. with both in [-127, 127] the pairs do not saturate 16 bits.
+	const __m256i ones(_mm256_set1_epi16(1));
+	__m256i acc[rows];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		acc[r] = _mm256_setzero_si256();
+	}
+
+	ndInt32 j = 0;
+	for (; j + 32 <= columns; j += 32)
+	{
+		const __m256i vector(_mm256_loadu_si256((const __m256i*)&x[j]));
+		const __m256i absVector(_mm256_sign_epi8(vector, vector));
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			const __m256i row(_mm256_sign_epi8(_mm256_loadu_si256((const __m256i*)&m[r * stride + j]), vector));
+			const __m256i pairs(_mm256_maddubs_epi16(absVector, row));
+			acc[r] = _mm256_add_epi32(acc[r], _mm256_madd_epi16(pairs, ones));
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		ndInt32 sum = ndBrainAvx2HorizontalAdd(acc[r]);
+		for (ndInt32 k = j; k < columns; ++k)
+		{
+			sum += ndInt32(m[r * stride + k]) * ndInt32(x[k]);
+		}
+		y[r] = sum;
+	}
+}
+
+// the quantized gemv are also used by the avx512 kernels.
+D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvInt8(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y)
+{
+	ndInt32 i = 0;
+	for (; i + 4 <= rows; i += 4)
+	{
+		ndBrainAvx2GemvInt8Rows<4>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+	for (; i < rows; ++i)
+	{
+		ndBrainAvx2GemvInt8Rows<1>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+}
+
+static inline D_BRAIN_AVX2_TARGET __m256 ndBrainAvx2HalfToFloat(const ndUnsigned16* const src)
+{
+	// same bit manipulation as ndBrainKernels::HalfToFloat, 
+	// so that it does not depend on the f16c extension.
+	const __m256i halfs(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)src)));
+	const __m256i sign(_mm256_slli_epi32(_mm256_and_si256(halfs, _mm256_set1_epi32(0x8000)), 16));
+	const __m256i magnitude(_mm256_slli_epi32(_mm256_and_si256(halfs, _mm256_set1_epi32(0x7fff)), 13));
+	const __m256 scale(_mm256_castsi256_ps(_mm256_set1_epi32((127 + 127 - 15) << 23)));
+	const __m256 value(_mm256_mul_ps(_mm256_castsi256_ps(magnitude), scale));
+	return _mm256_or_ps(value, _mm256_castsi256_ps(sign));
+}
+
+template <ndInt32 rows>
+static inline D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvHalfRows(ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	__m256 acc[rows];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		acc[r] = _mm256_setzero_ps();
+	}
+
+	ndInt32 j = 0;
+	for (; j + 8 <= columns; j += 8)
+	{
+		const __m256 vector(_mm256_loadu_ps(&x[j]));
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			acc[r] = _mm256_fmadd_ps(ndBrainAvx2HalfToFloat(&m[r * stride + j]), vector, acc[r]);
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		ndBrainFloat sum = ndBrainAvx2HorizontalAdd(acc[r]);
+		for (ndInt32 k = j; k < columns; ++k)
+		{
+			sum += ndBrainKernels::HalfToFloat(m[r * stride + k]) * x[k];
+		}
+		y[r] = sum;
+	}
+}
+
+D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvHalf(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	ndInt32 i = 0;
+	for (; i + 4 <= rows; i += 4)
+	{
+		ndBrainAvx2GemvHalfRows<4>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+	for (; i < rows; ++i)
+	{
+		ndBrainAvx2GemvHalfRows<1>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+}
+
+const ndBrainKernels::ndMicroKernels* ndBrainGetAvx2Kernels()
+{
+	static const ndBrainKernels::ndMicroKernels kernels =
+	{
+		D_BRAIN_AVX2_STRIP_ROWS, ndBrainAvx2GemmStrip, ndBrainAvx2Gemv, ndBrainAvx2GemvTranspose, ndBrainAvx2GemvInt8, ndBrainAvx2GemvHalf
+	};
+	return &kernels;
+}
+
+#endif
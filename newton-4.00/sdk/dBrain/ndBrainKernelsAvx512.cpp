@@ -0,0 +1,199 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainKernels.h"
+
+#ifdef D_BRAIN_USE_AVX512_KERNELS
+#include <immintrin.h>
+
+// the quantized gemv of this instruction set are the avx2 ones
+D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvInt8(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y);
+D_BRAIN_AVX2_TARGET void ndBrainAvx2GemvHalf(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+
+// avx512 micro kernels, the gemm tile is 8 x 32, sixteen accumulators.
+// the columns that do not fill a register are handled with masked loads and stores.
+#define D_BRAIN_AVX512_STRIP_ROWS	8
+
+static inline D_BRAIN_AVX512_TARGET __mmask16 ndBrainAvx512Mask(ndInt32 count)
+{
+	return (count >= 16) ? __mmask16(0xffff) : __mmask16((1 << count) - 1);
+}
+
+template <ndInt32 rows, ndInt32 width>
+static inline D_BRAIN_AVX512_TARGET void ndBrainAvx512GemmTile(ndInt32 depth, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride, __mmask16 mask)
+{
+	// the mask applies to the last register of each row
+	__m512 acc[rows][width];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		for (ndInt32 w = 0; w < width - 1; ++w)
+		{
+			acc[r][w] = _mm512_loadu_ps(&c[r * cStride + w * 16]);
+		}
+		acc[r][width - 1] = _mm512_maskz_loadu_ps(mask, &c[r * cStride + (width - 1) * 16]);
+	}
+
+	for (ndInt32 k = 0; k < depth; ++k)
+	{
+		__m512 panel[width];
+		const ndBrainFloat* const bRow = &b[k * D_BRAIN_GEMM_COLUMN_BLOCK];
+		for (ndInt32 w = 0; w < width - 1; ++w)
+		{
+			panel[w] = _mm512_loadu_ps(&bRow[w * 16]);
+		}
+		panel[width - 1] = _mm512_maskz_loadu_ps(mask, &bRow[(width - 1) * 16]);
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			const __m512 scale(_mm512_set1_ps(a[k * rows + r]));
+			for (ndInt32 w = 0; w < width; ++w)
+			{
+				acc[r][w] = _mm512_fmadd_ps(scale, panel[w], acc[r][w]);
+			}
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		for (ndInt32 w = 0; w < width - 1; ++w)
+		{
+			_mm512_storeu_ps(&c[r * cStride + w * 16], acc[r][w]);
+		}
+		_mm512_mask_storeu_ps(&c[r * cStride + (width - 1) * 16], mask, acc[r][width - 1]);
+	}
+}
+
+template <ndInt32 rows>
+static inline D_BRAIN_AVX512_TARGET void ndBrainAvx512GemmRows(ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	ndInt32 j = 0;
+	for (; j + 32 <= columns; j += 32)
+	{
+		ndBrainAvx512GemmTile<rows, 2>(depth, a, &b[j], &c[j], cStride, ndBrainAvx512Mask(16));
+	}
+	for (; j < columns; j += 16)
+	{
+		ndBrainAvx512GemmTile<rows, 1>(depth, a, &b[j], &c[j], cStride, ndBrainAvx512Mask(columns - j));
+	}
+}
+
+static D_BRAIN_AVX512_TARGET void ndBrainAvx512GemmStrip(ndInt32 rows, ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	if (rows == D_BRAIN_AVX512_STRIP_ROWS)
+	{
+		ndBrainAvx512GemmRows<D_BRAIN_AVX512_STRIP_ROWS>(depth, columns, a, b, c, cStride);
+	}
+	else
+	{
+		ndAssert(rows == 1);
+		ndBrainAvx512GemmRows<1>(depth, columns, a, b, c, cStride);
+	}
+}
+
+template <ndInt32 rows>
+static inline D_BRAIN_AVX512_TARGET void ndBrainAvx512GemvRows(ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	__m512 acc[rows];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		acc[r] = _mm512_setzero_ps();
+	}
+
+	for (ndInt32 j = 0; j < columns; j += 16)
+	{
+		const __mmask16 mask = ndBrainAvx512Mask(columns - j);
+		const __m512 vector(_mm512_maskz_loadu_ps(mask, &x[j]));
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			acc[r] = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, &m[r * stride + j]), vector, acc[r]);
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		y[r] = _mm512_reduce_add_ps(acc[r]);
+	}
+}
+
+static D_BRAIN_AVX512_TARGET void ndBrainAvx512Gemv(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// four rows at a time share the loads of x
+	ndInt32 i = 0;
+	for (; i + 4 <= rows; i += 4)
+	{
+		ndBrainAvx512GemvRows<4>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+	for (; i < rows; ++i)
+	{
+		ndBrainAvx512GemvRows<1>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+}
+
+template <ndInt32 width>
+static inline D_BRAIN_AVX512_TARGET void ndBrainAvx512GemvTransposeColumns(ndInt32 rows, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y, __mmask16 mask)
+{
+	__m512 acc[width];
+	for (ndInt32 w = 0; w < width; ++w)
+	{
+		acc[w] = _mm512_setzero_ps();
+	}
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		const __m512 scale(_mm512_set1_ps(x[i]));
+		const ndBrainFloat* const row = &m[i * stride];
+		for (ndInt32 w = 0; w < width - 1; ++w)
+		{
+			acc[w] = _mm512_fmadd_ps(scale, _mm512_loadu_ps(&row[w * 16]), acc[w]);
+		}
+		acc[width - 1] = _mm512_fmadd_ps(scale, _mm512_maskz_loadu_ps(mask, &row[(width - 1) * 16]), acc[width - 1]);
+	}
+	for (ndInt32 w = 0; w < width - 1; ++w)
+	{
+		_mm512_storeu_ps(&y[w * 16], acc[w]);
+	}
+	_mm512_mask_storeu_ps(&y[(width - 1) * 16], mask, acc[width - 1]);
+}
+
+static D_BRAIN_AVX512_TARGET void ndBrainAvx512GemvTranspose(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// a block of columns of the output stays in registers while all the rows are added
+	ndInt32 j = 0;
+	for (; j + 64 <= columns; j += 64)
+	{
+		ndBrainAvx512GemvTransposeColumns<4>(rows, &m[j], stride, x, &y[j], ndBrainAvx512Mask(16));
+	}
+	for (; j < columns; j += 16)
+	{
+		ndBrainAvx512GemvTransposeColumns<1>(rows, &m[j], stride, x, &y[j], ndBrainAvx512Mask(columns - j));
+	}
+}
+
+const ndBrainKernels::ndMicroKernels* ndBrainGetAvx512Kernels()
+{
+	static const ndBrainKernels::ndMicroKernels kernels =
+	{
+		D_BRAIN_AVX512_STRIP_ROWS, ndBrainAvx512GemmStrip, ndBrainAvx512Gemv, ndBrainAvx512GemvTranspose, ndBrainAvx2GemvInt8, ndBrainAvx2GemvHalf
+	};
+	return &kernels;
+}
+
+#endif
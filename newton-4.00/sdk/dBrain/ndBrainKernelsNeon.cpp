@@ -0,0 +1,213 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainKernels.h"
+
+#ifdef D_BRAIN_USE_NEON_KERNELS
+#include <arm_neon.h>
+
+// the quantized gemv of this instruction set are the generic ones
+void ndBrainGenericGemvInt8(ndInt32 rows, ndInt32 columns, const ndInt8* const m, ndInt64 stride, const ndInt8* const x, ndInt32* const y);
+void ndBrainGenericGemvHalf(ndInt32 rows, ndInt32 columns, const ndUnsigned16* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y);
+
+// neon micro kernels, the gemm tile is 4 x 16, sixteen accumulators.
+#define D_BRAIN_NEON_STRIP_ROWS	4
+
+template <ndInt32 rows, ndInt32 width>
+static inline void ndBrainNeonGemmTile(ndInt32 depth, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	float32x4_t acc[rows][width];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			acc[r][w] = vld1q_f32(&c[r * cStride + w * 4]);
+		}
+	}
+
+	for (ndInt32 k = 0; k < depth; ++k)
+	{
+		float32x4_t panel[width];
+		const ndBrainFloat* const bRow = &b[k * D_BRAIN_GEMM_COLUMN_BLOCK];
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			panel[w] = vld1q_f32(&bRow[w * 4]);
+		}
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			const float32x4_t scale(vdupq_n_f32(a[k * rows + r]));
+			for (ndInt32 w = 0; w < width; ++w)
+			{
+				acc[r][w] = vfmaq_f32(acc[r][w], scale, panel[w]);
+			}
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			vst1q_f32(&c[r * cStride + w * 4], acc[r][w]);
+		}
+	}
+}
+
+template <ndInt32 rows>
+static inline void ndBrainNeonGemmRows(ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	ndInt32 j = 0;
+	for (; j + 16 <= columns; j += 16)
+	{
+		ndBrainNeonGemmTile<rows, 4>(depth, a, &b[j], &c[j], cStride);
+	}
+	for (; j + 4 <= columns; j += 4)
+	{
+		ndBrainNeonGemmTile<rows, 1>(depth, a, &b[j], &c[j], cStride);
+	}
+	for (; j < columns; ++j)
+	{
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			ndBrainFloat sum = ndBrainFloat(0.0f);
+			for (ndInt32 k = 0; k < depth; ++k)
+			{
+				sum += a[k * rows + r] * b[k * D_BRAIN_GEMM_COLUMN_BLOCK + j];
+			}
+			c[r * cStride + j] += sum;
+		}
+	}
+}
+
+static void ndBrainNeonGemmStrip(ndInt32 rows, ndInt32 depth, ndInt32 columns, const ndBrainFloat* const a, const ndBrainFloat* const b, ndBrainFloat* const c, ndInt64 cStride)
+{
+	if (rows == D_BRAIN_NEON_STRIP_ROWS)
+	{
+		ndBrainNeonGemmRows<D_BRAIN_NEON_STRIP_ROWS>(depth, columns, a, b, c, cStride);
+	}
+	else
+	{
+		ndAssert(rows == 1);
+		ndBrainNeonGemmRows<1>(depth, columns, a, b, c, cStride);
+	}
+}
+
+template <ndInt32 rows>
+static inline void ndBrainNeonGemvRows(ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	float32x4_t acc[rows];
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		acc[r] = vdupq_n_f32(0.0f);
+	}
+
+	ndInt32 j = 0;
+	for (; j + 4 <= columns; j += 4)
+	{
+		const float32x4_t vector(vld1q_f32(&x[j]));
+		for (ndInt32 r = 0; r < rows; ++r)
+		{
+			acc[r] = vfmaq_f32(acc[r], vld1q_f32(&m[r * stride + j]), vector);
+		}
+	}
+
+	for (ndInt32 r = 0; r < rows; ++r)
+	{
+		ndBrainFloat sum = vaddvq_f32(acc[r]);
+		for (ndInt32 k = j; k < columns; ++k)
+		{
+			sum += m[r * stride + k] * x[k];
+		}
+		y[r] = sum;
+	}
+}
+
+static void ndBrainNeonGemv(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// four rows at a time share the loads of x
+	ndInt32 i = 0;
+	for (; i + 4 <= rows; i += 4)
+	{
+		ndBrainNeonGemvRows<4>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+	for (; i < rows; ++i)
+	{
+		ndBrainNeonGemvRows<1>(columns, &m[i * stride], stride, x, &y[i]);
+	}
+}
+
+template <ndInt32 width>
+static inline void ndBrainNeonGemvTransposeColumns(ndInt32 rows, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	float32x4_t acc[width];
+	for (ndInt32 w = 0; w < width; ++w)
+	{
+		acc[w] = vdupq_n_f32(0.0f);
+	}
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		const float32x4_t scale(vdupq_n_f32(x[i]));
+		const ndBrainFloat* const row = &m[i * stride];
+		for (ndInt32 w = 0; w < width; ++w)
+		{
+			acc[w] = vfmaq_f32(acc[w], scale, vld1q_f32(&row[w * 4]));
+		}
+	}
+	for (ndInt32 w = 0; w < width; ++w)
+	{
+		vst1q_f32(&y[w * 4], acc[w]);
+	}
+}
+
+static void ndBrainNeonGemvTranspose(ndInt32 rows, ndInt32 columns, const ndBrainFloat* const m, ndInt64 stride, const ndBrainFloat* const x, ndBrainFloat* const y)
+{
+	// a block of columns of the output stays in registers while all the rows are added
+	ndInt32 j = 0;
+	for (; j + 32 <= columns; j += 32)
+	{
+		ndBrainNeonGemvTransposeColumns<8>(rows, &m[j], stride, x, &y[j]);
+	}
+	for (; j + 4 <= columns; j += 4)
+	{
+		ndBrainNeonGemvTransposeColumns<1>(rows, &m[j], stride, x, &y[j]);
+	}
+	for (; j < columns; ++j)
+	{
+		ndBrainFloat sum = ndBrainFloat(0.0f);
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			sum += m[i * stride + j] * x[i];
+		}
+		y[j] = sum;
+	}
+}
+
+const ndBrainKernels::ndMicroKernels* ndBrainGetNeonKernels()
+{
+	static const ndBrainKernels::ndMicroKernels kernels =
+	{
+		D_BRAIN_NEON_STRIP_ROWS, ndBrainNeonGemmStrip, ndBrainNeonGemv, ndBrainNeonGemvTranspose, ndBrainGenericGemvInt8, ndBrainGenericGemvHalf
+	};
+	return &kernels;
+}
+
+#endif
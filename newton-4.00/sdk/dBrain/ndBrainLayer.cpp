@@ -22,6 +22,8 @@
 
 #include "ndBrainStdafx.h"
 #include "ndBrainLayer.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
 
 ndBrainLayer::ndBrainLayer(const ndBrainLayer& src)
 	:ndClassAlloc(src)
@@ -160,3 +162,66 @@ void ndBrainLayer::CalculateParamGradients(const ndBrainVector&, const ndBrainVe
 	ndAssert(0);
 }
 
+void ndBrainLayer::SetThreadPool(ndBrainThreadPool* const)
+{
+}
+
+void ndBrainLayer::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	ndAssert(input.GetColumns() == GetInputSize());
+	ndAssert(output.GetColumns() == GetOutputSize());
+
+	// generic path, one sample at a time. 
+	// layers that use scratch memory past the end of the output get a private buffer.
+	if (GetOutputBufferSize() == GetOutputSize())
+	{
+		for (ndInt32 i = input.GetRows() - 1; i >= 0; --i)
+		{
+			MakePrediction(input[i], output[i]);
+		}
+	}
+	else
+	{
+		ndBrainVector buffer;
+		buffer.SetCount(GetOutputBufferSize());
+		ndBrainMemVector out(&buffer[0], GetOutputSize());
+		for (ndInt32 i = input.GetRows() - 1; i >= 0; --i)
+		{
+			MakePrediction(input[i], out);
+			output[i].Set(out);
+		}
+	}
+}
+
+void ndBrainLayer::CalculateBatchParamGradients(
+	const ndBrainMatrix& input, const ndBrainMatrix& output,
+	const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+	ndBrainLayer* const gradientOut, ndBrainLayer* const sampleGradient) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	ndAssert(input.GetRows() == outputDerivative.GetRows());
+	ndAssert(input.GetRows() == inputGradient.GetRows());
+
+	// generic path, one sample at a time, accumulating the parameter gradients.
+	// sampleGradient is the caller's scratch copy of the gradient layer.
+	if (HasParameters())
+	{
+		ndAssert(gradientOut);
+		ndAssert(sampleGradient && (sampleGradient != gradientOut));
+		gradientOut->Clear();
+	}
+
+	ndBrainVector buffer;
+	buffer.SetCount(GetOutputBufferSize());
+	ndBrainMemVector out(&buffer[0], GetOutputSize());
+	for (ndInt32 i = input.GetRows() - 1; i >= 0; --i)
+	{
+		out.Set(output[i]);
+		CalculateParamGradients(input[i], out, outputDerivative[i], inputGradient[i], sampleGradient);
+		if (HasParameters())
+		{
+			gradientOut->Add(*sampleGradient);
+		}
+	}
+}
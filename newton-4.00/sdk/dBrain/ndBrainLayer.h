@@ -28,6 +28,7 @@ class ndBrainLoad;
 class ndBrainSave;
 class ndBrainVector;
 class ndBrainMatrix;
+class ndBrainThreadPool;
 
 class ndBrainLayer : public ndClassAlloc
 {
@@ -67,6 +68,16 @@ class ndBrainLayer : public ndClassAlloc
 		const ndBrainVector& input, const ndBrainVector& output, 
 		const ndBrainVector& outputDerivative, ndBrainVector& inputGradient, ndBrainLayer* const gradientOut) const;
 
+	// mini batch versions, each row of the matrices is one sample. 
+	// the parameter gradients are the sum over all the samples in the batch,
+	// sampleGradient is a preallocated clone of gradientOut used as scratch.
+	virtual void MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const;
+	virtual void SetThreadPool(ndBrainThreadPool* const threadPool);
+	virtual void CalculateBatchParamGradients(
+		const ndBrainMatrix& input, const ndBrainMatrix& output,
+		const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+		ndBrainLayer* const gradientOut, ndBrainLayer* const sampleGradient) const;
+
 	virtual void AdamUpdate(const ndBrainLayer& u, const ndBrainLayer& v, ndBrainFloat epsilon);
 
 	virtual void Save(const ndBrainSave* const loadSave) const;
@@ -133,3 +133,45 @@ void ndBrainLayerConvolutionalWithDropOut_2d::CalculateParamGradients(
 	}
 	ndBrainLayerConvolutional_2d::CalculateParamGradients(input, output, outputDerivative, inputGradient, gradientOut);
 }
+
+void ndBrainLayerConvolutionalWithDropOut_2d::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndBrainLayerConvolutional_2d::MakeBatchPrediction(input, output);
+	if (m_droutOutEnable)
+	{
+		const ndInt32 layerSize = m_outputWidth * m_outputHeight;
+		for (ndInt32 i = output.GetRows() - 1; i >= 0; --i)
+		{
+			ndInt32 layerOffset = 0;
+			for (ndInt32 j = 0; j < m_outputLayers; ++j)
+			{
+				ndBrainMemVector out(&output[i][layerOffset], layerSize);
+				out.Scale(m_dropout[j]);
+				layerOffset += layerSize;
+			}
+		}
+	}
+}
+
+void ndBrainLayerConvolutionalWithDropOut_2d::CalculateBatchParamGradients(
+	const ndBrainMatrix& input, const ndBrainMatrix& output,
+	const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+	ndBrainLayer* const gradientOut, ndBrainLayer* const sampleGradient) const
+{
+	if (m_droutOutEnable)
+	{
+		const ndInt32 layerSize = m_outputWidth * m_outputHeight;
+		for (ndInt32 i = outputDerivative.GetRows() - 1; i >= 0; --i)
+		{
+			ndInt32 layerOffset = 0;
+			const ndBrainFloat* const outMemory = &outputDerivative[i][0];
+			for (ndInt32 j = 0; j < m_outputLayers; ++j)
+			{
+				ndBrainMemVector outDerivative(&outMemory[layerOffset], layerSize);
+				outDerivative.Scale(m_dropout[j]);
+				layerOffset += layerSize;
+			}
+		}
+	}
+	ndBrainLayerConvolutional_2d::CalculateBatchParamGradients(input, output, outputDerivative, inputGradient, gradientOut, sampleGradient);
+}
@@ -20,18 +20,17 @@
 */
 
 #include "ndBrainStdafx.h"
-#include "ndBrainFloat4.h"
 #include "ndBrainSaveLoad.h"
+#include "ndBrainThreadPool.h"
 #include "ndBrainLayerConvolutional_2d.h"
 
-//#define ND_CONV_USE_SCALAR
-
-ndBrainLayerConvolutional_2d::ndBrainLayerConvolutional_2d(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputDepth, ndInt32 kernelSize, ndInt32 numberOfKernels)
+ndBrainLayerConvolutional_2d::ndBrainLayerConvolutional_2d(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputDepth, ndInt32 kernelSize, ndInt32 numberOfKernels, ndBrainConvolution::ndLayout layout)
 	:ndBrainLayer()
 	,m_bias()
 	,m_kernels()
-	,m_inputOffsets()
-	,m_inputGradOffsets()
+	,m_convolution(inputWidth, inputHeight, inputDepth, kernelSize, numberOfKernels, true, layout)
+	,m_threadPool(nullptr)
+	,m_batchScratch()
 	,m_kernelSize(kernelSize)
 	,m_inputWidth(inputWidth)
 	,m_inputHeight(inputHeight)
@@ -50,27 +49,15 @@ ndBrainLayerConvolutional_2d::ndBrainLayerConvolutional_2d(ndInt32 inputWidth, n
 
 	m_bias.Set(ndBrainFloat(0.0f));
 	m_kernels.Set(ndBrainFloat(0.0f));
-
-	ndInt32 inputOffset = 0;
-	ndInt32 inputGradOffset = 0;
-	for (ndInt32 j = 0; j < m_kernelSize; ++j)
-	{
-		for (ndInt32 i = 0; i < m_kernelSize; ++i)
-		{
-			m_inputOffsets.PushBack(inputOffset + i);
-			m_inputGradOffsets.PushBack(inputGradOffset + i);
-		}
-		inputOffset += m_inputWidth;
-		inputGradOffset += m_inputWidth + m_kernelSize - 1;
-	}
 }
 
 ndBrainLayerConvolutional_2d::ndBrainLayerConvolutional_2d(const ndBrainLayerConvolutional_2d& src)
 	:ndBrainLayer(src)
 	,m_bias(src.m_bias)
 	,m_kernels(src.m_kernels)
-	,m_inputOffsets(src.m_inputOffsets)
-	,m_inputGradOffsets(src.m_inputGradOffsets)
+	,m_convolution(src.m_convolution)
+	,m_threadPool(src.m_threadPool)
+	,m_batchScratch()
 	,m_kernelSize(src.m_kernelSize)
 	,m_inputWidth(src.m_inputWidth)
 	,m_inputHeight(src.m_inputHeight)
@@ -107,10 +94,8 @@ ndInt32 ndBrainLayerConvolutional_2d::GetOutputSize() const
 
 ndInt32 ndBrainLayerConvolutional_2d::GetOutputBufferSize() const
 {
-	ndInt32 size = GetOutputSize();
-	ndInt32 paddSizeWidth = m_inputWidth + m_kernelSize - 1;
-	ndInt32 paddSizeHeight = m_inputHeight + m_kernelSize - 1;
-	return size + paddSizeWidth * paddSizeHeight;
+	// the scratch memory of the convolution goes after the output
+	return GetOutputSize() + m_convolution.GetScratchSize();
 }
 
 ndInt32 ndBrainLayerConvolutional_2d::GetInputSize() const
@@ -133,6 +118,16 @@ ndInt32 ndBrainLayerConvolutional_2d::GetOutputChannels() const
 	return m_outputLayers;
 }
 
+ndBrainConvolution::ndLayout ndBrainLayerConvolutional_2d::GetLayout() const
+{
+	return m_convolution.GetLayout();
+}
+
+void ndBrainLayerConvolutional_2d::SetThreadPool(ndBrainThreadPool* const threadPool)
+{
+	m_threadPool = threadPool;
+}
+
 ndInt32 ndBrainLayerConvolutional_2d::GetNumberOfParameters() const
 {
 	return m_bias.GetCount() + m_kernelSize * m_kernelSize * m_inputLayers * m_outputLayers;
@@ -264,6 +259,10 @@ void ndBrainLayerConvolutional_2d::Save(const ndBrainSave* const loadSave) const
 	Save("\tinput_layers %d\n", m_inputLayers);
 	Save("\tkernel_Size %d\n", m_kernelSize);
 	Save("\touput_layers %d\n", m_outputLayers);
+	if (m_convolution.GetLayout() == ndBrainConvolution::m_channelLast)
+	{
+		Save("\tchannel_last 1\n");
+	}
 
 	Save("\tbias ");
 	for (ndInt32 i = 0; i < m_bias.GetCount(); ++i)
@@ -312,9 +311,17 @@ ndBrainLayer* ndBrainLayerConvolutional_2d::Load(const ndBrainLoad* const loadSa
 	loadSave->ReadString(buffer);
 	ndInt32 ouputLayers = loadSave->ReadInt();
 
-	ndBrainLayerConvolutional_2d* const layer = new ndBrainLayerConvolutional_2d(inputWidth, inputHeight, inputLayers, kernelSize, ouputLayers);
-
+	// the layout is only saved for channel last layers
+	ndBrainConvolution::ndLayout layout = ndBrainConvolution::m_channelFirst;
 	loadSave->ReadString(buffer);
+	if (!strcmp(buffer, "channel_last"))
+	{
+		layout = loadSave->ReadInt() ? ndBrainConvolution::m_channelLast : ndBrainConvolution::m_channelFirst;
+		loadSave->ReadString(buffer);
+	}
+
+	ndBrainLayerConvolutional_2d* const layer = new ndBrainLayerConvolutional_2d(inputWidth, inputHeight, inputLayers, kernelSize, ouputLayers, layout);
+
 	for (ndInt32 i = 0; i < ouputLayers; ++i)
 	{
 		ndBrainFloat val = ndBrainFloat(loadSave->ReadFloat());
@@ -340,72 +347,14 @@ ndBrainLayer* ndBrainLayerConvolutional_2d::Load(const ndBrainLoad* const loadSa
 	return layer;
 }
 
-#ifdef ND_CONV_USE_SCALAR
 void ndBrainLayerConvolutional_2d::MakePrediction(const ndBrainVector& input, ndBrainVector& output) const
 {
 	ndAssert(input.GetCount() == GetInputSize());
 
-	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
-	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
 	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
 	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
-
-	ndBrainFloat convKernelBuffer[512];
-	ndBrainMemVector convKernel(convKernelBuffer, kernelSize);
-
-	auto CrossCorrelation = [this, &convKernel](const ndBrainVector& input)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		for (ndInt32 i = m_inputOffsets.GetCount() - 1; i >= 0; --i)
-		{
-			ndInt32 index = m_inputOffsets[i];
-			ndAssert(convKernel[i] < ndBrainFloat(100.0f));
-			ndAssert(convKernel[i] > ndBrainFloat(-100.0f));
-			value += input[index] * convKernel[i];
-		}
-		return value;
-	};
-
-	auto RotateKernel = [&convKernel](const ndBrainVector& kernel)
-	{
-		ndAssert(convKernel.GetCount() == kernel.GetCount());
-		for (ndInt32 i = kernel.GetCount() - 1; i >= 0; --i)
-		{
-			convKernel[kernel.GetCount() - 1 - i] = kernel[i];
-		}
-	};
-
-	ndInt32 outputOffset = 0;
-	ndInt32 kernelOffset = 0;
-	for (ndInt32 i = 0; i < m_outputLayers; ++i)
-	{
-		ndBrainMemVector out(&output[outputOffset], outputSize);
-
-		ndInt32 inputOffset = 0;
-		out.Set(m_bias[i] * biasScale);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			ndInt32 outIndex = 0;
-			ndInt32 inputBase = inputOffset;
-
-			const ndBrainMemVector filter(&m_kernels[kernelOffset], kernelSize);
-			RotateKernel(filter);
-
-			for (ndInt32 y = 0; y < m_outputHeight; ++y)
-			{
-				for (ndInt32 x = 0; x < m_outputWidth; ++x)
-				{
-					const ndBrainMemVector in(&input[inputBase + x], inputSize);
-					out[outIndex] += CrossCorrelation(in);
-					outIndex++;
-				}
-				inputBase += m_inputWidth;
-			}
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-		outputOffset += outputSize;
-	}
+	ndBrainFloat* const scratch = &output[0] + GetOutputSize();
+	m_convolution.Forward(&m_kernels[0], &m_bias[0], biasScale, &input[0], &output[0], scratch);
 }
 
 //void ndBrainLayerConvolutional_2d::InputDerivative(const ndBrainVector& output, const ndBrainVector& outputDerivative, ndBrainVector& inputDerivative) const
@@ -423,505 +372,40 @@ void ndBrainLayerConvolutional_2d::CalculateParamGradients(
 
 	ndAssert(gradients->m_bias.GetCount() == m_outputLayers);
 
-	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
-	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
 	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
 	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
+	ndBrainFloat* const scratch = (ndBrainFloat*)&output[0] + GetOutputSize();
 
-	// calculate bias gradients
-	for (ndInt32 i = 0; i < m_bias.GetCount(); ++i)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		const ndBrainMemVector biasGrad(&outputDerivative[i * outputSize], outputSize);
-		for (ndInt32 j = 0; j < outputSize; ++j)
-		{
-			value += biasGrad[j];
-		}
-		gradients->m_bias[i] = value * biasScale;
-	}
-
-	// calculate filter weight gradients
-	auto CrossCorrelationGradient = [this](const ndBrainVector& input, ndInt32 y0, ndInt32 x0, const ndBrainVector& outputDerivative)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-
-		ndInt32 inputDerivativeBase = 0;
-		ndInt32 inputBase = y0 * m_inputWidth + x0;
-		for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		{
-			const ndBrainMemVector in(&input[inputBase], m_outputWidth);
-			const ndBrainMemVector outputGrad(&outputDerivative[inputDerivativeBase], m_outputWidth);
-			for (ndInt32 x = 0; x < m_outputWidth; ++x)
-			{
-				value += in[x] * outputGrad[x];
-			}
-			inputBase += m_inputWidth;
-			inputDerivativeBase += m_outputWidth;
-		}
-		return value;
-	};
-
-	ndInt32 outputOffset = 0;
-	ndInt32 kernelOffset = 0;
-
-	for (ndInt32 filter = 0; filter < m_outputLayers; ++filter)
-	{
-		ndInt32 inputOffset = 0;
-		const ndBrainMemVector outDerivative(&outputDerivative[outputOffset], outputSize);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			const ndBrainMemVector inputChannel(&input[inputOffset], inputSize);
-			ndBrainMemVector kernelGradients(&gradients->m_kernels[kernelOffset], kernelSize);
-
-			ndInt32 index = kernelSize - 1;
-			for (ndInt32 y = 0; y < m_kernelSize; ++y)
-			{
-				for (ndInt32 x = 0; x < m_kernelSize; ++x)
-				{
-					kernelGradients[index] = CrossCorrelationGradient(inputChannel, y, x, outDerivative);
-					index--;
-				}
-			}
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-		outputOffset += outputSize;
-	}
-
-	// calculate input gradients
-	const ndInt32 paddSizeWidth = m_inputWidth + m_kernelSize - 1;
-	const ndInt32 paddSizeHeight = m_inputHeight + m_kernelSize - 1;
-	ndBrainMemVector paddedGradientOut(&output[0] + GetOutputSize(), paddSizeWidth * paddSizeHeight);
-	paddedGradientOut.Set(ndBrainFloat(0.0f));
-
-	auto CopyOutput = [this, &outputDerivative, &paddedGradientOut](ndInt32 filter)
-	{
-		ndInt32 srcOffset = 0;
-		ndInt32 dstWidth = m_inputWidth + m_kernelSize - 1;
-		ndInt32 outputSize = m_outputWidth * m_outputHeight;
-		ndInt32 dstOffset = dstWidth * (m_kernelSize - 1) + m_kernelSize - 1;
-		const ndBrainMemVector srcGrad(&outputDerivative[filter * outputSize], outputSize);
-		for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		{
-			const ndBrainMemVector src(&srcGrad[srcOffset], m_outputWidth);
-			ndBrainMemVector dst(&paddedGradientOut[dstOffset], m_outputWidth);
-			dst.Set(src);
-			dstOffset += dstWidth;
-			srcOffset += m_outputWidth;
-		}
-	};
-
-	//auto CalculateInpuGradient = [this, &paddedGradientOut](const ndBrainVector& filter, ndBrainVector& output)
-	//{
-	//	auto CrossCorrelation = [this, &filter](const ndBrainVector& input)
-	//	{
-	//		ndBrainFloat value = ndBrainFloat(0.0f);
-	//		for (ndInt32 i = m_inputGradOffsets.GetCount() - 1; i >= 0; --i)
-	//		{
-	//			ndInt32 index = m_inputGradOffsets[i];
-	//			value += input[index] * filter[i];
-	//		}
-	//		return value;
-	//	};
-	//
-	//	ndInt32 outputOffset = 0;
-	//	ndInt32 gradInputOffset = 0;
-	//	const ndInt32 gradInputWidth = m_inputWidth + m_kernelSize - 1;
-	//	const ndInt32 gradInputSize = gradInputWidth * m_kernelSize;
-	//
-	//	for (ndInt32 y = 0; y < m_inputHeight; ++y)
-	//	{
-	//		for (ndInt32 x = 0; x < m_inputWidth; ++x)
-	//		{
-	//			const ndBrainMemVector in(&paddedGradientOut[gradInputOffset + x], gradInputSize);
-	//			output[outputOffset + x] += CrossCorrelation(in);
-	//		}
-	//		outputOffset += m_inputWidth;
-	//		gradInputOffset += gradInputWidth;
-	//	}
-	//};
-
-	auto CrossCorrelation = [this](const ndBrainVector& input, const ndBrainVector& filter)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		for (ndInt32 i = m_inputGradOffsets.GetCount() - 1; i >= 0; --i)
-		{
-			ndInt32 index = m_inputGradOffsets[i];
-			value += input[index] * filter[i];
-		}
-		return value;
-	};
-
-	kernelOffset = 0;
-	ndInt32 inputOffset = 0;
-	const ndInt32 gradInputWidth = m_inputWidth + m_kernelSize - 1;
-	const ndInt32 gradInputSize = gradInputWidth * m_kernelSize;
-
-	inputGradient.Set(ndBrainFloat(0.0f));
-	for (ndInt32 filter = 0; filter < m_outputLayers; ++filter)
-	{
-		inputOffset = 0;
-		CopyOutput(filter);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			ndBrainMemVector inputGrad(&inputGradient[inputOffset], inputSize);
-			const ndBrainMemVector kernelGradients(&m_kernels[kernelOffset], kernelSize);
-			//CalculateInpuGradient(kernelGradients, inputGrad);
-
-			ndInt32 outOffset = 0;
-			ndInt32 gradInputOffset = 0;
-			for (ndInt32 y = 0; y < m_inputHeight; ++y)
-			{
-				for (ndInt32 x = 0; x < m_inputWidth; ++x)
-				{
-					const ndBrainMemVector in(&paddedGradientOut[gradInputOffset + x], gradInputSize);
-					inputGrad[outOffset + x] += CrossCorrelation(in, kernelGradients);
-				}
-				outOffset += m_inputWidth;
-				gradInputOffset += gradInputWidth;
-			}
-
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-	}
+	gradients->m_bias.Set(ndBrainFloat(0.0f));
+	gradients->m_kernels.Set(ndBrainFloat(0.0f));
+	m_convolution.Backward(&m_kernels[0], &input[0], &outputDerivative[0], &inputGradient[0], &gradients->m_kernels[0], &gradients->m_bias[0], scratch);
+	gradients->m_bias.Scale(biasScale);
 }
 
-
-#else
-
-void ndBrainLayerConvolutional_2d::MakePrediction(const ndBrainVector& input, ndBrainVector& output) const
+void ndBrainLayerConvolutional_2d::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
 {
-	ndAssert(input.GetCount() == GetInputSize());
+	ndAssert(input.GetRows() == output.GetRows());
+	ndAssert(input.GetColumns() == GetInputSize());
+	ndAssert(output.GetColumns() == GetOutputSize());
 
-	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
-	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
 	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
 	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
-
-	ndBrainFloat convKernelSimdBuffer[128 * 4];
-	ndBrainFloat4* const  convKernelSimd = (ndBrainFloat4*)&convKernelSimdBuffer[0];
-
-	auto CrossCorrelationSimd = [this, &convKernelSimd](const ndBrainVector& input)
-	{
-		ndBrainFloat4 value(0.0f);
-		for (ndInt32 i = 0; i < (m_inputOffsets.GetCount() & -4); i += 4)
-		{
-			ndInt32 index = m_inputOffsets[i + 0];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 0];
-
-			index = m_inputOffsets[i + 1];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 1];
-
-			index = m_inputOffsets[i + 2];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 2];
-
-			index = m_inputOffsets[i + 3];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 3];
-		}
-		for (ndInt32 i = m_inputOffsets.GetCount() & -4; i < m_inputOffsets.GetCount(); ++i)
-		{
-			ndInt32 index = m_inputOffsets[i];
-			const ndBrainFloat4* const src = (ndBrainFloat4*)&input[index];
-			value = value + src[0] * convKernelSimd[i];
-		}
-		return value;
-	};
-
-	auto CrossCorrelationScalar = [this](const ndBrainVector& input, const ndBrainVector& convKernel)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		ndInt32 flipIndex = 0;
-		for (ndInt32 i = m_inputOffsets.GetCount() - 1; i >= 0; --i)
-		{
-			ndInt32 index = m_inputOffsets[i];
-			ndAssert(convKernel[i] < ndBrainFloat(100.0f));
-			ndAssert(convKernel[i] > ndBrainFloat(-100.0f));
-			value += input[index] * convKernel[flipIndex];
-			flipIndex++;
-		}
-		return value;
-	};
-
-	auto RotateKernelSimd = [convKernelSimd](const ndBrainVector& kernel)
-	{
-		for (ndInt32 i = kernel.GetCount() - 1; i >= 0; --i)
-		{
-			convKernelSimd[kernel.GetCount() - 1 - i] = ndBrainFloat4(kernel[i]);
-		}
-	};
-
-	ndInt32 outputOffset = 0;
-	ndInt32 kernelOffset = 0;
-	const ndInt32 roundedOuputWith = m_outputWidth & -4;
-
-	for (ndInt32 i = 0; i < m_outputLayers; ++i)
-	{
-		ndBrainMemVector out(&output[outputOffset], outputSize);
-
-		ndInt32 inputOffset = 0;
-		out.Set(m_bias[i] * biasScale);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			const ndBrainMemVector filter(&m_kernels[kernelOffset], kernelSize);
-			RotateKernelSimd(filter);
-
-			ndInt32 outOffset = 0;
-			ndInt32 inputBase = inputOffset;
-			for (ndInt32 y = 0; y < m_outputHeight; ++y)
-			{
-				ndInt32 outIndex = 0;
-				ndBrainFloat4* const out4 = (ndBrainFloat4*)&out[outOffset];
-				for (ndInt32 x = 0; x < roundedOuputWith; x += 4)
-				{
-					const ndBrainMemVector in(&input[inputBase + x], inputSize);
-					out4[outIndex] = out4[outIndex] + CrossCorrelationSimd(in);
-					outIndex++;
-				}
-				outIndex *= 4;
-				for (ndInt32 x = roundedOuputWith; x < m_outputWidth; ++x)
-				{
-					const ndBrainMemVector in(&input[inputBase + x], inputSize);
-					out[outOffset + outIndex] += CrossCorrelationScalar(in, filter);
-					outIndex++;
-				}
-				outOffset += m_outputWidth;
-				inputBase += m_inputWidth;
-			}
-
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-		outputOffset += outputSize;
-	}
+	m_convolution.ForwardBatch(m_threadPool, m_batchScratch, &m_kernels[0], &m_bias[0], biasScale, input, output);
 }
 
-//void ndBrainLayerConvolutional_2d::InputDerivative(const ndBrainVector& output, const ndBrainVector& outputDerivative, ndBrainVector& inputDerivative) const
-void ndBrainLayerConvolutional_2d::InputDerivative(const ndBrainVector&, const ndBrainVector&, ndBrainVector&) const
-{
-	ndAssert(0);
-}
-
-void ndBrainLayerConvolutional_2d::CalculateParamGradients(
-	const ndBrainVector& input, const ndBrainVector& output,
-	const ndBrainVector& outputDerivative, ndBrainVector& inputGradient, ndBrainLayer* const gradientOut) const
+void ndBrainLayerConvolutional_2d::CalculateBatchParamGradients(
+	const ndBrainMatrix& input, const ndBrainMatrix&,
+	const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+	ndBrainLayer* const gradientOut, ndBrainLayer* const) const
 {
 	ndAssert(!strcmp(GetLabelId(), gradientOut->GetLabelId()));
 	ndBrainLayerConvolutional_2d* const gradients = (ndBrainLayerConvolutional_2d*)gradientOut;
 
-	ndAssert(gradients->m_bias.GetCount() == m_outputLayers);
-
-	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
-	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
 	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
 	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
 
-	// calculate bias gradients
-	for (ndInt32 i = 0; i < m_bias.GetCount(); ++i)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		const ndBrainMemVector biasGrad(&outputDerivative[i * outputSize], outputSize);
-		for (ndInt32 j = 0; j < outputSize; ++j)
-		{
-			value += biasGrad[j];
-		}
-		gradients->m_bias[i] = value * biasScale;
-	}
-
-	// calculate filter weight gradients
-	auto CrossCorrelationGradient = [this](const ndBrainVector& input, ndInt32 y0, ndInt32 x0, const ndBrainVector& outputDerivative)
-	{
-		//ndBrainFloat value__ = ndBrainFloat(0.0f);
-		//{
-		//	ndInt32 inputDerivativeBase = 0;
-		//	ndInt32 inputBase = y0 * m_inputWidth + x0;
-		//	for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		//	{
-		//		const ndBrainMemVector in(&input[inputBase], m_outputWidth);
-		//		const ndBrainMemVector outputGrad(&outputDerivative[inputDerivativeBase], m_outputWidth);
-		//		for (ndInt32 x = 0; x < m_outputWidth; ++x)
-		//		{
-		//			value__ += in[x] * outputGrad[x];
-		//		}
-		//		inputBase += m_inputWidth;
-		//		inputDerivativeBase += m_outputWidth;
-		//	}
-		//}
-
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		ndBrainFloat4 valueSim (ndBrainFloat(0.0f));
-		ndInt32 inputDerivativeBase = 0;
-		ndInt32 inputBase = y0 * m_inputWidth + x0;
-
-		const ndInt32 outputWidthSimd = m_outputWidth & -4;
-		for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		{
-			const ndBrainMemVector in(&input[inputBase], m_outputWidth);
-			const ndBrainMemVector outputGrad(&outputDerivative[inputDerivativeBase], m_outputWidth);
-			const ndBrainFloat4* const inSimd = (ndBrainFloat4*)&in[0];
-			const ndBrainFloat4* const outputGradSimd = (ndBrainFloat4*)&outputGrad[0];
-			ndInt32 indxSimd = 0;
-			for (ndInt32 x = 0; x < outputWidthSimd; x += 4)
-			{
-				valueSim = valueSim + inSimd[indxSimd] * outputGradSimd[indxSimd];
-				indxSimd++;
-			}
-			for (ndInt32 x = outputWidthSimd; x < m_outputWidth; ++x)
-			{
-				value += in[x] * outputGrad[x];
-			}
-
-			inputBase += m_inputWidth;
-			inputDerivativeBase += m_outputWidth;
-		}
-		value += valueSim.m_x + valueSim.m_y + valueSim.m_z + valueSim.m_w;
-		return value;
-	};
-
-	ndInt32 outputOffset = 0;
-	ndInt32 kernelOffset = 0;
-	for (ndInt32 filter = 0; filter < m_outputLayers; ++filter)
-	{
-		ndInt32 inputOffset = 0;
-		const ndBrainMemVector outDerivative(&outputDerivative[outputOffset], outputSize);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			const ndBrainMemVector inputChannel(&input[inputOffset], inputSize);
-			ndBrainMemVector kernelGradients(&gradients->m_kernels[kernelOffset], kernelSize);
-
-			ndInt32 index = kernelSize - 1;
-			for (ndInt32 y = 0; y < m_kernelSize; ++y)
-			{
-				for (ndInt32 x = 0; x < m_kernelSize; ++x)
-				{
-					kernelGradients[index] = CrossCorrelationGradient(inputChannel, y, x, outDerivative);
-					index--;
-				}
-			}
-			
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-		outputOffset += outputSize;
-	}
-
-	// calculate input gradients
-	ndBrainFloat convKernelSimdBuffer[128 * 4];
-	ndBrainFloat4* const  convKernelSimd = (ndBrainFloat4*)&convKernelSimdBuffer[0];
-
-	const ndInt32 paddSizeWidth = m_inputWidth + m_kernelSize - 1;
-	const ndInt32 paddSizeHeight = m_inputHeight + m_kernelSize - 1;
-	ndBrainMemVector paddedGradientOut(&output[0] + GetOutputSize(), paddSizeWidth * paddSizeHeight);
-	paddedGradientOut.Set(ndBrainFloat(0.0f));
-
-	auto RotateKernelSimd = [convKernelSimd](const ndBrainVector& kernel)
-	{
-		for (ndInt32 i = kernel.GetCount() - 1; i >= 0; --i)
-		{
-			convKernelSimd[i] = ndBrainFloat4(kernel[i]);
-		}
-	};
-
-	auto CopyOutput = [this, &outputDerivative, &paddedGradientOut](ndInt32 filter)
-	{
-		ndInt32 srcOffset = 0;
-		ndInt32 dstWidth = m_inputWidth + m_kernelSize - 1;
-		ndInt32 outputSize = m_outputWidth * m_outputHeight;
-		ndInt32 dstOffset = dstWidth * (m_kernelSize - 1) + m_kernelSize - 1;
-		const ndBrainMemVector srcGrad(&outputDerivative[filter * outputSize], outputSize);
-		for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		{
-			const ndBrainMemVector src(&srcGrad[srcOffset], m_outputWidth);
-			ndBrainMemVector dst(&paddedGradientOut[dstOffset], m_outputWidth);
-			dst.Set(src);
-			dstOffset += dstWidth;
-			srcOffset += m_outputWidth;
-		}
-	};
-
-	auto CrossCorrelationScalar = [this](const ndBrainVector& input, const ndBrainVector& filter)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		for (ndInt32 i = 0; i < m_inputGradOffsets.GetCount(); ++i)
-		{
-			ndInt32 index = m_inputGradOffsets[i];
-			value += input[index] * filter[i];
-		}
-		return value;
-	};
-
-	auto CrossCorrelationSimd = [this, &convKernelSimd](const ndBrainVector& input)
-	{
-		ndBrainFloat4 value(0.0f);
-		for (ndInt32 i = 0; i < (m_inputGradOffsets.GetCount() & -4); i += 4)
-		{
-			ndInt32 index = m_inputGradOffsets[i + 0];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 0];
-
-			index = m_inputGradOffsets[i + 1];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 1];
-
-			index = m_inputGradOffsets[i + 2];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 2];
-
-			index = m_inputGradOffsets[i + 3];
-			value = value + ((ndBrainFloat4&)input[index]) * convKernelSimd[i + 3];
-		}
-		for (ndInt32 i = m_inputGradOffsets.GetCount() & -4; i < m_inputGradOffsets.GetCount(); ++i)
-		{
-			ndInt32 index = m_inputGradOffsets[i];
-			const ndBrainFloat4* const src = (ndBrainFloat4*)&input[index];
-			value = value + src[0] * convKernelSimd[i];
-		}
-		return value;
-	};
-
-	kernelOffset = 0;
-	ndInt32 inputOffset = 0;
-	const ndInt32 gradInputWidth = m_inputWidth + m_kernelSize - 1;
-	const ndInt32 gradInputSize = gradInputWidth * m_kernelSize;
-	const ndInt32 roundedInputWith = m_inputWidth & -4;
-
-	inputGradient.Set(ndBrainFloat(0.0f));
-	for (ndInt32 filter = 0; filter < m_outputLayers; ++filter)
-	{
-		inputOffset = 0;
-		CopyOutput(filter);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			ndBrainMemVector inputGrad(&inputGradient[inputOffset], inputSize);
-			const ndBrainMemVector kernelGradients(&m_kernels[kernelOffset], kernelSize);
-
-			ndInt32 outOffset = 0;
-			ndInt32 gradInputOffset = 0;
-			RotateKernelSimd(kernelGradients);
-			for (ndInt32 y = 0; y < m_inputHeight; ++y)
-			{
-				ndInt32 outIndex = 0;
-				ndBrainFloat4* const out4 = (ndBrainFloat4*)&inputGrad[outOffset];
-				for (ndInt32 x = 0; x < roundedInputWith; x += 4)
-				{
-					const ndBrainMemVector in(&paddedGradientOut[gradInputOffset + x], gradInputSize);
-					out4[outIndex] = out4[outIndex] + CrossCorrelationSimd(in);
-					outIndex++;
-				}
-				outIndex *= 4;
-				for (ndInt32 x = roundedInputWith; x < m_inputWidth; ++x)
-				{
-					const ndBrainMemVector in(&paddedGradientOut[gradInputOffset + x], gradInputSize);
-					inputGrad[outOffset + outIndex] += CrossCorrelationScalar(in, kernelGradients);
-					outIndex++;
-				}
-				outOffset += m_inputWidth;
-				gradInputOffset += gradInputWidth;
-			}
-
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-	}
+	gradients->m_bias.Set(ndBrainFloat(0.0f));
+	gradients->m_kernels.Set(ndBrainFloat(0.0f));
+	m_convolution.BackwardBatch(m_threadPool, m_batchScratch, &m_kernels[0], input, outputDerivative, inputGradient, &gradients->m_kernels[0], &gradients->m_bias[0]);
+	gradients->m_bias.Scale(biasScale);
 }
-
-#endif
-
-
@@ -21,14 +21,16 @@
 
 #include "ndBrainStdafx.h"
 #include "ndBrainSaveLoad.h"
+#include "ndBrainThreadPool.h"
 #include "ndBrainLayerCrossCorrelation_2d.h"
 
-ndBrainLayerCrossCorrelation_2d::ndBrainLayerCrossCorrelation_2d(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputDepth, ndInt32 kernelSize, ndInt32 numberOfKernels)
+ndBrainLayerCrossCorrelation_2d::ndBrainLayerCrossCorrelation_2d(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputDepth, ndInt32 kernelSize, ndInt32 numberOfKernels, ndBrainConvolution::ndLayout layout)
 	:ndBrainLayer()
 	,m_bias()
 	,m_kernels()
-	,m_inputOffsets()
-	,m_inputGradOffsets()
+	,m_convolution(inputWidth, inputHeight, inputDepth, kernelSize, numberOfKernels, false, layout)
+	,m_threadPool(nullptr)
+	,m_batchScratch()
 	,m_kernelSize(kernelSize)
 	,m_inputWidth(inputWidth)
 	,m_inputHeight(inputHeight)
@@ -47,27 +49,15 @@ ndBrainLayerCrossCorrelation_2d::ndBrainLayerCrossCorrelation_2d(ndInt32 inputWi
 
 	m_bias.Set(ndBrainFloat(0.0f));
 	m_kernels.Set(ndBrainFloat(0.0f));
-
-	ndInt32 inputOffset = 0;
-	ndInt32 inputGradOffset = 0;
-	for (ndInt32 j = 0; j < m_kernelSize; ++j)
-	{
-		for (ndInt32 i = 0; i < m_kernelSize; ++i)
-		{
-			m_inputOffsets.PushBack(inputOffset + i);
-			m_inputGradOffsets.PushBack(inputGradOffset + i);
-		}
-		inputOffset += m_inputWidth;
-		inputGradOffset += m_inputWidth + m_kernelSize - 1;
-	}
 }
 
 ndBrainLayerCrossCorrelation_2d::ndBrainLayerCrossCorrelation_2d(const ndBrainLayerCrossCorrelation_2d& src)
 	:ndBrainLayer(src)
 	,m_bias(src.m_bias)
 	,m_kernels(src.m_kernels)
-	,m_inputOffsets(src.m_inputOffsets)
-	,m_inputGradOffsets(src.m_inputGradOffsets)
+	,m_convolution(src.m_convolution)
+	,m_threadPool(src.m_threadPool)
+	,m_batchScratch()
 	,m_kernelSize(src.m_kernelSize)
 	,m_inputWidth(src.m_inputWidth)
 	,m_inputHeight(src.m_inputHeight)
@@ -99,10 +89,8 @@ ndInt32 ndBrainLayerCrossCorrelation_2d::GetOutputSize() const
 
 ndInt32 ndBrainLayerCrossCorrelation_2d::GetOutputBufferSize() const
 {
-	ndInt32 size = GetOutputSize();
-	ndInt32 paddSizeWidth = m_inputWidth + m_kernelSize - 1;
-	ndInt32 paddSizeHeight = m_inputHeight + m_kernelSize - 1;
-	return size + paddSizeWidth * paddSizeHeight;
+	// the scratch memory of the convolution goes after the output
+	return GetOutputSize() + m_convolution.GetScratchSize();
 }
 
 ndInt32 ndBrainLayerCrossCorrelation_2d::GetInputSize() const
@@ -125,6 +113,16 @@ ndInt32 ndBrainLayerCrossCorrelation_2d::GetOutputChannels() const
 	return m_outputLayers;
 }
 
+ndBrainConvolution::ndLayout ndBrainLayerCrossCorrelation_2d::GetLayout() const
+{
+	return m_convolution.GetLayout();
+}
+
+void ndBrainLayerCrossCorrelation_2d::SetThreadPool(ndBrainThreadPool* const threadPool)
+{
+	m_threadPool = threadPool;
+}
+
 ndInt32 ndBrainLayerCrossCorrelation_2d::GetNumberOfParameters() const
 {
 	return m_bias.GetCount() + m_kernelSize * m_kernelSize * m_inputLayers * m_outputLayers;
@@ -257,6 +255,10 @@ void ndBrainLayerCrossCorrelation_2d::Save(const ndBrainSave* const loadSave) co
 	Save("\tinput_layers %d\n", m_inputLayers);
 	Save("\tkernel_Size %d\n", m_kernelSize);
 	Save("\touput_layers %d\n", m_outputLayers);
+	if (m_convolution.GetLayout() == ndBrainConvolution::m_channelLast)
+	{
+		Save("\tchannel_last 1\n");
+	}
 
 	Save("\tbias ");
 	for (ndInt32 i = 0; i < m_bias.GetCount(); ++i)
@@ -305,9 +307,17 @@ ndBrainLayer* ndBrainLayerCrossCorrelation_2d::Load(const ndBrainLoad* const loa
 	loadSave->ReadString(buffer);
 	ndInt32 ouputLayers = loadSave->ReadInt();
 
-	ndBrainLayerCrossCorrelation_2d* const layer = new ndBrainLayerCrossCorrelation_2d(inputWidth, inputHeight, inputLayers, kernelSize, ouputLayers);
-
+	// the layout is only saved for channel last layers
+	ndBrainConvolution::ndLayout layout = ndBrainConvolution::m_channelFirst;
 	loadSave->ReadString(buffer);
+	if (!strcmp(buffer, "channel_last"))
+	{
+		layout = loadSave->ReadInt() ? ndBrainConvolution::m_channelLast : ndBrainConvolution::m_channelFirst;
+		loadSave->ReadString(buffer);
+	}
+
+	ndBrainLayerCrossCorrelation_2d* const layer = new ndBrainLayerCrossCorrelation_2d(inputWidth, inputHeight, inputLayers, kernelSize, ouputLayers, layout);
+
 	for (ndInt32 i = 0; i < ouputLayers; ++i)
 	{
 		ndBrainFloat val = ndBrainFloat(loadSave->ReadFloat());
@@ -337,54 +347,10 @@ void ndBrainLayerCrossCorrelation_2d::MakePrediction(const ndBrainVector& input,
 {
 	ndAssert(input.GetCount() == GetInputSize());
 
-	ndInt32 outputOffset = 0;
-	ndInt32 kernelOffset = 0;
-	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
-	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
 	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
-	auto CrossCorrelation = [this](const ndBrainVector& input, const ndBrainVector& kernel)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		for (ndInt32 i = m_inputOffsets.GetCount() - 1; i >= 0; --i)
-		{
-			ndInt32 index = m_inputOffsets[i];
-			ndAssert(kernel[i] < ndBrainFloat(100.0f));
-			ndAssert(kernel[i] > ndBrainFloat(-100.0f));
-			value += input[index] * kernel[i];
-		}
-		return value;
-	};
-
 	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
-
-	for (ndInt32 i = 0; i < m_outputLayers; ++i)
-	{
-		ndBrainMemVector out(&output[outputOffset], outputSize);
-
-		out.Set(m_bias[i] * biasScale);
-
-		ndInt32 inputOffset = 0;
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			ndInt32 outIndex = 0;
-			ndInt32 inputBase = inputOffset;
-			const ndBrainMemVector filter(&m_kernels[kernelOffset], kernelSize);
-
-			for (ndInt32 y = 0; y < m_outputHeight; ++y)
-			{
-				for (ndInt32 x = 0; x < m_outputWidth; ++x)
-				{
-					const ndBrainMemVector in(&input[inputBase + x], inputSize);
-					out[outIndex] += CrossCorrelation(in, filter);
-					outIndex++;
-				}
-				inputBase += m_inputWidth;
-			}
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-		outputOffset += outputSize;
-	}
+	ndBrainFloat* const scratch = &output[0] + GetOutputSize();
+	m_convolution.Forward(&m_kernels[0], &m_bias[0], biasScale, &input[0], &output[0], scratch);
 }
 
 //void ndBrainLayerCrossCorrelation_2d::InputDerivative(const ndBrainVector& output, const ndBrainVector& outputDerivative, ndBrainVector& inputDerivative) const
@@ -402,147 +368,40 @@ void ndBrainLayerCrossCorrelation_2d::CalculateParamGradients(
 
 	ndAssert(gradients->m_bias.GetCount() == m_outputLayers);
 
-	const ndInt32 inputSize = m_inputWidth * m_inputHeight;
-	const ndInt32 kernelSize = m_kernelSize * m_kernelSize;
 	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
 	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
+	ndBrainFloat* const scratch = (ndBrainFloat*)&output[0] + GetOutputSize();
 
-	// calculate bias gradients
-	for (ndInt32 i = 0; i < m_bias.GetCount(); ++i)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-		const ndBrainMemVector biasGrad(&outputDerivative[i * outputSize], outputSize);
-		for (ndInt32 j = 0; j < outputSize; ++j)
-		{
-			value += biasGrad[j];
-		}
-		gradients->m_bias[i] = value * biasScale;
-	}
-	
-	// calculate filter weight gradients
-	auto CrossCorrelationGradient = [this](const ndBrainVector& input, ndInt32 y0, ndInt32 x0, const ndBrainVector& outputDerivative)
-	{
-		ndBrainFloat value = ndBrainFloat(0.0f);
-
-		ndInt32 inputDerivativeBase = 0;
-		ndInt32 inputBase = y0 * m_inputWidth + x0;
-		for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		{
-			const ndBrainMemVector in(&input[inputBase], m_outputWidth);
-			const ndBrainMemVector outputGrad(&outputDerivative[inputDerivativeBase], m_outputWidth);
-			for (ndInt32 x = 0; x < m_outputWidth; ++x)
-			{
-				value += in[x] * outputGrad[x];
-			}
-			inputBase += m_inputWidth;
-			inputDerivativeBase += m_outputWidth;
-		}
-		return value;
-	};
-	
-	ndInt32 outputOffset = 0;
-	ndInt32 kernelOffset = 0;
-	for (ndInt32 filter = 0; filter < m_outputLayers; ++filter)
-	{
-		ndInt32 inputOffset = 0;
-		const ndBrainMemVector outDerivative(&outputDerivative[outputOffset], outputSize);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			const ndBrainMemVector inputChannel(&input[inputOffset], inputSize);
-			ndBrainMemVector kernelGradients(&gradients->m_kernels[kernelOffset], kernelSize);
-
-			ndInt32 index = 0;
-			for (ndInt32 y = 0; y < m_kernelSize; ++y)
-			{
-				for (ndInt32 x = 0; x < m_kernelSize; ++x)
-				{
-					kernelGradients[index] = CrossCorrelationGradient(inputChannel, y, x, outDerivative);
-					index++;
-				}
-			}
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-		outputOffset += outputSize;
-	}
+	gradients->m_bias.Set(ndBrainFloat(0.0f));
+	gradients->m_kernels.Set(ndBrainFloat(0.0f));
+	m_convolution.Backward(&m_kernels[0], &input[0], &outputDerivative[0], &inputGradient[0], &gradients->m_kernels[0], &gradients->m_bias[0], scratch);
+	gradients->m_bias.Scale(biasScale);
+}
 
-	// calculate input gradients
-	const ndInt32 paddSizeWidth = m_inputWidth + m_kernelSize - 1;
-	const ndInt32 paddSizeHeight = m_inputHeight + m_kernelSize - 1;
-	ndBrainMemVector paddedGradientOut(&output[0] + GetOutputSize(), paddSizeWidth * paddSizeHeight);
-	paddedGradientOut.Set(ndBrainFloat(0.0f));
+void ndBrainLayerCrossCorrelation_2d::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	ndAssert(input.GetColumns() == GetInputSize());
+	ndAssert(output.GetColumns() == GetOutputSize());
 
-	auto CopyOutput = [this, &outputDerivative, &paddedGradientOut](ndInt32 filter)
-	{
-		ndInt32 srcOffset = 0;
-		ndInt32 dstWidth = m_inputWidth + m_kernelSize - 1;
-		ndInt32 outputSize = m_outputWidth * m_outputHeight;
-		ndInt32 dstOffset = dstWidth * (m_kernelSize - 1) + m_kernelSize - 1;
-		const ndBrainMemVector srcGrad(&outputDerivative[filter * outputSize], outputSize);
-		for (ndInt32 y = 0; y < m_outputHeight; ++y)
-		{
-			const ndBrainMemVector src(&srcGrad[srcOffset], m_outputWidth);
-			//ndBrainMemVector dst(&m_paddedGradientOut[dstOffset], m_outputWidth);
-			ndBrainMemVector dst(&paddedGradientOut[dstOffset], m_outputWidth);
-			dst.Set(src);
-			dstOffset += dstWidth;
-			srcOffset += m_outputWidth;
-		}
-	};
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
+	m_convolution.ForwardBatch(m_threadPool, m_batchScratch, &m_kernels[0], &m_bias[0], biasScale, input, output);
+}
 
-	ndBrainFloat convKernelBuffer[256];
-	auto CalculateInpuGradient = [this, &convKernelBuffer, &paddedGradientOut](const ndBrainVector& filter, ndBrainVector& output)
-	{
-		auto CrossCorrelation = [this](const ndBrainVector& input, const ndBrainVector& convKernel)
-		{
-			ndBrainFloat value = ndBrainFloat(0.0f);
-			for (ndInt32 i = m_inputGradOffsets.GetCount() - 1; i >= 0 ; --i)
-			{
-				ndInt32 index = m_inputGradOffsets[i];
-				value += input[index] * convKernel[i];
-			}
-			return value;
-		};
-		
-		ndInt32 outputOffset = 0;
-		ndInt32 gradInputOffset = 0;
-		const ndInt32 gradInputWidth = m_inputWidth + m_kernelSize - 1;
-		const ndInt32 gradInputSize = gradInputWidth * m_kernelSize;
-
-		ndBrainMemVector convKernel(convKernelBuffer, m_kernelSize * m_kernelSize);
-		for (ndInt32 i = filter.GetCount() - 1; i >= 0; --i)
-		{
-			convKernel[filter.GetCount() - 1 - i] = filter[i];
-		}
+void ndBrainLayerCrossCorrelation_2d::CalculateBatchParamGradients(
+	const ndBrainMatrix& input, const ndBrainMatrix&,
+	const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+	ndBrainLayer* const gradientOut, ndBrainLayer* const) const
+{
+	ndAssert(!strcmp(GetLabelId(), gradientOut->GetLabelId()));
+	ndBrainLayerCrossCorrelation_2d* const gradients = (ndBrainLayerCrossCorrelation_2d*)gradientOut;
 
-		for (ndInt32 y = 0; y < m_inputHeight; ++y)
-		{
-			for (ndInt32 x = 0; x < m_inputWidth; ++x)
-			{
-				//const ndBrainMemVector in(&m_paddedGradientOut[gradInputOffset + x], gradInputSize);
-				const ndBrainMemVector in(&paddedGradientOut[gradInputOffset + x], gradInputSize);
-				output[outputOffset + x] += CrossCorrelation(in, convKernel);
-			}
-			outputOffset += m_inputWidth;
-			gradInputOffset += gradInputWidth;
-		}
-	};
+	const ndInt32 outputSize = m_outputWidth * m_outputHeight;
+	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(m_inputLayers * outputSize);
 
-	kernelOffset = 0;
-	ndInt32 inputOffset = 0;
-	inputGradient.Set(ndBrainFloat(0.0f));
-	for (ndInt32 filter = 0; filter < m_outputLayers; ++filter)
-	{
-		inputOffset = 0;
-		CopyOutput(filter);
-		for (ndInt32 channel = 0; channel < m_inputLayers; ++channel)
-		{
-			ndBrainMemVector inputGrad(&inputGradient[inputOffset], inputSize);
-			const ndBrainMemVector kernelGradients(&m_kernels[kernelOffset], kernelSize);
-			CalculateInpuGradient(kernelGradients, inputGrad);
-			inputOffset += inputSize;
-			kernelOffset += kernelSize;
-		}
-	}
+	gradients->m_bias.Set(ndBrainFloat(0.0f));
+	gradients->m_kernels.Set(ndBrainFloat(0.0f));
+	m_convolution.BackwardBatch(m_threadPool, m_batchScratch, &m_kernels[0], input, outputDerivative, inputGradient, &gradients->m_kernels[0], &gradients->m_bias[0]);
+	gradients->m_bias.Scale(biasScale);
 }
-
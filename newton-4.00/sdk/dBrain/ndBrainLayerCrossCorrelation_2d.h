@@ -26,11 +26,12 @@
 #include "ndBrainLayer.h"
 #include "ndBrainVector.h"
 #include "ndBrainMatrix.h"
+#include "ndBrainConvolution.h"
 
 class ndBrainLayerCrossCorrelation_2d : public ndBrainLayer
 {
 	public: 
-	ndBrainLayerCrossCorrelation_2d(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputLayers, ndInt32 kernelSize, ndInt32 ouputLayers);
+	ndBrainLayerCrossCorrelation_2d(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputLayers, ndInt32 kernelSize, ndInt32 ouputLayers, ndBrainConvolution::ndLayout layout = ndBrainConvolution::m_channelFirst);
 	ndBrainLayerCrossCorrelation_2d(const ndBrainLayerCrossCorrelation_2d& src);
 	virtual ~ndBrainLayerCrossCorrelation_2d();
 	virtual ndBrainLayer* Clone() const;
@@ -38,6 +39,11 @@ class ndBrainLayerCrossCorrelation_2d : public ndBrainLayer
 	ndInt32 GetOutputWidth() const;
 	ndInt32 GetOutputHeight() const;
 	ndInt32 GetOutputChannels() const;
+	ndBrainConvolution::ndLayout GetLayout() const;
+
+	// the batch functions split the work over the threads of the pool, if one is set.
+	// they reuse the layer scratch, so a layer can only run one batch at a time.
+	virtual void SetThreadPool(ndBrainThreadPool* const threadPool);
 
 	virtual bool HasParameters() const;
 	virtual ndInt32 GetOutputSize() const;
@@ -58,6 +64,12 @@ class ndBrainLayerCrossCorrelation_2d : public ndBrainLayer
 		const ndBrainVector& input, const ndBrainVector& output,
 		const ndBrainVector& outputDerivative, ndBrainVector& inputGradient, ndBrainLayer* const gradientOut) const;
 
+	virtual void MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const;
+	virtual void CalculateBatchParamGradients(
+		const ndBrainMatrix& input, const ndBrainMatrix& output,
+		const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+		ndBrainLayer* const gradientOut, ndBrainLayer* const sampleGradient) const;
+
 	virtual void Save(const ndBrainSave* const loadSave) const;
 	static ndBrainLayer* Load(const ndBrainLoad* const loadSave);
 
@@ -70,14 +82,15 @@ class ndBrainLayerCrossCorrelation_2d : public ndBrainLayer
 	virtual void Blend(const ndBrainLayer& src, ndBrainFloat blend);
 	virtual void ScaleAdd(const ndBrainLayer& src, ndBrainFloat scale);
 
-	private:
+	protected:
 	void InitGaussianBias(ndBrainFloat variance);
 	void InitGaussianWeights(ndBrainFloat variance);
 
 	ndBrainVector m_bias;
 	ndBrainVector m_kernels;
-	ndFixSizeArray<ndInt32, 128> m_inputOffsets;
-	ndFixSizeArray<ndInt32, 128> m_inputGradOffsets;
+	ndBrainConvolution m_convolution;
+	ndBrainThreadPool* m_threadPool;
+	mutable ndBrainVector m_batchScratch;
 
 	ndInt32 m_kernelSize;
 
@@ -88,6 +101,8 @@ class ndBrainLayerCrossCorrelation_2d : public ndBrainLayer
 	ndInt32 m_outputWidth;
 	ndInt32 m_outputHeight;
 	ndInt32 m_outputLayers;
+
+	friend class ndBrainBinaryFile;
 };
 
 #endif 
@@ -23,11 +23,12 @@
 #include "ndBrainSaveLoad.h"
 #include "ndBrainLayerImagePolling_2x2.h"
 
-ndBrainLayerImagePolling_2x2::ndBrainLayerImagePolling_2x2(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputLayers)
+ndBrainLayerImagePolling_2x2::ndBrainLayerImagePolling_2x2(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputLayers, ndBrainConvolution::ndLayout layout)
 	:ndBrainLayerActivation(((inputWidth + 1) / 2) * ((inputHeight + 1) / 2) * inputLayers)
 	,m_width(inputWidth)
 	,m_height(inputHeight)
 	,m_channels(inputLayers)
+	,m_layout(layout)
 {
 }
 
@@ -36,6 +37,7 @@ ndBrainLayerImagePolling_2x2::ndBrainLayerImagePolling_2x2(const ndBrainLayerIma
 	,m_width(src.m_width)
 	,m_height(src.m_height)
 	,m_channels(src.m_channels)
+	,m_layout(src.m_layout)
 {
 }
 
@@ -69,6 +71,11 @@ ndInt32 ndBrainLayerImagePolling_2x2::GetOutputChannels() const
 	return m_channels;
 }
 
+ndBrainConvolution::ndLayout ndBrainLayerImagePolling_2x2::GetLayout() const
+{
+	return m_layout;
+}
+
 ndInt32 ndBrainLayerImagePolling_2x2::GetInputSize() const
 {
 	return m_width * m_height * m_channels;
@@ -102,6 +109,12 @@ void ndBrainLayerImagePolling_2x2::Save(const ndBrainSave* const loadSave) const
 
 	sprintf(buffer, "\tinput_layers %d\n", m_channels);
 	loadSave->WriteData(buffer);
+
+	if (m_layout == ndBrainConvolution::m_channelLast)
+	{
+		sprintf(buffer, "\tchannel_last 1\n");
+		loadSave->WriteData(buffer);
+	}
 }
 
 ndBrainLayer* ndBrainLayerImagePolling_2x2::Load(const ndBrainLoad* const loadSave)
@@ -118,8 +131,16 @@ ndBrainLayer* ndBrainLayerImagePolling_2x2::Load(const ndBrainLoad* const loadSa
 	loadSave->ReadString(buffer);
 	ndInt32 inputLayers = loadSave->ReadInt();
 
-	ndBrainLayerImagePolling_2x2* const layer = new ndBrainLayerImagePolling_2x2(inputWidth, inputHeight, inputLayers);
+	// the layout is only saved for channel last layers
+	ndBrainConvolution::ndLayout layout = ndBrainConvolution::m_channelFirst;
 	loadSave->ReadString(buffer);
+	if (!strcmp(buffer, "channel_last"))
+	{
+		layout = loadSave->ReadInt() ? ndBrainConvolution::m_channelLast : ndBrainConvolution::m_channelFirst;
+		loadSave->ReadString(buffer);
+	}
+
+	ndBrainLayerImagePolling_2x2* const layer = new ndBrainLayerImagePolling_2x2(inputWidth, inputHeight, inputLayers, layout);
 	return layer;
 }
 
@@ -129,98 +150,60 @@ void ndBrainLayerImagePolling_2x2::MakePrediction(const ndBrainVector& input, nd
 	ndAssert(output.GetCount() == GetOutputSize());
 	
 	const ndBrainFloat minValue = ndBrainFloat(-1.0e20f);
-	const ndInt32 inputSize = m_height * m_width;
 	const ndInt32 outputSize = GetOutputSize();
-	
-	ndInt32 offsetOut = 0;
-	ndInt32 inputOffset = 0;
+	const ndInt32 outputWidth = GetOutputWidth();
+	const ndInt32 outputHeight = GetOutputHeight();
+
+	// the same loop serves both layouts, only the strides change
+	const bool channelFirst = (m_layout == ndBrainConvolution::m_channelFirst);
+	const ndInt32 inputChannelStride = channelFirst ? m_width * m_height : 1;
+	const ndInt32 inputPixelStride = channelFirst ? 1 : m_channels;
+	const ndInt32 inputRowStride = m_width * inputPixelStride;
+	const ndInt32 outputChannelStride = channelFirst ? outputWidth * outputHeight : 1;
+	const ndInt32 outputPixelStride = channelFirst ? 1 : m_channels;
+	const ndInt32 outputRowStride = outputWidth * outputPixelStride;
 
 	ndInt32* const maxIndex = (ndInt32*)(&output[0] + outputSize);
 	for (ndInt32 k = 0; k < m_channels; ++k)
 	{
-		ndInt32 inputStride = 0;
-		const ndBrainMemVector in(&input[inputOffset], inputSize);
-	
-		if (((m_height & 1) == 0) && ((m_width & 1) == 0))
+		for (ndInt32 y = 0; y < outputHeight; ++y)
 		{
-			for (ndInt32 y = 0; y < m_height; y += 2)
+			// the last row and column of odd sized images have no neighbor
+			const bool yMask = (y * 2 + 1) < m_height;
+			for (ndInt32 x = 0; x < outputWidth; ++x)
 			{
-				for (ndInt32 x = 0; x < m_width; x += 2)
-				{
-					const ndInt32 x0 = inputStride + x;
-					const ndInt32 x1 = x0 + 1;
-					const ndInt32 x2 = x0 + m_width;
-					const ndInt32 x3 = x2 + 1;
+				const bool xMask = (x * 2 + 1) < m_width;
 	
-					const ndBrainFloat val0 = in[x0];
-					const ndBrainFloat val1 = in[x1];
-					const ndBrainFloat val2 = in[x2];
-					const ndBrainFloat val3 = in[x3];
+				const ndInt32 x0 = k * inputChannelStride + y * 2 * inputRowStride + x * 2 * inputPixelStride;
+				const ndInt32 x1 = xMask ? x0 + inputPixelStride : x0;
+				const ndInt32 x2 = yMask ? x0 + inputRowStride : x0;
+				const ndInt32 x3 = yMask ? x1 + inputRowStride : x1;
 	
-					const bool test01 = val0 >= val1;
-					const ndInt32 index01 = test01 ? x0 : x1;
-					const ndBrainFloat val01 = test01 ? val0 : val1;
+				const ndBrainFloat val0 = input[x0];
+				const ndBrainFloat val1 = xMask ? input[x1] : minValue;
+				const ndBrainFloat val2 = yMask ? input[x2] : minValue;
+				const ndBrainFloat val3 = (xMask && yMask) ? input[x3] : minValue;
 	
-					const bool test23 = val2 >= val3;
-					const ndInt32 index23 = test23 ? x2 : x3;
-					const ndBrainFloat val23 = test23 ? val2 : val3;
+				const bool test01 = val0 >= val1;
+				const ndInt32 index01 = test01 ? x0 : x1;
+				const ndBrainFloat val01 = test01 ? val0 : val1;
 	
-					const bool test0123 = val01 >= val23;
-					const ndInt32 index0123 = test0123 ? index01 : index23;
-					const ndBrainFloat val0123 = test0123 ? val01 : val23;
+				const bool test23 = val2 >= val3;
+				const ndInt32 index23 = test23 ? x2 : x3;
+				const ndBrainFloat val23 = test23 ? val2 : val3;
 	
-					output[offsetOut + (x >> 1)] = val0123;
-					maxIndex[offsetOut + (x >> 1)] = inputOffset + index0123;
-				}
+				const bool test0123 = val01 >= val23;
+				const ndInt32 index0123 = test0123 ? index01 : index23;
+				const ndBrainFloat val0123 = test0123 ? val01 : val23;
 	
-				inputStride += m_width * 2;
-				offsetOut += m_width >> 1;
+				const ndInt32 outIndex = k * outputChannelStride + y * outputRowStride + x * outputPixelStride;
+				output[outIndex] = val0123;
+				maxIndex[outIndex] = index0123;
 			}
 		}
-		else
-		{
-			for (ndInt32 y = 0; y < m_height; y += 2)
-			{
-				ndInt32 yMask = (y + 1) < m_width;
-				for (ndInt32 x = 0; x < m_width; x += 2)
-				{
-					const ndInt32 xMask = (x + 1) < m_width;
-	
-					const ndInt32 x0 = inputStride + x;
-					const ndInt32 x1 = x0 + 1;
-					const ndInt32 x2 = x0 + m_width;
-					const ndInt32 x3 = x2 + 1;
-	
-					const ndBrainFloat val0 = in[x0];
-					const ndBrainFloat val1 = xMask ? in[x1] : minValue;
-					const ndBrainFloat val2 = yMask ? in[x2] : minValue;
-					const ndBrainFloat val3 = (xMask & yMask) ? in[x3] : minValue;
-	
-					const bool test01 = val0 >= val1;
-					const ndInt32 index01 = test01 ? x0 : x1;
-					const ndBrainFloat val01 = test01 ? val0 : val1;
-	
-					const bool test23 = val2 >= val3;
-					const ndInt32 index23 = test23 ? x2 : x3;
-					const ndBrainFloat val23 = test23 ? val2 : val3;
-	
-					const bool test0123 = val01 >= val23;
-					const ndInt32 index0123 = test0123 ? index01 : index23;
-					const ndBrainFloat val0123 = test0123 ? val01 : val23;
-	
-					output[offsetOut + (x >> 1)] = val0123;
-					maxIndex[offsetOut + (x >> 1)] = inputOffset + index0123;
-				}
-	
-				inputStride += m_width * 2;
-				offsetOut += (m_width + 1) >> 1;
-			}
-		}
-		inputOffset += inputSize;
 	}
 }
 
-
 void ndBrainLayerImagePolling_2x2::InputDerivative(const ndBrainVector& output, const ndBrainVector& outputDerivative, ndBrainVector& inputDerivative) const
 {
 	//ndAssert(m_index.GetCount() == outputDerivative.GetCount());
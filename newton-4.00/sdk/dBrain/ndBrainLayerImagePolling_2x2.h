@@ -24,11 +24,12 @@
 
 #include "ndBrainStdafx.h"
 #include "ndBrainLayerActivation.h"
+#include "ndBrainConvolution.h"
 
 class ndBrainLayerImagePolling_2x2 : public ndBrainLayerActivation
 {
 	public:
-	ndBrainLayerImagePolling_2x2(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputDepth);
+	ndBrainLayerImagePolling_2x2(ndInt32 inputWidth, ndInt32 inputHeight, ndInt32 inputDepth, ndBrainConvolution::ndLayout layout = ndBrainConvolution::m_channelFirst);
 	ndBrainLayerImagePolling_2x2(const ndBrainLayerImagePolling_2x2& src);
 	ndBrainLayer* Clone() const;
 	static ndBrainLayer* Load(const ndBrainLoad* const loadSave);
@@ -40,6 +41,7 @@ class ndBrainLayerImagePolling_2x2 : public ndBrainLayerActivation
 	ndInt32 GetOutputWidth() const;
 	ndInt32 GetOutputHeight() const;
 	ndInt32 GetOutputChannels() const;
+	ndBrainConvolution::ndLayout GetLayout() const;
 
 	virtual ndInt32 GetInputSize() const;
 	virtual ndInt32 GetOutputBufferSize() const;
@@ -52,6 +54,7 @@ class ndBrainLayerImagePolling_2x2 : public ndBrainLayerActivation
 	ndInt32 m_width;
 	ndInt32 m_height;
 	ndInt32 m_channels;
+	ndBrainConvolution::ndLayout m_layout;
 };
 
 #endif 
@@ -292,3 +292,32 @@ void ndBrainLayerLinear::CalculateParamGradients(
 	//ndBrainLayerLinear::InputDerivative(output, outputDerivative, inputGradient);
 	m_weights.TransposeMul(outputDerivative, inputGradient);
 }
+
+void ndBrainLayerLinear::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(input.GetRows() == output.GetRows());
+	output.MatrixMulTranspose(input, m_weights);
+	for (ndInt32 i = output.GetRows() - 1; i >= 0; --i)
+	{
+		output[i].Add(m_bias);
+	}
+}
+
+void ndBrainLayerLinear::CalculateBatchParamGradients(
+	const ndBrainMatrix& input, const ndBrainMatrix&,
+	const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+	ndBrainLayer* const gradientOut, ndBrainLayer* const) const
+{
+	ndAssert(!strcmp(GetLabelId(), gradientOut->GetLabelId()));
+	ndBrainLayerLinear* const gradients = (ndBrainLayerLinear*)gradientOut;
+	ndAssert(gradients->m_bias.GetCount() == outputDerivative.GetColumns());
+	ndAssert(input.GetRows() == outputDerivative.GetRows());
+
+	gradients->m_bias.Set(ndBrainFloat(0.0f));
+	for (ndInt32 i = outputDerivative.GetRows() - 1; i >= 0; --i)
+	{
+		gradients->m_bias.Add(outputDerivative[i]);
+	}
+	gradients->m_weights.TransposeMatrixMul(outputDerivative, input);
+	inputGradient.MatrixMul(outputDerivative, m_weights);
+}
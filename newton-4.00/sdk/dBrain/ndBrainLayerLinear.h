@@ -55,6 +55,12 @@ class ndBrainLayerLinear : public ndBrainLayer
 		const ndBrainVector& input, const ndBrainVector& output,
 		const ndBrainVector& outputDerivative, ndBrainVector& inputGradient, ndBrainLayer* const gradientOut) const;
 
+	virtual void MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const;
+	virtual void CalculateBatchParamGradients(
+		const ndBrainMatrix& input, const ndBrainMatrix& output,
+		const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+		ndBrainLayer* const gradientOut, ndBrainLayer* const sampleGradient) const;
+
 	virtual void Save(const ndBrainSave* const loadSave) const;
 	static ndBrainLayer* Load(const ndBrainLoad* const loadSave);
 	
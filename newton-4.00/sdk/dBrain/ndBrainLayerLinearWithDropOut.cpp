@@ -121,3 +121,33 @@ void ndBrainLayerLinearWithDropOut::CalculateParamGradients(
 	}
 	ndBrainLayerLinear::CalculateParamGradients(input, output, outputDerivative, inputGradient, gradientOut);
 }
+
+void ndBrainLayerLinearWithDropOut::MakeBatchPrediction(const ndBrainMatrix& input, ndBrainMatrix& output) const
+{
+	ndAssert(output.GetColumns() == m_dropout.GetCount());
+	ndBrainLayerLinear::MakeBatchPrediction(input, output);
+	if (m_droutOutEnable)
+	{
+		for (ndInt32 i = output.GetRows() - 1; i >= 0; --i)
+		{
+			output[i].Mul(m_dropout);
+		}
+	}
+}
+
+void ndBrainLayerLinearWithDropOut::CalculateBatchParamGradients(
+	const ndBrainMatrix& input, const ndBrainMatrix& output,
+	const ndBrainMatrix& outputDerivative, ndBrainMatrix& inputGradient,
+	ndBrainLayer* const gradientOut, ndBrainLayer* const sampleGradient) const
+{
+	if (m_droutOutEnable)
+	{
+		for (ndInt32 i = outputDerivative.GetRows() - 1; i >= 0; --i)
+		{
+			const ndBrainFloat* const outMemory = &outputDerivative[i][0];
+			ndBrainMemVector outDerivative(outMemory, outputDerivative.GetColumns());
+			outDerivative.Mul(m_dropout);
+		}
+	}
+	ndBrainLayerLinear::CalculateBatchParamGradients(input, output, outputDerivative, inputGradient, gradientOut, sampleGradient);
+}
@@ -21,6 +21,8 @@
 
 #include "ndBrainStdafx.h"
 #include "ndBrainLoss.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
 
 ndBrainLoss::ndBrainLoss() 
 	:ndClassAlloc()
@@ -30,3 +32,13 @@ ndBrainLoss::ndBrainLoss()
 ndBrainLoss::~ndBrainLoss() 
 {
 }
+
+void ndBrainLoss::GetBatchLoss(const ndBrainMatrix& output, ndBrainMatrix& loss)
+{
+	ndAssert(output.GetRows() == loss.GetRows());
+	ndAssert(output.GetColumns() == loss.GetColumns());
+	for (ndInt32 i = 0; i < output.GetRows(); ++i)
+	{
+		GetLoss(output[i], loss[i]);
+	}
+}
@@ -25,6 +25,7 @@
 #include "ndBrainStdafx.h"
 
 class ndBrainVector;
+class ndBrainMatrix;
 
 class ndBrainLoss : public ndClassAlloc
 {
@@ -33,6 +34,9 @@ class ndBrainLoss : public ndClassAlloc
 	virtual ~ndBrainLoss();
 	virtual void GetLoss(const ndBrainVector& output, ndBrainVector& loss) = 0;
 
+	// one sample per row, by default calls GetLoss for each row in order.
+	virtual void GetBatchLoss(const ndBrainMatrix& output, ndBrainMatrix& loss);
+
 	virtual bool IsCategorical() const;
 };
 
@@ -21,9 +21,15 @@
 
 #include "ndBrainStdafx.h"
 #include "ndBrainMatrix.h"
+#include "ndBrainKernels.h"
 
 #define D_BRAIN_MATRIX_ALIGNMENT 16
 
+static ndInt64 ndBrainGetRowStride(const ndBrainMatrix& matrix)
+{
+	return (matrix.GetRows() > 1) ? ndInt64(&matrix[1][0] - &matrix[0][0]) : ndInt64(matrix.GetColumns());
+}
+
 ndBrainMatrix::ndBrainMatrix()
 	:ndArray<ndBrainMemVector>()
 	,m_memory(nullptr)
@@ -87,6 +93,23 @@ void ndBrainMatrix::Init(ndInt32 rows, ndInt32 columns)
 	Set(ndBrainFloat(0.0f));
 }
 
+void ndBrainMatrix::SetColumns(ndInt32 columns)
+{
+	const ndInt32 rows = GetRows();
+	size_t strideInBytes = size_t((ndInt64(columns * sizeof(ndBrainFloat)) + D_BRAIN_MATRIX_ALIGNMENT - 1) & -D_BRAIN_MATRIX_ALIGNMENT);
+	size_t bytes = size_t((rows * sizeof(ndBrainMemVector) + D_BRAIN_MATRIX_ALIGNMENT - 1) & -D_BRAIN_MATRIX_ALIGNMENT);
+	ndInt8* ptr = (ndInt8*)m_memory + bytes;
+
+	ndBrainMatrix& me = *this;
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		ndBrainMemVector& row = me[i];
+		row.SetSize(columns);
+		row.SetPointer((ndBrainFloat*)ptr);
+		ptr += strideInBytes;
+	}
+}
+
 void ndBrainMatrix::Set(ndBrainFloat value)
 {
 	ndBrainMatrix& matrix = *this;
@@ -186,14 +209,11 @@ void ndBrainMatrix::FlushToZero()
 void ndBrainMatrix::Mul(const ndBrainVector& input, ndBrainVector& output) const
 {
 	const ndBrainMatrix& me = *this;
-	ndInt32 columns = input.GetCount();
-	ndAssert(columns == GetColumns());
+	ndAssert(input.GetCount() == GetColumns());
 	ndAssert(output.GetCount() == GetCount());
-	
-	for (ndInt32 i = GetCount() - 1; i >= 0; --i)
+	if (GetRows() && GetColumns())
 	{
-		const ndBrainVector& row = me[i];
-		output[i] = ndDotProduct(columns, &row[0], &input[0]);
+		ndBrainKernels::Gemv(GetRows(), GetColumns(), &me[0][0], ndBrainGetRowStride(me), &input[0], &output[0]);
 	}
 }
 
@@ -202,13 +222,73 @@ void ndBrainMatrix::TransposeMul(const ndBrainVector& input, ndBrainVector& outp
 	const ndBrainMatrix& me = *this;
 	ndAssert(input.GetCount() == GetCount());
 	ndAssert(output.GetCount() == GetColumns());
+	if (GetRows() && GetColumns())
+	{
+		ndBrainKernels::GemvTranspose(GetRows(), GetColumns(), &me[0][0], ndBrainGetRowStride(me), &input[0], &output[0]);
+	}
+}
 
-	output.Set(me[input.GetCount() - 1]);
-	output.Scale(input[input.GetCount() - 1]);
-	for (ndInt32 j = me.GetCount() - 2; j >= 0; --j)
+void ndBrainMatrix::MatrixMul(const ndBrainMatrix& a, const ndBrainMatrix& b)
+{
+	ndAssert(a.GetColumns() == b.GetRows());
+	ndAssert(a.GetRows() == GetRows());
+	ndAssert(b.GetColumns() == GetColumns());
+	if (!GetRows() || !GetColumns())
 	{
-		ndBrainFloat scale = input[j];
-		const ndBrainVector& row = me[j];
-		output.ScaleAdd(row, scale);
+		return;
 	}
-}
\ No newline at end of file
+
+	ndBrainMatrix& me = *this;
+	me.Set(ndBrainFloat(0.0f));
+	if (a.GetColumns())
+	{
+		ndBrainKernels::Gemm(GetRows(), GetColumns(), a.GetColumns(), 
+			&a[0][0], ndBrainGetRowStride(a), 1, 
+			&b[0][0], ndBrainGetRowStride(b), 1, 
+			&me[0][0], ndBrainGetRowStride(me));
+	}
+}
+
+void ndBrainMatrix::MatrixMulTranspose(const ndBrainMatrix& a, const ndBrainMatrix& b)
+{
+	ndAssert(a.GetColumns() == b.GetColumns());
+	ndAssert(a.GetRows() == GetRows());
+	ndAssert(b.GetRows() == GetColumns());
+	if (!GetRows() || !GetColumns())
+	{
+		return;
+	}
+
+	ndBrainMatrix& me = *this;
+	me.Set(ndBrainFloat(0.0f));
+	if (a.GetColumns())
+	{
+		// b is read by columns
+		ndBrainKernels::Gemm(GetRows(), GetColumns(), a.GetColumns(), 
+			&a[0][0], ndBrainGetRowStride(a), 1, 
+			&b[0][0], 1, ndBrainGetRowStride(b), 
+			&me[0][0], ndBrainGetRowStride(me));
+	}
+}
+
+void ndBrainMatrix::TransposeMatrixMul(const ndBrainMatrix& a, const ndBrainMatrix& b)
+{
+	ndAssert(a.GetRows() == b.GetRows());
+	ndAssert(a.GetColumns() == GetRows());
+	ndAssert(b.GetColumns() == GetColumns());
+	if (!GetRows() || !GetColumns())
+	{
+		return;
+	}
+
+	ndBrainMatrix& me = *this;
+	me.Set(ndBrainFloat(0.0f));
+	if (a.GetRows())
+	{
+		// a is read by columns
+		ndBrainKernels::Gemm(GetRows(), GetColumns(), a.GetRows(), 
+			&a[0][0], 1, ndBrainGetRowStride(a), 
+			&b[0][0], ndBrainGetRowStride(b), 1, 
+			&me[0][0], ndBrainGetRowStride(me));
+	}
+}
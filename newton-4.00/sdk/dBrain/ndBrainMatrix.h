@@ -34,6 +34,10 @@ class ndBrainMatrix: public ndArray<ndBrainMemVector>
 	~ndBrainMatrix();
 	void Init(ndInt32 rows, ndInt32 columns);
 
+	// lays the rows out again over the same memory, for buffers shared by 
+	// layers of different width. columns can not exceed the initial columns.
+	void SetColumns(ndInt32 columns);
+
 	ndInt32 GetRows() const;
 	ndInt32 GetColumns() const;
 
@@ -49,6 +53,12 @@ class ndBrainMatrix: public ndArray<ndBrainMemVector>
 	void Mul(const ndBrainVector& input, ndBrainVector& output) const;
 	void TransposeMul(const ndBrainVector& input, ndBrainVector& output) const;
 
+	// matrix products for mini batches, one sample per row.
+	// the result is written to this matrix, which must be already sized.
+	void MatrixMul(const ndBrainMatrix& a, const ndBrainMatrix& b);
+	void MatrixMulTranspose(const ndBrainMatrix& a, const ndBrainMatrix& b);
+	void TransposeMatrixMul(const ndBrainMatrix& a, const ndBrainMatrix& b);
+
 	protected:
 	void* m_memory;
 };
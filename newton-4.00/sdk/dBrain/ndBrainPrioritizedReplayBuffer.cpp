@@ -0,0 +1,366 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrainPrioritizedReplayBuffer.h"
+
+// priorities are stored in fixed point, so that the sum tree can be 
+// updated with atomic adds and the partial sums never drift.
+#define D_REPLAY_PRIORITY_SCALE		ndBrainFloat(1 << 16)
+#define D_REPLAY_MAX_PRIORITY		ndBrainFloat(1.0e6f)
+#define D_REPLAY_PRIORITY_EPSILON	ndBrainFloat(1.0e-4f)
+#define D_REPLAY_MAX_SAMPLE_TRIES	64
+
+// a leaf keeps the priority in the low bits, the largest fixed point 
+// priority fits in them, and the sequence of its transition in the high bits.
+#define D_REPLAY_PRIORITY_BITS		36
+#define D_REPLAY_PRIORITY_MASK		((ndUnsigned64(1) << D_REPLAY_PRIORITY_BITS) - 1)
+
+ndBrainPrioritizedReplayBuffer::ndBatch::ndBatch()
+	:m_actions()
+	,m_observations()
+	,m_nextObservations()
+	,m_rewards()
+	,m_terminalStates()
+	,m_weights()
+	,m_indices()
+	,m_sequences()
+{
+}
+
+ndBrainPrioritizedReplayBuffer::ndShard::ndShard()
+	:m_start(0)
+	,m_size(0)
+	,m_writeIndex(0)
+	,m_count(0)
+{
+}
+
+ndBrainPrioritizedReplayBuffer::ndBrainPrioritizedReplayBuffer(ndInt32 observationSize, ndInt32 actionSize, ndInt32 capacity, ndInt32 shardsCount)
+	:ndClassAlloc()
+	,m_actions()
+	,m_observations()
+	,m_nextObservations()
+	,m_rewards()
+	,m_terminalStates()
+	,m_shards(nullptr)
+	,m_sumTree(nullptr)
+	,m_sequences(nullptr)
+	,m_maxPriority(ndUnsigned64(D_REPLAY_PRIORITY_SCALE))
+	,m_alpha(ndBrainFloat(0.6f))
+	,m_beta(ndBrainFloat(0.4f))
+	,m_capacity(capacity)
+	,m_leafCount(1)
+	,m_actionSize(actionSize)
+	,m_shardsCount(ndClamp(shardsCount, 1, capacity))
+	,m_observationSize(observationSize)
+{
+	ndAssert(capacity > 0);
+	while (m_leafCount < m_capacity)
+	{
+		m_leafCount *= 2;
+	}
+
+	m_actions.SetCount(m_capacity * m_actionSize);
+	m_observations.SetCount(m_capacity * m_observationSize);
+	m_nextObservations.SetCount(m_capacity * m_observationSize);
+	m_rewards.SetCount(m_capacity);
+	m_terminalStates.SetCount(m_capacity);
+	m_actions.Set(ndBrainFloat(0.0f));
+	m_observations.Set(ndBrainFloat(0.0f));
+	m_nextObservations.Set(ndBrainFloat(0.0f));
+	m_rewards.Set(ndBrainFloat(0.0f));
+
+	m_sumTree = new ndAtomic<ndUnsigned64>[2 * m_leafCount];
+	m_sequences = new ndAtomic<ndUnsigned32>[m_capacity];
+	for (ndInt32 i = 0; i < 2 * m_leafCount; ++i)
+	{
+		m_sumTree[i].store(0);
+	}
+	for (ndInt32 i = 0; i < m_capacity; ++i)
+	{
+		m_sequences[i].store(0);
+		m_terminalStates[i] = 0;
+	}
+
+	m_shards = new ndShard[m_shardsCount];
+	for (ndInt32 i = 0; i < m_shardsCount; ++i)
+	{
+		const ndStartEnd startEnd(m_capacity, i, m_shardsCount);
+		m_shards[i].m_start = startEnd.m_start;
+		m_shards[i].m_size = startEnd.m_end - startEnd.m_start;
+	}
+}
+
+ndBrainPrioritizedReplayBuffer::~ndBrainPrioritizedReplayBuffer()
+{
+	delete[] m_shards;
+	delete[] m_sumTree;
+	delete[] m_sequences;
+}
+
+ndInt32 ndBrainPrioritizedReplayBuffer::GetCount() const
+{
+	ndInt32 count = 0;
+	for (ndInt32 i = 0; i < m_shardsCount; ++i)
+	{
+		count += m_shards[i].m_count.load();
+	}
+	return count;
+}
+
+ndFloat64 ndBrainPrioritizedReplayBuffer::GetTotalPriority() const
+{
+	return ndFloat64(GetNodePriority(1)) / ndFloat64(D_REPLAY_PRIORITY_SCALE);
+}
+
+ndFloat64 ndBrainPrioritizedReplayBuffer::GetPriority(ndInt32 index) const
+{
+	ndAssert((index >= 0) && (index < m_capacity));
+	return ndFloat64(GetNodePriority(m_leafCount + index)) / ndFloat64(D_REPLAY_PRIORITY_SCALE);
+}
+
+ndUnsigned64 ndBrainPrioritizedReplayBuffer::GetNodePriority(ndInt32 node) const
+{
+	const ndUnsigned64 value = m_sumTree[node].load();
+	return (node >= m_leafCount) ? (value & D_REPLAY_PRIORITY_MASK) : value;
+}
+
+ndUnsigned64 ndBrainPrioritizedReplayBuffer::PackLeaf(ndUnsigned32 sequence, ndUnsigned64 priority)
+{
+	ndAssert(priority <= D_REPLAY_PRIORITY_MASK);
+	return (ndUnsigned64(sequence) << D_REPLAY_PRIORITY_BITS) | priority;
+}
+
+void ndBrainPrioritizedReplayBuffer::SetAlpha(ndBrainFloat alpha)
+{
+	m_alpha = ndMax(alpha, ndBrainFloat(0.0f));
+}
+
+void ndBrainPrioritizedReplayBuffer::SetBeta(ndBrainFloat beta)
+{
+	m_beta = ndClamp(beta, ndBrainFloat(0.0f), ndBrainFloat(1.0f));
+}
+
+ndUnsigned64 ndBrainPrioritizedReplayBuffer::CalculatePriority(ndBrainFloat tdError) const
+{
+	const ndBrainFloat priority = ndBrainFloat(ndPow(ndAbs(tdError) + D_REPLAY_PRIORITY_EPSILON, m_alpha));
+	const ndBrainFloat clampPriority = ndMin(priority, D_REPLAY_MAX_PRIORITY);
+	ndAssert(ndUnsigned64(D_REPLAY_MAX_PRIORITY * D_REPLAY_PRIORITY_SCALE) <= D_REPLAY_PRIORITY_MASK);
+	return ndMax(ndUnsigned64(clampPriority * D_REPLAY_PRIORITY_SCALE), ndUnsigned64(1));
+}
+
+void ndBrainPrioritizedReplayBuffer::AddToParents(ndInt32 slot, ndUnsigned64 delta)
+{
+	if (delta)
+	{
+		for (ndInt32 node = (m_leafCount + slot) >> 1; node; node = node >> 1)
+		{
+			m_sumTree[node].fetch_add(delta);
+		}
+	}
+}
+
+void ndBrainPrioritizedReplayBuffer::SetPriority(ndInt32 slot, ndUnsigned32 sequence, ndUnsigned64 priority)
+{
+	// exchanging the leaf and propagating the difference keeps 
+	// every partial sum exact, even with concurrent updates.
+	const ndUnsigned64 oldLeaf = m_sumTree[m_leafCount + slot].exchange(PackLeaf(sequence, priority));
+	AddToParents(slot, priority - (oldLeaf & D_REPLAY_PRIORITY_MASK));
+}
+
+bool ndBrainPrioritizedReplayBuffer::UpdatePriority(ndInt32 slot, ndUnsigned32 sequence, ndUnsigned64 priority)
+{
+	// the exchange only happens while the leaf still carries the sequence 
+	// of the sampled transition, a producer that overwrites the slot changes 
+	// it first, so a late update can never land on the new transition.
+	ndAtomic<ndUnsigned64>& leaf = m_sumTree[m_leafCount + slot];
+	const ndUnsigned64 tag = PackLeaf(sequence, 0);
+	ndUnsigned64 oldLeaf = leaf.load();
+	bool updated = false;
+	while (!updated && ((oldLeaf & ~D_REPLAY_PRIORITY_MASK) == tag))
+	{
+		updated = leaf.compare_exchange_weak(oldLeaf, tag | priority);
+	}
+	if (updated)
+	{
+		AddToParents(slot, priority - (oldLeaf & D_REPLAY_PRIORITY_MASK));
+
+		ndUnsigned64 maxPriority = m_maxPriority.load();
+		while ((priority > maxPriority) && !m_maxPriority.compare_exchange_weak(maxPriority, priority))
+		{
+			maxPriority = m_maxPriority.load();
+		}
+	}
+	return updated;
+}
+
+ndInt32 ndBrainPrioritizedReplayBuffer::FindSlot(ndUnsigned64 value) const
+{
+	ndInt32 node = 1;
+	while (node < m_leafCount)
+	{
+		const ndUnsigned64 left = GetNodePriority(2 * node);
+		if (value < left)
+		{
+			node = 2 * node;
+		}
+		else
+		{
+			value -= left;
+			node = 2 * node + 1;
+		}
+	}
+	return node - m_leafCount;
+}
+
+void ndBrainPrioritizedReplayBuffer::AddTransition(ndInt32 shardIndex,
+	const ndBrainFloat* const observation, const ndBrainFloat* const actions,
+	ndBrainFloat reward, const ndBrainFloat* const nextObservation, bool terminalState)
+{
+	ndShard& shard = m_shards[shardIndex];
+	const ndInt32 slot = shard.m_start + shard.m_writeIndex;
+	shard.m_writeIndex = (shard.m_writeIndex + 1) % shard.m_size;
+
+	// mark the slot as being written, and take it out of the distribution
+	const ndUnsigned32 sequence = m_sequences[slot].fetch_add(1) + 1;
+	SetPriority(slot, sequence, 0);
+
+	ndMemCpy(&m_actions[slot * m_actionSize], actions, m_actionSize);
+	ndMemCpy(&m_observations[slot * m_observationSize], observation, m_observationSize);
+	ndMemCpy(&m_nextObservations[slot * m_observationSize], nextObservation, m_observationSize);
+	m_rewards[slot] = reward;
+	m_terminalStates[slot] = terminalState ? 1 : 0;
+
+	m_sequences[slot].fetch_add(1);
+	if (shard.m_count.load() < shard.m_size)
+	{
+		shard.m_count.fetch_add(1);
+	}
+	SetPriority(slot, sequence + 1, m_maxPriority.load());
+}
+
+void ndBrainPrioritizedReplayBuffer::SampleBatch(ndBatch& batch, ndInt32 batchSize) const
+{
+	if ((batch.m_observations.GetRows() != batchSize) || (batch.m_observations.GetColumns() != m_observationSize))
+	{
+		batch.m_actions.Init(batchSize, m_actionSize);
+		batch.m_observations.Init(batchSize, m_observationSize);
+		batch.m_nextObservations.Init(batchSize, m_observationSize);
+	}
+	batch.m_rewards.SetCount(batchSize);
+	batch.m_terminalStates.SetCount(batchSize);
+	batch.m_weights.SetCount(batchSize);
+	batch.m_indices.SetCount(batchSize);
+	batch.m_sequences.SetCount(batchSize);
+
+	// one call to the shared generator per batch, 
+	// after that each sample uses a local xor shift generator.
+	ndUnsigned32 seed = ndRandInt() | 1;
+	auto Random = [&seed]()
+	{
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return ndFloat64(seed) * (ndFloat64(1.0f) / ndFloat64(4294967296.0));
+	};
+
+	const ndInt32 count = ndMax(GetCount(), 1);
+	ndBrainFloat maxWeight = ndBrainFloat(0.0f);
+	for (ndInt32 i = 0; i < batchSize; ++i)
+	{
+		bool sampled = false;
+		for (ndInt32 j = 0; !sampled && (j < D_REPLAY_MAX_SAMPLE_TRIES); ++j)
+		{
+			const ndUnsigned64 total = GetNodePriority(1);
+			if (!total)
+			{
+				break;
+			}
+			const ndFloat64 segment = ndFloat64(total) / ndFloat64(batchSize);
+			const ndUnsigned64 value = ndMin(ndUnsigned64((ndFloat64(i) + Random()) * segment), total - 1);
+			const ndInt32 slot = FindSlot(value);
+			if (slot >= m_capacity)
+			{
+				continue;
+			}
+			const ndUnsigned64 priority = GetNodePriority(m_leafCount + slot);
+			const ndUnsigned32 sequence = m_sequences[slot].load();
+			if (!priority || (sequence & 1))
+			{
+				continue;
+			}
+
+			ndMemCpy(&batch.m_actions[i][0], &m_actions[slot * m_actionSize], m_actionSize);
+			ndMemCpy(&batch.m_observations[i][0], &m_observations[slot * m_observationSize], m_observationSize);
+			ndMemCpy(&batch.m_nextObservations[i][0], &m_nextObservations[slot * m_observationSize], m_observationSize);
+			batch.m_rewards[i] = m_rewards[slot];
+			batch.m_terminalStates[i] = m_terminalStates[slot] ? ndBrainFloat(1.0f) : ndBrainFloat(0.0f);
+
+			// the copy is only valid if no producer touched the slot meanwhile
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_sequences[slot].load() != sequence)
+			{
+				continue;
+			}
+
+			const ndFloat64 probability = ndFloat64(priority) / ndFloat64(total);
+			const ndBrainFloat weight = ndBrainFloat(ndPow(ndFloat64(count) * probability, -ndFloat64(m_beta)));
+			batch.m_weights[i] = weight;
+			batch.m_indices[i] = slot;
+			batch.m_sequences[i] = sequence;
+			maxWeight = ndMax(maxWeight, weight);
+			sampled = true;
+		}
+
+		if (!sampled)
+		{
+			// empty buffer, or a slot under heavy contention
+			batch.m_actions[i].Set(ndBrainFloat(0.0f));
+			batch.m_observations[i].Set(ndBrainFloat(0.0f));
+			batch.m_nextObservations[i].Set(ndBrainFloat(0.0f));
+			batch.m_rewards[i] = ndBrainFloat(0.0f);
+			batch.m_terminalStates[i] = ndBrainFloat(0.0f);
+			batch.m_weights[i] = ndBrainFloat(0.0f);
+			batch.m_indices[i] = -1;
+			batch.m_sequences[i] = 0;
+		}
+	}
+
+	if (maxWeight > ndBrainFloat(0.0f))
+	{
+		batch.m_weights.Scale(ndBrainFloat(1.0f) / maxWeight);
+	}
+}
+
+void ndBrainPrioritizedReplayBuffer::UpdatePriorities(const ndBatch& batch, const ndBrainVector& tdErrors)
+{
+	ndAssert(tdErrors.GetCount() == batch.m_indices.GetCount());
+	for (ndInt32 i = 0; i < batch.m_indices.GetCount(); ++i)
+	{
+		const ndInt32 slot = batch.m_indices[i];
+		if (slot >= 0)
+		{
+			UpdatePriority(slot, batch.m_sequences[i], CalculatePriority(tdErrors[i]));
+		}
+	}
+}
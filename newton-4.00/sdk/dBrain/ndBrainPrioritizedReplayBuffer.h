@@ -0,0 +1,150 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_PRIORITIZED_REPLAY_BUFFER_H__
+#define _ND_BRAIN_PRIORITIZED_REPLAY_BUFFER_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
+#include "ndBrainReplayBuffer.h"
+
+// concurrent replay buffer for prioritized experience replay, as described in:
+// https://arxiv.org/abs/1511.05952
+//
+// the capacity is divided in shards, each shard is a ring buffer written by 
+// a single producer, so many environment threads can add transitions without
+// locks. priorities are kept in a sum tree of fixed point atomic counters,
+// and transitions are stored in structure of arrays form. 
+// sampling does not take locks either, a sequence counter per slot detects 
+// transitions that were overwritten while being copied, and those are sampled again.
+// the leaves of the tree carry that sequence too, so the priority update of a 
+// transition that was overwritten after it was sampled is dropped.
+class ndBrainPrioritizedReplayBuffer: public ndClassAlloc
+{
+	public: 
+	class ndBatch
+	{
+		public:
+		ndBatch();
+
+		ndBrainMatrix m_actions;
+		ndBrainMatrix m_observations;
+		ndBrainMatrix m_nextObservations;
+		ndBrainVector m_rewards;
+		ndBrainVector m_terminalStates;
+		ndBrainVector m_weights;
+		ndArray<ndInt32> m_indices;
+		ndArray<ndUnsigned32> m_sequences;
+	};
+
+	ndBrainPrioritizedReplayBuffer(ndInt32 observationSize, ndInt32 actionSize, ndInt32 capacity, ndInt32 shardsCount);
+	~ndBrainPrioritizedReplayBuffer();
+
+	ndInt32 GetCount() const;
+	ndInt32 GetCapacity() const;
+	ndInt32 GetShardsCount() const;
+	ndFloat64 GetTotalPriority() const;
+	ndFloat64 GetPriority(ndInt32 index) const;
+
+	// alpha shapes the priorities, zero is uniform sampling.
+	// beta is the importance sampling correction, one is full correction.
+	void SetAlpha(ndBrainFloat alpha);
+	void SetBeta(ndBrainFloat beta);
+
+	// only one thread at a time can add transitions to a given shard.
+	// new transitions take the largest priority seen so far.
+	void AddTransition(ndInt32 shard, 
+		const ndBrainFloat* const observation, const ndBrainFloat* const actions, 
+		ndBrainFloat reward, const ndBrainFloat* const nextObservation, bool terminalState);
+
+	template<ndInt32 statesDim, ndInt32 actionDim>
+	void AddTransition(ndInt32 shard, const ndBrainReplayTransitionMemory<statesDim, actionDim>& transition);
+
+	// stratified sampling proportional to the priorities, it can run
+	// concurrently with the producers and with other samplers.
+	void SampleBatch(ndBatch& batch, ndInt32 batchSize) const;
+
+	// sets the priorities of a sampled batch from its temporal difference errors.
+	// transitions that were overwritten since the batch was sampled are skipped.
+	void UpdatePriorities(const ndBatch& batch, const ndBrainVector& tdErrors);
+
+	private:
+	class ndShard
+	{
+		public:
+		ndShard();
+
+		ndInt32 m_start;
+		ndInt32 m_size;
+		ndInt32 m_writeIndex;
+		ndAtomic<ndInt32> m_count;
+	};
+
+	ndUnsigned64 CalculatePriority(ndBrainFloat tdError) const;
+	ndUnsigned64 GetNodePriority(ndInt32 node) const;
+	void SetPriority(ndInt32 slot, ndUnsigned32 sequence, ndUnsigned64 priority);
+	bool UpdatePriority(ndInt32 slot, ndUnsigned32 sequence, ndUnsigned64 priority);
+	void AddToParents(ndInt32 slot, ndUnsigned64 delta);
+	ndInt32 FindSlot(ndUnsigned64 value) const;
+
+	static ndUnsigned64 PackLeaf(ndUnsigned32 sequence, ndUnsigned64 priority);
+
+	ndBrainVector m_actions;
+	ndBrainVector m_observations;
+	ndBrainVector m_nextObservations;
+	ndBrainVector m_rewards;
+	ndArray<ndUnsigned8> m_terminalStates;
+
+	ndShard* m_shards;
+	ndAtomic<ndUnsigned64>* m_sumTree;
+	ndAtomic<ndUnsigned32>* m_sequences;
+	ndAtomic<ndUnsigned64> m_maxPriority;
+
+	ndBrainFloat m_alpha;
+	ndBrainFloat m_beta;
+	ndInt32 m_capacity;
+	ndInt32 m_leafCount;
+	ndInt32 m_actionSize;
+	ndInt32 m_shardsCount;
+	ndInt32 m_observationSize;
+};
+
+inline ndInt32 ndBrainPrioritizedReplayBuffer::GetCapacity() const
+{
+	return m_capacity;
+}
+
+inline ndInt32 ndBrainPrioritizedReplayBuffer::GetShardsCount() const
+{
+	return m_shardsCount;
+}
+
+template<ndInt32 statesDim, ndInt32 actionDim>
+void ndBrainPrioritizedReplayBuffer::AddTransition(ndInt32 shard, const ndBrainReplayTransitionMemory<statesDim, actionDim>& transition)
+{
+	ndAssert(statesDim == m_observationSize);
+	ndAssert(actionDim == m_actionSize);
+	AddTransition(shard, &transition.m_observation[0], &transition.m_action[0], transition.m_reward, &transition.m_nextObservation[0], transition.m_terminalState);
+}
+
+#endif 
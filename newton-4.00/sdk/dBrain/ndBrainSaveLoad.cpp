@@ -22,6 +22,7 @@
 #include "ndBrainStdafx.h"
 #include "ndBrain.h"
 #include "ndBrainSaveLoad.h"
+#include "ndBrainBinaryFile.h"
 #include "ndBrainLayerLinear.h"
 #include "ndBrainLayerReluActivation.h"
 #include "ndBrainLayerTanhActivation.h"
@@ -37,6 +38,12 @@
 
 ndBrain* ndBrainLoad::Load(const char* const pathName)
 {
+	if (ndBrainBinaryFile::IsBinaryFile(pathName))
+	{
+		ndBrainBinaryFile file;
+		return file.Open(pathName) ? file.CreateBrain() : nullptr;
+	}
+
 	class Loader : public ndBrainLoad
 	{
 		public:
@@ -215,3 +222,20 @@ void ndBrainSave::Save(const ndBrain* const brain, const char* const pathName)
 	SaveAgent saveAgent(pathName);
 	saveAgent.Save(brain);
 }
+
+bool ndBrainSave::SaveBinary(const ndBrain* const brain, const char* const pathName)
+{
+	return ndBrainBinaryFile::Save(brain, pathName);
+}
+
+bool ndBrainSave::ConvertToBinary(const char* const textPathName, const char* const binaryPathName)
+{
+	ndBrain* const brain = ndBrainLoad::Load(textPathName);
+	if (!brain)
+	{
+		return false;
+	}
+	const bool ok = ndBrainBinaryFile::Save(brain, binaryPathName);
+	delete brain;
+	return ok;
+}
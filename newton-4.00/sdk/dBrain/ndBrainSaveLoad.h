@@ -50,6 +50,10 @@ class ndBrainSave: public ndClassAlloc
 
 	void Save(const ndBrain* const brain);
 	static void Save(const ndBrain* const brain, const char* const pathName);
+
+	// binary files are also read by ndBrainLoad::Load
+	static bool SaveBinary(const ndBrain* const brain, const char* const pathName);
+	static bool ConvertToBinary(const char* const textPathName, const char* const binaryPathName);
 };
 
 #endif 
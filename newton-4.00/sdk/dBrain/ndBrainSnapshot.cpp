@@ -0,0 +1,95 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainSnapshot.h"
+
+ndBrainSnapshot::ndBrainSnapshot(const ndBrain& brain)
+	:ndClassAlloc()
+	,m_front(0)
+	,m_version(0)
+{
+	m_brains[0] = new ndBrain(brain);
+	m_brains[1] = new ndBrain(brain);
+	m_readers[0].store(0);
+	m_readers[1].store(0);
+}
+
+ndBrainSnapshot::~ndBrainSnapshot()
+{
+	ndAssert(!m_readers[0].load());
+	ndAssert(!m_readers[1].load());
+	delete m_brains[0];
+	delete m_brains[1];
+}
+
+ndUnsigned32 ndBrainSnapshot::GetVersion() const
+{
+	return m_version.load();
+}
+
+const ndBrain* ndBrainSnapshot::Acquire()
+{
+	for (;;)
+	{
+		// a reader is only safe if the index is still the front 
+		// after it was counted, otherwise the publisher may be 
+		// writing to it, and the reader must try again.
+		const ndInt32 index = m_front.load();
+		m_readers[index].fetch_add(1);
+		if (m_front.load() == index)
+		{
+			return m_brains[index];
+		}
+		m_readers[index].fetch_sub(1);
+	}
+}
+
+void ndBrainSnapshot::Release(const ndBrain* const brain)
+{
+	const ndInt32 index = (brain == m_brains[0]) ? 0 : 1;
+	ndAssert(brain == m_brains[index]);
+	ndAssert(m_readers[index].load() > 0);
+	m_readers[index].fetch_sub(1);
+}
+
+void ndBrainSnapshot::Publish(const ndBrain& brain)
+{
+	// wait for the readers that acquired the back buffer 
+	// before the last swap, new readers will not take it.
+	const ndInt32 back = 1 - m_front.load();
+	while (m_readers[back].load())
+	{
+		ndThreadYield();
+	}
+	m_brains[back]->CopyFrom(brain);
+	m_front.store(back);
+	m_version.fetch_add(1);
+}
+
+void ndBrainSnapshot::MakePrediction(const ndBrainVector& input, ndBrainVector& output, ndBrainVector& workingBuffer)
+{
+	ndBrain* const brain = (ndBrain*)Acquire();
+	brain->MakePrediction(input, output, workingBuffer);
+	Release(brain);
+}
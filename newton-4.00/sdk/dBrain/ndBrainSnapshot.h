@@ -0,0 +1,57 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_SNAPSHOT_H__
+#define _ND_BRAIN_SNAPSHOT_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+
+class ndBrain;
+
+// double buffered copy of a brain, for actors that keep making predictions
+// while a learner thread trains the original. the learner publishes a new 
+// version by copying the weights into the back buffer and swapping the front 
+// index atomically, actors acquire the front buffer for as long as they use it.
+// there can be many readers, but only one thread at a time can publish.
+class ndBrainSnapshot: public ndClassAlloc
+{
+	public: 
+	ndBrainSnapshot(const ndBrain& brain);
+	~ndBrainSnapshot();
+
+	ndUnsigned32 GetVersion() const;
+	void Publish(const ndBrain& brain);
+
+	const ndBrain* Acquire();
+	void Release(const ndBrain* const brain);
+
+	void MakePrediction(const ndBrainVector& input, ndBrainVector& output, ndBrainVector& workingBuffer);
+
+	private:
+	ndBrain* m_brains[2];
+	ndAtomic<ndInt32> m_readers[2];
+	ndAtomic<ndInt32> m_front;
+	ndAtomic<ndUnsigned32> m_version;
+};
+
+#endif 
@@ -35,10 +35,12 @@ class ndBrainTrainer::ndLayerData : public ndClassAlloc
 		:ndClassAlloc()
 		,m_layer(layer)
 		,m_gradient(nullptr)
+		,m_sampleGradient(nullptr)
 	{
 		if (layer->HasParameters())
 		{
 			m_gradient = layer->Clone();
+			m_sampleGradient = layer->Clone();
 		}
 	}
 
@@ -47,6 +49,7 @@ class ndBrainTrainer::ndLayerData : public ndClassAlloc
 		if (m_gradient)
 		{
 			delete m_gradient;
+			delete m_sampleGradient;
 		}
 	}
 
@@ -76,14 +79,18 @@ class ndBrainTrainer::ndLayerData : public ndClassAlloc
 
 	ndBrainLayer* m_layer;
 	ndBrainLayer* m_gradient;
+	ndBrainLayer* m_sampleGradient;
 };
 
 ndBrainTrainer::ndBrainTrainer(ndBrain* const brain)
 	:ndClassAlloc()
 	,m_data()
+	,m_batchOutputs()
+	,m_batchGradients()
 	,m_workingBuffer()
 	,m_prefixScan()
 	,m_brain(brain)
+	,m_threadPool(nullptr)
 {
 	for (ndInt32 i = 0; i < m_brain->GetCount(); ++i)
 	{
@@ -112,9 +119,12 @@ ndBrainTrainer::ndBrainTrainer(ndBrain* const brain)
 ndBrainTrainer::ndBrainTrainer(const ndBrainTrainer& src)
 	:ndClassAlloc()
 	,m_data()
+	,m_batchOutputs()
+	,m_batchGradients()
 	,m_workingBuffer()
 	,m_prefixScan(src.m_prefixScan)
 	,m_brain(src.m_brain)
+	,m_threadPool(src.m_threadPool)
 	,m_maxLayerBufferSize(src.m_maxLayerBufferSize)
 {
 	ndAssert(0);
@@ -131,6 +141,40 @@ ndBrainTrainer::~ndBrainTrainer()
 	{
 		delete (m_data[i]);
 	}
+	FreeBatch();
+}
+
+void ndBrainTrainer::FreeBatch()
+{
+	for (ndInt32 i = 0; i < m_batchOutputs.GetCount(); ++i)
+	{
+		delete (m_batchOutputs[i]);
+	}
+	for (ndInt32 i = 0; i < m_batchGradients.GetCount(); ++i)
+	{
+		delete (m_batchGradients[i]);
+	}
+	m_batchOutputs.SetCount(0);
+	m_batchGradients.SetCount(0);
+}
+
+void ndBrainTrainer::InitBatch(ndInt32 batchSize)
+{
+	if (m_batchOutputs.GetCount() && (m_batchOutputs[0]->GetRows() == batchSize))
+	{
+		return;
+	}
+
+	// m_batchGradients[i] is the input gradient of layer i, 
+	// and m_batchGradients[i + 1] its output gradient.
+	FreeBatch();
+	const ndArray<ndBrainLayer*>& layers = *m_brain;
+	m_batchGradients.PushBack(new ndBrainMatrix(batchSize, layers[0]->GetInputSize()));
+	for (ndInt32 i = 0; i < layers.GetCount(); ++i)
+	{
+		m_batchOutputs.PushBack(new ndBrainMatrix(batchSize, layers[i]->GetOutputSize()));
+		m_batchGradients.PushBack(new ndBrainMatrix(batchSize, layers[i]->GetOutputSize()));
+	}
 }
 
 ndBrain* ndBrainTrainer::GetBrain() const
@@ -222,4 +266,39 @@ void ndBrainTrainer::BackPropagate(const ndBrainVector& input, ndBrainLoss& loss
 	}
 }
 
+void ndBrainTrainer::SetThreadPool(ndBrainThreadPool* const threadPool)
+{
+	m_threadPool = threadPool;
+}
 
+ndBrainThreadPool* ndBrainTrainer::GetThreadPool() const
+{
+	return m_threadPool;
+}
+
+void ndBrainTrainer::BackPropagateBatch(const ndBrainMatrix& input, ndBrainLoss& loss)
+{
+	const ndInt32 layersCount = m_brain->GetCount();
+	const ndArray<ndBrainLayer*>& layers = *m_brain;
+	ndAssert(input.GetColumns() == m_brain->GetInputSize());
+	ndAssert(!(loss.IsCategorical() ^ (!strcmp(layers[layersCount - 1]->GetLabelId(), "ndBrainLayerCategoricalSoftmaxActivation"))));
+
+	InitBatch(input.GetRows());
+
+	const ndBrainMatrix* in = &input;
+	for (ndInt32 i = 0; i < layersCount; ++i)
+	{
+		layers[i]->SetThreadPool(m_threadPool);
+		layers[i]->MakeBatchPrediction(*in, *m_batchOutputs[i]);
+		in = m_batchOutputs[i];
+	}
+	loss.GetBatchLoss(*m_batchOutputs[layersCount - 1], *m_batchGradients[layersCount]);
+
+	for (ndInt32 i = layersCount - 1; i >= 0; --i)
+	{
+		const ndBrainLayer* const layer = m_data[i]->m_layer;
+		const ndBrainMatrix& layerInput = i ? *m_batchOutputs[i - 1] : input;
+		ndLayerData* const data = m_data[i];
+		layer->CalculateBatchParamGradients(layerInput, *m_batchOutputs[i], *m_batchGradients[i + 1], *m_batchGradients[i], data->m_gradient, data->m_sampleGradient);
+	}
+}
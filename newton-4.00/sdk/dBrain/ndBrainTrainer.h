@@ -26,6 +26,8 @@
 #include "ndBrainVector.h"
 class ndBrain;
 class ndBrainLoss;
+class ndBrainMatrix;
+class ndBrainThreadPool;
 
 class ndBrainTrainer: public ndClassAlloc
 {
@@ -38,6 +40,14 @@ class ndBrainTrainer: public ndClassAlloc
 
 	ndBrain* GetBrain() const;
 	void BackPropagate(const ndBrainVector& input, ndBrainLoss& loss);
+
+	// one sample per row, the gradients are the sum over the batch,
+	// the same as adding the gradients of one trainer per sample.
+	void BackPropagateBatch(const ndBrainMatrix& input, ndBrainLoss& loss);
+
+	// the batch back propagation hands this pool to the layers
+	void SetThreadPool(ndBrainThreadPool* const threadPool);
+	ndBrainThreadPool* GetThreadPool() const;
 	void AcculumateGradients(const ndBrainTrainer& src, ndInt32 index);
 
 	ndBrainLayer* GetWeightsLayer(ndInt32 index) const;
@@ -50,10 +60,16 @@ class ndBrainTrainer: public ndClassAlloc
 	ndBrainVector& GetWorkingBuffer();
 
 	private:
+	void InitBatch(ndInt32 batchSize);
+	void FreeBatch();
+
 	ndArray<ndLayerData*> m_data;
+	ndArray<ndBrainMatrix*> m_batchOutputs;
+	ndArray<ndBrainMatrix*> m_batchGradients;
 	ndBrainVector m_workingBuffer;
 	ndFixSizeArray<ndInt32, 256> m_prefixScan;
 	ndBrain* m_brain;
+	ndBrainThreadPool* m_threadPool;
 	ndInt32 m_maxLayerBufferSize;
 };
 
@@ -0,0 +1,183 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndBrainStdafx.h"
+#include "ndBrain.h"
+#include "ndBrainVectorEnvironment.h"
+
+ndBrainVectorEnvironment::ndEnvironment::ndEnvironment()
+	:ndClassAlloc()
+	,m_framesAlive(0)
+{
+}
+
+ndBrainVectorEnvironment::ndEnvironment::~ndEnvironment()
+{
+}
+
+ndBrainVectorEnvironment::ndBrainVectorEnvironment(ndBrain* const policy)
+	:ndBrainThreadPool()
+	,m_policy(policy)
+	,m_environments()
+	,m_actions()
+	,m_observations()
+	,m_nextObservations()
+	,m_rewards()
+	,m_terminalStates()
+	,m_frameCount(0)
+	,m_episodeCount(0)
+	,m_initialized(false)
+{
+}
+
+ndBrainVectorEnvironment::~ndBrainVectorEnvironment()
+{
+	for (ndInt32 i = 0; i < m_environments.GetCount(); ++i)
+	{
+		delete m_environments[i];
+	}
+}
+
+void ndBrainVectorEnvironment::SetPolicy(ndBrain* const policy)
+{
+	m_policy = policy;
+	m_initialized = false;
+}
+
+void ndBrainVectorEnvironment::AddEnvironment(ndEnvironment* const environment)
+{
+	m_environments.PushBack(environment);
+	m_initialized = false;
+}
+
+void ndBrainVectorEnvironment::SelectActions(ndBrainMatrix&)
+{
+}
+
+void ndBrainVectorEnvironment::AddTransition(ndInt32, const ndBrainVector&, const ndBrainVector&, ndBrainFloat, const ndBrainVector&, bool)
+{
+}
+
+void ndBrainVectorEnvironment::EndEpisode(ndInt32, ndInt32)
+{
+}
+
+void ndBrainVectorEnvironment::InitBuffers()
+{
+	ndAssert(m_policy);
+	const ndInt32 count = GetCount();
+	m_actions.Init(count, m_policy->GetOutputSize());
+	m_observations.Init(count, m_policy->GetInputSize());
+	m_nextObservations.Init(count, m_policy->GetInputSize());
+	m_rewards.SetCount(count);
+	m_terminalStates.SetCount(count);
+	m_actions.Set(ndBrainFloat(0.0f));
+	m_observations.Set(ndBrainFloat(0.0f));
+	m_nextObservations.Set(ndBrainFloat(0.0f));
+	m_rewards.Set(ndBrainFloat(0.0f));
+	m_initialized = true;
+}
+
+void ndBrainVectorEnvironment::Reset()
+{
+	InitBuffers();
+	auto ResetEnvironments = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndEnvironment* const environment = m_environments[i];
+			environment->ResetModel();
+			environment->m_framesAlive = 0;
+			environment->GetObservation(&m_observations[i][0]);
+		}
+	});
+	ParallelExecute(ResetEnvironments);
+}
+
+void ndBrainVectorEnvironment::Step(ndBrainFloat timestep)
+{
+	if (!m_initialized)
+	{
+		Reset();
+	}
+	if (!GetCount())
+	{
+		return;
+	}
+
+	// one forward pass for all environments
+	m_policy->MakeBatchPrediction(m_observations, m_actions);
+	SelectActions(m_actions);
+
+	auto StepEnvironments = ndMakeObject::ndFunction([this, timestep](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndEnvironment* const environment = m_environments[i];
+			environment->ApplyActions(&m_actions[i][0]);
+			environment->Update(timestep);
+			environment->m_framesAlive++;
+			m_rewards[i] = environment->GetReward();
+			m_terminalStates[i] = environment->IsTerminal() ? 1 : 0;
+			environment->GetObservation(&m_nextObservations[i][0]);
+		}
+	});
+	ParallelExecute(StepEnvironments);
+
+	for (ndInt32 i = 0; i < GetCount(); ++i)
+	{
+		AddTransition(i, m_observations[i], m_actions[i], m_rewards[i], m_nextObservations[i], m_terminalStates[i] ? true : false);
+	}
+	m_frameCount += GetCount();
+
+	auto ResetTerminalEnvironments = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		const ndStartEnd startEnd(GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			if (m_terminalStates[i])
+			{
+				ndEnvironment* const environment = m_environments[i];
+				environment->ResetModel();
+				environment->GetObservation(&m_observations[i][0]);
+			}
+			else
+			{
+				m_observations[i].Set(m_nextObservations[i]);
+			}
+		}
+	});
+	ParallelExecute(ResetTerminalEnvironments);
+
+	for (ndInt32 i = 0; i < GetCount(); ++i)
+	{
+		if (m_terminalStates[i])
+		{
+			ndEnvironment* const environment = m_environments[i];
+			EndEpisode(i, environment->m_framesAlive);
+			environment->m_framesAlive = 0;
+			m_episodeCount++;
+		}
+	}
+}
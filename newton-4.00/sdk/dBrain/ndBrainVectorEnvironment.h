@@ -0,0 +1,146 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef _ND_BRAIN_VECTOR_ENVIRONMENT_H__
+#define _ND_BRAIN_VECTOR_ENVIRONMENT_H__
+
+#include "ndBrainStdafx.h"
+#include "ndBrainVector.h"
+#include "ndBrainMatrix.h"
+#include "ndBrainThreadPool.h"
+
+class ndBrain;
+
+// steps a set of independent environments in parallel.
+// the observations of all environments are gathered into one matrix,
+// the policy is evaluated with a single batched prediction and the 
+// actions are scattered back to each environment.
+// transitions are reported serially, in environment order, so that a
+// trainer can store them in its replay buffer without synchronization.
+class ndBrainVectorEnvironment: public ndBrainThreadPool
+{
+	public: 
+	class ndEnvironment: public ndClassAlloc
+	{
+		public:
+		ndEnvironment();
+		virtual ~ndEnvironment();
+
+		// these are the same callbacks an ndBrainAgent implements, 
+		// plus an update that advances the simulation by one step.
+		// an environment usually owns its own ndWorld, in which case 
+		// Update calls world->Update(timestep) followed by world->Sync()
+		virtual void ResetModel() = 0;
+		virtual bool IsTerminal() const = 0;
+		virtual ndBrainFloat GetReward() const = 0;
+		virtual void Update(ndBrainFloat timestep) = 0;
+		virtual void ApplyActions(const ndBrainFloat* const actions) = 0;
+		virtual void GetObservation(ndBrainFloat* const observation) = 0;
+
+		private:
+		ndInt32 m_framesAlive;
+		friend class ndBrainVectorEnvironment;
+	};
+
+	ndBrainVectorEnvironment(ndBrain* const policy);
+	virtual ~ndBrainVectorEnvironment();
+
+	ndBrain* GetPolicy() const;
+	void SetPolicy(ndBrain* const policy);
+
+	ndInt32 GetCount() const;
+	ndEnvironment* GetEnvironment(ndInt32 index) const;
+	void AddEnvironment(ndEnvironment* const environment);
+
+	ndInt32 GetFramesCount() const;
+	ndInt32 GetEpisodeCount() const;
+	const ndBrainMatrix& GetActions() const;
+	const ndBrainMatrix& GetObservations() const;
+
+	void Reset();
+	void Step(ndBrainFloat timestep);
+
+	protected:
+	// exploration hook, called after the batched prediction 
+	// and before the actions are applied to the environments.
+	virtual void SelectActions(ndBrainMatrix& actions);
+
+	// called once for each environment and step, in environment order.
+	// the next observation is the one before the environment is reset.
+	virtual void AddTransition(ndInt32 environmentIndex, 
+		const ndBrainVector& observation, const ndBrainVector& actions, 
+		ndBrainFloat reward, const ndBrainVector& nextObservation, bool terminalState);
+
+	// called after an environment reached a terminal state and was reset
+	virtual void EndEpisode(ndInt32 environmentIndex, ndInt32 framesAlive);
+
+	private:
+	void InitBuffers();
+
+	ndBrain* m_policy;
+	ndArray<ndEnvironment*> m_environments;
+	ndBrainMatrix m_actions;
+	ndBrainMatrix m_observations;
+	ndBrainMatrix m_nextObservations;
+	ndBrainVector m_rewards;
+	ndArray<ndInt32> m_terminalStates;
+	ndInt32 m_frameCount;
+	ndInt32 m_episodeCount;
+	bool m_initialized;
+};
+
+inline ndBrain* ndBrainVectorEnvironment::GetPolicy() const
+{
+	return m_policy;
+}
+
+inline ndInt32 ndBrainVectorEnvironment::GetCount() const
+{
+	return ndInt32(m_environments.GetCount());
+}
+
+inline ndBrainVectorEnvironment::ndEnvironment* ndBrainVectorEnvironment::GetEnvironment(ndInt32 index) const
+{
+	return m_environments[index];
+}
+
+inline ndInt32 ndBrainVectorEnvironment::GetFramesCount() const
+{
+	return m_frameCount;
+}
+
+inline ndInt32 ndBrainVectorEnvironment::GetEpisodeCount() const
+{
+	return m_episodeCount;
+}
+
+inline const ndBrainMatrix& ndBrainVectorEnvironment::GetActions() const
+{
+	return m_actions;
+}
+
+inline const ndBrainMatrix& ndBrainVectorEnvironment::GetObservations() const
+{
+	return m_observations;
+}
+
+#endif 
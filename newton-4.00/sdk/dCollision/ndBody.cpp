@@ -34,12 +34,14 @@ ndBody::ndBody()
 	,m_omega(ndVector::m_zero)
 	,m_localCentreOfMass(ndVector::m_wOne)
 	,m_globalCentreOfMass(ndVector::m_wOne)
+	,m_preciseCentreOfMass(ndVector::m_wOne)
 	,m_minAabb(ndVector::m_wOne)
 	,m_maxAabb(ndVector::m_wOne)
 	,m_rotation()
 	,m_notifyCallback(nullptr)
 	,m_deletedNode(nullptr)
 	,m_uniqueId(m_uniqueIdCount)
+	,m_sleepingCounter(0)
 	,m_flags(0)
 	,m_isStatic(0)
 	,m_autoSleep(1)
@@ -64,6 +66,15 @@ ndBody::~ndBody()
 	}
 }
 
+bool ndBody::IsMixedPrecision()
+{
+#ifdef D_NEWTON_USE_MIXED_PRECISION
+	return true;
+#else
+	return false;
+#endif
+}
+
 void ndBody::SetCentreOfMass(const ndVector& com)
 {
 	m_localCentreOfMass.m_x = com.m_x;
@@ -71,6 +82,7 @@ void ndBody::SetCentreOfMass(const ndVector& com)
 	m_localCentreOfMass.m_z = com.m_z;
 	m_localCentreOfMass.m_w = ndFloat32(1.0f);
 	m_globalCentreOfMass = m_matrix.TransformVector(m_localCentreOfMass);
+	m_preciseCentreOfMass = ndBigVector(m_globalCentreOfMass);
 }
 
 void ndBody::SetNotifyCallback(ndBodyNotify* const notify)
@@ -97,6 +109,7 @@ void ndBody::SetOmegaNoSleep(const ndVector& omega)
 void ndBody::SetOmega(const ndVector& omega)
 {
 	m_equilibrium = 0;
+	m_sleepingCounter = 0;
 	SetOmegaNoSleep(omega);
 }
 
@@ -108,6 +121,7 @@ void ndBody::SetVelocityNoSleep(const ndVector& veloc)
 void ndBody::SetVelocity(const ndVector& veloc)
 {
 	m_equilibrium = 0;
+	m_sleepingCounter = 0;
 	SetVelocityNoSleep(veloc);
 }
 
@@ -118,6 +132,7 @@ void ndBody::SetMatrixNoSleep(const ndMatrix& matrix)
 
 	m_rotation = ndQuaternion(m_matrix);
 	m_globalCentreOfMass = m_matrix.TransformVector(m_localCentreOfMass);
+	m_preciseCentreOfMass = ndBigVector(m_globalCentreOfMass);
 }
 
 void ndBody::SetMatrixAndCentreOfMass(const ndQuaternion& rotation, const ndVector& globalcom)
@@ -125,6 +140,7 @@ void ndBody::SetMatrixAndCentreOfMass(const ndQuaternion& rotation, const ndVect
 	m_rotation = rotation;
 	ndAssert(m_rotation.DotProduct(m_rotation).GetScalar() > ndFloat32(0.9999f));
 	m_globalCentreOfMass = globalcom;
+	m_preciseCentreOfMass = ndBigVector(m_globalCentreOfMass);
 	m_matrix = ndCalculateMatrix(rotation, m_matrix.m_posit);
 	m_matrix.m_posit = m_globalCentreOfMass - m_matrix.RotateVector(m_localCentreOfMass);
 }
@@ -132,6 +148,7 @@ void ndBody::SetMatrixAndCentreOfMass(const ndQuaternion& rotation, const ndVect
 void ndBody::SetMatrix(const ndMatrix& matrix)
 {
 	m_equilibrium = 0;
+	m_sleepingCounter = 0;
 	m_transformIsDirty = 1;
 	m_sceneForceUpdate = 1;
 	SetMatrixNoSleep(matrix);
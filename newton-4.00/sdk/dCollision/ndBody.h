@@ -75,6 +75,17 @@ class ndBody : public ndContainersFreeListAlloc<ndBody>
 	ndQuaternion GetRotation() const;
 	ndVector GetGlobalGetCentreOfMass() const;
 
+	// position and centre of mass relative to the world origin, in double precision 
+	// when the engine is built with mixed precision, for worlds far larger than the 
+	// float range. the float matrix used by the collision and the solver is relative 
+	// to the same origin, so adding the world origin gives the global position.
+	ndBigVector GetPrecisePosition() const;
+	ndBigVector GetPreciseCentreOfMass() const;
+
+	// true if the library accumulates the body positions in double precision,
+	// the class layout is the same either way.
+	D_COLLISION_API static bool IsMixedPrecision();
+
 	D_COLLISION_API virtual void SetNotifyCallback(ndBodyNotify* const notify);
 	D_COLLISION_API virtual void SetOmega(const ndVector& veloc);
 	D_COLLISION_API virtual void SetVelocity(const ndVector& veloc);
@@ -96,6 +107,7 @@ class ndBody : public ndContainersFreeListAlloc<ndBody>
 	ndVector m_omega;
 	ndVector m_localCentreOfMass;
 	ndVector m_globalCentreOfMass;
+	ndBigVector m_preciseCentreOfMass;
 	ndVector m_minAabb;
 	ndVector m_maxAabb;
 	ndQuaternion m_rotation;
@@ -103,6 +115,9 @@ class ndBody : public ndContainersFreeListAlloc<ndBody>
 	ndSpecialList<ndBody>::ndNode* m_deletedNode;
 
 	ndUnsigned32 m_uniqueId;
+	// consecutive steps the body has been within a sleep table entry, 
+	// any wake up starts the count again.
+	ndInt32 m_sleepingCounter;
 	union
 	{
 		ndUnsigned32 m_flags;
@@ -166,6 +181,16 @@ inline ndVector ndBody::GetGlobalGetCentreOfMass() const
 	return m_globalCentreOfMass;
 }
 
+inline ndBigVector ndBody::GetPreciseCentreOfMass() const
+{
+	return m_preciseCentreOfMass;
+}
+
+inline ndBigVector ndBody::GetPrecisePosition() const
+{
+	return GetPreciseCentreOfMass() - ndBigVector(m_matrix.RotateVector(m_localCentreOfMass) & ndVector::m_triplexMask);
+}
+
 inline ndVector ndBody::GetVelocity() const
 {
 	return m_veloc;
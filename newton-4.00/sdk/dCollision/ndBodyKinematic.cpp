@@ -121,6 +121,7 @@ ndBodyKinematic::ndBodyKinematic()
 	,m_sceneNodeIndex(-1)
 	,m_buildBodyNodeIndex(-1)
 	,m_buildSceneNodeIndex(-1)
+	,m_sleepIsland(-1)
 {
 	m_invWorldInertiaMatrix[3][3] = ndFloat32(1.0f);
 	m_shapeInstance.m_ownerBody = this;
@@ -137,6 +138,7 @@ ndBodyKinematic::~ndBodyKinematic()
 void ndBodyKinematic::SetSleepState(bool state)
 {
 	m_equilibrium = ndUnsigned8 (state ? 1 : 0);
+	m_sleepingCounter = 0;
 	if ((m_invMass.m_w > ndFloat32(0.0f)) && (m_veloc.DotProduct(m_veloc).GetScalar() < ndFloat32(1.0e-10f)) && (m_omega.DotProduct(m_omega).GetScalar() < ndFloat32(1.0e-10f))) 
 	{
 		ndVector invalidateVeloc(ndFloat32(10.0f));
@@ -172,6 +174,7 @@ void ndBodyKinematic::AttachContact(ndContact* const contact)
 	if (m_invMass.m_w > ndFloat32(0.0f))
 	{
 		m_equilibrium = 0;
+		m_sleepingCounter = 0;
 	}
 
 	m_contactList.AttachContact(contact);
@@ -185,6 +188,7 @@ void ndBodyKinematic::DetachContact(ndContact* const contact)
 	if (contact->IsActive() && m_invMass.m_w > ndFloat32(0.0f))
 	{
 		m_equilibrium = 0;
+		m_sleepingCounter = 0;
 	}
 	m_contactList.DetachContact(contact);
 }
@@ -604,7 +608,15 @@ void ndBodyKinematic::IntegrateVelocity(ndFloat32 timestep)
 {
 	ndAssert(m_veloc.m_w == ndFloat32(0.0f));
 	ndAssert(m_omega.m_w == ndFloat32(0.0f));
+#ifdef D_NEWTON_USE_MIXED_PRECISION
+	// accumulate the position in double, so that small steps 
+	// are not lost when the body is far from the origin.
+	m_preciseCentreOfMass += ndBigVector(m_veloc.Scale(timestep));
+	m_globalCentreOfMass = ndVector(m_preciseCentreOfMass);
+#else
 	m_globalCentreOfMass += m_veloc.Scale(timestep);
+	m_preciseCentreOfMass = ndBigVector(m_globalCentreOfMass);
+#endif
 
 	const ndFloat32 omegaMag2 = m_omega.DotProduct(m_omega).GetScalar();
 
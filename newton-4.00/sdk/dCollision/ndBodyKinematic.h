@@ -220,6 +220,7 @@ class ndBodyKinematic : public ndBody
 	ndInt32 m_sceneNodeIndex;
 	ndInt32 m_buildBodyNodeIndex;
 	ndInt32 m_buildSceneNodeIndex;
+	ndInt32 m_sleepIsland;
 
 	D_COLLISION_API static ndVector m_velocTol;
 
@@ -235,6 +236,9 @@ class ndBodyKinematic : public ndBody
 	friend class ndSkeletonContainer;
 	friend class ndModelArticulation;
 	friend class ndDynamicsUpdateSoa;
+	friend class ndDynamicsUpdateColored;
+	friend class ndDynamicsUpdateIsland;
+	friend class ndDynamicsUpdateSubstep;
 	friend class ndDynamicsUpdateAvx2;
 	friend class ndDynamicsUpdateSycl;
 	friend class ndDynamicsUpdateCuda;
@@ -389,6 +393,9 @@ inline void ndBodyKinematic::PrepareStep(ndInt32 index)
 	m_isStatic = ndUnsigned8(m_invMass.m_w == ndFloat32(0.0f));
 	m_equilibrium = ndUnsigned8 (m_isStatic | m_equilibrium);
 	m_equilibrium0 = m_equilibrium;
+
+	// a sleeping body starts counting again from zero when anything wakes it.
+	m_sleepingCounter = m_equilibrium ? 0 : m_sleepingCounter;
 }
 
 inline ndBodyKinematic::ndContactMap& ndBodyKinematic::GetContactMap()
@@ -63,6 +63,7 @@
 #include <ndShapeConvexHull.h>
 #include <ndShapeStaticMesh.h>
 #include <ndShapeHeightfield.h>
+#include <ndShapeTiledHeightfield.h>
 #include <ndConvexCastNotify.h>
 #include <ndBodyPlayerCapsule.h>
 #include <ndBodyTriggerVolume.h>
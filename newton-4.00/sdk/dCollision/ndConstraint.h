@@ -252,6 +252,9 @@ class ndConstraint: public ndContainersFreeListAlloc<ndConstraint>
 	friend class ndDynamicsUpdate;
 	friend class ndSkeletonContainer;
 	friend class ndDynamicsUpdateSoa;
+	friend class ndDynamicsUpdateColored;
+	friend class ndDynamicsUpdateIsland;
+	friend class ndDynamicsUpdateSubstep;
 	friend class ndDynamicsUpdateAvx2;
 } D_GCC_NEWTON_ALIGN_32 ;
 
@@ -2631,6 +2631,11 @@ ndInt32 ndContactSolver::CompoundContactsDiscrete()
 		}
 		else if (m_instance1.GetShape()->GetAsShapeStaticBVH())
 		{
+			// compressed trees do not expose the nodes, collide them as a generic static mesh
+			if (m_instance1.GetShape()->GetAsShapeStaticBVH()->IsCompressed())
+			{
+				return CompoundToStaticProceduralMesh();
+			}
 			return CompoundToShapeStaticBvhContactsDiscrete();
 		}
 		else if (m_instance1.GetShape()->GetAsShapeHeightfield())
@@ -28,15 +28,22 @@
 #include "ndShapeInstance.h"
 #include "ndPolygonMeshDesc.h"
 
-//ndPolygonMeshDesc::ndPolygonMeshDesc()
-//	:ndFastAabb()
-//	,m_boxDistanceTravelInMeshSpace(ndVector::m_zero)
-//	,m_maxT(ndFloat32(1.0f))
-//	,m_threadId(0)
-//	,m_ownTempBuffers(false)
-//	,m_doContinueCollisionTest(false)
-//{
-//}
+ndPolygonMeshDesc::ndPolygonMeshDesc()
+	:ndFastAabb()
+	,m_boxDistanceTravelInMeshSpace(ndVector::m_zero)
+	,m_vertexStrideInBytes(0)
+	,m_skinMargin(ndFloat32(0.0f))
+	,m_convexInstance(nullptr)
+	,m_polySoupInstance(nullptr)
+	,m_vertex(nullptr)
+	,m_staticMeshQuery(nullptr)
+	,m_proceduralStaticMeshFaceQuery(nullptr)
+	,m_maxT(ndFloat32(1.0f))
+	,m_threadId(0)
+	//,m_ownTempBuffers(false)
+	,m_doContinueCollisionTest(false)
+{
+}
 
 ndPolygonMeshDesc::ndPolygonMeshDesc(ndContactSolver& proxy, bool ccdMode)
 	:ndFastAabb()
@@ -40,6 +40,8 @@
 #define D_NARROW_PHASE_DIST			ndFloat32 (0.2f)
 #define D_CONTACT_TRANSLATION_ERROR	ndFloat32 (1.0e-3f)
 #define D_CONTACT_ANGULAR_ERROR		(ndFloat32 (0.25f * ndDegreeToRad))
+#define D_CONTACT_WARM_START_DIST	ndFloat32 (0.125f)
+#define D_CONTACT_WARM_START_COS	ndFloat32 (0.9f)
 
 ndVector ndScene::m_velocTol(ndFloat32(1.0e-16f));
 ndVector ndScene::m_angularContactError2(D_CONTACT_ANGULAR_ERROR * D_CONTACT_ANGULAR_ERROR);
@@ -467,24 +469,30 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 	contact->m_material = m_contactNotifyCallback->GetMaterial(contact, body0->GetCollisionShape(), body1->GetCollisionShape());
 	const ndContactPoint* const contactArray = contactSolver->m_contactBuffer;
 	
+	const ndVector& v0 = body0->m_veloc;
+	const ndVector& w0 = body0->m_omega;
+	const ndVector& com0 = body0->m_globalCentreOfMass;
+	
+	const ndVector& v1 = body1->m_veloc;
+	const ndVector& w1 = body1->m_omega;
+	const ndVector& com1 = body1->m_globalCentreOfMass;
+
+	// the cached points were generated last step, move them with the bodies 
+	// so that the match with the new points does not depend on the body speed.
 	ndInt32 count = 0;
+	const ndVector halfTimestep(m_timestep * ndFloat32(0.5f));
 	ndVector cachePosition[D_MAX_CONTATCS];
 	ndContactPointList::ndNode* nodes[D_MAX_CONTATCS];
 	ndContactPointList& contactPointList = contact->m_contacPointsList;
 	for (ndContactPointList::ndNode* contactNode = contactPointList.GetFirst(); contactNode; contactNode = contactNode->GetNext()) 
 	{
+		const ndVector point(contactNode->GetInfo().m_point);
+		const ndVector pointVeloc0(v0 + w0.CrossProduct(point - com0));
+		const ndVector pointVeloc1(v1 + w1.CrossProduct(point - com1));
 		nodes[count] = contactNode;
-		cachePosition[count] = contactNode->GetInfo().m_point;
+		cachePosition[count] = point + (pointVeloc0 + pointVeloc1) * halfTimestep;
 		count++;
 	}
-	
-	const ndVector& v0 = body0->m_veloc;
-	const ndVector& w0 = body0->m_omega;
-	const ndVector& com0 = body0->m_globalCentreOfMass;
-	
-	const ndVector& v1 = body1->m_veloc;
-	const ndVector& w1 = body1->m_omega;
-	const ndVector& com1 = body1->m_globalCentreOfMass;
 
 	ndVector controlDir0(ndVector::m_zero);
 	ndVector controlDir1(ndVector::m_zero);
@@ -520,28 +528,42 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 	ndFloat32 maxImpulse = ndFloat32(-1.0f);
 	for (ndInt32 i = 0; i < contactCount; ++i) 
 	{
+		// a new point inherits the cached forces of the closest old point on the same 
+		// shape features, provided it did not move too far away.
 		ndInt32 index = -1;
-		ndFloat32 min = ndFloat32(1.0e20f);
+		ndFloat32 min = D_CONTACT_WARM_START_DIST * D_CONTACT_WARM_START_DIST;
 		ndContactPointList::ndNode* contactNode = nullptr;
 		for (ndInt32 j = 0; j < count; ++j) 
 		{
-			ndVector v(ndVector::m_triplexMask & (cachePosition[j] - contactArray[i].m_point));
-			ndAssert(v.m_w == ndFloat32(0.0f));
-			diff = v.DotProduct(v).GetScalar();
-			if (diff < min) 
+			const ndContactMaterial& cachedPoint = nodes[j]->GetInfo();
+			if ((cachedPoint.m_shapeId0 == contactArray[i].m_shapeId0) && (cachedPoint.m_shapeId1 == contactArray[i].m_shapeId1))
 			{
-				index = j;
-				min = diff;
-				contactNode = nodes[j];
+				ndVector v(ndVector::m_triplexMask & (cachePosition[j] - contactArray[i].m_point));
+				ndAssert(v.m_w == ndFloat32(0.0f));
+				diff = v.DotProduct(v).GetScalar();
+				if (diff < min) 
+				{
+					index = j;
+					min = diff;
+					contactNode = nodes[j];
+				}
 			}
 		}
 	
+		ndVector cachedNormal(ndVector::m_zero);
+		ndVector cachedDir0(ndVector::m_zero);
+		ndVector cachedDir1(ndVector::m_zero);
 		if (contactNode) 
 		{
 			count--;
 			ndAssert(index != -1);
 			nodes[index] = nodes[count];
 			cachePosition[index] = cachePosition[count];
+
+			const ndContactMaterial& cachedPoint = contactNode->GetInfo();
+			cachedNormal = cachedPoint.m_normal;
+			cachedDir0 = cachedPoint.m_dir0;
+			cachedDir1 = cachedPoint.m_dir1;
 		}
 		else 
 		{
@@ -637,6 +659,26 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 		ndAssert(contactPoint->m_dir0.m_w == ndFloat32(0.0f));
 		ndAssert(contactPoint->m_dir0.m_w == ndFloat32(0.0f));
 		ndAssert(contactPoint->m_normal.m_w == ndFloat32(0.0f));
+
+		if (cachedNormal.DotProduct(contactPoint->m_normal).GetScalar() > D_CONTACT_WARM_START_COS)
+		{
+			// the friction directions are recalculated every step, 
+			// express the cached friction forces in the new tangent frame.
+			ndForceImpactPair& force0 = contactPoint->m_dir0_Force;
+			ndForceImpactPair& force1 = contactPoint->m_dir1_Force;
+			for (ndInt32 j = 0; j < ndInt32(sizeof(force0.m_initialGuess) / sizeof(force0.m_initialGuess[0])); ++j)
+			{
+				const ndVector friction(cachedDir0.Scale(force0.m_initialGuess[j]) + cachedDir1.Scale(force1.m_initialGuess[j]));
+				force0.m_initialGuess[j] = friction.DotProduct(contactPoint->m_dir0).GetScalar();
+				force1.m_initialGuess[j] = friction.DotProduct(contactPoint->m_dir1).GetScalar();
+			}
+		}
+		else
+		{
+			contactPoint->m_normal_Force.Clear();
+			contactPoint->m_dir0_Force.Clear();
+			contactPoint->m_dir1_Force.Clear();
+		}
 	}
 	
 	for (ndInt32 i = 0; i < count; ++i) 
@@ -888,9 +930,11 @@ void ndScene::CalculateContacts(ndInt32 threadIndex, ndContact* const contact)
 		{
 			ndAssert(body0->GetInvMass() > ndFloat32(0.0f));
 			body0->m_equilibrium = 0;
+			body0->m_sleepingCounter = 0;
 			if (body1->GetInvMass() > ndFloat32(0.0f))
 			{
 				body1->m_equilibrium = 0;
+				body1->m_sleepingCounter = 0;
 			}
 		}
 	}
@@ -1265,6 +1309,50 @@ void ndScene::SendBackgroundTask(ndBackgroundTask* const job)
 	m_backgroundThread.SendTask(job);
 }
 
+void ndScene::ShiftOrigin(const ndBigVector& offset)
+{
+	D_TRACKTIME();
+	const ndBigVector shift(offset & ndBigVector::m_triplexMask);
+	const ndVector floatShift(shift);
+	for (ndBodyListView::ndNode* node = m_bodyList.GetFirst(); node; node = node->GetNext())
+	{
+		ndBodyKinematic* const body = node->GetInfo()->GetAsBodyKinematic();
+#ifdef D_NEWTON_USE_MIXED_PRECISION
+		body->m_preciseCentreOfMass -= shift;
+		body->m_globalCentreOfMass = ndVector(body->m_preciseCentreOfMass);
+#else
+		body->m_globalCentreOfMass -= floatShift;
+		body->m_preciseCentreOfMass = ndBigVector(body->m_globalCentreOfMass);
+#endif
+		body->m_matrix.m_posit = body->m_globalCentreOfMass - body->m_matrix.RotateVector(body->m_localCentreOfMass);
+
+		// the aabb and the broad phase are updated at the beginning 
+		// of the next step, even for bodies at rest.
+		body->m_transformIsDirty = 1;
+		body->m_sceneForceUpdate = 1;
+	}
+
+	for (ndBodyList::ndNode* node = m_particleSetList.GetFirst(); node; node = node->GetNext())
+	{
+		ndBodyParticleSet* const particle = (*node->GetInfo())->GetAsBodyParticleSet();
+		ndArray<ndVector>& posit = particle->GetPositions();
+		for (ndInt32 i = 0; i < posit.GetCount(); ++i)
+		{
+			posit[i] -= floatShift;
+		}
+	}
+
+	// cached contact points are matched by position in the next step
+	for (ndInt32 i = 0; i < m_contactArray.GetCount(); ++i)
+	{
+		ndContactPointList& points = m_contactArray[i]->GetContactPoints();
+		for (ndContactPointList::ndNode* node = points.GetFirst(); node; node = node->GetNext())
+		{
+			node->GetInfo().m_point -= floatShift;
+		}
+	}
+}
+
 void ndScene::AddPair(ndBodyKinematic* const body0, ndBodyKinematic* const body1, ndInt32 threadId)
 {
 	const ndBodyKinematic::ndContactMap& contactMap0 = body0->GetContactMap();
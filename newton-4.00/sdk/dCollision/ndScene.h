@@ -98,6 +98,10 @@ class ndScene : public ndThreadPool
 
 	D_COLLISION_API void SendBackgroundTask(ndBackgroundTask* const job);
 
+	// move all bodies, particles and contacts by -offset, 
+	// the caller must make sure the scene is not updating.
+	D_COLLISION_API void ShiftOrigin(const ndBigVector& offset);
+
 	ndInt32 GetThreadCount() const;
 
 	virtual ndWorld* GetWorld() const;
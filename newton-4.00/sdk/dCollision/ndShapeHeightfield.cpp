@@ -45,6 +45,8 @@ ndShapeHeightfield::ndShapeHeightfield(
 	,m_maxBox(ndVector::m_zero)
 	,m_atributeMap(width * height)
 	,m_elevationMap(width * height)
+	,m_minMaxPyramid()
+	,m_mipLevels()
 	,m_horizontalScale_x(horizontalScale_x)
 	,m_horizontalScale_z(horizontalScale_z)
 	,m_horizontalScaleInv_x(ndFloat32(1.0f) / horizontalScale_x)
@@ -61,6 +63,7 @@ ndShapeHeightfield::ndShapeHeightfield(
 	memset(&m_atributeMap[0], 0, sizeof(ndInt8) * m_atributeMap.GetCount());
 	memset(&m_elevationMap[0], 0, sizeof(ndReal) * m_elevationMap.GetCount());
 
+	BuildMinMaxPyramid();
 	CalculateLocalObb();
 }
 
@@ -85,23 +88,111 @@ ndShapeInfo ndShapeHeightfield::GetShapeInfo() const
 
 void ndShapeHeightfield::CalculateLocalObb()
 {
-	ndReal y0 = ndReal (1.0e10f);
-	ndReal y1 = -ndReal(1.0e10f);
-	for (ndInt32 i = m_elevationMap.GetCount()-1; i >= 0; --i)
-	{
-		y0 = ndMin(y0, m_elevationMap[i]);
-		y1 = ndMax(y1, m_elevationMap[i]);
-	}
+	// the top of the pyramid is a single block covering the entire grid
+	const ndMipLevel& top = m_mipLevels[m_mipLevels.GetCount() - 1];
+	ndAssert((top.m_width == 1) && (top.m_height == 1));
+	const ndMinMax bounds(GetBlockMinMax(m_mipLevels.GetCount() - 1, 0, 0));
 
-	m_minBox = ndVector(ndFloat32(0.0f), ndFloat32 (y0), ndFloat32(0.0f), ndFloat32(0.0f));
-	m_maxBox = ndVector(ndFloat32(m_width-1) * m_horizontalScale_x, ndFloat32(y1), ndFloat32(m_height-1) * m_horizontalScale_z, ndFloat32(0.0f));
+	m_minBox = ndVector(ndFloat32(0.0f), ndFloat32 (bounds.m_min), ndFloat32(0.0f), ndFloat32(0.0f));
+	m_maxBox = ndVector(ndFloat32(m_width-1) * m_horizontalScale_x, ndFloat32(bounds.m_max), ndFloat32(m_height-1) * m_horizontalScale_z, ndFloat32(0.0f));
 
 	m_boxSize = (m_maxBox - m_minBox) * ndVector::m_half;
 	m_boxOrigin = (m_maxBox + m_minBox) * ndVector::m_half;
 }
 
+ndShapeHeightfield::ndMinMax ndShapeHeightfield::GetBlockMinMax(ndInt32 level, ndInt32 x, ndInt32 z) const
+{
+	ndMinMax bounds;
+	if (level == 0)
+	{
+		// the cells bounds come from its four vertices
+		const ndReal* const row0 = &m_elevationMap[z * m_width + x];
+		const ndReal* const row1 = row0 + m_width;
+		bounds.m_min = ndMin(ndMin(row0[0], row0[1]), ndMin(row1[0], row1[1]));
+		bounds.m_max = ndMax(ndMax(row0[0], row0[1]), ndMax(row1[0], row1[1]));
+	}
+	else
+	{
+		const ndMipLevel& mip = m_mipLevels[level];
+		bounds = m_minMaxPyramid[mip.m_offset + z * mip.m_width + x];
+	}
+	return bounds;
+}
+
+void ndShapeHeightfield::BuildMinMaxPyramid()
+{
+	// each level halves the number of blocks until a single block covers the whole grid,
+	// level zero are the grid cells and takes no storage
+	ndInt32 offset = 0;
+	ndInt32 levelWidth = m_width - 1;
+	ndInt32 levelHeight = m_height - 1;
+	m_mipLevels.SetCount(0);
+	for (bool done = false; !done;)
+	{
+		ndMipLevel level;
+		level.m_offset = offset;
+		level.m_width = levelWidth;
+		level.m_height = levelHeight;
+		m_mipLevels.PushBack(level);
+
+		offset += (m_mipLevels.GetCount() > 1) ? levelWidth * levelHeight : 0;
+		done = (levelWidth == 1) && (levelHeight == 1);
+		levelWidth = (levelWidth + 1) >> 1;
+		levelHeight = (levelHeight + 1) >> 1;
+	}
+	m_minMaxPyramid.SetCount(offset);
+	UpdateMinMaxPyramid(0, 0, m_width - 1, m_height - 1);
+}
+
+void ndShapeHeightfield::UpdateMinMaxPyramid(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1)
+{
+	// a vertex is shared by the four cells around it
+	ndInt32 cx0 = ndClamp(x0 - 1, 0, m_width - 2);
+	ndInt32 cz0 = ndClamp(z0 - 1, 0, m_height - 2);
+	ndInt32 cx1 = ndClamp(x1, 0, m_width - 2);
+	ndInt32 cz1 = ndClamp(z1, 0, m_height - 2);
+
+	for (ndInt32 i = 1; i < m_mipLevels.GetCount(); ++i)
+	{
+		const ndMipLevel& child = m_mipLevels[i - 1];
+		const ndMipLevel& parent = m_mipLevels[i];
+		cx0 = cx0 >> 1;
+		cz0 = cz0 >> 1;
+		cx1 = cx1 >> 1;
+		cz1 = cz1 >> 1;
+		for (ndInt32 z = cz0; z <= cz1; ++z)
+		{
+			const ndInt32 zc0 = z * 2;
+			const ndInt32 zc1 = ndMin(zc0 + 1, child.m_height - 1);
+			ndMinMax* const blocks = &m_minMaxPyramid[parent.m_offset + z * parent.m_width];
+			for (ndInt32 x = cx0; x <= cx1; ++x)
+			{
+				const ndInt32 xc0 = x * 2;
+				const ndInt32 xc1 = ndMin(xc0 + 1, child.m_width - 1);
+				const ndMinMax b00(GetBlockMinMax(i - 1, xc0, zc0));
+				const ndMinMax b01(GetBlockMinMax(i - 1, xc1, zc0));
+				const ndMinMax b10(GetBlockMinMax(i - 1, xc0, zc1));
+				const ndMinMax b11(GetBlockMinMax(i - 1, xc1, zc1));
+				ndMinMax& block = blocks[x];
+				block.m_min = ndMin(ndMin(b00.m_min, b01.m_min), ndMin(b10.m_min, b11.m_min));
+				block.m_max = ndMax(ndMax(b00.m_max, b01.m_max), ndMax(b10.m_max, b11.m_max));
+			}
+		}
+	}
+}
+
 void ndShapeHeightfield::UpdateElevationMapAabb()
 {
+	UpdateMinMaxPyramid(0, 0, m_width - 1, m_height - 1);
+	CalculateLocalObb();
+}
+
+void ndShapeHeightfield::UpdateElevationMapAabb(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1)
+{
+	// only refresh the blocks that contain the edited vertices
+	ndAssert(x0 <= x1);
+	ndAssert(z0 <= z1);
+	UpdateMinMaxPyramid(ndClamp(x0, 0, m_width - 1), ndClamp(z0, 0, m_height - 1), ndClamp(x1, 0, m_width - 1), ndClamp(z1, 0, m_height - 1));
 	CalculateLocalObb();
 }
 
@@ -216,16 +307,79 @@ void ndShapeHeightfield::GetLocalAabb(const ndVector& q0, const ndVector& q1, nd
 	ndAssert(p1.m_ix == FastInt(boxP1.m_x * m_horizontalScaleInv_x));
 	ndAssert(p1.m_iz == FastInt(boxP1.m_z * m_horizontalScaleInv_x));
 	
-	ndInt32 x0 = ndInt32(p0.m_ix);
-	ndInt32 x1 = ndInt32(p1.m_ix);
-	ndInt32 z0 = ndInt32(p0.m_iz);
-	ndInt32 z1 = ndInt32(p1.m_iz);
-	
-	ndFloat32 minHeight = ndFloat32(1.0e10f);
-	ndFloat32 maxHeight = ndFloat32(-1.0e10f);
-	CalculateMinAndMaxElevation(x0, x1, z0, z1, minHeight, maxHeight);
-	boxP0.m_y = minHeight;
-	boxP1.m_y = maxHeight;
+	const ndInt32 x0 = ndInt32(p0.m_ix);
+	const ndInt32 x1 = ndInt32(p1.m_ix);
+	const ndInt32 z0 = ndInt32(p0.m_iz);
+	const ndInt32 z1 = ndInt32(p1.m_iz);
+
+	class ndBlock
+	{
+		public:
+		ndInt32 m_level;
+		ndInt32 m_x;
+		ndInt32 m_z;
+	};
+
+	// convert the vertex range to the range of cells sharing those vertices 
+	const ndInt32 cx0 = ndMin(x0, m_width - 2);
+	const ndInt32 cz0 = ndMin(z0, m_height - 2);
+	const ndInt32 cx1 = ndMax(ndMin(x1 - 1, m_width - 2), cx0);
+	const ndInt32 cz1 = ndMax(ndMin(z1 - 1, m_height - 2), cz0);
+
+	ndReal minVal = ndReal(1.0e10f);
+	ndReal maxVal = -ndReal(1.0e10f);
+
+	ndBlock stack[D_HEIGHTFIELD_STACK_DEPTH];
+	stack[0].m_level = m_mipLevels.GetCount() - 1;
+	stack[0].m_x = 0;
+	stack[0].m_z = 0;
+	ndInt32 stackIndex = 1;
+	while (stackIndex)
+	{
+		stackIndex--;
+		const ndBlock block(stack[stackIndex]);
+		const ndInt32 bx0 = block.m_x << block.m_level;
+		const ndInt32 bz0 = block.m_z << block.m_level;
+		const ndInt32 bx1 = ndMin(bx0 + (1 << block.m_level) - 1, m_width - 2);
+		const ndInt32 bz1 = ndMin(bz0 + (1 << block.m_level) - 1, m_height - 2);
+		if ((bx0 > cx1) || (bz0 > cz1) || (bx1 < cx0) || (bz1 < cz0))
+		{
+			continue;
+		}
+
+		const ndMinMax bounds(GetBlockMinMax(block.m_level, block.m_x, block.m_z));
+		if ((bounds.m_min >= minVal) && (bounds.m_max <= maxVal))
+		{
+			// this block can not expand the current bounds
+			continue;
+		}
+
+		if ((block.m_level == 0) || ((bx0 >= cx0) && (bz0 >= cz0) && (bx1 <= cx1) && (bz1 <= cz1)))
+		{
+			minVal = ndMin(bounds.m_min, minVal);
+			maxVal = ndMax(bounds.m_max, maxVal);
+		}
+		else
+		{
+			const ndMipLevel& childLevel = m_mipLevels[block.m_level - 1];
+			const ndInt32 childX1 = ndMin(block.m_x * 2 + 1, childLevel.m_width - 1);
+			const ndInt32 childZ1 = ndMin(block.m_z * 2 + 1, childLevel.m_height - 1);
+			for (ndInt32 z = block.m_z * 2; z <= childZ1; ++z)
+			{
+				for (ndInt32 x = block.m_x * 2; x <= childX1; ++x)
+				{
+					ndAssert(stackIndex < ndInt32(sizeof(stack) / sizeof(stack[0])));
+					stack[stackIndex].m_level = block.m_level - 1;
+					stack[stackIndex].m_x = x;
+					stack[stackIndex].m_z = z;
+					stackIndex++;
+				}
+			}
+		}
+	}
+
+	boxP0.m_y = minVal;
+	boxP1.m_y = maxVal;
 	ndAssert(boxP0.m_x <= boxP1.m_x);
 	ndAssert(boxP0.m_y <= boxP1.m_y);
 	ndAssert(boxP0.m_z <= boxP1.m_z);
@@ -319,6 +473,16 @@ ndFloat32 ndShapeHeightfield::RayCastCell(const ndFastRay& ray, ndInt32 xIndex0,
 
 ndFloat32 ndShapeHeightfield::RayCast(ndRayCastNotify&, const ndVector& localP0, const ndVector& localP1, ndFloat32 maxT, const ndBody* const, ndContactPoint& contactOut) const
 {
+	class ndBlock
+	{
+		public:
+		ndFloat32 m_t0;
+		ndFloat32 m_t1;
+		ndInt32 m_level;
+		ndInt32 m_x;
+		ndInt32 m_z;
+	};
+
 	ndVector boxP0;
 	ndVector boxP1;
 
@@ -329,126 +493,235 @@ ndFloat32 ndShapeHeightfield::RayCast(ndRayCastNotify&, const ndVector& localP0,
 	ndVector p1(localP1);
 	
 	// clip the line against the bounding box
-	if (ndRayBoxClip(p0, p1, boxP0, boxP1)) 
+	if (!ndRayBoxClip(p0, p1, boxP0, boxP1)) 
 	{
-		ndVector dp(p1 - p0);
-		ndVector normalOut(ndVector::m_zero);
-	
-		ndFloat32 scale_x = m_horizontalScale_x;
-		ndFloat32 invScale_x = m_horizontalScaleInv_x;
-		ndFloat32 scale_z = m_horizontalScale_z;
-		ndFloat32 invScale_z = m_horizontalScaleInv_z;
-		ndInt32 ix0 = FastInt(p0.m_x * invScale_x);
-		ndInt32 iz0 = FastInt(p0.m_z * invScale_z);
-	
-		// implement a 3ddda line algorithm 
-		ndInt32 xInc;
-		ndFloat32 tx;
-		ndFloat32 stepX;
-		if (dp.m_x > ndFloat32(0.0f)) 
-		{
-			xInc = 1;
-			ndFloat32 val = ndFloat32(1.0f) / dp.m_x;
-			stepX = scale_x * val;
-			tx = (scale_x * ((ndFloat32)ix0 + ndFloat32(1.0f)) - p0.m_x) * val;
-		}
-		else if (dp.m_x < ndFloat32(0.0f)) 
-		{
-			xInc = -1;
-			ndFloat32 val = -ndFloat32(1.0f) / dp.m_x;
-			stepX = scale_x * val;
-			tx = -(scale_x * (ndFloat32)ix0 - p0.m_x) * val;
-		}
-		else 
-		{
-			xInc = 0;
-			stepX = ndFloat32(0.0f);
-			tx = ndFloat32(1.0e10f);
-		}
-	
-		ndInt32 zInc;
-		ndFloat32 tz;
-		ndFloat32 stepZ;
-		if (dp.m_z > ndFloat32(0.0f)) 
-		{
-			zInc = 1;
-			ndFloat32 val = ndFloat32(1.0f) / dp.m_z;
-			stepZ = scale_z * val;
-			tz = (scale_z * ((ndFloat32)iz0 + ndFloat32(1.0f)) - p0.m_z) * val;
-		}
-		else if (dp.m_z < ndFloat32(0.0f)) 
-		{
-			zInc = -1;
-			ndFloat32 val = -ndFloat32(1.0f) / dp.m_z;
-			stepZ = scale_z * val;
-			tz = -(scale_z * (ndFloat32)iz0 - p0.m_z) * val;
-		}
-		else 
-		{
-			zInc = 0;
-			stepZ = ndFloat32(0.0f);
-			tz = ndFloat32(1.0e10f);
-		}
-	
-		ndFloat32 txAcc = tx;
-		ndFloat32 tzAcc = tz;
-		ndInt32 xIndex0 = ix0;
-		ndInt32 zIndex0 = iz0;
-		ndFastRay ray(localP0, localP1);
-	
-		// for each cell touched by the line
-		do 
+		return ndFloat32(1.2f);
+	}
+
+	// implement a hierarchical 2d dda, walking the min max pyramid front to back
+	// and skipping all blocks the ray passes over or under.
+	const ndVector dp(localP1 - localP0);
+	const ndFloat32 tol = ndFloat32(1.0e-4f);
+	const ndFloat32 yPadding = ndFloat32(1.0e-3f);
+	const bool xIsZero = ndAbs(dp.m_x) < ndFloat32(1.0e-12f);
+	const bool zIsZero = ndAbs(dp.m_z) < ndFloat32(1.0e-12f);
+	const ndFloat32 invDx = xIsZero ? ndFloat32(0.0f) : ndFloat32(1.0f) / dp.m_x;
+	const ndFloat32 invDz = zIsZero ? ndFloat32(0.0f) : ndFloat32(1.0f) / dp.m_z;
+
+	ndVector normalOut(ndVector::m_zero);
+	ndFastRay ray(localP0, localP1);
+
+	ndBlock stack[D_HEIGHTFIELD_STACK_DEPTH];
+	stack[0].m_t0 = ndFloat32(0.0f);
+	stack[0].m_t1 = maxT;
+	stack[0].m_level = m_mipLevels.GetCount() - 1;
+	stack[0].m_x = 0;
+	stack[0].m_z = 0;
+	ndInt32 stackIndex = 1;
+
+	while (stackIndex)
+	{
+		stackIndex--;
+		const ndBlock block(stack[stackIndex]);
+		if (block.m_level == 0)
 		{
-			ndFloat32 t = RayCastCell(ray, xIndex0, zIndex0, normalOut, maxT);
-			if (t < maxT) 
+			ndFloat32 t = RayCastCell(ray, block.m_x, block.m_z, normalOut, maxT);
+			if (t < maxT)
 			{
-				// bail out at the first intersection and copy the data into the descriptor
+				// cells are visited front to back, so bail out at the first intersection
 				ndAssert(normalOut.m_w == ndFloat32(0.0f));
 				contactOut.m_normal = normalOut.Normalize();
-				contactOut.m_shapeId0 = m_atributeMap[zIndex0 * m_width + xIndex0];
-				contactOut.m_shapeId1 = m_atributeMap[zIndex0 * m_width + xIndex0];
-	
+				contactOut.m_shapeId0 = m_atributeMap[block.m_z * m_width + block.m_x];
+				contactOut.m_shapeId1 = m_atributeMap[block.m_z * m_width + block.m_x];
 				return t;
 			}
-	
-			if (txAcc < tzAcc) 
+			continue;
+		}
+
+		const ndMipLevel& childLevel = m_mipLevels[block.m_level - 1];
+		const ndInt32 childSize = 1 << (block.m_level - 1);
+		const ndInt32 childX1 = ndMin(block.m_x * 2 + 1, childLevel.m_width - 1);
+		const ndInt32 childZ1 = ndMin(block.m_z * 2 + 1, childLevel.m_height - 1);
+
+		ndInt32 count = 0;
+		ndBlock children[4];
+		for (ndInt32 z = block.m_z * 2; z <= childZ1; ++z)
+		{
+			for (ndInt32 x = block.m_x * 2; x <= childX1; ++x)
 			{
-				xIndex0 += xInc;
-				tx = txAcc;
-				txAcc += stepX;
+				// clip the ray segment to the child horizontal extend
+				const ndFloat32 x0 = ndFloat32(x * childSize) * m_horizontalScale_x;
+				const ndFloat32 x1 = ndFloat32(ndMin((x + 1) * childSize, m_width - 1)) * m_horizontalScale_x;
+				const ndFloat32 z0 = ndFloat32(z * childSize) * m_horizontalScale_z;
+				const ndFloat32 z1 = ndFloat32(ndMin((z + 1) * childSize, m_height - 1)) * m_horizontalScale_z;
+
+				ndFloat32 t0 = block.m_t0;
+				ndFloat32 t1 = block.m_t1;
+				if (xIsZero)
+				{
+					if ((localP0.m_x < x0) || (localP0.m_x > x1))
+					{
+						continue;
+					}
+				}
+				else
+				{
+					const ndFloat32 tx0 = (x0 - localP0.m_x) * invDx;
+					const ndFloat32 tx1 = (x1 - localP0.m_x) * invDx;
+					t0 = ndMax(t0, ndMin(tx0, tx1) - tol);
+					t1 = ndMin(t1, ndMax(tx0, tx1) + tol);
+				}
+				if (zIsZero)
+				{
+					if ((localP0.m_z < z0) || (localP0.m_z > z1))
+					{
+						continue;
+					}
+				}
+				else
+				{
+					const ndFloat32 tz0 = (z0 - localP0.m_z) * invDz;
+					const ndFloat32 tz1 = (z1 - localP0.m_z) * invDz;
+					t0 = ndMax(t0, ndMin(tz0, tz1) - tol);
+					t1 = ndMin(t1, ndMax(tz0, tz1) + tol);
+				}
+				if (t0 > t1)
+				{
+					continue;
+				}
+
+				// reject the child if the ray segment passes over or under it
+				const ndMinMax bounds(GetBlockMinMax(block.m_level - 1, x, z));
+				const ndFloat32 y0 = localP0.m_y + dp.m_y * t0;
+				const ndFloat32 y1 = localP0.m_y + dp.m_y * t1;
+				if ((ndMin(y0, y1) > ndFloat32(bounds.m_max) + yPadding) || (ndMax(y0, y1) < ndFloat32(bounds.m_min) - yPadding))
+				{
+					continue;
+				}
+
+				ndBlock& child = children[count];
+				child.m_t0 = t0;
+				child.m_t1 = t1;
+				child.m_level = block.m_level - 1;
+				child.m_x = x;
+				child.m_z = z;
+				count++;
 			}
-			else 
+		}
+
+		// push the children far to near so that the nearest is visited first
+		for (ndInt32 i = 1; i < count; ++i)
+		{
+			const ndBlock tmp(children[i]);
+			ndInt32 j = i - 1;
+			for (; (j >= 0) && (children[j].m_t0 < tmp.m_t0); --j)
 			{
-				zIndex0 += zInc;
-				tz = tzAcc;
-				tzAcc += stepZ;
+				children[j + 1] = children[j];
 			}
-		} while ((tx <= ndFloat32(1.0f)) || (tz <= ndFloat32(1.0f)));
+			children[j + 1] = tmp;
+		}
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			ndAssert(stackIndex < ndInt32(sizeof(stack) / sizeof(stack[0])));
+			stack[stackIndex] = children[i];
+			stackIndex++;
+		}
 	}
-	
+
 	// if no cell was hit, return a large value
 	return ndFloat32(1.2f);
 }
 
-void ndShapeHeightfield::CalculateMinAndMaxElevation(ndInt32 x0, ndInt32 x1, ndInt32 z0, ndInt32 z1, ndFloat32& minHeight, ndFloat32& maxHeight) const
+bool ndShapeHeightfield::CalculateOverlapingCells(ndInt32& x0, ndInt32& x1, ndInt32& z0, ndInt32& z1, ndFloat32 minHeight, ndFloat32 maxHeight) const
 {
-	ndReal minVal = ndReal(1.0e10f);
-	ndReal maxVal = -ndReal(1.0e10f);
-
-	ndInt32 base = z0 * m_width;
-	for (ndInt32 z = z0; z <= z1; ++z) 
+	class ndBlock
+	{
+		public:
+		ndInt32 m_level;
+		ndInt32 m_x;
+		ndInt32 m_z;
+	};
+
+	// find the smallest rectangle of cells, inside the vertex range,
+	// that has elevations overlapping the vertical extend of the box
+	const ndInt32 cx0 = x0;
+	const ndInt32 cz0 = z0;
+	const ndInt32 cx1 = x1 - 1;
+	const ndInt32 cz1 = z1 - 1;
+	ndAssert(cx0 <= cx1);
+	ndAssert(cz0 <= cz1);
+
+	ndInt32 rectX0 = cx1 + 1;
+	ndInt32 rectZ0 = cz1 + 1;
+	ndInt32 rectX1 = cx0 - 1;
+	ndInt32 rectZ1 = cz0 - 1;
+
+	ndBlock stack[D_HEIGHTFIELD_STACK_DEPTH];
+	stack[0].m_level = m_mipLevels.GetCount() - 1;
+	stack[0].m_x = 0;
+	stack[0].m_z = 0;
+	ndInt32 stackIndex = 1;
+	while (stackIndex)
 	{
-		for (ndInt32 x = x0; x <= x1; ++x) 
+		stackIndex--;
+		const ndBlock block(stack[stackIndex]);
+		const ndInt32 bx0 = ndMax(block.m_x << block.m_level, cx0);
+		const ndInt32 bz0 = ndMax(block.m_z << block.m_level, cz0);
+		const ndInt32 bx1 = ndMin(((block.m_x + 1) << block.m_level) - 1, cx1);
+		const ndInt32 bz1 = ndMin(((block.m_z + 1) << block.m_level) - 1, cz1);
+		if ((bx0 > bx1) || (bz0 > bz1))
 		{
-			ndReal high = m_elevationMap[base + x];
-			minVal = ndMin(high, minVal);
-			maxVal = ndMax(high, maxVal);
+			continue;
 		}
-		base += m_width;
+
+		if ((bx0 >= rectX0) && (bz0 >= rectZ0) && (bx1 <= rectX1) && (bz1 <= rectZ1))
+		{
+			// this block is already inside the overlapping rectangle
+			continue;
+		}
+
+		const ndMinMax bounds(GetBlockMinMax(block.m_level, block.m_x, block.m_z));
+		if ((ndFloat32(bounds.m_max) < minHeight) || (ndFloat32(bounds.m_min) > maxHeight))
+		{
+			continue;
+		}
+
+		if (block.m_level == 0)
+		{
+			rectX0 = ndMin(rectX0, bx0);
+			rectZ0 = ndMin(rectZ0, bz0);
+			rectX1 = ndMax(rectX1, bx1);
+			rectZ1 = ndMax(rectZ1, bz1);
+		}
+		else
+		{
+			const ndMipLevel& childLevel = m_mipLevels[block.m_level - 1];
+			const ndInt32 childX1 = ndMin(block.m_x * 2 + 1, childLevel.m_width - 1);
+			const ndInt32 childZ1 = ndMin(block.m_z * 2 + 1, childLevel.m_height - 1);
+			for (ndInt32 z = block.m_z * 2; z <= childZ1; ++z)
+			{
+				for (ndInt32 x = block.m_x * 2; x <= childX1; ++x)
+				{
+					ndAssert(stackIndex < ndInt32(sizeof(stack) / sizeof(stack[0])));
+					stack[stackIndex].m_level = block.m_level - 1;
+					stack[stackIndex].m_x = x;
+					stack[stackIndex].m_z = z;
+					stackIndex++;
+				}
+			}
+		}
+	}
+
+	if (rectX0 > rectX1)
+	{
+		return false;
 	}
 
-	minHeight = minVal;
-	maxHeight = maxVal;
+	x0 = rectX0;
+	z0 = rectZ0;
+	x1 = rectX1 + 1;
+	z1 = rectZ1 + 1;
+	return true;
 }
 
 void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
@@ -483,12 +756,11 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 		return;
 	}
 
-	ndFloat32 minHeight = ndFloat32(1.0e10f);
-	ndFloat32 maxHeight = ndFloat32(-1.0e10f);
 	data->SetSeparatingDistance(ndFloat32(0.0f));
-	CalculateMinAndMaxElevation(x0, x1, z0, z1, minHeight, maxHeight);
 
-	if (!((maxHeight < boxP0.m_y) || (minHeight > boxP1.m_y))) 
+	// shrink the grid rectangle to the cells that can touch the box vertical extend,
+	// for large boxes over rough terrain this culls most of the faces.
+	if (CalculateOverlapingCells(x0, x1, z0, z1, boxP0.m_y, boxP1.m_y))
 	{
 		ndPolygonMeshDesc::ndStaticMeshFaceQuery& query = *data->m_staticMeshQuery;
 		ndArray<ndVector>& vertex = data->m_proceduralStaticMeshFaceQuery->m_vertex;
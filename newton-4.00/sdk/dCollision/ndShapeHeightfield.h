@@ -25,6 +25,9 @@
 #include "ndCollisionStdafx.h"
 #include "ndShapeStaticMesh.h"
 
+#define D_HEIGHTFIELD_MAX_MIP_LEVELS	32
+#define D_HEIGHTFIELD_STACK_DEPTH		256
+
 class ndShapeHeightfield: public ndShapeStaticMesh
 {
 	public:
@@ -49,6 +52,23 @@ class ndShapeHeightfield: public ndShapeStaticMesh
 		ndTriangle m_triangle1;
 	};
 
+	// elevation bounds of a block of grid cells
+	class ndMinMax
+	{
+		public:
+		ndReal m_min;
+		ndReal m_max;
+	};
+
+	// one level of the min max pyramid, level zero are the grid cells and is read from the elevation map
+	class ndMipLevel
+	{
+		public:
+		ndInt32 m_offset;
+		ndInt32 m_width;
+		ndInt32 m_height;
+	};
+
 	enum ndGridConstruction
 	{
 		m_normalDiagonals = 0,
@@ -62,7 +82,11 @@ class ndShapeHeightfield: public ndShapeStaticMesh
 	ndArray<ndReal>& GetElevationMap();
 	const ndArray<ndReal>& GetElevationMap() const;
 
+	ndArray<ndInt8>& GetAttributeMap();
+	const ndArray<ndInt8>& GetAttributeMap() const;
+
 	D_COLLISION_API void UpdateElevationMapAabb();
+	D_COLLISION_API void UpdateElevationMapAabb(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1);
 	D_COLLISION_API void GetLocalAabb(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const;
 
 	protected:
@@ -75,17 +99,22 @@ class ndShapeHeightfield: public ndShapeStaticMesh
 
 	private: 
 	void CalculateLocalObb();
+	void BuildMinMaxPyramid();
+	void UpdateMinMaxPyramid(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1);
+	ndMinMax GetBlockMinMax(ndInt32 level, ndInt32 x, ndInt32 z) const;
+	bool CalculateOverlapingCells(ndInt32& x0, ndInt32& x1, ndInt32& z0, ndInt32& z1, ndFloat32 minHeight, ndFloat32 maxHeight) const;
 	ndInt32 FastInt(ndFloat32 x) const;
 	const ndInt32* GetIndexList() const;
 	void CalculateMinExtend2d(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const;
 	void CalculateMinExtend3d(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const;
 	ndFloat32 RayCastCell(const ndFastRay& ray, ndInt32 xIndex0, ndInt32 zIndex0, ndVector& normalOut, ndFloat32 maxT) const;
-	void CalculateMinAndMaxElevation(ndInt32 x0, ndInt32 x1, ndInt32 z0, ndInt32 z1, ndFloat32& minHeight, ndFloat32& maxHeight) const;
 
 	ndVector m_minBox;
 	ndVector m_maxBox;
 	ndArray<ndInt8> m_atributeMap;
 	ndArray<ndReal> m_elevationMap;
+	ndArray<ndMinMax> m_minMaxPyramid;
+	ndFixSizeArray<ndMipLevel, D_HEIGHTFIELD_MAX_MIP_LEVELS> m_mipLevels;
 	ndFloat32 m_horizontalScale_x;
 	ndFloat32 m_horizontalScale_z;
 	ndFloat32 m_horizontalScaleInv_x;
@@ -113,6 +142,16 @@ inline const ndArray<ndReal>& ndShapeHeightfield::GetElevationMap() const
 	return m_elevationMap;
 }
 
+inline ndArray<ndInt8>& ndShapeHeightfield::GetAttributeMap()
+{
+	return m_atributeMap;
+}
+
+inline const ndArray<ndInt8>& ndShapeHeightfield::GetAttributeMap() const
+{
+	return m_atributeMap;
+}
+
 inline ndInt32 ndShapeHeightfield::FastInt(ndFloat32 x) const
 {
 	ndInt32 i = ndInt32(x);
@@ -68,7 +68,29 @@ ndShapeStatic_bvh::ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder)
 {
 	Create(builder);
 	CalculateAdjacent();
+	CalculateBoxAndTriangleCount();
+}
+
+ndShapeStatic_bvh::ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder, ndThreadPool& threadPool, ndPolygonSoupBuildProgress* const progress)
+	:ndShapeStaticMesh(m_boundingBoxHierachy)
+	,ndAabbPolygonSoup()
+	,m_trianglesCount(0)
+{
+	threadPool.Begin();
+	const bool ok = Create(threadPool, builder, progress) && CalculateAdjacent(threadPool, progress);
+	threadPool.End();
+	if (ok)
+	{
+		CalculateBoxAndTriangleCount();
+	}
+}
+
+ndShapeStatic_bvh::~ndShapeStatic_bvh(void)
+{
+}
 
+void ndShapeStatic_bvh::CalculateBoxAndTriangleCount()
+{
 	ndVector p0;
 	ndVector p1;
 	GetAABB(p0, p1);
@@ -86,8 +108,30 @@ ndShapeStatic_bvh::ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder)
 	m_trianglesCount = data.m_triangleCount;
 }
 
-ndShapeStatic_bvh::~ndShapeStatic_bvh(void)
+ndShapeStatic_bvh::ndCacheStatus ndShapeStatic_bvh::LoadCache(const char* const path, bool verify)
 {
+	const ndCacheStatus status = ndAabbPolygonSoup::LoadCache(path, verify);
+	if (status == m_cacheLoaded)
+	{
+		CalculateBoxAndTriangleCount();
+	}
+	return status;
+}
+
+bool ndShapeStatic_bvh::Compress()
+{
+	if (!ndAabbPolygonSoup::Compress())
+	{
+		return false;
+	}
+
+	// the boxes are recalculated from the quantized vertices
+	ndVector p0;
+	ndVector p1;
+	GetAABB(p0, p1);
+	m_boxSize = (p1 - p0) * ndVector::m_half;
+	m_boxOrigin = (p1 + p0) * ndVector::m_half;
+	return true;
 }
 
 ndIntersectStatus ndShapeStatic_bvh::GetTriangleCount(void* const context, const ndFloat32* const, ndInt32, const ndInt32* const, ndInt32 indexCount, ndFloat32)
@@ -197,11 +241,56 @@ ndIntersectStatus ndShapeStatic_bvh::GetPolygon(void* const context, const ndFlo
 	return m_continueSearh;
 }
 
+ndIntersectStatus ndShapeStatic_bvh::GetDecodedPolygon(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance)
+{
+	ndPolygonMeshDesc& data = (*(ndPolygonMeshDesc*)context);
+	ndPolygonMeshDesc::ndStaticMeshFaceQuery& query = *data.m_staticMeshQuery;
+	ndArray<ndVector>& vertex = data.m_proceduralStaticMeshFaceQuery->m_vertex;
+
+	// the face was decoded to a temporary buffer, with the points
+	// followed by the face normal and the edge normals.
+	const ndInt32 base = vertex.GetCount();
+	const ndInt32 stride = ndInt32(strideInBytes / sizeof(ndFloat32));
+	for (ndInt32 i = 0; i < indexCount * 2 + 1; ++i)
+	{
+		const ndVector p(&polygon[i * stride]);
+		vertex.PushBack(p & ndVector::m_triplexMask);
+	}
+
+	query.m_hitDistance.PushBack(hitDistance);
+	query.m_faceIndexCount.PushBack(indexCount);
+	query.m_faceIndexStart.PushBack(query.m_faceVertexIndex.GetCount());
+	for (ndInt32 i = 0; i < indexCount; ++i)
+	{
+		query.m_faceVertexIndex.PushBack(indexArray[i] + base);
+	}
+	query.m_faceVertexIndex.PushBack(indexArray[indexCount]);
+	query.m_faceVertexIndex.PushBack(indexArray[indexCount + 1] + base);
+	for (ndInt32 i = 0; i < indexCount; ++i)
+	{
+		const ndInt32 edge = indexArray[indexCount + 2 + i];
+		query.m_faceVertexIndex.PushBack(((edge & (~D_CONCAVE_EDGE_MASK)) + base) | (edge & D_CONCAVE_EDGE_MASK));
+	}
+	query.m_faceVertexIndex.PushBack(indexArray[indexCount * 2 + 2]);
+	return m_continueSearh;
+}
+
 void ndShapeStatic_bvh::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 {
-	data->m_vertex = GetLocalVertexPool();
-	data->m_vertexStrideInBytes = GetStrideInBytes();
-	ForAllSectors(*data, data->m_boxDistanceTravelInMeshSpace, data->m_maxT, GetPolygon, data);
+	if (IsCompressed())
+	{
+		ndArray<ndVector>& vertex = data->m_proceduralStaticMeshFaceQuery->m_vertex;
+		vertex.SetCount(0);
+		ForAllSectors(*data, data->m_boxDistanceTravelInMeshSpace, data->m_maxT, GetDecodedPolygon, data);
+		data->m_vertex = vertex.GetCount() ? &vertex[0].m_x : nullptr;
+		data->m_vertexStrideInBytes = sizeof(ndVector);
+	}
+	else
+	{
+		data->m_vertex = GetLocalVertexPool();
+		data->m_vertexStrideInBytes = GetStrideInBytes();
+		ForAllSectors(*data, data->m_boxDistanceTravelInMeshSpace, data->m_maxT, GetPolygon, data);
+	}
 }
 
 
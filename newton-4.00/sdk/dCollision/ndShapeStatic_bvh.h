@@ -32,8 +32,15 @@ class ndShapeStatic_bvh: public ndShapeStaticMesh, public ndAabbPolygonSoup
 
 	D_COLLISION_API ndShapeStatic_bvh();
 	D_COLLISION_API ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder);
+
+	// builds the hierarchy and the adjacency on all the threads of the pool,
+	// the pool must be idle. The shape is empty if the build was canceled.
+	D_COLLISION_API ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder, ndThreadPool& threadPool, ndPolygonSoupBuildProgress* const progress = nullptr);
 	D_COLLISION_API virtual ~ndShapeStatic_bvh();
 
+	D_COLLISION_API virtual bool Compress();
+	D_COLLISION_API virtual ndCacheStatus LoadCache(const char* const path, bool verify = true);
+
 	void *operator new (size_t size);
 	void operator delete (void* ptr);
 
@@ -50,8 +57,10 @@ class ndShapeStatic_bvh: public ndShapeStaticMesh, public ndAabbPolygonSoup
 	static ndIntersectStatus ShowDebugPolygon(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
 	static ndIntersectStatus GetTriangleCount(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
 	static ndIntersectStatus GetPolygon(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
+	static ndIntersectStatus GetDecodedPolygon(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
 
 	private: 
+	void CalculateBoxAndTriangleCount();
 
 	static ndIntersectStatus CalculateHash (
 			void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes,
@@ -0,0 +1,492 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndContact.h"
+#include "ndShapeInstance.h"
+#include "ndPolygonMeshDesc.h"
+#include "ndShapeTiledHeightfield.h"
+
+#define D_TILED_HEIGHTFIELD_MAX_RESIDENT_TILES	64
+
+ndShapeTiledHeightfield::ndTile::ndTile(ndInt32 x, ndInt32 z)
+	:ndClassAlloc()
+	,m_heightfield(nullptr)
+	,m_userData(nullptr)
+	,m_x(x)
+	,m_z(z)
+	,m_lastUsed(0)
+	,m_loaded(false)
+{
+}
+
+ndShapeTiledHeightfield::ndTile::~ndTile()
+{
+	if (m_heightfield)
+	{
+		m_heightfield->Release();
+	}
+}
+
+ndShapeTiledHeightfield::ndShapeTiledHeightfield(
+	ndTileLoader* const loader, ndInt32 tileSize, ndInt32 tileCount_x, ndInt32 tileCount_z,
+	ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z, ndFloat32 minHeight, ndFloat32 maxHeight,
+	ndShapeHeightfield::ndGridConstruction constructionMode)
+	:ndShapeStaticProceduralMesh(
+		ndFloat32(tileSize * tileCount_x) * horizontalScale_x,
+		maxHeight - minHeight,
+		ndFloat32(tileSize * tileCount_z) * horizontalScale_z)
+	,m_loader(loader)
+	,m_tiles()
+	,m_lock()
+	,m_horizontalScale_x(horizontalScale_x)
+	,m_horizontalScale_z(horizontalScale_z)
+	,m_minHeight(minHeight)
+	,m_maxHeight(maxHeight)
+	,m_tileSize(tileSize)
+	,m_tileCount_x(tileCount_x)
+	,m_tileCount_z(tileCount_z)
+	,m_maxResidentTiles(D_TILED_HEIGHTFIELD_MAX_RESIDENT_TILES)
+	,m_frame(0)
+	,m_diagonalMode(constructionMode)
+{
+	ndAssert(loader);
+	ndAssert(tileSize >= 1);
+	ndAssert(tileCount_x >= 1);
+	ndAssert(tileCount_z >= 1);
+	ndAssert(maxHeight >= minHeight);
+
+	// the terrain starts at the origin, like a heightfield
+	const ndVector minBox(ndFloat32(0.0f), minHeight, ndFloat32(0.0f), ndFloat32(0.0f));
+	const ndVector maxBox(ndFloat32(tileSize * tileCount_x) * horizontalScale_x, maxHeight, ndFloat32(tileSize * tileCount_z) * horizontalScale_z, ndFloat32(0.0f));
+	m_boxSize = (maxBox - minBox) * ndVector::m_half;
+	m_boxOrigin = (maxBox + minBox) * ndVector::m_half;
+}
+
+ndShapeTiledHeightfield::~ndShapeTiledHeightfield()
+{
+	EvictAllTiles();
+	delete m_loader;
+}
+
+ndShapeInfo ndShapeTiledHeightfield::GetShapeInfo() const
+{
+	return ndShapeStaticProceduralMesh::GetShapeInfo();
+}
+
+ndUnsigned64 ndShapeTiledHeightfield::GetHash(ndUnsigned64 hash) const
+{
+	ndInt32 dims[3];
+	dims[0] = m_tileSize;
+	dims[1] = m_tileCount_x;
+	dims[2] = m_tileCount_z;
+	hash = ndCRC64(dims, sizeof(dims), hash);
+	hash = ndCRC64(&m_horizontalScale_x, sizeof(ndFloat32), hash);
+	hash = ndCRC64(&m_horizontalScale_z, sizeof(ndFloat32), hash);
+	return hash;
+}
+
+ndVector ndShapeTiledHeightfield::GetTileOrigin(const ndTile* const tile) const
+{
+	return ndVector(ndFloat32(tile->m_x * m_tileSize) * m_horizontalScale_x, ndFloat32(0.0f), ndFloat32(tile->m_z * m_tileSize) * m_horizontalScale_z, ndFloat32(0.0f));
+}
+
+void ndShapeTiledHeightfield::LoadTile(ndTile* const tile) const
+{
+	const ndInt32 vertexCount = m_tileSize + 1;
+	ndShapeHeightfield* const heightfield = new ndShapeHeightfield(vertexCount, vertexCount, m_diagonalMode, m_horizontalScale_x, m_horizontalScale_z);
+	heightfield->AddRef();
+	if (m_loader->LoadTile(*tile, heightfield->GetElevationMap(), heightfield->GetAttributeMap()))
+	{
+		ndAssert(heightfield->GetElevationMap().GetCount() == vertexCount * vertexCount);
+		ndAssert(heightfield->GetAttributeMap().GetCount() == vertexCount * vertexCount);
+		heightfield->UpdateElevationMapAabb();
+		tile->m_heightfield = heightfield;
+	}
+	else
+	{
+		// empty tiles stay resident so that they are not requested again
+		heightfield->Release();
+	}
+	tile->m_loaded.store(true);
+}
+
+void ndShapeTiledHeightfield::EvictTile(ndTileMap::ndNode* const node) const
+{
+	ndTile* const tile = node->GetInfo();
+	m_loader->UnloadTile(*tile);
+	delete tile;
+	m_tiles.Remove(node);
+}
+
+ndShapeTiledHeightfield::ndTile* ndShapeTiledHeightfield::GetTile(ndInt32 tile_x, ndInt32 tile_z) const
+{
+	if ((tile_x < 0) || (tile_z < 0) || (tile_x >= m_tileCount_x) || (tile_z >= m_tileCount_z))
+	{
+		return nullptr;
+	}
+
+	// collision queries run on all worker threads, tiles missing
+	// from the resident set are loaded lazily by the first thread that needs them.
+	// the lock only covers the map, the thread that inserts the tile loads it 
+	// outside the lock, and only the threads that need that same tile wait for it.
+	ndTile* tile = nullptr;
+	bool load = false;
+	{
+		ndScopeSpinLock lock(m_lock);
+		const ndUnsigned64 key = (ndUnsigned64(tile_z) << 32) + ndUnsigned64(tile_x);
+		ndTileMap::ndNode* const node = m_tiles.Find(key);
+		if (node)
+		{
+			tile = node->GetInfo();
+		}
+		else
+		{
+			tile = new ndTile(tile_x, tile_z);
+			m_tiles.Insert(tile, key);
+			load = true;
+		}
+		tile->m_lastUsed = m_frame;
+	}
+
+	if (load)
+	{
+		LoadTile(tile);
+	}
+	else
+	{
+		while (!tile->m_loaded.load())
+		{
+			ndThreadYield();
+		}
+	}
+	return tile;
+}
+
+const ndShapeTiledHeightfield::ndTile* ndShapeTiledHeightfield::FindTile(ndInt32 tile_x, ndInt32 tile_z) const
+{
+	ndScopeSpinLock lock(m_lock);
+	const ndUnsigned64 key = (ndUnsigned64(tile_z) << 32) + ndUnsigned64(tile_x);
+	ndTileMap::ndNode* const node = m_tiles.Find(key);
+	return (node && node->GetInfo()->m_loaded.load()) ? node->GetInfo() : nullptr;
+}
+
+void ndShapeTiledHeightfield::EvictAllTiles()
+{
+	while (m_tiles.GetCount())
+	{
+		EvictTile(m_tiles.GetRoot());
+	}
+}
+
+void ndShapeTiledHeightfield::UpdateResidentTiles(const ndVector* const points, ndInt32 count, ndFloat32 radius)
+{
+	m_frame++;
+	const ndFloat32 tileSize_x = ndFloat32(m_tileSize) * m_horizontalScale_x;
+	const ndFloat32 tileSize_z = ndFloat32(m_tileSize) * m_horizontalScale_z;
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		const ndInt32 x0 = ndMax(ndInt32(ndFloor((points[i].m_x - radius) / tileSize_x)), 0);
+		const ndInt32 z0 = ndMax(ndInt32(ndFloor((points[i].m_z - radius) / tileSize_z)), 0);
+		const ndInt32 x1 = ndMin(ndInt32(ndFloor((points[i].m_x + radius) / tileSize_x)), m_tileCount_x - 1);
+		const ndInt32 z1 = ndMin(ndInt32(ndFloor((points[i].m_z + radius) / tileSize_z)), m_tileCount_z - 1);
+		for (ndInt32 z = z0; z <= z1; ++z)
+		{
+			for (ndInt32 x = x0; x <= x1; ++x)
+			{
+				GetTile(x, z);
+			}
+		}
+	}
+
+	if (m_tiles.GetCount() > m_maxResidentTiles)
+	{
+		class CompareTiles
+		{
+			public:
+			ndInt32 Compare(const ndTileMap::ndNode* const nodeA, const ndTileMap::ndNode* const nodeB, void* const) const
+			{
+				const ndUnsigned32 a = nodeA->GetInfo()->m_lastUsed;
+				const ndUnsigned32 b = nodeB->GetInfo()->m_lastUsed;
+				return (a < b) ? -1 : ((a > b) ? 1 : 0);
+			}
+		};
+
+		// evict the least recently used tiles, but never the ones just requested
+		ndArray<ndTileMap::ndNode*> candidates;
+		ndTileMap::Iterator it(m_tiles);
+		for (it.Begin(); it; it++)
+		{
+			ndTileMap::ndNode* const node = it.GetNode();
+			if (node->GetInfo()->m_lastUsed != m_frame)
+			{
+				candidates.PushBack(node);
+			}
+		}
+
+		if (candidates.GetCount())
+		{
+			ndSort<ndTileMap::ndNode*, CompareTiles>(&candidates[0], candidates.GetCount(), nullptr);
+			for (ndInt32 i = 0; (i < candidates.GetCount()) && (m_tiles.GetCount() > m_maxResidentTiles); ++i)
+			{
+				EvictTile(candidates[i]);
+			}
+		}
+	}
+}
+
+void ndShapeTiledHeightfield::DebugShape(const ndMatrix& matrix, ndShapeDebugNotify& debugCallback) const
+{
+	// collect the loaded tiles under the lock, and draw them outside of it.
+	ndArray<const ndTile*> tiles;
+	{
+		ndScopeSpinLock lock(m_lock);
+		ndTileMap::Iterator it(m_tiles);
+		for (it.Begin(); it; it++)
+		{
+			const ndTile* const tile = it.GetNode()->GetInfo();
+			if (tile->m_loaded.load() && tile->m_heightfield)
+			{
+				tiles.PushBack(tile);
+			}
+		}
+	}
+
+	for (ndInt32 i = 0; i < tiles.GetCount(); ++i)
+	{
+		const ndTile* const tile = tiles[i];
+		ndMatrix tileMatrix(matrix);
+		tileMatrix.m_posit = matrix.TransformVector(GetTileOrigin(tile));
+		const ndShape* const shape = tile->m_heightfield;
+		shape->DebugShape(tileMatrix, debugCallback);
+	}
+}
+
+ndFloat32 ndShapeTiledHeightfield::RayCast(ndRayCastNotify& callback, const ndVector& localP0, const ndVector& localP1, ndFloat32 maxT, const ndBody* const body, ndContactPoint& contactOut) const
+{
+	const ndVector boxP0(m_boxOrigin - m_boxSize);
+	const ndVector boxP1(m_boxOrigin + m_boxSize);
+
+	ndVector p0(localP0);
+	ndVector p1(localP1);
+	if (!ndRayBoxClip(p0, p1, boxP0, boxP1))
+	{
+		return ndFloat32(1.2f);
+	}
+
+	// 2d dda over the tiles, each tile does its own ray cast in tile space.
+	const ndVector dp(p1 - p0);
+	const ndFloat32 scale_x = ndFloat32(m_tileSize) * m_horizontalScale_x;
+	const ndFloat32 scale_z = ndFloat32(m_tileSize) * m_horizontalScale_z;
+	ndInt32 xIndex = ndClamp(ndInt32(ndFloor(p0.m_x / scale_x)), 0, m_tileCount_x - 1);
+	ndInt32 zIndex = ndClamp(ndInt32(ndFloor(p0.m_z / scale_z)), 0, m_tileCount_z - 1);
+
+	ndInt32 xInc = 0;
+	ndFloat32 tx = ndFloat32(1.0e10f);
+	ndFloat32 stepX = ndFloat32(0.0f);
+	if (dp.m_x > ndFloat32(0.0f))
+	{
+		xInc = 1;
+		ndFloat32 val = ndFloat32(1.0f) / dp.m_x;
+		stepX = scale_x * val;
+		tx = (scale_x * ((ndFloat32)xIndex + ndFloat32(1.0f)) - p0.m_x) * val;
+	}
+	else if (dp.m_x < ndFloat32(0.0f))
+	{
+		xInc = -1;
+		ndFloat32 val = -ndFloat32(1.0f) / dp.m_x;
+		stepX = scale_x * val;
+		tx = -(scale_x * (ndFloat32)xIndex - p0.m_x) * val;
+	}
+
+	ndInt32 zInc = 0;
+	ndFloat32 tz = ndFloat32(1.0e10f);
+	ndFloat32 stepZ = ndFloat32(0.0f);
+	if (dp.m_z > ndFloat32(0.0f))
+	{
+		zInc = 1;
+		ndFloat32 val = ndFloat32(1.0f) / dp.m_z;
+		stepZ = scale_z * val;
+		tz = (scale_z * ((ndFloat32)zIndex + ndFloat32(1.0f)) - p0.m_z) * val;
+	}
+	else if (dp.m_z < ndFloat32(0.0f))
+	{
+		zInc = -1;
+		ndFloat32 val = -ndFloat32(1.0f) / dp.m_z;
+		stepZ = scale_z * val;
+		tz = -(scale_z * (ndFloat32)zIndex - p0.m_z) * val;
+	}
+
+	for (;;)
+	{
+		const ndTile* const tile = GetTile(xIndex, zIndex);
+		if (tile && tile->m_heightfield)
+		{
+			const ndVector origin(GetTileOrigin(tile));
+			const ndShape* const shape = tile->m_heightfield;
+			ndFloat32 t = shape->RayCast(callback, localP0 - origin, localP1 - origin, maxT, body, contactOut);
+			if (t < maxT)
+			{
+				// tiles are visited front to back, the first hit is the closest
+				return t;
+			}
+		}
+
+		if ((tx > ndFloat32(1.0f)) && (tz > ndFloat32(1.0f)))
+		{
+			break;
+		}
+		if (tx < tz)
+		{
+			xIndex += xInc;
+			tx += stepX;
+		}
+		else
+		{
+			zIndex += zInc;
+			tz += stepZ;
+		}
+		if ((xIndex < 0) || (zIndex < 0) || (xIndex >= m_tileCount_x) || (zIndex >= m_tileCount_z))
+		{
+			break;
+		}
+	}
+	return ndFloat32(1.2f);
+}
+
+void ndShapeTiledHeightfield::GetCollidingFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexList) const
+{
+	// the vertex rectangle covered by the box
+	const ndInt32 gridSize_x = m_tileSize * m_tileCount_x;
+	const ndInt32 gridSize_z = m_tileSize * m_tileCount_z;
+	const ndInt32 x0 = ndClamp(ndInt32(ndFloor(minBox.m_x / m_horizontalScale_x)), 0, gridSize_x);
+	const ndInt32 z0 = ndClamp(ndInt32(ndFloor(minBox.m_z / m_horizontalScale_z)), 0, gridSize_z);
+	const ndInt32 x1 = ndClamp(ndInt32(ndFloor(maxBox.m_x / m_horizontalScale_x)) + 1, 0, gridSize_x);
+	const ndInt32 z1 = ndClamp(ndInt32(ndFloor(maxBox.m_z / m_horizontalScale_z)) + 1, 0, gridSize_z);
+	if ((x0 >= x1) || (z0 >= z1))
+	{
+		return;
+	}
+
+	// vertices of skipped or empty tiles are not referenced by any face, 
+	// but they are cleared so that the array never has garbage.
+	const ndInt32 stride = x1 - x0 + 1;
+	vertex.SetCount(stride * (z1 - z0 + 1));
+	ndMemSet(&vertex[0], ndVector::m_zero, vertex.GetCount());
+
+	const ndInt32 tileStride = m_tileSize + 1;
+	const bool normalDiagonals = (m_diagonalMode == ndShapeHeightfield::m_normalDiagonals);
+	const ndInt32 tile_x0 = x0 / m_tileSize;
+	const ndInt32 tile_z0 = z0 / m_tileSize;
+	const ndInt32 tile_x1 = ndMin((x1 - 1) / m_tileSize, m_tileCount_x - 1);
+	const ndInt32 tile_z1 = ndMin((z1 - 1) / m_tileSize, m_tileCount_z - 1);
+	for (ndInt32 tz = tile_z0; tz <= tile_z1; ++tz)
+	{
+		for (ndInt32 tx = tile_x0; tx <= tile_x1; ++tx)
+		{
+			const ndTile* const tile = GetTile(tx, tz);
+			if (!(tile && tile->m_heightfield))
+			{
+				continue;
+			}
+
+			// reject the whole tile using its elevation bounds
+			const ndShapeHeightfield* const heightfield = tile->m_heightfield;
+			const ndVector tileP0(heightfield->GetObbOrigin() - heightfield->GetObbSize());
+			const ndVector tileP1(heightfield->GetObbOrigin() + heightfield->GetObbSize());
+			if ((tileP1.m_y < minBox.m_y) || (tileP0.m_y > maxBox.m_y))
+			{
+				continue;
+			}
+
+			const ndArray<ndReal>& elevation = heightfield->GetElevationMap();
+			const ndArray<ndInt8>& attributes = heightfield->GetAttributeMap();
+
+			const ndInt32 base_x = tx * m_tileSize;
+			const ndInt32 base_z = tz * m_tileSize;
+			const ndInt32 vx0 = ndMax(x0, base_x);
+			const ndInt32 vz0 = ndMax(z0, base_z);
+			const ndInt32 vx1 = ndMin(x1, base_x + m_tileSize);
+			const ndInt32 vz1 = ndMin(z1, base_z + m_tileSize);
+
+			// border vertices are written by both tiles with the same value
+			for (ndInt32 z = vz0; z <= vz1; ++z)
+			{
+				const ndFloat32 zVal = m_horizontalScale_z * (ndFloat32)z;
+				const ndReal* const row = &elevation[(z - base_z) * tileStride];
+				ndVector* const dst = &vertex[(z - z0) * stride];
+				for (ndInt32 x = vx0; x <= vx1; ++x)
+				{
+					dst[x - x0] = ndVector(m_horizontalScale_x * (ndFloat32)x, ndFloat32(row[x - base_x]), zVal, ndFloat32(0.0f));
+				}
+			}
+
+			for (ndInt32 z = vz0; z < vz1; ++z)
+			{
+				for (ndInt32 x = vx0; x < vx1; ++x)
+				{
+					const ndInt32 i00 = (z - z0) * stride + x - x0;
+					const ndInt32 i10 = i00 + 1;
+					const ndInt32 i01 = i00 + stride;
+					const ndInt32 i11 = i01 + 1;
+
+					const ndFloat32 y00 = vertex[i00].m_y;
+					const ndFloat32 y10 = vertex[i10].m_y;
+					const ndFloat32 y01 = vertex[i01].m_y;
+					const ndFloat32 y11 = vertex[i11].m_y;
+					const ndFloat32 cellMin = ndMin(ndMin(y00, y10), ndMin(y01, y11));
+					const ndFloat32 cellMax = ndMax(ndMax(y00, y10), ndMax(y01, y11));
+					if ((cellMax < minBox.m_y) || (cellMin > maxBox.m_y))
+					{
+						continue;
+					}
+
+					const ndInt32 material = attributes[(z - base_z) * tileStride + x - base_x];
+					faceList.PushBack(3);
+					faceList.PushBack(3);
+					faceMaterial.PushBack(material);
+					faceMaterial.PushBack(material);
+					if (normalDiagonals)
+					{
+						indexList.PushBack(i01);
+						indexList.PushBack(i10);
+						indexList.PushBack(i00);
+
+						indexList.PushBack(i10);
+						indexList.PushBack(i01);
+						indexList.PushBack(i11);
+					}
+					else
+					{
+						indexList.PushBack(i00);
+						indexList.PushBack(i11);
+						indexList.PushBack(i10);
+
+						indexList.PushBack(i11);
+						indexList.PushBack(i00);
+						indexList.PushBack(i01);
+					}
+				}
+			}
+		}
+	}
+}
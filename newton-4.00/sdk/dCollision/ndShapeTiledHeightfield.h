@@ -0,0 +1,154 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_SHAPE_TILED_HEIGHT_FIELD__
+#define __ND_SHAPE_TILED_HEIGHT_FIELD__
+
+#include "ndCollisionStdafx.h"
+#include "ndShapeHeightfield.h"
+#include "ndShapeStaticProceduralMesh.h"
+
+// A terrain made of a grid of fixed size heightfield tiles.
+// Only the tiles around the active bodies are kept in memory,
+// tiles are requested from the application on demand and evicted
+// when the number of resident tiles goes over budget.
+class ndShapeTiledHeightfield: public ndShapeStaticProceduralMesh
+{
+	public:
+	class ndTile: public ndClassAlloc
+	{
+		public:
+		ndTile(ndInt32 x, ndInt32 z);
+		~ndTile();
+
+		// valid after the tile is loaded, elevation and attributes
+		// are (tileSize + 1) x (tileSize + 1) with the border shared with the neighbor tiles.
+		ndShapeHeightfield* m_heightfield;
+		void* m_userData;
+		ndInt32 m_x;
+		ndInt32 m_z;
+		ndUnsigned32 m_lastUsed;
+		ndAtomic<bool> m_loaded;
+	};
+
+	// application side of the streaming, the loader can read the tile
+	// from a file, a memory mapped archive, or generate it procedurally.
+	class ndTileLoader: public ndClassAlloc
+	{
+		public:
+		ndTileLoader()
+		{
+		}
+
+		virtual ~ndTileLoader()
+		{
+		}
+
+		// fill the tile elevation and attribute maps.
+		// return false if the tile is empty and should not collide.
+		// collision threads call it outside the tile lock, so different 
+		// tiles can be loading at the same time.
+		virtual bool LoadTile(ndTile& tile, ndArray<ndReal>& elevation, ndArray<ndInt8>& attributes) = 0;
+
+		// called just before an resident tile is discarded
+		virtual void UnloadTile(ndTile&)
+		{
+		}
+	};
+
+	D_CLASS_REFLECTION(ndShapeTiledHeightfield, ndShapeStaticProceduralMesh)
+	D_COLLISION_API ndShapeTiledHeightfield(
+		ndTileLoader* const loader, ndInt32 tileSize, ndInt32 tileCount_x, ndInt32 tileCount_z,
+		ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z, ndFloat32 minHeight, ndFloat32 maxHeight,
+		ndShapeHeightfield::ndGridConstruction constructionMode = ndShapeHeightfield::m_normalDiagonals);
+	D_COLLISION_API virtual ~ndShapeTiledHeightfield();
+
+	ndInt32 GetTileSize() const;
+	ndInt32 GetResidentTileCount() const;
+	ndInt32 GetMaxResidentTiles() const;
+	void SetMaxResidentTiles(ndInt32 count);
+
+	// Load the tiles within radius of the points (in shape local space) and
+	// evict the least recently used tiles over the budget.
+	// must be called from the main thread, outside the world update.
+	D_COLLISION_API void UpdateResidentTiles(const ndVector* const points, ndInt32 count, ndFloat32 radius);
+	D_COLLISION_API void EvictAllTiles();
+
+	D_COLLISION_API const ndTile* FindTile(ndInt32 tile_x, ndInt32 tile_z) const;
+
+	protected:
+	D_COLLISION_API virtual ndShapeInfo GetShapeInfo() const;
+	D_COLLISION_API virtual ndUnsigned64 GetHash(ndUnsigned64 hash) const;
+	D_COLLISION_API virtual void DebugShape(const ndMatrix& matrix, ndShapeDebugNotify& debugCallback) const;
+	D_COLLISION_API virtual ndFloat32 RayCast(ndRayCastNotify& callback, const ndVector& localP0, const ndVector& localP1, ndFloat32 maxT, const ndBody* const body, ndContactPoint& contactOut) const;
+	D_COLLISION_API virtual void GetCollidingFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexListList) const;
+
+	private:
+	class ndTileMap: public ndTree<ndTile*, ndUnsigned64, ndContainersFreeListAlloc<ndTile*>>
+	{
+		public:
+		ndTileMap()
+			:ndTree<ndTile*, ndUnsigned64, ndContainersFreeListAlloc<ndTile*>>()
+		{
+		}
+	};
+
+	ndTile* GetTile(ndInt32 tile_x, ndInt32 tile_z) const;
+	void LoadTile(ndTile* const tile) const;
+	void EvictTile(ndTileMap::ndNode* const node) const;
+	ndVector GetTileOrigin(const ndTile* const tile) const;
+
+	ndTileLoader* m_loader;
+	mutable ndTileMap m_tiles;
+	mutable ndSpinLock m_lock;
+	ndFloat32 m_horizontalScale_x;
+	ndFloat32 m_horizontalScale_z;
+	ndFloat32 m_minHeight;
+	ndFloat32 m_maxHeight;
+	ndInt32 m_tileSize;
+	ndInt32 m_tileCount_x;
+	ndInt32 m_tileCount_z;
+	ndInt32 m_maxResidentTiles;
+	ndUnsigned32 m_frame;
+	ndShapeHeightfield::ndGridConstruction m_diagonalMode;
+};
+
+inline ndInt32 ndShapeTiledHeightfield::GetTileSize() const
+{
+	return m_tileSize;
+}
+
+inline ndInt32 ndShapeTiledHeightfield::GetResidentTileCount() const
+{
+	return m_tiles.GetCount();
+}
+
+inline ndInt32 ndShapeTiledHeightfield::GetMaxResidentTiles() const
+{
+	return m_maxResidentTiles;
+}
+
+inline void ndShapeTiledHeightfield::SetMaxResidentTiles(ndInt32 count)
+{
+	m_maxResidentTiles = ndMax(count, 1);
+}
+
+#endif
@@ -25,8 +25,11 @@
 #include "ndStack.h"
 #include "ndList.h"
 #include "ndMatrix.h"
+#include "ndProfiler.h"
 #include "ndPolyhedra.h"
+#include "ndThreadPool.h"
 #include "ndAabbPolygonSoup.h"
+#include "ndMemoryMappedFile.h"
 #include "ndPolygonSoupBuilder.h"
 
 #define DG_STACK_DEPTH 512
@@ -228,22 +231,612 @@ class ndAabbPolygonSoup::ndSplitInfo
 	ndVector m_p1;
 };
 
+#define D_AABB_SAH_BINS				16
+#define D_AABB_PARALLEL_SPLIT_SIZE	(1024 * 8)
+
+// splits a range of leaves with a binned surface area heuristic over the three axes,
+// falls back to the median split when the leaf centers can't be separated.
+class ndAabbSahSplit
+{
+	public:
+	class ndBins
+	{
+		public:
+		ndBins()
+		{
+			for (ndInt32 i = 0; i < 3; ++i)
+			{
+				for (ndInt32 j = 0; j < D_AABB_SAH_BINS; ++j)
+				{
+					m_p0[i][j] = ndVector(ndFloat32(1.0e15f));
+					m_p1[i][j] = ndVector(-ndFloat32(1.0e15f));
+					m_count[i][j] = 0;
+				}
+			}
+		}
+
+		void Merge(const ndBins& bins)
+		{
+			for (ndInt32 i = 0; i < 3; ++i)
+			{
+				for (ndInt32 j = 0; j < D_AABB_SAH_BINS; ++j)
+				{
+					m_p0[i][j] = m_p0[i][j].GetMin(bins.m_p0[i][j]);
+					m_p1[i][j] = m_p1[i][j].GetMax(bins.m_p1[i][j]);
+					m_count[i][j] += bins.m_count[i][j];
+				}
+			}
+		}
+
+		ndVector m_p0[3][D_AABB_SAH_BINS];
+		ndVector m_p1[3][D_AABB_SAH_BINS];
+		ndInt32 m_count[3][D_AABB_SAH_BINS];
+	};
+
+	class ndBounds
+	{
+		public:
+		ndBounds()
+			:m_p0(ndFloat32(1.0e15f))
+			,m_p1(-ndFloat32(1.0e15f))
+			,m_centerP0(ndFloat32(1.0e15f))
+			,m_centerP1(-ndFloat32(1.0e15f))
+		{
+		}
+
+		void Merge(const ndBounds& bounds)
+		{
+			m_p0 = m_p0.GetMin(bounds.m_p0);
+			m_p1 = m_p1.GetMax(bounds.m_p1);
+			m_centerP0 = m_centerP0.GetMin(bounds.m_centerP0);
+			m_centerP1 = m_centerP1.GetMax(bounds.m_centerP1);
+		}
+
+		ndVector m_p0;
+		ndVector m_p1;
+		ndVector m_centerP0;
+		ndVector m_centerP1;
+	};
+
+	ndAabbSahSplit(ndThreadPool* const threadPool, ndAabbPolygonSoup::ndNodeBuilder* const leafArray, ndInt32 leafCount)
+		:m_leafCount(1)
+	{
+		// only the large ranges at the top of the tree are worth binning in parallel
+		ndThreadPool* const pool = (threadPool && (leafCount >= D_AABB_PARALLEL_SPLIT_SIZE)) ? threadPool : nullptr;
+
+		const ndBounds bounds(CalculateBounds(pool, leafArray, leafCount));
+		m_p0 = bounds.m_p0 & ndVector::m_triplexMask;
+		m_p1 = bounds.m_p1 & ndVector::m_triplexMask;
+		if (leafCount == 2)
+		{
+			return;
+		}
+
+		const ndVector size((bounds.m_centerP1 - bounds.m_centerP0) & ndVector::m_triplexMask);
+		if (ndMax(size.m_x, ndMax(size.m_y, size.m_z)) > ndFloat32(1.0e-6f))
+		{
+			const ndVector origin(bounds.m_centerP0 & ndVector::m_triplexMask);
+			ndVector invScale(ndVector::m_zero);
+			for (ndInt32 i = 0; i < 3; ++i)
+			{
+				if (size[i] > ndFloat32(1.0e-6f))
+				{
+					invScale[i] = ndFloat32(D_AABB_SAH_BINS) * ndFloat32(0.999f) / size[i];
+				}
+			}
+			const ndBins bins(CalculateBins(pool, leafArray, leafCount, origin, invScale));
+
+			ndInt32 bestAxis = -1;
+			ndInt32 bestBin = -1;
+			ndFloat32 bestCost = ndFloat32(1.0e30f);
+			for (ndInt32 axis = 0; axis < 3; ++axis)
+			{
+				ndFloat32 rightArea[D_AABB_SAH_BINS];
+				ndVector p0(ndFloat32(1.0e15f));
+				ndVector p1(-ndFloat32(1.0e15f));
+				for (ndInt32 i = D_AABB_SAH_BINS - 1; i > 0; --i)
+				{
+					p0 = p0.GetMin(bins.m_p0[axis][i]);
+					p1 = p1.GetMax(bins.m_p1[axis][i]);
+					rightArea[i] = SurfaceArea(p0, p1);
+				}
+
+				ndInt32 leftCount = 0;
+				p0 = ndVector(ndFloat32(1.0e15f));
+				p1 = ndVector(-ndFloat32(1.0e15f));
+				for (ndInt32 i = 0; i < D_AABB_SAH_BINS - 1; ++i)
+				{
+					p0 = p0.GetMin(bins.m_p0[axis][i]);
+					p1 = p1.GetMax(bins.m_p1[axis][i]);
+					leftCount += bins.m_count[axis][i];
+					if (leftCount && (leftCount < leafCount))
+					{
+						const ndFloat32 cost = SurfaceArea(p0, p1) * ndFloat32(leftCount) + rightArea[i + 1] * ndFloat32(leafCount - leftCount);
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							bestAxis = axis;
+							bestBin = i;
+						}
+					}
+				}
+			}
+
+			if (bestAxis >= 0)
+			{
+				ndInt32 i0 = 0;
+				ndInt32 i1 = leafCount - 1;
+				const ndFloat32 axisOrigin = origin[bestAxis];
+				const ndFloat32 axisScale = invScale[bestAxis];
+				while (i0 <= i1)
+				{
+					const ndAabbPolygonSoup::ndNodeBuilder& leaf = leafArray[i0];
+					const ndFloat32 center = (leaf.m_p0[bestAxis] + leaf.m_p1[bestAxis]) * ndFloat32(0.5f);
+					if (GetBin(center, axisOrigin, axisScale) <= bestBin)
+					{
+						i0++;
+					}
+					else
+					{
+						ndSwap(leafArray[i0], leafArray[i1]);
+						i1--;
+					}
+				}
+				ndAssert(i0 > 0);
+				ndAssert(i0 < leafCount);
+				m_leafCount = i0;
+				return;
+			}
+		}
+
+		ndAabbPolygonSoup::ndSplitInfo info(leafArray, leafCount);
+		m_leafCount = info.m_axis;
+	}
+
+	static ndFloat32 SurfaceArea(const ndVector& p0, const ndVector& p1)
+	{
+		const ndVector size(p1 - p0);
+		return size.m_x * size.m_y + size.m_y * size.m_z + size.m_z * size.m_x;
+	}
+
+	static ndInt32 GetBin(ndFloat32 center, ndFloat32 origin, ndFloat32 scale)
+	{
+		return ndClamp(ndInt32((center - origin) * scale), 0, D_AABB_SAH_BINS - 1);
+	}
+
+	static ndBounds CalculateBounds(ndThreadPool* const threadPool, const ndAabbPolygonSoup::ndNodeBuilder* const leafArray, ndInt32 leafCount)
+	{
+		ndBounds partialBounds[D_MAX_THREADS_COUNT + 1];
+		auto CalculatePartialBounds = ndMakeObject::ndFunction([leafArray, leafCount, &partialBounds](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(CalculatePartialBounds);
+			ndBounds& bounds = partialBounds[threadIndex];
+			const ndStartEnd startEnd(leafCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				const ndAabbPolygonSoup::ndNodeBuilder& leaf = leafArray[i];
+				const ndVector center(ndVector::m_half * (leaf.m_p0 + leaf.m_p1));
+				bounds.m_p0 = bounds.m_p0.GetMin(leaf.m_p0);
+				bounds.m_p1 = bounds.m_p1.GetMax(leaf.m_p1);
+				bounds.m_centerP0 = bounds.m_centerP0.GetMin(center);
+				bounds.m_centerP1 = bounds.m_centerP1.GetMax(center);
+			}
+		});
+
+		ndInt32 threadCount = 1;
+		if (threadPool)
+		{
+			threadCount = threadPool->GetThreadCount();
+			threadPool->ParallelExecute(CalculatePartialBounds);
+		}
+		else
+		{
+			CalculatePartialBounds(0, 1);
+		}
+
+		ndBounds bounds;
+		for (ndInt32 i = 0; i < threadCount; ++i)
+		{
+			bounds.Merge(partialBounds[i]);
+		}
+		return bounds;
+	}
+
+	static ndBins CalculateBins(ndThreadPool* const threadPool, const ndAabbPolygonSoup::ndNodeBuilder* const leafArray, ndInt32 leafCount, const ndVector& origin, const ndVector& scale)
+	{
+		const ndInt32 threadCount = threadPool ? threadPool->GetThreadCount() : 1;
+		ndStack<ndBins> partialBinsPool(threadCount);
+		ndBins* const partialBins = &partialBinsPool[0];
+		auto CalculatePartialBins = ndMakeObject::ndFunction([leafArray, leafCount, partialBins, &origin, &scale](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(CalculatePartialBins);
+			ndBins& bins = *new (&partialBins[threadIndex]) ndBins();
+			const ndStartEnd startEnd(leafCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				const ndAabbPolygonSoup::ndNodeBuilder& leaf = leafArray[i];
+				const ndVector center(ndVector::m_half * (leaf.m_p0 + leaf.m_p1));
+				for (ndInt32 axis = 0; axis < 3; ++axis)
+				{
+					const ndInt32 bin = GetBin(center[axis], origin[axis], scale[axis]);
+					bins.m_p0[axis][bin] = bins.m_p0[axis][bin].GetMin(leaf.m_p0);
+					bins.m_p1[axis][bin] = bins.m_p1[axis][bin].GetMax(leaf.m_p1);
+					bins.m_count[axis][bin]++;
+				}
+			}
+		});
+
+		if (threadPool)
+		{
+			threadPool->ParallelExecute(CalculatePartialBins);
+		}
+		else
+		{
+			CalculatePartialBins(0, 1);
+		}
+
+		ndBins bins;
+		for (ndInt32 i = 0; i < threadCount; ++i)
+		{
+			bins.Merge(partialBins[i]);
+		}
+		return bins;
+	}
+
+	ndVector m_p0;
+	ndVector m_p1;
+	ndInt32 m_leafCount;
+};
+
+#define D_COMPRESSED_SOUP_TAG		-1
+#define D_COMPRESSED_FACE_BUFFER	256
+#define D_COMPRESSED_BOX_QUANTIZE	ndFloat32 (65535.0f)
+#define D_COMPRESSED_NORMAL_SCALE	ndFloat32 (32767.0f)
+#define D_COMPRESSED_MAX_FACE_BYTES	(1<<(32 - DG_INDEX_COUNT_BITS - 1))
+
+class ndAabbPolygonSoup::ndCompressedData: public ndClassAlloc
+{
+	public:
+	class ndVertexCluster
+	{
+		public:
+		ndTriplex m_origin;
+		ndTriplex m_scale;
+	};
+
+	D_MSV_NEWTON_ALIGN_32
+	class ndStackEntry
+	{
+		public:
+		ndVector m_p0;
+		ndVector m_p1;
+		const ndCompressedNode* m_node;
+		ndFloat32 m_dist;
+	} D_GCC_NEWTON_ALIGN_32;
+
+	ndCompressedData()
+		:ndClassAlloc()
+		,m_nodes(nullptr)
+		,m_clusters(nullptr)
+		,m_vertex(nullptr)
+		,m_normals(nullptr)
+		,m_faces(nullptr)
+		,m_nodesCount(0)
+		,m_vertexCount(0)
+		,m_normalCount(0)
+		,m_faceBytes(0)
+	{
+		memset(m_rootBox, 0, sizeof(m_rootBox));
+	}
+
+	~ndCompressedData()
+	{
+		if (m_nodes)
+		{
+			ndMemory::Free(m_nodes);
+		}
+		if (m_clusters)
+		{
+			ndMemory::Free(m_clusters);
+		}
+		if (m_vertex)
+		{
+			ndMemory::Free(m_vertex);
+		}
+		if (m_normals)
+		{
+			ndMemory::Free(m_normals);
+		}
+		if (m_faces)
+		{
+			ndMemory::Free(m_faces);
+		}
+	}
+
+	// the arrays belong to a mapped file, forget them so that they are not freed.
+	void Detach()
+	{
+		m_nodes = nullptr;
+		m_clusters = nullptr;
+		m_vertex = nullptr;
+		m_normals = nullptr;
+		m_faces = nullptr;
+	}
+
+	void Allocate()
+	{
+		m_nodes = (ndCompressedNode*)ndMemory::Malloc(size_t(sizeof(ndCompressedNode) * m_nodesCount));
+		m_clusters = (ndVertexCluster*)ndMemory::Malloc(size_t(sizeof(ndVertexCluster) * ndMax(GetClusterCount(), 1)));
+		m_vertex = (ndUnsigned16*)ndMemory::Malloc(size_t(sizeof(ndUnsigned16) * 3 * ndMax(m_vertexCount, 1)));
+		m_normals = (ndInt16*)ndMemory::Malloc(size_t(sizeof(ndInt16) * 3 * ndMax(m_normalCount, 1)));
+		m_faces = (ndUnsigned8*)ndMemory::Malloc(size_t(ndMax(m_faceBytes, 1)));
+	}
+
+	ndInt64 GetMemoryUsed() const
+	{
+		ndInt64 size = ndInt64(sizeof(ndCompressedData));
+		size += ndInt64(sizeof(ndCompressedNode)) * m_nodesCount;
+		size += ndInt64(sizeof(ndVertexCluster)) * GetClusterCount();
+		size += ndInt64(sizeof(ndUnsigned16)) * 3 * m_vertexCount;
+		size += ndInt64(sizeof(ndInt16)) * 3 * m_normalCount;
+		size += m_faceBytes;
+		return size;
+	}
+
+	inline ndInt32 GetClusterCount() const
+	{
+		return (m_vertexCount + D_COMPRESSED_CLUSTER_SIZE - 1) >> D_COMPRESSED_CLUSTER_SIZE_BITS;
+	}
+
+	inline ndVector GetRootP0() const
+	{
+		return ndVector(m_rootBox[0].m_x, m_rootBox[0].m_y, m_rootBox[0].m_z, ndFloat32(0.0f));
+	}
+
+	inline ndVector GetRootP1() const
+	{
+		return ndVector(m_rootBox[1].m_x, m_rootBox[1].m_y, m_rootBox[1].m_z, ndFloat32(0.0f));
+	}
+
+	static inline ndVector GetBoxScale(const ndVector& p0, const ndVector& p1)
+	{
+		return (p1 - p0) * ndVector(ndFloat32(1.0f) / D_COMPRESSED_BOX_QUANTIZE);
+	}
+
+	inline ndVector GetVertex(ndInt32 index) const
+	{
+		ndAssert(index < m_vertexCount);
+		const ndVertexCluster& cluster = m_clusters[index >> D_COMPRESSED_CLUSTER_SIZE_BITS];
+		const ndUnsigned16* const q = &m_vertex[index * 3];
+		const ndVector origin(cluster.m_origin.m_x, cluster.m_origin.m_y, cluster.m_origin.m_z, ndFloat32(0.0f));
+		const ndVector scale(cluster.m_scale.m_x, cluster.m_scale.m_y, cluster.m_scale.m_z, ndFloat32(0.0f));
+		return origin + ndVector(ndFloat32(q[0]), ndFloat32(q[1]), ndFloat32(q[2]), ndFloat32(0.0f)) * scale;
+	}
+
+	inline ndVector GetNormal(ndInt32 index) const
+	{
+		ndAssert(index < m_normalCount);
+		const ndInt16* const q = &m_normals[index * 3];
+		return ndVector(ndFloat32(q[0]), ndFloat32(q[1]), ndFloat32(q[2]), ndFloat32(0.0f)).Normalize();
+	}
+
+	static inline ndUnsigned32 ZigZag(ndInt32 value)
+	{
+		return (ndUnsigned32(value) << 1) ^ ndUnsigned32(value >> 31);
+	}
+
+	static inline ndInt32 UnZigZag(ndUnsigned32 value)
+	{
+		return ndInt32(value >> 1) ^ (-ndInt32(value & 1));
+	}
+
+	static inline void WriteVarint(ndArray<ndUnsigned8>& stream, ndUnsigned32 value)
+	{
+		while (value >= 0x80)
+		{
+			stream.PushBack(ndUnsigned8(value | 0x80));
+			value >>= 7;
+		}
+		stream.PushBack(ndUnsigned8(value));
+	}
+
+	static inline ndUnsigned32 ReadVarint(const ndUnsigned8*& ptr)
+	{
+		ndInt32 shift = 0;
+		ndUnsigned32 value = 0;
+		ndUnsigned8 code;
+		do
+		{
+			code = *ptr++;
+			value |= ndUnsigned32(code & 0x7f) << shift;
+			shift += 7;
+		} while (code & 0x80);
+		return value;
+	}
+
+	// stream format: id, i0, i1 - i0, i2 - i1, ..., normal, e0Normal - normal, e1Normal - normal, ..., faceSize
+	// edge normals are stored with the concave bit in the lower bit, and zero for edges without an adjacent face.
+	void EncodeFace(ndArray<ndUnsigned8>& stream, const ndInt32* const face, ndInt32 indexCount, const ndArray<ndInt32>& vertexMap, const ndArray<ndInt32>& normalMap) const
+	{
+		WriteVarint(stream, ndUnsigned32(face[indexCount]));
+
+		ndInt32 index0 = vertexMap[face[0]];
+		WriteVarint(stream, ndUnsigned32(index0));
+		for (ndInt32 i = 1; i < indexCount; ++i)
+		{
+			const ndInt32 index1 = vertexMap[face[i]];
+			WriteVarint(stream, ZigZag(index1 - index0));
+			index0 = index1;
+		}
+
+		const ndInt32 normalIndex = normalMap[face[indexCount + 1]];
+		WriteVarint(stream, ndUnsigned32(normalIndex));
+		for (ndInt32 i = 0; i < indexCount; ++i)
+		{
+			const ndInt32 edge = face[indexCount + 2 + i];
+			if (edge == -1)
+			{
+				WriteVarint(stream, 0);
+			}
+			else
+			{
+				const ndUnsigned32 concave = (edge & D_CONCAVE_EDGE_MASK) ? 1 : 0;
+				const ndInt32 edgeNormal = normalMap[edge & (~D_CONCAVE_EDGE_MASK)];
+				WriteVarint(stream, ((ZigZag(edgeNormal - normalIndex) << 1) | concave) + 1);
+			}
+		}
+		WriteVarint(stream, ndUnsigned32(face[indexCount * 2 + 2]));
+	}
+
+	// decode a face to a temporary buffer, vertex array holds the face points
+	// followed by the face normal and the edge normals, and the index array
+	// has the same format as the uncompressed face.
+	void DecodeFace(ndUnsigned32 offset, ndInt32 indexCount, ndVector* const vertex, ndInt32* const indices) const
+	{
+		ndAssert((2 * indexCount + 3) <= D_COMPRESSED_FACE_BUFFER);
+		const ndUnsigned8* ptr = &m_faces[offset];
+		indices[indexCount] = ndInt32(ReadVarint(ptr));
+
+		ndInt32 index = ndInt32(ReadVarint(ptr));
+		vertex[0] = GetVertex(index);
+		indices[0] = 0;
+		for (ndInt32 i = 1; i < indexCount; ++i)
+		{
+			index += UnZigZag(ReadVarint(ptr));
+			vertex[i] = GetVertex(index);
+			indices[i] = i;
+		}
+
+		const ndInt32 normalIndex = ndInt32(ReadVarint(ptr));
+		vertex[indexCount] = GetNormal(normalIndex);
+		indices[indexCount + 1] = indexCount;
+		for (ndInt32 i = 0; i < indexCount; ++i)
+		{
+			const ndInt32 j = indexCount + 1 + i;
+			const ndUnsigned32 code = ReadVarint(ptr);
+			if (code)
+			{
+				const ndUnsigned32 edge = code - 1;
+				vertex[j] = GetNormal(normalIndex + UnZigZag(edge >> 1));
+				indices[indexCount + 2 + i] = (edge & 1) ? (j | D_CONCAVE_EDGE_MASK) : j;
+			}
+			else
+			{
+				vertex[j] = vertex[indexCount];
+				indices[indexCount + 2 + i] = j | D_CONCAVE_EDGE_MASK;
+			}
+		}
+		indices[indexCount * 2 + 2] = ndInt32(ReadVarint(ptr));
+	}
+
+	// find the smallest quantized box, relative to the parent box, that contains the box p0, p1
+	void QuantizeBox(const ndVector& parentP0, const ndVector& parentP1, const ndVector& p0, const ndVector& p1, ndCompressedNode& node) const
+	{
+		const ndVector scale(GetBoxScale(parentP0, parentP1));
+		for (ndInt32 i = 0; i < 3; ++i)
+		{
+			ndInt32 q0 = 0;
+			ndInt32 q1 = 0;
+			if (scale[i] > ndFloat32(0.0f))
+			{
+				q0 = ndClamp(ndInt32(ndFloor((p0[i] - parentP0[i]) / scale[i])), 0, 0xffff);
+				q1 = ndClamp(ndInt32(ndFloor((parentP1[i] - p1[i]) / scale[i])), 0, 0xffff);
+			}
+			node.m_box[i] = ndUnsigned16(q0);
+			node.m_box[i + 3] = ndUnsigned16(q1);
+		}
+
+		// correct for round off, a zero value always decodes to the parent box
+		bool done = false;
+		while (!done)
+		{
+			ndVector q0;
+			ndVector q1;
+			done = true;
+			node.GetBox(parentP0, parentP1, scale, q0, q1);
+			for (ndInt32 i = 0; i < 3; ++i)
+			{
+				if (q0[i] > p0[i])
+				{
+					ndAssert(node.m_box[i]);
+					node.m_box[i]--;
+					done = false;
+				}
+				if (q1[i] < p1[i])
+				{
+					ndAssert(node.m_box[i + 3]);
+					node.m_box[i + 3]--;
+					done = false;
+				}
+			}
+		}
+	}
+
+	static inline void PushStackEntry(ndStackEntry* const stackPool, ndInt32& stack, const ndCompressedNode* const node, const ndVector& p0, const ndVector& p1, ndFloat32 dist)
+	{
+		ndInt32 j = stack;
+		for (; j && (dist > stackPool[j - 1].m_dist); j--)
+		{
+			stackPool[j] = stackPool[j - 1];
+		}
+		ndAssert(stack < DG_STACK_DEPTH);
+		stackPool[j].m_p0 = p0;
+		stackPool[j].m_p1 = p1;
+		stackPool[j].m_node = node;
+		stackPool[j].m_dist = dist;
+		stack++;
+	}
+
+	ndTriplex m_rootBox[2];
+	ndCompressedNode* m_nodes;
+	ndVertexCluster* m_clusters;
+	ndUnsigned16* m_vertex;
+	ndInt16* m_normals;
+	ndUnsigned8* m_faces;
+	ndInt32 m_nodesCount;
+	ndInt32 m_vertexCount;
+	ndInt32 m_normalCount;
+	ndInt32 m_faceBytes;
+};
+
 ndAabbPolygonSoup::ndAabbPolygonSoup ()
 	:ndPolygonSoupDatabase()
 	,m_aabb(nullptr)
 	,m_indices(nullptr)
 	,m_nodesCount(0)
 	,m_indexCount(0)
+	,m_compressed(nullptr)
+	,m_mappedFile(nullptr)
 {
 }
 
 ndAabbPolygonSoup::~ndAabbPolygonSoup ()
 {
+	if (m_mappedFile)
+	{
+		// the arrays point to the mapped file
+		if (m_compressed)
+		{
+			m_compressed->Detach();
+		}
+		m_aabb = nullptr;
+		m_indices = nullptr;
+		m_localVertex = nullptr;
+	}
+
 	if (m_aabb) 
 	{
 		ndMemory::Free(m_aabb);
 		ndMemory::Free(m_indices);
 	}
+	if (m_compressed)
+	{
+		delete m_compressed;
+	}
+	if (m_mappedFile)
+	{
+		delete m_mappedFile;
+	}
 }
 
 ndFloat32 ndAabbPolygonSoup::CalculateFaceMaxDiagonal (const ndVector* const vertex, ndInt32 indexCount, const ndInt32* const indexArray) const
@@ -281,7 +874,12 @@ ndFloat32 ndAabbPolygonSoup::CalculateFaceMaxDiagonal (const ndVector* const ver
 
 void ndAabbPolygonSoup::GetAABB (ndVector& p0, ndVector& p1) const
 {
-	if (m_aabb) 
+	if (m_compressed)
+	{
+		p0 = m_compressed->GetRootP0();
+		p1 = m_compressed->GetRootP1();
+	}
+	else if (m_aabb) 
 	{ 
 		GetNodeAabb (m_aabb, p0, p1);
 	} 
@@ -294,6 +892,8 @@ void ndAabbPolygonSoup::GetAABB (ndVector& p0, ndVector& p1) const
 
 void ndAabbPolygonSoup::CalculateAdjacent ()
 {
+	ndAssert(!m_compressed);
+	ndAssert(!m_mappedFile);
 	ndVector p0;
 	ndVector p1;
 	GetAABB (p0, p1);
@@ -575,64 +1175,32 @@ ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown (ndNodeBuilder
 	}
 }
 
-void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
+void ndAabbPolygonSoup::FreeHierarchy ()
 {
-	if (builder.m_faceVertexCount.GetCount() == 0) 
+	if (m_aabb)
 	{
-		return;
+		ndMemory::Free(m_aabb);
+		ndMemory::Free(m_indices);
 	}
-	ndAssert (builder.m_faceVertexCount.GetCount() >= 1);
-	m_strideInBytes = sizeof (ndTriplex);
-	m_nodesCount = ((builder.m_faceVertexCount.GetCount() - 1) < 1) ? 1 : builder.m_faceVertexCount.GetCount() - 1;
-	m_aabb = (ndNode*) ndMemory::Malloc (sizeof (ndNode) * m_nodesCount);
-	m_indexCount = builder.m_vertexIndex.GetCount() * 2 + builder.m_faceVertexCount.GetCount();
-
-	if (builder.m_faceVertexCount.GetCount() == 1) 
+	if (m_localVertex)
 	{
-		m_indexCount *= 2;
+		ndMemory::Free(m_localVertex);
 	}
+	m_aabb = nullptr;
+	m_indices = nullptr;
+	m_localVertex = nullptr;
+	m_nodesCount = 0;
+	m_indexCount = 0;
+	m_vertexCount = 0;
+}
 
-	m_indices = (ndInt32*) ndMemory::Malloc (sizeof (ndInt32) * m_indexCount);
-	ndStack<ndVector> tmpVertexArrayCount(builder.m_vertexPoints.GetCount() + builder.m_normalPoints.GetCount() + builder.m_faceVertexCount.GetCount() * 2 + 4);
-
-	ndVector* const tmpVertexArray = &tmpVertexArrayCount[0];
-	for (ndInt32 i = 0; i < builder.m_vertexPoints.GetCount(); ++i) 
-	{
-		tmpVertexArray[i] = builder.m_vertexPoints[i];
-	}
-
-	for (ndInt32 i = 0; i < builder.m_normalPoints.GetCount(); ++i) 
-	{
-		tmpVertexArray[i + builder.m_vertexPoints.GetCount()] = builder.m_normalPoints[i];
-	}
-
-	const ndInt32* const indices = &builder.m_vertexIndex[0];
-	ndStack<ndNodeBuilder> constructor (builder.m_faceVertexCount.GetCount() * 2 + 16); 
-
-	ndInt32 polygonIndex = 0;
-	ndInt32 allocatorIndex = 0;
-	if (builder.m_faceVertexCount.GetCount() == 1) 
-	{
-		ndInt32 indexCount = builder.m_faceVertexCount[0] - 1;
-		new (&constructor[allocatorIndex]) ndNodeBuilder (&tmpVertexArray[0], 0, indexCount, &indices[0]);
-		allocatorIndex ++;
-	}
-	for (ndInt32 i = 0; i < builder.m_faceVertexCount.GetCount(); ++i) 
-	{
-		ndInt32 indexCount = builder.m_faceVertexCount[i] - 1;
-		new (&constructor[allocatorIndex]) ndNodeBuilder (&tmpVertexArray[0], i, indexCount, &indices[polygonIndex]);
-		allocatorIndex ++;
-		polygonIndex += (indexCount + 1);
-	}
-
-	ndNodeBuilder* constructorAllocator = &constructor[allocatorIndex];
-	ndNodeBuilder* const root = BuildTopDown (&constructor[0], 0, allocatorIndex - 1, &constructorAllocator);
-
-	ndAssert (root);
-	ndList<ndNodeBuilder*> list;
-	list.Append(root);
-	ndInt32 nodeIndex = 0;
-	while (list.GetCount())
+void ndAabbPolygonSoup::BuildNodes (ndThreadPool* const threadPool, const ndPolygonSoupBuilder& builder, ndNodeBuilder* const root, ndVector* const tmpVertexArray)
+{
+	ndAssert (root);
+	ndList<ndNodeBuilder*> list;
+	list.Append(root);
+	ndInt32 nodeIndex = 0;
+	while (list.GetCount())
 	{
 		ndNodeBuilder* const node = list.GetFirst()->GetInfo();
 		list.Remove(list.GetFirst());
@@ -736,7 +1304,9 @@ void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 	}
 
 	ndStack<ndInt32> indexArray (vertexIndex);
-	ndInt32 aabbPointCount = ndVertexListToIndexList (&aabbPoints[0].m_x, sizeof (ndVector), 3, vertexIndex, &indexArray[0], ndFloat32 (1.0e-6f));
+	ndInt32 aabbPointCount = threadPool ? 
+		ndVertexListToIndexList (*threadPool, &aabbPoints[0].m_x, sizeof (ndVector), 3, vertexIndex, &indexArray[0], ndFloat32 (1.0e-6f)) :
+		ndVertexListToIndexList (&aabbPoints[0].m_x, sizeof (ndVector), 3, vertexIndex, &indexArray[0], ndFloat32 (1.0e-6f));
 
 	m_vertexCount = aabbBase + aabbPointCount;
 	m_localVertex = (ndFloat32*) ndMemory::Malloc (sizeof (ndTriplex) * m_vertexCount);
@@ -759,6 +1329,64 @@ void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 		j = box.m_indexBox1 - aabbBase;
 		box.m_indexBox1 = indexArray[j] + aabbBase;
 	}
+}
+
+void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
+{
+	if (builder.m_faceVertexCount.GetCount() == 0) 
+	{
+		return;
+	}
+	ndAssert (builder.m_faceVertexCount.GetCount() >= 1);
+	ndAssert (!m_compressed);
+	ndAssert (!m_mappedFile);
+	m_strideInBytes = sizeof (ndTriplex);
+	m_nodesCount = ((builder.m_faceVertexCount.GetCount() - 1) < 1) ? 1 : builder.m_faceVertexCount.GetCount() - 1;
+	m_aabb = (ndNode*) ndMemory::Malloc (sizeof (ndNode) * m_nodesCount);
+	m_indexCount = builder.m_vertexIndex.GetCount() * 2 + builder.m_faceVertexCount.GetCount();
+
+	if (builder.m_faceVertexCount.GetCount() == 1) 
+	{
+		m_indexCount *= 2;
+	}
+
+	m_indices = (ndInt32*) ndMemory::Malloc (sizeof (ndInt32) * m_indexCount);
+	ndStack<ndVector> tmpVertexArrayCount(builder.m_vertexPoints.GetCount() + builder.m_normalPoints.GetCount() + builder.m_faceVertexCount.GetCount() * 2 + 4);
+
+	ndVector* const tmpVertexArray = &tmpVertexArrayCount[0];
+	for (ndInt32 i = 0; i < builder.m_vertexPoints.GetCount(); ++i) 
+	{
+		tmpVertexArray[i] = builder.m_vertexPoints[i];
+	}
+
+	for (ndInt32 i = 0; i < builder.m_normalPoints.GetCount(); ++i) 
+	{
+		tmpVertexArray[i + builder.m_vertexPoints.GetCount()] = builder.m_normalPoints[i];
+	}
+
+	const ndInt32* const indices = &builder.m_vertexIndex[0];
+	ndStack<ndNodeBuilder> constructor (builder.m_faceVertexCount.GetCount() * 2 + 16); 
+
+	ndInt32 polygonIndex = 0;
+	ndInt32 allocatorIndex = 0;
+	if (builder.m_faceVertexCount.GetCount() == 1) 
+	{
+		ndInt32 indexCount = builder.m_faceVertexCount[0] - 1;
+		new (&constructor[allocatorIndex]) ndNodeBuilder (&tmpVertexArray[0], 0, indexCount, &indices[0]);
+		allocatorIndex ++;
+	}
+	for (ndInt32 i = 0; i < builder.m_faceVertexCount.GetCount(); ++i) 
+	{
+		ndInt32 indexCount = builder.m_faceVertexCount[i] - 1;
+		new (&constructor[allocatorIndex]) ndNodeBuilder (&tmpVertexArray[0], i, indexCount, &indices[polygonIndex]);
+		allocatorIndex ++;
+		polygonIndex += (indexCount + 1);
+	}
+
+	ndNodeBuilder* constructorAllocator = &constructor[allocatorIndex];
+	ndNodeBuilder* const root = BuildTopDown (&constructor[0], 0, allocatorIndex - 1, &constructorAllocator);
+
+	BuildNodes(nullptr, builder, root, tmpVertexArray);
 
 	if (builder.m_faceVertexCount.GetCount() == 1) 
 	{
@@ -766,140 +1394,658 @@ void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 	}
 }
 
-void ndAabbPolygonSoup::Serialize (const char* const path) const
+ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown(ndThreadPool& threadPool, ndNodeBuilder* const leafArray, ndInt32 leafCount, ndPolygonSoupBuildProgress* const progress) const
 {
-	FILE* const file = fopen(path, "wb");
-	if (file)
+	D_TRACKTIME();
+	class ndBuildTask
 	{
-		fwrite(&m_vertexCount, sizeof(ndInt32), 1, file);
-		fwrite(&m_indexCount, sizeof(ndInt32), 1, file);
-		fwrite(&m_nodesCount, sizeof(ndInt32), 1, file);
-		if (m_aabb)
+		public:
+		ndNodeBuilder* m_parent;
+		ndNodeBuilder** m_link;
+		ndInt32 m_first;
+		ndInt32 m_count;
+	};
+
+	// the internal nodes of the leaves range [first, last] split at leaf
+	// m go to slot m - 1, so that sub trees can be built independently.
+	class ndSubTreeBuilder
+	{
+		public:
+		static ndNodeBuilder* Build(ndNodeBuilder* const leafArray, ndNodeBuilder* const nodeArray, ndInt32 first, ndInt32 count)
 		{
-			fwrite(m_localVertex, sizeof(ndTriplex) * m_vertexCount, 1, file);
-			fwrite(m_indices, sizeof(ndInt32) * m_indexCount, 1, file);
-			fwrite(m_aabb, sizeof(ndNode) * m_nodesCount, 1, file);
+			if (count == 1)
+			{
+				return &leafArray[first];
+			}
+			ndAabbSahSplit split(nullptr, &leafArray[first], count);
+			ndNodeBuilder* const parent = new (&nodeArray[first + split.m_leafCount - 1]) ndNodeBuilder(split.m_p0, split.m_p1);
+			parent->m_left = Build(leafArray, nodeArray, first, split.m_leafCount);
+			parent->m_left->m_parent = parent;
+			parent->m_right = Build(leafArray, nodeArray, first + split.m_leafCount, count - split.m_leafCount);
+			parent->m_right->m_parent = parent;
+			return parent;
 		}
-		fclose(file);
+	};
+
+	ndNodeBuilder* root = nullptr;
+	ndNodeBuilder* const nodeArray = &leafArray[leafCount];
+	const ndInt32 threadCount = threadPool.GetThreadCount();
+	const ndInt32 taskSize = ndMax(leafCount / (threadCount * 8), 256);
+
+	// split the top of the tree until the ranges are small enough to be built by one thread
+	ndArray<ndBuildTask> tasks;
+	ndArray<ndBuildTask> pending;
+	ndBuildTask rootTask;
+	rootTask.m_parent = nullptr;
+	rootTask.m_link = &root;
+	rootTask.m_first = 0;
+	rootTask.m_count = leafCount;
+	pending.PushBack(rootTask);
+	while (pending.GetCount())
+	{
+		const ndBuildTask task(pending[pending.GetCount() - 1]);
+		pending.SetCount(pending.GetCount() - 1);
+		if (task.m_count <= taskSize)
+		{
+			tasks.PushBack(task);
+		}
+		else
+		{
+			ndAabbSahSplit split(&threadPool, &leafArray[task.m_first], task.m_count);
+			ndNodeBuilder* const node = new (&nodeArray[task.m_first + split.m_leafCount - 1]) ndNodeBuilder(split.m_p0, split.m_p1);
+			node->m_parent = task.m_parent;
+			*task.m_link = node;
+
+			ndBuildTask left;
+			left.m_parent = node;
+			left.m_link = &node->m_left;
+			left.m_first = task.m_first;
+			left.m_count = split.m_leafCount;
+
+			ndBuildTask right;
+			right.m_parent = node;
+			right.m_link = &node->m_right;
+			right.m_first = task.m_first + split.m_leafCount;
+			right.m_count = task.m_count - split.m_leafCount;
+
+			pending.PushBack(right);
+			pending.PushBack(left);
+		}
+	}
+
+	const ndInt32 batchSize = threadCount * 2;
+	for (ndInt32 base = 0; base < tasks.GetCount(); base += batchSize)
+	{
+		if (progress && !progress->Update(ndPolygonSoupBuildProgress::m_buildHierarchy, ndFloat32(base) / ndFloat32(tasks.GetCount())))
+		{
+			return nullptr;
+		}
+
+		const ndInt32 count = ndMin(batchSize, tasks.GetCount() - base);
+		ndAtomic<ndInt32> iterator(0);
+		auto BuildSubTrees = ndMakeObject::ndFunction([&tasks, &iterator, leafArray, nodeArray, base, count](ndInt32, ndInt32)
+		{
+			D_TRACKTIME_NAMED(BuildSubTrees);
+			for (ndInt32 i = iterator.fetch_add(1); i < count; i = iterator.fetch_add(1))
+			{
+				const ndBuildTask& task = tasks[base + i];
+				ndNodeBuilder* const node = ndSubTreeBuilder::Build(leafArray, nodeArray, task.m_first, task.m_count);
+				node->m_parent = task.m_parent;
+				*task.m_link = node;
+			}
+		});
+		threadPool.ParallelExecute(BuildSubTrees);
 	}
+	return root;
 }
 
-void ndAabbPolygonSoup::Deserialize (const char* const path)
+bool ndAabbPolygonSoup::Create(ndThreadPool& threadPool, const ndPolygonSoupBuilder& builder, ndPolygonSoupBuildProgress* const progress)
 {
-	FILE* const file = fopen(path, "rb");
-	if (file)
+	D_TRACKTIME();
+	const ndInt32 faceCount = builder.m_faceVertexCount.GetCount();
+	if (faceCount <= 1)
 	{
-		size_t readValues = 0; 
-		readValues++;
-		m_strideInBytes = sizeof(ndTriplex);
-		readValues = fread(&m_vertexCount, sizeof(ndInt32), 1, file);
-		readValues = fread(&m_indexCount, sizeof(ndInt32), 1, file);
-		readValues = fread(&m_nodesCount, sizeof(ndInt32), 1, file);
+		// a single face duplicates the leaf, there is nothing to do in parallel
+		Create(builder);
+		return true;
+	}
+	ndAssert(!m_compressed);
+	ndAssert(!m_mappedFile);
+	m_strideInBytes = sizeof(ndTriplex);
+	m_nodesCount = faceCount - 1;
+	m_aabb = (ndNode*)ndMemory::Malloc(sizeof(ndNode) * m_nodesCount);
+	m_indexCount = builder.m_vertexIndex.GetCount() * 2 + faceCount;
+	m_indices = (ndInt32*)ndMemory::Malloc(sizeof(ndInt32) * m_indexCount);
+
+	const ndInt32 pointsCount = builder.m_vertexPoints.GetCount();
+	const ndInt32 vertexCount = pointsCount + builder.m_normalPoints.GetCount();
+	ndStack<ndVector> tmpVertexArrayCount(vertexCount + faceCount * 2 + 4);
+	ndStack<ndNodeBuilder> constructor(faceCount * 2 + 16);
+	ndStack<ndInt32> faceStartPool(faceCount);
 
-		if (m_vertexCount) 
-		{
-			m_localVertex = (ndFloat32*)ndMemory::Malloc(sizeof(ndTriplex) * m_vertexCount);
-			m_indices = (ndInt32*)ndMemory::Malloc(sizeof(ndInt32) * m_indexCount);
-			m_aabb = (ndNode*)ndMemory::Malloc(sizeof(ndNode) * m_nodesCount);
+	ndInt32 polygonIndex = 0;
+	ndInt32* const faceStart = &faceStartPool[0];
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		faceStart[i] = polygonIndex;
+		polygonIndex += builder.m_faceVertexCount[i];
+	}
 
-			readValues = fread(m_localVertex, sizeof(ndTriplex) * m_vertexCount, 1, file);
-			readValues = fread(m_indices, sizeof(ndInt32) * m_indexCount, 1, file);
-			readValues = fread(m_aabb, sizeof(ndNode) * m_nodesCount, 1, file);
+	ndVector* const tmpVertexArray = &tmpVertexArrayCount[0];
+	auto CopyVertices = ndMakeObject::ndFunction([&builder, tmpVertexArray, pointsCount, vertexCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CopyVertices);
+		const ndStartEnd startEnd(vertexCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			tmpVertexArray[i] = (i < pointsCount) ? builder.m_vertexPoints[i] : builder.m_normalPoints[i - pointsCount];
 		}
-		else 
+	});
+	threadPool.ParallelExecute(CopyVertices);
+
+	ndNodeBuilder* const leafArray = &constructor[0];
+	auto BuildLeaves = ndMakeObject::ndFunction([&builder, tmpVertexArray, leafArray, faceStart, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(BuildLeaves);
+		const ndInt32* const indices = &builder.m_vertexIndex[0];
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			m_localVertex = nullptr;
-			m_indices = nullptr;
-			m_aabb = nullptr;
+			new (&leafArray[i]) ndNodeBuilder(tmpVertexArray, i, builder.m_faceVertexCount[i] - 1, &indices[faceStart[i]]);
 		}
+	});
+	threadPool.ParallelExecute(BuildLeaves);
 
-		fclose(file);
+	ndNodeBuilder* const root = BuildTopDown(threadPool, leafArray, faceCount, progress);
+	if (!root)
+	{
+		FreeHierarchy();
+		return false;
 	}
+
+	BuildNodes(&threadPool, builder, root, tmpVertexArray);
+	return true;
 }
 
-ndVector ndAabbPolygonSoup::ForAllSectorsSupportVertex (const ndVector& dir) const
+bool ndAabbPolygonSoup::CalculateAdjacent(ndThreadPool& threadPool, ndPolygonSoupBuildProgress* const progress)
 {
-	ndVector supportVertex (ndFloat32 (0.0f));
-	if (m_aabb) 
+	D_TRACKTIME();
+	ndAssert(!m_compressed);
+	ndAssert(!m_mappedFile);
+	if (progress && !progress->Update(ndPolygonSoupBuildProgress::m_calculateAdjacency, ndFloat32(0.0f)))
 	{
-		ndFloat32 aabbProjection[DG_STACK_DEPTH];
-		const ndNode *stackPool[DG_STACK_DEPTH];
+		FreeHierarchy();
+		return false;
+	}
 
-		ndInt32 stack = 1;
-		stackPool[0] = m_aabb;
-		aabbProjection[0] = ndFloat32 (1.0e10f);
-		const ndTriplex* const boxArray = (ndTriplex*)m_localVertex;
+	// collect the faces in the same order the serial version visits them
+	ndArray<ndInt32> faceIndex;
+	ndArray<ndInt32> faceVertexCount;
+	for (ndInt32 i = 0; i < m_nodesCount; ++i)
+	{
+		const ndNode* const node = &m_aabb[i];
+		if (node->m_left.IsLeaf() && node->m_left.GetCount())
+		{
+			faceIndex.PushBack(ndInt32(node->m_left.GetIndex()));
+			faceVertexCount.PushBack(ndInt32(node->m_left.GetCount()));
+		}
+		if (node->m_right.IsLeaf() && node->m_right.GetCount())
+		{
+			faceIndex.PushBack(ndInt32(node->m_right.GetIndex()));
+			faceVertexCount.PushBack(ndInt32(node->m_right.GetCount()));
+		}
+	}
+	const ndInt32 faceCount = faceIndex.GetCount();
+	if (!faceCount)
+	{
+		return true;
+	}
 
-		ndFloat32 maxProj = ndFloat32 (-1.0e20f); 
-		ndInt32 ix = (dir[0] > ndFloat32 (0.0f)) ? 1 : 0;
-		ndInt32 iy = (dir[1] > ndFloat32 (0.0f)) ? 1 : 0;
-		ndInt32 iz = (dir[2] > ndFloat32 (0.0f)) ? 1 : 0;
+	ndInt32 edgeCount = 0;
+	ndStack<ndInt32> edgeStartPool(faceCount + 1);
+	ndInt32* const edgeStart = &edgeStartPool[0];
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		edgeStart[i] = edgeCount;
+		edgeCount += faceVertexCount[i];
+	}
+	edgeStart[faceCount] = edgeCount;
 
-		while (stack) 
+	// bucket the face edges by the hash of their undirected vertex pair
+	ndInt32 bucketCount = 1;
+	while (bucketCount < edgeCount)
+	{
+		bucketCount *= 2;
+	}
+	ndStack<ndInt32> edgeFacePool(edgeCount);
+	ndStack<ndUnsigned32> edgeBucketPool(edgeCount);
+	ndStack<ndInt32> bucketStartPool(bucketCount + 1);
+	ndStack<ndInt32> bucketEdgesPool(edgeCount);
+	ndInt32* const edgeFace = &edgeFacePool[0];
+	ndUnsigned32* const edgeBucket = &edgeBucketPool[0];
+	ndInt32* const bucketStart = &bucketStartPool[0];
+	ndInt32* const bucketEdges = &bucketEdgesPool[0];
+
+	ndInt32* const indices = m_indices;
+	const ndInt32* const faceIndexArray = &faceIndex[0];
+	const ndInt32* const faceVertexCountArray = &faceVertexCount[0];
+	auto HashEdges = ndMakeObject::ndFunction([indices, faceIndexArray, faceVertexCountArray, edgeStart, edgeFace, edgeBucket, bucketCount, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(HashEdges);
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndFloat32 boxSupportValue;
+			const ndInt32 count = faceVertexCountArray[i];
+			const ndInt32* const face = &indices[faceIndexArray[i]];
+			ndInt32 i0 = face[count - 1];
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				const ndInt32 i1 = face[j];
+				const ndUnsigned64 key = (ndUnsigned64(ndMin(i0, i1)) << 32) | ndUnsigned64(ndMax(i0, i1));
+				const ndUnsigned64 hash = key * ndUnsigned64(0x9E3779B97F4A7C15ULL);
+				const ndInt32 edge = edgeStart[i] + ((j + count - 1) % count);
+				edgeFace[edge] = i;
+				edgeBucket[edge] = ndUnsigned32(hash >> 32) & ndUnsigned32(bucketCount - 1);
+				i0 = i1;
+			}
+		}
+	});
+	threadPool.ParallelExecute(HashEdges);
 
-			stack--;
-			boxSupportValue = aabbProjection[stack];
-			if (boxSupportValue > maxProj) {
-				ndFloat32 backSupportDist = ndFloat32 (0.0f);
-				ndFloat32 frontSupportDist = ndFloat32 (0.0f);
-				const ndNode* const me = stackPool[stack];
-				if (me->m_left.IsLeaf()) 
-				{
-					backSupportDist = ndFloat32 (-1.0e20f);
-					ndInt32 index = ndInt32 (me->m_left.GetIndex());
-					ndInt32 vCount = ndInt32 (me->m_left.GetCount());
-					ndVector vertex (ndFloat32 (0.0f));
-					for (ndInt32 j = 0; j < vCount; ++j) 
-					{
-						ndInt32 i0 = m_indices[index + j] * ndInt32 (sizeof (ndTriplex) / sizeof (ndFloat32));
-						ndVector p (&boxArray[i0].m_x);
-						p = p & ndVector::m_triplexMask;
-						ndFloat32 dist = p.DotProduct(dir).GetScalar();
-						if (dist > backSupportDist) 
-						{
-							backSupportDist = dist;
-							vertex = p;
-						}
-					}
+	for (ndInt32 i = 0; i <= bucketCount; ++i)
+	{
+		bucketStart[i] = 0;
+	}
+	for (ndInt32 i = 0; i < edgeCount; ++i)
+	{
+		bucketStart[edgeBucket[i] + 1]++;
+	}
+	for (ndInt32 i = 0; i < bucketCount; ++i)
+	{
+		bucketStart[i + 1] += bucketStart[i];
+	}
+	for (ndInt32 i = 0; i < edgeCount; ++i)
+	{
+		const ndUnsigned32 bucket = edgeBucket[i];
+		bucketEdges[bucketStart[bucket]] = i;
+		bucketStart[bucket]++;
+	}
+	for (ndInt32 i = bucketCount; i > 0; --i)
+	{
+		bucketStart[i] = bucketStart[i - 1];
+	}
+	bucketStart[0] = 0;
 
-					if (backSupportDist > maxProj) 
-					{
-						maxProj = backSupportDist;
-						supportVertex = vertex; 
-					}
+	if (progress && !progress->Update(ndPolygonSoupBuildProgress::m_calculateAdjacency, ndFloat32(0.25f)))
+	{
+		FreeHierarchy();
+		return false;
+	}
 
-				} 
-				else 
+	// each edge finds its twin and writes the adjacent face normal to its own slot,
+	// edges shared by more than two faces are left open like the serial version.
+	const ndTriplex* const vertexArray = (ndTriplex*)GetLocalVertexPool();
+	auto MatchEdges = ndMakeObject::ndFunction([indices, vertexArray, faceIndexArray, faceVertexCountArray, edgeStart, edgeFace, edgeBucket, bucketStart, bucketEdges, edgeCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(MatchEdges);
+		const ndStartEnd startEnd(edgeCount, threadIndex, threadCount);
+		for (ndInt32 edge = startEnd.m_start; edge < startEnd.m_end; ++edge)
+		{
+			const ndInt32 face0 = edgeFace[edge];
+			const ndInt32 indexCount0 = faceVertexCountArray[face0];
+			const ndInt32 offsetIndex0 = edge - edgeStart[face0];
+			ndInt32* const indexArray0 = &indices[faceIndexArray[face0]];
+			const ndInt32 v0 = indexArray0[offsetIndex0];
+			const ndInt32 v1 = indexArray0[(offsetIndex0 + 1) % indexCount0];
+
+			ndInt32 twin = -1;
+			ndInt32 twinCount = 0;
+			ndInt32 sameCount = 0;
+			const ndUnsigned32 bucket = edgeBucket[edge];
+			for (ndInt32 i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i)
+			{
+				const ndInt32 edge1 = bucketEdges[i];
+				const ndInt32 face1 = edgeFace[edge1];
+				const ndInt32 offset1 = edge1 - edgeStart[face1];
+				const ndInt32* const indexArray1 = &indices[faceIndexArray[face1]];
+				const ndInt32 w0 = indexArray1[offset1];
+				const ndInt32 w1 = indexArray1[(offset1 + 1) % faceVertexCountArray[face1]];
+				if ((w0 == v1) && (w1 == v0))
 				{
-					ndVector box[2];
-					const ndNode* const node = me->m_left.GetNode(m_aabb);
-					box[0].m_x = boxArray[node->m_indexBox0].m_x;
-					box[0].m_y = boxArray[node->m_indexBox0].m_y;
-					box[0].m_z = boxArray[node->m_indexBox0].m_z;
-					box[1].m_x = boxArray[node->m_indexBox1].m_x;
-					box[1].m_y = boxArray[node->m_indexBox1].m_y;
-					box[1].m_z = boxArray[node->m_indexBox1].m_z;
-
-					ndVector supportPoint (box[ix].m_x, box[iy].m_y, box[iz].m_z, ndFloat32 (0.0));
-					backSupportDist = supportPoint.DotProduct(dir).GetScalar();
+					twin = edge1;
+					twinCount++;
 				}
-
-				if (me->m_right.IsLeaf()) 
+				else if ((w0 == v0) && (w1 == v1))
 				{
-					frontSupportDist = ndFloat32 (-1.0e20f);
-					ndInt32 index = ndInt32 (me->m_right.GetIndex());
-					ndInt32 vCount = ndInt32 (me->m_right.GetCount());
-					ndVector vertex (ndFloat32 (0.0f));
-					for (ndInt32 j = 0; j < vCount; ++j) 
-					{
-						ndInt32 i0 = m_indices[index + j] * ndInt32 (sizeof (ndTriplex) / sizeof (ndFloat32));
-						ndVector p (&boxArray[i0].m_x);
-						p = p & ndVector::m_triplexMask;
-						ndFloat32 dist = p.DotProduct(dir).GetScalar();
-						if (dist > frontSupportDist) 
-						{
+					sameCount++;
+				}
+			}
+
+			if ((twinCount != 1) || (sameCount != 1))
+			{
+				continue;
+			}
+
+			const ndInt32 face1 = edgeFace[twin];
+			const ndInt32 indexCount1 = faceVertexCountArray[face1];
+			const ndInt32* const indexArray1 = &indices[faceIndexArray[face1]];
+
+			ndVector n0(&vertexArray[indexArray0[indexCount0 + 1]].m_x);
+			ndVector q0(&vertexArray[indexArray0[0]].m_x);
+			n0 = n0 & ndVector::m_triplexMask;
+			q0 = q0 & ndVector::m_triplexMask;
+
+			ndVector n1(&vertexArray[indexArray1[indexCount1 + 1]].m_x);
+			ndVector q1(&vertexArray[indexArray1[0]].m_x);
+			n1 = n1 & ndVector::m_triplexMask;
+			q1 = q1 & ndVector::m_triplexMask;
+
+			ndPlane plane0(n0, -n0.DotProduct(q0).GetScalar());
+			ndPlane plane1(n1, -n1.DotProduct(q1).GetScalar());
+
+			ndFloat32 maxDist0 = ndFloat32(-1.0f);
+			for (ndInt32 i = 0; i < indexCount1; ++i)
+			{
+				ndVector point(&vertexArray[indexArray1[i]].m_x);
+				maxDist0 = ndMax(maxDist0, plane0.Evalue(point & ndVector::m_triplexMask));
+			}
+
+			ndFloat32 maxDist1 = ndFloat32(-1.0f);
+			for (ndInt32 i = 0; i < indexCount0; ++i)
+			{
+				ndVector point(&vertexArray[indexArray0[i]].m_x);
+				maxDist1 = ndMax(maxDist1, plane1.Evalue(point & ndVector::m_triplexMask));
+			}
+
+			bool edgeIsConvex = (maxDist0 <= ndFloat32(1.0e-3f));
+			edgeIsConvex = edgeIsConvex && (maxDist1 <= ndFloat32(1.0e-3f));
+			edgeIsConvex = edgeIsConvex || (n0.DotProduct(n1).GetScalar() > ndFloat32(0.9991f));
+			if (edgeIsConvex)
+			{
+				indexArray0[indexCount0 + 2 + offsetIndex0] = indexArray1[indexCount1 + 1];
+			}
+		}
+	});
+	threadPool.ParallelExecute(MatchEdges);
+
+	if (progress && !progress->Update(ndPolygonSoupBuildProgress::m_calculateAdjacency, ndFloat32(0.5f)))
+	{
+		FreeHierarchy();
+		return false;
+	}
+
+	// the open and concave edges get a normal perpendicular to the edge
+	ndStack<ndInt32> normalStartPool(faceCount + 1);
+	ndInt32* const normalStart = &normalStartPool[0];
+	auto CountEdgeNormals = ndMakeObject::ndFunction([indices, faceIndexArray, faceVertexCountArray, normalStart, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CountEdgeNormals);
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndInt32 count = 0;
+			const ndInt32 vCount = faceVertexCountArray[i];
+			const ndInt32* const face = &indices[faceIndexArray[i]];
+			for (ndInt32 j = 0; j < vCount; ++j)
+			{
+				count += (face[vCount + 2 + j] & D_CONCAVE_EDGE_MASK) ? 1 : 0;
+			}
+			normalStart[i] = count;
+		}
+	});
+	threadPool.ParallelExecute(CountEdgeNormals);
+
+	ndInt32 normalCount = 0;
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		const ndInt32 count = normalStart[i];
+		normalStart[i] = normalCount;
+		normalCount += count;
+	}
+	normalStart[faceCount] = normalCount;
+	if (!normalCount)
+	{
+		return true;
+	}
+
+	ndStack<ndTriplex> pool(normalCount);
+	ndTriplex* const normalPool = &pool[0];
+	auto CalculateEdgeNormals = ndMakeObject::ndFunction([indices, vertexArray, faceIndexArray, faceVertexCountArray, normalStart, normalPool, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateEdgeNormals);
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndInt32 vCount = faceVertexCountArray[i];
+			ndInt32* const face = &indices[faceIndexArray[i]];
+			ndInt32 normalIndex = normalStart[i];
+
+			ndInt32 j0 = 2 * (vCount + 1) - 1;
+			ndVector normal(&vertexArray[face[vCount + 1]].m_x);
+			normal = normal & ndVector::m_triplexMask;
+			ndVector q0(&vertexArray[face[vCount - 1]].m_x);
+			q0 = q0 & ndVector::m_triplexMask;
+			for (ndInt32 j = 0; j < vCount; ++j)
+			{
+				ndInt32 j1 = vCount + 2 + j;
+				ndVector q1(&vertexArray[face[j]].m_x);
+				q1 = q1 & ndVector::m_triplexMask;
+				if (face[j0] & D_CONCAVE_EDGE_MASK)
+				{
+					ndVector e(q1 - q0);
+					ndVector n(e.CrossProduct(normal).Normalize());
+					normalPool[normalIndex].m_x = n.m_x;
+					normalPool[normalIndex].m_y = n.m_y;
+					normalPool[normalIndex].m_z = n.m_z;
+					face[j0] = normalIndex | D_CONCAVE_EDGE_MASK;
+					normalIndex++;
+				}
+				q0 = q1;
+				j0 = j1;
+			}
+		}
+	});
+	threadPool.ParallelExecute(CalculateEdgeNormals);
+
+	if (progress && !progress->Update(ndPolygonSoupBuildProgress::m_calculateAdjacency, ndFloat32(0.75f)))
+	{
+		FreeHierarchy();
+		return false;
+	}
+
+	ndStack<ndInt32> indexArrayPool(normalCount);
+	ndInt32* const indexArray = &indexArrayPool[0];
+	ndInt32 newNormalCount = ndVertexListToIndexList(threadPool, &pool[0].m_x, sizeof(ndTriplex), 3, normalCount, &indexArray[0], ndFloat32(1.0e-6f));
+
+	const ndInt32 oldCount = GetVertexCount();
+	ndTriplex* const vertexArray1 = (ndTriplex*)ndMemory::Malloc(sizeof(ndTriplex) * (oldCount + newNormalCount));
+	ndMemCpy(vertexArray1, (ndTriplex*)GetLocalVertexPool(), oldCount);
+	ndMemCpy(&vertexArray1[oldCount], &pool[0], newNormalCount);
+	ndMemory::Free(GetLocalVertexPool());
+
+	m_localVertex = &vertexArray1[0].m_x;
+	m_vertexCount = oldCount + newNormalCount;
+
+	auto RemapEdgeNormals = ndMakeObject::ndFunction([indices, faceIndexArray, faceVertexCountArray, indexArray, oldCount, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(RemapEdgeNormals);
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndInt32 vCount = faceVertexCountArray[i];
+			ndInt32* const face = &indices[faceIndexArray[i]];
+			for (ndInt32 j = 0; j < vCount; ++j)
+			{
+				const ndInt32 edgeIndexNormal = face[vCount + 2 + j];
+				if (edgeIndexNormal & D_CONCAVE_EDGE_MASK)
+				{
+					const ndInt32 k = edgeIndexNormal & (~D_CONCAVE_EDGE_MASK);
+					face[vCount + 2 + j] = (indexArray[k] + oldCount) | D_CONCAVE_EDGE_MASK;
+				}
+			}
+		}
+	});
+	threadPool.ParallelExecute(RemapEdgeNormals);
+
+	if (progress && !progress->Update(ndPolygonSoupBuildProgress::m_calculateAdjacency, ndFloat32(1.0f)))
+	{
+		FreeHierarchy();
+		return false;
+	}
+	return true;
+}
+
+void ndAabbPolygonSoup::Serialize (const char* const path) const
+{
+	FILE* const file = fopen(path, "wb");
+	if (file && m_compressed)
+	{
+		SerializeCompressed(file);
+		fclose(file);
+	}
+	else if (file)
+	{
+		fwrite(&m_vertexCount, sizeof(ndInt32), 1, file);
+		fwrite(&m_indexCount, sizeof(ndInt32), 1, file);
+		fwrite(&m_nodesCount, sizeof(ndInt32), 1, file);
+		if (m_aabb)
+		{
+			fwrite(m_localVertex, sizeof(ndTriplex) * m_vertexCount, 1, file);
+			fwrite(m_indices, sizeof(ndInt32) * m_indexCount, 1, file);
+			fwrite(m_aabb, sizeof(ndNode) * m_nodesCount, 1, file);
+		}
+		fclose(file);
+	}
+}
+
+void ndAabbPolygonSoup::Deserialize (const char* const path)
+{
+	ndAssert(!m_mappedFile);
+	FILE* const file = fopen(path, "rb");
+	if (file)
+	{
+		size_t readValues = 0; 
+		readValues++;
+		m_strideInBytes = sizeof(ndTriplex);
+		readValues = fread(&m_vertexCount, sizeof(ndInt32), 1, file);
+		if (m_vertexCount == D_COMPRESSED_SOUP_TAG)
+		{
+			DeserializeCompressed(file);
+			fclose(file);
+			return;
+		}
+		readValues = fread(&m_indexCount, sizeof(ndInt32), 1, file);
+		readValues = fread(&m_nodesCount, sizeof(ndInt32), 1, file);
+
+		if (m_vertexCount) 
+		{
+			m_localVertex = (ndFloat32*)ndMemory::Malloc(sizeof(ndTriplex) * m_vertexCount);
+			m_indices = (ndInt32*)ndMemory::Malloc(sizeof(ndInt32) * m_indexCount);
+			m_aabb = (ndNode*)ndMemory::Malloc(sizeof(ndNode) * m_nodesCount);
+
+			readValues = fread(m_localVertex, sizeof(ndTriplex) * m_vertexCount, 1, file);
+			readValues = fread(m_indices, sizeof(ndInt32) * m_indexCount, 1, file);
+			readValues = fread(m_aabb, sizeof(ndNode) * m_nodesCount, 1, file);
+		}
+		else 
+		{
+			m_localVertex = nullptr;
+			m_indices = nullptr;
+			m_aabb = nullptr;
+		}
+
+		fclose(file);
+	}
+}
+
+ndVector ndAabbPolygonSoup::ForAllSectorsSupportVertex (const ndVector& dir) const
+{
+	if (m_compressed)
+	{
+		return ForAllSectorsSupportVertexCompressed(dir);
+	}
+
+	ndVector supportVertex (ndFloat32 (0.0f));
+	if (m_aabb) 
+	{
+		ndFloat32 aabbProjection[DG_STACK_DEPTH];
+		const ndNode *stackPool[DG_STACK_DEPTH];
+
+		ndInt32 stack = 1;
+		stackPool[0] = m_aabb;
+		aabbProjection[0] = ndFloat32 (1.0e10f);
+		const ndTriplex* const boxArray = (ndTriplex*)m_localVertex;
+
+		ndFloat32 maxProj = ndFloat32 (-1.0e20f); 
+		ndInt32 ix = (dir[0] > ndFloat32 (0.0f)) ? 1 : 0;
+		ndInt32 iy = (dir[1] > ndFloat32 (0.0f)) ? 1 : 0;
+		ndInt32 iz = (dir[2] > ndFloat32 (0.0f)) ? 1 : 0;
+
+		while (stack) 
+		{
+			ndFloat32 boxSupportValue;
+
+			stack--;
+			boxSupportValue = aabbProjection[stack];
+			if (boxSupportValue > maxProj) {
+				ndFloat32 backSupportDist = ndFloat32 (0.0f);
+				ndFloat32 frontSupportDist = ndFloat32 (0.0f);
+				const ndNode* const me = stackPool[stack];
+				if (me->m_left.IsLeaf()) 
+				{
+					backSupportDist = ndFloat32 (-1.0e20f);
+					ndInt32 index = ndInt32 (me->m_left.GetIndex());
+					ndInt32 vCount = ndInt32 (me->m_left.GetCount());
+					ndVector vertex (ndFloat32 (0.0f));
+					for (ndInt32 j = 0; j < vCount; ++j) 
+					{
+						ndInt32 i0 = m_indices[index + j] * ndInt32 (sizeof (ndTriplex) / sizeof (ndFloat32));
+						ndVector p (&boxArray[i0].m_x);
+						p = p & ndVector::m_triplexMask;
+						ndFloat32 dist = p.DotProduct(dir).GetScalar();
+						if (dist > backSupportDist) 
+						{
+							backSupportDist = dist;
+							vertex = p;
+						}
+					}
+
+					if (backSupportDist > maxProj) 
+					{
+						maxProj = backSupportDist;
+						supportVertex = vertex; 
+					}
+
+				} 
+				else 
+				{
+					ndVector box[2];
+					const ndNode* const node = me->m_left.GetNode(m_aabb);
+					box[0].m_x = boxArray[node->m_indexBox0].m_x;
+					box[0].m_y = boxArray[node->m_indexBox0].m_y;
+					box[0].m_z = boxArray[node->m_indexBox0].m_z;
+					box[1].m_x = boxArray[node->m_indexBox1].m_x;
+					box[1].m_y = boxArray[node->m_indexBox1].m_y;
+					box[1].m_z = boxArray[node->m_indexBox1].m_z;
+
+					ndVector supportPoint (box[ix].m_x, box[iy].m_y, box[iz].m_z, ndFloat32 (0.0));
+					backSupportDist = supportPoint.DotProduct(dir).GetScalar();
+				}
+
+				if (me->m_right.IsLeaf()) 
+				{
+					frontSupportDist = ndFloat32 (-1.0e20f);
+					ndInt32 index = ndInt32 (me->m_right.GetIndex());
+					ndInt32 vCount = ndInt32 (me->m_right.GetCount());
+					ndVector vertex (ndFloat32 (0.0f));
+					for (ndInt32 j = 0; j < vCount; ++j) 
+					{
+						ndInt32 i0 = m_indices[index + j] * ndInt32 (sizeof (ndTriplex) / sizeof (ndFloat32));
+						ndVector p (&boxArray[i0].m_x);
+						p = p & ndVector::m_triplexMask;
+						ndFloat32 dist = p.DotProduct(dir).GetScalar();
+						if (dist > frontSupportDist) 
+						{
 							frontSupportDist = dist;
 							vertex = p;
 						}
@@ -967,6 +2113,12 @@ ndVector ndAabbPolygonSoup::ForAllSectorsSupportVertex (const ndVector& dir) con
 
 void ndAabbPolygonSoup::ForAllSectorsRayHit (const ndFastRay& raySrc, ndFloat32 maxParam, ndRayIntersectCallback callback, void* const context) const
 {
+	if (m_compressed)
+	{
+		ForAllSectorsRayHitCompressed(raySrc, maxParam, callback, context);
+		return;
+	}
+
 	const ndNode *stackPool[DG_STACK_DEPTH];
 	ndFloat32 distance[DG_STACK_DEPTH];
 	ndFastRay ray (raySrc);
@@ -1075,7 +2227,11 @@ void ndAabbPolygonSoup::ForAllSectors (const ndFastAabb& obbAabbInfo, const ndVe
 	ndAssert (ndAbs(ndAbs(obbAabbInfo[0][2]) - obbAabbInfo.m_absDir[2][0]) < ndFloat32 (1.0e-4f));
 	ndAssert (ndAbs(ndAbs(obbAabbInfo[1][2]) - obbAabbInfo.m_absDir[2][1]) < ndFloat32 (1.0e-4f));
 
-	if (m_aabb) 
+	if (m_compressed)
+	{
+		ForAllSectorsCompressed(obbAabbInfo, boxDistanceTravel, callback, context);
+	}
+	else if (m_aabb) 
 	{
 		ndFloat32 distance[DG_STACK_DEPTH];
 		const ndNode* stackPool[DG_STACK_DEPTH];
@@ -1309,6 +2465,8 @@ void ndAabbPolygonSoup::ForThisSector(const ndAabbPolygonSoup::ndNode* const nod
 	ndAssert(ndAbs(ndAbs(obbAabbInfo[0][2]) - obbAabbInfo.m_absDir[2][0]) < ndFloat32(1.0e-4f));
 	ndAssert(ndAbs(ndAbs(obbAabbInfo[1][2]) - obbAabbInfo.m_absDir[2][1]) < ndFloat32(1.0e-4f));
 
+	// node level queries are not supported by the compressed layout
+	ndAssert(!m_compressed);
 	if (m_aabb)
 	{
 		const ndInt32 stride = sizeof(ndTriplex) / sizeof(ndFloat32);
@@ -1464,3 +2622,866 @@ void ndAabbPolygonSoup::ForThisSector(const ndAabbPolygonSoup::ndNode* const nod
 		}
 	}
 }
+
+ndInt64 ndAabbPolygonSoup::GetMemoryUsed() const
+{
+	if (m_compressed)
+	{
+		return m_compressed->GetMemoryUsed();
+	}
+
+	ndInt64 size = 0;
+	if (m_aabb)
+	{
+		size += ndInt64(sizeof(ndNode)) * m_nodesCount;
+		size += ndInt64(sizeof(ndInt32)) * m_indexCount;
+		size += ndInt64(sizeof(ndTriplex)) * m_vertexCount;
+	}
+	return size;
+}
+
+bool ndAabbPolygonSoup::Compress()
+{
+	if (!m_aabb || m_compressed)
+	{
+		return false;
+	}
+
+	// enumerate points and normals in the order the faces are stored in the tree,
+	// so that neighbor faces reference close indices, and the vertex clusters are compact.
+	ndArray<ndInt32> vertexMap;
+	ndArray<ndInt32> normalMap;
+	ndArray<ndInt32> vertexList;
+	ndArray<ndInt32> normalList;
+	vertexMap.SetCount(m_vertexCount);
+	normalMap.SetCount(m_vertexCount);
+	for (ndInt32 i = 0; i < m_vertexCount; ++i)
+	{
+		vertexMap[i] = -1;
+		normalMap[i] = -1;
+	}
+
+	for (ndInt32 i = 0; i < m_nodesCount; ++i)
+	{
+		const ndNode* const node = &m_aabb[i];
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndNode::ndLeafNodePtr& child = j ? node->m_right : node->m_left;
+			if (child.IsLeaf() && child.GetCount())
+			{
+				const ndInt32 vCount = ndInt32(child.GetCount());
+				const ndInt32* const face = &m_indices[child.GetIndex()];
+				for (ndInt32 k = 0; k < vCount; ++k)
+				{
+					const ndInt32 index = face[k];
+					if (vertexMap[index] < 0)
+					{
+						vertexMap[index] = vertexList.GetCount();
+						vertexList.PushBack(index);
+					}
+				}
+				for (ndInt32 k = 0; k <= vCount; ++k)
+				{
+					const ndInt32 edge = face[vCount + 1 + k];
+					if (edge != -1)
+					{
+						const ndInt32 index = edge & (~D_CONCAVE_EDGE_MASK);
+						if (normalMap[index] < 0)
+						{
+							normalMap[index] = normalList.GetCount();
+							normalList.PushBack(index);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// pack the faces
+	ndArray<ndUnsigned8> faceStream;
+	ndCompressedData* const data = new ndCompressedData;
+	for (ndInt32 i = 0; i < m_nodesCount; ++i)
+	{
+		const ndNode* const node = &m_aabb[i];
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndNode::ndLeafNodePtr& child = j ? node->m_right : node->m_left;
+			if (child.IsLeaf() && child.GetCount())
+			{
+				if (faceStream.GetCount() >= D_COMPRESSED_MAX_FACE_BYTES)
+				{
+					// face stream can't be addressed by the leaf nodes
+					delete data;
+					return false;
+				}
+				data->EncodeFace(faceStream, &m_indices[child.GetIndex()], ndInt32(child.GetCount()), vertexMap, normalMap);
+			}
+		}
+	}
+
+	data->m_nodesCount = m_nodesCount;
+	data->m_vertexCount = vertexList.GetCount();
+	data->m_normalCount = normalList.GetCount();
+	data->m_faceBytes = faceStream.GetCount();
+	data->Allocate();
+	if (faceStream.GetCount())
+	{
+		ndMemCpy(data->m_faces, &faceStream[0], faceStream.GetCount());
+	}
+
+	// quantize the points relative to the cluster box
+	const ndTriplex* const vertexArray = (ndTriplex*)m_localVertex;
+	const ndInt32 clusterCount = data->GetClusterCount();
+	for (ndInt32 i = 0; i < clusterCount; ++i)
+	{
+		const ndInt32 start = i * D_COMPRESSED_CLUSTER_SIZE;
+		const ndInt32 count = ndMin(data->m_vertexCount - start, D_COMPRESSED_CLUSTER_SIZE);
+
+		ndVector minP(ndFloat32(1.0e15f));
+		ndVector maxP(ndFloat32(-1.0e15f));
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			const ndTriplex& p = vertexArray[vertexList[start + j]];
+			const ndVector q(p.m_x, p.m_y, p.m_z, ndFloat32(0.0f));
+			minP = minP.GetMin(q);
+			maxP = maxP.GetMax(q);
+		}
+		const ndVector scale((maxP - minP) * ndVector(ndFloat32(1.0f) / D_COMPRESSED_BOX_QUANTIZE));
+
+		ndCompressedData::ndVertexCluster& cluster = data->m_clusters[i];
+		cluster.m_origin.m_x = minP.m_x;
+		cluster.m_origin.m_y = minP.m_y;
+		cluster.m_origin.m_z = minP.m_z;
+		cluster.m_scale.m_x = scale.m_x;
+		cluster.m_scale.m_y = scale.m_y;
+		cluster.m_scale.m_z = scale.m_z;
+
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			const ndTriplex& p = vertexArray[vertexList[start + j]];
+			const ndVector q(p.m_x, p.m_y, p.m_z, ndFloat32(0.0f));
+			ndUnsigned16* const dst = &data->m_vertex[(start + j) * 3];
+			for (ndInt32 k = 0; k < 3; ++k)
+			{
+				ndInt32 value = 0;
+				if (scale[k] > ndFloat32(0.0f))
+				{
+					value = ndClamp(ndInt32(ndFloor((q[k] - minP[k]) / scale[k] + ndFloat32(0.5f))), 0, 0xffff);
+				}
+				dst[k] = ndUnsigned16(value);
+			}
+		}
+	}
+
+	for (ndInt32 i = 0; i < data->m_normalCount; ++i)
+	{
+		const ndTriplex& n = vertexArray[normalList[i]];
+		ndInt16* const dst = &data->m_normals[i * 3];
+		dst[0] = ndInt16(ndClamp(ndInt32(ndFloor(n.m_x * D_COMPRESSED_NORMAL_SCALE + ndFloat32(0.5f))), -0x7fff, 0x7fff));
+		dst[1] = ndInt16(ndClamp(ndInt32(ndFloor(n.m_y * D_COMPRESSED_NORMAL_SCALE + ndFloat32(0.5f))), -0x7fff, 0x7fff));
+		dst[2] = ndInt16(ndClamp(ndInt32(ndFloor(n.m_z * D_COMPRESSED_NORMAL_SCALE + ndFloat32(0.5f))), -0x7fff, 0x7fff));
+	}
+
+	// rebuild the node boxes from the decoded faces, children are always stored after the parent.
+	ndVector faceVertex[D_COMPRESSED_FACE_BUFFER];
+	ndInt32 faceIndices[D_COMPRESSED_FACE_BUFFER];
+	ndArray<ndVector> boxP0;
+	ndArray<ndVector> boxP1;
+	boxP0.SetCount(m_nodesCount);
+	boxP1.SetCount(m_nodesCount);
+
+	ndUnsigned32 faceOffset = 0;
+	ndArray<ndUnsigned32> leafOffset;
+	leafOffset.SetCount(m_nodesCount * 2);
+	for (ndInt32 i = 0; i < m_nodesCount; ++i)
+	{
+		const ndNode* const node = &m_aabb[i];
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndNode::ndLeafNodePtr& child = j ? node->m_right : node->m_left;
+			leafOffset[i * 2 + j] = faceOffset;
+			if (child.IsLeaf() && child.GetCount())
+			{
+				const ndInt32 vCount = ndInt32(child.GetCount());
+				const ndUnsigned8* ptr = &data->m_faces[faceOffset];
+				// skip the face to find the next one
+				for (ndInt32 k = 0; k < vCount * 2 + 3; ++k)
+				{
+					ndCompressedData::ReadVarint(ptr);
+				}
+				faceOffset = ndUnsigned32(ptr - data->m_faces);
+			}
+		}
+	}
+	ndAssert(ndInt32(faceOffset) == data->m_faceBytes);
+
+	const ndVector padding(ndVector(ndFloat32(1.0e-3f)) & ndVector::m_triplexMask);
+	for (ndInt32 i = m_nodesCount - 1; i >= 0; --i)
+	{
+		const ndNode* const node = &m_aabb[i];
+		ndCompressedNode& compressedNode = data->m_nodes[i];
+		ndVector minP(ndFloat32(1.0e15f));
+		ndVector maxP(ndFloat32(-1.0e15f));
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndNode::ndLeafNodePtr& child = j ? node->m_right : node->m_left;
+			ndNode::ndLeafNodePtr& compressedChild = j ? compressedNode.m_right : compressedNode.m_left;
+			if (child.IsLeaf())
+			{
+				const ndInt32 vCount = ndInt32(child.GetCount());
+				compressedChild = ndNode::ndLeafNodePtr(ndUnsigned32(vCount), vCount ? leafOffset[i * 2 + j] : 0);
+				if (vCount)
+				{
+					data->DecodeFace(leafOffset[i * 2 + j], vCount, faceVertex, faceIndices);
+					for (ndInt32 k = 0; k < vCount; ++k)
+					{
+						minP = minP.GetMin(faceVertex[k] - padding);
+						maxP = maxP.GetMax(faceVertex[k] + padding);
+					}
+				}
+			}
+			else
+			{
+				compressedChild = child;
+				minP = minP.GetMin(boxP0[ndInt32(child.m_node)]);
+				maxP = maxP.GetMax(boxP1[ndInt32(child.m_node)]);
+			}
+		}
+		boxP0[i] = minP & ndVector::m_triplexMask;
+		boxP1[i] = maxP & ndVector::m_triplexMask;
+	}
+
+	// quantize the boxes top down, relative to the decoded parent box
+	data->m_rootBox[0].m_x = boxP0[0].m_x;
+	data->m_rootBox[0].m_y = boxP0[0].m_y;
+	data->m_rootBox[0].m_z = boxP0[0].m_z;
+	data->m_rootBox[1].m_x = boxP1[0].m_x;
+	data->m_rootBox[1].m_y = boxP1[0].m_y;
+	data->m_rootBox[1].m_z = boxP1[0].m_z;
+	memset(data->m_nodes[0].m_box, 0, sizeof(data->m_nodes[0].m_box));
+	boxP0[0] = data->GetRootP0();
+	boxP1[0] = data->GetRootP1();
+	for (ndInt32 i = 0; i < m_nodesCount; ++i)
+	{
+		const ndCompressedNode& node = data->m_nodes[i];
+		const ndVector parentP0(boxP0[i]);
+		const ndVector parentP1(boxP1[i]);
+		const ndVector scale(ndCompressedData::GetBoxScale(parentP0, parentP1));
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndNode::ndLeafNodePtr& child = j ? node.m_right : node.m_left;
+			if (!child.IsLeaf())
+			{
+				const ndInt32 index = ndInt32(child.m_node);
+				ndAssert(index > i);
+				ndCompressedNode& childNode = data->m_nodes[index];
+				data->QuantizeBox(parentP0, parentP1, boxP0[index], boxP1[index], childNode);
+				childNode.GetBox(parentP0, parentP1, scale, boxP0[index], boxP1[index]);
+			}
+		}
+	}
+
+	if (m_mappedFile)
+	{
+		// the source arrays were in the mapped file
+		delete m_mappedFile;
+		m_mappedFile = nullptr;
+	}
+	else
+	{
+		ndMemory::Free(m_aabb);
+		ndMemory::Free(m_indices);
+		ndMemory::Free(m_localVertex);
+	}
+	m_aabb = nullptr;
+	m_indices = nullptr;
+	m_localVertex = nullptr;
+	m_strideInBytes = sizeof(ndVector);
+	m_compressed = data;
+	return true;
+}
+
+void ndAabbPolygonSoup::SerializeCompressed(FILE* const file) const
+{
+	ndAssert(m_compressed);
+	const ndInt32 tag = D_COMPRESSED_SOUP_TAG;
+	fwrite(&tag, sizeof(ndInt32), 1, file);
+	fwrite(&m_vertexCount, sizeof(ndInt32), 1, file);
+	fwrite(&m_indexCount, sizeof(ndInt32), 1, file);
+	fwrite(&m_nodesCount, sizeof(ndInt32), 1, file);
+	fwrite(&m_compressed->m_vertexCount, sizeof(ndInt32), 1, file);
+	fwrite(&m_compressed->m_normalCount, sizeof(ndInt32), 1, file);
+	fwrite(&m_compressed->m_faceBytes, sizeof(ndInt32), 1, file);
+	fwrite(m_compressed->m_rootBox, sizeof(m_compressed->m_rootBox), 1, file);
+	fwrite(m_compressed->m_nodes, sizeof(ndCompressedNode) * size_t(m_nodesCount), 1, file);
+	fwrite(m_compressed->m_clusters, sizeof(ndCompressedData::ndVertexCluster) * size_t(m_compressed->GetClusterCount()), 1, file);
+	fwrite(m_compressed->m_vertex, sizeof(ndUnsigned16) * 3 * size_t(m_compressed->m_vertexCount), 1, file);
+	fwrite(m_compressed->m_normals, sizeof(ndInt16) * 3 * size_t(m_compressed->m_normalCount), 1, file);
+	fwrite(m_compressed->m_faces, size_t(m_compressed->m_faceBytes), 1, file);
+}
+
+void ndAabbPolygonSoup::DeserializeCompressed(FILE* const file)
+{
+	size_t readValues = 0;
+	readValues++;
+	ndCompressedData* const data = new ndCompressedData;
+	readValues = fread(&m_vertexCount, sizeof(ndInt32), 1, file);
+	readValues = fread(&m_indexCount, sizeof(ndInt32), 1, file);
+	readValues = fread(&m_nodesCount, sizeof(ndInt32), 1, file);
+	readValues = fread(&data->m_vertexCount, sizeof(ndInt32), 1, file);
+	readValues = fread(&data->m_normalCount, sizeof(ndInt32), 1, file);
+	readValues = fread(&data->m_faceBytes, sizeof(ndInt32), 1, file);
+	readValues = fread(data->m_rootBox, sizeof(data->m_rootBox), 1, file);
+
+	data->m_nodesCount = m_nodesCount;
+	data->Allocate();
+	readValues = fread(data->m_nodes, sizeof(ndCompressedNode) * size_t(m_nodesCount), 1, file);
+	readValues = fread(data->m_clusters, sizeof(ndCompressedData::ndVertexCluster) * size_t(data->GetClusterCount()), 1, file);
+	readValues = fread(data->m_vertex, sizeof(ndUnsigned16) * 3 * size_t(data->m_vertexCount), 1, file);
+	readValues = fread(data->m_normals, sizeof(ndInt16) * 3 * size_t(data->m_normalCount), 1, file);
+	readValues = fread(data->m_faces, size_t(data->m_faceBytes), 1, file);
+
+	m_strideInBytes = sizeof(ndVector);
+	m_localVertex = nullptr;
+	m_indices = nullptr;
+	m_aabb = nullptr;
+	m_compressed = data;
+}
+
+#define D_SOUP_CACHE_MAGIC		0x48434256
+#define D_SOUP_CACHE_VERSION	1
+#define D_SOUP_CACHE_BYTE_ORDER	0x01020304
+#define D_SOUP_CACHE_ALIGNMENT	64
+#define D_SOUP_CACHE_SECTIONS	5
+
+// plain layout sections:		vertex, indices, nodes
+// compressed layout sections:	nodes, vertex clusters, vertex, normals, faces
+class ndPolygonSoupCacheHeader
+{
+	public:
+	ndPolygonSoupCacheHeader()
+	{
+		// clear the padding too, the header is part of the hash
+		memset(this, 0, sizeof(ndPolygonSoupCacheHeader));
+	}
+
+	void GetSectionSizes(ndUnsigned64* const sizes) const
+	{
+		memset(sizes, 0, sizeof(ndUnsigned64) * D_SOUP_CACHE_SECTIONS);
+		if (m_compressed)
+		{
+			const ndInt32 clusterCount = (m_compressedVertexCount + D_COMPRESSED_CLUSTER_SIZE - 1) >> D_COMPRESSED_CLUSTER_SIZE_BITS;
+			sizes[0] = ndUnsigned64(sizeof(ndAabbPolygonSoup::ndCompressedNode)) * ndUnsigned64(m_nodesCount);
+			sizes[1] = ndUnsigned64(sizeof(ndTriplex) * 2) * ndUnsigned64(clusterCount);
+			sizes[2] = ndUnsigned64(sizeof(ndUnsigned16) * 3) * ndUnsigned64(m_compressedVertexCount);
+			sizes[3] = ndUnsigned64(sizeof(ndInt16) * 3) * ndUnsigned64(m_normalCount);
+			sizes[4] = ndUnsigned64(m_faceBytes);
+		}
+		else
+		{
+			sizes[0] = ndUnsigned64(sizeof(ndTriplex)) * ndUnsigned64(m_vertexCount);
+			sizes[1] = ndUnsigned64(sizeof(ndInt32)) * ndUnsigned64(m_indexCount);
+			sizes[2] = ndUnsigned64(sizeof(ndAabbPolygonSoup::ndNode)) * ndUnsigned64(m_nodesCount);
+		}
+	}
+
+	void Layout()
+	{
+		ndUnsigned64 sizes[D_SOUP_CACHE_SECTIONS];
+		GetSectionSizes(sizes);
+		ndUnsigned64 offset = sizeof(ndPolygonSoupCacheHeader);
+		for (ndInt32 i = 0; i < D_SOUP_CACHE_SECTIONS; ++i)
+		{
+			offset = (offset + D_SOUP_CACHE_ALIGNMENT - 1) & ~ndUnsigned64(D_SOUP_CACHE_ALIGNMENT - 1);
+			m_sectionOffset[i] = offset;
+			offset += sizes[i];
+		}
+		m_fileSize = offset;
+	}
+
+	bool IsValid(size_t fileSize) const
+	{
+		const ndUnsigned32 nodeSize = ndUnsigned32(m_compressed ? sizeof(ndAabbPolygonSoup::ndCompressedNode) : sizeof(ndAabbPolygonSoup::ndNode));
+		if ((m_magic != D_SOUP_CACHE_MAGIC) || (m_version != D_SOUP_CACHE_VERSION) || (m_byteOrder != D_SOUP_CACHE_BYTE_ORDER) ||
+			(m_floatSize != sizeof(ndFloat32)) || (m_nodeSize != nodeSize) || (m_fileSize != fileSize))
+		{
+			return false;
+		}
+		if ((m_vertexCount < 0) || (m_indexCount < 0) || (m_nodesCount <= 0) || (m_compressedVertexCount < 0) || (m_normalCount < 0) || (m_faceBytes < 0))
+		{
+			return false;
+		}
+
+		ndUnsigned64 sizes[D_SOUP_CACHE_SECTIONS];
+		GetSectionSizes(sizes);
+		for (ndInt32 i = 0; i < D_SOUP_CACHE_SECTIONS; ++i)
+		{
+			if ((m_sectionOffset[i] & (D_SOUP_CACHE_ALIGNMENT - 1)) || (m_sectionOffset[i] < sizeof(ndPolygonSoupCacheHeader)) ||
+				(m_sectionOffset[i] > m_fileSize) || (sizes[i] > (m_fileSize - m_sectionOffset[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// ndCRC64 only depends on the last few bytes of the buffer,
+	// the content hash mixes eight bytes at a time over the entire section.
+	static ndUnsigned64 HashBuffer(const void* const buffer, ndUnsigned64 size, ndUnsigned64 hash)
+	{
+		const ndUnsigned8* const data = (ndUnsigned8*)buffer;
+		for (ndUnsigned64 i = 0; i < size; i += sizeof(ndUnsigned64))
+		{
+			ndUnsigned64 word = 0;
+			memcpy(&word, &data[i], size_t(ndMin(size - i, ndUnsigned64(sizeof(ndUnsigned64)))));
+			hash ^= word * 0x9e3779b97f4a7c15ULL;
+			hash = ((hash << 31) | (hash >> 33)) * 0xbf58476d1ce4e5b9ULL;
+		}
+		hash ^= size;
+		hash ^= hash >> 29;
+		hash *= 0x94d049bb133111ebULL;
+		return hash ^ (hash >> 32);
+	}
+
+	ndUnsigned64 CalculateHash(const void* const* const sections) const
+	{
+		ndPolygonSoupCacheHeader header;
+		memcpy(&header, this, sizeof(ndPolygonSoupCacheHeader));
+		header.m_hash = 0;
+		ndUnsigned64 hash = HashBuffer(&header, sizeof(ndPolygonSoupCacheHeader), 0);
+
+		ndUnsigned64 sizes[D_SOUP_CACHE_SECTIONS];
+		GetSectionSizes(sizes);
+		for (ndInt32 i = 0; i < D_SOUP_CACHE_SECTIONS; ++i)
+		{
+			hash = HashBuffer(sections[i], sizes[i], hash);
+		}
+		return hash;
+	}
+
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndUnsigned32 m_byteOrder;
+	ndUnsigned32 m_floatSize;
+	ndUnsigned32 m_nodeSize;
+	ndUnsigned32 m_compressed;
+	ndInt32 m_vertexCount;
+	ndInt32 m_indexCount;
+	ndInt32 m_nodesCount;
+	ndInt32 m_compressedVertexCount;
+	ndInt32 m_normalCount;
+	ndInt32 m_faceBytes;
+	ndTriplex m_rootBox[2];
+	ndUnsigned64 m_fileSize;
+	ndUnsigned64 m_hash;
+	ndUnsigned64 m_sectionOffset[D_SOUP_CACHE_SECTIONS];
+};
+
+bool ndAabbPolygonSoup::SaveCache(const char* const path) const
+{
+	if (!m_aabb && !m_compressed)
+	{
+		return false;
+	}
+
+	ndVector p0;
+	ndVector p1;
+	GetAABB(p0, p1);
+
+	ndPolygonSoupCacheHeader header;
+	header.m_magic = D_SOUP_CACHE_MAGIC;
+	header.m_version = D_SOUP_CACHE_VERSION;
+	header.m_byteOrder = D_SOUP_CACHE_BYTE_ORDER;
+	header.m_floatSize = sizeof(ndFloat32);
+	header.m_nodeSize = ndUnsigned32(m_compressed ? sizeof(ndCompressedNode) : sizeof(ndNode));
+	header.m_compressed = m_compressed ? 1 : 0;
+	header.m_vertexCount = m_vertexCount;
+	header.m_indexCount = m_indexCount;
+	header.m_nodesCount = m_nodesCount;
+	header.m_rootBox[0].m_x = p0.m_x;
+	header.m_rootBox[0].m_y = p0.m_y;
+	header.m_rootBox[0].m_z = p0.m_z;
+	header.m_rootBox[1].m_x = p1.m_x;
+	header.m_rootBox[1].m_y = p1.m_y;
+	header.m_rootBox[1].m_z = p1.m_z;
+
+	const void* sections[D_SOUP_CACHE_SECTIONS];
+	memset(sections, 0, sizeof(sections));
+	if (m_compressed)
+	{
+		header.m_compressedVertexCount = m_compressed->m_vertexCount;
+		header.m_normalCount = m_compressed->m_normalCount;
+		header.m_faceBytes = m_compressed->m_faceBytes;
+		sections[0] = m_compressed->m_nodes;
+		sections[1] = m_compressed->m_clusters;
+		sections[2] = m_compressed->m_vertex;
+		sections[3] = m_compressed->m_normals;
+		sections[4] = m_compressed->m_faces;
+	}
+	else
+	{
+		sections[0] = m_localVertex;
+		sections[1] = m_indices;
+		sections[2] = m_aabb;
+	}
+	header.Layout();
+	header.m_hash = header.CalculateHash(sections);
+
+	FILE* const file = fopen(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ndUnsigned64 offset = sizeof(header);
+	ndUnsigned64 sizes[D_SOUP_CACHE_SECTIONS];
+	header.GetSectionSizes(sizes);
+	const ndUnsigned8 padding[D_SOUP_CACHE_ALIGNMENT] = {};
+	for (ndInt32 i = 0; ok && (i < D_SOUP_CACHE_SECTIONS); ++i)
+	{
+		const size_t paddingSize = size_t(header.m_sectionOffset[i] - offset);
+		ok = ok && (!paddingSize || (fwrite(padding, paddingSize, 1, file) == 1));
+		ok = ok && (!sizes[i] || (fwrite(sections[i], size_t(sizes[i]), 1, file) == 1));
+		offset = header.m_sectionOffset[i] + sizes[i];
+	}
+	fclose(file);
+	return ok;
+}
+
+ndAabbPolygonSoup::ndCacheStatus ndAabbPolygonSoup::LoadCache(const char* const path, bool verify)
+{
+	ndAssert(!m_aabb && !m_compressed && !m_mappedFile);
+	if (m_aabb || m_compressed || m_mappedFile)
+	{
+		return m_cacheCorrupted;
+	}
+
+	ndMemoryMappedFile* const file = new ndMemoryMappedFile;
+	if (!file->Open(path))
+	{
+		delete file;
+		return m_cacheNotACacheFile;
+	}
+
+	// anything that does not start with the signature is not a cache,
+	// it could be a file written by Serialize
+	ndUnsigned32 magic = 0;
+	ndUnsigned8* const base = (ndUnsigned8*)file->GetData();
+	if (file->GetSize() >= sizeof(magic))
+	{
+		memcpy(&magic, base, sizeof(magic));
+	}
+	if (magic != D_SOUP_CACHE_MAGIC)
+	{
+		delete file;
+		return m_cacheNotACacheFile;
+	}
+
+	ndPolygonSoupCacheHeader header;
+	if (file->GetSize() < sizeof(ndPolygonSoupCacheHeader))
+	{
+		delete file;
+		return m_cacheCorrupted;
+	}
+	memcpy(&header, base, sizeof(header));
+	if (!header.IsValid(file->GetSize()))
+	{
+		delete file;
+		return m_cacheCorrupted;
+	}
+
+	void* sections[D_SOUP_CACHE_SECTIONS];
+	for (ndInt32 i = 0; i < D_SOUP_CACHE_SECTIONS; ++i)
+	{
+		sections[i] = &base[header.m_sectionOffset[i]];
+	}
+	if (verify && (header.CalculateHash(sections) != header.m_hash))
+	{
+		delete file;
+		return m_cacheCorrupted;
+	}
+
+	m_vertexCount = header.m_vertexCount;
+	m_indexCount = header.m_indexCount;
+	m_nodesCount = header.m_nodesCount;
+	if (header.m_compressed)
+	{
+		ndCompressedData* const data = new ndCompressedData;
+		data->m_rootBox[0] = header.m_rootBox[0];
+		data->m_rootBox[1] = header.m_rootBox[1];
+		data->m_nodesCount = header.m_nodesCount;
+		data->m_vertexCount = header.m_compressedVertexCount;
+		data->m_normalCount = header.m_normalCount;
+		data->m_faceBytes = header.m_faceBytes;
+		data->m_nodes = (ndCompressedNode*)sections[0];
+		data->m_clusters = (ndCompressedData::ndVertexCluster*)sections[1];
+		data->m_vertex = (ndUnsigned16*)sections[2];
+		data->m_normals = (ndInt16*)sections[3];
+		data->m_faces = (ndUnsigned8*)sections[4];
+		m_strideInBytes = sizeof(ndVector);
+		m_compressed = data;
+	}
+	else
+	{
+		m_localVertex = (ndFloat32*)sections[0];
+		m_indices = (ndInt32*)sections[1];
+		m_aabb = (ndNode*)sections[2];
+		m_strideInBytes = sizeof(ndTriplex);
+	}
+	m_mappedFile = file;
+	return m_cacheLoaded;
+}
+
+ndVector ndAabbPolygonSoup::ForAllSectorsSupportVertexCompressed(const ndVector& dir) const
+{
+	ndCompressedData::ndStackEntry stackPool[DG_STACK_DEPTH];
+	ndVector faceVertex[D_COMPRESSED_FACE_BUFFER];
+	ndInt32 faceIndices[D_COMPRESSED_FACE_BUFFER];
+
+	const ndCompressedData* const data = m_compressed;
+	const ndInt32 ix = (dir[0] > ndFloat32(0.0f)) ? 1 : 0;
+	const ndInt32 iy = (dir[1] > ndFloat32(0.0f)) ? 1 : 0;
+	const ndInt32 iz = (dir[2] > ndFloat32(0.0f)) ? 1 : 0;
+
+	ndInt32 stack = 1;
+	stackPool[0].m_p0 = data->GetRootP0();
+	stackPool[0].m_p1 = data->GetRootP1();
+	stackPool[0].m_node = &data->m_nodes[0];
+	stackPool[0].m_dist = ndFloat32(1.0e10f);
+
+	ndFloat32 maxProj = ndFloat32(-1.0e20f);
+	ndVector supportVertex(ndFloat32(0.0f));
+	while (stack)
+	{
+		stack--;
+		const ndCompressedData::ndStackEntry entry(stackPool[stack]);
+		if (entry.m_dist > maxProj)
+		{
+			const ndCompressedNode* const me = entry.m_node;
+			const ndVector scale(ndCompressedData::GetBoxScale(entry.m_p0, entry.m_p1));
+			for (ndInt32 i = 0; i < 2; ++i)
+			{
+				const ndNode::ndLeafNodePtr& child = i ? me->m_right : me->m_left;
+				if (child.IsLeaf())
+				{
+					const ndInt32 vCount = ndInt32(child.GetCount());
+					if (vCount)
+					{
+						data->DecodeFace(child.GetIndex(), vCount, faceVertex, faceIndices);
+						for (ndInt32 j = 0; j < vCount; ++j)
+						{
+							const ndFloat32 dist = faceVertex[j].DotProduct(dir).GetScalar();
+							if (dist > maxProj)
+							{
+								maxProj = dist;
+								supportVertex = faceVertex[j];
+							}
+						}
+					}
+				}
+				else
+				{
+					ndVector box[2];
+					const ndCompressedNode* const node = &data->m_nodes[child.m_node];
+					node->GetBox(entry.m_p0, entry.m_p1, scale, box[0], box[1]);
+					const ndVector supportPoint(box[ix].m_x, box[iy].m_y, box[iz].m_z, ndFloat32(0.0f));
+					const ndFloat32 dist = supportPoint.DotProduct(dir).GetScalar();
+					if (dist > maxProj)
+					{
+						ndCompressedData::PushStackEntry(stackPool, stack, node, box[0], box[1], dist);
+					}
+				}
+			}
+		}
+	}
+	return supportVertex;
+}
+
+void ndAabbPolygonSoup::ForAllSectorsRayHitCompressed(const ndFastRay& raySrc, ndFloat32 maxParam, ndRayIntersectCallback callback, void* const context) const
+{
+	ndCompressedData::ndStackEntry stackPool[DG_STACK_DEPTH];
+	ndVector faceVertex[D_COMPRESSED_FACE_BUFFER];
+	ndInt32 faceIndices[D_COMPRESSED_FACE_BUFFER];
+
+	ndFastRay ray(raySrc);
+	const ndCompressedData* const data = m_compressed;
+
+	ndInt32 stack = 1;
+	stackPool[0].m_p0 = data->GetRootP0();
+	stackPool[0].m_p1 = data->GetRootP1();
+	stackPool[0].m_node = &data->m_nodes[0];
+	stackPool[0].m_dist = ray.BoxIntersect(stackPool[0].m_p0, stackPool[0].m_p1);
+	while (stack)
+	{
+		stack--;
+		const ndCompressedData::ndStackEntry entry(stackPool[stack]);
+		if (entry.m_dist > maxParam)
+		{
+			break;
+		}
+
+		const ndCompressedNode* const me = entry.m_node;
+		const ndVector scale(ndCompressedData::GetBoxScale(entry.m_p0, entry.m_p1));
+		for (ndInt32 i = 0; i < 2; ++i)
+		{
+			const ndNode::ndLeafNodePtr& child = i ? me->m_right : me->m_left;
+			if (child.IsLeaf())
+			{
+				const ndInt32 vCount = ndInt32(child.GetCount());
+				if (vCount > 0)
+				{
+					data->DecodeFace(child.GetIndex(), vCount, faceVertex, faceIndices);
+					ndFloat32 param = callback(context, &faceVertex[0].m_x, sizeof(ndVector), faceIndices, vCount);
+					ndAssert(param >= ndFloat32(0.0f));
+					if (param < maxParam)
+					{
+						maxParam = param;
+						if (maxParam == ndFloat32(0.0f))
+						{
+							return;
+						}
+					}
+				}
+			}
+			else
+			{
+				ndVector p0;
+				ndVector p1;
+				const ndCompressedNode* const node = &data->m_nodes[child.m_node];
+				node->GetBox(entry.m_p0, entry.m_p1, scale, p0, p1);
+				ndFloat32 dist1 = ray.BoxIntersect(p0, p1);
+				if (dist1 < maxParam)
+				{
+					ndCompressedData::PushStackEntry(stackPool, stack, node, p0, p1, dist1);
+				}
+			}
+		}
+	}
+}
+
+void ndAabbPolygonSoup::ForAllSectorsCompressed(const ndFastAabb& obbAabbInfo, const ndVector& boxDistanceTravel, ndAaabbIntersectCallback callback, void* const context) const
+{
+	ndCompressedData::ndStackEntry stackPool[DG_STACK_DEPTH];
+	ndVector faceVertex[D_COMPRESSED_FACE_BUFFER];
+	ndInt32 faceIndices[D_COMPRESSED_FACE_BUFFER];
+
+	const ndInt32 stride = sizeof(ndVector) / sizeof(ndFloat32);
+	const ndCompressedData* const data = m_compressed;
+
+	ndInt32 stack = 1;
+	stackPool[0].m_p0 = data->GetRootP0();
+	stackPool[0].m_p1 = data->GetRootP1();
+	stackPool[0].m_node = &data->m_nodes[0];
+
+	ndAssert(boxDistanceTravel.m_w == ndFloat32(0.0f));
+	if (boxDistanceTravel.DotProduct(boxDistanceTravel).GetScalar() < ndFloat32(1.0e-8f))
+	{
+		stackPool[0].m_dist = ndNode::BoxPenetration(obbAabbInfo, stackPool[0].m_p0, stackPool[0].m_p1);
+		if (stackPool[0].m_dist <= ndFloat32(0.0f))
+		{
+			obbAabbInfo.m_separationDistance = ndMin(obbAabbInfo.m_separationDistance[0], -stackPool[0].m_dist);
+		}
+		while (stack)
+		{
+			stack--;
+			const ndCompressedData::ndStackEntry entry(stackPool[stack]);
+			if (entry.m_dist > ndFloat32(0.0f))
+			{
+				const ndCompressedNode* const me = entry.m_node;
+				const ndVector scale(ndCompressedData::GetBoxScale(entry.m_p0, entry.m_p1));
+				for (ndInt32 i = 0; i < 2; ++i)
+				{
+					const ndNode::ndLeafNodePtr& child = i ? me->m_right : me->m_left;
+					if (child.IsLeaf())
+					{
+						const ndInt32 vCount = ndInt32(child.GetCount());
+						if (vCount > 0)
+						{
+							data->DecodeFace(child.GetIndex(), vCount, faceVertex, faceIndices);
+							const ndFloat32 dist1 = obbAabbInfo.PolygonBoxDistance(faceVertex[vCount], vCount, faceIndices, stride, &faceVertex[0].m_x);
+							if (dist1 > ndFloat32(0.0f))
+							{
+								obbAabbInfo.m_separationDistance = ndFloat32(0.0f);
+								ndAssert(vCount >= 3);
+								if (callback(context, &faceVertex[0].m_x, sizeof(ndVector), faceIndices, vCount, dist1) == m_stopSearch)
+								{
+									return;
+								}
+							}
+							else
+							{
+								obbAabbInfo.m_separationDistance = ndMin(obbAabbInfo.m_separationDistance[0], -dist1);
+							}
+						}
+					}
+					else
+					{
+						ndVector p0;
+						ndVector p1;
+						const ndCompressedNode* const node = &data->m_nodes[child.m_node];
+						node->GetBox(entry.m_p0, entry.m_p1, scale, p0, p1);
+						const ndFloat32 dist1 = ndNode::BoxPenetration(obbAabbInfo, p0, p1);
+						if (dist1 > ndFloat32(0.0f))
+						{
+							ndCompressedData::PushStackEntry(stackPool, stack, node, p0, p1, dist1);
+						}
+						else
+						{
+							obbAabbInfo.m_separationDistance = ndMin(obbAabbInfo.m_separationDistance[0], -dist1);
+						}
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		ndFastRay ray(ndVector::m_zero, boxDistanceTravel);
+		ndFastRay obbRay(ndVector::m_zero, obbAabbInfo.UnrotateVector(boxDistanceTravel));
+		stackPool[0].m_dist = ndNode::BoxIntersect(ray, obbRay, obbAabbInfo, stackPool[0].m_p0, stackPool[0].m_p1);
+		while (stack)
+		{
+			stack--;
+			const ndCompressedData::ndStackEntry entry(stackPool[stack]);
+			if (entry.m_dist < ndFloat32(1.0f))
+			{
+				const ndCompressedNode* const me = entry.m_node;
+				const ndVector scale(ndCompressedData::GetBoxScale(entry.m_p0, entry.m_p1));
+				for (ndInt32 i = 0; i < 2; ++i)
+				{
+					const ndNode::ndLeafNodePtr& child = i ? me->m_right : me->m_left;
+					if (child.IsLeaf())
+					{
+						const ndInt32 vCount = ndInt32(child.GetCount());
+						if (vCount > 0)
+						{
+							data->DecodeFace(child.GetIndex(), vCount, faceVertex, faceIndices);
+							const ndFloat32 hitDistance = obbAabbInfo.PolygonBoxRayDistance(faceVertex[vCount], vCount, faceIndices, stride, &faceVertex[0].m_x, ray);
+							if (hitDistance < ndFloat32(1.0f))
+							{
+								ndAssert(vCount >= 3);
+								if (callback(context, &faceVertex[0].m_x, sizeof(ndVector), faceIndices, vCount, hitDistance) == m_stopSearch)
+								{
+									return;
+								}
+							}
+						}
+					}
+					else
+					{
+						ndVector p0;
+						ndVector p1;
+						const ndCompressedNode* const node = &data->m_nodes[child.m_node];
+						node->GetBox(entry.m_p0, entry.m_p1, scale, p0, p1);
+						const ndFloat32 dist1 = ndNode::BoxIntersect(ray, obbRay, obbAabbInfo, p0, p1);
+						if (dist1 < ndFloat32(1.0f))
+						{
+							ndCompressedData::PushStackEntry(stackPool, stack, node, p0, p1, dist1);
+						}
+					}
+				}
+			}
+		}
+	}
+}
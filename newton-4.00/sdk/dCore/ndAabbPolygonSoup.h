@@ -30,12 +30,19 @@
 #include "ndIntersections.h"
 #include "ndPolygonSoupDatabase.h"
 
+class ndThreadPool;
+class ndMemoryMappedFile;
 class ndPolygonSoupBuilder;
+class ndPolygonSoupBuildProgress;
 
 // index format: i0, i1, i2, ... , id, normal, e0Normal, e1Normal, e2Normal, ..., faceSize
 #define D_CONCAVE_EDGE_MASK			(1<<31)
 #define D_FACE_CLIP_DIAGONAL_SCALE	ndFloat32 (0.25f)
 
+// compressed database, vertices are quantized in clusters of consecutive vertices
+#define D_COMPRESSED_CLUSTER_SIZE_BITS	8
+#define D_COMPRESSED_CLUSTER_SIZE		(1<<D_COMPRESSED_CLUSTER_SIZE_BITS)
+
 enum ndIntersectStatus
 {
 	m_stopSearch,
@@ -54,6 +61,13 @@ typedef ndFloat32(*ndRayIntersectCallback) (void* const context,
 class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 {
 	public:
+	enum ndCacheStatus
+	{
+		m_cacheLoaded = 0,
+		m_cacheNotACacheFile,
+		m_cacheCorrupted,
+	};
+
 	class ndNode
 	{
 		public:
@@ -133,6 +147,20 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 			ndVector p1 (&vertexArray[m_indexBox1].m_x);
 			p0 = p0 & ndVector::m_triplexMask;
 			p1 = p1 & ndVector::m_triplexMask;
+			return BoxPenetration(obb, p0, p1);
+		}
+
+		inline ndFloat32 BoxIntersect (const ndFastRay& ray, const ndFastRay& obbRay, const ndFastAabb& obb, const ndTriplex* const vertexArray) const
+		{
+			ndVector p0 (&vertexArray[m_indexBox0].m_x);
+			ndVector p1 (&vertexArray[m_indexBox1].m_x);
+			p0 = p0 & ndVector::m_triplexMask;
+			p1 = p1 & ndVector::m_triplexMask;
+			return BoxIntersect(ray, obbRay, obb, p0, p1);
+		}
+
+		static inline ndFloat32 BoxPenetration (const ndFastAabb& obb, const ndVector& p0, const ndVector& p1)
+		{
 			ndVector minBox (p0 - obb.m_p1);
 			ndVector maxBox (p1 - obb.m_p0);
 			ndAssert(maxBox.m_x >= minBox.m_x);
@@ -173,13 +201,8 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 			return	dist.GetScalar();
 		}
 
-		inline ndFloat32 BoxIntersect (const ndFastRay& ray, const ndFastRay& obbRay, const ndFastAabb& obb, const ndTriplex* const vertexArray) const
+		static inline ndFloat32 BoxIntersect (const ndFastRay& ray, const ndFastRay& obbRay, const ndFastAabb& obb, const ndVector& p0, const ndVector& p1)
 		{
-			ndVector p0 (&vertexArray[m_indexBox0].m_x);
-			ndVector p1 (&vertexArray[m_indexBox1].m_x);
-			p0 = p0 & ndVector::m_triplexMask;
-			p1 = p1 & ndVector::m_triplexMask;
-
 			ndVector minBox (p0 - obb.m_p1);
 			ndVector maxBox (p1 - obb.m_p0);
 			ndFloat32 dist = ray.BoxIntersect(minBox, maxBox);
@@ -207,8 +230,25 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 		ndLeafNodePtr m_right;
 	};
 
+	class ndCompressedNode
+	{
+		public:
+		// box minimum quantized relative to the parent box minimum,
+		// and box maximum quantized relative to the parent box maximum.
+		inline void GetBox (const ndVector& parentP0, const ndVector& parentP1, const ndVector& parentScale, ndVector& p0, ndVector& p1) const
+		{
+			p0 = parentP0 + ndVector (ndFloat32 (m_box[0]), ndFloat32 (m_box[1]), ndFloat32 (m_box[2]), ndFloat32 (0.0f)) * parentScale;
+			p1 = parentP1 - ndVector (ndFloat32 (m_box[3]), ndFloat32 (m_box[4]), ndFloat32 (m_box[5]), ndFloat32 (0.0f)) * parentScale;
+		}
+
+		ndUnsigned16 m_box[6];
+		ndNode::ndLeafNodePtr m_left;
+		ndNode::ndLeafNodePtr m_right;
+	};
+
 	class ndSplitInfo;
 	class ndNodeBuilder;
+	class ndCompressedData;
 
 	/// get the root node bounding box of the mesh.
 	D_CORE_API virtual void GetAABB (ndVector& p0, ndVector& p1) const;
@@ -219,12 +259,49 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	/// Reads a previously saved database binary file named path.
 	D_CORE_API virtual void Deserialize (const char* const path);
 
+	/// Converts the database to a compressed layout. Node boxes are quantized to 16 bits
+	/// relative to the parent box, vertices are quantized to 16 bits relative to the origin
+	/// of small vertex clusters, and face indices are packed in a variable length stream.
+	/// Faces are decoded on the fly by the queries, the vertex array passed to the callbacks is
+	/// a temporary buffer with the face points, followed by the face normal and the edge normals.
+	/// Must be called after the adjacency is calculated, returns false if the mesh can't be compressed.
+	D_CORE_API virtual bool Compress ();
+
+	/// returns true if the database was compressed.
+	bool IsCompressed () const;
+
+	/// Writes the built hierarchy, plain or compressed, to a binary cache file that LoadCache
+	/// can map and use in place. The layout is versioned and pointer free, nodes reference
+	/// children and faces by index, and the file carries an integrity hash of its content.
+	D_CORE_API bool SaveCache (const char* const path) const;
+
+	/// Maps a cache file written by SaveCache and uses it in place, nothing is rebuilt or copied.
+	/// Returns m_cacheNotACacheFile if the file is missing or does not start with the cache signature,
+	/// and m_cacheCorrupted if it does but was written by a different version or platform layout,
+	/// is truncated, or verify is true and the content does not match the integrity hash.
+	/// The database must be empty.
+	D_CORE_API virtual ndCacheStatus LoadCache (const char* const path, bool verify = true);
+
+	/// returns true if the database is used in place from a memory mapped cache file.
+	bool IsMapped () const;
+
+	/// Returns the memory used by the hierarchy, vertex and face data.
+	D_CORE_API ndInt64 GetMemoryUsed () const;
+
 	protected:
 	D_CORE_API ndAabbPolygonSoup ();
 	D_CORE_API virtual ~ndAabbPolygonSoup ();
 
 	D_CORE_API void Create (const ndPolygonSoupBuilder& builder);
 	D_CORE_API void CalculateAdjacent ();
+
+	/// Builds the hierarchy on all the threads of the pool, the leaves are split with a binned surface
+	/// area heuristic. The pool must be running. Returns false and leaves the database empty if canceled.
+	D_CORE_API bool Create (ndThreadPool& threadPool, const ndPolygonSoupBuilder& builder, ndPolygonSoupBuildProgress* const progress = nullptr);
+
+	/// Calculates the face edge adjacency on all the threads of the pool by matching the edges of the
+	/// faces with a hash table. The pool must be running. Returns false and empties the database if canceled.
+	D_CORE_API bool CalculateAdjacent (ndThreadPool& threadPool, ndPolygonSoupBuildProgress* const progress = nullptr);
 	D_CORE_API virtual ndVector ForAllSectorsSupportVertex(const ndVector& dir) const;
 	D_CORE_API virtual void ForAllSectorsRayHit (const ndFastRay& ray, ndFloat32 maxT, ndRayIntersectCallback callback, void* const context) const;
 	D_CORE_API virtual void ForAllSectors (const ndFastAabb& obbAabb, const ndVector& boxDistanceTravel, ndFloat32 maxT, ndAaabbIntersectCallback callback, void* const context) const;
@@ -261,7 +338,16 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	}
 
 	private:
+	void ForAllSectorsCompressed (const ndFastAabb& obbAabb, const ndVector& boxDistanceTravel, ndAaabbIntersectCallback callback, void* const context) const;
+	void ForAllSectorsRayHitCompressed (const ndFastRay& ray, ndFloat32 maxT, ndRayIntersectCallback callback, void* const context) const;
+	ndVector ForAllSectorsSupportVertexCompressed (const ndVector& dir) const;
+	void SerializeCompressed (FILE* const file) const;
+	void DeserializeCompressed (FILE* const file);
+
 	ndNodeBuilder* BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator) const;
+	ndNodeBuilder* BuildTopDown (ndThreadPool& threadPool, ndNodeBuilder* const leafArray, ndInt32 leafCount, ndPolygonSoupBuildProgress* const progress) const;
+	void FreeHierarchy ();
+	void BuildNodes (ndThreadPool* const threadPool, const ndPolygonSoupBuilder& builder, ndNodeBuilder* const root, ndVector* const tmpVertexArray);
 	ndFloat32 CalculateFaceMaxDiagonal (const ndVector* const vertex, ndInt32 indexCount, const ndInt32* const indexArray) const;
 	static ndIntersectStatus CalculateAllFaceEdgeNormals(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
 	
@@ -269,9 +355,21 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	ndInt32* m_indices;
 	ndInt32 m_nodesCount;
 	ndInt32 m_indexCount;
+	ndCompressedData* m_compressed;
+	ndMemoryMappedFile* m_mappedFile;
 	friend class ndContactSolver;
 };
 
+inline bool ndAabbPolygonSoup::IsCompressed () const
+{
+	return m_compressed ? true : false;
+}
+
+inline bool ndAabbPolygonSoup::IsMapped () const
+{
+	return m_mappedFile ? true : false;
+}
+
 #endif
 
 
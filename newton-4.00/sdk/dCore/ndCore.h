@@ -66,6 +66,7 @@
 #include <ndGeneralMatrix.h>
 #include <ndTemplateVector.h>
 #include <ndContainersAlloc.h>
+#include <ndMemoryMappedFile.h>
 #include <ndAabbPolygonSoup.h>
 #include <ndSmallDeterminant.h>
 #include <ndConjugateGradient.h>
@@ -29,6 +29,7 @@
 #include "ndGeneralVector.h"
 
 #define D_LCP_MAX_VALUE ndFloat32 (1.0e15f)
+#define D_CHOLESKY_BLOCK_SIZE 16
 
 //*************************************************************
 //
@@ -137,6 +138,92 @@ bool ndCholeskyFactorization(ndInt32 size, ndInt32 stride, T* const psdMatrix)
 	return state;
 }
 
+// dot product with four partial sums, so that the compiler can map them to simd lanes
+template<class T>
+T ndCholeskyDotProduct(ndInt32 size, const T* const A, const T* const B)
+{
+	T acc0(0.0f);
+	T acc1(0.0f);
+	T acc2(0.0f);
+	T acc3(0.0f);
+	ndInt32 i = 0;
+	for (; i < (size & -4); i += 4)
+	{
+		acc0 += A[i + 0] * B[i + 0];
+		acc1 += A[i + 1] * B[i + 1];
+		acc2 += A[i + 2] * B[i + 2];
+		acc3 += A[i + 3] * B[i + 3];
+	}
+	for (; i < size; ++i)
+	{
+		acc0 += A[i] * B[i];
+	}
+	return (acc0 + acc1) + (acc2 + acc3);
+}
+
+// right looking block factorization, each diagonal block is factored,
+// then the panel below it is solved and the trailing lower triangle
+// is updated with the panel rows, so the inner loops stay in the
+// cache and run over contiguous rows.
+template<class T>
+bool ndBlockCholeskyFactorization(ndInt32 size, ndInt32 stride, T* const psdMatrix)
+{
+	if (size <= 2 * D_CHOLESKY_BLOCK_SIZE)
+	{
+		return ndCholeskyFactorization(size, stride, psdMatrix);
+	}
+
+	T* const invDiagonal = ndAlloca(T, size);
+	for (ndInt32 block = 0; block < size; block += D_CHOLESKY_BLOCK_SIZE)
+	{
+		const ndInt32 blockEnd = ndMin(block + D_CHOLESKY_BLOCK_SIZE, size);
+		for (ndInt32 i = block; i < blockEnd; ++i)
+		{
+			T* const rowI = &psdMatrix[stride * i];
+			for (ndInt32 j = block; j < i; ++j)
+			{
+				T* const rowJ = &psdMatrix[stride * j];
+				rowI[j] = invDiagonal[j] * (rowI[j] - ndCholeskyDotProduct(j - block, &rowI[block], &rowJ[block]));
+				rowJ[i] = T(0.0f);
+			}
+
+			const T diag = rowI[i] - ndCholeskyDotProduct(i - block, &rowI[block], &rowI[block]);
+			#ifdef D_NEWTON_USE_DOUBLE
+			if (diag < T(1.0e-12f))
+			#else
+			if (diag < T(1.0e-6f))
+			#endif
+			{
+				return false;
+			}
+			rowI[i] = T(sqrt(diag));
+			invDiagonal[i] = T(1.0f) / rowI[i];
+		}
+
+		for (ndInt32 i = blockEnd; i < size; ++i)
+		{
+			T* const rowI = &psdMatrix[stride * i];
+			for (ndInt32 j = block; j < blockEnd; ++j)
+			{
+				T* const rowJ = &psdMatrix[stride * j];
+				rowI[j] = invDiagonal[j] * (rowI[j] - ndCholeskyDotProduct(j - block, &rowI[block], &rowJ[block]));
+				rowJ[i] = T(0.0f);
+			}
+		}
+
+		const ndInt32 width = blockEnd - block;
+		for (ndInt32 i = blockEnd; i < size; ++i)
+		{
+			T* const rowI = &psdMatrix[stride * i];
+			for (ndInt32 j = blockEnd; j <= i; ++j)
+			{
+				rowI[j] -= ndCholeskyDotProduct(width, &rowI[block], &psdMatrix[stride * j + block]);
+			}
+		}
+	}
+	return true;
+}
+
 template<class T>
 bool ndTestPSDmatrix(ndInt32 size, ndInt32 stride, T* const matrix)
 {
@@ -0,0 +1,133 @@
+/* Copyright (c) <2003-2022> <Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndMemoryMappedFile.h"
+
+#if !(defined (WIN32) || defined(_WIN32) || defined (_M_ARM) || defined (_M_ARM64))
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+ndMemoryMappedFile::ndMemoryMappedFile()
+	:ndClassAlloc()
+	,m_data(nullptr)
+	,m_size(0)
+	,m_file(nullptr)
+	,m_mapping(nullptr)
+{
+}
+
+ndMemoryMappedFile::~ndMemoryMappedFile()
+{
+	Close();
+}
+
+#if (defined (WIN32) || defined(_WIN32) || defined (_M_ARM) || defined (_M_ARM64))
+
+bool ndMemoryMappedFile::Open(const char* const path)
+{
+	Close();
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (size.QuadPart == 0))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* const data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_data = data;
+	m_size = size_t(size.QuadPart);
+	m_file = file;
+	m_mapping = mapping;
+	return true;
+}
+
+void ndMemoryMappedFile::Close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		CloseHandle((HANDLE)m_mapping);
+		CloseHandle((HANDLE)m_file);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+
+#else
+
+bool ndMemoryMappedFile::Open(const char* const path)
+{
+	Close();
+	const int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if ((fstat(file, &info) != 0) || (info.st_size == 0))
+	{
+		close(file);
+		return false;
+	}
+
+	// a private mapping, pages are shared with the file cache until they are written to.
+	void* const data = mmap(nullptr, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	// the mapping keeps a reference to the file, the descriptor is not needed anymore
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	m_data = data;
+	m_size = size_t(info.st_size);
+	return true;
+}
+
+void ndMemoryMappedFile::Close()
+{
+	if (m_data)
+	{
+		munmap(m_data, m_size);
+	}
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/* Copyright (c) <2003-2022> <Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#ifndef __ND_MEMORY_MAPPED_FILE_H__
+#define __ND_MEMORY_MAPPED_FILE_H__
+
+#include "ndCoreStdafx.h"
+#include "ndTypes.h"
+#include "ndClassAlloc.h"
+
+/// Read only view of a file mapped in the process address space.
+/// The view is copy on write, the application can patch the mapped
+/// memory, but the changes are private and never written back to the file.
+class ndMemoryMappedFile: public ndClassAlloc
+{
+	public:
+	D_CORE_API ndMemoryMappedFile();
+	D_CORE_API ~ndMemoryMappedFile();
+
+	/// maps the entire file, returns false if the file can't be opened or is empty.
+	D_CORE_API bool Open(const char* const path);
+
+	/// unmaps the file, all pointers to the mapped memory are invalid after this call.
+	D_CORE_API void Close();
+
+	bool IsOpen() const;
+	size_t GetSize() const;
+	void* GetData() const;
+
+	private:
+	void* m_data;
+	size_t m_size;
+	void* m_file;
+	void* m_mapping;
+};
+
+inline bool ndMemoryMappedFile::IsOpen() const
+{
+	return m_data ? true : false;
+}
+
+inline size_t ndMemoryMappedFile::GetSize() const
+{
+	return m_size;
+}
+
+inline void* ndMemoryMappedFile::GetData() const
+{
+	return m_data;
+}
+
+#endif
@@ -29,7 +29,9 @@
 #include "ndList.h"
 #include "ndTree.h"
 #include "ndStack.h"
+#include "ndProfiler.h"
 #include "ndPolyhedra.h"
+#include "ndThreadPool.h"
 #include "ndPolygonSoupBuilder.h"
 
 #define ND_POINTS_RUN (512 * 1024)
@@ -41,6 +43,14 @@ class ndPolygonSoupBuilder::ndFaceInfo
 	ndInt32 indexStart;
 };
 
+class ndPolygonSoupBuilder::ndOptimizeCluster
+{
+	public:
+	ndInt32 m_faceId;
+	ndInt32 m_start;
+	ndInt32 m_count;
+};
+
 class ndPolygonSoupBuilder::ndFaceBucket: public ndList<ndFaceInfo>
 {
 	public: 
@@ -635,24 +645,203 @@ void ndPolygonSoupBuilder::End(bool optimize)
 	}
 }
 
-void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source)
+void ndPolygonSoupBuilder::CalculateFaceStart(ndInt32* const faceStart) const
 {
-	#define DG_MESH_PARTITION_SIZE (1024 * 4)
+	ndInt32 indexCount = 0;
+	for (ndInt32 i = 0; i < m_faceVertexCount.GetCount(); ++i)
+	{
+		faceStart[i] = indexCount;
+		indexCount += m_faceVertexCount[i];
+	}
+	faceStart[m_faceVertexCount.GetCount()] = indexCount;
+}
 
-	const ndInt32* const indexArray = &source.m_vertexIndex[0];
-	const ndBigVector* const points = &source.m_vertexPoints[0];
+void ndPolygonSoupBuilder::Finalize(ndThreadPool& threadPool)
+{
+	D_TRACKTIME();
+	const ndInt32 faceCount = m_faceVertexCount.GetCount();
+	if (faceCount)
+	{
+		ndStack<ndInt32> indexMapPool(m_vertexPoints.GetCount());
+		ndInt32* const indexMap = &indexMapPool[0];
+		ndInt32 vertexCount = ndVertexListToIndexList(threadPool, &m_vertexPoints[0].m_x, sizeof(ndBigVector), 3, m_vertexPoints.GetCount(), &indexMap[0], ndFloat64(1.0e-4f));
+		ndAssert(vertexCount <= m_vertexPoints.GetCount());
+		m_vertexPoints.SetCount(vertexCount);
 
-	ndVector face[256];
-	ndInt32 faceIndex[256];
-	if (faceBucket.GetCount() >= DG_MESH_PARTITION_SIZE) 
+		ndStack<ndInt32> faceStartPool(faceCount + 1);
+		ndInt32* const faceStart = &faceStartPool[0];
+		CalculateFaceStart(faceStart);
+
+		ndInt32* const vertexIndex = &m_vertexIndex[0];
+		const ndInt32* const faceVertexCount = &m_faceVertexCount[0];
+		auto RemapIndices = ndMakeObject::ndFunction([vertexIndex, faceVertexCount, faceStart, indexMap, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(RemapIndices);
+			const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				ndInt32* const face = &vertexIndex[faceStart[i]];
+				const ndInt32 count = faceVertexCount[i] - 1;
+				for (ndInt32 j = 0; j < count; ++j)
+				{
+					face[j] = indexMap[face[j]];
+				}
+			}
+		});
+		threadPool.ParallelExecute(RemapIndices);
+
+		OptimizeByIndividualFaces(threadPool, faceStart);
+	}
+}
+
+void ndPolygonSoupBuilder::OptimizeByIndividualFaces(ndThreadPool& threadPool, const ndInt32* const faceStart)
+{
+	D_TRACKTIME();
+	const ndInt32 faceCount = m_faceVertexCount.GetCount();
+	ndStack<ndInt32> filteredCountPool(faceCount);
+	ndInt32* const filteredCount = &filteredCountPool[0];
+
+	// each face is filtered in place, the filtered faces are packed afterward
+	auto FilterFaces = ndMakeObject::ndFunction([this, faceStart, filteredCount, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		ndStack<ndFaceBucket::ndNode*> array(faceBucket.GetCount());
-		ndInt32 count = 0;
-		for (ndFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
+		D_TRACKTIME_NAMED(FilterFaces);
+		ndInt32* const indexArray = &m_vertexIndex[0];
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			array[count] = node;
-			count ++;
+			filteredCount[i] = FilterFace(m_faceVertexCount[i] - 1, &indexArray[faceStart[i]]);
 		}
+	});
+	threadPool.ParallelExecute(FilterFaces);
+
+	ndInt32* const faceArray = &m_faceVertexCount[0];
+	ndInt32* const indexArray = &m_vertexIndex[0];
+	ndInt32 newFaceCount = 0;
+	ndInt32 newIndexCount = 0;
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		const ndInt32 count = filteredCount[i];
+		if (count)
+		{
+			const ndInt32 polygonIndex = faceStart[i];
+			const ndInt32 attribute = indexArray[faceStart[i + 1] - 1];
+			faceArray[newFaceCount] = count + 1;
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				indexArray[newIndexCount + j] = indexArray[polygonIndex + j];
+			}
+			indexArray[newIndexCount + count] = attribute;
+			newFaceCount++;
+			newIndexCount += (count + 1);
+		}
+	}
+
+	m_vertexIndex.Resize(newIndexCount);
+	m_faceVertexCount.Resize(newFaceCount);
+	m_vertexIndex.SetCount(newIndexCount);
+	m_faceVertexCount.SetCount(newFaceCount);
+}
+
+void ndPolygonSoupBuilder::CalculateFaceNormals(ndThreadPool& threadPool)
+{
+	D_TRACKTIME();
+	const ndInt32 faceCount = m_faceVertexCount.GetCount();
+	if (faceCount)
+	{
+		ndStack<ndInt32> faceStartPool(faceCount + 1);
+		ndInt32* const faceStart = &faceStartPool[0];
+		CalculateFaceStart(faceStart);
+
+		m_normalPoints.Resize(faceCount);
+		m_normalPoints.SetCount(faceCount);
+		auto CalculateNormals = ndMakeObject::ndFunction([this, faceStart, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(CalculateNormals);
+			const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+			{
+				const ndInt32 faceIndexCount = m_faceVertexCount[i];
+				const ndInt32* const ptr = &m_vertexIndex[faceStart[i]];
+				ndBigVector v0(&m_vertexPoints[ptr[0]].m_x);
+				ndBigVector v1(&m_vertexPoints[ptr[1]].m_x);
+				ndBigVector e0(v1 - v0);
+				ndBigVector normal0(ndBigVector::m_zero);
+				for (ndInt32 j = 2; j < faceIndexCount - 1; ++j)
+				{
+					ndBigVector v2(&m_vertexPoints[ptr[j]].m_x);
+					ndBigVector e1(v2 - v0);
+					normal0 += e0.CrossProduct(e1);
+					e0 = e1;
+				}
+				ndBigVector normal(normal0.Normalize());
+
+				m_normalPoints[i].m_x = normal.m_x;
+				m_normalPoints[i].m_y = normal.m_y;
+				m_normalPoints[i].m_z = normal.m_z;
+				m_normalPoints[i].m_w = ndFloat32(0.0f);
+			}
+		});
+		threadPool.ParallelExecute(CalculateNormals);
+
+		m_normalIndex.Resize(faceCount);
+		m_normalIndex.SetCount(faceCount);
+		ndInt32 normalCount = ndVertexListToIndexList(threadPool, &m_normalPoints[0].m_x, sizeof(ndBigVector), 3, faceCount, &m_normalIndex[0], ndFloat64(1.0e-6f));
+		ndAssert(normalCount <= m_normalPoints.GetCount());
+		m_normalPoints.SetCount(normalCount);
+	}
+}
+
+bool ndPolygonSoupBuilder::End(ndThreadPool& threadPool, bool optimize, ndPolygonSoupBuildProgress* const progress)
+{
+	D_TRACKTIME();
+	bool ok = true;
+	threadPool.Begin();
+	if (optimize)
+	{
+		ndPolygonSoupBuilder copy(*this);
+		ndFaceMap faceMap(copy);
+
+		Begin();
+		// the points are welded once at the end, not on every run
+		m_run = 0x7fffffff;
+		ok = Optimize(threadPool, faceMap, copy, progress);
+	}
+
+	ok = ok && (!progress || progress->Update(ndPolygonSoupBuildProgress::m_weldVertices, ndFloat32(0.0f)));
+	if (ok)
+	{
+		Finalize(threadPool);
+		CalculateFaceNormals(threadPool);
+		ok = !progress || progress->Update(ndPolygonSoupBuildProgress::m_weldVertices, ndFloat32(1.0f));
+	}
+	threadPool.End();
+
+	if (!ok)
+	{
+		Begin();
+	}
+	m_run = ND_POINTS_RUN;
+	return ok;
+}
+
+void ndPolygonSoupBuilder::GetOptimizeClusters(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source, ndArray<ndFaceInfo>& faces, ndArray<ndOptimizeCluster>& clusters) const
+{
+	#define DG_MESH_PARTITION_SIZE (1024 * 4)
+
+	const ndInt32 base = faces.GetCount();
+	for (ndFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
+	{
+		faces.PushBack(node->GetInfo());
+	}
+	const ndInt32 count = faces.GetCount() - base;
+
+	ndOptimizeCluster cluster;
+	cluster.m_faceId = faceId;
+	if (count >= DG_MESH_PARTITION_SIZE) 
+	{
+		const ndInt32* const indexArray = &source.m_vertexIndex[0];
+		const ndBigVector* const points = &source.m_vertexPoints[0];
+		ndFaceInfo* const array = &faces[base];
 
 		ndInt32 stack = 1;
 		ndInt32 segments[32][2];
@@ -668,37 +857,9 @@ void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBuck
 
 			if (faceCount <= DG_MESH_PARTITION_SIZE) 
 			{
-				ndPolygonSoupBuilder tmpBuilder;
-				for (ndInt32 i = 0; i < faceCount; ++i) 
-				{
-					const ndFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
-
-					ndInt32 count1 = faceInfo.indexCount - 1;
-					ndInt32 start1 = faceInfo.indexStart;
-					ndAssert (faceId == indexArray[start1 + count1]);
-					for (ndInt32 j = 0; j < count1; ++j) 
-					{
-						ndInt32 index = indexArray[start1 + j];
-						face[j] = points[index];
-						faceIndex[j] = j;
-					}
-					tmpBuilder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count1);
-				}
-				tmpBuilder.FinalizeAndOptimize (faceId);
-
-				ndInt32 faceIndexNumber = 0;
-				for (ndInt32 i = 0; i < tmpBuilder.m_faceVertexCount.GetCount(); ++i)
-				{
-					ndInt32 indexCount = tmpBuilder.m_faceVertexCount[i] - 1;
-					for (ndInt32 j = 0; j < indexCount; ++j) 
-					{
-						ndInt32 index = tmpBuilder.m_vertexIndex[faceIndexNumber + j];
-						face[j] = tmpBuilder.m_vertexPoints[index];
-						faceIndex[j] = j;
-					}
-					AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
-					faceIndexNumber += (indexCount + 1); 
-				}
+				cluster.m_start = base + faceStart;
+				cluster.m_count = faceCount;
+				clusters.PushBack(cluster);
 			} 
 			else 
 			{
@@ -706,7 +867,7 @@ void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBuck
 				ndBigVector varian (ndBigVector::m_zero);
 				for (ndInt32 i = 0; i < faceCount; ++i) 
 				{
-					const ndFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
+					const ndFaceInfo& faceInfo = array[faceStart + i];
 					ndInt32 count1 = faceInfo.indexCount - 1;
 					ndInt32 start1 = faceInfo.indexStart;
 					ndBigVector p0 (ndFloat32 ( 1.0e10f), ndFloat32 ( 1.0e10f), ndFloat32 ( 1.0e10f), ndFloat32 (0.0f));
@@ -745,7 +906,7 @@ void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBuck
 				for (ndInt32 i = 0; i < lastFace; ++i) 
 				{
 					ndInt32 side = 0;
-					const ndFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
+					const ndFaceInfo& faceInfo = array[faceStart + i];
 
 					ndInt32 start1 = faceInfo.indexStart;
 					ndInt32 count1 = faceInfo.indexCount - 1;
@@ -786,39 +947,119 @@ void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBuck
 	} 
 	else 
 	{
-		ndPolygonSoupBuilder tmpBuilder;
-		for (ndFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
+		cluster.m_start = base;
+		cluster.m_count = count;
+		clusters.PushBack(cluster);
+	}
+}
+
+void ndPolygonSoupBuilder::OptimizeCluster(ndPolygonSoupBuilder& builder, ndInt32 faceId, const ndFaceInfo* const faces, ndInt32 count, const ndPolygonSoupBuilder& source)
+{
+	ndVector face[256];
+	ndInt32 faceIndex[256];
+	const ndInt32* const indexArray = &source.m_vertexIndex[0];
+	const ndBigVector* const points = &source.m_vertexPoints[0];
+	for (ndInt32 i = 0; i < count; ++i) 
+	{
+		const ndFaceInfo& faceInfo = faces[i];
+
+		ndInt32 count1 = faceInfo.indexCount - 1;
+		ndInt32 start1 = faceInfo.indexStart;
+		ndAssert (faceId == indexArray[start1 + count1]);
+		for (ndInt32 j = 0; j < count1; ++j) 
 		{
-			const ndFaceInfo& faceInfo = node->GetInfo();
+			ndInt32 index = indexArray[start1 + j];
+			face[j] = points[index];
+			faceIndex[j] = j;
+		}
+		builder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count1);
+	}
+	builder.FinalizeAndOptimize (faceId);
+}
 
-			ndInt32 count = faceInfo.indexCount - 1;
-			ndInt32 start = faceInfo.indexStart;
-			ndAssert (faceId == indexArray[start + count]);
-			for (ndInt32 j = 0; j < count; ++j) 
-			{
-				ndInt32 index = indexArray[start + j];
-				face[j] = points[index];
-				faceIndex[j] = j;
-			}
-			tmpBuilder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count);
+void ndPolygonSoupBuilder::AddOptimizedFaces(const ndPolygonSoupBuilder& builder, ndInt32 faceId)
+{
+	ndVector face[256];
+	ndInt32 faceIndex[256];
+	ndInt32 faceIndexNumber = 0;
+	for (ndInt32 i = 0; i < builder.m_faceVertexCount.GetCount(); ++i)
+	{
+		ndInt32 indexCount = builder.m_faceVertexCount[i] - 1;
+		for (ndInt32 j = 0; j < indexCount; ++j) 
+		{
+			ndInt32 index = builder.m_vertexIndex[faceIndexNumber + j];
+			face[j] = builder.m_vertexPoints[index];
+			faceIndex[j] = j;
 		}
-		tmpBuilder.FinalizeAndOptimize (faceId);
+		AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
+		faceIndexNumber += (indexCount + 1); 
+	}
+}
 
-		ndInt32 faceIndexNumber = 0;
-		for (ndInt32 i = 0; i < tmpBuilder.m_faceVertexCount.GetCount(); ++i)
+void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source)
+{
+	ndArray<ndFaceInfo> faces;
+	ndArray<ndOptimizeCluster> clusters;
+	GetOptimizeClusters(faceId, faceBucket, source, faces, clusters);
+	for (ndInt32 i = 0; i < clusters.GetCount(); ++i)
+	{
+		const ndOptimizeCluster& cluster = clusters[i];
+		ndPolygonSoupBuilder tmpBuilder;
+		OptimizeCluster(tmpBuilder, faceId, &faces[cluster.m_start], cluster.m_count, source);
+		AddOptimizedFaces(tmpBuilder, faceId);
+	}
+}
+
+bool ndPolygonSoupBuilder::Optimize(ndThreadPool& threadPool, const ndFaceMap& faceMap, const ndPolygonSoupBuilder& source, ndPolygonSoupBuildProgress* const progress)
+{
+	D_TRACKTIME();
+	ndArray<ndFaceInfo> faces;
+	ndArray<ndOptimizeCluster> clusters;
+	ndFaceMap::Iterator iter(faceMap);
+	for (iter.Begin(); iter; iter++)
+	{
+		GetOptimizeClusters(iter.GetNode()->GetKey(), iter.GetNode()->GetInfo(), source, faces, clusters);
+	}
+
+	// the clusters are optimized in parallel in batches, and the
+	// results are added in order, so the output does not depend on the thread count.
+	const ndInt32 batchSize = threadPool.GetThreadCount() * 4;
+	ndFixSizeArray<ndPolygonSoupBuilder*, D_MAX_THREADS_COUNT * 4> builders;
+	for (ndInt32 i = 0; i < batchSize; ++i)
+	{
+		builders.PushBack(new ndPolygonSoupBuilder);
+	}
+
+	bool canceled = false;
+	for (ndInt32 base = 0; !canceled && (base < clusters.GetCount()); base += batchSize)
+	{
+		const ndInt32 count = ndMin(batchSize, clusters.GetCount() - base);
+		ndAtomic<ndInt32> iterator(0);
+		auto OptimizeClusters = ndMakeObject::ndFunction([&faces, &clusters, &builders, &iterator, &source, base, count](ndInt32, ndInt32)
 		{
-			ndInt32 indexCount = tmpBuilder.m_faceVertexCount[i] - 1;
-			for (ndInt32 j = 0; j < indexCount; ++j) 
+			D_TRACKTIME_NAMED(OptimizeClusters);
+			for (ndInt32 i = iterator.fetch_add(1); i < count; i = iterator.fetch_add(1))
 			{
-				ndInt32 index = tmpBuilder.m_vertexIndex[faceIndexNumber + j];
-				face[j] = tmpBuilder.m_vertexPoints[index];
-				faceIndex[j] = j;
+				const ndOptimizeCluster& cluster = clusters[base + i];
+				ndPolygonSoupBuilder* const builder = builders[i];
+				builder->Begin();
+				OptimizeCluster(*builder, cluster.m_faceId, &faces[cluster.m_start], cluster.m_count, source);
 			}
-			AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
-		
-			faceIndexNumber += (indexCount + 1); 
+		});
+		threadPool.ParallelExecute(OptimizeClusters);
+
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			AddOptimizedFaces(*builders[i], clusters[base + i].m_faceId);
 		}
+		canceled = progress && !progress->Update(ndPolygonSoupBuildProgress::m_optimizeFaces, ndFloat32(base + count) / ndFloat32(clusters.GetCount()));
+	}
+
+	for (ndInt32 i = 0; i < builders.GetCount(); ++i)
+	{
+		delete builders[i];
 	}
+	return !canceled;
 }
 
 ndInt32 ndPolygonSoupBuilder::FilterFace (ndInt32 count, ndInt32* const pool)
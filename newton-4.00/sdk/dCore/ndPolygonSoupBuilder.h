@@ -34,6 +34,8 @@
 #include "ndVector.h"
 #include "ndMatrix.h"
 
+class ndThreadPool;
+
 /// Helper intermediate class for encoding a face adjacent face to an edge of a face.
 class ndAdjacentFace
 {
@@ -44,11 +46,37 @@ class ndAdjacentFace
 	ndInt64 m_edgeMap[256];
 };
 
+/// Progress notification for the threaded polygon soup and collision tree builds.
+class ndPolygonSoupBuildProgress
+{
+	public:
+	enum ndStage
+	{
+		m_optimizeFaces,
+		m_weldVertices,
+		m_buildHierarchy,
+		m_calculateAdjacency,
+	};
+
+	ndPolygonSoupBuildProgress()
+	{
+	}
+
+	virtual ~ndPolygonSoupBuildProgress()
+	{
+	}
+
+	/// Called from the thread that runs the build, between batches of parallel work.
+	/// progress goes from zero to one within each stage, return false to cancel the build.
+	virtual bool Update(ndStage stage, ndFloat32 progress) = 0;
+};
+
 class ndPolygonSoupBuilder: public ndClassAlloc 
 {
 	class ndFaceMap;
 	class ndFaceInfo;
 	class ndFaceBucket;
+	class ndOptimizeCluster;
 	class ndPolySoupFilterAllocator;
 
 	public:
@@ -58,6 +86,11 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 
 	D_CORE_API virtual void Begin();
 	D_CORE_API virtual void End(bool optimize);
+
+	/// Same as End, but the vertex welding, face filtering, face normals and the optimization of the
+	/// faces of each material run on all the threads of the pool. The pool must be idle, the build
+	/// starts and stops it. Returns false if the build was canceled, the builder is left empty.
+	D_CORE_API bool End(ndThreadPool& threadPool, bool optimize, ndPolygonSoupBuildProgress* const progress = nullptr);
 	D_CORE_API virtual void AddFace(const ndFloat32* const vertex, ndInt32 strideInBytes, ndInt32 vertexCount, const ndInt32 faceId);
 	D_CORE_API virtual void AddFaceIndirect(const ndFloat32* const vertex, ndInt32 strideInBytes, ndInt32 faceId, const ndInt32* const indexArray, ndInt32 indexCount);
 
@@ -66,9 +99,17 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 
 	private:
 	void Optimize(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source);
+	bool Optimize(ndThreadPool& threadPool, const ndFaceMap& faceMap, const ndPolygonSoupBuilder& source, ndPolygonSoupBuildProgress* const progress);
+	void GetOptimizeClusters(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source, ndArray<ndFaceInfo>& faces, ndArray<ndOptimizeCluster>& clusters) const;
+	void AddOptimizedFaces(const ndPolygonSoupBuilder& builder, ndInt32 faceId);
+	static void OptimizeCluster(ndPolygonSoupBuilder& builder, ndInt32 faceId, const ndFaceInfo* const faces, ndInt32 count, const ndPolygonSoupBuilder& source);
 
 	void Finalize();
 	void OptimizeByIndividualFaces();
+	void Finalize(ndThreadPool& threadPool);
+	void OptimizeByIndividualFaces(ndThreadPool& threadPool, const ndInt32* const faceStart);
+	void CalculateFaceNormals(ndThreadPool& threadPool);
+	void CalculateFaceStart(ndInt32* const faceStart) const;
 	void FinalizeAndOptimize(ndInt32 id);
 	ndInt32 FilterFace (ndInt32 count, ndInt32* const indexArray);
 	ndInt32 AddConvexFace (ndInt32 count, ndInt32* const indexArray, ndInt32* const  facesArray);
@@ -25,6 +25,8 @@
 #include "ndUtils.h"
 #include "ndVector.h"
 #include "ndMatrix.h"
+#include "ndProfiler.h"
+#include "ndThreadPool.h"
 
 #define D_VERTEXLIST_INDEX_LIST_BASH (1024)
 
@@ -368,6 +370,159 @@ ndInt32 ndVertexListToIndexList(ndFloat64* const vertList, ndInt32 strideInBytes
 	return count;
 }
 
+static inline ndUnsigned32 ndWeldCellHash(ndInt64 x, ndInt64 y, ndInt64 z)
+{
+	ndUnsigned64 hash = ndUnsigned64(x) * 0x9e3779b97f4a7c15ULL;
+	hash ^= ndUnsigned64(y) * 0xc2b2ae3d27d4eb4fULL;
+	hash ^= ndUnsigned64(z) * 0x165667b19e3779f9ULL;
+	hash ^= hash >> 29;
+	hash *= 0x94d049bb133111ebULL;
+	return ndUnsigned32(hash ^ (hash >> 32));
+}
+
+ndInt32 ndVertexListToIndexList(ndThreadPool& threadPool, ndFloat64* const vertList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance)
+{
+	D_TRACKTIME();
+	if (strideInBytes < 3 * ndInt32(sizeof(ndFloat64)))
+	{
+		return 0;
+	}
+	if ((compareCount < 3) || (vertexCount <= 0))
+	{
+		return 0;
+	}
+
+	// cells are twice the tolerance, so that a point can only
+	// have neighbors in the eight cells closer to its position.
+	const ndInt32 stride = strideInBytes / ndInt32(sizeof(ndFloat64));
+	const ndFloat64 tol = ndMax(tolerance, ndFloat64(1.0e-8f));
+	const ndFloat64 invCellSize = ndFloat64(0.5f) / tol;
+
+	ndInt32 bucketBits = 1;
+	while (((1 << bucketBits) < vertexCount) && (bucketBits < 30))
+	{
+		bucketBits++;
+	}
+	const ndInt32 bucketCount = 1 << bucketBits;
+	const ndUnsigned32 bucketMask = ndUnsigned32(bucketCount - 1);
+
+	ndStack<ndInt32> bucketStartPool(bucketCount + 1);
+	ndStack<ndInt32> vertexBucketPool(vertexCount);
+	ndStack<ndInt32> sortedPool(vertexCount);
+	ndInt32* const bucketStart = &bucketStartPool[0];
+	ndInt32* const vertexBucket = &vertexBucketPool[0];
+	ndInt32* const sorted = &sortedPool[0];
+
+	auto CalculateBuckets = ndMakeObject::ndFunction([vertList, stride, invCellSize, bucketMask, vertexCount, vertexBucket](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateBuckets);
+		const ndStartEnd startEnd(vertexCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndFloat64* const p = &vertList[i * stride];
+			const ndInt64 x = ndInt64(floor(p[0] * invCellSize));
+			const ndInt64 y = ndInt64(floor(p[1] * invCellSize));
+			const ndInt64 z = ndInt64(floor(p[2] * invCellSize));
+			vertexBucket[i] = ndInt32(ndWeldCellHash(x, y, z) & bucketMask);
+		}
+	});
+	threadPool.ParallelExecute(CalculateBuckets);
+
+	// counting sort, the vertices in each bucket are in increasing index order
+	memset(bucketStart, 0, sizeof(ndInt32) * size_t(bucketCount + 1));
+	for (ndInt32 i = 0; i < vertexCount; ++i)
+	{
+		bucketStart[vertexBucket[i] + 1]++;
+	}
+	for (ndInt32 i = 0; i < bucketCount; ++i)
+	{
+		bucketStart[i + 1] += bucketStart[i];
+	}
+	for (ndInt32 i = 0; i < vertexCount; ++i)
+	{
+		const ndInt32 bucket = vertexBucket[i];
+		sorted[bucketStart[bucket]] = i;
+		bucketStart[bucket]++;
+	}
+	for (ndInt32 i = bucketCount; i > 0; --i)
+	{
+		bucketStart[i] = bucketStart[i - 1];
+	}
+	bucketStart[0] = 0;
+
+	// each vertex finds the lowest index vertex within tolerance
+	auto FindNeighbors = ndMakeObject::ndFunction([vertList, stride, compareCount, tol, invCellSize, bucketMask, vertexCount, bucketStart, sorted, indexListOut](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(FindNeighbors);
+		const ndStartEnd startEnd(vertexCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndFloat64* const p = &vertList[i * stride];
+			ndInt64 cell[3];
+			ndInt64 side[3];
+			for (ndInt32 j = 0; j < 3; ++j)
+			{
+				const ndFloat64 x = p[j] * invCellSize;
+				const ndFloat64 base = floor(x);
+				cell[j] = ndInt64(base);
+				side[j] = ((x - base) < ndFloat64(0.5f)) ? -1 : 1;
+			}
+
+			ndInt32 root = i;
+			for (ndInt32 j = 0; j < 8; ++j)
+			{
+				const ndInt64 x = cell[0] + ((j & 1) ? side[0] : 0);
+				const ndInt64 y = cell[1] + ((j & 2) ? side[1] : 0);
+				const ndInt64 z = cell[2] + ((j & 4) ? side[2] : 0);
+				const ndUnsigned32 bucket = ndWeldCellHash(x, y, z) & bucketMask;
+				for (ndInt32 k = bucketStart[bucket]; k < bucketStart[bucket + 1]; ++k)
+				{
+					const ndInt32 index = sorted[k];
+					if (index >= root)
+					{
+						break;
+					}
+					const ndFloat64* const q = &vertList[index * stride];
+					bool test = true;
+					for (ndInt32 m = 0; test && (m < compareCount); ++m)
+					{
+						test = fabs(p[m] - q[m]) <= tol;
+					}
+					if (test)
+					{
+						root = index;
+						break;
+					}
+				}
+			}
+			indexListOut[i] = root;
+		}
+	});
+	threadPool.ParallelExecute(FindNeighbors);
+
+	// the root of a vertex always has a lower index, so a single pass resolves
+	// the chains, and the unique vertices can be packed in place.
+	ndInt32 count = 0;
+	for (ndInt32 i = 0; i < vertexCount; ++i)
+	{
+		const ndInt32 root = indexListOut[i];
+		if (root == i)
+		{
+			if (count != i)
+			{
+				ndMemCpy(&vertList[count * stride], &vertList[i * stride], stride);
+			}
+			indexListOut[i] = count;
+			count++;
+		}
+		else
+		{
+			indexListOut[i] = indexListOut[root];
+		}
+	}
+	return count;
+}
+
 void ndThreadYield()
 {
 	std::this_thread::yield();
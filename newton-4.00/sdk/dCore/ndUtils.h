@@ -28,6 +28,8 @@
 #include "ndMemory.h"
 #include "ndFixSizeArray.h"
 
+class ndThreadPool;
+
 // assume this function returns memory aligned to 16 bytes
 #define ndAlloca(type, count) (type*) alloca (sizeof (type) * size_t(count))
 
@@ -262,6 +264,34 @@ ndInt32 ndVertexListToIndexList(T* const vertexList, ndInt32 strideInBytes, ndIn
 	return count;
 }
 
+/// removed all duplicate points from an array and place the location in the index array.
+/// welds the points on a hash grid using all the threads of the pool, vertices within tolerance are
+/// merged with the first vertex of the cluster, and the surviving vertices keep their relative order.
+/// the thread pool must be running, this is, between calls to Begin and End.
+D_CORE_API ndInt32 ndVertexListToIndexList(ndThreadPool& threadPool, ndFloat64* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance = ndEpsilon);
+
+/// removed all duplicate points from an array and place the location in the index array.
+/// welds the points on a hash grid using all the threads of the pool.
+template <class T>
+ndInt32 ndVertexListToIndexList(ndThreadPool& threadPool, T* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, T tolerance = ndEpsilon)
+{
+	ndInt32 stride = ndInt32(strideInBytes / sizeof(T));
+	ndStack<ndFloat64> pool(vertexCount * stride);
+
+	ndFloat64* const data = &pool[0];
+	for (ndInt32 i = 0; i < vertexCount * stride; ++i)
+	{
+		data[i] = vertexList[i];
+	}
+
+	ndInt32 count = ndVertexListToIndexList(threadPool, data, ndInt32(stride * sizeof(ndFloat64)), compareCount, vertexCount, indexListOut, ndFloat64(tolerance));
+	for (ndInt32 i = 0; i < count * stride; ++i)
+	{
+		vertexList[i] = T(data[i]);
+	}
+	return count;
+}
+
 /// Simple moving average class, useful for stuff like frame rate smoothing
 template <ndInt32 size>
 class ndMovingAverage: public ndFixSizeArray<ndReal, size>
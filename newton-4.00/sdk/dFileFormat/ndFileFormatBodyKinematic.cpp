@@ -80,6 +80,11 @@ void ndFileFormatBodyKinematic::LoadBody(const nd::TiXmlElement* const node, con
 	ndFileFormatRegistrar* const collisionHandler = ndFileFormatRegistrar::GetHandler(ndShapeInstance::StaticClassName());
 	ndAssert(collisionHandler);
 	ndSharedPtr<ndShapeInstance> instance(collisionHandler->LoadCollision((nd::TiXmlElement*)node->FirstChild(D_INSTANCE_CLASS), shapeMap));
+	if (!*instance)
+	{
+		// the body keeps its null shape
+		return;
+	}
 	kinBody->SetCollisionShape(*(*instance));
 	
 	ndFloat32 invMass = xmlGetFloat(node, "invMass");
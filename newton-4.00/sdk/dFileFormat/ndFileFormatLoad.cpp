@@ -39,8 +39,9 @@ const ndList<ndSharedPtr<ndBody>>& ndFileFormatLoad::GetBodyList() const
 	return m_bodies;
 }
 
-void ndFileFormatLoad::LoadShapes(const nd::TiXmlElement* const rootNode, ndTree<ndShape*, ndInt32>& shapeMap)
+bool ndFileFormatLoad::LoadShapes(const nd::TiXmlElement* const rootNode, ndTree<ndShape*, ndInt32>& shapeMap)
 {
+	bool loaded = true;
 	const nd::TiXmlNode* const shapes = rootNode->FirstChild("ndShapes");
 	if (shapes)
 	{
@@ -54,10 +55,18 @@ void ndFileFormatLoad::LoadShapes(const nd::TiXmlElement* const rootNode, ndTree
 			ndInt32 nodeId;
 			element->Attribute("nodeId", &nodeId);
 			ndShape* const shape = handler->LoadShape(element, shapeMap);
-			shape->AddRef();
-			shapeMap.Insert(shape, nodeId);
+			if (shape)
+			{
+				shape->AddRef();
+				shapeMap.Insert(shape, nodeId);
+			}
+			else
+			{
+				loaded = false;
+			}
 		}
 	}
+	return loaded;
 }
 
 void ndFileFormatLoad::LoadBodies(const nd::TiXmlElement* const rootNode, const ndTree<ndShape*, ndInt32>& shapeMap, ndTree<ndSharedPtr<ndBody>, ndInt32>& bodyMap)
@@ -155,7 +164,7 @@ void ndFileFormatLoad::LoadModels(const nd::TiXmlElement* const rootNode, const
 	}
 }
 
-void ndFileFormatLoad::Load(const char* const path)
+bool ndFileFormatLoad::Load(const char* const path)
 {
 	// save the path for use with generated assets.
 	SetPath(path);
@@ -169,14 +178,14 @@ void ndFileFormatLoad::Load(const char* const path)
 	if (doc.Error())
 	{
 		setlocale(LC_ALL, m_oldloc.GetStr());
-		return;
+		return false;
 	}
 	ndAssert(!doc.Error());
 	
 	if (!doc.FirstChild("ndFile"))
 	{
 		setlocale(LC_ALL, m_oldloc.GetStr());
-		return;
+		return false;
 	}
 	const nd::TiXmlElement* const rootNode = doc.RootElement();
 
@@ -186,11 +195,17 @@ void ndFileFormatLoad::Load(const char* const path)
 
 	m_bodies.RemoveAll();
 	m_joints.RemoveAll();
+	m_models.RemoveAll();
 
-	LoadShapes(rootNode, shapeMap);
-	LoadBodies(rootNode, shapeMap, bodyMap);
-	LoadJoints(rootNode, bodyMap, jointMap);
-	LoadModels(rootNode, bodyMap, jointMap);
+	// the bodies, joints and models refer to each other by id, 
+	// so a scene with a missing shape is not loaded at all.
+	const bool loaded = LoadShapes(rootNode, shapeMap);
+	if (loaded)
+	{
+		LoadBodies(rootNode, shapeMap, bodyMap);
+		LoadJoints(rootNode, bodyMap, jointMap);
+		LoadModels(rootNode, bodyMap, jointMap);
+	}
 
 	ndTree<ndShape*, ndInt32>::Iterator it (shapeMap);
 	for (it.Begin(); it; it++)
@@ -201,6 +216,7 @@ void ndFileFormatLoad::Load(const char* const path)
 	}
 	
 	setlocale(LC_ALL, m_oldloc.GetStr());
+	return loaded;
 }
 
 void ndFileFormatLoad::AddToWorld(ndWorld* const world)
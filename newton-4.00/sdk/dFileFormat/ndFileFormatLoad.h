@@ -31,13 +31,15 @@ class ndFileFormatLoad : public ndFileFormat
 	ndFileFormatLoad();
 	~ndFileFormatLoad();
 
-	void Load(const char* const path);
+	// returns false if the file can not be parsed or a shape can not be 
+	// loaded, for example a damaged static mesh cache. nothing is loaded then.
+	bool Load(const char* const path);
 	void AddToWorld(ndWorld* const world);
 
 	const ndList<ndSharedPtr<ndBody>>& GetBodyList() const;
 	
 	private:
-	void LoadShapes(const nd::TiXmlElement* const rootNode, ndTree<ndShape*, ndInt32>& shapeMap);
+	bool LoadShapes(const nd::TiXmlElement* const rootNode, ndTree<ndShape*, ndInt32>& shapeMap);
 	void LoadBodies(const nd::TiXmlElement* const rootNode, const ndTree<ndShape*, ndInt32>& shapeMap, ndTree<ndSharedPtr<ndBody>, ndInt32>& bodyMap);
 	void LoadJoints(const nd::TiXmlElement* const rootNode, const ndTree<ndSharedPtr<ndBody>, ndInt32>& bodyMap, ndTree<ndSharedPtr<ndJointBilateralConstraint>, ndInt32>& jointMap);
 	void LoadModels(const nd::TiXmlElement* const rootNode, const ndTree<ndSharedPtr<ndBody>, ndInt32>& bodyMap, const ndTree<ndSharedPtr<ndJointBilateralConstraint>, ndInt32>& jointMap);
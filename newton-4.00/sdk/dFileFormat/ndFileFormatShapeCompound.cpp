@@ -78,6 +78,12 @@ ndShape* ndFileFormatShapeCompound::LoadShape(const nd::TiXmlElement* const node
 	for (const nd::TiXmlNode* childNode = node->FirstChild(D_INSTANCE_CLASS); childNode; childNode = childNode->NextSibling())
 	{
 		ndSharedPtr<ndShapeInstance> instance(collisionHandler->LoadCollision((nd::TiXmlElement*)childNode, shapeMap));
+		if (!*instance)
+		{
+			// a compound missing a child is not the saved shape
+			compoundShape->EndAddRemove();
+			return nullptr;
+		}
 		compoundShape->AddCollision(*instance);
 	}
 	compoundShape->EndAddRemove();
@@ -75,7 +75,12 @@ ndShapeInstance* ndFileFormatShapeInstance::LoadCollision(const nd::TiXmlElement
 	xmlGetInt64(node, "material", materialData);
 
 	ndTree<ndShape*, ndInt32>::ndNode* const shapeNode = shapeMap.Find(shapeRef);
-	ndAssert(shapeNode);
+	if (!shapeNode)
+	{
+		// the shape failed to load, the caller decides what to do without it
+		ndTrace(("collision shape %d was not loaded\n", shapeRef));
+		return nullptr;
+	}
 	//ndShapeInstance instance(shapeNode->GetInfo());
 	ndShapeInstance* const instance = new ndShapeInstance(shapeNode->GetInfo());
 
@@ -85,6 +85,7 @@ ndShape* ndFileFormatShapeStaticHeightfield::LoadShape(const nd::TiXmlElement* c
 		ret = fread(&staticMesh->m_elevationMap[0], sizeof(ndReal), size_t(staticMesh->m_elevationMap.GetCount()), file);
 		ret = fread(&staticMesh->m_atributeMap[0], sizeof(ndInt8), size_t(staticMesh->m_atributeMap.GetCount()), file);
 		fclose(file);
+		staticMesh->UpdateElevationMapAabb();
 	}
 	return staticMesh;
 }
\ No newline at end of file
@@ -44,7 +44,7 @@ ndInt32 ndFileFormatShapeStaticMesh_bvh::SaveShape(ndFileFormatSave* const scene
 	ndShapeStatic_bvh* const staticMesh = (ndShapeStatic_bvh*)shape;
 	xmlSaveParam(classNode, "assetName", fileName);
 	xmlSaveParam(classNode, "triangleCount", staticMesh->m_trianglesCount);
-	staticMesh->Serialize(fileName);
+	staticMesh->SaveCache(fileName);
 	return xmlGetNodeId(classNode);
 }
 
@@ -55,7 +55,20 @@ ndShape* ndFileFormatShapeStaticMesh_bvh::LoadShape(const nd::TiXmlElement* cons
 
 	ndShapeStatic_bvh* const staticMesh = new ndShapeStatic_bvh();
 
-	staticMesh->Deserialize(filename);
+	// map the built tree in place, files saved by older versions are read and copied
+	const ndShapeStatic_bvh::ndCacheStatus status = staticMesh->LoadCache(filename);
+	if (status == ndShapeStatic_bvh::m_cacheCorrupted)
+	{
+		// a damaged cache is not a legacy file, do not feed it to the text parser
+		ndTrace(("static mesh cache %s is damaged or was saved by an incompatible build\n", filename));
+		delete staticMesh;
+		return nullptr;
+	}
+	else if (status == ndShapeStatic_bvh::m_cacheNotACacheFile)
+	{
+		staticMesh->Deserialize(filename);
+		staticMesh->CalculateBoxAndTriangleCount();
+	}
 	staticMesh->m_trianglesCount = triangleCount;
 	return staticMesh;
 }
\ No newline at end of file
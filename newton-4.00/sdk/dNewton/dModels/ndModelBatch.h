@@ -0,0 +1,54 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef __ND_MODEL_BATCH_H__
+#define __ND_MODEL_BATCH_H__
+
+#include "ndNewtonStdafx.h"
+
+class ndWorld;
+
+// work collected by many models during their update, and done in one pass. 
+// batches are updated after all the models and before the solver, 
+// so the results can still be applied to the bodies of this sub step. 
+// the typical use is one neural net evaluation for all the models 
+// that run the same brain.
+class ndModelBatch: public ndClassAlloc
+{
+	public:
+	ndModelBatch();
+	virtual ~ndModelBatch();
+
+	// called once per sub step, the batch can use the world scene thread pool.
+	virtual void Update(ndWorld* const world, ndFloat32 timestep) = 0;
+};
+
+inline ndModelBatch::ndModelBatch()
+	:ndClassAlloc()
+{
+}
+
+inline ndModelBatch::~ndModelBatch()
+{
+}
+
+#endif 
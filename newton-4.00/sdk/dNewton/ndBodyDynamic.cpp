@@ -60,6 +60,7 @@ void ndBodyDynamic::SetForce(const ndVector& force)
 		ndAssert(deltaAccel.m_w == ndFloat32(0.0f));
 		ndFloat32 deltaAccel2 = deltaAccel.DotProduct(deltaAccel).GetScalar();
 		m_equilibrium = ndUnsigned8(deltaAccel2 < D_ERR_TOLERANCE2);
+		m_sleepingCounter = m_equilibrium ? m_sleepingCounter : 0;
 	}
 }
 
@@ -77,6 +78,7 @@ void ndBodyDynamic::SetTorque(const ndVector& torque)
 		ndAssert(deltaAlpha.m_w == ndFloat32(0.0f));
 		ndFloat32 deltaAlpha2 = deltaAlpha.DotProduct(deltaAlpha).GetScalar();
 		m_equilibrium = ndUnsigned8(deltaAlpha2 < D_ERR_TOLERANCE2);
+		m_sleepingCounter = m_equilibrium ? m_sleepingCounter : 0;
 	}
 }
 
@@ -151,6 +153,7 @@ void ndBodyDynamic::AddImpulse(const ndVector& pointDeltaVeloc, const ndVector&
 		m_impulseTorque += globalContact.CrossProduct(m_impulseForce);
 
 		m_equilibrium = false;
+		m_sleepingCounter = 0;
 		//Unfreeze();
 	}
 }
@@ -168,6 +171,7 @@ void ndBodyDynamic::ApplyImpulsePair(const ndVector& linearImpulseIn, const ndVe
 		m_impulseTorque += angularImpulse.Scale(1.0f / timestep);
 
 		m_equilibrium = false;
+		m_sleepingCounter = 0;
 	}
 }
 
@@ -197,6 +201,7 @@ void ndBodyDynamic::ApplyImpulsesAtPoint(ndInt32 count, const ndVector* const im
 		m_impulseTorque += angularImpulse.Scale(1.0f / timestep);
 
 		m_equilibrium = false;
+		m_sleepingCounter = 0;
 	}
 }
 
@@ -416,9 +421,9 @@ void ndBodyDynamic::EvaluateSleepState(ndFloat32 freezeSpeed2, ndFloat32 freezeA
 			const ndFloat32 alpha2 = m_alpha.DotProduct(m_alpha).GetScalar();
 			const ndFloat32 speed2 = m_veloc.DotProduct(m_veloc).GetScalar();
 			const ndFloat32 omega2 = m_omega.DotProduct(m_omega).GetScalar();
-			ndUnsigned32 equilibriumTest = ndUnsigned32((accel2 < accelFreeze2) && (alpha2 < accelFreeze2) && (speed2 < freezeSpeed2) && (omega2 < freezeSpeed2));
+			const ndUnsigned32 freezeTest = ndUnsigned32((accel2 < accelFreeze2) && (alpha2 < accelFreeze2) && (speed2 < freezeSpeed2) && (omega2 < freezeSpeed2));
 
-			if (equilibriumTest)
+			if (freezeTest)
 			{
 				const ndFloat32 velocityDragCoeff = (count <= 1) ? D_FREEZZING_VELOCITY_DRAG : ndFloat32(0.9999f);
 				const ndVector velocDragVect(velocityDragCoeff, velocityDragCoeff, velocityDragCoeff, ndFloat32(0.0f));
@@ -429,7 +434,29 @@ void ndBodyDynamic::EvaluateSleepState(ndFloat32 freezeSpeed2, ndFloat32 freezeA
 				m_veloc = velocMask & veloc;
 				m_omega = omegaMask & omega;
 			}
-			equilibrium &= equilibriumTest;
+
+			// progressive sleep, a constrained body goes to sleep after staying within 
+			// the thresholds of a sleep table entry for that entry number of steps, 
+			// so the slower a pile is creeping the sooner it goes to sleep.
+			// free bodies only use the first entry, so that slow bodies keep drifting.
+			const ndWorld* const world = m_scene->GetWorld();
+			const ndInt32 entryCount = count ? D_SLEEP_ENTRIES : 1;
+			const ndFloat32 accelScale = (count <= 1) ? ndFloat32(0.01f) : ndFloat32(1.0f);
+			const ndFloat32 maxAccel2 = ndMax(accel2, alpha2);
+			const ndFloat32 maxSpeed2 = ndMax(speed2, omega2);
+
+			ndInt32 entry = 0;
+			for (; entry < entryCount; ++entry)
+			{
+				const ndWorld::dgSolverProgressiveSleepEntry& sleepEntry = world->m_sleepTable[entry];
+				if ((maxAccel2 < sleepEntry.m_maxAccel * accelScale) && (maxSpeed2 < sleepEntry.m_maxVeloc))
+				{
+					break;
+				}
+			}
+			m_sleepingCounter = (entry < entryCount) ? ndMin(m_sleepingCounter + 1, world->m_sleepTable[D_SLEEP_ENTRIES - 1].m_steps) : 0;
+			const ndUnsigned32 sleepTest = ndUnsigned32((entry < entryCount) && (m_sleepingCounter >= world->m_sleepTable[entry].m_steps));
+			equilibrium &= (freezeTest | sleepTest);
 		}
 		m_isJointFence0 = equilibrium;
 		if (equilibrium & ~m_isConstrained)
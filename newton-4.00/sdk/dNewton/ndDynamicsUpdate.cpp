@@ -33,6 +33,7 @@
 ndDynamicsUpdate::ndDynamicsUpdate(ndWorld* const world)
 	:m_velocTol(ndFloat32(1.0e-8f))
 	,m_islands(D_DEFAULT_BUFFER_SIZE)
+	,m_islandPassesUsed(D_DEFAULT_BUFFER_SIZE)
 	,m_jointForcesIndex(D_DEFAULT_BUFFER_SIZE)
 	,m_internalForces(D_DEFAULT_BUFFER_SIZE)
 	,m_leftHandSide(D_DEFAULT_BUFFER_SIZE * 4)
@@ -50,6 +51,9 @@ ndDynamicsUpdate::ndDynamicsUpdate(ndWorld* const world)
 	,m_solverPasses(0)
 	,m_activeJointCount(0)
 	,m_unConstrainedBodyCount(0)
+	,m_passesUsed(0)
+	,m_passesSolveCount(0)
+	,m_maxPassesUsed(0)
 {
 }
 
@@ -63,9 +67,40 @@ const char* ndDynamicsUpdate::GetStringId() const
 	return "default";
 }
 
+ndFloat32 ndDynamicsUpdate::GetAveragePassesUsed() const
+{
+	return m_passesSolveCount ? ndFloat32(m_passesUsed) / ndFloat32(m_passesSolveCount) : ndFloat32(0.0f);
+}
+
+ndInt32 ndDynamicsUpdate::GetMaxPassesUsed() const
+{
+	return m_maxPassesUsed;
+}
+
+const ndArray<ndInt32>& ndDynamicsUpdate::GetIslandPassesUsed() const
+{
+	return m_islandPassesUsed;
+}
+
+void ndDynamicsUpdate::ResetPassesStats()
+{
+	m_islandPassesUsed.SetCount(0);
+	m_passesUsed = 0;
+	m_passesSolveCount = 0;
+	m_maxPassesUsed = 0;
+}
+
+void ndDynamicsUpdate::AddPassesStats(ndInt32 passes)
+{
+	m_passesUsed += passes;
+	m_passesSolveCount++;
+	m_maxPassesUsed = ndMax(m_maxPassesUsed, passes);
+}
+
 void ndDynamicsUpdate::Clear()
 {
 	m_islands.Resize(D_DEFAULT_BUFFER_SIZE);
+	m_islandPassesUsed.Resize(D_DEFAULT_BUFFER_SIZE);
 	m_rightHandSide.Resize(D_DEFAULT_BUFFER_SIZE);
 	m_internalForces.Resize(D_DEFAULT_BUFFER_SIZE);
 	m_bodyIslandOrder.Resize(D_DEFAULT_BUFFER_SIZE);
@@ -603,6 +638,7 @@ void ndDynamicsUpdate::InitWeights()
 {
 	D_TRACKTIME();
 	ndScene* const scene = m_world->GetScene();
+	ResetPassesStats();
 	m_invTimestep = ndFloat32(1.0f) / m_timestep;
 	m_invStepRK = ndFloat32(0.25f);
 	m_timestepRK = m_timestep * m_invStepRK;
@@ -1175,7 +1211,9 @@ void ndDynamicsUpdate::InitSkeletons()
 	ndScene* const scene = m_world->GetScene();
 	const ndArray<ndSkeletonContainer*>& activeSkeletons = m_world->m_activeSkeletons;
 
-	auto InitSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
+	const bool parallelSkeletons = scene->GetThreadCount() > 1;
+
+	auto InitSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons, parallelSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
 	{
 		D_TRACKTIME_NAMED(InitSkeletons);
 		ndArray<ndRightHandSide>& rightHandSide = m_rightHandSide;
@@ -1184,13 +1222,28 @@ void ndDynamicsUpdate::InitSkeletons()
 		for (ndInt32 i = threadIndex; i < activeSkeletons.GetCount(); i += threadCount)
 		{
 			ndSkeletonContainer* const skeleton = activeSkeletons[i];
-			skeleton->InitMassMatrix(&leftHandSide[0], &rightHandSide[0]);
+			if (!(parallelSkeletons && skeleton->m_branches.GetCount()))
+			{
+				skeleton->InitMassMatrix(&leftHandSide[0], &rightHandSide[0]);
+			}
 		}
 	});
 
 	if (activeSkeletons.GetCount())
 	{
 		scene->ParallelExecute(InitSkeletons);
+		if (parallelSkeletons)
+		{
+			// large skeletons are split into branches, and all threads work on one at a time
+			for (ndInt32 i = 0; i < activeSkeletons.GetCount(); ++i)
+			{
+				ndSkeletonContainer* const skeleton = activeSkeletons[i];
+				if (skeleton->m_branches.GetCount())
+				{
+					skeleton->InitMassMatrix(*scene, &m_leftHandSide[0], &m_rightHandSide[0]);
+				}
+			}
+		}
 	}
 }
 
@@ -1200,146 +1253,230 @@ void ndDynamicsUpdate::UpdateSkeletons()
 	ndScene* const scene = m_world->GetScene();
 	const ndArray<ndSkeletonContainer*>& activeSkeletons = m_world->m_activeSkeletons;
 
-	auto UpdateSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
+	const bool parallelSkeletons = scene->GetThreadCount() > 1;
+
+	auto UpdateSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons, parallelSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
 	{
 		D_TRACKTIME_NAMED(UpdateSkeletons);
 		ndJacobian* const internalForces = &GetInternalForces()[0];
 		for (ndInt32 i = threadIndex; i < activeSkeletons.GetCount(); i += threadCount)
 		{
 			ndSkeletonContainer* const skeleton = activeSkeletons[i];
-			skeleton->CalculateReactionForces(internalForces);
+			if (!(parallelSkeletons && skeleton->m_branches.GetCount()))
+			{
+				skeleton->CalculateReactionForces(internalForces);
+			}
 		}
 	});
 
 	if (activeSkeletons.GetCount())
 	{
 		scene->ParallelExecute(UpdateSkeletons);
+		if (parallelSkeletons)
+		{
+			ndJacobian* const internalForces = &GetInternalForces()[0];
+			for (ndInt32 i = 0; i < activeSkeletons.GetCount(); ++i)
+			{
+				ndSkeletonContainer* const skeleton = activeSkeletons[i];
+				if (skeleton->m_branches.GetCount())
+				{
+					skeleton->CalculateReactionForces(*scene, internalForces);
+				}
+			}
+		}
 	}
 }
 
-void ndDynamicsUpdate::CalculateJointsForce()
+ndFloat32 ndDynamicsUpdate::CalculateJointForce(ndConstraint* const joint, ndInt32 jointIndex)
 {
-	D_TRACKTIME();
-	const ndUnsigned32 passes = m_solverPasses;
-	ndScene* const scene = m_world->GetScene();
-
-	ndArray<ndBodyKinematic*>& bodyArray = scene->GetActiveBodyArray();
-	ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+	// the jacobi solver scales the force updates by the body joint count
+	const ndVector preconditioner0(joint->GetBody0()->m_weigh);
+	const ndVector preconditioner1(joint->GetBody1()->m_weigh);
+	return CalculateJointForce(joint, jointIndex, preconditioner0, preconditioner1);
+}
 
-	auto CalculateJointsForce = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+ndFloat32 ndDynamicsUpdate::CalculateJointForce(ndConstraint* const joint, ndInt32 jointIndex, const ndVector& preconditioner0, const ndVector& preconditioner1)
+{
+	ndJacobian* const jointPartialForces = &GetTempInternalForces()[0];
+	const ndVector zero(ndVector::m_zero);
+	ndVector accNorm(zero);
+	ndBodyKinematic* const body0 = joint->GetBody0();
+	ndBodyKinematic* const body1 = joint->GetBody1();
+	ndAssert(body0);
+	ndAssert(body1);
+
+	const ndInt32 m0 = body0->m_index;
+	const ndInt32 m1 = body1->m_index;
+	const ndInt32 rowStart = joint->m_rowStart;
+	const ndInt32 rowsCount = joint->m_rowCount;
+
+	const ndInt32 resting = body0->m_equilibrium0 & body1->m_equilibrium0;
+	if (!resting)
 	{
-		D_TRACKTIME_NAMED(CalculateJointsForce);
-		const ndInt32 jointCount = jointArray.GetCount();
-		ndJacobian* const jointPartialForces = &GetTempInternalForces()[0];
+		ndVector forceM0(m_internalForces[m0].m_linear);
+		ndVector torqueM0(m_internalForces[m0].m_angular);
+		ndVector forceM1(m_internalForces[m1].m_linear);
+		ndVector torqueM1(m_internalForces[m1].m_angular);
 
-		auto JointForce = [this, &jointPartialForces](ndConstraint* const joint, ndInt32 jointIndex)
+		for (ndInt32 j = 0; j < rowsCount; ++j)
 		{
-			const ndVector zero(ndVector::m_zero);
-			ndVector accNorm(zero);
-			ndBodyKinematic* const body0 = joint->GetBody0();
-			ndBodyKinematic* const body1 = joint->GetBody1();
-			ndAssert(body0);
-			ndAssert(body1);
+			ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
+			const ndLeftHandSide* const lhs = &m_leftHandSide[rowStart + j];
+			const ndVector force(rhs->m_force);
+
+			ndVector a(lhs->m_JMinv.m_jacobianM0.m_linear * forceM0);
+			a = a.MulAdd(lhs->m_JMinv.m_jacobianM0.m_angular, torqueM0);
+			a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_linear, forceM1);
+			a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_angular, torqueM1);
+			a = ndVector(rhs->m_coordenateAccel - rhs->m_force * rhs->m_diagDamp) - a.AddHorizontal();
+
+			ndAssert(rhs->m_normalForceIndexFlat >= 0);
+			ndVector f(force + a.Scale(rhs->m_invJinvMJt));
+			const ndInt32 frictionIndex = rhs->m_normalForceIndexFlat;
+			const ndFloat32 frictionNormal = m_rightHandSide[frictionIndex].m_force;
+			const ndVector lowerFrictionForce(frictionNormal * rhs->m_lowerBoundFrictionCoefficent);
+			const ndVector upperFrictionForce(frictionNormal * rhs->m_upperBoundFrictionCoefficent);
+
+			a = a & (f < upperFrictionForce) & (f > lowerFrictionForce);
+			accNorm = accNorm.MulAdd(a, a);
+
+			f = f.GetMax(lowerFrictionForce).GetMin(upperFrictionForce);
+			rhs->m_force = f.GetScalar();
+
+			const ndVector deltaForce(f - force);
+			const ndVector deltaForce0(deltaForce * preconditioner0);
+			const ndVector deltaForce1(deltaForce * preconditioner1);
+			forceM0 = forceM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_linear, deltaForce0);
+			torqueM0 = torqueM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_angular, deltaForce0);
+			forceM1 = forceM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_linear, deltaForce1);
+			torqueM1 = torqueM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_angular, deltaForce1);
+		}
 
-			const ndInt32 m0 = body0->m_index;
-			const ndInt32 m1 = body1->m_index;
-			const ndInt32 rowStart = joint->m_rowStart;
-			const ndInt32 rowsCount = joint->m_rowCount;
+		const ndFloat32 tol = ndFloat32(0.125f);
+		const ndFloat32 tol2 = tol * tol;
 
-			const ndInt32 resting = body0->m_equilibrium0 & body1->m_equilibrium0;
-			if (!resting)
+		ndVector maxAccel(accNorm);
+		for (ndInt32 k = 0; (k < 4) && (maxAccel.GetScalar() > tol2); ++k)
+		{
+			maxAccel = zero;
+			for (ndInt32 j = 0; j < rowsCount; ++j)
 			{
-				const ndVector preconditioner0(body0->m_weigh);
-				const ndVector preconditioner1(body1->m_weigh);
+				ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
+				const ndLeftHandSide* const lhs = &m_leftHandSide[rowStart + j];
+				const ndVector force(rhs->m_force);
+
+				ndVector a(lhs->m_JMinv.m_jacobianM0.m_linear * forceM0);
+				a = a.MulAdd(lhs->m_JMinv.m_jacobianM0.m_angular, torqueM0);
+				a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_linear, forceM1);
+				a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_angular, torqueM1);
+				a = ndVector(rhs->m_coordenateAccel - rhs->m_force * rhs->m_diagDamp) - a.AddHorizontal();
+
+				ndVector f(force + a.Scale(rhs->m_invJinvMJt));
+				ndAssert(rhs->m_normalForceIndexFlat >= 0);
+				const ndInt32 frictionIndex = rhs->m_normalForceIndexFlat;
+				const ndFloat32 frictionNormal = m_rightHandSide[frictionIndex].m_force;
+
+				const ndVector lowerFrictionForce(frictionNormal * rhs->m_lowerBoundFrictionCoefficent);
+				const ndVector upperFrictionForce(frictionNormal * rhs->m_upperBoundFrictionCoefficent);
+
+				a = a & (f < upperFrictionForce) & (f > lowerFrictionForce);
+				maxAccel = maxAccel.MulAdd(a, a);
+
+				f = f.GetMax(lowerFrictionForce).GetMin(upperFrictionForce);
+				rhs->m_force = f.GetScalar();
+
+				const ndVector deltaForce(f - force);
+				const ndVector deltaForce0(deltaForce * preconditioner0);
+				const ndVector deltaForce1(deltaForce * preconditioner1);
+				forceM0 = forceM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_linear, deltaForce0);
+				torqueM0 = torqueM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_angular, deltaForce0);
+				forceM1 = forceM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_linear, deltaForce1);
+				torqueM1 = torqueM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_angular, deltaForce1);
+			}
+		}
+	}
 
-				ndVector forceM0(m_internalForces[m0].m_linear);
-				ndVector torqueM0(m_internalForces[m0].m_angular);
-				ndVector forceM1(m_internalForces[m1].m_linear);
-				ndVector torqueM1(m_internalForces[m1].m_angular);
+	ndVector forceM0(zero);
+	ndVector torqueM0(zero);
+	ndVector forceM1(zero);
+	ndVector torqueM1(zero);
 
-				for (ndInt32 j = 0; j < rowsCount; ++j)
-				{
-					ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
-					const ndLeftHandSide* const lhs = &m_leftHandSide[rowStart + j];
-					const ndVector force(rhs->m_force);
-
-					ndVector a(lhs->m_JMinv.m_jacobianM0.m_linear * forceM0);
-					a = a.MulAdd(lhs->m_JMinv.m_jacobianM0.m_angular, torqueM0);
-					a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_linear, forceM1);
-					a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_angular, torqueM1);
-					a = ndVector(rhs->m_coordenateAccel - rhs->m_force * rhs->m_diagDamp) - a.AddHorizontal();
-
-					ndAssert(rhs->m_normalForceIndexFlat >= 0);
-					ndVector f(force + a.Scale(rhs->m_invJinvMJt));
-					const ndInt32 frictionIndex = rhs->m_normalForceIndexFlat;
-					const ndFloat32 frictionNormal = m_rightHandSide[frictionIndex].m_force;
-					const ndVector lowerFrictionForce(frictionNormal * rhs->m_lowerBoundFrictionCoefficent);
-					const ndVector upperFrictionForce(frictionNormal * rhs->m_upperBoundFrictionCoefficent);
-
-					a = a & (f < upperFrictionForce) & (f > lowerFrictionForce);
-					accNorm = accNorm.MulAdd(a, a);
-
-					f = f.GetMax(lowerFrictionForce).GetMin(upperFrictionForce);
-					rhs->m_force = f.GetScalar();
-
-					const ndVector deltaForce(f - force);
-					const ndVector deltaForce0(deltaForce * preconditioner0);
-					const ndVector deltaForce1(deltaForce * preconditioner1);
-					forceM0 = forceM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_linear, deltaForce0);
-					torqueM0 = torqueM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_angular, deltaForce0);
-					forceM1 = forceM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_linear, deltaForce1);
-					torqueM1 = torqueM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_angular, deltaForce1);
-				}
+	for (ndInt32 j = 0; j < rowsCount; ++j)
+	{
+		ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
+		const ndLeftHandSide* const lhs = &m_leftHandSide[rowStart + j];
+
+		const ndVector f(rhs->m_force);
+		forceM0 = forceM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_linear, f);
+		torqueM0 = torqueM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_angular, f);
+		forceM1 = forceM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_linear, f);
+		torqueM1 = torqueM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_angular, f);
+		rhs->m_maxImpact = ndMax(ndAbs(f.GetScalar()), rhs->m_maxImpact);
+	}
 
-				const ndFloat32 tol = ndFloat32(0.125f);
-				const ndFloat32 tol2 = tol * tol;
+	const ndInt32 index0 = jointIndex * 2 + 0;
+	ndJacobian& outBody0 = jointPartialForces[index0];
+	outBody0.m_linear = forceM0;
+	outBody0.m_angular = torqueM0;
 
-				ndVector maxAccel(accNorm);
-				for (ndInt32 k = 0; (k < 4) && (maxAccel.GetScalar() > tol2); ++k)
-				{
-					maxAccel = zero;
-					for (ndInt32 j = 0; j < rowsCount; ++j)
-					{
-						ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
-						const ndLeftHandSide* const lhs = &m_leftHandSide[rowStart + j];
-						const ndVector force(rhs->m_force);
-
-						ndVector a(lhs->m_JMinv.m_jacobianM0.m_linear * forceM0);
-						a = a.MulAdd(lhs->m_JMinv.m_jacobianM0.m_angular, torqueM0);
-						a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_linear, forceM1);
-						a = a.MulAdd(lhs->m_JMinv.m_jacobianM1.m_angular, torqueM1);
-						a = ndVector(rhs->m_coordenateAccel - rhs->m_force * rhs->m_diagDamp) - a.AddHorizontal();
-
-						ndVector f(force + a.Scale(rhs->m_invJinvMJt));
-						ndAssert(rhs->m_normalForceIndexFlat >= 0);
-						const ndInt32 frictionIndex = rhs->m_normalForceIndexFlat;
-						const ndFloat32 frictionNormal = m_rightHandSide[frictionIndex].m_force;
-
-						const ndVector lowerFrictionForce(frictionNormal * rhs->m_lowerBoundFrictionCoefficent);
-						const ndVector upperFrictionForce(frictionNormal * rhs->m_upperBoundFrictionCoefficent);
-
-						a = a & (f < upperFrictionForce) & (f > lowerFrictionForce);
-						maxAccel = maxAccel.MulAdd(a, a);
-
-						f = f.GetMax(lowerFrictionForce).GetMin(upperFrictionForce);
-						rhs->m_force = f.GetScalar();
-
-						const ndVector deltaForce(f - force);
-						const ndVector deltaForce0(deltaForce * preconditioner0);
-						const ndVector deltaForce1(deltaForce * preconditioner1);
-						forceM0 = forceM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_linear, deltaForce0);
-						torqueM0 = torqueM0.MulAdd(lhs->m_Jt.m_jacobianM0.m_angular, deltaForce0);
-						forceM1 = forceM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_linear, deltaForce1);
-						torqueM1 = torqueM1.MulAdd(lhs->m_Jt.m_jacobianM1.m_angular, deltaForce1);
-					}
-				}
-			}
+	const ndInt32 index1 = jointIndex * 2 + 1;
+	ndJacobian& outBody1 = jointPartialForces[index1];
+	outBody1.m_linear = forceM1;
+	outBody1.m_angular = torqueM1;
+
+	// the residual of the first sweep, measured against the body forces of the 
+	// previous pass, so it tells how far the island is from converging. 
+	// the inner sweeps only refine this joint. resting joints are already converged.
+	return accNorm.GetScalar();
+}
+
+void ndDynamicsUpdate::AccumulateBodyForce(ndInt32 bodyIndex)
+{
+	const ndVector zero(ndVector::m_zero);
+	ndJacobian* const internalForces = &GetInternalForces()[0];
+	const ndInt32* const bodyJointIndex = &GetJointForceIndexBuffer()[0];
+	const ndJacobian* const jointInternalForces = &GetTempInternalForces()[0];
+	const ndJointBodyPairIndex* const jointBodyPairIndexBuffer = &GetJointBodyPairIndexBuffer()[0];
+	const ndBodyKinematic* const body = m_world->GetScene()->GetActiveBodyArray()[bodyIndex];
+
+	ndVector force(zero);
+	ndVector torque(zero);
+	const ndInt32 startIndex = bodyJointIndex[bodyIndex];
+	const ndInt32 mask = body->m_isStatic - 1;
+	const ndInt32 count = mask & (bodyJointIndex[bodyIndex + 1] - startIndex);
+	for (ndInt32 j = 0; j < count; ++j)
+	{
+		const ndInt32 index = jointBodyPairIndexBuffer[startIndex + j].m_joint;
+		force += jointInternalForces[index].m_linear;
+		torque += jointInternalForces[index].m_angular;
+	}
+	internalForces[bodyIndex].m_linear = force;
+	internalForces[bodyIndex].m_angular = torque;
+}
+
+void ndDynamicsUpdate::AccumulateJointForces()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndBodyKinematic*>& bodyArray = scene->GetActiveBodyArray();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+
+	auto CalculateJointPartialForces = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateJointPartialForces);
+		const ndVector zero(ndVector::m_zero);
+		ndJacobian* const jointPartialForces = &GetTempInternalForces()[0];
+		const ndStartEnd startEnd(jointArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndConstraint* const joint = jointArray[i];
+			const ndInt32 rowStart = joint->m_rowStart;
+			const ndInt32 rowsCount = joint->m_rowCount;
 
 			ndVector forceM0(zero);
 			ndVector torqueM0(zero);
 			ndVector forceM1(zero);
 			ndVector torqueM1(zero);
-
 			for (ndInt32 j = 0; j < rowsCount; ++j)
 			{
 				ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
@@ -1353,53 +1490,57 @@ void ndDynamicsUpdate::CalculateJointsForce()
 				rhs->m_maxImpact = ndMax(ndAbs(f.GetScalar()), rhs->m_maxImpact);
 			}
 
-			const ndInt32 index0 = jointIndex * 2 + 0;
-			ndJacobian& outBody0 = jointPartialForces[index0];
+			ndJacobian& outBody0 = jointPartialForces[i * 2 + 0];
 			outBody0.m_linear = forceM0;
 			outBody0.m_angular = torqueM0;
 
-			const ndInt32 index1 = jointIndex * 2 + 1;
-			ndJacobian& outBody1 = jointPartialForces[index1];
+			ndJacobian& outBody1 = jointPartialForces[i * 2 + 1];
 			outBody1.m_linear = forceM1;
 			outBody1.m_angular = torqueM1;
-		};
+		}
+	});
 
+	auto AccumulatePartialForces = ndMakeObject::ndFunction([this, &bodyArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(AccumulatePartialForces);
+		const ndStartEnd startEnd(bodyArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			AccumulateBodyForce(i);
+		}
+	});
+
+	scene->ParallelExecute(CalculateJointPartialForces);
+	scene->ParallelExecute(AccumulatePartialForces);
+}
+
+void ndDynamicsUpdate::CalculateJointsForce()
+{
+	D_TRACKTIME();
+	const ndUnsigned32 passes = m_solverPasses;
+	ndScene* const scene = m_world->GetScene();
+
+	ndArray<ndBodyKinematic*>& bodyArray = scene->GetActiveBodyArray();
+	ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+
+	auto CalculateJointsForce = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateJointsForce);
+		const ndInt32 jointCount = jointArray.GetCount();
 		for (ndInt32 i = threadIndex; i < jointCount; i += threadCount)
 		{
 			ndConstraint* const joint = jointArray[i];
-			JointForce(joint, i);
+			CalculateJointForce(joint, i);
 		}
 	});
 
 	auto ApplyJacobianAccumulatePartialForces = ndMakeObject::ndFunction([this, &bodyArray](ndInt32 threadIndex, ndInt32 threadCount)
 	{
 		D_TRACKTIME_NAMED(ApplyJacobianAccumulatePartialForces);
-		const ndVector zero(ndVector::m_zero);
-
-		ndJacobian* const internalForces = &GetInternalForces()[0];
-		const ndInt32* const bodyIndex = &GetJointForceIndexBuffer()[0];
-
-		const ndJacobian* const jointInternalForces = &GetTempInternalForces()[0];
-		const ndJointBodyPairIndex* const jointBodyPairIndexBuffer = &GetJointBodyPairIndexBuffer()[0];
-
 		const ndStartEnd startEnd(bodyArray.GetCount(), threadIndex, threadCount);
 		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndVector force(zero);
-			ndVector torque(zero);
-			const ndBodyKinematic* const body = bodyArray[i];
-
-			const ndInt32 startIndex = bodyIndex[i];
-			const ndInt32 mask = body->m_isStatic - 1;
-			const ndInt32 count = mask & (bodyIndex[i + 1] - startIndex);
-			for (ndInt32 j = 0; j < count; ++j)
-			{
-				const ndInt32 index = jointBodyPairIndexBuffer[startIndex + j].m_joint;
-				force += jointInternalForces[index].m_linear;
-				torque += jointInternalForces[index].m_angular;
-			}
-			internalForces[i].m_linear = force;
-			internalForces[i].m_angular = torque;
+			AccumulateBodyForce(i);
 		}
 	});
 
@@ -1408,6 +1549,7 @@ void ndDynamicsUpdate::CalculateJointsForce()
 		scene->ParallelExecute(CalculateJointsForce);
 		scene->ParallelExecute(ApplyJacobianAccumulatePartialForces);
 	}
+	AddPassesStats(ndInt32(passes));
 }
 
 void ndDynamicsUpdate::CalculateForces()
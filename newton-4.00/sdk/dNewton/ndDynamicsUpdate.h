@@ -80,6 +80,15 @@ class ndDynamicsUpdate : public ndClassAlloc
 	virtual const char* GetStringId() const;
 	ndInt32 GetUnconstrainedBodyCount() const;
 
+	// solver passes used in the last step, averaged over all the 
+	// islands and velocity steps, and the most used by a single solve.
+	ndFloat32 GetAveragePassesUsed() const;
+	ndInt32 GetMaxPassesUsed() const;
+
+	// passes used by each island in the last step, the most of all the velocity 
+	// steps, in solve order. Only the solvers that solve islands independently fill it.
+	const ndArray<ndInt32>& GetIslandPassesUsed() const;
+
 	ndVector GetVelocTol() const;
 	ndFloat32 GetTimestepRK() const;
 	ndArray<ndIsland>& GetIslands();
@@ -91,7 +100,7 @@ class ndDynamicsUpdate : public ndClassAlloc
 	ndArray<ndBodyKinematic*>& GetBodyIslandOrder();
 	ndArray<ndJointBodyPairIndex>& GetJointBodyPairIndexBuffer();
 
-	private:
+	protected:
 	void SortJoints();
 	void SortIslands();
 	void BuildIsland();
@@ -103,23 +112,29 @@ class ndDynamicsUpdate : public ndClassAlloc
 	void UpdateSkeletons();
 	void InitJacobianMatrix();
 	void UpdateForceFeedback();
-	void CalculateJointsForce();
 	void IntegrateBodiesVelocity();
 	void CalculateJointsAcceleration();
 	void IntegrateUnconstrainedBodies();
+	void AccumulateJointForces();
+	void AccumulateBodyForce(ndInt32 bodyIndex);
+	ndFloat32 CalculateJointForce(ndConstraint* const joint, ndInt32 jointIndex);
+	ndFloat32 CalculateJointForce(ndConstraint* const joint, ndInt32 jointIndex, const ndVector& preconditioner0, const ndVector& preconditioner1);
+	void AddPassesStats(ndInt32 passes);
+	void ResetPassesStats();
 
 	void DetermineSleepStates();
 	void GetJacobianDerivatives(ndConstraint* const joint);
 
-	protected:
 	void Clear();
 	virtual void Update();
+	virtual void CalculateJointsForce();
 	void SortJointsScan();
 	void SortBodyJointScan();
 	ndBodyKinematic* FindRootAndSplit(ndBodyKinematic* const body);
 
 	ndVector m_velocTol;
 	ndArray<ndIsland> m_islands;
+	ndArray<ndInt32> m_islandPassesUsed;
 	ndArray<ndInt32> m_jointForcesIndex;
 	ndArray<ndJacobian> m_internalForces;
 	ndArray<ndLeftHandSide> m_leftHandSide;
@@ -138,6 +153,9 @@ class ndDynamicsUpdate : public ndClassAlloc
 	ndUnsigned32 m_solverPasses;
 	ndInt32 m_activeJointCount;
 	ndInt32 m_unConstrainedBodyCount;
+	ndInt32 m_passesUsed;
+	ndInt32 m_passesSolveCount;
+	ndInt32 m_maxPassesUsed;
 
 	friend class ndWorld;
 	friend class ndSkeletonContainer;
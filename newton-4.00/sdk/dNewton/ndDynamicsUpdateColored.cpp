@@ -0,0 +1,259 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndCoreStdafx.h"
+#include "ndNewtonStdafx.h"
+#include "ndWorld.h"
+#include "ndBodyDynamic.h"
+#include "ndDynamicsUpdateColored.h"
+
+ndDynamicsUpdateColored::ndDynamicsUpdateColored(ndWorld* const world)
+	:ndDynamicsUpdate(world)
+	,m_colorStart(D_MAX_JOINT_COLORS + 2)
+	,m_colorJoints(256)
+	,m_bodyColors(256)
+	,m_colorCount(0)
+{
+}
+
+ndDynamicsUpdateColored::~ndDynamicsUpdateColored()
+{
+}
+
+const char* ndDynamicsUpdateColored::GetStringId() const
+{
+	return "colored gauss seidel";
+}
+
+void ndDynamicsUpdateColored::ColorJoints()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+	const ndInt32 jointCount = jointArray.GetCount();
+
+	m_bodyColors.SetCount(scene->GetActiveBodyArray().GetCount());
+	for (ndInt32 i = 0; i < m_bodyColors.GetCount(); ++i)
+	{
+		m_bodyColors[i] = 0;
+	}
+
+	// greedy coloring, each joint takes the first color not used by any of its dynamic bodies.
+	// static bodies are never written by the solver so they do not constrain the coloring.
+	ndInt32 histogram[D_MAX_JOINT_COLORS + 1];
+	for (ndInt32 i = 0; i <= D_MAX_JOINT_COLORS; ++i)
+	{
+		histogram[i] = 0;
+	}
+
+	ndStack<ndInt8> jointColors(jointCount);
+	m_colorCount = 0;
+	for (ndInt32 i = 0; i < jointCount; ++i)
+	{
+		const ndConstraint* const joint = jointArray[i];
+		const ndBodyKinematic* const body0 = joint->GetBody0();
+		const ndBodyKinematic* const body1 = joint->GetBody1();
+		const ndUnsigned64 used0 = body0->m_isStatic ? 0 : m_bodyColors[body0->m_index];
+		const ndUnsigned64 used1 = body1->m_isStatic ? 0 : m_bodyColors[body1->m_index];
+		const ndUnsigned64 used = used0 | used1;
+
+		ndInt32 color = 0;
+		for (; (color < D_MAX_JOINT_COLORS) && (used & (ndUnsigned64(1) << color)); ++color);
+		if (color < D_MAX_JOINT_COLORS)
+		{
+			const ndUnsigned64 bit = ndUnsigned64(1) << color;
+			if (!body0->m_isStatic)
+			{
+				m_bodyColors[body0->m_index] |= bit;
+			}
+			if (!body1->m_isStatic)
+			{
+				m_bodyColors[body1->m_index] |= bit;
+			}
+			m_colorCount = ndMax(m_colorCount, color + 1);
+		}
+		jointColors[i] = ndInt8(color);
+		histogram[color]++;
+	}
+
+	// the overflow group goes right after the last used color
+	histogram[m_colorCount] = histogram[D_MAX_JOINT_COLORS];
+	m_colorStart.SetCount(m_colorCount + 2);
+	ndInt32 sum = 0;
+	for (ndInt32 i = 0; i <= m_colorCount; ++i)
+	{
+		m_colorStart[i] = sum;
+		sum += histogram[i];
+	}
+	m_colorStart[m_colorCount + 1] = sum;
+	ndAssert(sum == jointCount);
+
+	ndInt32 offsets[D_MAX_JOINT_COLORS + 1];
+	for (ndInt32 i = 0; i <= m_colorCount; ++i)
+	{
+		offsets[i] = m_colorStart[i];
+	}
+	m_colorJoints.SetCount(jointCount);
+	for (ndInt32 i = 0; i < jointCount; ++i)
+	{
+		const ndInt32 color = ndMin(ndInt32(jointColors[i]), m_colorCount);
+		m_colorJoints[offsets[color]] = i;
+		offsets[color]++;
+	}
+}
+
+void ndDynamicsUpdateColored::InitGaussSeidel()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+
+	// the jacobi solver scales the diagonal by the body joint count, 
+	// the forces are now applied in place so the plain diagonal is used instead.
+	auto InitDiagonals = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(InitDiagonals);
+		const ndStartEnd startEnd(jointArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndConstraint* const joint = jointArray[i];
+			const ndInt32 index = joint->m_rowStart;
+			const ndInt32 count = joint->m_rowCount;
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				const ndLeftHandSide* const row = &m_leftHandSide[index + j];
+				ndRightHandSide* const rhs = &m_rightHandSide[index + j];
+
+				const ndJacobian& JMinvM0 = row->m_JMinv.m_jacobianM0;
+				const ndJacobian& JMinvM1 = row->m_JMinv.m_jacobianM1;
+				const ndJacobian& JtM0 = row->m_Jt.m_jacobianM0;
+				const ndJacobian& JtM1 = row->m_Jt.m_jacobianM1;
+				const ndVector tmpDiag(
+					JMinvM0.m_linear * JtM0.m_linear + JMinvM0.m_angular * JtM0.m_angular +
+					JMinvM1.m_linear * JtM1.m_linear + JMinvM1.m_angular * JtM1.m_angular);
+
+				ndFloat32 diag = tmpDiag.AddHorizontal().GetScalar();
+				ndAssert(diag > ndFloat32(0.0f));
+				rhs->m_diagDamp = diag * rhs->m_diagonalRegularizer;
+
+				diag *= (ndFloat32(1.0f) + rhs->m_diagonalRegularizer);
+				rhs->m_invJinvMJt = ndFloat32(1.0f) / diag;
+			}
+		}
+	});
+
+	if (jointArray.GetCount())
+	{
+		scene->ParallelExecute(InitDiagonals);
+		ColorJoints();
+
+		// gauss seidel propagates forces across the island in one sweep, 
+		// it does not need the extra passes the jacobi solver adds for the joint valence.
+		m_solverPasses = ndUnsigned32(m_world->GetSolverIterations() + 1);
+	}
+}
+
+void ndDynamicsUpdateColored::CalculateJointsForce()
+{
+	D_TRACKTIME();
+	const ndUnsigned32 passes = m_solverPasses;
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+
+	// the skeletons may have changed the body forces after the last sub step, 
+	// start from the forces and the joint partial forces of the current solution.
+	AccumulateJointForces();
+
+	auto JointForce = [this, &jointArray](ndInt32 jointIndex)
+	{
+		ndConstraint* const joint = jointArray[jointIndex];
+		ndJacobian* const jointPartialForces = &GetTempInternalForces()[0];
+		const ndJacobian partial0(jointPartialForces[jointIndex * 2 + 0]);
+		const ndJacobian partial1(jointPartialForces[jointIndex * 2 + 1]);
+
+		// the forces are applied in place, the updates are not scaled by the joint count.
+		const ndVector one(ndVector::m_one);
+		CalculateJointForce(joint, jointIndex, one, one);
+
+		// replace the old joint contribution with the new one, no other joint 
+		// of this color touches these bodies, the static ones are never written.
+		const ndBodyKinematic* const body0 = joint->GetBody0();
+		const ndBodyKinematic* const body1 = joint->GetBody1();
+		if (!body0->m_isStatic)
+		{
+			const ndInt32 m0 = body0->m_index;
+			m_internalForces[m0].m_linear += jointPartialForces[jointIndex * 2 + 0].m_linear - partial0.m_linear;
+			m_internalForces[m0].m_angular += jointPartialForces[jointIndex * 2 + 0].m_angular - partial0.m_angular;
+		}
+		if (!body1->m_isStatic)
+		{
+			const ndInt32 m1 = body1->m_index;
+			m_internalForces[m1].m_linear += jointPartialForces[jointIndex * 2 + 1].m_linear - partial1.m_linear;
+			m_internalForces[m1].m_angular += jointPartialForces[jointIndex * 2 + 1].m_angular - partial1.m_angular;
+		}
+	};
+
+	ndInt32 color = 0;
+	auto CalculateColorJointsForce = ndMakeObject::ndFunction([this, &color, &JointForce](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateColorJointsForce);
+		const ndInt32 start = m_colorStart[color];
+		const ndStartEnd startEnd(m_colorStart[color + 1] - start, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			JointForce(m_colorJoints[start + i]);
+		}
+	});
+
+	for (ndInt32 i = 0; i < ndInt32(passes); ++i)
+	{
+		for (color = 0; color < m_colorCount; ++color)
+		{
+			scene->ParallelExecute(CalculateColorJointsForce);
+		}
+
+		for (ndInt32 j = m_colorStart[m_colorCount]; j < m_colorStart[m_colorCount + 1]; ++j)
+		{
+			JointForce(m_colorJoints[j]);
+		}
+	}
+
+	// resync the body forces with the final joint forces and update the joint impacts.
+	AccumulateJointForces();
+	AddPassesStats(ndInt32(passes));
+}
+
+void ndDynamicsUpdateColored::Update()
+{
+	D_TRACKTIME();
+	m_timestep = m_world->GetScene()->GetTimestep();
+
+	BuildIsland();
+	IntegrateUnconstrainedBodies();
+	InitWeights();
+	InitBodyArray();
+	InitJacobianMatrix();
+	InitGaussSeidel();
+	CalculateForces();
+	IntegrateBodies();
+	DetermineSleepStates();
+}
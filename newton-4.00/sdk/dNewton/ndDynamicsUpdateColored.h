@@ -0,0 +1,66 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef __ND_WORLD_DYNAMICS_UPDATE_COLORED_H__
+#define __ND_WORLD_DYNAMICS_UPDATE_COLORED_H__
+
+#include "ndNewtonStdafx.h"
+#include "ndDynamicsUpdate.h"
+
+#define D_MAX_JOINT_COLORS	64
+
+// Gauss Seidel variant of the scalar solver.
+// The joint graph is colored so that no two joints of the same color share a dynamic body.
+// The joints of one color are solved in parallel, writing the body forces in place, 
+// so each color sees the updates of all the colors before it.
+// Joints that can not be colored with D_MAX_JOINT_COLORS colors go to an overflow group
+// that is solved serially after the last color.
+D_MSV_NEWTON_ALIGN_32
+class ndDynamicsUpdateColored: public ndDynamicsUpdate
+{
+	public:
+	ndDynamicsUpdateColored(ndWorld* const world);
+	virtual ~ndDynamicsUpdateColored();
+
+	virtual const char* GetStringId() const;
+	ndInt32 GetColorCount() const;
+
+	protected:
+	virtual void Update();
+	virtual void CalculateJointsForce();
+
+	private:
+	void ColorJoints();
+	void InitGaussSeidel();
+
+	ndArray<ndInt32> m_colorStart;
+	ndArray<ndInt32> m_colorJoints;
+	ndArray<ndUnsigned64> m_bodyColors;
+	ndInt32 m_colorCount;
+} D_GCC_NEWTON_ALIGN_32;
+
+inline ndInt32 ndDynamicsUpdateColored::GetColorCount() const
+{
+	return m_colorCount;
+}
+
+#endif
@@ -0,0 +1,351 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndCoreStdafx.h"
+#include "ndNewtonStdafx.h"
+#include "ndWorld.h"
+#include "ndBodyDynamic.h"
+#include "ndDynamicsUpdateIsland.h"
+
+ndDynamicsUpdateIsland::ndDynamicsUpdateIsland(ndWorld* const world)
+	:ndDynamicsUpdate(world)
+	,m_bodyIsland(256)
+	,m_islandJoints(256)
+	,m_islandBodies(256)
+	,m_islandJointStart(256)
+	,m_islandPasses(256)
+	,m_largeIslandCount(0)
+{
+}
+
+ndDynamicsUpdateIsland::~ndDynamicsUpdateIsland()
+{
+}
+
+const char* ndDynamicsUpdateIsland::GetStringId() const
+{
+	return "island parallel";
+}
+
+void ndDynamicsUpdateIsland::BuildIslands()
+{
+	D_TRACKTIME();
+	class ndIslandInfo
+	{
+		public:
+		ndBodyKinematic* m_root;
+		ndInt32 m_index;
+		ndInt32 m_jointCount;
+		ndInt32 m_bodyCount;
+	};
+
+	class ndCompareIslands
+	{
+		public:
+		ndInt32 Compare(const ndIslandInfo& islandA, const ndIslandInfo& islandB, void* const) const
+		{
+			if (islandA.m_jointCount > islandB.m_jointCount)
+			{
+				return -1;
+			}
+			if (islandA.m_jointCount < islandB.m_jointCount)
+			{
+				return 1;
+			}
+			return islandA.m_index - islandB.m_index;
+		}
+	};
+
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndBodyKinematic*>& bodyArray = scene->GetActiveBodyArray();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+	const ndInt32 bodyCount = bodyArray.GetCount();
+	const ndInt32 jointCount = jointArray.GetCount();
+
+	m_islands.SetCount(0);
+	m_largeIslandCount = 0;
+	m_islandJointStart.SetCount(1);
+	m_islandJointStart[0] = 0;
+	if (!jointCount)
+	{
+		return;
+	}
+
+	// union find of the dynamic bodies, static bodies do not connect islands.
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		ndBodyKinematic* const body = bodyArray[i];
+		body->m_islandParent = body;
+	}
+	for (ndInt32 i = 0; i < jointCount; ++i)
+	{
+		const ndConstraint* const joint = jointArray[i];
+		ndBodyKinematic* const body0 = joint->GetBody0();
+		ndBodyKinematic* const body1 = joint->GetBody1();
+		if (!(body0->m_isStatic | body1->m_isStatic))
+		{
+			ndBodyKinematic* const root0 = FindRootAndSplit(body0);
+			ndBodyKinematic* const root1 = FindRootAndSplit(body1);
+			if (root0 != root1)
+			{
+				root0->m_islandParent = root1;
+			}
+		}
+	}
+
+	// enumerate the islands in joint order so that the result is deterministic
+	m_bodyIsland.SetCount(bodyCount);
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		m_bodyIsland[i] = -1;
+	}
+
+	ndInt32 islandCount = 0;
+	ndStack<ndInt32> jointIsland(jointCount);
+	ndStack<ndIslandInfo> islandInfo(jointCount);
+	for (ndInt32 i = 0; i < jointCount; ++i)
+	{
+		const ndConstraint* const joint = jointArray[i];
+		ndBodyKinematic* const body0 = joint->GetBody0();
+		ndBodyKinematic* const body1 = joint->GetBody1();
+		ndBodyKinematic* const body = body0->m_isStatic ? body1 : body0;
+
+		ndInt32 index = -1;
+		if (!body->m_isStatic)
+		{
+			ndBodyKinematic* const root = FindRootAndSplit(body);
+			index = m_bodyIsland[root->m_index];
+			if (index == -1)
+			{
+				index = islandCount;
+				m_bodyIsland[root->m_index] = index;
+			}
+		}
+		if (index == -1 || index == islandCount)
+		{
+			// joints between two static bodies are islands of their own, with no bodies.
+			index = islandCount;
+			ndIslandInfo& info = islandInfo[islandCount];
+			info.m_root = body;
+			info.m_index = islandCount;
+			info.m_jointCount = 0;
+			info.m_bodyCount = 0;
+			islandCount++;
+		}
+		jointIsland[i] = index;
+		islandInfo[index].m_jointCount++;
+	}
+
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		ndBodyKinematic* const body = bodyArray[i];
+		if (!body->m_isStatic)
+		{
+			ndBodyKinematic* const root = FindRootAndSplit(body);
+			const ndInt32 index = m_bodyIsland[root->m_index];
+			m_bodyIsland[i] = index;
+			if (index >= 0)
+			{
+				islandInfo[index].m_bodyCount++;
+			}
+		}
+	}
+
+	// largest islands first, so the queue is processed longest job first.
+	ndSort<ndIslandInfo, ndCompareIslands>(&islandInfo[0], islandCount, nullptr);
+
+	ndStack<ndInt32> remap(islandCount);
+	m_islands.SetCount(islandCount);
+	m_islandJointStart.SetCount(islandCount + 1);
+
+	ndInt32 bodyStart = 0;
+	ndInt32 jointStart = 0;
+	for (ndInt32 i = 0; i < islandCount; ++i)
+	{
+		const ndIslandInfo& info = islandInfo[i];
+		remap[info.m_index] = i;
+		ndIsland& island = m_islands[i];
+		island.m_root = info.m_root;
+		island.m_start = bodyStart;
+		island.m_count = 0;
+		m_islandJointStart[i] = jointStart;
+		bodyStart += info.m_bodyCount;
+		jointStart += info.m_jointCount;
+	}
+	m_islandJointStart[islandCount] = jointStart;
+
+	ndStack<ndInt32> jointOffset(islandCount);
+	for (ndInt32 i = 0; i < islandCount; ++i)
+	{
+		jointOffset[i] = m_islandJointStart[i];
+	}
+	m_islandJoints.SetCount(jointCount);
+	for (ndInt32 i = 0; i < jointCount; ++i)
+	{
+		const ndInt32 index = remap[jointIsland[i]];
+		m_islandJoints[jointOffset[index]] = i;
+		jointOffset[index]++;
+	}
+
+	m_islandBodies.SetCount(bodyStart);
+	for (ndInt32 i = 0; i < bodyCount; ++i)
+	{
+		if (m_bodyIsland[i] >= 0)
+		{
+			ndIsland& island = m_islands[remap[m_bodyIsland[i]]];
+			m_islandBodies[island.m_start + island.m_count] = i;
+			island.m_count++;
+		}
+	}
+
+	// an island is split across threads only if it holds more than a thread share of the joints.
+	const ndInt32 threadCount = scene->GetThreadCount();
+	const ndInt32 splitJointCount = ndMax(D_ISLAND_SPLIT_JOINT_COUNT, jointCount / threadCount);
+	for (; (m_largeIslandCount < islandCount) && (islandInfo[m_largeIslandCount].m_jointCount > splitJointCount); ++m_largeIslandCount);
+}
+
+void ndDynamicsUpdateIsland::CalculateJointsForce()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+
+	// with a tolerance, islands stop as soon as the largest joint residual is 
+	// below it, and the ones above it can take up to twice the nominal passes.
+	const ndFloat32 tolerance = m_world->GetSolverTolerance();
+	const ndFloat32 tolerance2 = tolerance * tolerance;
+	const bool adaptive = tolerance > ndFloat32(0.0f);
+	const ndInt32 passes = ndInt32(m_solverPasses);
+	const ndInt32 maxPasses = adaptive ? passes * D_ISLAND_MAX_PASSES_FACTOR : passes;
+
+	const ndInt32 islandCount = m_islands.GetCount();
+	const ndInt32 largeJointCount = m_islandJointStart[m_largeIslandCount];
+	const ndInt32 largeBodyCount = m_largeIslandCount ? m_islands[m_largeIslandCount - 1].m_start + m_islands[m_largeIslandCount - 1].m_count : 0;
+	m_islandPasses.SetCount(islandCount);
+	if (m_islandPassesUsed.GetCount() != islandCount)
+	{
+		m_islandPassesUsed.SetCount(islandCount);
+		ndMemSet(&m_islandPassesUsed[0], 0, islandCount);
+	}
+
+	ndAtomic<ndInt32> islandIndex(m_largeIslandCount);
+	auto CalculateIslandsForce = ndMakeObject::ndFunction([this, &jointArray, &islandIndex, islandCount, maxPasses, tolerance2, adaptive](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(CalculateIslandsForce);
+		for (ndInt32 i = islandIndex.fetch_add(1); i < islandCount; i = islandIndex.fetch_add(1))
+		{
+			const ndIsland& island = m_islands[i];
+			const ndInt32 jointStart = m_islandJointStart[i];
+			const ndInt32 jointEnd = m_islandJointStart[i + 1];
+
+			ndInt32 pass = 0;
+			ndFloat32 residual = ndFloat32(1.0e10f);
+			for (; (pass < maxPasses) && (!adaptive || (residual > tolerance2)); ++pass)
+			{
+				residual = ndFloat32(0.0f);
+				for (ndInt32 j = jointStart; j < jointEnd; ++j)
+				{
+					const ndInt32 jointIndex = m_islandJoints[j];
+					residual = ndMax(residual, CalculateJointForce(jointArray[jointIndex], jointIndex));
+				}
+				for (ndInt32 j = 0; j < island.m_count; ++j)
+				{
+					AccumulateBodyForce(m_islandBodies[island.m_start + j]);
+				}
+			}
+			m_islandPasses[i] = pass;
+		}
+	});
+
+	ndFloat32 residualArray[D_MAX_THREADS_COUNT];
+	auto CalculateLargeIslandsJointsForce = ndMakeObject::ndFunction([this, &jointArray, &residualArray, largeJointCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateLargeIslandsJointsForce);
+		ndFloat32 residual = ndFloat32(0.0f);
+		for (ndInt32 i = threadIndex; i < largeJointCount; i += threadCount)
+		{
+			const ndInt32 jointIndex = m_islandJoints[i];
+			residual = ndMax(residual, CalculateJointForce(jointArray[jointIndex], jointIndex));
+		}
+		residualArray[threadIndex] = residual;
+	});
+
+	auto AccumulateLargeIslandsForce = ndMakeObject::ndFunction([this, largeBodyCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(AccumulateLargeIslandsForce);
+		const ndStartEnd startEnd(largeBodyCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			AccumulateBodyForce(m_islandBodies[i]);
+		}
+	});
+
+	if (islandCount > m_largeIslandCount)
+	{
+		scene->ParallelExecute(CalculateIslandsForce);
+	}
+
+	if (m_largeIslandCount)
+	{
+		// the large islands are solved together, so they share the passes count
+		ndInt32 pass = 0;
+		ndFloat32 residual = ndFloat32(1.0e10f);
+		const ndInt32 threadCount = scene->GetThreadCount();
+		for (; (pass < maxPasses) && (!adaptive || (residual > tolerance2)); ++pass)
+		{
+			scene->ParallelExecute(CalculateLargeIslandsJointsForce);
+			scene->ParallelExecute(AccumulateLargeIslandsForce);
+
+			residual = ndFloat32(0.0f);
+			for (ndInt32 i = 0; i < threadCount; ++i)
+			{
+				residual = ndMax(residual, residualArray[i]);
+			}
+		}
+		for (ndInt32 i = 0; i < m_largeIslandCount; ++i)
+		{
+			m_islandPasses[i] = pass;
+		}
+	}
+
+	for (ndInt32 i = 0; i < islandCount; ++i)
+	{
+		AddPassesStats(m_islandPasses[i]);
+		m_islandPassesUsed[i] = ndMax(m_islandPassesUsed[i], m_islandPasses[i]);
+	}
+}
+
+void ndDynamicsUpdateIsland::Update()
+{
+	D_TRACKTIME();
+	m_timestep = m_world->GetScene()->GetTimestep();
+
+	BuildIsland();
+	BuildIslands();
+	IntegrateUnconstrainedBodies();
+	InitWeights();
+	InitBodyArray();
+	InitJacobianMatrix();
+	CalculateForces();
+	IntegrateBodies();
+	DetermineSleepStates();
+}
@@ -0,0 +1,68 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef __ND_WORLD_DYNAMICS_UPDATE_ISLAND_H__
+#define __ND_WORLD_DYNAMICS_UPDATE_ISLAND_H__
+
+#include "ndNewtonStdafx.h"
+#include "ndDynamicsUpdate.h"
+
+#define D_ISLAND_SPLIT_JOINT_COUNT	256
+#define D_ISLAND_MAX_PASSES_FACTOR	2
+
+// Variant of the scalar solver that schedules the joint solve by island.
+// Islands are sorted by size, the small ones are taken from the queue by 
+// the workers and solved whole by a single thread for all the solver passes, 
+// only the islands too large for one thread are split by joint across all threads.
+// When the world solver tolerance is not zero, each island runs only the passes 
+// it needs to bring its joint residual below the tolerance.
+D_MSV_NEWTON_ALIGN_32
+class ndDynamicsUpdateIsland: public ndDynamicsUpdate
+{
+	public:
+	ndDynamicsUpdateIsland(ndWorld* const world);
+	virtual ~ndDynamicsUpdateIsland();
+
+	virtual const char* GetStringId() const;
+	ndInt32 GetLargeIslandCount() const;
+
+	protected:
+	virtual void Update();
+	virtual void CalculateJointsForce();
+
+	private:
+	void BuildIslands();
+
+	ndArray<ndInt32> m_bodyIsland;
+	ndArray<ndInt32> m_islandJoints;
+	ndArray<ndInt32> m_islandBodies;
+	ndArray<ndInt32> m_islandJointStart;
+	ndArray<ndInt32> m_islandPasses;
+	ndInt32 m_largeIslandCount;
+} D_GCC_NEWTON_ALIGN_32;
+
+inline ndInt32 ndDynamicsUpdateIsland::GetLargeIslandCount() const
+{
+	return m_largeIslandCount;
+}
+
+#endif
@@ -1053,7 +1053,9 @@ void ndDynamicsUpdateSoa::InitSkeletons()
 	ndScene* const scene = m_world->GetScene();
 	const ndArray<ndSkeletonContainer*>& activeSkeletons = m_world->m_activeSkeletons;
 
-	auto InitSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
+	const bool parallelSkeletons = scene->GetThreadCount() > 1;
+
+	auto InitSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons, parallelSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
 	{
 		D_TRACKTIME_NAMED(InitSkeletons);
 		ndArray<ndRightHandSide>& rightHandSide = m_rightHandSide;
@@ -1062,13 +1064,28 @@ void ndDynamicsUpdateSoa::InitSkeletons()
 		for (ndInt32 i = threadIndex; i < activeSkeletons.GetCount(); i += threadCount)
 		{
 			ndSkeletonContainer* const skeleton = activeSkeletons[i];
-			skeleton->InitMassMatrix(&leftHandSide[0], &rightHandSide[0]);
+			if (!(parallelSkeletons && skeleton->m_branches.GetCount()))
+			{
+				skeleton->InitMassMatrix(&leftHandSide[0], &rightHandSide[0]);
+			}
 		}
 	});
 
 	if (activeSkeletons.GetCount())
 	{
 		scene->ParallelExecute(InitSkeletons);
+		if (parallelSkeletons)
+		{
+			// large skeletons are split into branches, and all threads work on one at a time
+			for (ndInt32 i = 0; i < activeSkeletons.GetCount(); ++i)
+			{
+				ndSkeletonContainer* const skeleton = activeSkeletons[i];
+				if (skeleton->m_branches.GetCount())
+				{
+					skeleton->InitMassMatrix(*scene, &m_leftHandSide[0], &m_rightHandSide[0]);
+				}
+			}
+		}
 	}
 }
 
@@ -1079,20 +1096,37 @@ void ndDynamicsUpdateSoa::UpdateSkeletons()
 	const ndArray<ndSkeletonContainer*>& activeSkeletons = m_world->m_activeSkeletons;
 	//const ndBodyKinematic** const bodyArray = (const ndBodyKinematic**)(&scene->GetActiveBodyArray()[0]);
 
-	auto UpdateSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
+	const bool parallelSkeletons = scene->GetThreadCount() > 1;
+
+	auto UpdateSkeletons = ndMakeObject::ndFunction([this, &activeSkeletons, parallelSkeletons](ndInt32 threadIndex, ndInt32 threadCount)
 	{
 		D_TRACKTIME_NAMED(UpdateSkeletons);
 		ndJacobian* const internalForces = &GetInternalForces()[0];
 		for (ndInt32 i = threadIndex; i < activeSkeletons.GetCount(); i += threadCount)
 		{
 			ndSkeletonContainer* const skeleton = activeSkeletons[i];
-			skeleton->CalculateReactionForces(internalForces);
+			if (!(parallelSkeletons && skeleton->m_branches.GetCount()))
+			{
+				skeleton->CalculateReactionForces(internalForces);
+			}
 		}
 	});
 
 	if (activeSkeletons.GetCount())
 	{
 		scene->ParallelExecute(UpdateSkeletons);
+		if (parallelSkeletons)
+		{
+			ndJacobian* const internalForces = &GetInternalForces()[0];
+			for (ndInt32 i = 0; i < activeSkeletons.GetCount(); ++i)
+			{
+				ndSkeletonContainer* const skeleton = activeSkeletons[i];
+				if (skeleton->m_branches.GetCount())
+				{
+					skeleton->CalculateReactionForces(*scene, internalForces);
+				}
+			}
+		}
 	}
 }
 
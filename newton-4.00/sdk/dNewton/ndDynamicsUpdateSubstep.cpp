@@ -0,0 +1,354 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndCoreStdafx.h"
+#include "ndNewtonStdafx.h"
+#include "ndWorld.h"
+#include "ndBodyDynamic.h"
+#include "ndSkeletonContainer.h"
+#include "ndDynamicsUpdateSubstep.h"
+
+ndDynamicsUpdateSubstep::ndDynamicsUpdateSubstep(ndWorld* const world)
+	:ndDynamicsUpdate(world)
+	,m_substepForces(256)
+	,m_contactGeometry(256)
+{
+}
+
+ndDynamicsUpdateSubstep::~ndDynamicsUpdateSubstep()
+{
+}
+
+const char* ndDynamicsUpdateSubstep::GetStringId() const
+{
+	return "substeps";
+}
+
+void ndDynamicsUpdateSubstep::SaveJointForces()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	m_substepForces.SetCount(m_rightHandSide.GetCount());
+	auto SaveJointForces = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(SaveJointForces);
+		const ndStartEnd startEnd(m_rightHandSide.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			m_substepForces[i] = m_rightHandSide[i].m_force;
+		}
+	});
+	scene->ParallelExecute(SaveJointForces);
+}
+
+void ndDynamicsUpdateSubstep::RestoreJointForces()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+	auto RestoreJointForces = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(RestoreJointForces);
+		const ndStartEnd startEnd(jointArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndConstraint* const joint = jointArray[i];
+			const ndInt32 rowStart = joint->m_rowStart;
+			const bool isBilateral = joint->IsBilateral();
+			for (ndInt32 j = 0; j < joint->m_rowCount; ++j)
+			{
+				ndRightHandSide* const rhs = &m_rightHandSide[rowStart + j];
+				const ndFloat32 force = m_substepForces[rowStart + j];
+				rhs->m_force = isBilateral ? ndClamp(force, rhs->m_lowerBoundFrictionCoefficent, rhs->m_upperBoundFrictionCoefficent) : force;
+			}
+		}
+	});
+	scene->ParallelExecute(RestoreJointForces);
+
+	// the jacobians changed, so the body internal forces must be recalculated
+	AccumulateJointForces();
+}
+
+void ndDynamicsUpdateSubstep::ClearSkeletonLoops()
+{
+	// the jacobian pass adds the skeleton loop joints, 
+	// they have to be removed before rebuilding the jacobians.
+	const ndArray<ndSkeletonContainer*>& activeSkeletons = m_world->m_activeSkeletons;
+	for (ndInt32 i = 0; i < activeSkeletons.GetCount(); ++i)
+	{
+		activeSkeletons[i]->ClearCloseLoopJoints();
+	}
+}
+
+void ndDynamicsUpdateSubstep::SaveContactGeometry()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+
+	// the contact normal rows come first, one per contact point, 
+	// so the row index of a contact can be used to store its points.
+	m_contactGeometry.SetCount(m_rightHandSide.GetCount());
+	auto SaveContactGeometry = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(SaveContactGeometry);
+		const ndStartEnd startEnd(jointArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndContact* const contact = jointArray[i]->GetAsContact();
+			if (contact && contact->m_rowCount)
+			{
+				ndInt32 index = contact->m_rowStart;
+				const ndContactPointList& contactPoints = contact->GetContactPoints();
+				ndAssert(contactPoints.GetCount() <= contact->m_rowCount);
+				for (ndContactPointList::ndNode* node = contactPoints.GetFirst(); node; node = node->GetNext())
+				{
+					const ndContactMaterial& point = node->GetInfo();
+					m_contactGeometry[index].m_point = point.m_point;
+					m_contactGeometry[index].m_penetration = point.m_penetration;
+					index++;
+				}
+			}
+		}
+	});
+	scene->ParallelExecute(SaveContactGeometry);
+}
+
+void ndDynamicsUpdateSubstep::RestoreContactGeometry()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+	auto RestoreContactGeometry = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(RestoreContactGeometry);
+		const ndStartEnd startEnd(jointArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndContact* const contact = jointArray[i]->GetAsContact();
+			if (contact && contact->m_rowCount)
+			{
+				ndInt32 index = contact->m_rowStart;
+				ndContactPointList& contactPoints = contact->GetContactPoints();
+				for (ndContactPointList::ndNode* node = contactPoints.GetFirst(); node; node = node->GetNext())
+				{
+					ndContactMaterial& point = node->GetInfo();
+					point.m_point = m_contactGeometry[index].m_point;
+					point.m_penetration = m_contactGeometry[index].m_penetration;
+					index++;
+				}
+			}
+		}
+	});
+	scene->ParallelExecute(RestoreContactGeometry);
+}
+
+void ndDynamicsUpdateSubstep::ReprojectContacts()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndArray<ndConstraint*>& jointArray = scene->GetActiveContactArray();
+	auto ReprojectContacts = ndMakeObject::ndFunction([this, &jointArray](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(ReprojectContacts);
+		const ndVector half(ndFloat32(0.5f));
+		const ndVector timestep(m_timestep);
+		const ndStartEnd startEnd(jointArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndContact* const contact = jointArray[i]->GetAsContact();
+			if (contact && contact->m_rowCount)
+			{
+				const ndBodyKinematic* const body0 = contact->GetBody0();
+				const ndBodyKinematic* const body1 = contact->GetBody1();
+				ndContactPointList& contactPoints = contact->GetContactPoints();
+				for (ndContactPointList::ndNode* node = contactPoints.GetFirst(); node; node = node->GetNext())
+				{
+					// first order update of the contact geometry, 
+					// the normal stays the same for the whole step.
+					ndContactMaterial& point = node->GetInfo();
+					const ndVector veloc0(body0->GetVelocityAtPoint(point.m_point));
+					const ndVector veloc1(body1->GetVelocityAtPoint(point.m_point));
+					const ndFloat32 approachSpeed = point.m_normal.DotProduct(veloc1 - veloc0).GetScalar();
+					point.m_penetration += approachSpeed * m_timestep;
+					point.m_point += (half * (veloc0 + veloc1) * timestep) & ndVector::m_triplexMask;
+				}
+			}
+		}
+	});
+	scene->ParallelExecute(ReprojectContacts);
+}
+
+void ndDynamicsUpdateSubstep::IntegrateSubstep()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	auto IntegrateSubstep = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(IntegrateSubstep);
+		const ndArray<ndBodyKinematic*>& bodyArray = GetBodyIslandOrder();
+		const ndStartEnd startEnd(bodyArray.GetCount() - GetUnconstrainedBodyCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndBodyKinematic* const body = bodyArray[i];
+			if (!body->m_equilibrium)
+			{
+				body->IntegrateVelocity(m_timestep);
+
+				// refresh the inertia and the gyro terms at the new pose,
+				// but not m_accel and m_alpha, those hold the velocity at 
+				// the beginning of the step for the final acceleration.
+				body->UpdateInvInertiaMatrix();
+				const ndVector angularMomentum(body->CalculateAngularMomentum());
+				body->m_gyroTorque = body->m_omega.CrossProduct(angularMomentum);
+				body->m_gyroAlpha = body->m_invWorldInertiaMatrix.RotateVector(body->m_gyroTorque);
+				body->m_gyroRotation = body->m_rotation;
+			}
+		}
+	});
+	scene->ParallelExecute(IntegrateSubstep);
+}
+
+void ndDynamicsUpdateSubstep::IntegrateBodiesAcceleration()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndVector invTime(m_invTimestep);
+	const bool hasJoints = scene->GetActiveContactArray().GetCount() ? true : false;
+	const ndInt32 unconstrainedBase = hasJoints ? GetBodyIslandOrder().GetCount() - GetUnconstrainedBodyCount() : 0;
+	const ndFloat32 timestep = scene->GetTimestep();
+
+	auto IntegrateBodiesAcceleration = ndMakeObject::ndFunction([this, timestep, invTime, unconstrainedBase](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(IntegrateBodiesAcceleration);
+		const ndWorld* const world = m_world;
+		const ndArray<ndBodyKinematic*>& bodyArray = GetBodyIslandOrder();
+		const ndStartEnd startEnd(bodyArray.GetCount(), threadIndex, threadCount);
+
+		const ndFloat32 speedFreeze2 = world->m_freezeSpeed2;
+		const ndFloat32 accelFreeze2 = world->m_freezeAccel2;
+
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndBodyKinematic* const body = bodyArray[i];
+			if (!body->m_equilibrium)
+			{
+				body->SetAcceleration(invTime * (body->m_veloc - body->m_accel), invTime * (body->m_omega - body->m_alpha));
+				if (i >= unconstrainedBase)
+				{
+					// constrained bodies were already moved by the substeps
+					body->IntegrateVelocity(timestep);
+				}
+			}
+			body->EvaluateSleepState(speedFreeze2, accelFreeze2);
+		}
+	});
+
+	scene->ParallelExecute(IntegrateBodiesAcceleration);
+}
+
+void ndDynamicsUpdateSubstep::CalculateSubstepForces(ndInt32 substep, ndInt32 velocitySteps)
+{
+	D_TRACKTIME();
+	if (substep)
+	{
+		ClearSkeletonLoops();
+	}
+	InitJacobianMatrix();
+	if (substep)
+	{
+		RestoreJointForces();
+	}
+
+	m_firstPassCoef = ndFloat32(0.0f);
+	InitSkeletons();
+	for (ndInt32 step = 0; step < velocitySteps; ++step)
+	{
+		CalculateJointsAcceleration();
+		CalculateJointsForce();
+		UpdateSkeletons();
+		IntegrateBodiesVelocity();
+	}
+}
+
+void ndDynamicsUpdateSubstep::Update()
+{
+	D_TRACKTIME();
+	ndScene* const scene = m_world->GetScene();
+	const ndFloat32 timestep = scene->GetTimestep();
+	const ndInt32 substeps = m_world->GetSubSteps();
+	m_timestep = timestep;
+
+	BuildIsland();
+	IntegrateUnconstrainedBodies();
+	InitWeights();
+	InitBodyArray();
+
+	if (scene->GetActiveContactArray().GetCount())
+	{
+		// max(4, substeps) velocity steps per frame, at least as many as the default 
+		// RK4 solver, rounded up to a whole number of velocity steps per substep. 
+		// The default solver passes budget is distributed among them.
+		const ndInt32 frameVelocitySteps = ndMax(4, substeps);
+		const ndInt32 velocitySteps = (frameVelocitySteps + substeps - 1) / substeps;
+		const ndInt32 passesBudget = ndInt32(m_solverPasses) * 4;
+		m_solverPasses = ndUnsigned32(ndMax(passesBudget / (velocitySteps * substeps), 4));
+
+		m_timestep = timestep / ndFloat32(substeps);
+		m_invTimestep = ndFloat32(1.0f) / m_timestep;
+		m_invStepRK = ndFloat32(1.0f) / ndFloat32(velocitySteps);
+		m_timestepRK = m_timestep * m_invStepRK;
+		m_invTimestepRK = m_invTimestep * ndFloat32(velocitySteps);
+
+		for (ndInt32 i = 0; i < substeps; ++i)
+		{
+			if (i)
+			{
+				if (i == 1)
+				{
+					SaveContactGeometry();
+				}
+				ReprojectContacts();
+			}
+			CalculateSubstepForces(i, velocitySteps);
+			IntegrateSubstep();
+			if (i < (substeps - 1))
+			{
+				SaveJointForces();
+			}
+		}
+
+		if (substeps > 1)
+		{
+			// the reprojected contacts are only an approximation used by the solver,
+			// the contact joints keep the geometry of the collision pass.
+			RestoreContactGeometry();
+		}
+
+		m_timestep = timestep;
+		m_invTimestep = ndFloat32(1.0f) / timestep;
+		UpdateForceFeedback();
+	}
+
+	IntegrateBodiesAcceleration();
+	DetermineSleepStates();
+}
@@ -0,0 +1,71 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef __ND_WORLD_DYNAMICS_UPDATE_SUBSTEP_H__
+#define __ND_WORLD_DYNAMICS_UPDATE_SUBSTEP_H__
+
+#include "ndNewtonStdafx.h"
+#include "ndDynamicsUpdate.h"
+
+// Substepping variant of the scalar solver.
+// In this mode the world runs the collision only once per step, and the 
+// solver divides the step in GetSubSteps() small substeps. Each substep 
+// rebuilds the joint jacobians at the current body poses, does a short 
+// relaxation warm started with the previous substep forces, and integrates 
+// the bodies. Contacts are not recalculated, instead the contact points and 
+// penetrations are projected forward with the body velocities, and restored 
+// to the values found by the collision pass at the end of the step.
+D_MSV_NEWTON_ALIGN_32
+class ndDynamicsUpdateSubstep: public ndDynamicsUpdate
+{
+	class ndContactGeometry
+	{
+		public:
+		ndVector m_point;
+		ndFloat32 m_penetration;
+	};
+
+	public:
+	ndDynamicsUpdateSubstep(ndWorld* const world);
+	virtual ~ndDynamicsUpdateSubstep();
+
+	virtual const char* GetStringId() const;
+
+	protected:
+	virtual void Update();
+
+	private:
+	void SaveJointForces();
+	void RestoreJointForces();
+	void ClearSkeletonLoops();
+	void IntegrateSubstep();
+	void ReprojectContacts();
+	void SaveContactGeometry();
+	void RestoreContactGeometry();
+	void IntegrateBodiesAcceleration();
+	void CalculateSubstepForces(ndInt32 substep, ndInt32 velocitySteps);
+
+	ndArray<ndFloat32> m_substepForces;
+	ndArray<ndContactGeometry> m_contactGeometry;
+} D_GCC_NEWTON_ALIGN_32;
+
+#endif
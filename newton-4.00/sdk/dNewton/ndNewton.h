@@ -32,6 +32,7 @@
 #include <ndModel.h>
 #include <ndIkSolver.h>
 #include <ndModelList.h>
+#include <ndModelBatch.h>
 #include <ndJointGear.h>
 #include <ndJointList.h>
 #include <ndWorldScene.h>
@@ -64,6 +65,9 @@
 #include <ndModelArticulation.h>
 #include <ndSkeletonContainer.h>
 #include <ndDynamicsUpdateSoa.h>
+#include <ndDynamicsUpdateIsland.h>
+#include <ndDynamicsUpdateSubstep.h>
+#include <ndDynamicsUpdateColored.h>
 #include <ndIkJointDoubleHinge.h>
 #include <ndMultiBodyVehicleMotor.h>
 #include <ndMultiBodyVehicleGearBox.h>
@@ -336,6 +336,86 @@ void ndSkeletonContainer::ndNode::BodyJacobianTimeMassForward(const ndForcePair&
 	}
 }
 
+ndSkeletonContainer::ndPlan::ndPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash)
+	:ndClassAlloc()
+	,m_key(size)
+	,m_hash(hash)
+{
+	m_key.SetCount(size);
+	ndMemCpy(&m_key[0], key, size);
+}
+
+bool ndSkeletonContainer::ndPlan::IsEqual(const ndInt32* const key, ndInt32 size) const
+{
+	return (m_key.GetCount() == size) && !memcmp(&m_key[0], key, size * sizeof(ndInt32));
+}
+
+ndSkeletonContainer::ndTopologyPlan::ndTopologyPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash)
+	:ndPlan(key, size, hash)
+	,m_nodesOrder()
+	,m_branches()
+	,m_trunk()
+{
+}
+
+ndSkeletonContainer::ndLoopPlan::ndLoopPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash)
+	:ndPlan(key, size, hash)
+	,m_auxiliaryOrder()
+	,m_sparseStart()
+	,m_sparseIndex()
+	,m_blockSize(0)
+{
+}
+
+ndSkeletonContainer::ndPlanCache::ndPlanCache()
+	:m_topologyPlans()
+	,m_loopPlans()
+	,m_lock()
+{
+}
+
+ndSharedPtr<ndSkeletonContainer::ndTopologyPlan> ndSkeletonContainer::ndPlanCache::FindTopologyPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash)
+{
+	ndScopeSpinLock lock(m_lock);
+	ndPlanTree<ndTopologyPlan>::ndNode* const node = m_topologyPlans.Find(hash);
+	if (node && node->GetInfo()->IsEqual(key, size))
+	{
+		return node->GetInfo();
+	}
+	return ndSharedPtr<ndTopologyPlan>();
+}
+
+ndSharedPtr<ndSkeletonContainer::ndLoopPlan> ndSkeletonContainer::ndPlanCache::FindLoopPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash)
+{
+	ndScopeSpinLock lock(m_lock);
+	ndPlanTree<ndLoopPlan>::ndNode* const node = m_loopPlans.Find(hash);
+	if (node && node->GetInfo()->IsEqual(key, size))
+	{
+		return node->GetInfo();
+	}
+	return ndSharedPtr<ndLoopPlan>();
+}
+
+void ndSkeletonContainer::ndPlanCache::AddTopologyPlan(const ndSharedPtr<ndTopologyPlan>& plan)
+{
+	ndScopeSpinLock lock(m_lock);
+	if (m_topologyPlans.GetCount() >= D_SKELETON_MAX_CACHED_PLANS)
+	{
+		m_topologyPlans.RemoveAll();
+	}
+	m_topologyPlans.Insert(plan, plan->m_hash);
+}
+
+void ndSkeletonContainer::ndPlanCache::AddLoopPlan(const ndSharedPtr<ndLoopPlan>& plan)
+{
+	ndScopeSpinLock lock(m_lock);
+	if (m_loopPlans.GetCount() >= D_SKELETON_MAX_CACHED_PLANS)
+	{
+		m_loopPlans.RemoveAll();
+	}
+	m_loopPlans.Insert(plan, plan->m_hash);
+}
+
 ndSkeletonContainer::ndSkeletonContainer()
 	:m_skeleton(nullptr)
 	,m_nodesOrder(nullptr)
@@ -349,6 +429,12 @@ ndSkeletonContainer::ndSkeletonContainer()
 	,m_deltaForce(nullptr)
 	,m_nodeList()
 	,m_loopingJoints(32)
+	,m_branches()
+	,m_trunk()
+	,m_loopKey()
+	,m_bodyNodeMap()
+	,m_loopPlan()
+	,m_planCache(nullptr)
 	,m_auxiliaryMemoryBuffer(1024 * 8)
 	,m_lock()
 	,m_blockSize(0)
@@ -458,11 +544,80 @@ void ndSkeletonContainer::SortGraph(ndNode* const root, ndInt32& index)
 void ndSkeletonContainer::Finalize(ndInt32 loopJointsCount, ndJointBilateralConstraint** const loopJointArray)
 {
 	ndAssert(m_nodeList.GetCount() >= 1);
-	m_nodesOrder = (ndNode**)ndMemory::Malloc(m_nodeList.GetCount() * sizeof(ndNode*));
-	
+	const ndInt32 nodeCount = m_nodeList.GetCount();
+	m_nodesOrder = (ndNode**)ndMemory::Malloc(nodeCount * sizeof(ndNode*));
+
+	// the topology key is the parent of each node in the order they were added
 	ndInt32 index = 0;
-	SortGraph(m_skeleton, index);
-	ndAssert(index == m_nodeList.GetCount());
+	ndNode** const nodes = ndAlloca(ndNode*, nodeCount);
+	ndInt32* const key = ndAlloca(ndInt32, nodeCount);
+	for (ndNodeList::ndNode* ptr = m_nodeList.GetFirst(); ptr; ptr = ptr->GetNext())
+	{
+		ndNode* const node = &ptr->GetInfo();
+		ndAssert(!node->m_parent || (node->m_parent->m_index < index));
+		node->m_index = index;
+		nodes[index] = node;
+		key[index] = node->m_parent ? node->m_parent->m_index : -1;
+		index++;
+	}
+
+	const ndUnsigned64 hash = ndCRC64(key, ndInt32(nodeCount * sizeof(ndInt32)), 0);
+	ndSharedPtr<ndTopologyPlan> plan(m_planCache ? m_planCache->FindTopologyPlan(key, nodeCount, hash) : ndSharedPtr<ndTopologyPlan>());
+	if (plan)
+	{
+		for (ndInt32 i = 0; i < nodeCount; ++i)
+		{
+			ndNode* const node = nodes[plan->m_nodesOrder[i]];
+			m_nodesOrder[i] = node;
+			node->m_index = i;
+		}
+		m_branches.SetCount(0);
+		for (ndInt32 i = 0; i < plan->m_branches.GetCount(); ++i)
+		{
+			m_branches.PushBack(plan->m_branches[i]);
+		}
+		m_trunk.SetCount(0);
+		for (ndInt32 i = 0; i < plan->m_trunk.GetCount(); ++i)
+		{
+			m_trunk.PushBack(m_nodesOrder[plan->m_trunk[i]]);
+		}
+	}
+	else
+	{
+		index = 0;
+		SortGraph(m_skeleton, index);
+		ndAssert(index == nodeCount);
+		CalculateBranches();
+
+		plan = ndSharedPtr<ndTopologyPlan>(new ndTopologyPlan(key, nodeCount, hash));
+		plan->m_nodesOrder.SetCount(nodeCount);
+		for (ndInt32 i = 0; i < nodeCount; ++i)
+		{
+			plan->m_nodesOrder[nodes[i]->m_index] = i;
+		}
+		for (ndInt32 i = 0; i < m_branches.GetCount(); ++i)
+		{
+			plan->m_branches.PushBack(m_branches[i]);
+		}
+		for (ndInt32 i = 0; i < m_trunk.GetCount(); ++i)
+		{
+			plan->m_trunk.PushBack(m_trunk[i]->m_index);
+		}
+		if (m_planCache)
+		{
+			m_planCache->AddTopologyPlan(plan);
+		}
+	}
+
+	m_bodyNodeMap.RemoveAll();
+	for (ndInt32 i = 0; i < nodeCount; ++i)
+	{
+		const ndBodyKinematic* const body = m_nodesOrder[i]->m_body;
+		if (body->GetInvMass() != ndFloat32(0.0f))
+		{
+			m_bodyNodeMap.Insert(i, body);
+		}
+	}
 	
 	for (ndInt32 i = 0; i < loopJointsCount; ++i) 
 	{
@@ -473,6 +628,209 @@ void ndSkeletonContainer::Finalize(ndInt32 loopJointsCount, ndJointBilateralCons
 	}
 }
 
+void ndSkeletonContainer::CalculateBranches()
+{
+	m_trunk.SetCount(0);
+	m_branches.SetCount(0);
+	const ndInt32 nodeCount = m_nodeList.GetCount();
+	if (nodeCount < D_SKELETON_PARALLEL_NODE_COUNT)
+	{
+		return;
+	}
+
+	ndInt32* const subtreeSize = ndAlloca(ndInt32, nodeCount);
+	for (ndInt32 i = 0; i < nodeCount; ++i)
+	{
+		subtreeSize[i] = 1;
+		for (ndNode* child = m_nodesOrder[i]->m_child; child; child = child->m_sibling)
+		{
+			subtreeSize[i] += subtreeSize[child->m_index];
+		}
+	}
+
+	// keep splitting the largest branch at its first fork, the nodes above
+	// the fork become part of the trunk, which is solved by a single thread 
+	// after all the branches. branches without forks can't be split.
+	ndInt8* const isTrunk = ndAlloca(ndInt8, nodeCount);
+	ndMemSet(isTrunk, ndInt8(0), nodeCount);
+
+	ndArray<ndNode*> chains;
+	ndArray<ndNode*> branches;
+	branches.PushBack(m_skeleton);
+	while (branches.GetCount() && ((branches.GetCount() + chains.GetCount()) < D_SKELETON_MAX_BRANCHES))
+	{
+		ndInt32 largest = 0;
+		for (ndInt32 i = 1; i < branches.GetCount(); ++i)
+		{
+			if (subtreeSize[branches[i]->m_index] > subtreeSize[branches[largest]->m_index])
+			{
+				largest = i;
+			}
+		}
+
+		ndNode* const node = branches[largest];
+		if ((node != m_skeleton) && (subtreeSize[node->m_index] * D_SKELETON_MAX_BRANCHES < nodeCount))
+		{
+			break;
+		}
+		branches[largest] = branches[branches.GetCount() - 1];
+		branches.SetCount(branches.GetCount() - 1);
+
+		ndNode* fork = node;
+		while (fork->m_child && !fork->m_child->m_sibling)
+		{
+			fork = fork->m_child;
+		}
+
+		if (!fork->m_child && (node != m_skeleton))
+		{
+			chains.PushBack(node);
+		}
+		else
+		{
+			for (ndNode* trunkNode = node; trunkNode != fork; trunkNode = trunkNode->m_child)
+			{
+				isTrunk[trunkNode->m_index] = 1;
+			}
+			isTrunk[fork->m_index] = 1;
+			for (ndNode* child = fork->m_child; child; child = child->m_sibling)
+			{
+				branches.PushBack(child);
+			}
+		}
+	}
+
+	for (ndInt32 i = 0; i < chains.GetCount(); ++i)
+	{
+		branches.PushBack(chains[i]);
+	}
+	if (branches.GetCount() < 2)
+	{
+		return;
+	}
+
+	// the largest branches go first, so that the threads stay balanced
+	for (ndInt32 i = 1; i < branches.GetCount(); ++i)
+	{
+		ndInt32 j = i;
+		ndNode* const node = branches[i];
+		for (; j && (subtreeSize[branches[j - 1]->m_index] < subtreeSize[node->m_index]); --j)
+		{
+			branches[j] = branches[j - 1];
+		}
+		branches[j] = node;
+	}
+
+	for (ndInt32 i = 0; i < branches.GetCount(); ++i)
+	{
+		ndBranch branch;
+		branch.m_end = branches[i]->m_index + 1;
+		branch.m_start = branch.m_end - subtreeSize[branches[i]->m_index];
+		m_branches.PushBack(branch);
+	}
+
+	for (ndInt32 i = 0; i < nodeCount; ++i)
+	{
+		if (isTrunk[i])
+		{
+			m_trunk.PushBack(m_nodesOrder[i]);
+		}
+	}
+	ndAssert(m_trunk[m_trunk.GetCount() - 1] == m_skeleton);
+}
+
+ndInt32 ndSkeletonContainer::GetBodyNodeIndex(const ndBodyKinematic* const body) const
+{
+	ndBodyNodeMap::ndNode* const node = m_bodyNodeMap.Find(body);
+	return node ? node->GetInfo() : -1;
+}
+
+const ndSkeletonContainer::ndLoopPlan* ndSkeletonContainer::GetLoopPlan(const ndInt32* const boundRow, const ndInt32* const primaryBodies, const ndInt32* const auxiliaryBodies)
+{
+	// the key is the structure of the skeleton, the joints rows and 
+	// the bodies and bounds of the auxiliary rows for this step.
+	const ndInt32 nodeCount = m_nodeList.GetCount();
+	const ndInt32 loopCount = m_loopCount + m_dynamicsLoopCount;
+	m_loopKey.SetCount(0);
+	m_loopKey.PushBack(nodeCount);
+	m_loopKey.PushBack(loopCount);
+	m_loopKey.PushBack((m_skeleton->m_body->GetInvMass() == ndFloat32(0.0f)) ? 1 : 0);
+	for (ndInt32 i = 0; i < nodeCount - 1; ++i)
+	{
+		const ndNode* const node = m_nodesOrder[i];
+		m_loopKey.PushBack(node->m_parent->m_index);
+		m_loopKey.PushBack(node->m_joint->m_rowCount);
+		m_loopKey.PushBack(node->m_dof);
+	}
+	for (ndInt32 i = 0; i < loopCount; ++i)
+	{
+		m_loopKey.PushBack(m_loopingJoints[i]->m_rowCount);
+	}
+	for (ndInt32 i = 0; i < m_auxiliaryRowCount; ++i)
+	{
+		m_loopKey.PushBack(boundRow[i]);
+		m_loopKey.PushBack(auxiliaryBodies[i * 2 + 0]);
+		m_loopKey.PushBack(auxiliaryBodies[i * 2 + 1]);
+	}
+
+	const ndInt32 size = m_loopKey.GetCount();
+	const ndInt32* const key = &m_loopKey[0];
+	if (!(m_loopPlan && m_loopPlan->IsEqual(key, size)))
+	{
+		const ndUnsigned64 hash = ndCRC64(key, ndInt32(size * sizeof(ndInt32)), 0);
+		ndSharedPtr<ndLoopPlan> plan(m_planCache ? m_planCache->FindLoopPlan(key, size, hash) : ndSharedPtr<ndLoopPlan>());
+		if (!plan)
+		{
+			plan = ndSharedPtr<ndLoopPlan>(new ndLoopPlan(key, size, hash));
+
+			// unbounded rows go first, in the order they were added.
+			for (ndInt32 i = 0; i < m_auxiliaryRowCount; ++i)
+			{
+				if (boundRow[i])
+				{
+					plan->m_auxiliaryOrder.PushBack(i);
+				}
+			}
+			plan->m_blockSize = plan->m_auxiliaryOrder.GetCount();
+			for (ndInt32 i = 0; i < m_auxiliaryRowCount; ++i)
+			{
+				if (!boundRow[i])
+				{
+					plan->m_auxiliaryOrder.PushBack(i);
+				}
+			}
+
+			const ndInt32 primaryCount = m_rowCount - m_auxiliaryRowCount;
+			for (ndInt32 i = 0; i < m_auxiliaryRowCount; ++i)
+			{
+				plan->m_sparseStart.PushBack(plan->m_sparseIndex.GetCount());
+				const ndInt32 j = plan->m_auxiliaryOrder[i];
+				const ndInt32 a0 = auxiliaryBodies[j * 2 + 0];
+				const ndInt32 a1 = auxiliaryBodies[j * 2 + 1];
+				for (ndInt32 k = 0; k < primaryCount; ++k)
+				{
+					const ndInt32 p0 = primaryBodies[k * 2 + 0];
+					const ndInt32 p1 = primaryBodies[k * 2 + 1];
+					const bool share0 = (a0 >= 0) && ((a0 == p0) || (a0 == p1));
+					const bool share1 = (a1 >= 0) && ((a1 == p0) || (a1 == p1));
+					if (share0 || share1)
+					{
+						plan->m_sparseIndex.PushBack(k);
+					}
+				}
+			}
+			plan->m_sparseStart.PushBack(plan->m_sparseIndex.GetCount());
+
+			if (m_planCache)
+			{
+				m_planCache->AddLoopPlan(plan);
+			}
+		}
+		m_loopPlan = plan;
+	}
+	return *m_loopPlan;
+}
+
 void ndSkeletonContainer::ClearCloseLoopJoints()
 {
 	m_dynamicsLoopCount = 0;
@@ -542,28 +900,9 @@ void ndSkeletonContainer::CheckSleepState()
 
 void ndSkeletonContainer::CalculateBufferSizeInBytes()
 {
-	ndInt32 rowCount = 0;
-	ndInt32 auxiliaryRowCount = 0;
-	if (m_nodesOrder) 
-	{
-		const ndInt32 nodeCount = m_nodeList.GetCount() - 1;
-		for (ndInt32 i = 0; i < nodeCount; ++i) 
-		{
-			ndNode* const node = m_nodesOrder[i];
-			rowCount += node->m_joint->m_rowCount;
-			auxiliaryRowCount += node->GetAuxiliaryRows(m_rightHandSide);
-		}
-	}
-
-	ndInt32 extraAuxiliaryRows = 0;
-	const ndInt32 loopCount = m_loopCount + m_dynamicsLoopCount;
-	for (ndInt32 j = 0; j < loopCount; ++j)  
-	{
-		const ndConstraint* const joint = m_loopingJoints[j];
-		extraAuxiliaryRows += joint->m_rowCount;
-	}
-	rowCount += extraAuxiliaryRows;
-	auxiliaryRowCount += extraAuxiliaryRows;
+	// the row counts are known after the nodes are factorized
+	const ndInt32 rowCount = m_rowCount;
+	const ndInt32 auxiliaryRowCount = m_auxiliaryRowCount;
 
 	ndInt32 size = ndInt32(sizeof(ndInt32) * rowCount);
 	size += sizeof(ndInt32) * rowCount;
@@ -575,7 +914,7 @@ void ndSkeletonContainer::CalculateBufferSizeInBytes()
 	m_auxiliaryMemoryBuffer.SetCount((size + 1024) & -0x10);
 }
 
-void ndSkeletonContainer::CalculateLoopMassMatrixCoefficients(ndFloat32* const diagDamp)
+void ndSkeletonContainer::CalculateLoopMassMatrixCoefficients(ndFloat32* const diagDamp, ndInt32 threadIndex, ndInt32 threadCount)
 {
 	D_TRACKTIME();
 	const ndInt32 primaryCount = m_rowCount - m_auxiliaryRowCount;
@@ -583,7 +922,7 @@ void ndSkeletonContainer::CalculateLoopMassMatrixCoefficients(ndFloat32* const d
 	ndJacobian tempArray[3];
 	tempArray[0].m_linear = ndVector::m_zero;
 	tempArray[0].m_angular = ndVector::m_zero;
-	for (ndInt32 index = 0; index < m_auxiliaryRowCount; ++index) 
+	for (ndInt32 index = threadIndex; index < m_auxiliaryRowCount; index += threadCount) 
 	{
 		const ndInt32 ii = m_matrixRowsIndex[primaryCount + index];
 		const ndLeftHandSide* const row_i = &m_leftHandSide[ii];
@@ -633,9 +972,12 @@ void ndSkeletonContainer::CalculateLoopMassMatrixCoefficients(ndFloat32* const d
 			m_massMatrix11[j * m_auxiliaryRowCount + index] = offDiagValue;
 		}
 
+		// only the primary rows sharing a body with this row are not zero
 		ndFloat32* const matrixRow10 = &m_massMatrix10[primaryCount * index];
-		for (ndInt32 j = 0; j < primaryCount; ++j)  
+		const ndLoopPlan* const plan = *m_loopPlan;
+		for (ndInt32 k = plan->m_sparseStart[index]; k < plan->m_sparseStart[index + 1]; ++k)
 		{
+			const ndInt32 j = plan->m_sparseIndex[k];
 			const ndInt32 jj = m_matrixRowsIndex[j];
 			const ndLeftHandSide* const row_j = &m_leftHandSide[jj];
 
@@ -660,6 +1002,24 @@ void ndSkeletonContainer::CalculateLoopMassMatrixCoefficients(ndFloat32* const d
 	}
 }
 
+void ndSkeletonContainer::SolveForwardNode(ndForcePair* const force, const ndForcePair* const accel, ndInt32 index) const
+{
+	ndNode* const node = m_nodesOrder[index];
+	ndAssert(node->m_joint);
+	ndAssert(node->m_index == index);
+	ndForcePair& f = force[index];
+	const ndForcePair& a = accel[index];
+	f.m_body = a.m_body;
+	f.m_joint = a.m_joint;
+	for (ndNode* child = node->m_child; child; child = child->m_sibling)
+	{
+		ndAssert(child->m_joint);
+		ndAssert(child->m_parent->m_index == index);
+		child->BodyJacobianTimeMassForward(force[child->m_index], f);
+	}
+	node->JointJacobianTimeMassForward(f);
+}
+
 void ndSkeletonContainer::SolveForward(ndForcePair* const force, const ndForcePair* const accel, ndInt32 startNode) const
 {
 	ndSpatialVector zero(ndSpatialVector::m_zero);
@@ -672,20 +1032,7 @@ void ndSkeletonContainer::SolveForward(ndForcePair* const force, const ndForcePa
 	const ndInt32 nodeCount = m_nodeList.GetCount();
 	for (ndInt32 i = startNode; i < nodeCount - 1; ++i) 
 	{
-		ndNode* const node = m_nodesOrder[i];
-		ndAssert(node->m_joint);
-		ndAssert(node->m_index == i);
-		ndForcePair& f = force[i];
-		const ndForcePair& a = accel[i];
-		f.m_body = a.m_body;
-		f.m_joint = a.m_joint;
-		for (ndNode* child = node->m_child; child; child = child->m_sibling) 
-		{
-			ndAssert(child->m_joint);
-			ndAssert(child->m_parent->m_index == i);
-			child->BodyJacobianTimeMassForward(force[child->m_index], f);
-		}
-		node->JointJacobianTimeMassForward(f);
+		SolveForwardNode(force, accel, i);
 	}
 
 	force[nodeCount - 1] = accel[nodeCount - 1];
@@ -717,7 +1064,7 @@ void ndSkeletonContainer::SolveBackward(ndForcePair* const force) const
 	}
 }
 
-void ndSkeletonContainer::ConditionMassMatrix() const
+void ndSkeletonContainer::ConditionMassMatrix(ndInt32 threadIndex, ndInt32 threadCount) const
 {
 	D_TRACKTIME();
 	const ndInt32 nodeCount = m_nodeList.GetCount();
@@ -725,7 +1072,7 @@ void ndSkeletonContainer::ConditionMassMatrix() const
 	const ndSpatialVector zero(ndSpatialVector::m_zero);
 
 	const ndInt32 primaryCount = m_rowCount - m_auxiliaryRowCount;
-	for (ndInt32 i = 0; i < m_auxiliaryRowCount; ++i) 
+	for (ndInt32 i = threadIndex; i < m_auxiliaryRowCount; i += threadCount) 
 	{
 		ndInt32 entry0 = 0;
 		ndInt32 startjoint = nodeCount;
@@ -771,19 +1118,21 @@ void ndSkeletonContainer::ConditionMassMatrix() const
 	}
 }
 
-void ndSkeletonContainer::RebuildMassMatrix(const ndFloat32* const diagDamp) const
+void ndSkeletonContainer::RebuildMassMatrix(const ndFloat32* const diagDamp, ndInt32 threadIndex, ndInt32 threadCount) const
 {
 	D_TRACKTIME();
 	const ndInt32 primaryCount = m_rowCount - m_auxiliaryRowCount;
 	ndInt16* const indexList = ndAlloca(ndInt16, primaryCount);
-	for (ndInt32 i = 0; i < m_auxiliaryRowCount; ++i) 
+	const ndLoopPlan* const plan = *m_loopPlan;
+	for (ndInt32 i = threadIndex; i < m_auxiliaryRowCount; i += threadCount) 
 	{
 		const ndFloat32* const matrixRow10 = &m_massMatrix10[i * primaryCount];
 		ndFloat32* const matrixRow11 = &m_massMatrix11[i * m_auxiliaryRowCount];
 
 		ndInt32 indexCount = 0;
-		for (ndInt32 k = 0; k < primaryCount; ++k) 
+		for (ndInt32 j = plan->m_sparseStart[i]; j < plan->m_sparseStart[i + 1]; ++j)
 		{
+			const ndInt32 k = plan->m_sparseIndex[j];
 			indexList[indexCount] = ndInt16(k);
 			indexCount += (matrixRow10[k] != ndFloat32(0.0f)) ? 1 : 0;
 		}
@@ -819,7 +1168,7 @@ void ndSkeletonContainer::FactorizeMatrix(ndInt32 size, ndInt32 stride, ndFloat3
 		srcLine += stride;
 	}
 
-	while (!ndCholeskyFactorization(size, stride, matrix))
+	while (!ndBlockCholeskyFactorization(size, stride, matrix))
 	{
 		srcLine = 0;
 		dstLine = 0;
@@ -834,7 +1183,7 @@ void ndSkeletonContainer::FactorizeMatrix(ndInt32 size, ndInt32 stride, ndFloat3
 	}
 }
 
-void ndSkeletonContainer::InitLoopMassMatrix()
+void ndSkeletonContainer::InitLoopMassMatrix(ndThreadPool* const threadPool)
 {
 	CalculateBufferSizeInBytes();
 	ndInt8* const memoryBuffer = &m_auxiliaryMemoryBuffer[0];
@@ -847,9 +1196,15 @@ void ndSkeletonContainer::InitLoopMassMatrix()
 	m_massMatrix10 = (ndFloat32*)&m_massMatrix11[m_auxiliaryRowCount * m_auxiliaryRowCount];
 	m_deltaForce = &m_massMatrix10[m_auxiliaryRowCount * primaryCount];
 	
+	// the auxiliary rows are collected in the order they are found, 
+	// the loop plan tells where each one goes in the loop matrix.
 	ndInt32* const boundRow = ndAlloca(ndInt32, m_auxiliaryRowCount);
+	ndInt32* const frictionIndex = ndAlloca(ndInt32, m_auxiliaryRowCount);
+	ndInt32* const matrixRowsIndex = ndAlloca(ndInt32, m_auxiliaryRowCount);
+	ndNodePair* const pairs = ndAlloca(ndNodePair, m_auxiliaryRowCount);
+	ndInt32* const primaryBodies = ndAlloca(ndInt32, 2 * primaryCount + 2);
+	ndInt32* const auxiliaryBodies = ndAlloca(ndInt32, 2 * m_auxiliaryRowCount + 2);
 
-	m_blockSize = 0;
 	ndInt32 primaryIndex = 0;
 	ndInt32 auxiliaryIndex = 0;
 	const ndInt32 nodeCount = m_nodeList.GetCount() - 1;
@@ -861,6 +1216,8 @@ void ndSkeletonContainer::InitLoopMassMatrix()
 		const ndInt32 m1 = joint->GetBody1()->m_index;
 		const ndInt32 primaryDof = node->m_dof;
 		const ndInt32 first = joint->m_rowStart;
+		const ndInt32 id0 = node->m_index;
+		const ndInt32 id1 = (node->m_parent->m_body->GetInvMass() != ndFloat32(0.0f)) ? node->m_parent->m_index : -1;
 		for (ndInt32 j = 0; j < primaryDof; ++j)  
 		{
 			const ndInt32 index = node->m_ordinal.m_sourceJacobianIndex[j];
@@ -869,6 +1226,8 @@ void ndSkeletonContainer::InitLoopMassMatrix()
 			m_pairs[primaryIndex].m_joint = joint;
 			m_frictionIndex[primaryIndex] = 0;
 			m_matrixRowsIndex[primaryIndex] = first + index;
+			primaryBodies[primaryIndex * 2 + 0] = id0;
+			primaryBodies[primaryIndex * 2 + 1] = id1;
 			primaryIndex++;
 		}
 
@@ -878,14 +1237,14 @@ void ndSkeletonContainer::InitLoopMassMatrix()
 			const ndInt32 index = node->m_ordinal.m_sourceJacobianIndex[primaryDof + j];
 			const ndRightHandSide* const rhs = &m_rightHandSide[first + index];
 
-			m_pairs[auxiliaryIndex + primaryCount].m_m0 = m0;
-			m_pairs[auxiliaryIndex + primaryCount].m_m1 = m1;
-			m_pairs[auxiliaryIndex + primaryCount].m_joint = joint;
-			m_frictionIndex[auxiliaryIndex + primaryCount] = 0;
-			m_matrixRowsIndex[auxiliaryIndex + primaryCount] = first + index;
-			const ndInt32 boundIndex = (rhs->m_lowerBoundFrictionCoefficent <= ndFloat32(-D_MAX_SKELETON_LCP_VALUE)) && (rhs->m_upperBoundFrictionCoefficent >= ndFloat32(D_MAX_SKELETON_LCP_VALUE)) ? 1 : 0;
-			boundRow[auxiliaryIndex] = boundIndex;
-			m_blockSize += boundIndex;
+			pairs[auxiliaryIndex].m_m0 = m0;
+			pairs[auxiliaryIndex].m_m1 = m1;
+			pairs[auxiliaryIndex].m_joint = joint;
+			frictionIndex[auxiliaryIndex] = 0;
+			matrixRowsIndex[auxiliaryIndex] = first + index;
+			boundRow[auxiliaryIndex] = (rhs->m_lowerBoundFrictionCoefficent <= ndFloat32(-D_MAX_SKELETON_LCP_VALUE)) && (rhs->m_upperBoundFrictionCoefficent >= ndFloat32(D_MAX_SKELETON_LCP_VALUE)) ? 1 : 0;
+			auxiliaryBodies[auxiliaryIndex * 2 + 0] = id0;
+			auxiliaryBodies[auxiliaryIndex * 2 + 1] = id1;
 			auxiliaryIndex++;
 		}
 	}
@@ -897,20 +1256,22 @@ void ndSkeletonContainer::InitLoopMassMatrix()
 		const ndConstraint* const joint = m_loopingJoints[j];
 		const ndInt32 m0 = joint->GetBody0()->m_index;
 		const ndInt32 m1 = joint->GetBody1()->m_index;
+		const ndInt32 id0 = GetBodyNodeIndex(joint->GetBody0());
+		const ndInt32 id1 = GetBodyNodeIndex(joint->GetBody1());
 
 		const ndInt32 first = joint->m_rowStart;
 		const ndInt32 auxiliaryDof = joint->m_rowCount;
 		for (ndInt32 i = 0; i < auxiliaryDof; ++i) 
 		{
 			const ndRightHandSide* const rhs = &m_rightHandSide[first + i];
-			m_pairs[auxiliaryIndex + primaryCount].m_m0 = m0;
-			m_pairs[auxiliaryIndex + primaryCount].m_m1 = m1;
-			m_pairs[auxiliaryIndex + primaryCount].m_joint = joint;
-			m_frictionIndex[auxiliaryIndex + primaryCount] = (rhs->m_normalForceIndex < 0) ? 0 : rhs->m_normalForceIndex - i;
-			m_matrixRowsIndex[auxiliaryIndex + primaryCount] = first + i;
-			const ndInt32 boundIndex = (rhs->m_lowerBoundFrictionCoefficent <= ndFloat32(-D_MAX_SKELETON_LCP_VALUE)) && (rhs->m_upperBoundFrictionCoefficent >= ndFloat32(D_MAX_SKELETON_LCP_VALUE)) ? 1 : 0;
-			boundRow[auxiliaryIndex] = boundIndex;
-			m_blockSize += boundIndex;
+			pairs[auxiliaryIndex].m_m0 = m0;
+			pairs[auxiliaryIndex].m_m1 = m1;
+			pairs[auxiliaryIndex].m_joint = joint;
+			frictionIndex[auxiliaryIndex] = (rhs->m_normalForceIndex < 0) ? 0 : rhs->m_normalForceIndex - i;
+			matrixRowsIndex[auxiliaryIndex] = first + i;
+			boundRow[auxiliaryIndex] = (rhs->m_lowerBoundFrictionCoefficent <= ndFloat32(-D_MAX_SKELETON_LCP_VALUE)) && (rhs->m_upperBoundFrictionCoefficent >= ndFloat32(D_MAX_SKELETON_LCP_VALUE)) ? 1 : 0;
+			auxiliaryBodies[auxiliaryIndex * 2 + 0] = id0;
+			auxiliaryBodies[auxiliaryIndex * 2 + 1] = id1;
 			auxiliaryIndex++;
 		}
 	}
@@ -918,35 +1279,51 @@ void ndSkeletonContainer::InitLoopMassMatrix()
 	ndAssert(primaryIndex == primaryCount);
 	ndAssert(auxiliaryIndex == m_auxiliaryRowCount);
 
-	for (ndInt32 i = 1; i < auxiliaryIndex; ++i) 
+	const ndLoopPlan* const plan = GetLoopPlan(boundRow, primaryBodies, auxiliaryBodies);
+	m_blockSize = plan->m_blockSize;
+	for (ndInt32 i = 0; i < auxiliaryIndex; ++i)
 	{
-		ndInt32 tmpBoundRow = boundRow[i];
-		ndNodePair tmpPair(m_pairs[primaryCount + i]);
-		ndInt32 tmpFrictionIndex = m_frictionIndex[primaryCount + i];
-		ndInt32 tmpMatrixRowsIndex = m_matrixRowsIndex[primaryCount + i];
-
-		ndInt32 j = i;
-		for (; j && (boundRow[j - 1] < tmpBoundRow); j--) 
-		{
-			ndAssert(j > 0);
-			boundRow[j] = boundRow[j - 1];
-			m_pairs[primaryCount + j] = m_pairs[primaryCount + j - 1];
-			m_frictionIndex[primaryCount + j] = m_frictionIndex[primaryCount + j - 1];
-			m_matrixRowsIndex[primaryCount + j] = m_matrixRowsIndex[primaryCount + j - 1];
-		}
-		boundRow[j] = tmpBoundRow;
-		m_pairs[primaryCount + j] = tmpPair;
-		m_frictionIndex[primaryCount + j] = tmpFrictionIndex;
-		m_matrixRowsIndex[primaryCount + j] = tmpMatrixRowsIndex;
+		const ndInt32 j = plan->m_auxiliaryOrder[i];
+		m_pairs[primaryCount + i] = pairs[j];
+		m_frictionIndex[primaryCount + i] = frictionIndex[j];
+		m_matrixRowsIndex[primaryCount + i] = matrixRowsIndex[j];
 	}
 
 	ndFloat32* const diagDamp = ndAlloca(ndFloat32, m_auxiliaryRowCount);
 	ndMemSet(m_massMatrix10, ndFloat32(0.0f), primaryCount * m_auxiliaryRowCount);
 	ndMemSet(m_massMatrix11, ndFloat32(0.0f), m_auxiliaryRowCount * m_auxiliaryRowCount);
 
-	CalculateLoopMassMatrixCoefficients(diagDamp);
-	ConditionMassMatrix();
-	RebuildMassMatrix(diagDamp);
+	if (threadPool)
+	{
+		// the rows of the loop mass matrix are independent of each other
+		auto CalculateCoefficients = ndMakeObject::ndFunction([this, diagDamp](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(CalculateCoefficients);
+			CalculateLoopMassMatrixCoefficients(diagDamp, threadIndex, threadCount);
+		});
+
+		auto ConditionMatrix = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(ConditionMatrix);
+			ConditionMassMatrix(threadIndex, threadCount);
+		});
+
+		auto RebuildMatrix = ndMakeObject::ndFunction([this, diagDamp](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(RebuildMatrix);
+			RebuildMassMatrix(diagDamp, threadIndex, threadCount);
+		});
+
+		threadPool->ParallelExecute(CalculateCoefficients);
+		threadPool->ParallelExecute(ConditionMatrix);
+		threadPool->ParallelExecute(RebuildMatrix);
+	}
+	else
+	{
+		CalculateLoopMassMatrixCoefficients(diagDamp, 0, 1);
+		ConditionMassMatrix(0, 1);
+		RebuildMassMatrix(diagDamp, 0, 1);
+	}
 
 	if (m_blockSize) 
 	{
@@ -1024,7 +1401,16 @@ void ndSkeletonContainer::CalculateJointAccel(const ndJacobian* const internalFo
 {
 	const ndSpatialVector zero(ndSpatialVector::m_zero);
 	const ndInt32 nodeCount = m_nodeList.GetCount();
-	for (ndInt32 i = 0; i < nodeCount - 1; ++i) 
+	CalculateJointAccel(internalForces, accel, 0, nodeCount - 1);
+	ndAssert((nodeCount - 1) == m_nodesOrder[nodeCount - 1]->m_index);
+	accel[nodeCount - 1].m_body = zero;
+	accel[nodeCount - 1].m_joint = zero;
+}
+
+void ndSkeletonContainer::CalculateJointAccel(const ndJacobian* const internalForces, ndForcePair* const accel, ndInt32 start, ndInt32 end) const
+{
+	const ndSpatialVector zero(ndSpatialVector::m_zero);
+	for (ndInt32 i = start; i < end; ++i) 
 	{
 		ndNode* const node = m_nodesOrder[i];
 		ndAssert(i == node->m_index);
@@ -1055,9 +1441,6 @@ void ndSkeletonContainer::CalculateJointAccel(const ndJacobian* const internalFo
 			a.m_joint[j] = -(rhs->m_coordenateAccel - rhs->m_force * rhs->m_diagDamp - diag.AddHorizontal().GetScalar());
 		}
 	}
-	ndAssert((nodeCount - 1) == m_nodesOrder[nodeCount - 1]->m_index);
-	accel[nodeCount - 1].m_body = zero;
-	accel[nodeCount - 1].m_joint = zero;
 }
 
 void ndSkeletonContainer::CalculateForce(ndForcePair* const force, const ndForcePair* const accel) const
@@ -1432,7 +1815,84 @@ void ndSkeletonContainer::InitMassMatrix(const ndLeftHandSide* const leftHandSid
 
 	if (m_auxiliaryRowCount)
 	{
-		InitLoopMassMatrix();
+		InitLoopMassMatrix(nullptr);
+	}
+}
+
+void ndSkeletonContainer::InitMassMatrix(ndThreadPool& threadPool, const ndLeftHandSide* const leftHandSide, ndRightHandSide* const rightHandSide)
+{
+	D_TRACKTIME();
+	ndAssert(m_branches.GetCount());
+	if (m_isResting)
+	{
+		return;
+	}
+	m_leftHandSide = leftHandSide;
+	m_rightHandSide = rightHandSide;
+
+	const ndInt32 nodeCount = m_nodeList.GetCount();
+	const ndInt32 branchCount = m_branches.GetCount();
+	ndSpatialMatrix* const bodyMassArray = ndAlloca(ndSpatialMatrix, nodeCount);
+	ndSpatialMatrix* const jointMassArray = ndAlloca(ndSpatialMatrix, nodeCount);
+	ndInt32* const branchRowCount = ndAlloca(ndInt32, branchCount);
+	ndInt32* const branchAuxiliaryCount = ndAlloca(ndInt32, branchCount);
+
+	auto FactorizeBranches = ndMakeObject::ndFunction([this, leftHandSide, rightHandSide, bodyMassArray, jointMassArray, branchRowCount, branchAuxiliaryCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(FactorizeBranches);
+		for (ndInt32 i = threadIndex; i < m_branches.GetCount(); i += threadCount)
+		{
+			ndInt32 rowCount = 0;
+			ndInt32 auxiliaryCount = 0;
+			const ndBranch& branch = m_branches[i];
+			for (ndInt32 j = branch.m_start; j < branch.m_end; ++j)
+			{
+				ndNode* const node = m_nodesOrder[j];
+				rowCount += node->m_joint->m_rowCount;
+				auxiliaryCount += node->Factorize(leftHandSide, rightHandSide, bodyMassArray, jointMassArray);
+			}
+			branchRowCount[i] = rowCount;
+			branchAuxiliaryCount[i] = auxiliaryCount;
+		}
+	});
+	threadPool.ParallelExecute(FactorizeBranches);
+
+	ndInt32 rowCount = 0;
+	ndInt32 auxiliaryCount = 0;
+	for (ndInt32 i = 0; i < branchCount; ++i)
+	{
+		rowCount += branchRowCount[i];
+		auxiliaryCount += branchAuxiliaryCount[i];
+	}
+
+	// the trunk goes after all the branches, the root is the last node 
+	const ndInt32 trunkCount = m_trunk.GetCount() - 1;
+	for (ndInt32 i = 0; i < trunkCount; ++i)
+	{
+		ndNode* const node = m_trunk[i];
+		rowCount += node->m_joint->m_rowCount;
+		auxiliaryCount += node->Factorize(leftHandSide, rightHandSide, bodyMassArray, jointMassArray);
+	}
+	m_trunk[trunkCount]->Factorize(leftHandSide, rightHandSide, bodyMassArray, jointMassArray);
+
+	m_rowCount = rowCount;
+	m_auxiliaryRowCount = auxiliaryCount;
+
+	ndInt32 loopRowCount = 0;
+	const ndInt32 loopCount = m_loopCount + m_dynamicsLoopCount;
+	for (ndInt32 j = 0; j < loopCount; ++j)
+	{
+		const ndConstraint* const joint = m_loopingJoints[j];
+		loopRowCount += joint->m_rowCount;
+	}
+
+	m_loopRowCount = loopRowCount;
+	m_rowCount += m_loopRowCount;
+	m_auxiliaryRowCount += m_loopRowCount;
+
+	if (m_auxiliaryRowCount)
+	{
+		InitLoopMassMatrix(&threadPool);
 	}
 }
 
@@ -1458,6 +1918,118 @@ void ndSkeletonContainer::CalculateReactionForces(ndJacobian* const internalForc
 	}
 }
 
+void ndSkeletonContainer::CalculateReactionForces(ndThreadPool& threadPool, ndJacobian* const internalForces)
+{
+	ndAssert(m_branches.GetCount());
+	if (!m_isResting)
+	{
+		D_TRACKTIME();
+		const ndInt32 nodeCount = m_nodeList.GetCount();
+		ndForcePair* const force = ndAlloca(ndForcePair, nodeCount);
+		ndForcePair* const accel = ndAlloca(ndForcePair, nodeCount);
+
+		// same sweeps as CalculateForce, but each branch runs on its own thread.
+		// the root of a branch is scaled and back substituted with the trunk, 
+		// because its parent is a trunk node.
+		auto SolveBranchesForward = ndMakeObject::ndFunction([this, internalForces, force, accel](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(SolveBranchesForward);
+			for (ndInt32 i = threadIndex; i < m_branches.GetCount(); i += threadCount)
+			{
+				const ndBranch& branch = m_branches[i];
+				CalculateJointAccel(internalForces, accel, branch.m_start, branch.m_end);
+				for (ndInt32 j = branch.m_start; j < branch.m_end; ++j)
+				{
+					SolveForwardNode(force, accel, j);
+				}
+				for (ndInt32 j = branch.m_start; j < branch.m_end - 1; ++j)
+				{
+					ndNode* const node = m_nodesOrder[j];
+					node->BodyDiagInvTimeSolution(force[j]);
+					node->JointDiagInvTimeSolution(force[j]);
+				}
+			}
+		});
+
+		auto SolveBranchesBackward = ndMakeObject::ndFunction([this, force](ndInt32 threadIndex, ndInt32 threadCount)
+		{
+			D_TRACKTIME_NAMED(SolveBranchesBackward);
+			for (ndInt32 i = threadIndex; i < m_branches.GetCount(); i += threadCount)
+			{
+				const ndBranch& branch = m_branches[i];
+				for (ndInt32 j = branch.m_end - 2; j >= branch.m_start; --j)
+				{
+					ndNode* const node = m_nodesOrder[j];
+					ndForcePair& f = force[j];
+					node->JointJacobianTimeSolutionBackward(f, force[node->m_parent->m_index]);
+					node->BodyJacobianTimeSolutionBackward(f);
+				}
+			}
+		});
+
+		threadPool.ParallelExecute(SolveBranchesForward);
+
+		const ndInt32 trunkCount = m_trunk.GetCount() - 1;
+		for (ndInt32 i = 0; i < trunkCount; ++i)
+		{
+			const ndInt32 index = m_trunk[i]->m_index;
+			CalculateJointAccel(internalForces, accel, index, index + 1);
+			SolveForwardNode(force, accel, index);
+		}
+
+		const ndSpatialVector zero(ndSpatialVector::m_zero);
+		ndNode* const root = m_nodesOrder[nodeCount - 1];
+		accel[nodeCount - 1].m_body = zero;
+		accel[nodeCount - 1].m_joint = zero;
+		force[nodeCount - 1] = accel[nodeCount - 1];
+		for (ndNode* child = root->m_child; child; child = child->m_sibling)
+		{
+			child->BodyJacobianTimeMassForward(force[child->m_index], force[nodeCount - 1]);
+		}
+
+		for (ndInt32 i = 0; i < trunkCount; ++i)
+		{
+			ndNode* const node = m_trunk[i];
+			node->BodyDiagInvTimeSolution(force[node->m_index]);
+			node->JointDiagInvTimeSolution(force[node->m_index]);
+		}
+		for (ndInt32 i = 0; i < m_branches.GetCount(); ++i)
+		{
+			const ndInt32 index = m_branches[i].m_end - 1;
+			ndNode* const node = m_nodesOrder[index];
+			node->BodyDiagInvTimeSolution(force[index]);
+			node->JointDiagInvTimeSolution(force[index]);
+		}
+		root->BodyDiagInvTimeSolution(force[nodeCount - 1]);
+
+		for (ndInt32 i = trunkCount - 1; i >= 0; --i)
+		{
+			ndNode* const node = m_trunk[i];
+			ndForcePair& f = force[node->m_index];
+			node->JointJacobianTimeSolutionBackward(f, force[node->m_parent->m_index]);
+			node->BodyJacobianTimeSolutionBackward(f);
+		}
+		for (ndInt32 i = 0; i < m_branches.GetCount(); ++i)
+		{
+			const ndInt32 index = m_branches[i].m_end - 1;
+			ndNode* const node = m_nodesOrder[index];
+			node->JointJacobianTimeSolutionBackward(force[index], force[node->m_parent->m_index]);
+			node->BodyJacobianTimeSolutionBackward(force[index]);
+		}
+
+		threadPool.ParallelExecute(SolveBranchesBackward);
+
+		if (m_auxiliaryRowCount)
+		{
+			SolveAuxiliary(internalForces, accel, force);
+		}
+		else
+		{
+			UpdateForces(internalForces, force);
+		}
+	}
+}
+
 void ndSkeletonContainer::CalculateJointAccelImmediate(ndForcePair* const accel) const
 {
 	const ndSpatialVector zero(ndSpatialVector::m_zero);
@@ -24,6 +24,12 @@
 
 #include "ndNewtonStdafx.h"
 
+// skeletons with at least this many nodes are split into branches 
+// that are factorized and solved by all threads in parallel.
+#define D_SKELETON_PARALLEL_NODE_COUNT	64
+#define D_SKELETON_MAX_BRANCHES			16
+#define D_SKELETON_MAX_CACHED_PLANS		256
+
 class ndIkSolver;
 class ndJointBilateralConstraint;
 
@@ -113,6 +119,85 @@ class ndSkeletonContainer
 		ndInt8 m_swapJacobianBodiesIndex;
 	};
 
+	// a subtree of the skeleton, in the node order it is the 
+	// continuous range [m_start, m_end), and m_end - 1 is its root.
+	class ndBranch
+	{
+		public:
+		ndInt32 m_start;
+		ndInt32 m_end;
+	};
+
+	// the symbolic part of the factorization only depends on the skeleton
+	// topology, so it is cached and shared by all the skeletons with the
+	// same structure. the key is the exact description of that structure.
+	class ndPlan: public ndClassAlloc
+	{
+		public:
+		ndPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash);
+		bool IsEqual(const ndInt32* const key, ndInt32 size) const;
+
+		ndArray<ndInt32> m_key;
+		ndUnsigned64 m_hash;
+	};
+
+	// node order and branches, as indices in the order the nodes were added.
+	class ndTopologyPlan: public ndPlan
+	{
+		public:
+		ndTopologyPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash);
+
+		ndArray<ndInt32> m_nodesOrder;
+		ndArray<ndBranch> m_branches;
+		ndArray<ndInt32> m_trunk;
+	};
+
+	// layout of the auxiliary rows and sparsity of the loop mass matrix.
+	// for each auxiliary row, the primary rows that share a body with it.
+	class ndLoopPlan: public ndPlan
+	{
+		public:
+		ndLoopPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash);
+
+		ndArray<ndInt32> m_auxiliaryOrder;
+		ndArray<ndInt32> m_sparseStart;
+		ndArray<ndInt32> m_sparseIndex;
+		ndInt32 m_blockSize;
+	};
+
+	class ndPlanCache
+	{
+		public:
+		template <class T>
+		class ndPlanTree: public ndTree<ndSharedPtr<T>, ndUnsigned64, ndContainersFreeListAlloc<ndSharedPtr<T>>>
+		{
+			public:
+			ndPlanTree()
+				:ndTree<ndSharedPtr<T>, ndUnsigned64, ndContainersFreeListAlloc<ndSharedPtr<T>>>()
+			{
+			}
+		};
+
+		ndPlanCache();
+		ndSharedPtr<ndTopologyPlan> FindTopologyPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash);
+		ndSharedPtr<ndLoopPlan> FindLoopPlan(const ndInt32* const key, ndInt32 size, ndUnsigned64 hash);
+		void AddTopologyPlan(const ndSharedPtr<ndTopologyPlan>& plan);
+		void AddLoopPlan(const ndSharedPtr<ndLoopPlan>& plan);
+
+		ndPlanTree<ndTopologyPlan> m_topologyPlans;
+		ndPlanTree<ndLoopPlan> m_loopPlans;
+		ndSpinLock m_lock;
+	};
+
+	class ndBodyNodeMap: public ndTree<ndInt32, const ndBodyKinematic*, ndContainersFreeListAlloc<ndInt32>>
+	{
+		public:
+		ndBodyNodeMap()
+			:ndTree<ndInt32, const ndBodyKinematic*, ndContainersFreeListAlloc<ndInt32>>()
+		{
+		}
+	};
+
 	class ndNodeList : public ndList<ndNode, ndContainersFreeListAlloc<ndSkeletonContainer::ndNode> >
 	{
 		public:
@@ -131,16 +216,21 @@ class ndSkeletonContainer
 	ndNode* AddChild(ndJointBilateralConstraint* const joint, ndNode* const parent);
 	void Finalize(ndInt32 loopJoints, ndJointBilateralConstraint** const loopJointArray);
 
-	void InitLoopMassMatrix();
 	void ClearCloseLoopJoints();
 	void AddCloseLoopJoint(ndConstraint* const joint);
 	void CalculateReactionForces(ndJacobian* const internalForces);
 	void InitMassMatrix(const ndLeftHandSide* const matrixRow, ndRightHandSide* const rightHandSide);
+	void InitMassMatrix(ndThreadPool& threadPool, const ndLeftHandSide* const matrixRow, ndRightHandSide* const rightHandSide);
+	void CalculateReactionForces(ndThreadPool& threadPool, ndJacobian* const internalForces);
+	void InitLoopMassMatrix(ndThreadPool* const threadPool);
+	void CalculateBranches();
+	ndInt32 GetBodyNodeIndex(const ndBodyKinematic* const body) const;
+	const ndLoopPlan* GetLoopPlan(const ndInt32* const boundRow, const ndInt32* const primaryBodies, const ndInt32* const auxiliaryBodies);
 	void CalculateBufferSizeInBytes();
-	void ConditionMassMatrix() const;
+	void ConditionMassMatrix(ndInt32 threadIndex, ndInt32 threadCount) const;
 	void SortGraph(ndNode* const root, ndInt32& index);
-	void RebuildMassMatrix(const ndFloat32* const diagDamp) const;
-	void CalculateLoopMassMatrixCoefficients(ndFloat32* const diagDamp);
+	void RebuildMassMatrix(const ndFloat32* const diagDamp, ndInt32 threadIndex, ndInt32 threadCount) const;
+	void CalculateLoopMassMatrixCoefficients(ndFloat32* const diagDamp, ndInt32 threadIndex, ndInt32 threadCount);
 	void FactorizeMatrix(ndInt32 size, ndInt32 stride, ndFloat32* const matrix, ndFloat32* const diagDamp) const;
 	void SolveAuxiliary(ndJacobian* const internalForces, const ndForcePair* const accel, ndForcePair* const force) const;
 	void SolveBlockLcp(ndInt32 size, ndInt32 blockSize, const ndFloat32* const x0, ndFloat32* const x, ndFloat32* const b, const ndFloat32* const low, const ndFloat32* const high, const ndInt32* const normalIndex, ndFloat32 accelTol) const;
@@ -151,6 +241,8 @@ class ndSkeletonContainer
 	inline void UpdateForces(ndJacobian* const internalForces, const ndForcePair* const force) const;
 	inline void CalculateJointAccel(const ndJacobian* const internalForces, ndForcePair* const accel) const;
 	inline void SolveForward(ndForcePair* const force, const ndForcePair* const accel, ndInt32 startNode) const;
+	inline void SolveForwardNode(ndForcePair* const force, const ndForcePair* const accel, ndInt32 index) const;
+	inline void CalculateJointAccel(const ndJacobian* const internalForces, ndForcePair* const accel, ndInt32 start, ndInt32 end) const;
 
 	void SolveImmediate(ndIkSolver& solverInfo);
 	void UpdateForcesImmediate(const ndForcePair* const force) const;
@@ -170,6 +262,12 @@ class ndSkeletonContainer
 
 	ndNodeList m_nodeList;
 	ndArray<ndConstraint*> m_loopingJoints;
+	ndArray<ndBranch> m_branches;
+	ndArray<ndNode*> m_trunk;
+	ndArray<ndInt32> m_loopKey;
+	ndBodyNodeMap m_bodyNodeMap;
+	ndSharedPtr<ndLoopPlan> m_loopPlan;
+	ndPlanCache* m_planCache;
 	ndArray<ndInt8> m_auxiliaryMemoryBuffer;
 	ndSpinLock m_lock;
 	ndInt32 m_blockSize;
@@ -186,6 +284,7 @@ class ndSkeletonContainer
 	friend class ndSkeletonQueue;
 	friend class ndDynamicsUpdate;
 	friend class ndDynamicsUpdateSoa;
+	friend class ndDynamicsUpdateSubstep;
 	friend class ndDynamicsUpdateAvx2;
 	friend class ndDynamicsUpdateSycl;
 	friend class ndDynamicsUpdateCuda;
@@ -32,6 +32,7 @@ class ndSkeletonList: public ndList<ndSkeletonContainer, ndContainersFreeListAll
 	public:
 	ndSkeletonList()
 		:ndList<ndSkeletonContainer, ndContainersFreeListAlloc<ndSkeletonContainer>>()
+		,m_planCache()
 		,m_skelListIsDirty(false)
 	{
 	}
@@ -41,9 +42,11 @@ class ndSkeletonList: public ndList<ndSkeletonContainer, ndContainersFreeListAll
 		ndNode* const node = Append();
 		ndSkeletonContainer* const container = &node->GetInfo();
 		container->Init(rootBody);
+		container->m_planCache = &m_planCache;
 		return container;
 	}
 
+	ndSkeletonContainer::ndPlanCache m_planCache;
 	bool m_skelListIsDirty;
 };
 
@@ -28,6 +28,9 @@
 #include "ndSkeletonList.h"
 #include "ndDynamicsUpdate.h"
 #include "ndDynamicsUpdateSoa.h"
+#include "ndDynamicsUpdateIsland.h"
+#include "ndDynamicsUpdateSubstep.h"
+#include "ndDynamicsUpdateColored.h"
 #include "ndJointBilateralConstraint.h"
 
 #ifdef _D_USE_AVX2_SOLVER
@@ -104,11 +107,16 @@ ndWorld::ndWorld()
 	,m_solver(nullptr)
 	,m_jointList()
 	,m_modelList()
+	,m_modelBatchList()
 	,m_skeletonList()
 	,m_deletedBodies()
 	,m_deletedModels()
 	,m_deletedJoints()
 	,m_activeSkeletons(256)
+	,m_sleepingIslands()
+	,m_sleepingBodies()
+	,m_freeSleepingIslands()
+	,m_origin(ndBigVector::m_wOne)
 	,m_deletedLock()
 	,m_timestep(ndFloat32 (0.0f))
 	,m_freezeAccel2(D_FREEZE_ACCEL2)
@@ -118,8 +126,11 @@ ndWorld::ndWorld()
 	,m_averageFramesCount(ndFloat32(0.0f))
 	,m_lastExecutionTime(ndFloat32(0.0f))
 	,m_subSteps(1)
+	,m_sleepingBodyHoles(0)
 	,m_solverMode(ndStandardSolver)
 	,m_solverIterations(4)
+	,m_solverTolerance(D_SOLVER_DEFAULT_TOLERANCE)
+	,m_originCellSize(ndFloat32(0.0f))
 	,m_inUpdate(false)
 {
 	// start the engine thread;
@@ -189,6 +200,7 @@ void ndWorld::CleanUp()
 		ndSharedPtr<ndModel>& model = m_modelList.GetFirst()->GetInfo();
 		m_modelList.RemoveModel(model);
 	}
+	m_modelBatchList.RemoveAll();
 
 	while (m_scene->m_particleSetList.GetFirst())
 	{
@@ -202,6 +214,12 @@ void ndWorld::CleanUp()
 		RemoveBody(body);
 	}
 
+	ndAssert(!GetSleepingIslandCount());
+	m_sleepingIslands.SetCount(0);
+	m_sleepingBodies.SetCount(0);
+	m_freeSleepingIslands.SetCount(0);
+	m_sleepingBodyHoles = 0;
+
 	ndBody::m_uniqueIdCount = 1;
 	m_scene->Cleanup();
 }
@@ -262,6 +280,97 @@ void ndWorld::SetSolverIterations(ndInt32 iterations)
 	m_solverIterations = ndInt32(ndMax(4, iterations));
 }
 
+ndFloat32 ndWorld::GetSolverTolerance() const
+{
+	return m_solverTolerance;
+}
+
+void ndWorld::SetSolverTolerance(ndFloat32 tolerance)
+{
+	m_solverTolerance = ndMax(tolerance, ndFloat32(0.0f));
+}
+
+ndBigVector ndWorld::GetOrigin() const
+{
+	return m_origin;
+}
+
+void ndWorld::SetOrigin(const ndBigVector& origin)
+{
+	Sync();
+	const ndBigVector offset((origin - m_origin) & ndBigVector::m_triplexMask);
+	m_origin = origin & ndBigVector::m_triplexMask;
+	m_origin.m_w = ndFloat64(1.0f);
+
+	m_scene->ShiftOrigin(offset);
+
+	// joints attached to the sentinel have the world pivot in their local frame
+	const ndVector shift(offset);
+	const ndBodyKinematic* const sentinel = GetSentinelBody();
+	for (ndJointList::ndNode* node = m_jointList.GetFirst(); node; node = node->GetNext())
+	{
+		ndJointBilateralConstraint* const joint = *node->GetInfo();
+		if (joint->GetBody0() == sentinel)
+		{
+			joint->m_localMatrix0.m_posit -= shift;
+		}
+		if (joint->GetBody1() == sentinel)
+		{
+			joint->m_localMatrix1.m_posit -= shift;
+		}
+	}
+}
+
+ndFloat32 ndWorld::GetOriginCellSize() const
+{
+	return m_originCellSize;
+}
+
+void ndWorld::SetOriginCellSize(ndFloat32 size)
+{
+	m_originCellSize = ndMax(size, ndFloat32(0.0f));
+}
+
+bool ndWorld::UpdateOriginCell(const ndBigVector& focus)
+{
+	if (m_originCellSize > ndFloat32(0.0f))
+	{
+		const ndFloat64 cellSize = m_originCellSize;
+		const ndBigVector dist(((focus - m_origin) & ndBigVector::m_triplexMask).Abs());
+		if ((dist.m_x > cellSize) || (dist.m_y > cellSize) || (dist.m_z > cellSize))
+		{
+			// snap to the cell grid so that the origin does not depend on the path
+			const ndBigVector cell(
+				floor(focus.m_x / cellSize + ndFloat64(0.5f)) * cellSize,
+				floor(focus.m_y / cellSize + ndFloat64(0.5f)) * cellSize,
+				floor(focus.m_z / cellSize + ndFloat64(0.5f)) * cellSize, ndFloat64(1.0f));
+			SetOrigin(cell);
+			return true;
+		}
+	}
+	return false;
+}
+
+ndInt32 ndWorld::GetMaxSolverPasses() const
+{
+	return m_solver->GetMaxPassesUsed();
+}
+
+ndFloat32 ndWorld::GetAverageSolverPasses() const
+{
+	return m_solver->GetAveragePassesUsed();
+}
+
+const ndArray<ndInt32>& ndWorld::GetIslandSolverPasses() const
+{
+	return m_solver->GetIslandPassesUsed();
+}
+
+ndInt32 ndWorld::GetSleepingIslandCount() const
+{
+	return m_sleepingIslands.GetCount() - m_freeSleepingIslands.GetCount();
+}
+
 ndContactNotify* ndWorld::GetContactNotify() const
 {
 	return m_scene->GetContactNotify();
@@ -396,6 +505,18 @@ void ndWorld::AddModel(const ndSharedPtr<ndModel>& model)
 	m_modelList.AddModel(model, this);
 }
 
+void ndWorld::AddModelBatch(const ndSharedPtr<ndModelBatch>& batch)
+{
+	Sync();
+	#ifdef _DEBUG
+	for (ndList<ndSharedPtr<ndModelBatch>>::ndNode* node = m_modelBatchList.GetFirst(); node; node = node->GetNext())
+	{
+		ndAssert(*node->GetInfo() != *batch);
+	}
+	#endif
+	m_modelBatchList.Append(batch);
+}
+
 ndInt32 ndWorld::CompareJointByInvMass(const ndJointBilateralConstraint* const jointA, const ndJointBilateralConstraint* const jointB, void*)
 {
 	ndInt32 modeA = jointA->GetSolverModel();
@@ -484,7 +605,8 @@ void ndWorld::ThreadFunction()
 
 	PreUpdate(m_timestep);
 
-	ndInt32 const steps = m_subSteps;
+	// the substep solver subdivides the step internally with a single collision pass
+	ndInt32 const steps = (m_solverMode == ndSubstepSolver) ? 1 : m_subSteps;
 	ndFloat32 timestep = m_timestep / (ndFloat32)steps;
 	for (ndInt32 i = 0; i < steps; ++i)
 	{
@@ -552,9 +674,15 @@ void ndWorld::SubStepUpdate(ndFloat32 timestep)
 	// Update all models
 	ModelUpdate();
 
+	// batched work requested by the models
+	ModelBatchUpdate();
+
 	// calculate internal forces, integrate bodies and update matrices.
 	ndAssert(m_solver);
+	WakeSleepingIslands();
 	m_solver->Update();
+	WakeSleepingIslands();
+	CacheSleepingIslands();
 
 	// second pass on models
 	ModelPostUpdate();
@@ -562,6 +690,205 @@ void ndWorld::SubStepUpdate(ndFloat32 timestep)
 	m_scene->m_subStepNumber++;
 }
 
+void ndWorld::FreeSleepingIsland(ndInt32 index)
+{
+	ndSleepingIsland& island = m_sleepingIslands[index];
+	m_sleepingBodyHoles += island.m_count;
+	island.m_count = 0;
+	island.m_awake = 0;
+	m_freeSleepingIslands.PushBack(index);
+}
+
+void ndWorld::WakeSleepingIsland(ndInt32 index)
+{
+	// all the bodies wake in one go, the contacts between them were never 
+	// recalculated while they slept, so they keep their points and forces 
+	// and warm start the solver.
+	const ndSleepingIsland& island = m_sleepingIslands[index];
+	for (ndInt32 i = 0; i < island.m_count; ++i)
+	{
+		ndBodyKinematic* const body = m_sleepingBodies[island.m_start + i];
+		ndAssert(body->m_sleepIsland == index);
+		body->m_sleepIsland = -1;
+		body->m_equilibrium = 0;
+		body->m_equilibrium0 = 0;
+		body->m_sleepingCounter = 0;
+	}
+	FreeSleepingIsland(index);
+}
+
+void ndWorld::CompactSleepingIslands()
+{
+	D_TRACKTIME();
+	ndInt32 count = 0;
+	for (ndInt32 i = 0; i < m_sleepingIslands.GetCount(); ++i)
+	{
+		ndSleepingIsland& island = m_sleepingIslands[i];
+		const ndInt32 start = island.m_start;
+		island.m_start = count;
+		for (ndInt32 j = 0; j < island.m_count; ++j)
+		{
+			m_sleepingBodies[count] = m_sleepingBodies[start + j];
+			count++;
+		}
+	}
+	m_sleepingBodies.SetCount(count);
+	m_sleepingBodyHoles = 0;
+}
+
+void ndWorld::WakeSleepingIslands()
+{
+	D_TRACKTIME();
+	if (!GetSleepingIslandCount())
+	{
+		return;
+	}
+
+	// an island wakes as a whole when one of its bodies wakes, before the solver 
+	// by a force, a velocity or a matrix change, and after the solver by the 
+	// impulse of a moving body touching it.
+	auto MarkIsland = [this](const ndConstraint* const joint)
+	{
+		const ndBodyKinematic* const body0 = joint->GetBody0();
+		const ndBodyKinematic* const body1 = joint->GetBody1();
+		if ((body0->m_sleepIsland >= 0) && !body0->m_equilibrium)
+		{
+			m_sleepingIslands[body0->m_sleepIsland].m_awake = 1;
+		}
+		if ((body1->m_sleepIsland >= 0) && !body1->m_equilibrium)
+		{
+			m_sleepingIslands[body1->m_sleepIsland].m_awake = 1;
+		}
+	};
+
+	auto MarkAwakeIslands = ndMakeObject::ndFunction([this, &MarkIsland](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(MarkAwakeIslands);
+		const ndArray<ndConstraint*>& contactArray = m_scene->GetActiveContactArray();
+		const ndStartEnd startEnd(contactArray.GetCount(), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			MarkIsland(contactArray[i]);
+		}
+	});
+	m_scene->ParallelExecute(MarkAwakeIslands);
+
+	for (ndJointList::ndNode* node = m_jointList.GetFirst(); node; node = node->GetNext())
+	{
+		const ndJointBilateralConstraint* const joint = *node->GetInfo();
+		if (joint->IsActive())
+		{
+			MarkIsland(joint);
+		}
+	}
+
+	for (ndInt32 i = 0; i < m_sleepingIslands.GetCount(); ++i)
+	{
+		if (m_sleepingIslands[i].m_awake)
+		{
+			WakeSleepingIsland(i);
+		}
+	}
+}
+
+void ndWorld::BuildSleepingIsland(ndBodyKinematic* const body)
+{
+	ndInt32 index = m_sleepingIslands.GetCount();
+	if (m_freeSleepingIslands.GetCount())
+	{
+		index = m_freeSleepingIslands[m_freeSleepingIslands.GetCount() - 1];
+		m_freeSleepingIslands.SetCount(m_freeSleepingIslands.GetCount() - 1);
+	}
+	else
+	{
+		m_sleepingIslands.PushBack(ndSleepingIsland());
+	}
+
+	const ndInt32 start = m_sleepingBodies.GetCount();
+	m_sleepingIslands[index].m_start = start;
+	m_sleepingIslands[index].m_awake = 0;
+
+	// flood the sleeping bodies connected to this one, the island records are 
+	// the queue. an island that fell asleep in an earlier step is merged in.
+	auto AddBody = [this, index](ndBodyKinematic* const other)
+	{
+		if (other->m_isStatic || !other->m_equilibrium || (other->m_sleepIsland == index))
+		{
+			return;
+		}
+		const ndInt32 merged = other->m_sleepIsland;
+		if (merged >= 0)
+		{
+			const ndSleepingIsland& mergedIsland = m_sleepingIslands[merged];
+			for (ndInt32 i = 0; i < mergedIsland.m_count; ++i)
+			{
+				ndBodyKinematic* const mergedBody = m_sleepingBodies[mergedIsland.m_start + i];
+				mergedBody->m_sleepIsland = index;
+				m_sleepingBodies.PushBack(mergedBody);
+			}
+			FreeSleepingIsland(merged);
+		}
+		else
+		{
+			other->m_sleepIsland = index;
+			m_sleepingBodies.PushBack(other);
+		}
+	};
+
+	AddBody(body);
+	for (ndInt32 i = start; i < m_sleepingBodies.GetCount(); ++i)
+	{
+		ndBodyKinematic* const member = m_sleepingBodies[i];
+		const ndBodyKinematic::ndContactMap& contactMap = member->GetContactMap();
+		ndBodyKinematic::ndContactMap::Iterator it(contactMap);
+		for (it.Begin(); it; it++)
+		{
+			const ndContact* const contact = *it;
+			if (contact->IsActive())
+			{
+				AddBody((contact->GetBody0() == member) ? contact->GetBody1() : contact->GetBody0());
+			}
+		}
+
+		const ndBodyKinematic::ndJointList& jointList = member->GetJointList();
+		for (ndBodyKinematic::ndJointList::ndNode* node = jointList.GetFirst(); node; node = node->GetNext())
+		{
+			const ndJointBilateralConstraint* const joint = node->GetInfo();
+			if (joint->IsActive())
+			{
+				AddBody((joint->GetBody0() == member) ? joint->GetBody1() : joint->GetBody0());
+			}
+		}
+	}
+	m_sleepingIslands[index].m_count = m_sleepingBodies.GetCount() - start;
+}
+
+void ndWorld::CacheSleepingIslands()
+{
+	D_TRACKTIME();
+	// only the joints solved in this step can have bodies that just fell asleep.
+	const ndArray<ndConstraint*>& jointArray = m_scene->GetActiveContactArray();
+	for (ndInt32 i = 0; i < jointArray.GetCount(); ++i)
+	{
+		const ndConstraint* const joint = jointArray[i];
+		ndBodyKinematic* const body0 = joint->GetBody0();
+		ndBodyKinematic* const body1 = joint->GetBody1();
+		if (!body0->m_isStatic && body0->m_equilibrium && (body0->m_sleepIsland < 0))
+		{
+			BuildSleepingIsland(body0);
+		}
+		if (!body1->m_isStatic && body1->m_equilibrium && (body1->m_sleepIsland < 0))
+		{
+			BuildSleepingIsland(body1);
+		}
+	}
+
+	if (m_sleepingBodyHoles > (m_sleepingBodies.GetCount() >> 1))
+	{
+		CompactSleepingIslands();
+	}
+}
+
 void ndWorld::ParticleUpdate(ndFloat32 timestep)
 {
 	D_TRACKTIME();
@@ -589,6 +916,16 @@ void ndWorld::ModelUpdate()
 	m_scene->ParallelExecute(ModelUpdate);
 }
 
+void ndWorld::ModelBatchUpdate()
+{
+	D_TRACKTIME();
+	const ndFloat32 timestep = m_scene->GetTimestep();
+	for (ndList<ndSharedPtr<ndModelBatch>>::ndNode* node = m_modelBatchList.GetFirst(); node; node = node->GetNext())
+	{
+		node->GetInfo()->Update(this, timestep);
+	}
+}
+
 void ndWorld::ModelPostUpdate()
 {
 	D_TRACKTIME();
@@ -940,6 +1277,39 @@ void ndWorld::SelectSolver(ndSolverModes solverMode)
 				break;
 			}
 
+			case ndColoredGaussSeidelSolver:
+			{
+				ndWorldScene* const newScene = new ndWorldScene(*((ndWorldScene*)m_scene));
+				delete m_scene;
+				m_scene = newScene;
+
+				m_solverMode = solverMode;
+				m_solver = new ndDynamicsUpdateColored(this);
+				break;
+			}
+
+			case ndIslandParallelSolver:
+			{
+				ndWorldScene* const newScene = new ndWorldScene(*((ndWorldScene*)m_scene));
+				delete m_scene;
+				m_scene = newScene;
+
+				m_solverMode = solverMode;
+				m_solver = new ndDynamicsUpdateIsland(this);
+				break;
+			}
+
+			case ndSubstepSolver:
+			{
+				ndWorldScene* const newScene = new ndWorldScene(*((ndWorldScene*)m_scene));
+				delete m_scene;
+				m_scene = newScene;
+
+				m_solverMode = solverMode;
+				m_solver = new ndDynamicsUpdateSubstep(this);
+				break;
+			}
+
 			case ndSimdAvx2Solver:
 			{
 				#ifdef _D_USE_AVX2_SOLVER
@@ -1107,6 +1477,12 @@ void ndWorld::Update(ndFloat32 timestep)
 
 void ndWorld::RemoveBody(ndSharedPtr<ndBody>& body)
 {
+	// the rest of the pile loses its support, so it wakes up with the body.
+	ndBodyKinematic* const kinematicBody = body->GetAsBodyKinematic();
+	if (kinematicBody && (kinematicBody->m_sleepIsland >= 0))
+	{
+		WakeSleepingIsland(kinematicBody->m_sleepIsland);
+	}
 	m_scene->RemoveBody(body);
 }
 
@@ -1174,6 +1550,19 @@ void ndWorld::RemoveModel(ndModel* const model)
 	}
 }
 
+void ndWorld::RemoveModelBatch(ndModelBatch* const batch)
+{
+	Sync();
+	for (ndList<ndSharedPtr<ndModelBatch>>::ndNode* node = m_modelBatchList.GetFirst(); node; node = node->GetNext())
+	{
+		if (*node->GetInfo() == batch)
+		{
+			m_modelBatchList.Remove(node);
+			break;
+		}
+	}
+}
+
 void ndWorld::CalculateJointContacts(ndContact* const contact)
 {
 	ndBodyKinematic* const body0 = contact->GetBody0();
@@ -24,6 +24,7 @@
 
 #include "ndNewtonStdafx.h"
 #include "ndModelList.h"
+#include "ndModelBatch.h"
 #include "ndJointList.h"
 #include "ndSkeletonList.h"
 
@@ -41,6 +42,7 @@ class ndJointBilateralConstraint;
 #define D_NEWTON_ENGINE_MINOR_VERSION 00
 
 #define D_SLEEP_ENTRIES			8
+#define D_SOLVER_DEFAULT_TOLERANCE	ndFloat32(0.5f)
 
 D_MSV_NEWTON_ALIGN_32
 class ndWorld: public ndClassAlloc
@@ -54,6 +56,9 @@ class ndWorld: public ndClassAlloc
 		ndCudaSolver,
 		ndSyclSolverCpu,
 		ndSyclSolverGpu,
+		ndColoredGaussSeidelSolver,
+		ndIslandParallelSolver,
+		ndSubstepSolver,
 	};
 
 	D_BASE_CLASS_REFLECTION(ndWorld)
@@ -94,6 +99,11 @@ class ndWorld: public ndClassAlloc
 	D_NEWTON_API virtual void RemoveModel(ndModel* const model);
 	D_NEWTON_API virtual void RemoveJoint(ndJointBilateralConstraint* const joint);
 
+	// batches are updated after the models of each sub step, 
+	// they can not be added or removed while the world is updating.
+	D_NEWTON_API void AddModelBatch(const ndSharedPtr<ndModelBatch>& batch);
+	D_NEWTON_API void RemoveModelBatch(ndModelBatch* const batch);
+
 	D_NEWTON_API const ndJointList& GetJointList() const;
 	D_NEWTON_API const ndModelList& GetModelList() const;
 	D_NEWTON_API const ndBodyListView& GetBodyList() const;
@@ -103,7 +113,35 @@ class ndWorld: public ndClassAlloc
 
 	D_NEWTON_API ndInt32 GetSolverIterations() const;
 	D_NEWTON_API void SetSolverIterations(ndInt32 iterations);
+
+	// joint residual tolerance for the solvers with early termination, 
+	// zero always runs the full solver iterations.
+	D_NEWTON_API ndFloat32 GetSolverTolerance() const;
+	D_NEWTON_API void SetSolverTolerance(ndFloat32 tolerance);
+
+	// solver passes used in the last update, averaged by island.
+	D_NEWTON_API ndInt32 GetMaxSolverPasses() const;
+	D_NEWTON_API ndFloat32 GetAverageSolverPasses() const;
+
+	// solver passes used by each island in the last update, largest islands first.
+	// only filled by the island parallel solver, empty for the other solvers.
+	D_NEWTON_API const ndArray<ndInt32>& GetIslandSolverPasses() const;
+
+	// islands of bodies that went to sleep together, each one wakes as a whole.
+	D_NEWTON_API ndInt32 GetSleepingIslandCount() const;
 	
+	// large worlds run in float coordinates relative to a double precision origin.
+	// moving the origin shifts every body, contact, particle and joint attached 
+	// to the world, application data in world space must be shifted by the caller.
+	D_NEWTON_API ndBigVector GetOrigin() const;
+	D_NEWTON_API void SetOrigin(const ndBigVector& origin);
+
+	// with a cell size, the origin is moved to the cell containing the focus point 
+	// (in global coordinates) when the point is more than one cell away from it.
+	D_NEWTON_API ndFloat32 GetOriginCellSize() const;
+	D_NEWTON_API void SetOriginCellSize(ndFloat32 size);
+	D_NEWTON_API bool UpdateOriginCell(const ndBigVector& focus);
+
 	D_NEWTON_API ndFloat32 GetUpdateTime() const;
 	D_NEWTON_API ndUnsigned32 GetFrameNumber() const;
 	D_NEWTON_API ndUnsigned32 GetSubFrameNumber() const;
@@ -153,12 +191,28 @@ class ndWorld: public ndClassAlloc
 		ndBodyKinematic* m_body;
 	};
 
+	class ndSleepingIsland
+	{
+		public:
+		ndInt32 m_start;
+		ndInt32 m_count;
+		ndUnsigned8 m_awake;
+	};
+
 	void ModelUpdate();
+	void ModelBatchUpdate();
 	void ModelPostUpdate();
 	void CalculateAverageUpdateTime();
 	void SubStepUpdate(ndFloat32 timestep);
 	void ParticleUpdate(ndFloat32 timestep);
 
+	void WakeSleepingIslands();
+	void CacheSleepingIslands();
+	void CompactSleepingIslands();
+	void WakeSleepingIsland(ndInt32 index);
+	void FreeSleepingIsland(ndInt32 index);
+	void BuildSleepingIsland(ndBodyKinematic* const body);
+
 	bool SkeletonJointTest(ndJointBilateralConstraint* const jointA) const;
 	static ndInt32 CompareJointByInvMass(const ndJointBilateralConstraint* const jointA, const ndJointBilateralConstraint* const jointB, void* notUsed);
 
@@ -166,11 +220,16 @@ class ndWorld: public ndClassAlloc
 	ndDynamicsUpdate* m_solver;
 	ndJointList m_jointList;
 	ndModelList m_modelList;
+	ndList<ndSharedPtr<ndModelBatch>> m_modelBatchList;
 	ndSkeletonList m_skeletonList;
 	ndSpecialList<ndBody> m_deletedBodies;
 	ndSpecialList<ndModel> m_deletedModels;
 	ndSpecialList<ndJointBilateralConstraint> m_deletedJoints;
 	ndArray<ndSkeletonContainer*> m_activeSkeletons;
+	ndArray<ndSleepingIsland> m_sleepingIslands;
+	ndArray<ndBodyKinematic*> m_sleepingBodies;
+	ndArray<ndInt32> m_freeSleepingIslands;
+	ndBigVector m_origin;
 	ndSpinLock m_deletedLock;
 
 	ndFloat32 m_timestep;
@@ -183,8 +242,11 @@ class ndWorld: public ndClassAlloc
 	dgSolverProgressiveSleepEntry m_sleepTable[D_SLEEP_ENTRIES];
 
 	ndInt32 m_subSteps;
+	ndInt32 m_sleepingBodyHoles;
 	ndSolverModes m_solverMode;
 	ndInt32 m_solverIterations;
+	ndFloat32 m_solverTolerance;
+	ndFloat32 m_originCellSize;
 	bool m_inUpdate;
 	
 	friend class ndScene;
@@ -194,6 +256,9 @@ class ndWorld: public ndClassAlloc
 	friend class ndSkeletonContainer;
 	friend class ndModelArticulation;
 	friend class ndDynamicsUpdateSoa;
+	friend class ndDynamicsUpdateColored;
+	friend class ndDynamicsUpdateIsland;
+	friend class ndDynamicsUpdateSubstep;
 	friend class ndDynamicsUpdateAvx2;
 	friend class ndDynamicsUpdateSycl;
 	friend class ndDynamicsUpdateCuda;
@@ -0,0 +1,1482 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "ndBrain.h"
+#include "ndBrainLoss.h"
+#include "ndBrainMatrix.h"
+#include "ndBrainKernels.h"
+#include "ndBrainThreadPool.h"
+#include "ndBrainTrainer.h"
+#include "ndBrainLayerLinear.h"
+#include "ndBrainLayerReluActivation.h"
+#include "ndBrainLayerTanhActivation.h"
+#include "ndBrainLayerImagePolling_2x2.h"
+#include "ndBrainLayerConvolutional_2d.h"
+#include "ndBrainLayerCrossCorrelation_2d.h"
+#include "ndBrainVectorEnvironment.h"
+#include "ndBrainPrioritizedReplayBuffer.h"
+#include "ndBrainSnapshot.h"
+#include "ndBrainSaveLoad.h"
+#include "ndBrainInference.h"
+#include "ndBrainBinaryFile.h"
+#include "ndBrainBatchInference.h"
+#include "ndBrainLayerSigmoidActivation.h"
+#include "ndBrainLayerSoftmaxActivation.h"
+#include "ndBrainLayerLeakyReluActivation.h"
+#include "ndBrainAgentTD3_Trainer.h"
+#include "ndBrainAgentDDPG_Trainer.h"
+#include <gtest/gtest.h>
+
+static void RandomizeMatrix(ndBrainMatrix& matrix)
+{
+	for (ndInt32 i = 0; i < matrix.GetRows(); ++i)
+	{
+		for (ndInt32 j = 0; j < matrix.GetColumns(); ++j)
+		{
+			matrix[i][j] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+		}
+	}
+}
+
+static ndBrain* BuildBrain(ndInt32 inputs, ndInt32 hidden, ndInt32 outputs)
+{
+	ndBrain* const brain = new ndBrain;
+	brain->AddLayer(new ndBrainLayerLinear(inputs, hidden));
+	brain->AddLayer(new ndBrainLayerTanhActivation(hidden));
+	brain->AddLayer(new ndBrainLayerLinear(hidden, hidden));
+	brain->AddLayer(new ndBrainLayerReluActivation(hidden));
+	brain->AddLayer(new ndBrainLayerLinear(hidden, outputs));
+	brain->InitWeightsXavierMethod();
+	return brain;
+}
+
+// least squared error against a different truth for each sample
+class BatchLoss : public ndBrainLoss
+{
+	public:
+	BatchLoss(const ndBrainMatrix& truth)
+		:ndBrainLoss()
+		,m_truth(truth)
+		,m_index(0)
+	{
+	}
+
+	void GetLoss(const ndBrainVector& output, ndBrainVector& loss) override
+	{
+		loss.Set(output);
+		loss.Sub(m_truth[m_index % m_truth.GetRows()]);
+		m_index++;
+	}
+
+	const ndBrainMatrix& m_truth;
+	ndInt32 m_index;
+};
+
+TEST(BrainTest, MatrixProducts)
+{
+	// sizes picked to cross the cache blocks and leave partial tiles
+	const ndInt32 rows = 37;
+	const ndInt32 depth = 301;
+	const ndInt32 columns = 75;
+
+	ndBrainMatrix a(rows, depth);
+	ndBrainMatrix b(depth, columns);
+	ndBrainMatrix bt(columns, depth);
+	ndBrainMatrix at(depth, rows);
+	RandomizeMatrix(a);
+	RandomizeMatrix(b);
+	for (ndInt32 i = 0; i < depth; ++i)
+	{
+		for (ndInt32 j = 0; j < columns; ++j)
+		{
+			bt[j][i] = b[i][j];
+		}
+		for (ndInt32 j = 0; j < rows; ++j)
+		{
+			at[i][j] = a[j][i];
+		}
+	}
+
+	ndBrainVector x;
+	x.SetCount(depth);
+	for (ndInt32 i = 0; i < depth; ++i)
+	{
+		x[i] = b[i][0];
+	}
+
+	// every instruction set the cpu supports must give the same products
+	const ndBrainKernels::ndInstructionSet defaultSet = ndBrainKernels::GetInstructionSet();
+	const ndBrainKernels::ndInstructionSet sets[] = { ndBrainKernels::m_generic, ndBrainKernels::m_avx2, ndBrainKernels::m_avx512, ndBrainKernels::m_neon };
+	for (ndInt32 n = 0; n < ndInt32(sizeof(sets) / sizeof(sets[0])); ++n)
+	{
+		if (!ndBrainKernels::SetInstructionSet(sets[n]))
+		{
+			continue;
+		}
+
+		ndBrainMatrix c0(rows, columns);
+		ndBrainMatrix c1(rows, columns);
+		ndBrainMatrix c2(rows, columns);
+		c0.MatrixMul(a, b);
+		c1.MatrixMulTranspose(a, bt);
+		c2.TransposeMatrixMul(at, b);
+
+		ndBrainVector y0;
+		ndBrainVector y1;
+		y0.SetCount(rows);
+		y1.SetCount(rows);
+		a.Mul(x, y0);
+		at.TransposeMul(x, y1);
+
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			for (ndInt32 j = 0; j < columns; ++j)
+			{
+				ndFloat64 sum = 0.0f;
+				for (ndInt32 k = 0; k < depth; ++k)
+				{
+					sum += ndFloat64(a[i][k]) * ndFloat64(b[k][j]);
+				}
+				EXPECT_NEAR(c0[i][j], sum, 1.0e-3f);
+				EXPECT_NEAR(c1[i][j], sum, 1.0e-3f);
+				EXPECT_NEAR(c2[i][j], sum, 1.0e-3f);
+			}
+			EXPECT_NEAR(y0[i], c0[i][0], 1.0e-3f);
+			EXPECT_NEAR(y1[i], c0[i][0], 1.0e-3f);
+		}
+	}
+	ndBrainKernels::SetInstructionSet(defaultSet);
+}
+
+TEST(BrainTest, BatchBackPropagation)
+{
+	const ndInt32 batchSize = 19;
+	const ndInt32 inputs = 11;
+	const ndInt32 outputs = 5;
+	ndBrain* const brain = BuildBrain(inputs, 40, outputs);
+
+	ndBrainMatrix input(batchSize, inputs);
+	ndBrainMatrix truth(batchSize, outputs);
+	RandomizeMatrix(input);
+	RandomizeMatrix(truth);
+
+	// the batched prediction must match one sample at a time
+	ndBrainVector workingBuffer;
+	ndBrainVector output;
+	output.SetCount(outputs);
+	ndBrainMatrix batchOutput(batchSize, outputs);
+	brain->MakeBatchPrediction(input, batchOutput);
+	for (ndInt32 i = 0; i < batchSize; ++i)
+	{
+		brain->MakePrediction(input[i], output, workingBuffer);
+		for (ndInt32 j = 0; j < outputs; ++j)
+		{
+			EXPECT_NEAR(batchOutput[i][j], output[j], 1.0e-5f);
+		}
+	}
+
+	// and the batch gradients must be the sum of the per sample gradients
+	ndBrainTrainer batchTrainer(brain);
+	BatchLoss batchLoss(truth);
+	batchTrainer.BackPropagateBatch(input, batchLoss);
+
+	ndBrainTrainer sampleTrainer(brain);
+	ndBrainTrainer sumTrainer(brain);
+	sumTrainer.ClearGradients();
+	BatchLoss sampleLoss(truth);
+	for (ndInt32 i = 0; i < batchSize; ++i)
+	{
+		sampleTrainer.BackPropagate(input[i], sampleLoss);
+		sumTrainer.AddGradients(&sampleTrainer);
+	}
+
+	for (ndInt32 i = 0; i < brain->GetCount(); ++i)
+	{
+		if (!(*brain)[i]->HasParameters())
+		{
+			continue;
+		}
+		ndBrainLayerLinear* const batchGradient = (ndBrainLayerLinear*)batchTrainer.GetGradientLayer(i);
+		ndBrainLayerLinear* const sumGradient = (ndBrainLayerLinear*)sumTrainer.GetGradientLayer(i);
+
+		const ndBrainVector& bias0 = *batchGradient->GetBias();
+		const ndBrainVector& bias1 = *sumGradient->GetBias();
+		for (ndInt32 j = 0; j < bias0.GetCount(); ++j)
+		{
+			EXPECT_NEAR(bias0[j], bias1[j], 1.0e-4f);
+		}
+
+		const ndBrainMatrix& weights0 = *batchGradient->GetWeights();
+		const ndBrainMatrix& weights1 = *sumGradient->GetWeights();
+		for (ndInt32 j = 0; j < weights0.GetRows(); ++j)
+		{
+			for (ndInt32 k = 0; k < weights0.GetColumns(); ++k)
+			{
+				EXPECT_NEAR(weights0[j][k], weights1[j][k], 1.0e-4f);
+			}
+		}
+	}
+	delete brain;
+}
+
+TEST(BrainTest, BatchPredictionBuffers)
+{
+	// hidden layers of different widths share the two ping pong buffers, 
+	// and the buffers are reused by the following batches.
+	const ndInt32 inputs = 7;
+	const ndInt32 outputs = 3;
+	ndBrain brain;
+	brain.AddLayer(new ndBrainLayerLinear(inputs, 33));
+	brain.AddLayer(new ndBrainLayerTanhActivation(33));
+	brain.AddLayer(new ndBrainLayerLinear(33, 9));
+	brain.AddLayer(new ndBrainLayerReluActivation(9));
+	brain.AddLayer(new ndBrainLayerLinear(9, 17));
+	brain.AddLayer(new ndBrainLayerTanhActivation(17));
+	brain.AddLayer(new ndBrainLayerLinear(17, outputs));
+	brain.InitWeightsXavierMethod();
+
+	ndBrainVector workingBuffer;
+	ndBrainVector output;
+	output.SetCount(outputs);
+	const ndInt32 batchSizes[] = { 13, 13, 5 };
+	for (ndInt32 n = 0; n < ndInt32(sizeof(batchSizes) / sizeof(batchSizes[0])); ++n)
+	{
+		ndBrainMatrix input(batchSizes[n], inputs);
+		ndBrainMatrix batchOutput(batchSizes[n], outputs);
+		RandomizeMatrix(input);
+		brain.MakeBatchPrediction(input, batchOutput);
+		for (ndInt32 i = 0; i < batchSizes[n]; ++i)
+		{
+			brain.MakePrediction(input[i], output, workingBuffer);
+			for (ndInt32 j = 0; j < outputs; ++j)
+			{
+				EXPECT_NEAR(batchOutput[i][j], output[j], 1.0e-5f);
+			}
+		}
+	}
+}
+
+// exposes the parameters of the convolution layers
+template <class Layer>
+class ConvolutionProbe : public Layer
+{
+	public:
+	ConvolutionProbe(ndInt32 width, ndInt32 height, ndInt32 channels, ndInt32 kernelSize, ndInt32 filters, ndBrainConvolution::ndLayout layout)
+		:Layer(width, height, channels, kernelSize, filters, layout)
+	{
+	}
+
+	ndBrainVector& GetKernels()
+	{
+		return this->m_kernels;
+	}
+
+	ndBrainVector& GetBias()
+	{
+		return this->m_bias;
+	}
+};
+
+// index of pixel (x, y) of channel c in either layout
+static ndInt32 ImageIndex(ndBrainConvolution::ndLayout layout, ndInt32 width, ndInt32 height, ndInt32 channels, ndInt32 c, ndInt32 y, ndInt32 x)
+{
+	return (layout == ndBrainConvolution::m_channelFirst) ? (c * height + y) * width + x : (y * width + x) * channels + c;
+}
+
+template <class Layer>
+static void CheckConvolutionLayer(ndInt32 width, ndInt32 height, ndInt32 channels, ndInt32 kernelSize, ndInt32 filters, ndBrainConvolution::ndLayout layout, bool flip)
+{
+	ConvolutionProbe<Layer> layer(width, height, channels, kernelSize, filters, layout);
+	ConvolutionProbe<Layer> gradient(width, height, channels, kernelSize, filters, layout);
+	ConvolutionProbe<Layer> sampleGradient(width, height, channels, kernelSize, filters, layout);
+	for (ndInt32 i = 0; i < layer.GetKernels().GetCount(); ++i)
+	{
+		layer.GetKernels()[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+	for (ndInt32 i = 0; i < layer.GetBias().GetCount(); ++i)
+	{
+		layer.GetBias()[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+
+	const ndInt32 outputWidth = width - kernelSize + 1;
+	const ndInt32 outputHeight = height - kernelSize + 1;
+	const ndInt32 taps = kernelSize * kernelSize;
+	const ndBrainFloat biasScale = ndBrainFloat(1.0f) / ndBrainFloat(channels * outputWidth * outputHeight);
+	const ndBrainVector& kernels = layer.GetKernels();
+	auto Kernel = [&kernels, channels, taps, flip](ndInt32 o, ndInt32 c, ndInt32 j)
+	{
+		return kernels[(o * channels + c) * taps + (flip ? taps - 1 - j : j)];
+	};
+
+	const ndInt32 batchSize = 7;
+	ndBrainMatrix input(batchSize, layer.GetInputSize());
+	ndBrainMatrix outputDerivative(batchSize, layer.GetOutputSize());
+	RandomizeMatrix(input);
+	RandomizeMatrix(outputDerivative);
+
+	// direct evaluation of the outputs and all the gradients, summed over the batch
+	ndBrainMatrix expectedOutput(batchSize, layer.GetOutputSize());
+	ndBrainMatrix expectedInputGradient(batchSize, layer.GetInputSize());
+	ndBrainVector expectedKernelGradient;
+	ndBrainVector expectedBiasGradient;
+	expectedInputGradient.Set(ndBrainFloat(0.0f));
+	expectedKernelGradient.SetCount(kernels.GetCount());
+	expectedKernelGradient.Set(ndBrainFloat(0.0f));
+	expectedBiasGradient.SetCount(filters);
+	expectedBiasGradient.Set(ndBrainFloat(0.0f));
+	for (ndInt32 n = 0; n < batchSize; ++n)
+	{
+		for (ndInt32 o = 0; o < filters; ++o)
+		{
+			for (ndInt32 y = 0; y < outputHeight; ++y)
+			{
+				for (ndInt32 x = 0; x < outputWidth; ++x)
+				{
+					const ndInt32 outIndex = ImageIndex(layout, outputWidth, outputHeight, filters, o, y, x);
+					const ndBrainFloat derivative = outputDerivative[n][outIndex];
+					ndFloat64 sum = layer.GetBias()[o] * biasScale;
+					for (ndInt32 c = 0; c < channels; ++c)
+					{
+						for (ndInt32 j = 0; j < taps; ++j)
+						{
+							const ndInt32 inIndex = ImageIndex(layout, width, height, channels, c, y + j / kernelSize, x + j % kernelSize);
+							sum += ndFloat64(input[n][inIndex]) * Kernel(o, c, j);
+							expectedInputGradient[n][inIndex] += Kernel(o, c, j) * derivative;
+							expectedKernelGradient[(o * channels + c) * taps + (flip ? taps - 1 - j : j)] += input[n][inIndex] * derivative;
+						}
+					}
+					expectedOutput[n][outIndex] = ndBrainFloat(sum);
+					expectedBiasGradient[o] += derivative * biasScale;
+				}
+			}
+		}
+	}
+
+	auto ExpectNear = [](const ndBrainVector& a, const ndBrainVector& b, ndFloat32 tolerance)
+	{
+		ASSERT_EQ(a.GetCount(), b.GetCount());
+		for (ndInt32 i = 0; i < a.GetCount(); ++i)
+		{
+			EXPECT_NEAR(a[i], b[i], tolerance);
+		}
+	};
+
+	// one sample at a time
+	ndBrainVector buffer;
+	buffer.SetCount(layer.GetOutputBufferSize());
+	ndBrainMemVector output(&buffer[0], layer.GetOutputSize());
+	ndBrainVector inputGradient;
+	inputGradient.SetCount(layer.GetInputSize());
+	layer.MakePrediction(input[0], output);
+	ExpectNear(output, expectedOutput[0], 1.0e-3f);
+	layer.CalculateParamGradients(input[0], output, outputDerivative[0], inputGradient, &gradient);
+	ExpectNear(inputGradient, expectedInputGradient[0], 1.0e-3f);
+
+	// the batches, with more and with fewer samples than threads
+	ndBrainThreadPool threadPool;
+	threadPool.SetThreadCount(4);
+	layer.SetThreadPool(&threadPool);
+	for (ndInt32 rows = 1; rows <= batchSize; rows += batchSize - 1)
+	{
+		ndBrainMatrix batchInput(rows, layer.GetInputSize());
+		ndBrainMatrix batchDerivative(rows, layer.GetOutputSize());
+		ndBrainMatrix batchOutput(rows, layer.GetOutputSize());
+		ndBrainMatrix batchInputGradient(rows, layer.GetInputSize());
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			batchInput[i].Set(input[i]);
+			batchDerivative[i].Set(outputDerivative[i]);
+		}
+		layer.MakeBatchPrediction(batchInput, batchOutput);
+		layer.CalculateBatchParamGradients(batchInput, batchOutput, batchDerivative, batchInputGradient, &gradient, &sampleGradient);
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			ExpectNear(batchOutput[i], expectedOutput[i], 1.0e-3f);
+			ExpectNear(batchInputGradient[i], expectedInputGradient[i], 1.0e-3f);
+		}
+		if (rows == batchSize)
+		{
+			ExpectNear(gradient.GetKernels(), expectedKernelGradient, 1.0e-2f);
+			ExpectNear(gradient.GetBias(), expectedBiasGradient, 1.0e-3f);
+		}
+	}
+}
+
+TEST(BrainTest, ConvolutionLayers)
+{
+	// 3 x 3 kernels with eight or more channels take the winograd path, 
+	// the odd sizes leave partial winograd tiles.
+	const ndBrainConvolution::ndLayout layouts[] = { ndBrainConvolution::m_channelFirst, ndBrainConvolution::m_channelLast };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		CheckConvolutionLayer<ndBrainLayerConvolutional_2d>(11, 9, 8, 3, 5, layouts[i], true);
+		CheckConvolutionLayer<ndBrainLayerConvolutional_2d>(10, 12, 3, 5, 4, layouts[i], true);
+		CheckConvolutionLayer<ndBrainLayerCrossCorrelation_2d>(11, 9, 8, 3, 5, layouts[i], false);
+		CheckConvolutionLayer<ndBrainLayerCrossCorrelation_2d>(9, 7, 2, 3, 6, layouts[i], false);
+	}
+}
+
+TEST(BrainTest, ImagePoolingLayouts)
+{
+	// both layouts must pick the same maximum, including the odd edges
+	const ndInt32 width = 7;
+	const ndInt32 height = 5;
+	const ndInt32 channels = 3;
+	ndBrainLayerImagePolling_2x2 channelFirst(width, height, channels, ndBrainConvolution::m_channelFirst);
+	ndBrainLayerImagePolling_2x2 channelLast(width, height, channels, ndBrainConvolution::m_channelLast);
+
+	ndBrainVector input0;
+	ndBrainVector input1;
+	input0.SetCount(channelFirst.GetInputSize());
+	input1.SetCount(channelFirst.GetInputSize());
+	for (ndInt32 c = 0; c < channels; ++c)
+	{
+		for (ndInt32 y = 0; y < height; ++y)
+		{
+			for (ndInt32 x = 0; x < width; ++x)
+			{
+				const ndBrainFloat value = ndBrainFloat(ndRand());
+				input0[ImageIndex(ndBrainConvolution::m_channelFirst, width, height, channels, c, y, x)] = value;
+				input1[ImageIndex(ndBrainConvolution::m_channelLast, width, height, channels, c, y, x)] = value;
+			}
+		}
+	}
+
+	ndBrainVector buffer0;
+	ndBrainVector buffer1;
+	buffer0.SetCount(channelFirst.GetOutputBufferSize());
+	buffer1.SetCount(channelLast.GetOutputBufferSize());
+	ndBrainMemVector output0(&buffer0[0], channelFirst.GetOutputSize());
+	ndBrainMemVector output1(&buffer1[0], channelLast.GetOutputSize());
+	channelFirst.MakePrediction(input0, output0);
+	channelLast.MakePrediction(input1, output1);
+
+	const ndInt32 outputWidth = channelFirst.GetOutputWidth();
+	const ndInt32 outputHeight = channelFirst.GetOutputHeight();
+	for (ndInt32 c = 0; c < channels; ++c)
+	{
+		for (ndInt32 y = 0; y < outputHeight; ++y)
+		{
+			for (ndInt32 x = 0; x < outputWidth; ++x)
+			{
+				ndBrainFloat expected = ndBrainFloat(-1.0e10f);
+				for (ndInt32 j = 0; j < 4; ++j)
+				{
+					const ndInt32 y0 = y * 2 + j / 2;
+					const ndInt32 x0 = x * 2 + j % 2;
+					if ((y0 < height) && (x0 < width))
+					{
+						expected = ndMax(expected, input0[ImageIndex(ndBrainConvolution::m_channelFirst, width, height, channels, c, y0, x0)]);
+					}
+				}
+				EXPECT_EQ(output0[ImageIndex(ndBrainConvolution::m_channelFirst, outputWidth, outputHeight, channels, c, y, x)], expected);
+				EXPECT_EQ(output1[ImageIndex(ndBrainConvolution::m_channelLast, outputWidth, outputHeight, channels, c, y, x)], expected);
+			}
+		}
+	}
+}
+
+// a box in its own world, pushed up or down by the action
+class FallingBoxEnvironment : public ndBrainVectorEnvironment::ndEnvironment
+{
+	public:
+	FallingBoxEnvironment(ndInt32 episodeFrames)
+		:ndBrainVectorEnvironment::ndEnvironment()
+		,m_world()
+		,m_box(new ndBodyDynamic())
+		,m_episodeFrames(episodeFrames)
+		,m_frames(0)
+	{
+		m_world.SetThreadCount(1);
+		m_box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+		ndShapeInstance shape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+		m_box->SetCollisionShape(shape);
+		m_box->SetMassMatrix(1.0f, shape);
+		ndSharedPtr<ndBody> bodyPtr(m_box);
+		m_world.AddBody(bodyPtr);
+		ResetModel();
+	}
+
+	void ResetModel() override
+	{
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = ndVector(0.0f, 10.0f, 0.0f, 1.0f);
+		m_box->SetMatrix(matrix);
+		m_box->SetVelocity(ndVector::m_zero);
+		m_box->SetOmega(ndVector::m_zero);
+		m_frames = 0;
+	}
+
+	bool IsTerminal() const override
+	{
+		return m_frames >= m_episodeFrames;
+	}
+
+	ndBrainFloat GetReward() const override
+	{
+		return ndBrainFloat(-ndAbs(m_box->GetMatrix().m_posit.m_y - 10.0f));
+	}
+
+	void Update(ndBrainFloat timestep) override
+	{
+		m_world.Update(ndFloat32(timestep));
+		m_world.Sync();
+		m_frames++;
+	}
+
+	void ApplyActions(const ndBrainFloat* const actions) override
+	{
+		const ndFloat32 thrust = ndFloat32(ndClamp(actions[0], ndBrainFloat(-1.0f), ndBrainFloat(1.0f)));
+		m_box->GetNotifyCallback()->SetGravity(ndVector(0.0f, -10.0f + 5.0f * thrust, 0.0f, 0.0f));
+	}
+
+	void GetObservation(ndBrainFloat* const observation) override
+	{
+		observation[0] = ndBrainFloat(m_box->GetMatrix().m_posit.m_y - 10.0f);
+		observation[1] = ndBrainFloat(m_box->GetVelocity().m_y);
+	}
+
+	ndWorld m_world;
+	ndBodyDynamic* m_box;
+	ndInt32 m_episodeFrames;
+	ndInt32 m_frames;
+};
+
+class RecordingVectorEnvironment : public ndBrainVectorEnvironment
+{
+	public:
+	RecordingVectorEnvironment(ndBrain* const policy)
+		:ndBrainVectorEnvironment(policy)
+		,m_transitions()
+		,m_episodes(0)
+	{
+	}
+
+	void AddTransition(ndInt32 environmentIndex, const ndBrainVector& observation, const ndBrainVector& actions, ndBrainFloat reward, const ndBrainVector& nextObservation, bool terminalState) override
+	{
+		ndBrainVector& transition = m_transitions[environmentIndex];
+		transition.PushBack(observation[0]);
+		transition.PushBack(observation[1]);
+		transition.PushBack(actions[0]);
+		transition.PushBack(reward);
+		transition.PushBack(nextObservation[0]);
+		transition.PushBack(nextObservation[1]);
+		transition.PushBack(terminalState ? ndBrainFloat(1.0f) : ndBrainFloat(0.0f));
+	}
+
+	void EndEpisode(ndInt32, ndInt32) override
+	{
+		m_episodes++;
+	}
+
+	ndBrainVector m_transitions[4];
+	ndInt32 m_episodes;
+};
+
+TEST(BrainTest, VectorEnvironmentStepping)
+{
+	const ndInt32 steps = 24;
+	const ndInt32 environments = 4;
+	const ndBrainFloat timestep = ndBrainFloat(1.0f / 60.0f);
+	ndSharedPtr<ndBrain> policy(BuildBrain(2, 8, 1));
+
+	RecordingVectorEnvironment vectorEnvironment(*policy);
+	vectorEnvironment.SetThreadCount(environments);
+	for (ndInt32 i = 0; i < environments; ++i)
+	{
+		vectorEnvironment.AddEnvironment(new FallingBoxEnvironment(5 + 3 * i));
+	}
+	for (ndInt32 i = 0; i < steps; ++i)
+	{
+		vectorEnvironment.Step(timestep);
+	}
+
+	// the same environments stepped one at a time with a single sample prediction
+	ndInt32 episodes = 0;
+	ndBrainVector workingBuffer;
+	for (ndInt32 i = 0; i < environments; ++i)
+	{
+		FallingBoxEnvironment environment(5 + 3 * i);
+		const ndBrainVector& transitions = vectorEnvironment.m_transitions[i];
+		ASSERT_EQ(transitions.GetCount(), steps * 7);
+		for (ndInt32 j = 0; j < steps; ++j)
+		{
+			ndBrainFixSizeVector<2> observation;
+			ndBrainFixSizeVector<1> actions;
+			environment.GetObservation(&observation[0]);
+			policy->MakePrediction(observation, actions, workingBuffer);
+			environment.ApplyActions(&actions[0]);
+			environment.Update(timestep);
+
+			ndBrainFixSizeVector<2> nextObservation;
+			environment.GetObservation(&nextObservation[0]);
+			const ndBrainFloat* const transition = &transitions[j * 7];
+			EXPECT_NEAR(transition[0], observation[0], 1.0e-4f);
+			EXPECT_NEAR(transition[1], observation[1], 1.0e-4f);
+			EXPECT_NEAR(transition[2], actions[0], 1.0e-4f);
+			EXPECT_NEAR(transition[3], environment.GetReward(), 1.0e-4f);
+			EXPECT_NEAR(transition[4], nextObservation[0], 1.0e-4f);
+			EXPECT_NEAR(transition[5], nextObservation[1], 1.0e-4f);
+			EXPECT_EQ(transition[6] != ndBrainFloat(0.0f), environment.IsTerminal());
+			if (environment.IsTerminal())
+			{
+				environment.ResetModel();
+				episodes++;
+			}
+		}
+	}
+	EXPECT_EQ(vectorEnvironment.GetFramesCount(), steps * environments);
+	EXPECT_EQ(vectorEnvironment.GetEpisodeCount(), episodes);
+	EXPECT_EQ(vectorEnvironment.m_episodes, episodes);
+}
+
+TEST(BrainTest, PrioritizedReplayBuffer)
+{
+	// sampling frequencies follow the priorities
+	{
+		const ndInt32 size = 8;
+		ndBrainPrioritizedReplayBuffer replayBuffer(2, 1, size, 2);
+		replayBuffer.SetAlpha(ndBrainFloat(1.0f));
+		replayBuffer.SetBeta(ndBrainFloat(1.0f));
+		for (ndInt32 i = 0; i < size; ++i)
+		{
+			const ndBrainFloat observation[2] = { ndBrainFloat(i), ndBrainFloat(0.0f) };
+			const ndBrainFloat action = ndBrainFloat(i);
+			replayBuffer.AddTransition(i % 2, observation, &action, ndBrainFloat(i), observation, false);
+		}
+		EXPECT_EQ(replayBuffer.GetCount(), size);
+
+		ndBrainPrioritizedReplayBuffer::ndBatch batch;
+		ndBrainVector tdErrors;
+		ndInt32 updated = 0;
+		for (ndInt32 i = 0; (i < 1000) && (updated != (1 << size) - 1); ++i)
+		{
+			replayBuffer.SampleBatch(batch, size);
+			tdErrors.SetCount(size);
+			for (ndInt32 j = 0; j < size; ++j)
+			{
+				const ndInt32 id = ndInt32(batch.m_observations[j][0]);
+				EXPECT_EQ(batch.m_actions[j][0], ndBrainFloat(id));
+				EXPECT_EQ(batch.m_rewards[j], ndBrainFloat(id));
+				tdErrors[j] = ndBrainFloat(id + 1);
+				updated |= 1 << id;
+			}
+			replayBuffer.UpdatePriorities(batch, tdErrors);
+		}
+		ASSERT_EQ(updated, (1 << size) - 1);
+		EXPECT_NEAR(replayBuffer.GetTotalPriority(), 36.0, 1.0e-2);
+
+		ndInt32 histogram[size];
+		ndMemSet(histogram, 0, size);
+		const ndInt32 batches = 4000;
+		for (ndInt32 i = 0; i < batches; ++i)
+		{
+			replayBuffer.SampleBatch(batch, size);
+			for (ndInt32 j = 0; j < size; ++j)
+			{
+				const ndInt32 id = ndInt32(batch.m_observations[j][0]);
+				histogram[id]++;
+				// importance weights are inversely proportional to the priority
+				EXPECT_NEAR(batch.m_weights[j] * ndBrainFloat(id + 1), batch.m_weights[0] * (batch.m_observations[0][0] + ndBrainFloat(1.0f)), 1.0e-2f);
+			}
+		}
+		for (ndInt32 i = 0; i < size; ++i)
+		{
+			const ndFloat32 expected = ndFloat32(batches * size) * ndFloat32(i + 1) / 36.0f;
+			EXPECT_NEAR(ndFloat32(histogram[i]), expected, expected * 0.1f);
+		}
+	}
+
+	// a batch sampled before its transitions were overwritten does not change their priorities
+	{
+		const ndInt32 size = 4;
+		ndBrainPrioritizedReplayBuffer replayBuffer(2, 1, size, 1);
+		replayBuffer.SetAlpha(ndBrainFloat(1.0f));
+		auto AddTransitions = [&replayBuffer, size]()
+		{
+			for (ndInt32 i = 0; i < size; ++i)
+			{
+				const ndBrainFloat observation[2] = { ndBrainFloat(i), ndBrainFloat(0.0f) };
+				const ndBrainFloat action = ndBrainFloat(i);
+				replayBuffer.AddTransition(0, observation, &action, ndBrainFloat(i), observation, false);
+			}
+		};
+		AddTransitions();
+
+		ndBrainPrioritizedReplayBuffer::ndBatch batch;
+		replayBuffer.SampleBatch(batch, size);
+		AddTransitions();
+
+		ndBrainVector tdErrors;
+		tdErrors.SetCount(size);
+		tdErrors.Set(ndBrainFloat(10.0f));
+		replayBuffer.UpdatePriorities(batch, tdErrors);
+		for (ndInt32 i = 0; i < size; ++i)
+		{
+			EXPECT_NEAR(replayBuffer.GetPriority(i), 1.0, 1.0e-4);
+		}
+		EXPECT_NEAR(replayBuffer.GetTotalPriority(), ndFloat64(size), 1.0e-4);
+
+		// the current transitions take the update
+		replayBuffer.SampleBatch(batch, size);
+		replayBuffer.UpdatePriorities(batch, tdErrors);
+		EXPECT_GT(replayBuffer.GetTotalPriority(), ndFloat64(size) + 9.0);
+	}
+
+	// producers and a sampler running concurrently never see torn transitions
+	{
+		const ndInt32 size = 1024;
+		const ndInt32 producers = 4;
+		const ndInt32 transitionsPerProducer = 20000;
+		ndBrainPrioritizedReplayBuffer replayBuffer(2, 1, size, producers);
+
+		ndAtomic<ndInt32> running(producers);
+		ndAtomic<ndInt32> tornSamples(0);
+		std::thread sampler([&replayBuffer, &running, &tornSamples]()
+		{
+			ndBrainPrioritizedReplayBuffer::ndBatch batch;
+			ndBrainVector tdErrors;
+			while (running.load())
+			{
+				replayBuffer.SampleBatch(batch, 64);
+				tdErrors.SetCount(64);
+				for (ndInt32 j = 0; j < 64; ++j)
+				{
+					if (batch.m_indices[j] >= 0)
+					{
+						const ndBrainFloat value = batch.m_observations[j][0];
+						const bool consistent = 
+							(batch.m_observations[j][1] == value + ndBrainFloat(1.0f)) &&
+							(batch.m_actions[j][0] == value) && (batch.m_rewards[j] == value) &&
+							(batch.m_nextObservations[j][0] == value + ndBrainFloat(2.0f));
+						if (!consistent)
+						{
+							tornSamples.fetch_add(1);
+						}
+					}
+					tdErrors[j] = ndBrainFloat(j % 7);
+				}
+				replayBuffer.UpdatePriorities(batch, tdErrors);
+			}
+		});
+
+		std::thread producerThreads[producers];
+		for (ndInt32 i = 0; i < producers; ++i)
+		{
+			producerThreads[i] = std::thread([&replayBuffer, &running, i, transitionsPerProducer]()
+			{
+				for (ndInt32 j = 0; j < transitionsPerProducer; ++j)
+				{
+					const ndBrainFloat value = ndBrainFloat(i * 100000 + j);
+					const ndBrainFloat observation[2] = { value, value + ndBrainFloat(1.0f) };
+					const ndBrainFloat nextObservation[2] = { value + ndBrainFloat(2.0f), value + ndBrainFloat(3.0f) };
+					replayBuffer.AddTransition(i, observation, &value, value, nextObservation, false);
+				}
+				running.fetch_sub(1);
+			});
+		}
+		for (ndInt32 i = 0; i < producers; ++i)
+		{
+			producerThreads[i].join();
+		}
+		sampler.join();
+
+		EXPECT_EQ(tornSamples.load(), 0);
+		EXPECT_EQ(replayBuffer.GetCount(), size);
+
+		// the concurrent updates must leave the tree total equal to the sum of the leaves
+		ndFloat64 sum = 0.0;
+		for (ndInt32 i = 0; i < size; ++i)
+		{
+			EXPECT_GT(replayBuffer.GetPriority(i), 0.0);
+			sum += replayBuffer.GetPriority(i);
+		}
+		EXPECT_EQ(replayBuffer.GetTotalPriority(), sum);
+	}
+}
+
+TEST(BrainTest, InputGradient)
+{
+	// the gradient of the sum of the outputs, against central differences
+	ndSharedPtr<ndBrain> brain(BuildBrain(5, 12, 3));
+	ndBrainVector input;
+	ndBrainVector gradient;
+	ndBrainVector output;
+	ndBrainVector workingBuffer;
+	input.SetCount(5);
+	gradient.SetCount(5);
+	output.SetCount(3);
+	for (ndInt32 i = 0; i < 5; ++i)
+	{
+		input[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+	brain->CalculateInputGradient(input, gradient, workingBuffer);
+
+	const ndBrainFloat step = ndBrainFloat(1.0e-3f);
+	for (ndInt32 i = 0; i < 5; ++i)
+	{
+		const ndBrainFloat value = input[i];
+		input[i] = value + step;
+		brain->MakePrediction(input, output, workingBuffer);
+		const ndBrainFloat sum1 = output[0] + output[1] + output[2];
+		input[i] = value - step;
+		brain->MakePrediction(input, output, workingBuffer);
+		const ndBrainFloat sum0 = output[0] + output[1] + output[2];
+		input[i] = value;
+		EXPECT_NEAR(gradient[i], (sum1 - sum0) / (ndBrainFloat(2.0f) * step), 1.0e-2f);
+	}
+}
+
+TEST(BrainTest, SnapshotPublishing)
+{
+	// readers always see one of the published brains, never a mix of both
+	ndSharedPtr<ndBrain> brain0(BuildBrain(4, 16, 3));
+	ndSharedPtr<ndBrain> brain1(BuildBrain(4, 16, 3));
+	ndBrainSnapshot snapshot(**brain0);
+
+	ndBrainVector input;
+	ndBrainVector output0;
+	ndBrainVector output1;
+	ndBrainVector workingBuffer;
+	input.SetCount(4);
+	output0.SetCount(3);
+	output1.SetCount(3);
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		input[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+	brain0->MakePrediction(input, output0, workingBuffer);
+	brain1->MakePrediction(input, output1, workingBuffer);
+
+	ndAtomic<bool> publishing(true);
+	std::thread publisher([&snapshot, &brain0, &brain1, &publishing]()
+	{
+		for (ndInt32 i = 0; i < 2000; ++i)
+		{
+			snapshot.Publish((i & 1) ? **brain0 : **brain1);
+		}
+		publishing.store(false);
+	});
+
+	ndInt32 mismatches = 0;
+	ndBrainVector output;
+	output.SetCount(3);
+	do
+	{
+		snapshot.MakePrediction(input, output, workingBuffer);
+		bool equal0 = true;
+		bool equal1 = true;
+		for (ndInt32 i = 0; i < 3; ++i)
+		{
+			equal0 = equal0 && (output[i] == output0[i]);
+			equal1 = equal1 && (output[i] == output1[i]);
+		}
+		mismatches += (equal0 || equal1) ? 0 : 1;
+	} while (publishing.load());
+	publisher.join();
+
+	EXPECT_EQ(mismatches, 0);
+	EXPECT_EQ(snapshot.GetVersion(), ndUnsigned32(2000));
+}
+
+// one dimensional tracking task, the action should match the observation
+template <class Trainer>
+class TrackingAgent : public Trainer
+{
+	public:
+	TrackingAgent(const typename Trainer::HyperParameters& hyperParameters)
+		:Trainer(hyperParameters)
+		,m_target(0.0f)
+		,m_action(0.0f)
+		,m_frames(0)
+	{
+	}
+
+	void ResetModel() override
+	{
+		m_frames = 0;
+	}
+
+	bool IsTerminal() const override
+	{
+		return m_frames >= 16;
+	}
+
+	ndBrainFloat GetReward() const override
+	{
+		return ndBrainFloat(1.0f) - ndAbs(m_action - m_target);
+	}
+
+	void ApplyActions(ndBrainFloat* const actions) const override
+	{
+		TrackingAgent* const me = (TrackingAgent*)this;
+		me->m_action = actions[0];
+		me->m_frames++;
+	}
+
+	void GetObservation(ndBrainFloat* const observation) override
+	{
+		m_target = ndBrainFloat(ndRand() - 0.5f);
+		observation[0] = m_target;
+	}
+
+	void CheckPublishedActor()
+	{
+		// after the learner is idle, the published weights are the trained ones
+		this->m_learner->Sync();
+		ndBrainVector output0;
+		ndBrainVector output1;
+		ndBrainVector workingBuffer;
+		ndBrainFixSizeVector<1> input;
+		output0.SetCount(1);
+		output1.SetCount(1);
+		input[0] = ndBrainFloat(0.25f);
+		this->m_actor.MakePrediction(input, output0, workingBuffer);
+		this->m_publishedActor->MakePrediction(input, output1, workingBuffer);
+		EXPECT_EQ(output0[0], output1[0]);
+	}
+
+	ndBrainFloat m_target;
+	ndBrainFloat m_action;
+	ndInt32 m_frames;
+};
+
+template <class Trainer>
+static void CheckAsyncLearner()
+{
+	typename Trainer::HyperParameters hyperParameters;
+	hyperParameters.m_numberOfHiddenLayers = 2;
+	hyperParameters.m_hiddenLayersNumberOfNeurons = 16;
+	hyperParameters.m_bashBufferSize = 16;
+	hyperParameters.m_replayBufferSize = 4096;
+	hyperParameters.m_replayBufferPrefill = 64;
+	hyperParameters.m_threadsCount = 1;
+	hyperParameters.m_asyncLearning = true;
+
+	TrackingAgent<Trainer> agent(hyperParameters);
+	ndBrainAgent* const baseAgent = &agent;
+	EXPECT_TRUE(agent.IsAsyncLearning());
+	const ndUnsigned32 initialVersion = agent.GetPublishedVersion();
+	for (ndInt32 i = 0; i < 2000; ++i)
+	{
+		baseAgent->Step();
+		baseAgent->OptimizeStep();
+	}
+	EXPECT_EQ(agent.GetFramesCount(), 2000);
+	EXPECT_GT(agent.GetEposideCount(), 100);
+	agent.CheckPublishedActor();
+	EXPECT_GT(agent.GetPublishedVersion(), initialVersion);
+}
+
+TEST(BrainTest, AsyncLearner)
+{
+	CheckAsyncLearner<ndBrainAgentDDPG_Trainer<1, 1>>();
+	CheckAsyncLearner<ndBrainAgentTD3_Trainer<1, 1>>();
+}
+
+TEST(BrainTest, InferenceMatchesBrain)
+{
+	// the compiled network must produce the same values as the layers it was built from
+	ndBrain* const brains[] =
+	{
+		BuildBrain(7, 21, 5),
+		new ndBrain,
+		new ndBrain,
+	};
+
+	brains[1]->AddLayer(new ndBrainLayerLinear(6, 13));
+	brains[1]->AddLayer(new ndBrainLayerSigmoidActivation(13));
+	brains[1]->AddLayer(new ndBrainLayerLinear(13, 9));
+	brains[1]->AddLayer(new ndBrainLayerLeakyReluActivation(9, ndBrainFloat(0.2f)));
+	brains[1]->AddLayer(new ndBrainLayerLinear(9, 4));
+	brains[1]->AddLayer(new ndBrainLayerSoftmaxActivation(4));
+	brains[1]->InitWeightsXavierMethod();
+
+	// an activation that does not follow a linear layer, and a layer that can not be fused
+	brains[2]->AddLayer(new ndBrainLayerTanhActivation(8));
+	brains[2]->AddLayer(new ndBrainLayerLinear(8, 16));
+	brains[2]->AddLayer(new ndBrainLayerApproximateTanhActivation(16));
+	brains[2]->AddLayer(new ndBrainLayerLinear(16, 3));
+	brains[2]->InitWeightsXavierMethod();
+
+	const ndInt32 operations[] = { 3, 3, 4 };
+	for (ndInt32 k = 0; k < ndInt32(sizeof(brains) / sizeof(brains[0])); ++k)
+	{
+		ndSharedPtr<ndBrain> brain(brains[k]);
+		ndBrainInference inference(**brain);
+		EXPECT_EQ(inference.GetOperationsCount(), operations[k]);
+		EXPECT_EQ(inference.GetInputSize(), brain->GetInputSize());
+		EXPECT_EQ(inference.GetOutputSize(), brain->GetOutputSize());
+
+		ndBrainVector input;
+		ndBrainVector output0;
+		ndBrainVector output1;
+		ndBrainVector output2;
+		ndBrainVector scratch;
+		ndBrainVector workingBuffer;
+		input.SetCount(brain->GetInputSize());
+		output0.SetCount(brain->GetOutputSize());
+		output1.SetCount(brain->GetOutputSize());
+		output2.SetCount(brain->GetOutputSize());
+		scratch.SetCount(inference.GetScratchSize());
+		for (ndInt32 n = 0; n < 16; ++n)
+		{
+			for (ndInt32 i = 0; i < input.GetCount(); ++i)
+			{
+				input[i] = ndBrainFloat(ndRand() * 4.0f - 2.0f);
+			}
+			brain->MakePrediction(input, output0, workingBuffer);
+			inference.MakePrediction(input, output1);
+			inference.MakePrediction(&input[0], &output2[0], &scratch[0]);
+			for (ndInt32 i = 0; i < output0.GetCount(); ++i)
+			{
+				EXPECT_NEAR(output0[i], output1[i], 1.0e-5f);
+				EXPECT_EQ(output1[i], output2[i]);
+			}
+		}
+	}
+}
+
+// a model that asks a shared brain for its actions
+class BatchInferenceModel: public ndModel, public ndBrainBatchInference::ndClient
+{
+	public:
+	BatchInferenceModel(ndBrainBatchInference* const inference, ndInt32 index)
+		:ndModel()
+		,ndBrainBatchInference::ndClient()
+		,m_inference(inference)
+		,m_index(index)
+		,m_frame(0)
+		,m_actionsFrame(-1)
+		,m_missedActions(0)
+	{
+		m_observation.SetCount(inference->GetInputSize());
+		m_actions.SetCount(inference->GetOutputSize());
+		m_inference->AddClient(this);
+	}
+
+	~BatchInferenceModel()
+	{
+		m_inference->RemoveClient(this);
+	}
+
+	void OnAddToWorld() override
+	{
+	}
+
+	void OnRemoveFromToWorld() override
+	{
+	}
+
+	void GetObservation(ndInt32 frame, ndBrainVector& observation) const
+	{
+		for (ndInt32 i = 0; i < observation.GetCount(); ++i)
+		{
+			observation[i] = ndBrainFloat(ndSin(ndFloat32(m_index * 7 + frame * 3 + i) * 0.37f));
+		}
+	}
+
+	void Update(ndWorld* const, ndFloat32) override
+	{
+		GetObservation(m_frame, m_observation);
+		m_inference->Submit(this, &m_observation[0]);
+	}
+
+	void ApplyActions(const ndBrainFloat* const actions) override
+	{
+		ndMemCpy(&m_actions[0], actions, m_actions.GetCount());
+		m_actionsFrame = m_frame;
+	}
+
+	void PostUpdate(ndWorld* const, ndFloat32) override
+	{
+		// the actions of this frame must arrive before the post update
+		m_missedActions += (m_actionsFrame == m_frame) ? 0 : 1;
+		m_frame++;
+	}
+
+	ndBrainBatchInference* m_inference;
+	ndBrainVector m_observation;
+	ndBrainVector m_actions;
+	ndInt32 m_index;
+	ndInt32 m_frame;
+	ndInt32 m_actionsFrame;
+	ndInt32 m_missedActions;
+};
+
+class BrainModelBatch: public ndModelBatch
+{
+	public:
+	BrainModelBatch(const ndBrain& brain)
+		:ndModelBatch()
+		,m_inference(brain)
+	{
+	}
+
+	void Update(ndWorld* const world, ndFloat32) override
+	{
+		m_inference.Update(*world->GetScene());
+	}
+
+	ndBrainBatchInference m_inference;
+};
+
+TEST(BrainTest, BatchInference)
+{
+	ndSharedPtr<ndBrain> brain(BuildBrain(9, 24, 4));
+	ndBrainInference inference(**brain);
+
+	// a batch of rows against one row at a time
+	const ndInt32 rows = 37;
+	ndBrainVector inputs;
+	ndBrainVector outputs;
+	ndBrainVector output;
+	ndBrainVector scratch;
+	inputs.SetCount(rows * 9);
+	outputs.SetCount(rows * 4);
+	output.SetCount(4);
+	scratch.SetCount(ndInt32(inference.GetBatchScratchSize(rows)));
+	for (ndInt32 i = 0; i < inputs.GetCount(); ++i)
+	{
+		inputs[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+	inference.MakeBatchPrediction(&inputs[0], 9, &outputs[0], 4, rows, &scratch[0]);
+	for (ndInt32 i = 0; i < rows; ++i)
+	{
+		inference.MakePrediction(&inputs[i * 9], &output[0], &scratch[0]);
+		for (ndInt32 j = 0; j < 4; ++j)
+		{
+			EXPECT_NEAR(outputs[i * 4 + j], output[j], 1.0e-5f);
+		}
+	}
+
+	// many models of a world sharing the brain
+	ndWorld world;
+	world.SetThreadCount(4);
+	BrainModelBatch* const batch = new BrainModelBatch(**brain);
+	ndSharedPtr<ndModelBatch> batchPtr(batch);
+	world.AddModelBatch(batchPtr);
+
+	const ndInt32 modelsCount = 100;
+	ndArray<BatchInferenceModel*> models;
+	for (ndInt32 i = 0; i < modelsCount; ++i)
+	{
+		BatchInferenceModel* const model = new BatchInferenceModel(&batch->m_inference, i);
+		world.AddModel(ndSharedPtr<ndModel>(model));
+		models.PushBack(model);
+	}
+	EXPECT_EQ(batch->m_inference.GetClientsCount(), modelsCount);
+
+	const ndInt32 frames = 5;
+	for (ndInt32 i = 0; i < frames; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+
+	ndBrainVector observation;
+	observation.SetCount(9);
+	for (ndInt32 i = 0; i < modelsCount; ++i)
+	{
+		const BatchInferenceModel* const model = models[i];
+		EXPECT_EQ(model->m_frame, frames);
+		EXPECT_EQ(model->m_missedActions, 0);
+		model->GetObservation(frames - 1, observation);
+		inference.MakePrediction(&observation[0], &output[0], &scratch[0]);
+		for (ndInt32 j = 0; j < 4; ++j)
+		{
+			EXPECT_NEAR(model->m_actions[j], output[j], 1.0e-5f);
+		}
+	}
+	EXPECT_EQ(batch->m_inference.GetSubmittedCount(), 0);
+
+	world.CleanUp();
+	EXPECT_EQ(batch->m_inference.GetClientsCount(), 0);
+}
+
+TEST(BrainTest, QuantizedInference)
+{
+	// half floats, exact values, ties rounded to even and saturation
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(0.0f)), 0x0000);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(1.0f)), 0x3c00);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(-2.0f)), 0xc000);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(65504.0f)), 0x7bff);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(1.0e6f)), 0x7bff);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(5.9604645e-8f)), 0x0001);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(1.0f + 2.0f / 4096.0f)), 0x3c00);
+	EXPECT_EQ(ndBrainKernels::FloatToHalf(ndBrainFloat(1.0f + 6.0f / 4096.0f)), 0x3c02);
+	for (ndInt32 i = 0; i < 1000; ++i)
+	{
+		const ndBrainFloat value = ndBrainFloat((ndRand() * 2.0f - 1.0f) * 100.0f);
+		const ndBrainFloat half = ndBrainKernels::HalfToFloat(ndBrainKernels::FloatToHalf(value));
+		EXPECT_NEAR(half, value, ndAbs(value) * (1.0f / 2048.0f) + 1.0e-7f);
+	}
+
+	// quantized products on every instruction set
+	const ndInt32 rows = 7;
+	const ndInt32 columns = 75;
+	const ndInt32 stride = 80;
+	ndArray<ndInt8> int8Matrix;
+	ndArray<ndInt8> int8Vector;
+	ndArray<ndUnsigned16> halfMatrix;
+	ndBrainVector vector;
+	int8Matrix.SetCount(rows * stride);
+	halfMatrix.SetCount(rows * stride);
+	int8Vector.SetCount(columns);
+	vector.SetCount(columns);
+	for (ndInt32 i = 0; i < rows * stride; ++i)
+	{
+		int8Matrix[i] = ndInt8(ndRandInt() % 255 - 127);
+		halfMatrix[i] = ndBrainKernels::FloatToHalf(ndBrainFloat(ndRand() * 2.0f - 1.0f));
+	}
+	for (ndInt32 i = 0; i < columns; ++i)
+	{
+		int8Vector[i] = ndInt8((i & 1) ? 127 : -127);
+		vector[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+
+	const ndBrainKernels::ndInstructionSet defaultSet = ndBrainKernels::GetInstructionSet();
+	const ndBrainKernels::ndInstructionSet sets[] = { ndBrainKernels::m_generic, ndBrainKernels::m_avx2, ndBrainKernels::m_avx512, ndBrainKernels::m_neon };
+	for (ndInt32 n = 0; n < ndInt32(sizeof(sets) / sizeof(sets[0])); ++n)
+	{
+		if (!ndBrainKernels::SetInstructionSet(sets[n]))
+		{
+			continue;
+		}
+
+		ndInt32 int8Products[rows];
+		ndBrainFloat halfProducts[rows];
+		ndBrainKernels::GemvInt8(rows, columns, &int8Matrix[0], stride, &int8Vector[0], int8Products);
+		ndBrainKernels::GemvHalf(rows, columns, &halfMatrix[0], stride, &vector[0], halfProducts);
+		for (ndInt32 i = 0; i < rows; ++i)
+		{
+			ndInt32 int8Sum = 0;
+			ndBrainFloat halfSum = ndBrainFloat(0.0f);
+			for (ndInt32 j = 0; j < columns; ++j)
+			{
+				int8Sum += ndInt32(int8Matrix[i * stride + j]) * ndInt32(int8Vector[j]);
+				halfSum += ndBrainKernels::HalfToFloat(halfMatrix[i * stride + j]) * vector[j];
+			}
+			EXPECT_EQ(int8Products[i], int8Sum);
+			EXPECT_NEAR(halfProducts[i], halfSum, 1.0e-4f);
+		}
+	}
+	ndBrainKernels::SetInstructionSet(defaultSet);
+
+	// the accuracy of the quantized networks against the float network
+	ndSharedPtr<ndBrain> brain(BuildBrain(12, 64, 6));
+	const ndInt32 samples = 200;
+	ndBrainVector inputs;
+	inputs.SetCount(samples * 12);
+	for (ndInt32 i = 0; i < inputs.GetCount(); ++i)
+	{
+		inputs[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+	}
+
+	const ndBrainInference float32(**brain);
+	const ndBrainInference float16(**brain, ndBrainInference::m_float16);
+	const ndBrainInference int8(**brain, ndBrainInference::m_int8);
+
+	const ndBrainInference::ndAccuracy exact(float32.CalculateAccuracy(**brain, &inputs[0], 12, samples));
+	const ndBrainInference::ndAccuracy half(float16.CalculateAccuracy(**brain, &inputs[0], 12, samples));
+	const ndBrainInference::ndAccuracy quantized(int8.CalculateAccuracy(**brain, &inputs[0], 12, samples));
+	EXPECT_EQ(exact.m_samplesCount, samples);
+	EXPECT_EQ(exact.m_maxError, ndBrainFloat(0.0f));
+	EXPECT_LT(half.m_maxError, half.m_maxOutput * 5.0e-3f);
+	EXPECT_LT(quantized.m_maxError, quantized.m_maxOutput * 5.0e-2f);
+	EXPECT_LT(quantized.m_averageError, quantized.m_maxOutput * 1.0e-2f);
+
+	// the weights take a half and a quarter of the float memory, the bias and scales remain in float
+	EXPECT_EQ(exact.m_floatParametersBytes, float32.GetParametersBytes());
+	EXPECT_LT(half.m_parametersBytes * 10, exact.m_parametersBytes * 6);
+	EXPECT_LT(quantized.m_parametersBytes * 10, exact.m_parametersBytes * 4);
+
+	// quantized batches are evaluated one row at a time
+	ndBrainVector outputs;
+	ndBrainVector output;
+	ndBrainVector scratch;
+	outputs.SetCount(samples * 6);
+	output.SetCount(6);
+	scratch.SetCount(ndInt32(int8.GetBatchScratchSize(samples)));
+	int8.MakeBatchPrediction(&inputs[0], 12, &outputs[0], 6, samples, &scratch[0]);
+	for (ndInt32 i = 0; i < samples; i += 17)
+	{
+		int8.MakePrediction(&inputs[i * 12], &output[0], &scratch[0]);
+		for (ndInt32 j = 0; j < 6; ++j)
+		{
+			EXPECT_EQ(outputs[i * 6 + j], output[j]);
+		}
+	}
+}
+
+TEST(BrainTest, BinaryFile)
+{
+	ndBrain* const brains[] =
+	{
+		BuildBrain(7, 21, 5),
+		new ndBrain,
+	};
+
+	// layers with kernels and image parameters, and an activation with a parameter
+	brains[1]->AddLayer(new ndBrainLayerConvolutional_2d(8, 8, 2, 3, 4, ndBrainConvolution::m_channelLast));
+	brains[1]->AddLayer(new ndBrainLayerImagePolling_2x2(6, 6, 4, ndBrainConvolution::m_channelLast));
+	brains[1]->AddLayer(new ndBrainLayerLinear(36, 11));
+	brains[1]->AddLayer(new ndBrainLayerLeakyReluActivation(11, ndBrainFloat(0.15f)));
+	brains[1]->AddLayer(new ndBrainLayerLinear(11, 3));
+	brains[1]->AddLayer(new ndBrainLayerSigmoidActivation(3));
+	brains[1]->InitWeightsXavierMethod();
+
+	const char* const textFileName = "brainTextFile.txt";
+	const char* const binaryFileName = "brainBinaryFile.bin";
+	const char* const convertedFileName = "brainConvertedFile.bin";
+	for (ndInt32 k = 0; k < ndInt32(sizeof(brains) / sizeof(brains[0])); ++k)
+	{
+		ndSharedPtr<ndBrain> brain(brains[k]);
+		ndBrainSave::Save(*brain, textFileName);
+		ASSERT_TRUE(ndBrainSave::SaveBinary(*brain, binaryFileName));
+		ASSERT_TRUE(ndBrainSave::ConvertToBinary(textFileName, convertedFileName));
+		EXPECT_FALSE(ndBrainBinaryFile::IsBinaryFile(textFileName));
+		EXPECT_TRUE(ndBrainBinaryFile::IsBinaryFile(binaryFileName));
+
+		// the loader detects the binary files, and the binary files are exact
+		ndSharedPtr<ndBrain> binaryBrain(ndBrainLoad::Load(binaryFileName));
+		ndSharedPtr<ndBrain> convertedBrain(ndBrainLoad::Load(convertedFileName));
+		ASSERT_TRUE(*binaryBrain != nullptr);
+		ASSERT_TRUE(*convertedBrain != nullptr);
+		ASSERT_EQ(binaryBrain->GetCount(), brain->GetCount());
+
+		ndBrainBinaryFile file;
+		ASSERT_TRUE(file.Open(binaryFileName));
+		ndBrainInference inference(file);
+		ASSERT_TRUE(inference.IsValid());
+		EXPECT_EQ(inference.GetInputSize(), brain->GetInputSize());
+		EXPECT_EQ(inference.GetOutputSize(), brain->GetOutputSize());
+
+		// padded weight rows, and one aligned block for the bias of each linear layer
+		ndInt64 parametersBytes = 0;
+		for (ndInt32 i = 0; i < brain->GetCount(); ++i)
+		{
+			const ndBrainLayer* const layer = (**brain)[i];
+			if (!strcmp(layer->GetLabelId(), "ndBrainLayerLinear"))
+			{
+				const ndInt64 stride = (layer->GetInputSize() + D_BRAIN_BINARY_ROW_ALIGNMENT - 1) & -D_BRAIN_BINARY_ROW_ALIGNMENT;
+				const ndInt64 biasBytes = ndInt64(layer->GetOutputSize() * sizeof(ndBrainFloat));
+				parametersBytes += stride * layer->GetOutputSize() * ndInt64(sizeof(ndBrainFloat));
+				parametersBytes += (biasBytes + D_BRAIN_BINARY_ALIGNMENT - 1) & -D_BRAIN_BINARY_ALIGNMENT;
+			}
+		}
+		EXPECT_EQ(inference.GetParametersBytes(), parametersBytes);
+
+		ndBrainVector input;
+		ndBrainVector output0;
+		ndBrainVector output1;
+		ndBrainVector output2;
+		ndBrainVector output3;
+		ndBrainVector workingBuffer;
+		input.SetCount(brain->GetInputSize());
+		output0.SetCount(brain->GetOutputSize());
+		output1.SetCount(brain->GetOutputSize());
+		output2.SetCount(brain->GetOutputSize());
+		output3.SetCount(brain->GetOutputSize());
+		for (ndInt32 n = 0; n < 8; ++n)
+		{
+			for (ndInt32 i = 0; i < input.GetCount(); ++i)
+			{
+				input[i] = ndBrainFloat(ndRand() * 2.0f - 1.0f);
+			}
+			brain->MakePrediction(input, output0, workingBuffer);
+			binaryBrain->MakePrediction(input, output1, workingBuffer);
+			convertedBrain->MakePrediction(input, output2, workingBuffer);
+			inference.MakePrediction(input, output3);
+			for (ndInt32 i = 0; i < output0.GetCount(); ++i)
+			{
+				EXPECT_EQ(output0[i], output1[i]);
+				EXPECT_NEAR(output0[i], output2[i], 1.0e-3f);
+				EXPECT_NEAR(output0[i], output3[i], 1.0e-5f);
+			}
+		}
+		file.Close();
+	}
+
+	// a closed file, or a layer the inference can not create, makes an invalid network
+	ndBrainBinaryFile closedFile;
+	const ndBrainInference closedInference(closedFile);
+	EXPECT_FALSE(closedInference.IsValid());
+	EXPECT_EQ(closedInference.GetOperationsCount(), 0);
+
+	FILE* const unknownLayerFile = fopen(binaryFileName, "r+b");
+	ASSERT_TRUE(unknownLayerFile != nullptr);
+	fseek(unknownLayerFile, 0, SEEK_END);
+	const ndInt32 binaryFileSize = ndInt32(ftell(unknownLayerFile));
+	fseek(unknownLayerFile, 0, SEEK_SET);
+	ndArray<char> fileData;
+	fileData.SetCount(binaryFileSize);
+	ASSERT_EQ(fread(&fileData[0], 1, size_t(binaryFileSize), unknownLayerFile), size_t(binaryFileSize));
+	const char* const convolutionLabel = "ndBrainLayerConvolutional_2d";
+	const ndInt32 labelSize = ndInt32(strlen(convolutionLabel));
+	ndInt32 labelOffset = -1;
+	for (ndInt32 i = 0; (labelOffset < 0) && (i <= binaryFileSize - labelSize); ++i)
+	{
+		labelOffset = memcmp(&fileData[i], convolutionLabel, size_t(labelSize)) ? -1 : i;
+	}
+	ASSERT_TRUE(labelOffset >= 0);
+
+	// image parameters that do not make a layer are rejected even without the hash
+	auto OpenWithDamagedField = [&fileData, binaryFileSize, convertedFileName](ndInt32 offset, ndInt32 value)
+	{
+		ndArray<char> damagedData(fileData);
+		memcpy(&damagedData[offset], &value, sizeof(value));
+		FILE* const damagedFile = fopen(convertedFileName, "wb");
+		fwrite(&damagedData[0], 1, size_t(binaryFileSize), damagedFile);
+		fclose(damagedFile);
+		ndBrainBinaryFile binaryFile;
+		return binaryFile.Open(convertedFileName, false);
+	};
+	const ndInt32 poolingOffset = labelOffset + ndInt32(sizeof(ndBrainBinaryFile::ndLayer));
+	EXPECT_TRUE(OpenWithDamagedField(labelOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_layout)), 0));
+	EXPECT_FALSE(OpenWithDamagedField(labelOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_kernelSize)), 9));
+	EXPECT_FALSE(OpenWithDamagedField(labelOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_kernelSize)), 0));
+	EXPECT_FALSE(OpenWithDamagedField(labelOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_width)), -8));
+	EXPECT_FALSE(OpenWithDamagedField(labelOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_filters)), 1 << 30));
+	EXPECT_FALSE(OpenWithDamagedField(poolingOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_channels)), 1 << 20));
+	EXPECT_FALSE(OpenWithDamagedField(poolingOffset + ndInt32(offsetof(ndBrainBinaryFile::ndLayer, m_layout)), 7));
+
+	fseek(unknownLayerFile, labelOffset, SEEK_SET);
+	fputc('X', unknownLayerFile);
+	fclose(unknownLayerFile);
+
+	ndBrainBinaryFile unknownLayer;
+	ASSERT_TRUE(unknownLayer.Open(binaryFileName, false));
+	const ndBrainInference unknownLayerInference(unknownLayer);
+	EXPECT_FALSE(unknownLayerInference.IsValid());
+	EXPECT_EQ(unknownLayerInference.GetOperationsCount(), 0);
+	unknownLayer.Close();
+
+	// a damaged byte anywhere in the file is caught by the hash
+	FILE* const file = fopen(binaryFileName, "r+b");
+	ASSERT_TRUE(file != nullptr);
+	fseek(file, -4, SEEK_END);
+	const ndUnsigned8 byte = 0x5a;
+	fwrite(&byte, 1, 1, file);
+	fclose(file);
+
+	ndBrainBinaryFile damagedFile;
+	EXPECT_FALSE(damagedFile.Open(binaryFileName));
+	EXPECT_TRUE(damagedFile.Open(binaryFileName, false));
+	EXPECT_TRUE(ndBrainLoad::Load(binaryFileName) == nullptr);
+	damagedFile.Close();
+
+	remove(textFileName);
+	remove(binaryFileName);
+	remove(convertedFileName);
+}
@@ -0,0 +1,366 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+constexpr ndInt32 GRID_SIZE = 67;
+constexpr ndFloat32 CELL_SIZE = 2.0f;
+
+static ndShapeHeightfield* BuildTerrain()
+{
+	ndShapeHeightfield* const shape = new ndShapeHeightfield(GRID_SIZE, GRID_SIZE, ndShapeHeightfield::m_normalDiagonals, CELL_SIZE, CELL_SIZE);
+	ndArray<ndReal>& heightMap = shape->GetElevationMap();
+	for (ndInt32 z = 0; z < GRID_SIZE; ++z)
+	{
+		for (ndInt32 x = 0; x < GRID_SIZE; ++x)
+		{
+			heightMap[z * GRID_SIZE + x] = ndReal(4.0f * ndSin(ndFloat32(x) * 0.3f) * ndCos(ndFloat32(z) * 0.2f));
+		}
+	}
+	shape->UpdateElevationMapAabb();
+	return shape;
+}
+
+static bool CastRay(ndWorld& world, const ndVector& p0, const ndVector& p1, ndVector& hitPoint)
+{
+	ndRayCastClosestHitCallback callback;
+	if (world.RayCast(callback, p0, p1))
+	{
+		hitPoint = callback.m_contact.m_point;
+		return true;
+	}
+	return false;
+}
+
+TEST(HeightfieldTest, RayCastMatchesSurface)
+{
+	ndWorld world;
+	ndShapeHeightfield* const shape = BuildTerrain();
+	ndShapeInstance instance(shape);
+
+	ndBodyKinematic* const body = new ndBodyDynamic();
+	body->SetMatrix(ndGetIdentityMatrix());
+	body->SetCollisionShape(instance);
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	world.Update(1.0f / 60.0f);
+	world.Sync();
+
+	// vertical rays must hit the grid vertices at the elevation value
+	const ndArray<ndReal>& heightMap = shape->GetElevationMap();
+	for (ndInt32 z = 1; z < GRID_SIZE - 1; z += 5)
+	{
+		for (ndInt32 x = 1; x < GRID_SIZE - 1; x += 7)
+		{
+			ndVector hit;
+			const ndVector p0(ndFloat32(x) * CELL_SIZE, 50.0f, ndFloat32(z) * CELL_SIZE, 1.0f);
+			const ndVector p1(ndFloat32(x) * CELL_SIZE, -50.0f, ndFloat32(z) * CELL_SIZE, 1.0f);
+			ASSERT_TRUE(CastRay(world, p0, p1, hit));
+			EXPECT_NEAR(hit.m_y, ndFloat32(heightMap[z * GRID_SIZE + x]), 1.0e-3f);
+		}
+	}
+
+	// slanted rays must stop on the surface, and the surface must be below the ray before the hit
+	for (ndInt32 i = 0; i < 64; ++i)
+	{
+		const ndFloat32 x0 = ndFloat32(i % 8) * 15.0f + 1.0f;
+		const ndFloat32 z0 = ndFloat32(i / 8) * 15.0f + 1.0f;
+		const ndVector p0(x0, 10.0f, z0, 1.0f);
+		const ndVector p1(ndFloat32(GRID_SIZE) * CELL_SIZE - z0, -10.0f, x0 + 5.0f, 1.0f);
+
+		ndVector hit;
+		if (CastRay(world, p0, p1, hit))
+		{
+			ndVector surface;
+			ASSERT_TRUE(CastRay(world, ndVector(hit.m_x, 50.0f, hit.m_z, 1.0f), ndVector(hit.m_x, -50.0f, hit.m_z, 1.0f), surface));
+			EXPECT_NEAR(hit.m_y, surface.m_y, 1.0e-2f);
+		}
+	}
+}
+
+TEST(HeightfieldTest, IncrementalElevationUpdate)
+{
+	ndWorld world;
+	ndShapeHeightfield* const shape = BuildTerrain();
+	ndShapeInstance instance(shape);
+
+	ndBodyKinematic* const body = new ndBodyDynamic();
+	body->SetMatrix(ndGetIdentityMatrix());
+	body->SetCollisionShape(instance);
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+
+	// raise a single vertex and only refresh the region around it
+	const ndInt32 x = 33;
+	const ndInt32 z = 20;
+	ndShapeHeightfield* const terrain = body->GetCollisionShape().GetShape()->GetAsShapeHeightfield();
+	terrain->GetElevationMap()[z * GRID_SIZE + x] = ndReal(30.0f);
+	terrain->UpdateElevationMapAabb(x, z, x, z);
+	world.Update(1.0f / 60.0f);
+	world.Sync();
+
+	ndVector hit;
+	const ndVector p0(ndFloat32(x) * CELL_SIZE, 100.0f, ndFloat32(z) * CELL_SIZE, 1.0f);
+	const ndVector p1(ndFloat32(x) * CELL_SIZE, -100.0f, ndFloat32(z) * CELL_SIZE, 1.0f);
+	ASSERT_TRUE(CastRay(world, p0, p1, hit));
+	EXPECT_NEAR(hit.m_y, 30.0f, 1.0e-3f);
+
+	// a ray passing just under the new peak must now be blocked by it
+	const ndVector q0(ndFloat32(x - 3) * CELL_SIZE, 29.0f, ndFloat32(z) * CELL_SIZE, 1.0f);
+	const ndVector q1(ndFloat32(x + 3) * CELL_SIZE, 29.0f, ndFloat32(z) * CELL_SIZE, 1.0f);
+	EXPECT_TRUE(CastRay(world, q0, q1, hit));
+
+	// a vertex on the last row is only the far corner of its cells
+	const ndInt32 edge = GRID_SIZE - 1;
+	terrain->GetElevationMap()[edge * GRID_SIZE + x] = ndReal(30.0f);
+	terrain->UpdateElevationMapAabb(x, edge, x, edge);
+
+	ndVector boxP0;
+	ndVector boxP1;
+	const ndVector c0(ndFloat32(x - 1) * CELL_SIZE, -100.0f, ndFloat32(edge - 1) * CELL_SIZE, 0.0f);
+	const ndVector c1(ndFloat32(x) * CELL_SIZE, 100.0f, ndFloat32(edge) * CELL_SIZE, 0.0f);
+	terrain->GetLocalAabb(c0, c1, boxP0, boxP1);
+	EXPECT_NEAR(boxP1.m_y, 30.0f, 1.0e-3f);
+}
+
+// marks each triangle of the grid by its cell and its half of the cell
+static ndInt32 GetFaceIndex(const ndVector* const face)
+{
+	ndInt32 x0 = GRID_SIZE;
+	ndInt32 z0 = GRID_SIZE;
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		x0 = ndMin(x0, ndInt32(ndFloor(face[i].m_x / CELL_SIZE + 0.5f)));
+		z0 = ndMin(z0, ndInt32(ndFloor(face[i].m_z / CELL_SIZE + 0.5f)));
+	}
+	ndInt32 side = 0;
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		const ndInt32 x = ndInt32(ndFloor(face[i].m_x / CELL_SIZE + 0.5f));
+		const ndInt32 z = ndInt32(ndFloor(face[i].m_z / CELL_SIZE + 0.5f));
+		side |= ((x == x0 + 1) && (z == z0 + 1)) ? 1 : 0;
+	}
+	return (z0 * (GRID_SIZE - 1) + x0) * 2 + side;
+}
+
+// a face query of a box in the mesh local space, outside the contact solver
+class BoxFaceQuery : public ndPolygonMeshDesc
+{
+	public:
+	BoxFaceQuery(const ndVector& boxP0, const ndVector& boxP1)
+		:ndPolygonMeshDesc()
+		,m_faceQuery()
+		,m_proceduralFaceQuery()
+	{
+		ndFastAabb& box = *this;
+		box = ndFastAabb(boxP0 & ndVector::m_triplexMask, boxP1 & ndVector::m_triplexMask);
+		m_staticMeshQuery = &m_faceQuery;
+		m_proceduralStaticMeshFaceQuery = &m_proceduralFaceQuery;
+	}
+
+	ndStaticMeshFaceQuery m_faceQuery;
+	ndProceduralStaticMeshFaceQuery m_proceduralFaceQuery;
+};
+
+// brute force, tests every triangle of the grid against the box
+class BruteForceFaceScan : public ndShapeDebugNotify
+{
+	public:
+	BruteForceFaceScan(const ndPolygonMeshDesc& box, ndArray<ndInt32>& faceMarks)
+		:ndShapeDebugNotify()
+		,m_box(box)
+		,m_faceMarks(faceMarks)
+	{
+	}
+
+	void DrawPolygon(ndInt32, const ndVector* const faceArray, const ndEdgeType* const) override
+	{
+		// the box test depends on the first vertex, the face query 
+		// starts the first triangle of each cell on a different one.
+		const ndInt32 faceIndex = GetFaceIndex(faceArray);
+		const ndInt32 indices[2][3] = { { 2, 0, 1 }, { 0, 1, 2 } };
+		const ndInt32* const index = indices[faceIndex & 1];
+		const ndVector normal((faceArray[1] - faceArray[0]).CrossProduct(faceArray[2] - faceArray[0]).Normalize());
+		if (m_box.PolygonBoxDistance(normal, 3, index, sizeof(ndVector) / sizeof(ndFloat32), &faceArray[0].m_x) > ndFloat32(0.0f))
+		{
+			m_faceMarks[faceIndex] += 1;
+		}
+	}
+
+	const ndPolygonMeshDesc& m_box;
+	ndArray<ndInt32>& m_faceMarks;
+};
+
+TEST(HeightfieldTest, CulledFacesMatchBruteForce)
+{
+	ndShapeHeightfield* const heightfield = BuildTerrain();
+	ndShapeInstance instance(heightfield);
+	ndShapeStaticMesh* const shape = instance.GetShape()->GetAsShapeStaticMesh();
+
+	// boxes crossing the blocks of several pyramid levels, thin slabs
+	// where the culling removes most cells, and a box above the terrain.
+	const ndVector boxes[][2] =
+	{
+		{ ndVector(21.0f, -1.0f, 9.0f, 0.0f), ndVector(71.0f, 1.0f, 93.0f, 0.0f) },
+		{ ndVector(29.5f, 2.5f, 27.0f, 0.0f), ndVector(66.5f, 3.5f, 70.0f, 0.0f) },
+		{ ndVector(1.0f, -3.8f, 1.0f, 0.0f), ndVector(130.0f, -3.2f, 130.0f, 0.0f) },
+		{ ndVector(60.0f, -4.5f, 12.0f, 0.0f), ndVector(100.0f, -2.5f, 60.0f, 0.0f) },
+		{ ndVector(0.5f, 3.6f, 0.5f, 0.0f), ndVector(30.0f, 4.5f, 30.0f, 0.0f) },
+		{ ndVector(10.0f, 6.0f, 10.0f, 0.0f), ndVector(90.0f, 8.0f, 90.0f, 0.0f) },
+	};
+
+	for (ndInt32 i = 0; i < ndInt32(sizeof(boxes) / sizeof(boxes[0])); ++i)
+	{
+		ndArray<ndInt32> faceMarks;
+		faceMarks.SetCount((GRID_SIZE - 1) * (GRID_SIZE - 1) * 2);
+		ndMemSet(&faceMarks[0], 0, faceMarks.GetCount());
+
+		BoxFaceQuery query(boxes[i][0], boxes[i][1]);
+		shape->GetCollidingFaces(&query);
+		const ndPolygonMeshDesc::ndStaticMeshFaceQuery& faces = *query.m_staticMeshQuery;
+		const ndInt32 stride = query.m_vertexStrideInBytes / ndInt32(sizeof(ndFloat32));
+		for (ndInt32 j = 0; j < faces.m_faceIndexCount.GetCount(); ++j)
+		{
+			const ndInt32* const indices = &faces.m_faceVertexIndex[faces.m_faceIndexStart[j]];
+			ndVector face[3];
+			for (ndInt32 k = 0; k < 3; ++k)
+			{
+				const ndFloat32* const point = &query.m_vertex[indices[k] * stride];
+				face[k] = ndVector(point[0], point[1], point[2], ndFloat32(0.0f));
+			}
+			faceMarks[GetFaceIndex(face)] += 2;
+		}
+
+		BoxFaceQuery box(boxes[i][0], boxes[i][1]);
+		box.SetSeparatingDistance(ndFloat32(0.0f));
+		BruteForceFaceScan bruteForce(box, faceMarks);
+		shape->DebugShape(ndGetIdentityMatrix(), bruteForce);
+
+		// every face must be found by both, or by none
+		ndInt32 bruteForceCount = 0;
+		for (ndInt32 j = 0; j < faceMarks.GetCount(); ++j)
+		{
+			EXPECT_TRUE((faceMarks[j] == 0) || (faceMarks[j] == 3));
+			bruteForceCount += (faceMarks[j] == 3) ? 1 : 0;
+		}
+		EXPECT_EQ(bruteForceCount, faces.m_faceIndexCount.GetCount());
+		if (i < 5)
+		{
+			EXPECT_GT(bruteForceCount, 0);
+		}
+		else
+		{
+			EXPECT_EQ(bruteForceCount, 0);
+		}
+	}
+}
+
+class ProceduralTileLoader : public ndShapeTiledHeightfield::ndTileLoader
+{
+	public:
+	ProceduralTileLoader(ndInt32 tileSize)
+		:ndShapeTiledHeightfield::ndTileLoader()
+		,m_tileSize(tileSize)
+		,m_loadCount(0)
+		,m_unloadCount(0)
+	{
+	}
+
+	bool LoadTile(ndShapeTiledHeightfield::ndTile& tile, ndArray<ndReal>& elevation, ndArray<ndInt8>&) override
+	{
+		// a sloped plane, continuous across tile borders
+		const ndInt32 stride = m_tileSize + 1;
+		for (ndInt32 z = 0; z < stride; ++z)
+		{
+			for (ndInt32 x = 0; x < stride; ++x)
+			{
+				const ndInt32 gx = tile.m_x * m_tileSize + x;
+				elevation[z * stride + x] = ndReal(ndFloat32(gx) * 0.1f);
+			}
+		}
+		m_loadCount++;
+		return true;
+	}
+
+	void UnloadTile(ndShapeTiledHeightfield::ndTile&) override
+	{
+		m_unloadCount++;
+	}
+
+	ndInt32 m_tileSize;
+	ndAtomic<ndInt32> m_loadCount;
+	ndInt32 m_unloadCount;
+};
+
+TEST(HeightfieldTest, TiledStreaming)
+{
+	const ndInt32 tileSize = 16;
+	ProceduralTileLoader* const loader = new ProceduralTileLoader(tileSize);
+	ndShapeTiledHeightfield* const terrain = new ndShapeTiledHeightfield(loader, tileSize, 64, 64, 1.0f, 1.0f, 0.0f, 200.0f);
+	terrain->SetMaxResidentTiles(8);
+
+	ndWorld world;
+	ndShapeInstance instance(terrain);
+	ndBodyKinematic* const body = new ndBodyDynamic();
+	body->SetMatrix(ndGetIdentityMatrix());
+	body->SetCollisionShape(instance);
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+
+	// nothing is resident until a query or the application asks for it
+	EXPECT_EQ(terrain->GetResidentTileCount(), 0);
+
+	const ndVector point(100.0f, 0.0f, 100.0f, 0.0f);
+	terrain->UpdateResidentTiles(&point, 1, 10.0f);
+	EXPECT_EQ(terrain->GetResidentTileCount(), 4);
+
+	// a ray crossing several tiles resolves them lazily
+	ndRayCastClosestHitCallback callback;
+	const ndVector p0(20.0f, 100.0f, 500.0f, 1.0f);
+	const ndVector p1(20.0f, -10.0f, 500.0f, 1.0f);
+	ASSERT_TRUE(world.RayCast(callback, p0, p1));
+	EXPECT_NEAR(callback.m_contact.m_point.m_y, 2.0f, 1.0e-3f);
+
+	// moving the active region far away evicts the old tiles over budget
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		const ndVector farPoint(800.0f, 0.0f, 200.0f * ndFloat32(i), 0.0f);
+		terrain->UpdateResidentTiles(&farPoint, 1, 10.0f);
+	}
+	EXPECT_LE(terrain->GetResidentTileCount(), terrain->GetMaxResidentTiles());
+	EXPECT_GT(loader->m_unloadCount, 0);
+
+	// a box dropped on the terrain comes to rest on the slope
+	ndBodyDynamic* const box = new ndBodyDynamic();
+	box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = ndVector(320.0f, 40.0f, 320.0f, 1.0f);
+	box->SetMatrix(matrix);
+	ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+	box->SetCollisionShape(boxShape);
+	box->SetMassMatrix(1.0f, boxShape);
+	ndSharedPtr<ndBody> boxPtr(box);
+	world.AddBody(boxPtr);
+	for (ndInt32 i = 0; i < 240; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+
+	const ndVector posit(box->GetMatrix().m_posit);
+	EXPECT_GT(posit.m_y, posit.m_x * 0.1f - 0.5f);
+	EXPECT_LT(posit.m_y, posit.m_x * 0.1f + 1.5f);
+
+	// each tile is loaded once while it stays resident
+	EXPECT_EQ(loader->m_loadCount.load(), terrain->GetResidentTileCount() + loader->m_unloadCount);
+}
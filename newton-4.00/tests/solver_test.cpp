@@ -0,0 +1,647 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+constexpr ndInt32 STACK_HIGH = 6;
+constexpr ndInt32 STACK_COUNT = 4;
+
+static ndBodyDynamic* AddBox(ndWorld& world, const ndVector& posit, ndFloat32 mass, ndFloat32 sizex, ndFloat32 sizey, ndFloat32 sizez)
+{
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	ndShapeInstance shape(new ndShapeBox(sizex, sizey, sizez));
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = posit;
+	body->SetMatrix(matrix);
+	body->SetCollisionShape(shape);
+	if (mass > ndFloat32(0.0f))
+	{
+		body->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+		body->SetMassMatrix(mass, shape);
+	}
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	return body;
+}
+
+// several box stacks on a static floor, the stacks must settle without toppling.
+static void BuildStacks(ndWorld& world, ndArray<ndBodyDynamic*>& boxes)
+{
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), 0.0f, 100.0f, 1.0f, 100.0f);
+	for (ndInt32 i = 0; i < STACK_COUNT; ++i)
+	{
+		for (ndInt32 j = 0; j < STACK_HIGH; ++j)
+		{
+			const ndVector posit(ndFloat32(i) * 4.0f, ndFloat32(j) * 1.1f + 0.6f, 0.0f, 1.0f);
+			boxes.PushBack(AddBox(world, posit, 1.0f, 1.0f, 1.0f, 1.0f));
+		}
+	}
+}
+
+TEST(SolverTest, ColoredGaussSeidelStacks)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	world.SelectSolver(ndWorld::ndColoredGaussSeidelSolver);
+	EXPECT_EQ(world.GetSelectedSolver(), ndWorld::ndColoredGaussSeidelSolver);
+	EXPECT_STREQ(world.GetSolverString(), "colored gauss seidel");
+
+	ndArray<ndBodyDynamic*> boxes;
+	BuildStacks(world, boxes);
+	for (ndInt32 i = 0; i < 180; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+
+	for (ndInt32 i = 0; i < STACK_COUNT; ++i)
+	{
+		for (ndInt32 j = 0; j < STACK_HIGH; ++j)
+		{
+			const ndVector posit(boxes[i * STACK_HIGH + j]->GetMatrix().m_posit);
+			EXPECT_NEAR(posit.m_x, ndFloat32(i) * 4.0f, 0.05f);
+			EXPECT_NEAR(posit.m_y, ndFloat32(j) + 0.5f, 0.1f);
+			EXPECT_NEAR(posit.m_z, 0.0f, 0.05f);
+		}
+	}
+
+	// switching back to the default solver keeps the scene
+	world.SelectSolver(ndWorld::ndStandardSolver);
+	world.Update(1.0f / 60.0f);
+	world.Sync();
+	EXPECT_NEAR(boxes[STACK_HIGH - 1]->GetMatrix().m_posit.m_y, ndFloat32(STACK_HIGH) - 0.5f, 0.1f);
+}
+
+// the island scheduling only changes the order the joints are solved in,
+// with the early termination disabled the result must match the default solver.
+TEST(SolverTest, IslandSolverMatchesDefault)
+{
+	auto BuildScene = [](ndWorld& world, ndArray<ndBodyDynamic*>& boxes)
+	{
+		world.SetThreadCount(4);
+		AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), 0.0f, 200.0f, 1.0f, 200.0f);
+
+		// many small piles
+		for (ndInt32 i = 0; i < 64; ++i)
+		{
+			const ndFloat32 x = ndFloat32(i % 8) * 3.0f - 40.0f;
+			const ndFloat32 z = ndFloat32(i / 8) * 3.0f;
+			for (ndInt32 j = 0; j < 3; ++j)
+			{
+				boxes.PushBack(AddBox(world, ndVector(x, ndFloat32(j) * 1.1f + 0.6f, z, 1.0f), 1.0f, 1.0f, 1.0f, 1.0f));
+			}
+		}
+
+		// and a single large wall
+		for (ndInt32 i = 0; i < 20; ++i)
+		{
+			for (ndInt32 j = 0; j < 8; ++j)
+			{
+				const ndFloat32 offset = (j & 1) ? 0.5f : 0.0f;
+				boxes.PushBack(AddBox(world, ndVector(ndFloat32(i) + offset + 10.0f, ndFloat32(j) * 0.51f + 0.26f, 0.0f, 1.0f), 1.0f, 0.98f, 0.5f, 0.5f));
+			}
+		}
+	};
+
+	ndWorld world0;
+	ndArray<ndBodyDynamic*> boxes0;
+	BuildScene(world0, boxes0);
+
+	ndWorld world1;
+	world1.SelectSolver(ndWorld::ndIslandParallelSolver);
+	world1.SetSolverTolerance(0.0f);
+	EXPECT_STREQ(world1.GetSolverString(), "island parallel");
+	ndArray<ndBodyDynamic*> boxes1;
+	BuildScene(world1, boxes1);
+
+	for (ndInt32 i = 0; i < 60; ++i)
+	{
+		world0.Update(1.0f / 60.0f);
+		world1.Update(1.0f / 60.0f);
+		world0.Sync();
+		world1.Sync();
+	}
+
+	for (ndInt32 i = 0; i < boxes0.GetCount(); ++i)
+	{
+		const ndVector posit0(boxes0[i]->GetMatrix().m_posit);
+		const ndVector posit1(boxes1[i]->GetMatrix().m_posit);
+		EXPECT_NEAR(posit0.m_x, posit1.m_x, 1.0e-3f);
+		EXPECT_NEAR(posit0.m_y, posit1.m_y, 1.0e-3f);
+		EXPECT_NEAR(posit0.m_z, posit1.m_z, 1.0e-3f);
+	}
+}
+
+// resting contacts must keep their points from one step to the next
+// so that the solver starts from the forces of the previous step.
+TEST(SolverTest, ContactWarmStart)
+{
+	ndWorld world;
+	ndBodyDynamic* const floor = AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), 0.0f, 100.0f, 1.0f, 100.0f);
+
+	ndArray<ndBodyDynamic*> boxes;
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		ndBodyDynamic* const box = AddBox(world, ndVector(0.0f, ndFloat32(i) * 1.05f + 0.55f, 0.0f, 1.0f), 1.0f, 1.0f, 1.0f, 1.0f);
+		box->SetAutoSleep(false);
+		boxes.PushBack(box);
+	}
+
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+
+	auto FindFloorContact = [floor](ndBodyKinematic* const body)
+	{
+		ndContact* floorContact = nullptr;
+		ndBodyKinematic::ndContactMap::Iterator it(body->GetContactMap());
+		for (it.Begin(); it; it++)
+		{
+			ndContact* const contact = *it;
+			if (contact->IsActive() && ((contact->GetBody0() == floor) || (contact->GetBody1() == floor)))
+			{
+				floorContact = contact;
+			}
+		}
+		return floorContact;
+	};
+
+	ndContact* const contact = FindFloorContact(boxes[0]);
+	ASSERT_TRUE(contact != nullptr);
+	ndArray<const ndContactMaterial*> points;
+	const ndContactPointList& contactPoints = contact->GetContactPoints();
+	for (ndContactPointList::ndNode* node = contactPoints.GetFirst(); node; node = node->GetNext())
+	{
+		points.PushBack(&node->GetInfo());
+	}
+	ASSERT_GE(points.GetCount(), 3);
+
+	world.Update(1.0f / 60.0f);
+	world.Sync();
+
+	// the same points are reused and carry the weight of the stack as initial guess
+	ASSERT_EQ(FindFloorContact(boxes[0]), contact);
+	ndFloat32 normalForce = 0.0f;
+	ndInt32 matchCount = 0;
+	for (ndContactPointList::ndNode* node = contactPoints.GetFirst(); node; node = node->GetNext())
+	{
+		const ndContactMaterial* const point = &node->GetInfo();
+		for (ndInt32 i = 0; i < points.GetCount(); ++i)
+		{
+			matchCount += (points[i] == point) ? 1 : 0;
+		}
+		normalForce += point->m_normal_Force.GetInitialGuess();
+	}
+	EXPECT_EQ(matchCount, points.GetCount());
+	EXPECT_NEAR(normalForce, 40.0f, 4.0f);
+}
+
+// resting islands converge in a single pass, islands that are still 
+// settling take more passes, bounded by twice the nominal count.
+TEST(SolverTest, IslandSolverAdaptivePasses)
+{
+	ndWorld world;
+	world.SelectSolver(ndWorld::ndIslandParallelSolver);
+	EXPECT_GT(world.GetSolverTolerance(), 0.0f);
+
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), 0.0f, 100.0f, 1.0f, 100.0f);
+	ndArray<ndBodyDynamic*> boxes;
+	for (ndInt32 i = 0; i < STACK_COUNT; ++i)
+	{
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			ndBodyDynamic* const box = AddBox(world, ndVector(ndFloat32(i) * 4.0f, ndFloat32(j) * 1.05f + 0.55f, 0.0f, 1.0f), 1.0f, 1.0f, 1.0f, 1.0f);
+			box->SetAutoSleep(false);
+			boxes.PushBack(box);
+		}
+	}
+
+	ndInt32 maxPasses = 0;
+	for (ndInt32 i = 0; i < 30; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+		world.Sync();
+		maxPasses = ndMax(maxPasses, world.GetMaxSolverPasses());
+
+		// each stack is an island of its own once the boxes touch
+		const ndArray<ndInt32>& islandPasses = world.GetIslandSolverPasses();
+		EXPECT_TRUE((islandPasses.GetCount() == 0) || (islandPasses.GetCount() == STACK_COUNT));
+		for (ndInt32 j = 0; j < islandPasses.GetCount(); ++j)
+		{
+			EXPECT_GE(islandPasses[j], 1);
+			EXPECT_LE(islandPasses[j], world.GetMaxSolverPasses());
+		}
+	}
+	// the nominal passes are the iterations plus a few for the joint valence.
+	EXPECT_GT(maxPasses, 1);
+	EXPECT_LE(maxPasses, 2 * (world.GetSolverIterations() + 8));
+
+	for (ndInt32 i = 0; i < 90; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+	EXPECT_EQ(world.GetMaxSolverPasses(), 1);
+	EXPECT_NEAR(world.GetAverageSolverPasses(), 1.0f, 1.0e-3f);
+	const ndArray<ndInt32>& restingPasses = world.GetIslandSolverPasses();
+	ASSERT_EQ(restingPasses.GetCount(), STACK_COUNT);
+	for (ndInt32 i = 0; i < restingPasses.GetCount(); ++i)
+	{
+		EXPECT_EQ(restingPasses[i], 1);
+	}
+
+	for (ndInt32 i = 0; i < boxes.GetCount(); ++i)
+	{
+		EXPECT_NEAR(boxes[i]->GetMatrix().m_posit.m_y, ndFloat32(i % 3) + 0.5f, 0.1f);
+	}
+}
+
+// the adaptive islands must settle like a solver that always runs the 
+// most passes the adaptive islands can take, while using fewer passes.
+TEST(SolverTest, IslandSolverAdaptiveMatchesFullPasses)
+{
+	ndWorld adaptive;
+	ndWorld reference;
+	adaptive.SelectSolver(ndWorld::ndIslandParallelSolver);
+	reference.SelectSolver(ndWorld::ndIslandParallelSolver);
+	reference.SetSolverTolerance(0.0f);
+
+	// the stacks take six nominal passes, so the reference runs twice as many
+	reference.SetSolverIterations(adaptive.GetSolverIterations() + 6);
+
+	ndArray<ndBodyDynamic*> adaptiveBoxes;
+	ndArray<ndBodyDynamic*> referenceBoxes;
+	BuildStacks(adaptive, adaptiveBoxes);
+	BuildStacks(reference, referenceBoxes);
+
+	ndInt32 adaptivePasses = 0;
+	ndInt32 referencePasses = 0;
+	ndFloat32 maxDeviation = 0.0f;
+	for (ndInt32 i = 0; i < 480; ++i)
+	{
+		adaptive.Update(1.0f / 60.0f);
+		reference.Update(1.0f / 60.0f);
+		adaptive.Sync();
+		reference.Sync();
+		if (adaptive.GetIslandSolverPasses().GetCount())
+		{
+			EXPECT_LE(adaptive.GetMaxSolverPasses(), reference.GetMaxSolverPasses());
+		}
+		adaptivePasses += ndInt32(adaptive.GetAverageSolverPasses() * ndFloat32(adaptive.GetIslandSolverPasses().GetCount()) + 0.5f);
+		referencePasses += ndInt32(reference.GetAverageSolverPasses() * ndFloat32(reference.GetIslandSolverPasses().GetCount()) + 0.5f);
+
+		for (ndInt32 j = 0; j < adaptiveBoxes.GetCount(); ++j)
+		{
+			const ndVector step(adaptiveBoxes[j]->GetMatrix().m_posit - referenceBoxes[j]->GetMatrix().m_posit);
+			maxDeviation = ndMax(maxDeviation, ndSqrt(step.DotProduct(step & ndVector::m_triplexMask).GetScalar()));
+		}
+	}
+	EXPECT_LT(adaptivePasses, referencePasses);
+	EXPECT_LT(maxDeviation, 0.04f);
+
+	for (ndInt32 i = 0; i < adaptiveBoxes.GetCount(); ++i)
+	{
+		const ndVector posit(adaptiveBoxes[i]->GetMatrix().m_posit);
+		const ndVector referencePosit(referenceBoxes[i]->GetMatrix().m_posit);
+		EXPECT_NEAR(posit.m_y, referencePosit.m_y, 0.02f);
+		EXPECT_NEAR(adaptiveBoxes[i]->GetVelocity().m_y, referenceBoxes[i]->GetVelocity().m_y, 0.05f);
+	}
+}
+
+// a slowly creeping ball goes to sleep after the steps of its sleep table entry, and 
+// setting the velocity starts the count again. a ball rolling faster only goes to sleep 
+// with the long last entry. a free body drifting at a creeping speed keeps moving.
+TEST(SolverTest, ProgressiveSleep)
+{
+	ndWorld world;
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), 0.0f, 100.0f, 1.0f, 100.0f);
+
+	auto AddBall = [&world](const ndVector& posit, const ndVector& gravity, ndFloat32 speed)
+	{
+		ndBodyDynamic* const body = new ndBodyDynamic();
+		ndShapeInstance shape(new ndShapeSphere(0.5f));
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = posit;
+		body->SetMatrix(matrix);
+		body->SetCollisionShape(shape);
+		body->SetNotifyCallback(new ndBodyNotify(gravity));
+		body->SetMassMatrix(1.0f, shape);
+		body->SetVelocity(ndVector(speed, 0.0f, 0.0f, 0.0f));
+		body->SetOmega(ndVector(0.0f, 0.0f, -2.0f * speed, 0.0f));
+		ndSharedPtr<ndBody> bodyPtr(body);
+		world.AddBody(bodyPtr);
+		return body;
+	};
+
+	const ndVector gravity(0.0f, -10.0f, 0.0f, 0.0f);
+	ndBodyDynamic* const roller = AddBall(ndVector(0.0f, 0.5f, 0.0f, 1.0f), gravity, 0.15f);
+	ndBodyDynamic* const creeper = AddBall(ndVector(0.0f, 0.5f, 10.0f, 1.0f), gravity, 0.04f);
+	ndBodyDynamic* const drifter = AddBall(ndVector(0.0f, 20.0f, 20.0f, 1.0f), ndVector::m_zero, 0.04f);
+
+	auto Step = [&world](ndInt32 frames)
+	{
+		for (ndInt32 i = 0; i < frames; ++i)
+		{
+			world.Update(1.0f / 60.0f);
+		}
+		world.Sync();
+	};
+
+	// the creeper spin is within the entry of 36 steps, let it count most 
+	// of them, then set its velocity again and run past the original count.
+	Step(25);
+	EXPECT_FALSE(creeper->GetSleepState());
+	creeper->SetVelocity(creeper->GetVelocity());
+	Step(25);
+	EXPECT_FALSE(creeper->GetSleepState());
+
+	ndInt32 sleepFrame = -1;
+	for (ndInt32 i = 0; (i < 60) && (sleepFrame < 0); ++i)
+	{
+		Step(1);
+		sleepFrame = creeper->GetSleepState() ? i : -1;
+	}
+	EXPECT_GE(sleepFrame, 0);
+	const ndFloat32 x = creeper->GetMatrix().m_posit.m_x;
+
+	// the roller speed is well above the short entries, so it is still rolling.
+	EXPECT_FALSE(roller->GetSleepState());
+	ndInt32 rollerSleepFrame = -1;
+	for (ndInt32 i = 0; (i < 600) && (rollerSleepFrame < 0); ++i)
+	{
+		Step(1);
+		rollerSleepFrame = roller->GetSleepState() ? i : -1;
+	}
+	EXPECT_GE(rollerSleepFrame, 0);
+
+	const ndFloat32 rollerX = roller->GetMatrix().m_posit.m_x;
+	Step(30);
+	EXPECT_TRUE(roller->GetSleepState());
+	EXPECT_NEAR(roller->GetMatrix().m_posit.m_x, rollerX, 1.0e-4f);
+
+	EXPECT_TRUE(creeper->GetSleepState());
+	EXPECT_NEAR(creeper->GetMatrix().m_posit.m_x, x, 1.0e-4f);
+
+	EXPECT_FALSE(drifter->GetSleepState());
+	EXPECT_NEAR(drifter->GetVelocity().m_x, 0.04f, 1.0e-4f);
+}
+
+// each settled stack is cached as one sleeping island, pushing the bottom box 
+// wakes the whole stack in the same step and leaves the other stacks asleep.
+TEST(SolverTest, SleepingIslandWakesAsWhole)
+{
+	ndWorld world;
+	ndArray<ndBodyDynamic*> boxes;
+	BuildStacks(world, boxes);
+
+	auto AllSleeping = [&boxes](ndInt32 start, ndInt32 count)
+	{
+		bool sleeping = true;
+		for (ndInt32 i = start; i < start + count; ++i)
+		{
+			sleeping = sleeping && boxes[i]->GetSleepState();
+		}
+		return sleeping;
+	};
+
+	for (ndInt32 i = 0; (i < 600) && !AllSleeping(0, boxes.GetCount()); ++i)
+	{
+		world.Update(1.0f / 60.0f);
+		world.Sync();
+	}
+	ASSERT_TRUE(AllSleeping(0, boxes.GetCount()));
+	EXPECT_EQ(world.GetSleepingIslandCount(), STACK_COUNT);
+
+	boxes[0]->SetVelocity(ndVector(1.0f, 0.0f, 0.0f, 0.0f));
+	world.Update(1.0f / 60.0f);
+	world.Sync();
+
+	for (ndInt32 i = 0; i < STACK_HIGH; ++i)
+	{
+		EXPECT_FALSE(boxes[i]->GetSleepState());
+	}
+	EXPECT_TRUE(AllSleeping(STACK_HIGH, boxes.GetCount() - STACK_HIGH));
+	EXPECT_EQ(world.GetSleepingIslandCount(), STACK_COUNT - 1);
+}
+
+// with one collision pass per step and several solver substeps, stacks 
+// with a large mass ratio must settle without sinking into each other.
+TEST(SolverTest, SubstepMassRatioStacks)
+{
+	ndWorld world;
+	world.SetThreadCount(4);
+	world.SetSubSteps(8);
+	world.SelectSolver(ndWorld::ndSubstepSolver);
+	EXPECT_EQ(world.GetSelectedSolver(), ndWorld::ndSubstepSolver);
+	EXPECT_STREQ(world.GetSolverString(), "substeps");
+
+	AddBox(world, ndVector(0.0f, -0.5f, 0.0f, 1.0f), 0.0f, 100.0f, 1.0f, 100.0f);
+	ndArray<ndBodyDynamic*> boxes;
+	for (ndInt32 i = 0; i < STACK_COUNT; ++i)
+	{
+		for (ndInt32 j = 0; j < STACK_HIGH; ++j)
+		{
+			// every other box is 20 times heavier than the one below it
+			const ndFloat32 mass = (j & 1) ? 20.0f : 1.0f;
+			const ndVector posit(ndFloat32(i) * 4.0f, ndFloat32(j) * 1.1f + 0.6f, 0.0f, 1.0f);
+			boxes.PushBack(AddBox(world, posit, mass, 1.0f, 1.0f, 1.0f));
+		}
+	}
+
+	for (ndInt32 i = 0; i < 180; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+
+	for (ndInt32 i = 0; i < STACK_COUNT; ++i)
+	{
+		for (ndInt32 j = 0; j < STACK_HIGH; ++j)
+		{
+			const ndVector posit(boxes[i * STACK_HIGH + j]->GetMatrix().m_posit);
+			EXPECT_NEAR(posit.m_x, ndFloat32(i) * 4.0f, 0.05f);
+			EXPECT_NEAR(posit.m_y, ndFloat32(j) + 0.5f, 0.1f);
+			EXPECT_NEAR(posit.m_z, 0.0f, 0.05f);
+		}
+	}
+}
+
+// a hub with six arms hanging from a ball joint, the skeleton is large enough 
+// to be split into branches, so with several threads it is solved in parallel.
+static void BuildArticulatedHub(ndWorld& world, ndArray<ndBodyDynamic*>& tips, const ndVector& origin = ndVector(0.0f, 10.0f, 0.0f, 1.0f))
+{
+	const ndInt32 armCount = 6;
+	const ndInt32 armLinks = 12;
+	const ndVector gravity(0.0f, -10.0f, 0.0f, 0.0f);
+	ndShapeInstance shape(new ndShapeSphere(0.2f));
+
+	auto AddLink = [&world, &shape, &gravity](const ndVector& posit, ndFloat32 mass)
+	{
+		ndBodyDynamic* const body = new ndBodyDynamic();
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = posit;
+		body->SetMatrix(matrix);
+		body->SetCollisionShape(shape);
+		body->SetNotifyCallback(new ndBodyNotify(gravity));
+		body->SetMassMatrix(mass, shape);
+		ndSharedPtr<ndBody> bodyPtr(body);
+		world.AddBody(bodyPtr);
+		return body;
+	};
+
+	auto AddJoint = [&world](ndJointBilateralConstraint* const joint)
+	{
+		joint->SetSolverModel(m_jointkinematicOpenLoop);
+		ndSharedPtr<ndJointBilateralConstraint> jointPtr(joint);
+		world.AddJoint(jointPtr);
+	};
+
+	ndBodyDynamic* const hub = AddLink(origin, 10.0f);
+	ndMatrix pivot(ndGetIdentityMatrix());
+	pivot.m_posit = origin + ndVector(0.0f, 0.5f, 0.0f, 0.0f);
+	AddJoint(new ndJointSpherical(pivot, hub, world.GetSentinelBody()));
+
+	for (ndInt32 i = 0; i < armCount; ++i)
+	{
+		const ndFloat32 angle = ndFloat32(i) * 2.0f * ndPi / ndFloat32(armCount);
+		const ndVector dir(ndCos(angle), 0.0f, ndSin(angle), 0.0f);
+		ndBodyDynamic* parent = hub;
+		for (ndInt32 j = 0; j < armLinks; ++j)
+		{
+			ndBodyDynamic* const link = AddLink(origin + dir.Scale(0.5f * ndFloat32(j + 1)), 1.0f);
+			pivot.m_posit = origin + dir.Scale(0.5f * ndFloat32(j) + 0.25f);
+			AddJoint(new ndJointSpherical(pivot, link, parent));
+			parent = link;
+		}
+		tips.PushBack(parent);
+	}
+
+	// close a loop between the tips of the first two arms
+	const ndInt32 base = tips.GetCount() - armCount;
+	AddJoint(new ndJointFixDistance(tips[base + 0]->GetMatrix().m_posit, tips[base + 1]->GetMatrix().m_posit, tips[base + 0], tips[base + 1]));
+}
+
+TEST(SolverTest, ParallelSkeletonMatchesSerial)
+{
+	ndWorld world0;
+	ndWorld world1;
+	world1.SetThreadCount(4);
+
+	ndArray<ndBodyDynamic*> tips0;
+	ndArray<ndBodyDynamic*> tips1;
+	BuildArticulatedHub(world0, tips0);
+	BuildArticulatedHub(world1, tips1);
+
+	ndFloat32 lowestTip = 10.0f;
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		world0.Update(1.0f / 60.0f);
+		world1.Update(1.0f / 60.0f);
+		world0.Sync();
+		world1.Sync();
+		lowestTip = ndMin(lowestTip, tips0[2]->GetMatrix().m_posit.m_y);
+	}
+
+	for (ndInt32 i = 0; i < tips0.GetCount(); ++i)
+	{
+		const ndVector posit0(tips0[i]->GetMatrix().m_posit);
+		const ndVector posit1(tips1[i]->GetMatrix().m_posit);
+		const ndVector error(posit1 - posit0);
+		EXPECT_LT(error.DotProduct(error & ndVector::m_triplexMask).GetScalar(), 1.0e-4f);
+	}
+
+	// the arms swing under the hub, and the loop joint keeps the first two tips together
+	EXPECT_LT(lowestTip, 7.0f);
+	const ndVector span(tips0[1]->GetMatrix().m_posit - tips0[0]->GetMatrix().m_posit);
+	EXPECT_NEAR(ndSqrt(span.DotProduct(span & ndVector::m_triplexMask).GetScalar()), 6.0f, 0.1f);
+}
+
+TEST(SolverTest, SharedSkeletonPlans)
+{
+	// the second hub reuses the factorization plans of the first one,
+	// so both must move exactly like a hub simulated alone.
+	ndWorld world0;
+	ndWorld world1;
+
+	ndArray<ndBodyDynamic*> tips0;
+	ndArray<ndBodyDynamic*> tips1;
+	const ndVector offset(20.0f, 0.0f, 0.0f, 0.0f);
+	BuildArticulatedHub(world0, tips0);
+	BuildArticulatedHub(world1, tips1);
+	BuildArticulatedHub(world1, tips1, ndVector(0.0f, 10.0f, 0.0f, 1.0f) + offset);
+
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		world0.Update(1.0f / 60.0f);
+		world1.Update(1.0f / 60.0f);
+		world0.Sync();
+		world1.Sync();
+	}
+
+	for (ndInt32 i = 0; i < tips0.GetCount(); ++i)
+	{
+		const ndVector posit0(tips0[i]->GetMatrix().m_posit);
+		const ndVector error0(tips1[i]->GetMatrix().m_posit - posit0);
+		const ndVector error1(tips1[i + tips0.GetCount()]->GetMatrix().m_posit - offset - posit0);
+		EXPECT_LT(error0.DotProduct(error0 & ndVector::m_triplexMask).GetScalar(), 1.0e-4f);
+		EXPECT_LT(error1.DotProduct(error1 & ndVector::m_triplexMask).GetScalar(), 1.0e-4f);
+	}
+}
+
+TEST(SolverTest, MixedPrecisionFarFromOrigin)
+{
+	if (!ndBody::IsMixedPrecision())
+	{
+		GTEST_SKIP() << "the library is not built with NEWTON_MIXED_PRECISION";
+	}
+
+	// at 20 km a float step is about 2 mm, a slow body 
+	// moving less than that per step must still move.
+	ndWorld world;
+	ndBodyDynamic* const body = new ndBodyDynamic();
+	ndShapeInstance shape(new ndShapeSphere(0.5f));
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = ndVector(20000.0f, 0.0f, 0.0f, 1.0f);
+	body->SetMatrix(matrix);
+	body->SetCollisionShape(shape);
+	body->SetMassMatrix(1.0f, shape);
+	body->SetNotifyCallback(new ndBodyNotify(ndVector::m_zero));
+	body->SetAutoSleep(false);
+	body->SetVelocity(ndVector(0.05f, 0.0f, 0.0f, 0.0f));
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+
+	const ndFloat64 travel = body->GetPrecisePosition().m_x - ndFloat64(20000.0f);
+	EXPECT_NEAR(travel, ndFloat64(body->GetVelocity().m_x) * 2.0, 2.0e-3);
+	EXPECT_GT(travel, 0.09);
+	EXPECT_NEAR(ndFloat64(body->GetMatrix().m_posit.m_x), ndFloat64(20000.0f) + travel, 4.0e-3);
+
+	// with the origin in the body cell the collision and the solver run in small 
+	// float coordinates, and the double position keeps the travel exact.
+	world.SetOrigin(ndBigVector(20000.0f, 0.0f, 0.0f, 1.0f));
+	EXPECT_LT(ndAbs(body->GetMatrix().m_posit.m_x), 1.0f);
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+	}
+	world.Sync();
+	const ndFloat64 cellTravel = world.GetOrigin().m_x + body->GetPrecisePosition().m_x - ndFloat64(20000.0f);
+	EXPECT_NEAR(cellTravel, ndFloat64(body->GetVelocity().m_x) * 4.0, 1.0e-4);
+}
@@ -0,0 +1,432 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include <cstdio>
+#include "ndNewton.h"
+#include "ndFileFormatInc.h"
+#include <gtest/gtest.h>
+
+constexpr ndInt32 MESH_GRID_SIZE = 48;
+constexpr ndFloat32 MESH_CELL_SIZE = 2.0f;
+
+static ndFloat32 MeshElevation(ndInt32 x, ndInt32 z)
+{
+	return 3.0f * ndSin(ndFloat32(x) * 0.25f) * ndCos(ndFloat32(z) * 0.15f);
+}
+
+static void AddMeshFaces(ndPolygonSoupBuilder& meshBuilder)
+{
+	meshBuilder.Begin();
+	for (ndInt32 z = 0; z < MESH_GRID_SIZE - 1; ++z)
+	{
+		for (ndInt32 x = 0; x < MESH_GRID_SIZE - 1; ++x)
+		{
+			ndVector p[4];
+			p[0] = ndVector(ndFloat32(x + 0) * MESH_CELL_SIZE, MeshElevation(x + 0, z + 0), ndFloat32(z + 0) * MESH_CELL_SIZE, 0.0f);
+			p[1] = ndVector(ndFloat32(x + 0) * MESH_CELL_SIZE, MeshElevation(x + 0, z + 1), ndFloat32(z + 1) * MESH_CELL_SIZE, 0.0f);
+			p[2] = ndVector(ndFloat32(x + 1) * MESH_CELL_SIZE, MeshElevation(x + 1, z + 1), ndFloat32(z + 1) * MESH_CELL_SIZE, 0.0f);
+			p[3] = ndVector(ndFloat32(x + 1) * MESH_CELL_SIZE, MeshElevation(x + 1, z + 0), ndFloat32(z + 0) * MESH_CELL_SIZE, 0.0f);
+
+			const ndVector face0[] = { p[0], p[1], p[2] };
+			const ndVector face1[] = { p[0], p[2], p[3] };
+			meshBuilder.AddFace(&face0[0].m_x, sizeof(ndVector), 3, x & 3);
+			meshBuilder.AddFace(&face1[0].m_x, sizeof(ndVector), 3, z & 3);
+		}
+	}
+}
+
+static ndShapeStatic_bvh* BuildMesh(bool compressed)
+{
+	ndPolygonSoupBuilder meshBuilder;
+	AddMeshFaces(meshBuilder);
+	meshBuilder.End(false);
+
+	ndShapeStatic_bvh* const shape = new ndShapeStatic_bvh(meshBuilder);
+	if (compressed)
+	{
+		shape->Compress();
+	}
+	return shape;
+}
+
+static ndBodyKinematic* AddMeshBody(ndWorld& world, ndShapeStatic_bvh* const shape)
+{
+	ndShapeInstance instance(shape);
+	ndBodyKinematic* const body = new ndBodyDynamic();
+	body->SetMatrix(ndGetIdentityMatrix());
+	body->SetCollisionShape(instance);
+	ndSharedPtr<ndBody> bodyPtr(body);
+	world.AddBody(bodyPtr);
+	return body;
+}
+
+static ndBodyDynamic* AddBox(ndWorld& world, const ndVector& posit)
+{
+	ndBodyDynamic* const box = new ndBodyDynamic();
+	box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = posit;
+	box->SetMatrix(matrix);
+	ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+	box->SetCollisionShape(boxShape);
+	box->SetMassMatrix(1.0f, boxShape);
+	ndSharedPtr<ndBody> boxPtr(box);
+	world.AddBody(boxPtr);
+	return box;
+}
+
+TEST(StaticMeshTest, CompressedMatchesUncompressed)
+{
+	ndWorld world0;
+	ndWorld world1;
+	ndShapeStatic_bvh* const mesh0 = BuildMesh(false);
+	ndShapeStatic_bvh* const mesh1 = BuildMesh(true);
+	AddMeshBody(world0, mesh0);
+	AddMeshBody(world1, mesh1);
+
+	EXPECT_FALSE(mesh0->IsCompressed());
+	ASSERT_TRUE(mesh1->IsCompressed());
+	EXPECT_LT(mesh1->GetMemoryUsed() * 2, mesh0->GetMemoryUsed());
+
+	// rays must hit the same surface, within the quantization error
+	for (ndInt32 i = 0; i < 64; ++i)
+	{
+		const ndFloat32 x = ndFloat32(i % 8) * 11.0f + 3.0f;
+		const ndFloat32 z = ndFloat32(i / 8) * 11.0f + 3.0f;
+		const ndVector p0(x, 20.0f, z, 1.0f);
+		const ndVector p1(x + 5.0f, -20.0f, z + 3.0f, 1.0f);
+
+		ndRayCastClosestHitCallback callback0;
+		ndRayCastClosestHitCallback callback1;
+		ASSERT_TRUE(world0.RayCast(callback0, p0, p1));
+		ASSERT_TRUE(world1.RayCast(callback1, p0, p1));
+		EXPECT_NEAR(callback0.m_contact.m_point.m_y, callback1.m_contact.m_point.m_y, 1.0e-2f);
+		EXPECT_NEAR(callback0.m_contact.m_normal.DotProduct(callback1.m_contact.m_normal & ndVector::m_triplexMask).GetScalar(), 1.0f, 1.0e-3f);
+		EXPECT_EQ(callback0.m_contact.m_shapeId0, callback1.m_contact.m_shapeId0);
+	}
+
+	// boxes dropped on the two meshes must end up resting on the surface
+	const ndVector posit(30.0f, 8.0f, 40.0f, 1.0f);
+	ndBodyDynamic* const box0 = AddBox(world0, posit);
+	ndBodyDynamic* const box1 = AddBox(world1, posit);
+	for (ndInt32 i = 0; i < 180; ++i)
+	{
+		world0.Update(1.0f / 60.0f);
+		world1.Update(1.0f / 60.0f);
+	}
+	world0.Sync();
+	world1.Sync();
+
+	const ndVector posit0(box0->GetMatrix().m_posit);
+	const ndVector posit1(box1->GetMatrix().m_posit);
+	ndRayCastClosestHitCallback surface0;
+	ndRayCastClosestHitCallback surface1;
+	ASSERT_TRUE(world0.RayCast(surface0, ndVector(posit0.m_x, -20.0f, posit0.m_z, 1.0f), ndVector(posit0.m_x, 20.0f, posit0.m_z, 1.0f)));
+	ASSERT_TRUE(world1.RayCast(surface1, ndVector(posit1.m_x, -20.0f, posit1.m_z, 1.0f), ndVector(posit1.m_x, 20.0f, posit1.m_z, 1.0f)));
+	EXPECT_GT(posit0.m_y - surface0.m_contact.m_point.m_y, 0.3f);
+	EXPECT_LT(posit0.m_y - surface0.m_contact.m_point.m_y, 1.0f);
+	EXPECT_GT(posit1.m_y - surface1.m_contact.m_point.m_y, 0.3f);
+	EXPECT_LT(posit1.m_y - surface1.m_contact.m_point.m_y, 1.0f);
+}
+
+TEST(StaticMeshTest, CompressedSerialization)
+{
+	const char* const fileName = "compressedStaticMesh.bin";
+	ndShapeStatic_bvh* const mesh = BuildMesh(true);
+	ndShapeInstance instance(mesh);
+	mesh->Serialize(fileName);
+
+	ndShapeStatic_bvh* const loadedMesh = new ndShapeStatic_bvh();
+	ndShapeInstance loadedInstance(loadedMesh);
+	loadedMesh->Deserialize(fileName);
+	remove(fileName);
+
+	EXPECT_TRUE(loadedMesh->IsCompressed());
+	EXPECT_EQ(loadedMesh->GetMemoryUsed(), mesh->GetMemoryUsed());
+	EXPECT_EQ(loadedInstance.GetShape()->GetHash(0), instance.GetShape()->GetHash(0));
+}
+
+static void ExpectSameRayHits(ndShapeStatic_bvh* const mesh0, ndShapeStatic_bvh* const mesh1)
+{
+	ndWorld world0;
+	ndWorld world1;
+	AddMeshBody(world0, mesh0);
+	AddMeshBody(world1, mesh1);
+	for (ndInt32 i = 0; i < 64; ++i)
+	{
+		const ndFloat32 x = ndFloat32(i % 8) * 11.0f + 3.0f;
+		const ndFloat32 z = ndFloat32(i / 8) * 11.0f + 3.0f;
+		const ndVector p0(x, 20.0f, z, 1.0f);
+		const ndVector p1(x - 3.0f, -20.0f, z + 4.0f, 1.0f);
+
+		ndRayCastClosestHitCallback callback0;
+		ndRayCastClosestHitCallback callback1;
+		ASSERT_TRUE(world0.RayCast(callback0, p0, p1));
+		ASSERT_TRUE(world1.RayCast(callback1, p0, p1));
+		EXPECT_EQ(callback0.m_contact.m_point.m_y, callback1.m_contact.m_point.m_y);
+		EXPECT_EQ(callback0.m_contact.m_shapeId0, callback1.m_contact.m_shapeId0);
+	}
+}
+
+TEST(StaticMeshTest, MappedCache)
+{
+	const char* const fileNames[] = { "staticMeshCache.bin", "compressedStaticMeshCache.bin" };
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		ndShapeStatic_bvh* const mesh = BuildMesh(i ? true : false);
+		ASSERT_TRUE(mesh->SaveCache(fileNames[i]));
+
+		ndShapeStatic_bvh* const mappedMesh = new ndShapeStatic_bvh();
+		ASSERT_EQ(mappedMesh->LoadCache(fileNames[i]), ndShapeStatic_bvh::m_cacheLoaded);
+		EXPECT_TRUE(mappedMesh->IsMapped());
+		EXPECT_EQ(mappedMesh->IsCompressed(), mesh->IsCompressed());
+		EXPECT_EQ(mappedMesh->GetMemoryUsed(), mesh->GetMemoryUsed());
+
+		ndVector p0;
+		ndVector p1;
+		ndVector q0;
+		ndVector q1;
+		mesh->GetAABB(p0, p1);
+		mappedMesh->GetAABB(q0, q1);
+		EXPECT_EQ(p0.m_x, q0.m_x);
+		EXPECT_EQ(p1.m_y, q1.m_y);
+
+		ExpectSameRayHits(mesh, mappedMesh);
+		remove(fileNames[i]);
+	}
+}
+
+TEST(StaticMeshTest, MappedCacheRejectsCorruptedFile)
+{
+	const char* const fileName = "corruptedStaticMeshCache.bin";
+	ndShapeStatic_bvh* const mesh = BuildMesh(false);
+	ndShapeInstance instance(mesh);
+	ASSERT_TRUE(mesh->SaveCache(fileName));
+
+	// flip a byte in the middle of the payload
+	FILE* const file = fopen(fileName, "r+b");
+	ASSERT_TRUE(file != nullptr);
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, size / 2, SEEK_SET);
+	const int value = fgetc(file);
+	fseek(file, size / 2, SEEK_SET);
+	fputc(value ^ 0xff, file);
+	fclose(file);
+
+	ndShapeStatic_bvh* const mappedMesh = new ndShapeStatic_bvh();
+	ndShapeInstance mappedInstance(mappedMesh);
+	EXPECT_EQ(mappedMesh->LoadCache(fileName), ndShapeStatic_bvh::m_cacheCorrupted);
+	EXPECT_FALSE(mappedMesh->IsMapped());
+
+	// a truncated cache is damaged, not a file of another format
+	ndArray<char> buffer;
+	buffer.SetCount(ndInt32(size));
+	FILE* const readFile = fopen(fileName, "rb");
+	ASSERT_TRUE(readFile != nullptr);
+	ASSERT_EQ(fread(&buffer[0], size_t(size), 1, readFile), size_t(1));
+	fclose(readFile);
+	const ndInt32 truncatedSizes[] = { 8, ndInt32(size / 2) };
+	for (ndInt32 i = 0; i < ndInt32(sizeof(truncatedSizes) / sizeof(truncatedSizes[0])); ++i)
+	{
+		FILE* const writeFile = fopen(fileName, "wb");
+		ASSERT_TRUE(writeFile != nullptr);
+		ASSERT_EQ(fwrite(&buffer[0], size_t(truncatedSizes[i]), 1, writeFile), size_t(1));
+		fclose(writeFile);
+		EXPECT_EQ(mappedMesh->LoadCache(fileName, false), ndShapeStatic_bvh::m_cacheCorrupted);
+		EXPECT_FALSE(mappedMesh->IsMapped());
+	}
+
+	// files from other formats are rejected without verification
+	mesh->Serialize(fileName);
+	EXPECT_EQ(mappedMesh->LoadCache(fileName, false), ndShapeStatic_bvh::m_cacheNotACacheFile);
+	remove(fileName);
+	EXPECT_EQ(mappedMesh->LoadCache(fileName), ndShapeStatic_bvh::m_cacheNotACacheFile);
+}
+
+// a scene whose static mesh cache is damaged is not loaded, instead of crashing 
+// on the bodies that use the mesh. the same scene loads once the cache is good.
+TEST(StaticMeshTest, SceneWithCorruptedCache)
+{
+	const char* const sceneName = "corruptedCacheScene.nd";
+	{
+		ndWorld world;
+		AddMeshBody(world, BuildMesh(false));
+		AddBox(world, ndVector(10.0f, 6.0f, 10.0f, 1.0f));
+		ndFileFormatSave saver;
+		saver.SaveWorld(&world, sceneName);
+	}
+
+	// the cache file name is in the scene
+	FILE* const sceneFile = fopen(sceneName, "rb");
+	ASSERT_TRUE(sceneFile != nullptr);
+	fseek(sceneFile, 0, SEEK_END);
+	const ndInt32 sceneSize = ndInt32(ftell(sceneFile));
+	fseek(sceneFile, 0, SEEK_SET);
+	ndArray<char> scene;
+	scene.SetCount(sceneSize + 1);
+	ASSERT_EQ(fread(&scene[0], 1, size_t(sceneSize), sceneFile), size_t(sceneSize));
+	fclose(sceneFile);
+	scene[sceneSize] = 0;
+	const char* const assetName = strstr(&scene[0], "assetName");
+	ASSERT_TRUE(assetName != nullptr);
+	char cacheFileName[256];
+	ASSERT_EQ(sscanf(strchr(assetName, '"') + 1, "%255[^\"]", cacheFileName), 1);
+
+	{
+		ndFileFormatLoad loader;
+		ASSERT_TRUE(loader.Load(sceneName));
+		EXPECT_EQ(loader.GetBodyList().GetCount(), 2);
+	}
+
+	FILE* const cacheFile = fopen(cacheFileName, "r+b");
+	ASSERT_TRUE(cacheFile != nullptr);
+	fseek(cacheFile, 0, SEEK_END);
+	const long cacheSize = ftell(cacheFile);
+	fseek(cacheFile, cacheSize / 2, SEEK_SET);
+	const int value = fgetc(cacheFile);
+	fseek(cacheFile, cacheSize / 2, SEEK_SET);
+	fputc(value ^ 0xff, cacheFile);
+	fclose(cacheFile);
+
+	{
+		ndFileFormatLoad loader;
+		EXPECT_FALSE(loader.Load(sceneName));
+		EXPECT_EQ(loader.GetBodyList().GetCount(), 0);
+
+		ndWorld world;
+		loader.AddToWorld(&world);
+		world.Update(1.0f / 60.0f);
+		world.Sync();
+	}
+
+	remove(sceneName);
+	remove(cacheFileName);
+}
+
+class MeshBuildThreadPool: public ndThreadPool
+{
+	public:
+	MeshBuildThreadPool()
+		:ndThreadPool("meshBuild")
+	{
+		SetThreadCount(4);
+	}
+
+	~MeshBuildThreadPool()
+	{
+		Finish();
+	}
+
+	void ThreadFunction() override
+	{
+	}
+};
+
+class CancelBuildProgress: public ndPolygonSoupBuildProgress
+{
+	public:
+	CancelBuildProgress(ndStage cancelStage)
+		:ndPolygonSoupBuildProgress()
+		,m_cancelStage(cancelStage)
+		,m_updates(0)
+	{
+	}
+
+	bool Update(ndStage stage, ndFloat32) override
+	{
+		m_updates++;
+		return stage != m_cancelStage;
+	}
+
+	ndStage m_cancelStage;
+	ndInt32 m_updates;
+};
+
+static void ExpectSameSurface(ndShapeStatic_bvh* const mesh0, ndShapeStatic_bvh* const mesh1)
+{
+	ndWorld world0;
+	ndWorld world1;
+	AddMeshBody(world0, mesh0);
+	AddMeshBody(world1, mesh1);
+	for (ndInt32 i = 0; i < 64; ++i)
+	{
+		const ndFloat32 x = ndFloat32(i % 8) * 11.0f + 3.0f;
+		const ndFloat32 z = ndFloat32(i / 8) * 11.0f + 3.0f;
+		const ndVector p0(x, 20.0f, z, 1.0f);
+		const ndVector p1(x - 3.0f, -20.0f, z + 4.0f, 1.0f);
+
+		ndRayCastClosestHitCallback callback0;
+		ndRayCastClosestHitCallback callback1;
+		ASSERT_TRUE(world0.RayCast(callback0, p0, p1));
+		ASSERT_TRUE(world1.RayCast(callback1, p0, p1));
+		EXPECT_NEAR(callback0.m_contact.m_point.m_y, callback1.m_contact.m_point.m_y, 1.0e-4f);
+		EXPECT_EQ(callback0.m_contact.m_shapeId0, callback1.m_contact.m_shapeId0);
+	}
+}
+
+TEST(StaticMeshTest, ThreadedBuildMatchesSerial)
+{
+	MeshBuildThreadPool threadPool;
+	for (ndInt32 i = 0; i < 2; ++i)
+	{
+		const bool optimize = i ? true : false;
+		ndPolygonSoupBuilder serialBuilder;
+		ndPolygonSoupBuilder threadedBuilder;
+		AddMeshFaces(serialBuilder);
+		AddMeshFaces(threadedBuilder);
+		serialBuilder.End(optimize);
+		ASSERT_TRUE(threadedBuilder.End(threadPool, optimize));
+
+		EXPECT_EQ(threadedBuilder.m_faceVertexCount.GetCount(), serialBuilder.m_faceVertexCount.GetCount());
+		EXPECT_EQ(threadedBuilder.m_vertexPoints.GetCount(), serialBuilder.m_vertexPoints.GetCount());
+		EXPECT_EQ(threadedBuilder.m_normalPoints.GetCount(), serialBuilder.m_normalPoints.GetCount());
+
+		ndShapeStatic_bvh* const serialMesh = new ndShapeStatic_bvh(serialBuilder);
+		ndShapeStatic_bvh* const threadedMesh = new ndShapeStatic_bvh(threadedBuilder, threadPool);
+		ndShapeInstance serialInstance(serialMesh);
+		ndShapeInstance threadedInstance(threadedMesh);
+
+		ndVector p0;
+		ndVector p1;
+		ndVector q0;
+		ndVector q1;
+		serialMesh->GetAABB(p0, p1);
+		threadedMesh->GetAABB(q0, q1);
+		EXPECT_NEAR(p0.m_y, q0.m_y, 1.0e-4f);
+		EXPECT_NEAR(p1.m_y, q1.m_y, 1.0e-4f);
+
+		ExpectSameSurface(serialMesh, threadedMesh);
+
+		// the threaded hierarchy must still compress
+		EXPECT_TRUE(threadedMesh->Compress());
+	}
+}
+
+TEST(StaticMeshTest, ThreadedBuildCancel)
+{
+	MeshBuildThreadPool threadPool;
+
+	ndPolygonSoupBuilder meshBuilder;
+	AddMeshFaces(meshBuilder);
+	CancelBuildProgress cancelOptimize(ndPolygonSoupBuildProgress::m_optimizeFaces);
+	EXPECT_FALSE(meshBuilder.End(threadPool, true, &cancelOptimize));
+	EXPECT_EQ(cancelOptimize.m_updates, 1);
+	EXPECT_EQ(meshBuilder.m_faceVertexCount.GetCount(), 0);
+
+	AddMeshFaces(meshBuilder);
+	CancelBuildProgress cancelHierarchy(ndPolygonSoupBuildProgress::m_buildHierarchy);
+	ASSERT_TRUE(meshBuilder.End(threadPool, false, &cancelHierarchy));
+	ndShapeStatic_bvh* const mesh = new ndShapeStatic_bvh(meshBuilder, threadPool, &cancelHierarchy);
+	ndShapeInstance instance(mesh);
+	EXPECT_TRUE(mesh->GetRootNode() == nullptr);
+	EXPECT_EQ(mesh->GetVertexCount(), 0);
+}
@@ -47,3 +47,87 @@ TEST(Extremes, OrbitalDistances)
 
 	world.CleanUp();
 }
+
+static void BuildRebaseScene(ndWorld& world, const ndVector& center, ndArray<ndBodyDynamic*>& bodies)
+{
+	const ndVector gravity(0.0f, -10.0f, 0.0f, 0.0f);
+	auto AddBody = [&world, &gravity, &center](ndShapeInstance& shape, const ndVector& posit, ndFloat32 mass)
+	{
+		ndBodyDynamic* const body = new ndBodyDynamic();
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = center + posit;
+		matrix.m_posit.m_w = 1.0f;
+		body->SetMatrix(matrix);
+		body->SetCollisionShape(shape);
+		if (mass > ndFloat32(0.0f))
+		{
+			body->SetNotifyCallback(new ndBodyNotify(gravity));
+			body->SetMassMatrix(mass, shape);
+		}
+		ndSharedPtr<ndBody> bodyPtr(body);
+		world.AddBody(bodyPtr);
+		return body;
+	};
+
+	ndShapeInstance floorShape(new ndShapeBox(40.0f, 1.0f, 40.0f));
+	ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+	ndShapeInstance sphereShape(new ndShapeSphere(0.25f));
+	AddBody(floorShape, ndVector(0.0f, -0.5f, 0.0f, 0.0f), 0.0f);
+	bodies.PushBack(AddBody(boxShape, ndVector(0.0f, 1.0f, 0.0f, 0.0f), 1.0f));
+
+	// a pendulum hanging from the world
+	ndBodyDynamic* const bob = AddBody(sphereShape, ndVector(6.0f, 3.0f, 0.0f, 0.0f), 1.0f);
+	bob->SetVelocity(ndVector(0.0f, 0.0f, 2.0f, 0.0f));
+	ndMatrix pivot(ndGetIdentityMatrix());
+	pivot.m_posit = center + ndVector(6.0f, 5.0f, 0.0f, 1.0f);
+	ndSharedPtr<ndJointBilateralConstraint> joint(new ndJointSpherical(pivot, bob, world.GetSentinelBody()));
+	world.AddJoint(joint);
+	bodies.PushBack(bob);
+}
+
+TEST(Extremes, OriginRebasing)
+{
+	// the same scene simulated at the origin, and 20 km away 
+	// from it in a world that follows the box with its origin.
+	ndWorld world0;
+	ndWorld world1;
+	world1.SetOriginCellSize(500.0f);
+
+	ndArray<ndBodyDynamic*> bodies0;
+	ndArray<ndBodyDynamic*> bodies1;
+	const ndBigVector center(20000.0f, 0.0f, 0.0f, 0.0f);
+	BuildRebaseScene(world0, ndVector::m_zero, bodies0);
+	BuildRebaseScene(world1, ndVector(center), bodies1);
+
+	EXPECT_TRUE(world1.UpdateOriginCell(world1.GetOrigin() + bodies1[0]->GetPrecisePosition()));
+	EXPECT_NEAR(world1.GetOrigin().m_x, center.m_x, 1.0e-6);
+	EXPECT_NEAR(bodies1[0]->GetMatrix().m_posit.m_x, 0.0f, 1.0e-6f);
+
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		if (i == 60)
+		{
+			// move the origin while the box rests on the floor and the pendulum swings
+			world1.SetOrigin(world1.GetOrigin() + ndBigVector(300.0f, 0.0f, -200.0f, 0.0f));
+		}
+		EXPECT_FALSE(world1.UpdateOriginCell(world1.GetOrigin() + bodies1[0]->GetPrecisePosition()));
+		world0.Update(1.0f / 60.0f);
+		world1.Update(1.0f / 60.0f);
+		world0.Sync();
+		world1.Sync();
+	}
+
+	for (ndInt32 i = 0; i < bodies0.GetCount(); ++i)
+	{
+		const ndBigVector posit0(bodies0[i]->GetPrecisePosition());
+		const ndBigVector posit1(world1.GetOrigin() + bodies1[i]->GetPrecisePosition() - center);
+		EXPECT_NEAR(posit0.m_x, posit1.m_x, 1.0e-2);
+		EXPECT_NEAR(posit0.m_y, posit1.m_y, 1.0e-2);
+		EXPECT_NEAR(posit0.m_z, posit1.m_z, 1.0e-2);
+	}
+
+	// the box rests on the floor, and the pendulum still hangs from its pivot
+	EXPECT_NEAR(bodies0[0]->GetMatrix().m_posit.m_y, 0.5f, 2.0e-2f);
+	const ndBigVector arm(world1.GetOrigin() + bodies1[1]->GetPrecisePosition() - center - ndBigVector(6.0f, 5.0f, 0.0f, 1.0f));
+	EXPECT_NEAR(sqrt(arm.DotProduct(arm & ndBigVector::m_triplexMask).GetScalar()), 2.0, 1.0e-2);
+}